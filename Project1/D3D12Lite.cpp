@@ -1,16 +1,25 @@
 #include "D3D12Lite.h"
+#include "D3D12LiteBackend.h"
+#include "D3D12LiteNullBackend.h"
+#include "D3D12LitePipelineCache.h"
 #include "DXTex/DirectXTex.h"
-#include "D3D12MemoryAllocator/D3D12MemAlloc.h"
-#include "dxc/inc/dxcapi.h"
-#include <dxgidebug.h>
 #include <numeric>
+#include <algorithm>
+#include <unordered_map>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 extern "C" { __declspec(dllexport) extern const UINT D3D12SDKVersion = 602; }
 extern "C" { __declspec(dllexport) extern const char* D3D12SDKPath = ".\\D3D12\\"; }
 
 namespace D3D12Lite
 {
-    DescriptorHeap::DescriptorHeap(ID3D12Device* device, D3D12_DESCRIPTOR_HEAP_TYPE heapType, uint32_t numDescriptors, bool isShaderVisible)
+    DescriptorHeap::DescriptorHeap(DeviceBackend& backend, D3D12_DESCRIPTOR_HEAP_TYPE heapType, uint32_t numDescriptors, bool isShaderVisible)
         :mHeapType(heapType)
         , mMaxDescriptors(numDescriptors)
         , mIsShaderVisible(isShaderVisible)
@@ -21,32 +30,87 @@ namespace D3D12Lite
         heapDesc.Flags = mIsShaderVisible ? D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE : D3D12_DESCRIPTOR_HEAP_FLAG_NONE;
         heapDesc.NodeMask = 0;
 
-        AssertIfFailed(device->CreateDescriptorHeap(&heapDesc, IID_PPV_ARGS(&mDescriptorHeap)));
+        mDescriptorHeap = backend.CreateDescriptorHeap(heapDesc, mHeapStart, mDescriptorSize);
+    }
+
+    DescriptorHeap::~DescriptorHeap()
+    {
+        SafeRelease(mDescriptorHeap);
+    }
+
+    namespace
+    {
+        constexpr uint32_t INVALID_FREE_LIST_INDEX = UINT32_MAX;
+
+        uint64_t PackFreeListHead(uint32_t descriptorIndex, uint32_t tag)
+        {
+            return (static_cast<uint64_t>(tag) << 32) | descriptorIndex;
+        }
 
-        mHeapStart.mCPUHandle = mDescriptorHeap->GetCPUDescriptorHandleForHeapStart();
+        uint32_t GetFreeListHeadIndex(uint64_t head)
+        {
+            return static_cast<uint32_t>(head & UINT32_MAX);
+        }
 
-        if (mIsShaderVisible)
+        uint32_t GetFreeListHeadTag(uint64_t head)
         {
-            mHeapStart.mGPUHandle = mDescriptorHeap->GetGPUDescriptorHandleForHeapStart();
+            return static_cast<uint32_t>(head >> 32);
         }
 
-        mDescriptorSize = device->GetDescriptorHandleIncrementSize(mHeapType);
+        //Heaps that are still alive, so a thread that exits can hand its magazines back without racing heap destruction.
+        std::mutex gStagingHeapRegistryMutex;
+        std::unordered_map<uint64_t, StagingDescriptorHeap*> gStagingHeapRegistry;
+        std::atomic<uint64_t> gNextStagingHeapID{ 1 };
     }
 
-    DescriptorHeap::~DescriptorHeap()
+    struct StagingDescriptorHeap::ThreadMagazineCache
     {
-        SafeRelease(mDescriptorHeap);
-    }
+        ~ThreadMagazineCache()
+        {
+            std::lock_guard<std::mutex> lockGuard(gStagingHeapRegistryMutex);
+
+            for (auto& entry : mEntries)
+            {
+                auto heapIter = gStagingHeapRegistry.find(entry.first);
+                if (heapIter != gStagingHeapRegistry.end())
+                {
+                    heapIter->second->ReturnThreadMagazine(entry.second);
+                }
+            }
+        }
 
-    StagingDescriptorHeap::StagingDescriptorHeap(ID3D12Device* device, D3D12_DESCRIPTOR_HEAP_TYPE heapType, uint32_t numDescriptors)
-        :DescriptorHeap(device, heapType, numDescriptors, false)
+        std::vector<std::pair<uint64_t, Magazine*>> mEntries;
+        uint64_t mLastHeapID = 0;
+        Magazine* mLastMagazine = nullptr;
+    };
+
+    thread_local StagingDescriptorHeap::ThreadMagazineCache StagingDescriptorHeap::sThreadMagazineCache;
+
+    StagingDescriptorHeap::StagingDescriptorHeap(DeviceBackend& backend, D3D12_DESCRIPTOR_HEAP_TYPE heapType, uint32_t numDescriptors)
+        :DescriptorHeap(backend, heapType, numDescriptors, false)
+        , mHeapID(gNextStagingHeapID.fetch_add(1, std::memory_order_relaxed))
+        , mBatchSize(std::clamp(numDescriptors / 64, 1u, MAX_STAGING_DESCRIPTOR_BATCH_SIZE))
+        , mFreeListHead(PackFreeListHead(INVALID_FREE_LIST_INDEX, 0))
+        , mFreeListLinks(std::make_unique<std::atomic<uint32_t>[]>(numDescriptors))
     {
-        mFreeDescriptors.reserve(numDescriptors);
+        std::lock_guard<std::mutex> lockGuard(gStagingHeapRegistryMutex);
+        gStagingHeapRegistry[mHeapID] = this;
     }
 
     StagingDescriptorHeap::~StagingDescriptorHeap()
     {
-        if (mActiveHandleCount != 0)
+        {
+            std::lock_guard<std::mutex> lockGuard(gStagingHeapRegistryMutex);
+            gStagingHeapRegistry.erase(mHeapID);
+        }
+
+        int64_t activeHandleCount = 0;
+        for (auto& magazine : mMagazines)
+        {
+            activeHandleCount += magazine->mActiveHandleCount;
+        }
+
+        if (activeHandleCount != 0)
         {
             AssertError("There were active handles when the descriptor heap was destroyed. Look for leaks.");
         }
@@ -54,53 +118,196 @@ namespace D3D12Lite
 
     Descriptor StagingDescriptorHeap::GetNewDescriptor()
     {
-        std::lock_guard<std::mutex> lockGuard(mUsageMutex);
+        Magazine& magazine = GetThreadMagazine();
 
-        uint32_t newHandleID = 0;
-
-        if (mCurrentDescriptorIndex < mMaxDescriptors)
-        {
-            newHandleID = mCurrentDescriptorIndex;
-            mCurrentDescriptorIndex++;
-        }
-        else if (mFreeDescriptors.size() > 0)
-        {
-            newHandleID = mFreeDescriptors.back();
-            mFreeDescriptors.pop_back();
-        }
-        else
+        if (magazine.mCount == 0)
         {
-            AssertError("Ran out of dynamic descriptor heap handles, need to increase heap size.");
+            RefillMagazine(magazine);
+
+            //AssertError compiles out in release, so the caller gets an invalid descriptor rather than a wrapped count.
+            if (magazine.mCount == 0)
+            {
+                return Descriptor{};
+            }
         }
 
+        magazine.mCount--;
+        uint32_t newHandleID = magazine.mDescriptorIndices[magazine.mCount];
+
         Descriptor newDescriptor;
         D3D12_CPU_DESCRIPTOR_HANDLE cpuHandle = mHeapStart.mCPUHandle;
         cpuHandle.ptr += static_cast<uint64_t>(newHandleID) * mDescriptorSize;
         newDescriptor.mCPUHandle = cpuHandle;
         newDescriptor.mHeapIndex = newHandleID;
 
-        mActiveHandleCount++;
+        magazine.mActiveHandleCount++;
 
         return newDescriptor;
     }
 
     void StagingDescriptorHeap::FreeDescriptor(Descriptor descriptor)
     {
-        std::lock_guard<std::mutex> lockGuard(mUsageMutex);
+        assert(descriptor.mHeapIndex < mMaxDescriptors);
 
-        mFreeDescriptors.push_back(descriptor.mHeapIndex);
+        Magazine& magazine = GetThreadMagazine();
 
-        if (mActiveHandleCount == 0)
+        //Full magazine: hand the older half back to the shared free list and keep the recently freed (cache-warm) half.
+        if (magazine.mCount == mBatchSize * 2)
         {
-            AssertError("Freeing heap handles when there should be none left");
-            return;
+            PushFreeList(magazine.mDescriptorIndices.data(), mBatchSize);
+            std::copy(magazine.mDescriptorIndices.begin() + mBatchSize, magazine.mDescriptorIndices.begin() + magazine.mCount, magazine.mDescriptorIndices.begin());
+            magazine.mCount -= mBatchSize;
+            mNumGlobalReturns.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        magazine.mDescriptorIndices[magazine.mCount] = descriptor.mHeapIndex;
+        magazine.mCount++;
+
+        //Per-thread counts can go negative when a descriptor is freed on another thread than it was allocated on,
+        //only the sum over all magazines is meaningful.
+        magazine.mActiveHandleCount--;
+    }
+
+    StagingDescriptorHeap::Magazine& StagingDescriptorHeap::GetThreadMagazine()
+    {
+        ThreadMagazineCache& cache = sThreadMagazineCache;
+
+        if (cache.mLastHeapID == mHeapID)
+        {
+            return *cache.mLastMagazine;
+        }
+
+        Magazine* magazine = nullptr;
+
+        for (auto& entry : cache.mEntries)
+        {
+            if (entry.first == mHeapID)
+            {
+                magazine = entry.second;
+                break;
+            }
+        }
+
+        if (!magazine)
+        {
+            std::lock_guard<std::mutex> lockGuard(mMagazineMutex);
+
+            if (mSpareMagazines.size() > 0)
+            {
+                magazine = mSpareMagazines.back();
+                mSpareMagazines.pop_back();
+            }
+            else
+            {
+                mMagazines.push_back(std::make_unique<Magazine>());
+                magazine = mMagazines.back().get();
+            }
+
+            cache.mEntries.push_back({ mHeapID, magazine });
+        }
+
+        cache.mLastHeapID = mHeapID;
+        cache.mLastMagazine = magazine;
+
+        return *magazine;
+    }
+
+    void StagingDescriptorHeap::RefillMagazine(Magazine& magazine)
+    {
+        mNumGlobalRefills.fetch_add(1, std::memory_order_relaxed);
+
+        uint32_t currentIndex = mCurrentDescriptorIndex.load(std::memory_order_relaxed);
+
+        while (currentIndex < mMaxDescriptors)
+        {
+            uint32_t count = std::min(mBatchSize, mMaxDescriptors - currentIndex);
+
+            if (mCurrentDescriptorIndex.compare_exchange_weak(currentIndex, currentIndex + count, std::memory_order_relaxed))
+            {
+                //Reverse order so a single thread still hands out indices sequentially.
+                for (uint32_t index = 0; index < count; index++)
+                {
+                    magazine.mDescriptorIndices[index] = currentIndex + count - 1 - index;
+                }
+
+                magazine.mCount = count;
+                return;
+            }
+        }
+
+        magazine.mCount = PopFreeList(magazine.mDescriptorIndices.data(), mBatchSize);
+
+        if (magazine.mCount == 0)
+        {
+            AssertError("Ran out of dynamic descriptor heap handles, need to increase heap size.");
+        }
+    }
+
+    void StagingDescriptorHeap::ReturnThreadMagazine(Magazine* magazine)
+    {
+        if (magazine->mCount > 0)
+        {
+            PushFreeList(magazine->mDescriptorIndices.data(), magazine->mCount);
+            magazine->mCount = 0;
+        }
+
+        std::lock_guard<std::mutex> lockGuard(mMagazineMutex);
+        mSpareMagazines.push_back(magazine);
+    }
+
+    uint32_t StagingDescriptorHeap::PopFreeList(uint32_t* descriptorIndices, uint32_t maxCount)
+    {
+        uint64_t head = mFreeListHead.load(std::memory_order_acquire);
+
+        while (true)
+        {
+            uint32_t descriptorIndex = GetFreeListHeadIndex(head);
+            uint32_t count = 0;
+
+            //The chain may be stale if another thread got in first, but then the tag changed and the exchange below fails.
+            while (descriptorIndex != INVALID_FREE_LIST_INDEX && count < maxCount)
+            {
+                descriptorIndices[count] = descriptorIndex;
+                count++;
+                descriptorIndex = mFreeListLinks[descriptorIndex].load(std::memory_order_relaxed);
+            }
+
+            if (count == 0)
+            {
+                return 0;
+            }
+
+            uint64_t newHead = PackFreeListHead(descriptorIndex, GetFreeListHeadTag(head) + 1);
+
+            if (mFreeListHead.compare_exchange_weak(head, newHead, std::memory_order_acquire, std::memory_order_acquire))
+            {
+                return count;
+            }
+        }
+    }
+
+    void StagingDescriptorHeap::PushFreeList(const uint32_t* descriptorIndices, uint32_t count)
+    {
+        assert(count > 0);
+
+        for (uint32_t index = 0; index + 1 < count; index++)
+        {
+            mFreeListLinks[descriptorIndices[index]].store(descriptorIndices[index + 1], std::memory_order_relaxed);
         }
 
-        mActiveHandleCount--;
+        uint32_t lastIndex = descriptorIndices[count - 1];
+        uint64_t head = mFreeListHead.load(std::memory_order_relaxed);
+        uint64_t newHead = 0;
+
+        do
+        {
+            mFreeListLinks[lastIndex].store(GetFreeListHeadIndex(head), std::memory_order_relaxed);
+            newHead = PackFreeListHead(descriptorIndices[0], GetFreeListHeadTag(head) + 1);
+        } while (!mFreeListHead.compare_exchange_weak(head, newHead, std::memory_order_release, std::memory_order_relaxed));
     }
 
-    RenderPassDescriptorHeap::RenderPassDescriptorHeap(ID3D12Device* device, D3D12_DESCRIPTOR_HEAP_TYPE heapType, uint32_t reservedCount, uint32_t userCount)
-        :DescriptorHeap(device, heapType, reservedCount + userCount, true)
+    RenderPassDescriptorHeap::RenderPassDescriptorHeap(DeviceBackend& backend, D3D12_DESCRIPTOR_HEAP_TYPE heapType, uint32_t reservedCount, uint32_t userCount)
+        :DescriptorHeap(backend, heapType, reservedCount + userCount, true)
         , mReservedHandleCount(reservedCount)
         , mCurrentDescriptorIndex(reservedCount)
     {
@@ -125,23 +332,19 @@ namespace D3D12Lite
 
     Descriptor RenderPassDescriptorHeap::AllocateUserDescriptorBlock(uint32_t count)
     {
-        uint32_t newHandleID = 0;
+        //Only moves the index when the block fits, so a request that fails leaves the rest of the heap to smaller ones.
+        uint32_t newHandleID = mCurrentDescriptorIndex.load(std::memory_order_relaxed);
 
+        do
         {
-            std::lock_guard<std::mutex> lockGuard(mUsageMutex);
-
-            uint32_t blockEnd = mCurrentDescriptorIndex + count;
-
-            if (blockEnd <= mMaxDescriptors)
-            {
-                newHandleID = mCurrentDescriptorIndex;
-                mCurrentDescriptorIndex = blockEnd;
-            }
-            else
+            if (count > mMaxDescriptors - newHandleID)
             {
+                //Handing out index 0 instead would alias the reserved bindless range. AssertError compiles out in release,
+                //so the caller gets an invalid descriptor and skips the table.
                 AssertError("Ran out of render pass descriptor heap handles, need to increase heap size.");
+                return Descriptor{};
             }
-        }
+        } while (!mCurrentDescriptorIndex.compare_exchange_weak(newHandleID, newHandleID + count, std::memory_order_relaxed));
 
         Descriptor newDescriptor;
         newDescriptor.mHeapIndex = newHandleID;
@@ -159,7 +362,7 @@ namespace D3D12Lite
 
     void RenderPassDescriptorHeap::Reset()
     {
-        mCurrentDescriptorIndex = mReservedHandleCount;
+        mCurrentDescriptorIndex.store(mReservedHandleCount, std::memory_order_relaxed);
     }
 
     bool SortPipelineBindings(PipelineResourceBinding a, PipelineResourceBinding b)
@@ -171,7 +374,7 @@ namespace D3D12Lite
     {
         if (mIsLocked)
         {
-            if (mCBV == nullptr)
+            if (!HasCBV())
             {
                 AssertError("Setting unused binding in a locked resource space");
             }
@@ -184,6 +387,20 @@ namespace D3D12Lite
         {
             mCBV = resource;
         }
+
+        mTransientCBVAddress = 0;
+    }
+
+    void PipelineResourceSpace::SetTransientCBV(const TransientConstantBuffer& constantBuffer)
+    {
+        if (mIsLocked && !HasCBV())
+        {
+            AssertError("Setting unused binding in a locked resource space");
+            return;
+        }
+
+        mCBV = nullptr;
+        mTransientCBVAddress = constantBuffer.mVirtualAddress;
     }
 
     void PipelineResourceSpace::SetSRV(const PipelineResourceBinding& binding)
@@ -263,33 +480,30 @@ namespace D3D12Lite
         return UINT_MAX;
     }
 
-    Queue::Queue(ID3D12Device* device, D3D12_COMMAND_LIST_TYPE commandType)
+    Queue::Queue(DeviceBackend& backend, D3D12_COMMAND_LIST_TYPE commandType)
         :mQueueType(commandType)
     {
-        D3D12_COMMAND_QUEUE_DESC queueDesc = {};
-        queueDesc.Type = mQueueType;
-        queueDesc.NodeMask = 0;
-        device->CreateCommandQueue(&queueDesc, IID_PPV_ARGS(&mQueue));
-
-        AssertIfFailed(device->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&mFence)));
-
-        mFence->Signal(mLastCompletedFenceValue);
-
-        mFenceEventHandle = CreateEventEx(nullptr, nullptr, 0, EVENT_ALL_ACCESS);
-        assert(mFenceEventHandle != INVALID_HANDLE_VALUE);
+        mQueue = backend.CreateQueue(mQueueType);
     }
 
     Queue::~Queue()
     {
-        CloseHandle(mFenceEventHandle);
+        mQueue = nullptr;
+    }
+
+    ID3D12CommandQueue* Queue::GetDeviceQueue()
+    {
+        return mQueue->GetNativeQueue();
+    }
 
-        SafeRelease(mFence);
-        SafeRelease(mQueue);
+    ID3D12Fence* Queue::GetFence()
+    {
+        return mQueue->GetNativeFence();
     }
 
     uint64_t Queue::PollCurrentFenceValue()
     {
-        mLastCompletedFenceValue = (std::max)(mLastCompletedFenceValue, mFence->GetCompletedValue());
+        mLastCompletedFenceValue = (std::max)(mLastCompletedFenceValue, mQueue->GetCompletedValue());
         return mLastCompletedFenceValue;
     }
 
@@ -305,17 +519,17 @@ namespace D3D12Lite
 
     void Queue::InsertWait(uint64_t fenceValue)
     {
-        mQueue->Wait(mFence, fenceValue);
+        mQueue->InsertWait(*mQueue, fenceValue);
     }
 
     void Queue::InsertWaitForQueueFence(Queue* otherQueue, uint64_t fenceValue)
     {
-        mQueue->Wait(otherQueue->GetFence(), fenceValue);
+        mQueue->InsertWait(otherQueue->GetBackendQueue(), fenceValue);
     }
 
     void Queue::InsertWaitForQueue(Queue* otherQueue)
     {
-        mQueue->Wait(otherQueue->GetFence(), otherQueue->GetNextFenceValue() - 1);
+        mQueue->InsertWait(otherQueue->GetBackendQueue(), otherQueue->GetNextFenceValue() - 1);
     }
 
     void Queue::WaitForFenceCPUBlocking(uint64_t fenceValue)
@@ -328,8 +542,7 @@ namespace D3D12Lite
         {
             std::lock_guard<std::mutex> lockGuard(mEventMutex);
 
-            mFence->SetEventOnCompletion(fenceValue, mFenceEventHandle);
-            WaitForSingleObjectEx(mFenceEventHandle, INFINITE, false);
+            mQueue->WaitForFenceCPUBlocking(fenceValue);
             mLastCompletedFenceValue = fenceValue;
         }
     }
@@ -339,10 +552,16 @@ namespace D3D12Lite
         WaitForFenceCPUBlocking(mNextFenceValue - 1);
     }
 
-    uint64_t Queue::ExecuteCommandList(ID3D12CommandList* commandList)
+    uint64_t Queue::ExecuteCommandList(CommandRecorder& commandRecorder)
+    {
+        CommandRecorder* commandRecorders[] = { &commandRecorder };
+
+        return ExecuteCommandLists(1, commandRecorders);
+    }
+
+    uint64_t Queue::ExecuteCommandLists(uint32_t numCommandRecorders, CommandRecorder* const* commandRecorders)
     {
-        AssertIfFailed(static_cast<ID3D12GraphicsCommandList*>(commandList)->Close());
-        mQueue->ExecuteCommandLists(1, &commandList);
+        mQueue->ExecuteCommandLists(numCommandRecorders, commandRecorders);
 
         return SignalFence();
     }
@@ -351,39 +570,70 @@ namespace D3D12Lite
     {
         std::lock_guard<std::mutex> lockGuard(mFenceMutex);
 
-        mQueue->Signal(mFence, mNextFenceValue);
+        mQueue->Signal(mNextFenceValue);
 
         return mNextFenceValue++;
     }
 
-    Context::Context(Device& device, D3D12_COMMAND_LIST_TYPE commandType)
-        :mDevice(device)
-        , mContextType(commandType)
+    uint32_t GetNumSubresources(const Resource& resource)
     {
-        for (uint32_t frameIndex = 0; frameIndex < NUM_FRAMES_IN_FLIGHT; frameIndex++)
+        if (resource.mType == GPUResourceType::buffer)
+        {
+            return 1;
+        }
+
+        const D3D12_RESOURCE_DESC& desc = resource.mDesc;
+        const uint32_t arraySize = desc.Dimension == D3D12_RESOURCE_DIMENSION_TEXTURE3D ? 1 : desc.DepthOrArraySize;
+        uint32_t planeCount = 1;
+
+        switch (desc.Format)
         {
-            AssertIfFailed(mDevice.GetDevice()->CreateCommandAllocator(commandType, IID_PPV_ARGS(&mCommandAllocators[frameIndex])));
+        case DXGI_FORMAT_D24_UNORM_S8_UINT:
+        case DXGI_FORMAT_R24G8_TYPELESS:
+        case DXGI_FORMAT_D32_FLOAT_S8X24_UINT:
+        case DXGI_FORMAT_R32G8X24_TYPELESS:
+            planeCount = 2;
+            break;
+        default:
+            break;
         }
 
-        AssertIfFailed(mDevice.GetDevice()->CreateCommandList1(0, commandType, D3D12_COMMAND_LIST_FLAG_NONE, IID_PPV_ARGS(&mCommandList)));
+        return desc.MipLevels * arraySize * planeCount;
+    }
+
+    Context::Context(Device& device, D3D12_COMMAND_LIST_TYPE commandType)
+        :mDevice(device)
+        , mContextType(commandType)
+    {
+        mCommandRecorder = mDevice.GetBackend().CreateCommandRecorder(commandType);
+        mQueuedBarriers.reserve(MAX_QUEUED_BARRIERS);
+        mResourceBarriers.reserve(MAX_QUEUED_BARRIERS);
     }
 
     Context::~Context()
     {
-        SafeRelease(mCommandList);
+        mCommandRecorder = nullptr;
+    }
 
-        for (uint32_t frameIndex = 0; frameIndex < NUM_FRAMES_IN_FLIGHT; frameIndex++)
-        {
-            SafeRelease(mCommandAllocators[frameIndex]);
-        }
+    ID3D12GraphicsCommandList* Context::GetCommandList()
+    {
+        InvalidateState();
+
+        return mCommandRecorder->GetNativeCommandList();
     }
 
     void Context::Reset()
     {
         uint32_t frameId = mDevice.GetFrameId();
 
-        mCommandAllocators[frameId]->Reset();
-        mCommandList->Reset(mCommandAllocators[frameId], nullptr);
+        mCommandRecorder->Reset(frameId);
+
+        assert(mQueuedBarriers.empty() && mPendingSplitBarriers.empty());
+        mTrackedStates.clear();
+        mPendingBarriers.clear();
+        mBarrierStatistics = BarrierStatistics{};
+        mStateFilterStatistics = StateFilterStatistics{};
+        InvalidateState();
 
         if (mContextType != D3D12_COMMAND_LIST_TYPE_COPY)
         {
@@ -391,148 +641,455 @@ namespace D3D12Lite
         }
     }
 
-    void Context::AddBarrier(Resource& resource, D3D12_RESOURCE_STATES newState)
+    void Context::AddBarrier(Resource& resource, D3D12_RESOURCE_STATES newState, uint32_t subresource)
     {
-        if (mNumQueuedBarriers >= MAX_QUEUED_BARRIERS)
-        {
-            FlushBarriers();
-        }
+        TrackedResourceState& trackedState = mTrackedStates[&resource];
 
-        D3D12_RESOURCE_STATES oldState = resource.mState;
+        const bool isTrackedPerSubresource = !trackedState.mSubresourceStates.empty();
+        const D3D12_RESOURCE_STATES oldState = (subresource != D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES && isTrackedPerSubresource) ? trackedState.mSubresourceStates[subresource] : trackedState.mState;
 
         if (mContextType == D3D12_COMMAND_LIST_TYPE_COMPUTE)
         {
             constexpr D3D12_RESOURCE_STATES VALID_COMPUTE_CONTEXT_STATES = (D3D12_RESOURCE_STATE_UNORDERED_ACCESS | D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE |
                                                                             D3D12_RESOURCE_STATE_COPY_DEST | D3D12_RESOURCE_STATE_COPY_SOURCE);
 
-            assert((oldState & VALID_COMPUTE_CONTEXT_STATES) == oldState);
+            assert(oldState == UNKNOWN_RESOURCE_STATE || (oldState & VALID_COMPUTE_CONTEXT_STATES) == oldState);
             assert((newState & VALID_COMPUTE_CONTEXT_STATES) == newState);
         }
 
-        if (oldState != newState)
+        if (subresource == D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES && isTrackedPerSubresource)
         {
-            D3D12_RESOURCE_BARRIER& barrierDesc = mResourceBarriers[mNumQueuedBarriers];
-            mNumQueuedBarriers++;
+            //Bring every subresource over individually, then go back to tracking the resource as a whole.
+            const uint32_t numSubresources = static_cast<uint32_t>(trackedState.mSubresourceStates.size());
+            for (uint32_t subresourceIndex = 0; subresourceIndex < numSubresources; subresourceIndex++)
+            {
+                const D3D12_RESOURCE_STATES subresourceState = trackedState.mSubresourceStates[subresourceIndex];
 
-            barrierDesc.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
-            barrierDesc.Transition.pResource = resource.mResource;
-            barrierDesc.Transition.Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
-            barrierDesc.Transition.StateBefore = oldState;
-            barrierDesc.Transition.StateAfter = newState;
-            barrierDesc.Flags = D3D12_RESOURCE_BARRIER_FLAG_NONE;
+                if (subresourceState == UNKNOWN_RESOURCE_STATE)
+                {
+                    mPendingBarriers.push_back({ &resource, subresourceIndex, newState });
+                }
+                else if (subresourceState != newState)
+                {
+                    QueueTransition(resource, subresourceIndex, subresourceState, newState);
+                }
+            }
 
-            resource.mState = newState;
+            trackedState.mSubresourceStates.clear();
+            trackedState.mState = newState;
+        }
+        else if (oldState == UNKNOWN_RESOURCE_STATE)
+        {
+            //Other contexts may still be recording work on the resource, the state it is in before this one is only known
+            //once everything submitted ahead of this context is.
+            mPendingBarriers.push_back({ &resource, subresource, newState });
+            SetTrackedState(trackedState, resource, subresource, newState);
+        }
+        else if (oldState != newState)
+        {
+            QueueTransition(resource, subresource, oldState, newState);
+            SetTrackedState(trackedState, resource, subresource, newState);
         }
         else if (newState == D3D12_RESOURCE_STATE_UNORDERED_ACCESS)
         {
-            D3D12_RESOURCE_BARRIER& barrierDesc = mResourceBarriers[mNumQueuedBarriers];
-            mNumQueuedBarriers++;
-
-            barrierDesc.Type = D3D12_RESOURCE_BARRIER_TYPE_UAV;
-            barrierDesc.Flags = D3D12_RESOURCE_BARRIER_FLAG_NONE;
-            barrierDesc.UAV.pResource = resource.mResource;
+            QueuedBarrier& queuedBarrier = mQueuedBarriers.emplace_back();
+            queuedBarrier.mResource = &resource;
+            queuedBarrier.mBarrier.Type = D3D12_RESOURCE_BARRIER_TYPE_UAV;
+            queuedBarrier.mBarrier.Flags = D3D12_RESOURCE_BARRIER_FLAG_NONE;
+            queuedBarrier.mBarrier.UAV.pResource = resource.mResource;
+        }
+        else
+        {
+            mBarrierStatistics.mNumBarriersElided++;
         }
     }
 
-    void Context::FlushBarriers()
+    void Context::SetTrackedState(TrackedResourceState& trackedState, Resource& resource, uint32_t subresource, D3D12_RESOURCE_STATES newState)
     {
-        if (mNumQueuedBarriers > 0)
+        if (subresource == D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES)
         {
-            mCommandList->ResourceBarrier(mNumQueuedBarriers, mResourceBarriers.data());
-            mNumQueuedBarriers = 0;
+            trackedState.mSubresourceStates.clear();
+            trackedState.mState = newState;
+            return;
         }
-    }
 
-    void Context::BindDescriptorHeaps(uint32_t frameIndex)
-    {
-        mCurrentSRVHeap = &mDevice.GetSRVHeap(frameIndex);
-        mCurrentSRVHeap->Reset();
+        if (trackedState.mSubresourceStates.empty())
+        {
+            trackedState.mSubresourceStates.assign(GetNumSubresources(resource), trackedState.mState);
+        }
 
-        ID3D12DescriptorHeap* heapsToBind[2];
-        heapsToBind[0] = mDevice.GetSRVHeap(frameIndex).GetHeap();
-        heapsToBind[1] = mDevice.GetSamplerHeap().GetHeap();
+        trackedState.mSubresourceStates[subresource] = newState;
 
-        mCommandList->SetDescriptorHeaps(2, heapsToBind);
+        if (std::all_of(trackedState.mSubresourceStates.begin(), trackedState.mSubresourceStates.end(), [newState](D3D12_RESOURCE_STATES state) { return state == newState; }))
+        {
+            trackedState.mSubresourceStates.clear();
+            trackedState.mState = newState;
+        }
     }
 
-    void Context::CopyResource(const Resource& destination, const Resource& source)
+    void Context::TrackCurrentState(Resource& resource)
     {
-        mCommandList->CopyResource(destination.mResource, source.mResource);
+        TrackedResourceState& trackedState = mTrackedStates[&resource];
+        trackedState.mState = resource.mState;
+        trackedState.mSubresourceStates = resource.mSubresourceStates;
     }
 
-    void Context::CopyBufferRegion(Resource& destination, uint64_t destOffset, Resource& source, uint64_t sourceOffset, uint64_t numBytes)
+    CommandRecorder* Context::ResolvePendingBarriers()
     {
-        mCommandList->CopyBufferRegion(destination.mResource, destOffset, source.mResource, sourceOffset, numBytes);
-    }
+        mResourceBarriers.clear();
 
-    void Context::CopyTextureRegion(Resource& destination, Resource& source, size_t sourceOffset, SubResourceLayouts& subResourceLayouts, uint32_t numSubResources)
-    {
-        for (uint32_t subResourceIndex = 0; subResourceIndex < numSubResources; subResourceIndex++)
+        auto addTransition = [this](Resource& resource, uint32_t subresource, D3D12_RESOURCE_STATES oldState, D3D12_RESOURCE_STATES newState)
         {
-            D3D12_TEXTURE_COPY_LOCATION destinationLocation = {};
-            destinationLocation.pResource = destination.mResource;
-            destinationLocation.Type = D3D12_TEXTURE_COPY_TYPE_SUBRESOURCE_INDEX;
-            destinationLocation.SubresourceIndex = subResourceIndex;
+            if (oldState == newState)
+            {
+                mBarrierStatistics.mNumBarriersElided++;
+                return;
+            }
 
-            D3D12_TEXTURE_COPY_LOCATION sourceLocation = {};
-            sourceLocation.pResource = source.mResource;
-            sourceLocation.Type = D3D12_TEXTURE_COPY_TYPE_PLACED_FOOTPRINT;
-            sourceLocation.PlacedFootprint = subResourceLayouts[subResourceIndex];
-            sourceLocation.PlacedFootprint.Offset += sourceOffset;
+            D3D12_RESOURCE_BARRIER& barrier = mResourceBarriers.emplace_back();
+            barrier.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
+            barrier.Flags = D3D12_RESOURCE_BARRIER_FLAG_NONE;
+            barrier.Transition.pResource = resource.mResource;
+            barrier.Transition.Subresource = subresource;
+            barrier.Transition.StateBefore = oldState;
+            barrier.Transition.StateAfter = newState;
+        };
+
+        for (const PendingBarrier& pendingBarrier : mPendingBarriers)
+        {
+            Resource& resource = *pendingBarrier.mResource;
+            const bool isTrackedPerSubresource = !resource.mSubresourceStates.empty();
 
-            mCommandList->CopyTextureRegion(&destinationLocation, 0, 0, 0, &sourceLocation, nullptr);
+            if (pendingBarrier.mSubresource == D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES && isTrackedPerSubresource)
+            {
+                for (uint32_t subresourceIndex = 0; subresourceIndex < resource.mSubresourceStates.size(); subresourceIndex++)
+                {
+                    addTransition(resource, subresourceIndex, resource.mSubresourceStates[subresourceIndex], pendingBarrier.mState);
+                }
+            }
+            else
+            {
+                addTransition(resource, pendingBarrier.mSubresource, isTrackedPerSubresource ? resource.mSubresourceStates[pendingBarrier.mSubresource] : resource.mState, pendingBarrier.mState);
+            }
         }
-    }
 
-    GraphicsContext::GraphicsContext(Device& device)
-        :Context(device, D3D12_COMMAND_LIST_TYPE_DIRECT)
-    {
-    }
+        mPendingBarriers.clear();
 
-    void GraphicsContext::SetDefaultViewPortAndScissor(Uint2 screenSize)
-    {
-        D3D12_VIEWPORT viewPort;
-        viewPort.Width = static_cast<float>(screenSize.x);
-        viewPort.Height = static_cast<float>(screenSize.y);
-        viewPort.MinDepth = 0.0f;
-        viewPort.MaxDepth = 1.0f;
-        viewPort.TopLeftX = 0;
-        viewPort.TopLeftY = 0;
+        //The next context submitted continues from the states this one leaves the resources in.
+        for (auto& [resource, trackedState] : mTrackedStates)
+        {
+            if (trackedState.mSubresourceStates.empty())
+            {
+                resource->mSubresourceStates.clear();
+                resource->mState = trackedState.mState;
+                continue;
+            }
 
-        D3D12_RECT scissor;
-        scissor.top = 0;
-        scissor.left = 0;
-        scissor.bottom = screenSize.y;
-        scissor.right = screenSize.x;
+            if (resource->mSubresourceStates.empty())
+            {
+                resource->mSubresourceStates.assign(trackedState.mSubresourceStates.size(), resource->mState);
+            }
 
-        SetViewport(viewPort);
-        SetScissorRect(scissor);
-    }
+            for (uint32_t subresourceIndex = 0; subresourceIndex < trackedState.mSubresourceStates.size(); subresourceIndex++)
+            {
+                if (trackedState.mSubresourceStates[subresourceIndex] != UNKNOWN_RESOURCE_STATE)
+                {
+                    resource->mSubresourceStates[subresourceIndex] = trackedState.mSubresourceStates[subresourceIndex];
+                }
+            }
 
-    void GraphicsContext::SetViewport(const D3D12_VIEWPORT& viewPort)
-    {
-        mCommandList->RSSetViewports(1, &viewPort);
+            const D3D12_RESOURCE_STATES firstState = resource->mSubresourceStates[0];
+
+            if (std::all_of(resource->mSubresourceStates.begin(), resource->mSubresourceStates.end(), [firstState](D3D12_RESOURCE_STATES state) { return state == firstState; }))
+            {
+                resource->mSubresourceStates.clear();
+                resource->mState = firstState;
+            }
+        }
+
+        mTrackedStates.clear();
+
+        if (mResourceBarriers.empty())
+        {
+            return nullptr;
+        }
+
+        if (!mPendingBarrierCommandRecorder)
+        {
+            mPendingBarrierCommandRecorder = mDevice.GetBackend().CreateCommandRecorder(mContextType);
+        }
+
+        mPendingBarrierCommandRecorder->Reset(mDevice.GetFrameId());
+        mPendingBarrierCommandRecorder->ResourceBarrier(static_cast<uint32_t>(mResourceBarriers.size()), mResourceBarriers.data());
+
+        mBarrierStatistics.mNumBarriersIssued += mResourceBarriers.size();
+        mBarrierStatistics.mNumBarrierBatches++;
+
+        return mPendingBarrierCommandRecorder.get();
+    }
+
+    void Context::QueueTransition(Resource& resource, uint32_t subresource, D3D12_RESOURCE_STATES oldState, D3D12_RESOURCE_STATES newState)
+    {
+        //If the most recent queued barrier for this resource is a plain transition of the same subresource, nothing can have
+        //used the resource in between, so fold the two transitions into one, or drop both if we end up where we started.
+        for (auto queuedBarrierIter = mQueuedBarriers.rbegin(); queuedBarrierIter != mQueuedBarriers.rend(); queuedBarrierIter++)
+        {
+            if (queuedBarrierIter->mResource != &resource)
+            {
+                continue;
+            }
+
+            D3D12_RESOURCE_BARRIER& queuedBarrier = queuedBarrierIter->mBarrier;
+
+            if (queuedBarrier.Type == D3D12_RESOURCE_BARRIER_TYPE_TRANSITION && queuedBarrier.Flags == D3D12_RESOURCE_BARRIER_FLAG_NONE &&
+                queuedBarrier.Transition.Subresource == subresource)
+            {
+                assert(queuedBarrier.Transition.StateAfter == oldState);
+
+                if (queuedBarrier.Transition.StateBefore == newState)
+                {
+                    mQueuedBarriers.erase(std::next(queuedBarrierIter).base());
+                    mBarrierStatistics.mNumBarriersElided += 2;
+                }
+                else
+                {
+                    queuedBarrier.Transition.StateAfter = newState;
+                    mBarrierStatistics.mNumBarriersElided++;
+                }
+
+                return;
+            }
+
+            break;
+        }
+
+        QueuedBarrier& queuedBarrier = mQueuedBarriers.emplace_back();
+        queuedBarrier.mResource = &resource;
+        queuedBarrier.mBarrier.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
+        queuedBarrier.mBarrier.Flags = D3D12_RESOURCE_BARRIER_FLAG_NONE;
+        queuedBarrier.mBarrier.Transition.pResource = resource.mResource;
+        queuedBarrier.mBarrier.Transition.Subresource = subresource;
+        queuedBarrier.mBarrier.Transition.StateBefore = oldState;
+        queuedBarrier.mBarrier.Transition.StateAfter = newState;
+    }
+
+    void Context::BeginSplitBarrier(Resource& resource, D3D12_RESOURCE_STATES newState)
+    {
+        TrackedResourceState& trackedState = mTrackedStates[&resource];
+        assert(trackedState.mSubresourceStates.empty());
+
+        //Without a known state there is nothing to split, the transition is made on submission ahead of this context.
+        if (trackedState.mState == UNKNOWN_RESOURCE_STATE)
+        {
+            AddBarrier(resource, newState);
+            return;
+        }
+
+        if (trackedState.mState == newState)
+        {
+            mBarrierStatistics.mNumBarriersElided++;
+            return;
+        }
+
+        QueuedBarrier splitBarrier;
+        splitBarrier.mResource = &resource;
+        splitBarrier.mBarrier.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
+        splitBarrier.mBarrier.Flags = D3D12_RESOURCE_BARRIER_FLAG_BEGIN_ONLY;
+        splitBarrier.mBarrier.Transition.pResource = resource.mResource;
+        splitBarrier.mBarrier.Transition.Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
+        splitBarrier.mBarrier.Transition.StateBefore = trackedState.mState;
+        splitBarrier.mBarrier.Transition.StateAfter = newState;
+
+        mQueuedBarriers.push_back(splitBarrier);
+        mPendingSplitBarriers.push_back(splitBarrier);
+    }
+
+    void Context::EndSplitBarrier(Resource& resource)
+    {
+        auto splitBarrierIter = std::find_if(mPendingSplitBarriers.begin(), mPendingSplitBarriers.end(), [&resource](const QueuedBarrier& splitBarrier) { return splitBarrier.mResource == &resource; });
+
+        //Nothing to end when the begin was already in the right state.
+        if (splitBarrierIter == mPendingSplitBarriers.end())
+        {
+            return;
+        }
+
+        QueuedBarrier& queuedBarrier = mQueuedBarriers.emplace_back(*splitBarrierIter);
+        queuedBarrier.mBarrier.Flags = D3D12_RESOURCE_BARRIER_FLAG_END_ONLY;
+
+        mTrackedStates[&resource].mState = splitBarrierIter->mBarrier.Transition.StateAfter;
+        mPendingSplitBarriers.erase(splitBarrierIter);
+    }
+
+    void Context::FlushBarriers()
+    {
+        if (mQueuedBarriers.size() > 0)
+        {
+            mResourceBarriers.clear();
+
+            for (const QueuedBarrier& queuedBarrier : mQueuedBarriers)
+            {
+                mResourceBarriers.push_back(queuedBarrier.mBarrier);
+            }
+
+            mCommandRecorder->ResourceBarrier(static_cast<uint32_t>(mResourceBarriers.size()), mResourceBarriers.data());
+
+            mBarrierStatistics.mNumBarriersIssued += mResourceBarriers.size();
+            mBarrierStatistics.mNumBarrierBatches++;
+            mQueuedBarriers.clear();
+        }
+    }
+
+    void Context::BindDescriptorHeaps(uint32_t frameIndex)
+    {
+        mCurrentSRVHeap = &mDevice.GetSRVHeap(frameIndex);
+        mDescriptorRangeSize = 0;
+        mDescriptorRangeUsed = 0;
+
+        ID3D12DescriptorHeap* heapsToBind[2];
+        heapsToBind[0] = mDevice.GetSRVHeap(frameIndex).GetHeap();
+        heapsToBind[1] = mDevice.GetSamplerHeap().GetHeap();
+
+        mCommandRecorder->SetDescriptorHeaps(2, heapsToBind);
+    }
+
+    Descriptor Context::AllocateDescriptorBlock(uint32_t count)
+    {
+        //Grab descriptors from the shared heap a chunk at a time, so contexts recording on different threads only meet
+        //on a single atomic per chunk.
+        if (mDescriptorRangeUsed + count > mDescriptorRangeSize)
+        {
+            mDescriptorRangeSize = (std::max)(count, RENDER_PASS_DESCRIPTOR_CHUNK_SIZE);
+            mDescriptorRangeStart = mCurrentSRVHeap->AllocateUserDescriptorBlock(mDescriptorRangeSize);
+            mDescriptorRangeUsed = 0;
+
+            //Near the end of the heap a whole chunk may not fit where the block itself still does.
+            if (!mDescriptorRangeStart.IsValid() && mDescriptorRangeSize > count)
+            {
+                mDescriptorRangeSize = count;
+                mDescriptorRangeStart = mCurrentSRVHeap->AllocateUserDescriptorBlock(mDescriptorRangeSize);
+            }
+
+            if (!mDescriptorRangeStart.IsValid())
+            {
+                mDescriptorRangeSize = 0;
+                return Descriptor{};
+            }
+        }
+
+        const uint32_t descriptorSize = mCurrentSRVHeap->GetDescriptorSize();
+
+        Descriptor blockStart = mDescriptorRangeStart;
+        blockStart.mHeapIndex += mDescriptorRangeUsed;
+        blockStart.mCPUHandle.ptr += static_cast<uint64_t>(mDescriptorRangeUsed) * descriptorSize;
+        blockStart.mGPUHandle.ptr += static_cast<uint64_t>(mDescriptorRangeUsed) * descriptorSize;
+
+        mDescriptorRangeUsed += count;
+
+        return blockStart;
+    }
+
+    void Context::CopyResource(const Resource& destination, const Resource& source)
+    {
+        mCommandRecorder->CopyResource(destination, source);
+    }
+
+    void Context::CopyBufferRegion(Resource& destination, uint64_t destOffset, Resource& source, uint64_t sourceOffset, uint64_t numBytes)
+    {
+        mCommandRecorder->CopyBufferRegion(destination, destOffset, source, sourceOffset, numBytes);
+    }
+
+    void Context::CopyTextureRegion(Resource& destination, Resource& source, size_t sourceOffset, SubResourceLayouts& subResourceLayouts, uint32_t numSubResources, uint32_t firstSubResource)
+    {
+        //sourceOffset is where firstSubResource starts in the source, the others keep their layout offsets relative to it.
+        const uint64_t firstSubResourceOffset = subResourceLayouts[firstSubResource].Offset;
+
+        for (uint32_t subResourceIndex = firstSubResource; subResourceIndex < firstSubResource + numSubResources; subResourceIndex++)
+        {
+            D3D12_TEXTURE_COPY_LOCATION destinationLocation = {};
+            destinationLocation.pResource = destination.mResource;
+            destinationLocation.Type = D3D12_TEXTURE_COPY_TYPE_SUBRESOURCE_INDEX;
+            destinationLocation.SubresourceIndex = subResourceIndex;
+
+            D3D12_TEXTURE_COPY_LOCATION sourceLocation = {};
+            sourceLocation.pResource = source.mResource;
+            sourceLocation.Type = D3D12_TEXTURE_COPY_TYPE_PLACED_FOOTPRINT;
+            sourceLocation.PlacedFootprint = subResourceLayouts[subResourceIndex];
+            sourceLocation.PlacedFootprint.Offset = sourceLocation.PlacedFootprint.Offset - firstSubResourceOffset + sourceOffset;
+
+            mCommandRecorder->CopyTextureRegion(destinationLocation, 0, 0, 0, sourceLocation, nullptr);
+        }
+    }
+
+    GraphicsContext::GraphicsContext(Device& device)
+        :Context(device, D3D12_COMMAND_LIST_TYPE_DIRECT)
+    {
+    }
+
+    void GraphicsContext::SetDefaultViewPortAndScissor(Uint2 screenSize)
+    {
+        D3D12_VIEWPORT viewPort;
+        viewPort.Width = static_cast<float>(screenSize.x);
+        viewPort.Height = static_cast<float>(screenSize.y);
+        viewPort.MinDepth = 0.0f;
+        viewPort.MaxDepth = 1.0f;
+        viewPort.TopLeftX = 0;
+        viewPort.TopLeftY = 0;
+
+        D3D12_RECT scissor;
+        scissor.top = 0;
+        scissor.left = 0;
+        scissor.bottom = screenSize.y;
+        scissor.right = screenSize.x;
+
+        SetViewport(viewPort);
+        SetScissorRect(scissor);
+    }
+
+    void GraphicsContext::SetViewport(const D3D12_VIEWPORT& viewPort)
+    {
+        if (SkipIfBound(mBoundState.mIsViewportBound && memcmp(&mBoundState.mViewport, &viewPort, sizeof(viewPort)) == 0))
+        {
+            return;
+        }
+
+        mCommandRecorder->RSSetViewports(1, &viewPort);
+        mBoundState.mViewport = viewPort;
+        mBoundState.mIsViewportBound = true;
     }
 
     void GraphicsContext::SetScissorRect(const D3D12_RECT& rect)
     {
-        mCommandList->RSSetScissorRects(1, &rect);
+        if (SkipIfBound(mBoundState.mIsScissorRectBound && memcmp(&mBoundState.mScissorRect, &rect, sizeof(rect)) == 0))
+        {
+            return;
+        }
+
+        mCommandRecorder->RSSetScissorRects(1, &rect);
+        mBoundState.mScissorRect = rect;
+        mBoundState.mIsScissorRectBound = true;
     }
 
     void GraphicsContext::SetStencilRef(uint32_t stencilRef)
     {
-        mCommandList->OMSetStencilRef(stencilRef);
+        mCommandRecorder->OMSetStencilRef(stencilRef);
     }
 
     void GraphicsContext::SetBlendFactor(Color blendFactor)
     {
         float color[4] = { blendFactor.R(), blendFactor.G(), blendFactor.B(), blendFactor.A() };
-        mCommandList->OMSetBlendFactor(color);
+        mCommandRecorder->OMSetBlendFactor(color);
     }
 
     void GraphicsContext::SetPrimitiveTopology(D3D12_PRIMITIVE_TOPOLOGY topology)
     {
-        mCommandList->IASetPrimitiveTopology(topology);
+        if (SkipIfBound(mBoundState.mPrimitiveTopology == topology))
+        {
+            return;
+        }
+
+        mCommandRecorder->IASetPrimitiveTopology(topology);
+        mBoundState.mPrimitiveTopology = topology;
     }
 
     void GraphicsContext::SetPipeline(const PipelineInfo& pipelineBinding)
@@ -541,15 +1098,35 @@ namespace D3D12Lite
 
         if (!pipelineExpectedBoundExternally)
         {
-            if (pipelineBinding.mPipeline->mPipelineType == PipelineType::compute)
+            PipelineStateObject* pipeline = pipelineBinding.mPipeline;
+            PipelineStateObject* boundPipeline = mBoundState.mPipeline;
+
+            //Pipelines created from identical descs share their native pipeline state.
+            const bool isPipelineStateBound = boundPipeline && (pipeline == boundPipeline || (pipeline->mPipeline && pipeline->mPipeline == boundPipeline->mPipeline));
+
+            if (!SkipIfBound(isPipelineStateBound))
             {
-                mCommandList->SetPipelineState(pipelineBinding.mPipeline->mPipeline);
-                mCommandList->SetComputeRootSignature(pipelineBinding.mPipeline->mRootSignature);
+                mCommandRecorder->SetPipelineState(pipeline->mPipeline);
+                mBoundState.mPipeline = pipeline;
             }
-            else
+
+            BoundRootArguments& rootArguments = mBoundState.mRootArguments[static_cast<uint32_t>(pipeline->mPipelineType)];
+            const uint32_t rootSignatureId = pipeline->mPipelineResourceMapping.mRootSignatureId;
+
+            if (!SkipIfBound(rootSignatureId != 0 && rootSignatureId == rootArguments.mRootSignatureId))
             {
-                mCommandList->SetPipelineState(pipelineBinding.mPipeline->mPipeline);
-                mCommandList->SetGraphicsRootSignature(pipelineBinding.mPipeline->mRootSignature);
+                if (pipeline->mPipelineType == PipelineType::compute)
+                {
+                    mCommandRecorder->SetComputeRootSignature(pipeline->mRootSignature);
+                }
+                else
+                {
+                    mCommandRecorder->SetGraphicsRootSignature(pipeline->mRootSignature);
+                }
+
+                //Setting a root signature clears the root arguments, so they have to be set again even where they match.
+                rootArguments = BoundRootArguments{};
+                rootArguments.mRootSignatureId = rootSignatureId;
             }
         }
 
@@ -581,34 +1158,22 @@ namespace D3D12Lite
         assert(mCurrentPipeline);
         assert(resources.IsLocked());
 
-        static const uint32_t maxNumHandlesPerBinding = 16;
-        static const uint32_t singleDescriptorRangeCopyArray[maxNumHandlesPerBinding]{ 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1 ,1 };
+        static const uint32_t singleDescriptorRangeCopyArray[MAX_DESCRIPTORS_PER_TABLE]{ 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1 ,1 };
         
-        const BufferResource* cbv = resources.GetCBV();
+        const D3D12_GPU_VIRTUAL_ADDRESS cbvAddress = resources.GetCBVAddress();
         const auto& uavs = resources.GetUAVs();
         const auto& srvs = resources.GetSRVs();
         const uint32_t numTableHandles = static_cast<uint32_t>(uavs.size() + srvs.size());
-        D3D12_CPU_DESCRIPTOR_HANDLE handles[maxNumHandlesPerBinding]{};
+        D3D12_CPU_DESCRIPTOR_HANDLE handles[MAX_DESCRIPTORS_PER_TABLE]{};
         uint32_t currentHandleIndex = 0;
-        assert(numTableHandles <= maxNumHandlesPerBinding);
+        assert(numTableHandles <= MAX_DESCRIPTORS_PER_TABLE);
 
-        if(cbv)
+        if(cbvAddress != 0)
         {
             auto& cbvMapping = mCurrentPipeline->mPipelineResourceMapping.mCbvMapping[spaceId];
             assert(cbvMapping.has_value());
 
-            switch (mCurrentPipeline->mPipelineType)
-            {
-            case PipelineType::graphics:
-                mCommandList->SetGraphicsRootConstantBufferView(cbvMapping.value(), cbv->mVirtualAddress);
-                break;
-            case PipelineType::compute:
-                mCommandList->SetComputeRootConstantBufferView(cbvMapping.value(), cbv->mVirtualAddress);
-                break;
-            default:
-                assert(false);
-                break;
-            }
+            SetRootConstantBufferView(cbvMapping.value(), cbvAddress);
         }
 
         if (numTableHandles == 0)
@@ -640,29 +1205,156 @@ namespace D3D12Lite
             }
         }
 
-        Descriptor blockStart = mCurrentSRVHeap->AllocateUserDescriptorBlock(numTableHandles);
-        mDevice.CopyDescriptors(1, &blockStart.mCPUHandle, &numTableHandles, numTableHandles, handles, singleDescriptorRangeCopyArray, D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+        //Staging descriptors aren't freed or rewritten while a command list that may reference them is being recorded,
+        //so the same handles still mean the same descriptors and the block they were copied to last can be used again.
+        BoundDescriptorTable& boundTable = mBoundState.mDescriptorTables[spaceId];
+        const bool isTableCopied = boundTable.mBlockStart.ptr != 0 && boundTable.mNumHandles == numTableHandles &&
+                                   memcmp(boundTable.mHandles.data(), handles, numTableHandles * sizeof(D3D12_CPU_DESCRIPTOR_HANDLE)) == 0;
+
+        if (isTableCopied)
+        {
+            mStateFilterStatistics.mNumDescriptorTablesReused++;
+        }
+        else
+        {
+            Descriptor blockStart = AllocateDescriptorBlock(numTableHandles);
+            if (!blockStart.IsValid())
+            {
+                return;
+            }
+
+            mDevice.CopyDescriptors(1, &blockStart.mCPUHandle, &numTableHandles, numTableHandles, handles, singleDescriptorRangeCopyArray, D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+
+            std::copy(handles, handles + numTableHandles, boundTable.mHandles.begin());
+            boundTable.mNumHandles = numTableHandles;
+            boundTable.mBlockStart = blockStart.mGPUHandle;
+        }
 
         auto& tableMapping = mCurrentPipeline->mPipelineResourceMapping.mTableMapping[spaceId];
         assert(tableMapping.has_value());
 
+        SetRootDescriptorTable(tableMapping.value(), boundTable.mBlockStart);
+    }
+
+    void GraphicsContext::InvalidateState()
+    {
+        mBoundState = BoundState{};
+    }
+
+    bool GraphicsContext::SkipIfBound(bool isBound)
+    {
+        if (isBound)
+        {
+            mStateFilterStatistics.mNumStateCallsSkipped++;
+        }
+        else
+        {
+            mStateFilterStatistics.mNumStateCallsIssued++;
+        }
+
+        return isBound;
+    }
+
+    void GraphicsContext::SetTargets(uint32_t numRenderTargets, const D3D12_CPU_DESCRIPTOR_HANDLE renderTargets[], D3D12_CPU_DESCRIPTOR_HANDLE depthStencil)
+    {
+        bool areTargetsBound = mBoundState.mAreTargetsBound && mBoundState.mNumRenderTargets == numRenderTargets && mBoundState.mDepthStencil.ptr == depthStencil.ptr;
+
+        for (uint32_t targetIndex = 0; targetIndex < numRenderTargets && areTargetsBound; targetIndex++)
+        {
+            areTargetsBound = mBoundState.mRenderTargets[targetIndex].ptr == renderTargets[targetIndex].ptr;
+        }
+
+        if (SkipIfBound(areTargetsBound))
+        {
+            return;
+        }
+
+        mCommandRecorder->OMSetRenderTargets(numRenderTargets, renderTargets, depthStencil.ptr != 0 ? &depthStencil : nullptr);
+
+        std::copy(renderTargets, renderTargets + numRenderTargets, mBoundState.mRenderTargets.begin());
+        mBoundState.mNumRenderTargets = numRenderTargets;
+        mBoundState.mDepthStencil = depthStencil;
+        mBoundState.mAreTargetsBound = true;
+    }
+
+    void GraphicsContext::SetIndexBufferView(const D3D12_INDEX_BUFFER_VIEW* indexBufferView)
+    {
+        //No index buffer is bound as an empty view.
+        const D3D12_INDEX_BUFFER_VIEW indexBuffer = indexBufferView ? *indexBufferView : D3D12_INDEX_BUFFER_VIEW{};
+
+        if (SkipIfBound(mBoundState.mIsIndexBufferBound && memcmp(&mBoundState.mIndexBuffer, &indexBuffer, sizeof(indexBuffer)) == 0))
+        {
+            return;
+        }
+
+        mCommandRecorder->IASetIndexBuffer(indexBufferView);
+        mBoundState.mIndexBuffer = indexBuffer;
+        mBoundState.mIsIndexBufferBound = true;
+    }
+
+    void GraphicsContext::SetRootConstantBufferView(uint32_t rootParameter, D3D12_GPU_VIRTUAL_ADDRESS address)
+    {
+        assert(rootParameter < MAX_ROOT_PARAMETERS);
+
+        BoundRootArguments& rootArguments = mBoundState.mRootArguments[static_cast<uint32_t>(mCurrentPipeline->mPipelineType)];
+
+        if (SkipIfBound(rootArguments.mConstantBuffers[rootParameter] == address))
+        {
+            return;
+        }
+
         switch (mCurrentPipeline->mPipelineType)
         {
         case PipelineType::graphics:
-            mCommandList->SetGraphicsRootDescriptorTable(tableMapping.value(), blockStart.mGPUHandle);
+            mCommandRecorder->SetGraphicsRootConstantBufferView(rootParameter, address);
             break;
         case PipelineType::compute:
-            mCommandList->SetComputeRootDescriptorTable(tableMapping.value(), blockStart.mGPUHandle);
+            mCommandRecorder->SetComputeRootConstantBufferView(rootParameter, address);
             break;
         default:
             assert(false);
             break;
         }
+
+        rootArguments.mConstantBuffers[rootParameter] = address;
     }
 
-    void GraphicsContext::SetTargets(uint32_t numRenderTargets, const D3D12_CPU_DESCRIPTOR_HANDLE renderTargets[], D3D12_CPU_DESCRIPTOR_HANDLE depthStencil)
+    void GraphicsContext::SetRootDescriptorTable(uint32_t rootParameter, D3D12_GPU_DESCRIPTOR_HANDLE blockStart)
+    {
+        assert(rootParameter < MAX_ROOT_PARAMETERS);
+
+        BoundRootArguments& rootArguments = mBoundState.mRootArguments[static_cast<uint32_t>(mCurrentPipeline->mPipelineType)];
+
+        if (SkipIfBound(rootArguments.mDescriptorTables[rootParameter].ptr == blockStart.ptr))
+        {
+            return;
+        }
+
+        switch (mCurrentPipeline->mPipelineType)
+        {
+        case PipelineType::graphics:
+            mCommandRecorder->SetGraphicsRootDescriptorTable(rootParameter, blockStart);
+            break;
+        case PipelineType::compute:
+            mCommandRecorder->SetComputeRootDescriptorTable(rootParameter, blockStart);
+            break;
+        default:
+            assert(false);
+            break;
+        }
+
+        rootArguments.mDescriptorTables[rootParameter] = blockStart;
+    }
+
+    void GraphicsContext::SetConstantBuffer(uint32_t spaceId, const TransientConstantBuffer& constantBuffer)
     {
-        mCommandList->OMSetRenderTargets(numRenderTargets, renderTargets, false, depthStencil.ptr != 0 ? &depthStencil : nullptr);
+        assert(mCurrentPipeline);
+        assert(constantBuffer.IsValid());
+
+        auto& cbvMapping = mCurrentPipeline->mPipelineResourceMapping.mCbvMapping[spaceId];
+        assert(cbvMapping.has_value());
+
+        SetRootConstantBufferView(cbvMapping.value(), constantBuffer.mVirtualAddress);
     }
 
     void GraphicsContext::SetIndexBuffer(const BufferResource& indexBuffer)
@@ -670,25 +1362,25 @@ namespace D3D12Lite
         D3D12_INDEX_BUFFER_VIEW indexBufferView;
         indexBufferView.Format = indexBuffer.mStride == 4 ? DXGI_FORMAT_R32_UINT : indexBuffer.mStride == 2 ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_UNKNOWN;
         indexBufferView.SizeInBytes = static_cast<uint32_t>(indexBuffer.mDesc.Width);
-        indexBufferView.BufferLocation = indexBuffer.mResource->GetGPUVirtualAddress();
+        indexBufferView.BufferLocation = indexBuffer.mVirtualAddress;
 
-        mCommandList->IASetIndexBuffer(&indexBufferView);
+        SetIndexBufferView(&indexBufferView);
     }
 
     void GraphicsContext::ClearRenderTarget(const TextureResource& target, Color color)
     {
-        mCommandList->ClearRenderTargetView(target.mRTVDescriptor.mCPUHandle, color, 0, nullptr);
+        mCommandRecorder->ClearRenderTargetView(target.mRTVDescriptor.mCPUHandle, color);
     }
 
     void GraphicsContext::ClearDepthStencilTarget(const TextureResource& target, float depth, uint8_t stencil)
     {
-        mCommandList->ClearDepthStencilView(target.mDSVDescriptor.mCPUHandle, D3D12_CLEAR_FLAG_DEPTH | D3D12_CLEAR_FLAG_STENCIL, depth, stencil, 0, nullptr);
+        mCommandRecorder->ClearDepthStencilView(target.mDSVDescriptor.mCPUHandle, D3D12_CLEAR_FLAG_DEPTH | D3D12_CLEAR_FLAG_STENCIL, depth, stencil);
     }
 
     void GraphicsContext::DrawFullScreenTriangle()
     {
         SetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);
-        mCommandList->IASetIndexBuffer(nullptr);
+        SetIndexBufferView(nullptr);
         Draw(3);
     }
 
@@ -704,17 +1396,17 @@ namespace D3D12Lite
 
     void GraphicsContext::DrawInstanced(uint32_t vertexCountPerInstance, uint32_t instanceCount, uint32_t startVertexLocation, uint32_t startInstanceLocation)
     {
-        mCommandList->DrawInstanced(vertexCountPerInstance, instanceCount, startVertexLocation, startInstanceLocation);
+        mCommandRecorder->DrawInstanced(vertexCountPerInstance, instanceCount, startVertexLocation, startInstanceLocation);
     }
 
     void GraphicsContext::DrawIndexedInstanced(uint32_t indexCountPerInstance, uint32_t instanceCount, uint32_t startIndexLocation, uint32_t baseVertexLocation, uint32_t startInstanceLocation)
     {
-        mCommandList->DrawIndexedInstanced(indexCountPerInstance, instanceCount, startIndexLocation, baseVertexLocation, startInstanceLocation);
+        mCommandRecorder->DrawIndexedInstanced(indexCountPerInstance, instanceCount, startIndexLocation, baseVertexLocation, startInstanceLocation);
     }
 
     void GraphicsContext::Dispatch(uint32_t groupCountX, uint32_t groupCountY, uint32_t groupCountZ)
     {
-        mCommandList->Dispatch(groupCountX, groupCountY, groupCountZ);
+        mCommandRecorder->Dispatch(groupCountX, groupCountY, groupCountZ);
     }
 
     void GraphicsContext::Dispatch1D(uint32_t threadCountX, uint32_t groupSizeX)
@@ -742,8 +1434,8 @@ namespace D3D12Lite
     {
         assert(pipelineBinding.mPipeline && pipelineBinding.mPipeline->mPipelineType == PipelineType::compute);
 
-        mCommandList->SetPipelineState(pipelineBinding.mPipeline->mPipeline);
-        mCommandList->SetComputeRootSignature(pipelineBinding.mPipeline->mRootSignature);
+        mCommandRecorder->SetPipelineState(pipelineBinding.mPipeline->mPipeline);
+        mCommandRecorder->SetComputeRootSignature(pipelineBinding.mPipeline->mRootSignature);
 
         mCurrentPipeline = pipelineBinding.mPipeline;
     }
@@ -756,7 +1448,7 @@ namespace D3D12Lite
         static const uint32_t maxNumHandlesPerBinding = 16;
         static const uint32_t singleDescriptorRangeCopyArray[maxNumHandlesPerBinding]{ 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1 ,1 };
 
-        const BufferResource* cbv = resources.GetCBV();
+        const D3D12_GPU_VIRTUAL_ADDRESS cbvAddress = resources.GetCBVAddress();
         const auto& uavs = resources.GetUAVs();
         const auto& srvs = resources.GetSRVs();
         const uint32_t numTableHandles = static_cast<uint32_t>(uavs.size() + srvs.size());
@@ -765,12 +1457,12 @@ namespace D3D12Lite
 
         assert(numTableHandles <= maxNumHandlesPerBinding);
 
-        if(cbv)
+        if(cbvAddress != 0)
         {
             auto& cbvMapping = mCurrentPipeline->mPipelineResourceMapping.mCbvMapping[spaceId];
             assert(cbvMapping.has_value());
 
-            mCommandList->SetComputeRootConstantBufferView(cbvMapping.value(), cbv->mVirtualAddress);
+            mCommandRecorder->SetComputeRootConstantBufferView(cbvMapping.value(), cbvAddress);
         }
 
         if (numTableHandles == 0)
@@ -802,18 +1494,34 @@ namespace D3D12Lite
             }
         }
 
-        Descriptor blockStart = mCurrentSRVHeap->AllocateUserDescriptorBlock(numTableHandles);
+        Descriptor blockStart = AllocateDescriptorBlock(numTableHandles);
+        if (!blockStart.IsValid())
+        {
+            return;
+        }
+
         mDevice.CopyDescriptors(1, &blockStart.mCPUHandle, &numTableHandles, numTableHandles, handles, singleDescriptorRangeCopyArray, D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
 
         auto& tableMapping = mCurrentPipeline->mPipelineResourceMapping.mTableMapping[spaceId];
         assert(tableMapping.has_value());
 
-        mCommandList->SetComputeRootDescriptorTable(tableMapping.value(), blockStart.mGPUHandle);
+        mCommandRecorder->SetComputeRootDescriptorTable(tableMapping.value(), blockStart.mGPUHandle);
+    }
+
+    void ComputeContext::SetConstantBuffer(uint32_t spaceId, const TransientConstantBuffer& constantBuffer)
+    {
+        assert(mCurrentPipeline);
+        assert(constantBuffer.IsValid());
+
+        auto& cbvMapping = mCurrentPipeline->mPipelineResourceMapping.mCbvMapping[spaceId];
+        assert(cbvMapping.has_value());
+
+        mCommandRecorder->SetComputeRootConstantBufferView(cbvMapping.value(), constantBuffer.mVirtualAddress);
     }
 
     void ComputeContext::Dispatch(uint32_t groupCountX, uint32_t groupCountY, uint32_t groupCountZ)
     {
-        mCommandList->Dispatch(groupCountX, groupCountY, groupCountZ);
+        mCommandRecorder->Dispatch(groupCountX, groupCountY, groupCountZ);
     }
 
     void ComputeContext::Dispatch1D(uint32_t threadCountX, uint32_t groupSizeX)
@@ -826,143 +1534,644 @@ namespace D3D12Lite
         Dispatch(GetGroupCount(threadCountX, groupSizeX), GetGroupCount(threadCountY, groupSizeY), 1);
     }
 
-    void ComputeContext::Dispatch3D(uint32_t threadCountX, uint32_t threadCountY, uint32_t threadCountZ, uint32_t groupSizeX, uint32_t groupSizeY, uint32_t groupSizeZ)
-    {
-        Dispatch(GetGroupCount(threadCountX, groupSizeX), GetGroupCount(threadCountY, groupSizeY), GetGroupCount(threadCountZ, groupSizeZ));
-    }
+    void ComputeContext::Dispatch3D(uint32_t threadCountX, uint32_t threadCountY, uint32_t threadCountZ, uint32_t groupSizeX, uint32_t groupSizeY, uint32_t groupSizeZ)
+    {
+        Dispatch(GetGroupCount(threadCountX, groupSizeX), GetGroupCount(threadCountY, groupSizeY), GetGroupCount(threadCountZ, groupSizeZ));
+    }
+
+
+    std::future<void> UploadQueue::AddBufferUpload(std::unique_ptr<BufferUpload> bufferUpload)
+    {
+        std::future<void> completion = bufferUpload->mCompletion.get_future();
+
+        std::lock_guard<std::mutex> lockGuard(mQueueMutex);
+        mBufferUploads[static_cast<uint32_t>(bufferUpload->mPriority)].push_back(std::move(bufferUpload));
+
+        return completion;
+    }
+
+#ifdef _WIN32
+    MappedFile::~MappedFile()
+    {
+        if (mData)
+        {
+            UnmapViewOfFile(mData);
+        }
+
+        if (mMappingHandle)
+        {
+            CloseHandle(mMappingHandle);
+        }
+
+        if (mFileHandle != INVALID_HANDLE_VALUE)
+        {
+            CloseHandle(mFileHandle);
+        }
+    }
+
+    bool MappedFile::Open(const wchar_t* filePath)
+    {
+        assert(mData == nullptr);
+
+        mFileHandle = CreateFileW(filePath, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (mFileHandle == INVALID_HANDLE_VALUE)
+        {
+            return false;
+        }
+
+        LARGE_INTEGER fileSize{};
+        if (!GetFileSizeEx(mFileHandle, &fileSize) || fileSize.QuadPart == 0)
+        {
+            return false;
+        }
+
+        mMappingHandle = CreateFileMappingW(mFileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (!mMappingHandle)
+        {
+            return false;
+        }
+
+        mData = static_cast<const uint8_t*>(MapViewOfFile(mMappingHandle, FILE_MAP_READ, 0, 0, 0));
+        mSize = mData ? static_cast<size_t>(fileSize.QuadPart) : 0;
+
+        return mData != nullptr;
+    }
+#else
+    MappedFile::~MappedFile()
+    {
+        if (mData)
+        {
+            munmap(const_cast<uint8_t*>(mData), mSize);
+        }
+
+        if (mFileDescriptor != -1)
+        {
+            close(mFileDescriptor);
+        }
+    }
+
+    bool MappedFile::Open(const wchar_t* filePath)
+    {
+        assert(mData == nullptr);
+
+        mFileDescriptor = open(std::filesystem::path(filePath).c_str(), O_RDONLY);
+        if (mFileDescriptor == -1)
+        {
+            return false;
+        }
+
+        struct stat fileStatus{};
+        if (fstat(mFileDescriptor, &fileStatus) != 0 || fileStatus.st_size == 0)
+        {
+            return false;
+        }
+
+        void* data = mmap(nullptr, static_cast<size_t>(fileStatus.st_size), PROT_READ, MAP_PRIVATE, mFileDescriptor, 0);
+        if (data == MAP_FAILED)
+        {
+            return false;
+        }
+
+        mData = static_cast<const uint8_t*>(data);
+        mSize = static_cast<size_t>(fileStatus.st_size);
+
+        return true;
+    }
+#endif
+
+    TextureFileData LoadTextureFileData(const std::string& texturePath)
+    {
+        //Narrow paths are in the active code page, same as std::filesystem reads them.
+        const std::wstring widePath = std::filesystem::path(texturePath).wstring();
+        DirectX::TexMetadata textureMetaData{};
+        std::vector<DirectX::Image> sourceImages;
+        TextureFileData fileData;
+
+        //DDS data that needs no conversion is staged straight out of a mapping of the file, so the only copy is the
+        //one into the upload heap.
+        auto mappedFile = std::make_shared<MappedFile>();
+        if (mappedFile->Open(widePath.c_str()))
+        {
+            size_t numImages = 0;
+            if (SUCCEEDED(DirectX::GetImagesFromDDSMemory(mappedFile->GetData(), mappedFile->GetSize(), DirectX::DDS_FLAGS_NONE, textureMetaData, nullptr, numImages)))
+            {
+                sourceImages.resize(numImages);
+                if (SUCCEEDED(DirectX::GetImagesFromDDSMemory(mappedFile->GetData(), mappedFile->GetSize(), DirectX::DDS_FLAGS_NONE, textureMetaData, sourceImages.data(), numImages)))
+                {
+                    fileData.mSourceOwner = mappedFile;
+                }
+            }
+        }
+
+        if (!fileData.mSourceOwner)
+        {
+            auto imageData = std::make_shared<DirectX::ScratchImage>();
+            HRESULT loadResult = DirectX::LoadFromDDSFile(widePath.c_str(), DirectX::DDS_FLAGS_NONE, nullptr, *imageData);
+            assert(loadResult == S_OK);
+
+            textureMetaData = imageData->GetMetadata();
+            sourceImages.assign(imageData->GetImages(), imageData->GetImages() + imageData->GetImageCount());
+            fileData.mSourceOwner = imageData;
+        }
+
+        bool is3DTexture = textureMetaData.dimension == DirectX::TEX_DIMENSION_TEXTURE3D;
+
+        D3D12_RESOURCE_DESC& resourceDesc = fileData.mResourceDesc;
+        resourceDesc.Format = textureMetaData.format;
+        resourceDesc.Width = textureMetaData.width;
+        resourceDesc.Height = static_cast<UINT>(textureMetaData.height);
+        resourceDesc.Flags = D3D12_RESOURCE_FLAG_NONE;
+        resourceDesc.DepthOrArraySize = static_cast<UINT16>(is3DTexture ? textureMetaData.depth : textureMetaData.arraySize);
+        resourceDesc.MipLevels = static_cast<UINT16>(textureMetaData.mipLevels);
+        resourceDesc.SampleDesc.Count = 1;
+        resourceDesc.SampleDesc.Quality = 0;
+        resourceDesc.Dimension = is3DTexture ? D3D12_RESOURCE_DIMENSION_TEXTURE3D : D3D12_RESOURCE_DIMENSION_TEXTURE2D;
+        resourceDesc.Layout = D3D12_TEXTURE_LAYOUT_UNKNOWN;
+        resourceDesc.Alignment = 0;
+
+        const size_t numSubResources = textureMetaData.mipLevels * textureMetaData.arraySize;
+        fileData.mSubResourceSources.resize(numSubResources);
+
+        size_t imageIndex = 0;
+        for (size_t subResourceIndex = 0; subResourceIndex < numSubResources; subResourceIndex++)
+        {
+            const DirectX::Image& sourceImage = sourceImages[imageIndex];
+            TextureUploadSource& subResourceSource = fileData.mSubResourceSources[subResourceIndex];
+
+            subResourceSource.mPixels = sourceImage.pixels;
+            subResourceSource.mRowPitch = sourceImage.rowPitch;
+            subResourceSource.mSlicePitch = sourceImage.slicePitch;
+
+            //Images are ordered the same way as subresources, volume textures just have one image per depth slice.
+            imageIndex += is3DTexture ? (std::max)(textureMetaData.depth >> (subResourceIndex % textureMetaData.mipLevels), size_t(1)) : 1;
+        }
+
+        return fileData;
+    }
+
+    std::future<void> UploadQueue::AddTextureUpload(std::unique_ptr<TextureUpload> textureUpload)
+    {
+        std::future<void> completion = textureUpload->mCompletion.get_future();
+
+        std::lock_guard<std::mutex> lockGuard(mQueueMutex);
+        mTextureUploads[static_cast<uint32_t>(textureUpload->mPriority)].push_back(std::move(textureUpload));
+
+        return completion;
+    }
+
+    size_t UploadQueue::GetNumPendingUploads()
+    {
+        std::lock_guard<std::mutex> lockGuard(mQueueMutex);
+
+        size_t numPendingUploads = 0;
+        for (uint32_t priorityIndex = 0; priorityIndex < NUM_UPLOAD_PRIORITIES; priorityIndex++)
+        {
+            numPendingUploads += mBufferUploads[priorityIndex].size() + mTextureUploads[priorityIndex].size();
+        }
+
+        return numPendingUploads;
+    }
+
+    UploadContext::UploadContext(Device& device, std::unique_ptr<BufferResource> bufferUploadHeap, std::unique_ptr<BufferResource> textureUploadHeap)
+        :Context(device, D3D12_COMMAND_LIST_TYPE_COPY)
+        , mBufferUploadHeap(std::move(bufferUploadHeap))
+        , mTextureUploadHeap(std::move(textureUploadHeap))
+    {
+
+    }
+
+    UploadContext::~UploadContext()
+    {
+        //Upload context heaps weren't returned for some reason
+        assert(mBufferUploadHeap == nullptr);
+        assert(mTextureUploadHeap == nullptr);
+    }
+
+    std::unique_ptr<BufferResource> UploadContext::ReturnBufferHeap()
+    {
+        return std::move(mBufferUploadHeap);
+    }
+
+    std::unique_ptr<BufferResource> UploadContext::ReturnTextureHeap()
+    {
+        return std::move(mTextureUploadHeap);
+    }
+
+    std::future<void> UploadContext::AddBufferUpload(std::unique_ptr<BufferUpload> bufferUpload)
+    {
+        assert(bufferUpload->mBufferDataSize <= bufferUpload->mBuffer->mDesc.Width);
+
+        return mDevice.GetUploadQueue().AddBufferUpload(std::move(bufferUpload));
+    }
+
+    std::future<void> UploadContext::AddTextureUpload(std::unique_ptr<TextureUpload> textureUpload)
+    {
+        //Subresources bigger than the staging heap are split by rows, a single row always fits at D3D12's size limits.
+        assert(textureUpload->mSubResourceLayouts[0].Footprint.RowPitch <= mTextureUploadHeap->mDesc.Width);
+
+        return mDevice.GetUploadQueue().AddTextureUpload(std::move(textureUpload));
+    }
+
+    void UploadContext::StageUploads(UploadQueue& uploadQueue, size_t byteBudget, WorkerPool& workerPool)
+    {
+        assert(mStagingCopies.empty());
+
+        const size_t bufferUploadHeapSize = mBufferUploadHeap->mDesc.Width;
+        const size_t textureUploadHeapSize = mTextureUploadHeap->mDesc.Width;
+        size_t bufferUploadHeapOffset = 0;
+        size_t textureUploadHeapOffset = 0;
+        size_t numBytesStaged = 0;
+        bool isOutOfSpace = false;
+
+        //The first upload of the frame is always let through if it fits in the heap, so something too big for the budget
+        //can't block the queue forever.
+        auto fitsInBudget = [&numBytesStaged, byteBudget](size_t size) { return numBytesStaged == 0 || numBytesStaged + size <= byteBudget; };
+
+        std::lock_guard<std::mutex> lockGuard(uploadQueue.mQueueMutex);
+
+        for (uint32_t priorityIndex = 0; priorityIndex < NUM_UPLOAD_PRIORITIES && !isOutOfSpace; priorityIndex++)
+        {
+            auto& bufferUploads = uploadQueue.mBufferUploads[priorityIndex];
+
+            while (!bufferUploads.empty())
+            {
+                BufferUpload& currentUpload = *bufferUploads.front();
+
+                //Uploads that fit are staged whole, anything bigger than the heap space left is staged in ranges.
+                const size_t remainingSize = currentUpload.mBufferDataSize - currentUpload.mNextOffset;
+                size_t rangeSize = (std::min)(remainingSize, bufferUploadHeapSize - bufferUploadHeapOffset);
+
+                if (!fitsInBudget(rangeSize))
+                {
+                    rangeSize = (remainingSize > bufferUploadHeapSize && byteBudget > numBytesStaged) ? (std::min)(rangeSize, byteBudget - numBytesStaged) : 0;
+                }
+
+                if (rangeSize == 0 || (rangeSize < remainingSize && remainingSize <= bufferUploadHeapSize))
+                {
+                    isOutOfSpace = true;
+                    break;
+                }
+
+                const uint8_t* sourceData = currentUpload.mSourceData ? currentUpload.mSourceData : currentUpload.mBufferData.get();
+
+                AddStagingCopy(mBufferUploadHeap->mMappedResource + bufferUploadHeapOffset, sourceData + currentUpload.mNextOffset, rangeSize);
+                CopyBufferRegion(*currentUpload.mBuffer, currentUpload.mNextOffset, *mBufferUploadHeap, bufferUploadHeapOffset, rangeSize);
+
+                bufferUploadHeapOffset += rangeSize;
+                numBytesStaged += rangeSize;
+                currentUpload.mNextOffset += rangeSize;
+
+                if (currentUpload.mNextOffset < currentUpload.mBufferDataSize)
+                {
+                    isOutOfSpace = true;
+                    break;
+                }
+
+                mBufferUploadsInProgress.push_back(std::move(bufferUploads.front()));
+                bufferUploads.pop_front();
+            }
+
+            auto& textureUploads = uploadQueue.mTextureUploads[priorityIndex];
+
+            while (!textureUploads.empty() && !isOutOfSpace)
+            {
+                TextureUpload& currentUpload = *textureUploads.front();
+
+                auto getSubResourceEnd = [&currentUpload](uint32_t subResourceIndex)
+                {
+                    return (subResourceIndex + 1 < currentUpload.mNumSubResources) ? currentUpload.mSubResourceLayouts[subResourceIndex + 1].Offset : currentUpload.mTextureDataSize;
+                };
+
+                const uint32_t firstSubResource = currentUpload.mNextSubResource;
+                const uint64_t rangeStart = currentUpload.mSubResourceLayouts[firstSubResource].Offset;
+                const size_t heapOffset = AlignU64(textureUploadHeapOffset, D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT);
+
+                //Like buffers, a subresource that would never fit in the heap is staged in ranges of rows or slices.
+                if (currentUpload.mNextRow > 0 || getSubResourceEnd(firstSubResource) - rangeStart > textureUploadHeapSize)
+                {
+                    size_t maxSize = (heapOffset < textureUploadHeapSize) ? textureUploadHeapSize - heapOffset : 0;
+
+                    if (!fitsInBudget(maxSize))
+                    {
+                        maxSize = (byteBudget > numBytesStaged) ? (std::min)(maxSize, byteBudget - numBytesStaged) : 0;
+                    }
+
+                    const size_t stagedSize = StageTextureRows(currentUpload, heapOffset, maxSize);
+
+                    if (stagedSize == 0)
+                    {
+                        isOutOfSpace = true;
+                        break;
+                    }
+
+                    textureUploadHeapOffset = heapOffset + stagedSize;
+                    numBytesStaged += stagedSize;
+
+                    if (currentUpload.mNextRow > 0)
+                    {
+                        isOutOfSpace = true;
+                        break;
+                    }
+
+                    if (currentUpload.mNextSubResource < currentUpload.mNumSubResources)
+                    {
+                        continue;
+                    }
+
+                    mTextureUploadsInProgress.push_back(std::move(textureUploads.front()));
+                    textureUploads.pop_front();
+                    continue;
+                }
+
+                uint32_t endSubResource = firstSubResource;
+
+                while (endSubResource < currentUpload.mNumSubResources)
+                {
+                    const uint64_t rangeSize = getSubResourceEnd(endSubResource) - rangeStart;
+
+                    if ((heapOffset + rangeSize) > textureUploadHeapSize || !fitsInBudget(rangeSize))
+                    {
+                        break;
+                    }
+
+                    endSubResource++;
+                }
 
-    UploadContext::UploadContext(Device& device, std::unique_ptr<BufferResource> bufferUploadHeap, std::unique_ptr<BufferResource> textureUploadHeap)
-        :Context(device, D3D12_COMMAND_LIST_TYPE_COPY)
-        , mBufferUploadHeap(std::move(bufferUploadHeap))
-        , mTextureUploadHeap(std::move(textureUploadHeap))
-    {
+                if (endSubResource == firstSubResource)
+                {
+                    isOutOfSpace = true;
+                    break;
+                }
 
-    }
+                const uint64_t rangeSize = getSubResourceEnd(endSubResource - 1) - rangeStart;
 
-    UploadContext::~UploadContext()
-    {
-        //Upload context heaps weren't returned for some reason
-        assert(mBufferUploadHeap == nullptr);
-        assert(mTextureUploadHeap == nullptr);
-    }
+                if (currentUpload.mSubResourceSources.empty())
+                {
+                    AddStagingCopy(mTextureUploadHeap->mMappedResource + heapOffset, currentUpload.mTextureData.get() + rangeStart, rangeSize);
+                }
+                else
+                {
+                    for (uint32_t subResourceIndex = firstSubResource; subResourceIndex < endSubResource; subResourceIndex++)
+                    {
+                        const TextureUploadSource& subResourceSource = currentUpload.mSubResourceSources[subResourceIndex];
+                        const D3D12_PLACED_SUBRESOURCE_FOOTPRINT& subResourceLayout = currentUpload.mSubResourceLayouts[subResourceIndex];
+                        const size_t destinationPitch = subResourceLayout.Footprint.RowPitch;
+                        uint8_t* destination = mTextureUploadHeap->mMappedResource + heapOffset + (subResourceLayout.Offset - rangeStart);
+
+                        for (uint32_t sliceIndex = 0; sliceIndex < subResourceLayout.Footprint.Depth; sliceIndex++)
+                        {
+                            AddStagingRowCopy(destination + sliceIndex * destinationPitch * subResourceSource.mNumRows, destinationPitch,
+                                subResourceSource.mPixels + sliceIndex * subResourceSource.mSlicePitch, subResourceSource.mRowPitch, subResourceSource.mRowSize, subResourceSource.mNumRows);
+                        }
+                    }
+                }
 
-    std::unique_ptr<BufferResource> UploadContext::ReturnBufferHeap()
-    {
-        return std::move(mBufferUploadHeap);
-    }
+                CopyTextureRegion(*currentUpload.mTexture, *mTextureUploadHeap, heapOffset, currentUpload.mSubResourceLayouts, endSubResource - firstSubResource, firstSubResource);
 
-    std::unique_ptr<BufferResource> UploadContext::ReturnTextureHeap()
-    {
-        return std::move(mTextureUploadHeap);
-    }
+                textureUploadHeapOffset = heapOffset + rangeSize;
+                numBytesStaged += rangeSize;
+                currentUpload.mNextSubResource = endSubResource;
 
-    void UploadContext::AddBufferUpload(std::unique_ptr<BufferUpload> bufferUpload)
-    {
-        assert(bufferUpload->mBufferDataSize <= mBufferUploadHeap->mDesc.Width);
+                //The next subresource either did not fit, which the next pass finds out, or has to be split by rows.
+                if (endSubResource < currentUpload.mNumSubResources)
+                {
+                    continue;
+                }
 
-        mBufferUploads.push_back(std::move(bufferUpload));
-    }
+                mTextureUploadsInProgress.push_back(std::move(textureUploads.front()));
+                textureUploads.pop_front();
+            }
+        }
 
-    void UploadContext::AddTextureUpload(std::unique_ptr<TextureUpload> textureUpload)
-    {
-        assert(textureUpload->mTextureDataSize <= mTextureUploadHeap->mDesc.Width);
+        //Uploads still in the queue stay put until the next frame, anything we read from here is either owned by this
+        //context now or only touched again once ProcessUploads has waited for the copies.
+        mWorkerPool = &workerPool;
 
-        mTextureUploads.push_back(std::move(textureUpload));
+        for (const StagingCopy& stagingCopy : mStagingCopies)
+        {
+            workerPool.AddJob([stagingCopy]()
+            {
+                for (uint32_t rowIndex = 0; rowIndex < stagingCopy.mNumRows; rowIndex++)
+                {
+                    memcpy(stagingCopy.mDestination + rowIndex * stagingCopy.mDestinationPitch, stagingCopy.mSource + rowIndex * stagingCopy.mSourcePitch, stagingCopy.mSize);
+                }
+            });
+        }
     }
 
-    void UploadContext::ProcessUploads()
+    size_t UploadContext::StageTextureRows(TextureUpload& textureUpload, size_t heapOffset, size_t maxSize)
     {
-        const uint32_t numBufferUploads = static_cast<uint32_t>(mBufferUploads.size());
-        const uint32_t numTextureUploads = static_cast<uint32_t>(mTextureUploads.size());
-        uint32_t numBuffersProcessed = 0;
-        uint32_t numTexturesProcessed = 0;
-        size_t bufferUploadHeapOffset = 0;
-        size_t textureUploadHeapOffset = 0;
+        const uint32_t subResourceIndex = textureUpload.mNextSubResource;
+        const D3D12_PLACED_SUBRESOURCE_FOOTPRINT& subResourceLayout = textureUpload.mSubResourceLayouts[subResourceIndex];
+        const D3D12_SUBRESOURCE_FOOTPRINT& footprint = subResourceLayout.Footprint;
+        const size_t rowPitch = footprint.RowPitch;
 
-        for (numBuffersProcessed; numBuffersProcessed < numBufferUploads; numBuffersProcessed++)
-        {
-            BufferUpload& currentUpload = *mBufferUploads[numBuffersProcessed];
+        UINT numRows = 0;
+        uint64_t rowSize = 0;
+        mDevice.GetBackend().GetCopyableFootprints(textureUpload.mTexture->mDesc, subResourceIndex, 1, 0, nullptr, &numRows, &rowSize, nullptr);
 
-            if ((bufferUploadHeapOffset + currentUpload.mBufferDataSize) > mBufferUploadHeap->mDesc.Width)
-            {
-                break;
-            }
+        //Rows of block compressed formats cover several pixel rows.
+        const uint32_t rowHeight = (footprint.Height + numRows - 1) / numRows;
+        const uint32_t firstSlice = textureUpload.mNextRow / numRows;
+        const uint32_t firstRowInSlice = textureUpload.mNextRow % numRows;
+        const size_t slicePitch = rowPitch * numRows;
 
-            memcpy(mBufferUploadHeap->mMappedResource + bufferUploadHeapOffset, currentUpload.mBufferData.get(), currentUpload.mBufferDataSize);
-            CopyBufferRegion(*currentUpload.mBuffer, 0, *mBufferUploadHeap, bufferUploadHeapOffset, currentUpload.mBufferDataSize);
+        //Whole depth slices while they fit, otherwise part of a single slice.
+        uint32_t numSlices = 1;
+        uint32_t numRowsPerSlice = 0;
+
+        if (firstRowInSlice == 0 && maxSize >= slicePitch)
+        {
+            numSlices = static_cast<uint32_t>((std::min)(maxSize / slicePitch, static_cast<size_t>(footprint.Depth - firstSlice)));
+            numRowsPerSlice = numRows;
+        }
+        else
+        {
+            numRowsPerSlice = static_cast<uint32_t>((std::min)(maxSize / rowPitch, static_cast<size_t>(numRows - firstRowInSlice)));
+        }
 
-            bufferUploadHeapOffset += currentUpload.mBufferDataSize;
-            mBufferUploadsInProgress.push_back(currentUpload.mBuffer);
+        if (numRowsPerSlice == 0)
+        {
+            return 0;
         }
 
-        for (numTexturesProcessed; numTexturesProcessed < numTextureUploads; numTexturesProcessed++)
+        for (uint32_t sliceIndex = firstSlice; sliceIndex < firstSlice + numSlices; sliceIndex++)
         {
-            TextureUpload& currentUpload = *mTextureUploads[numTexturesProcessed];
+            uint8_t* destination = mTextureUploadHeap->mMappedResource + heapOffset + (sliceIndex - firstSlice) * rowPitch * numRowsPerSlice;
 
-            if ((textureUploadHeapOffset + currentUpload.mTextureDataSize) > mTextureUploadHeap->mDesc.Width)
+            if (textureUpload.mSubResourceSources.empty())
             {
-                break;
+                const uint8_t* source = textureUpload.mTextureData.get() + subResourceLayout.Offset + sliceIndex * slicePitch + firstRowInSlice * rowPitch;
+                AddStagingRowCopy(destination, rowPitch, source, rowPitch, rowSize, numRowsPerSlice);
+            }
+            else
+            {
+                const TextureUploadSource& subResourceSource = textureUpload.mSubResourceSources[subResourceIndex];
+                const uint8_t* source = subResourceSource.mPixels + sliceIndex * subResourceSource.mSlicePitch + firstRowInSlice * subResourceSource.mRowPitch;
+                AddStagingRowCopy(destination, rowPitch, source, subResourceSource.mRowPitch, subResourceSource.mRowSize, numRowsPerSlice);
             }
+        }
+
+        const uint32_t firstPixelRow = firstRowInSlice * rowHeight;
+        const uint32_t numPixelRows = (std::min)(numRowsPerSlice * rowHeight, footprint.Height - firstPixelRow);
+
+        D3D12_TEXTURE_COPY_LOCATION destinationLocation = {};
+        destinationLocation.pResource = textureUpload.mTexture->mResource;
+        destinationLocation.Type = D3D12_TEXTURE_COPY_TYPE_SUBRESOURCE_INDEX;
+        destinationLocation.SubresourceIndex = subResourceIndex;
+
+        D3D12_TEXTURE_COPY_LOCATION sourceLocation = {};
+        sourceLocation.pResource = mTextureUploadHeap->mResource;
+        sourceLocation.Type = D3D12_TEXTURE_COPY_TYPE_PLACED_FOOTPRINT;
+        sourceLocation.PlacedFootprint.Offset = heapOffset;
+        sourceLocation.PlacedFootprint.Footprint = footprint;
+        sourceLocation.PlacedFootprint.Footprint.Height = numPixelRows;
+        sourceLocation.PlacedFootprint.Footprint.Depth = numSlices;
+
+        const D3D12_BOX sourceBox = { 0, 0, 0, footprint.Width, numPixelRows, numSlices };
+        mCommandRecorder->CopyTextureRegion(destinationLocation, 0, firstPixelRow, firstSlice, sourceLocation, &sourceBox);
+
+        textureUpload.mNextRow += numSlices * numRowsPerSlice;
+
+        if (textureUpload.mNextRow == numRows * footprint.Depth)
+        {
+            textureUpload.mNextRow = 0;
+            textureUpload.mNextSubResource++;
+        }
 
-            memcpy(mTextureUploadHeap->mMappedResource + textureUploadHeapOffset, currentUpload.mTextureData.get(), currentUpload.mTextureDataSize);
-            CopyTextureRegion(*currentUpload.mTexture, *mTextureUploadHeap, textureUploadHeapOffset, currentUpload.mSubResourceLayouts, currentUpload.mNumSubResources);
+        return static_cast<size_t>(numSlices) * numRowsPerSlice * rowPitch;
+    }
 
-            textureUploadHeapOffset += currentUpload.mTextureDataSize;
-            textureUploadHeapOffset = AlignU64(textureUploadHeapOffset, 512);
+    void UploadContext::AddStagingCopy(uint8_t* destination, const uint8_t* source, size_t size)
+    {
+        for (size_t offset = 0; offset < size; offset += UPLOAD_STAGING_CHUNK_SIZE)
+        {
+            StagingCopy stagingCopy;
+            stagingCopy.mDestination = destination + offset;
+            stagingCopy.mSource = source + offset;
+            stagingCopy.mSize = (std::min)(UPLOAD_STAGING_CHUNK_SIZE, size - offset);
 
-            mTextureUploadsInProgress.push_back(currentUpload.mTexture);
+            mStagingCopies.push_back(stagingCopy);
         }
+    }
+
+    void UploadContext::AddStagingRowCopy(uint8_t* destination, size_t destinationPitch, const uint8_t* source, size_t sourcePitch, size_t rowSize, uint32_t numRows)
+    {
+        const uint32_t rowsPerCopy = static_cast<uint32_t>((std::max)(UPLOAD_STAGING_CHUNK_SIZE / destinationPitch, size_t(1)));
 
-        if (numBuffersProcessed > 0)
+        for (uint32_t rowIndex = 0; rowIndex < numRows; rowIndex += rowsPerCopy)
         {
-            mBufferUploads.erase(mBufferUploads.begin(), mBufferUploads.begin() + numBuffersProcessed);
+            StagingCopy stagingCopy;
+            stagingCopy.mDestination = destination + rowIndex * destinationPitch;
+            stagingCopy.mSource = source + rowIndex * sourcePitch;
+            stagingCopy.mSize = rowSize;
+            stagingCopy.mDestinationPitch = destinationPitch;
+            stagingCopy.mSourcePitch = sourcePitch;
+            stagingCopy.mNumRows = (std::min)(rowsPerCopy, numRows - rowIndex);
+
+            mStagingCopies.push_back(stagingCopy);
         }
+    }
 
-        if (numTexturesProcessed > 0)
+    void UploadContext::ProcessUploads()
+    {
+        if (mWorkerPool)
         {
-            mTextureUploads.erase(mTextureUploads.begin(), mTextureUploads.begin() + numTexturesProcessed);
+            mWorkerPool->WaitForIdle();
+            mWorkerPool = nullptr;
         }
+
+        mStagingCopies.clear();
     }
 
     void UploadContext::ResolveProcessedUploads()
     {
         for (auto& bufferUploadInProgress : mBufferUploadsInProgress)
         {
-            bufferUploadInProgress->mIsReady = true;
+            bufferUploadInProgress->mBuffer->mIsReady = true;
+            bufferUploadInProgress->mCompletion.set_value();
         }
 
         for (auto& textureUploadInProgress : mTextureUploadsInProgress)
         {
-            textureUploadInProgress->mIsReady = true;
+            textureUploadInProgress->mTexture->mIsReady = true;
+            textureUploadInProgress->mCompletion.set_value();
         }
 
         mBufferUploadsInProgress.clear();
         mTextureUploadsInProgress.clear();
     }
 
+    namespace
+    {
+        D3D12_SHADER_BYTECODE GetShaderByteCode(const Shader& shader)
+        {
+            const ShaderCacheResult& result = shader.GetResult();
+
+            if (!result.mSucceeded)
+            {
+                wprintf(L"Shader compilation error:\n%S\n", result.mErrors.c_str());
+                AssertError("Shader compilation error");
+            }
+
+            D3D12_SHADER_BYTECODE byteCode{};
+            byteCode.pShaderBytecode = result.mByteCode.data();
+            byteCode.BytecodeLength = result.mByteCode.size();
+
+            return byteCode;
+        }
+    }
+
     Device::Device(HWND windowHandle, Uint2 screenSize)
     {
-        InitializeDeviceResources();
+        InitializeDeviceResources(CreateD3D12DeviceBackend(), PIPELINE_LIBRARY_PATH, SHADER_OUTPUT_PATH);
         CreateWindowDependentResources(windowHandle, screenSize);
 
         mScreenSize = screenSize;
     }
 
+    Device::Device(const NullDeviceDesc& nullDeviceDesc, Uint2 screenSize)
+    {
+        InitializeDeviceResources(std::make_unique<NullDeviceBackend>(nullDeviceDesc), nullDeviceDesc.mPipelineLibraryPath, nullDeviceDesc.mShaderCachePath);
+        CreateWindowDependentResources(nullptr, screenSize);
+
+        mScreenSize = screenSize;
+    }
+
     Device::~Device()
     {
         WaitForIdle();
 
+        if (mIsDefragmentingResources)
+        {
+            EndResourceDefragmentation();
+        }
+
+        for (uint32_t frameIndex = 0; frameIndex < NUM_FRAMES_IN_FLIGHT; frameIndex++)
+        {
+            mUploadContexts[frameIndex]->ProcessUploads();
+        }
+
+        mUploadWorkerPool = nullptr;
+        mShaderCache = nullptr;
+
+        mPipelineCache->SaveLibrary();
+
         DestroyWindowDependentResources();
 
         for (uint32_t frameIndex = 0; frameIndex < NUM_FRAMES_IN_FLIGHT; frameIndex++)
         {
             DestroyBuffer(mUploadContexts[frameIndex]->ReturnBufferHeap());
             DestroyBuffer(mUploadContexts[frameIndex]->ReturnTextureHeap());
+            DestroyBuffer(std::move(mTransientConstantBuffers[frameIndex]));
         }
 
-        for (uint32_t frameIndex = 0; frameIndex < NUM_FRAMES_IN_FLIGHT; frameIndex++)
+        //Oldest frame first, so buffers are gone before the pools they were destroyed ahead of.
+        for (uint32_t frameOffset = 1; frameOffset <= NUM_FRAMES_IN_FLIGHT; frameOffset++)
         {
+            uint32_t frameIndex = (mFrameId + frameOffset) % NUM_FRAMES_IN_FLIGHT;
             ProcessDestructions(frameIndex);
+            mGraphicsContextPools[frameIndex].clear();
         }
 
         mCopyQueue = nullptr;
@@ -973,6 +2182,7 @@ namespace D3D12Lite
         mDSVStagingDescriptorHeap = nullptr;
         mSRVStagingDescriptorHeap = nullptr;
         mSamplerRenderPassDescriptorHeap = nullptr;
+        mPipelineCache = nullptr;
 
         for (uint32_t frameIndex = 0; frameIndex < NUM_FRAMES_IN_FLIGHT; frameIndex++)
         {
@@ -980,91 +2190,26 @@ namespace D3D12Lite
             mUploadContexts[frameIndex] = nullptr;
         }
 
-        SafeRelease(mAllocator);
-        SafeRelease(mDevice);
-        SafeRelease(mDXGIFactory);
-
-#ifdef _DEBUG
-        IDXGIDebug1* pDebug = nullptr;
-        if (SUCCEEDED(DXGIGetDebugInterface1(0, IID_PPV_ARGS(&pDebug))))
-        {
-            pDebug->ReportLiveObjects(DXGI_DEBUG_ALL, DXGI_DEBUG_RLO_FLAGS(DXGI_DEBUG_RLO_SUMMARY | DXGI_DEBUG_RLO_DETAIL | DXGI_DEBUG_RLO_IGNORE_INTERNAL));
-            SafeRelease(pDebug);
-        }
-#endif
+        mBackend = nullptr;
     }
 
-    void Device::InitializeDeviceResources()
+    void Device::InitializeDeviceResources(std::unique_ptr<DeviceBackend> backend, const std::wstring& pipelineLibraryPath, const std::wstring& shaderCachePath)
     {
-#if defined(_DEBUG)
-        ID3D12Debug* debugController;
-        if (SUCCEEDED(D3D12GetDebugInterface(IID_PPV_ARGS(&debugController))))
-        {
-            debugController->EnableDebugLayer();
-            SafeRelease(debugController);
-        }
-#endif
-
-        AssertIfFailed(CreateDXGIFactory1(IID_PPV_ARGS(&mDXGIFactory)));
-
-        IDXGIAdapter1* adapter = nullptr;
-        uint32_t bestAdapterIndex = 0;
-        size_t bestAdapterMemory = 0;
-
-        for (uint32_t adapterIndex = 0; mDXGIFactory->EnumAdapters1(adapterIndex, &adapter) != DXGI_ERROR_NOT_FOUND; adapterIndex++)
-        {
-            DXGI_ADAPTER_DESC1 adapterDesc;
-            AssertIfFailed(adapter->GetDesc1(&adapterDesc));
-
-            if (adapterDesc.Flags & DXGI_ADAPTER_FLAG_SOFTWARE)
-            {
-                continue;
-            }
-
-            if (FAILED(D3D12CreateDevice(adapter, D3D_FEATURE_LEVEL_12_2, _uuidof(ID3D12Device), nullptr)))
-            {
-                continue;
-            }
-
-            if (adapterDesc.DedicatedVideoMemory > bestAdapterMemory)
-            {
-                bestAdapterIndex = adapterIndex;
-                bestAdapterMemory = adapterDesc.DedicatedVideoMemory;
-            }
-
-            SafeRelease(adapter);
-        }
-
-        if (bestAdapterMemory == 0)
-        {
-            AssertError("Failed to find an adapter.");
-        }
-
-        mDXGIFactory->EnumAdapters1(bestAdapterIndex, &adapter);
-
-        AssertIfFailed(D3D12CreateDevice(adapter, D3D_FEATURE_LEVEL_12_2, IID_PPV_ARGS(&mDevice)));
-
-        D3D12MA::ALLOCATOR_DESC desc = {};
-        desc.Flags = D3D12MA::ALLOCATOR_FLAG_NONE;
-        desc.pDevice = mDevice;
-        desc.pAdapter = adapter;
+        mBackend = std::move(backend);
+        mPipelineCache = std::make_unique<PipelineCache>(*mBackend, pipelineLibraryPath);
 
-        D3D12MA::CreateAllocator(&desc, &mAllocator);
+        mGraphicsQueue = std::make_unique<Queue>(*mBackend, D3D12_COMMAND_LIST_TYPE_DIRECT);
+        mComputeQueue = std::make_unique<Queue>(*mBackend, D3D12_COMMAND_LIST_TYPE_COMPUTE);
+        mCopyQueue = std::make_unique<Queue>(*mBackend, D3D12_COMMAND_LIST_TYPE_COPY);
 
-        SafeRelease(adapter);
-
-        mGraphicsQueue = std::make_unique<Queue>(mDevice, D3D12_COMMAND_LIST_TYPE_DIRECT);
-        mComputeQueue = std::make_unique<Queue>(mDevice, D3D12_COMMAND_LIST_TYPE_COMPUTE);
-        mCopyQueue = std::make_unique<Queue>(mDevice, D3D12_COMMAND_LIST_TYPE_COPY);
-
-        mRTVStagingDescriptorHeap = std::make_unique<StagingDescriptorHeap>(mDevice, D3D12_DESCRIPTOR_HEAP_TYPE_RTV, NUM_RTV_STAGING_DESCRIPTORS);
-        mDSVStagingDescriptorHeap = std::make_unique<StagingDescriptorHeap>(mDevice, D3D12_DESCRIPTOR_HEAP_TYPE_DSV, NUM_DSV_STAGING_DESCRIPTORS);
-        mSRVStagingDescriptorHeap = std::make_unique<StagingDescriptorHeap>(mDevice, D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, NUM_SRV_STAGING_DESCRIPTORS);
-        mSamplerRenderPassDescriptorHeap = std::make_unique<RenderPassDescriptorHeap>(mDevice, D3D12_DESCRIPTOR_HEAP_TYPE_SAMPLER, 0, NUM_SAMPLER_DESCRIPTORS);
+        mRTVStagingDescriptorHeap = std::make_unique<StagingDescriptorHeap>(*mBackend, D3D12_DESCRIPTOR_HEAP_TYPE_RTV, NUM_RTV_STAGING_DESCRIPTORS);
+        mDSVStagingDescriptorHeap = std::make_unique<StagingDescriptorHeap>(*mBackend, D3D12_DESCRIPTOR_HEAP_TYPE_DSV, NUM_DSV_STAGING_DESCRIPTORS);
+        mSRVStagingDescriptorHeap = std::make_unique<StagingDescriptorHeap>(*mBackend, D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, NUM_SRV_STAGING_DESCRIPTORS);
+        mSamplerRenderPassDescriptorHeap = std::make_unique<RenderPassDescriptorHeap>(*mBackend, D3D12_DESCRIPTOR_HEAP_TYPE_SAMPLER, 0, NUM_SAMPLER_DESCRIPTORS);
 
         for (uint32_t frameIndex = 0; frameIndex < NUM_FRAMES_IN_FLIGHT; frameIndex++)
         {
-            mSRVRenderPassDescriptorHeaps[frameIndex] = std::make_unique<RenderPassDescriptorHeap>(mDevice, D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, NUM_RESERVED_SRV_DESCRIPTORS, NUM_SRV_RENDER_PASS_USER_DESCRIPTORS);
+            mSRVRenderPassDescriptorHeaps[frameIndex] = std::make_unique<RenderPassDescriptorHeap>(*mBackend, D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, NUM_RESERVED_SRV_DESCRIPTORS, NUM_SRV_RENDER_PASS_USER_DESCRIPTORS);
             mImguiDescriptors[frameIndex] = mSRVRenderPassDescriptorHeaps[frameIndex]->GetReservedDescriptor(IMGUI_RESERVED_DESCRIPTOR_INDEX);
         }
 
@@ -1083,6 +2228,18 @@ namespace D3D12Lite
             mUploadContexts[frameIndex] = std::make_unique<UploadContext>(*this, CreateBuffer(uploadBufferDesc), CreateBuffer(uploadTextureDesc));
         }
 
+        BufferCreationDesc transientConstantBufferDesc;
+        transientConstantBufferDesc.mSize = TRANSIENT_CONSTANT_BUFFER_SIZE;
+        transientConstantBufferDesc.mAccessFlags = BufferAccessFlags::hostWritable;
+
+        for (uint32_t frameIndex = 0; frameIndex < NUM_FRAMES_IN_FLIGHT; frameIndex++)
+        {
+            mTransientConstantBuffers[frameIndex] = CreateBuffer(transientConstantBufferDesc);
+        }
+
+        mUploadWorkerPool = std::make_unique<WorkerPool>(NUM_UPLOAD_WORKER_THREADS);
+        mShaderCache = std::make_unique<ShaderCache>(shaderCachePath, [this]() { return mBackend->CreateShaderCompiler(); });
+
         //The -1 and starting at index 1 accounts for the imgui descriptor.
         mFreeReservedDescriptorIndices.resize(NUM_RESERVED_SRV_DESCRIPTORS - 1);
         std::iota(mFreeReservedDescriptorIndices.begin(), mFreeReservedDescriptorIndices.end(), 1);
@@ -1162,36 +2319,17 @@ namespace D3D12Lite
 
         for (uint32_t samplerIndex = 0; samplerIndex < NUM_SAMPLER_DESCRIPTORS; samplerIndex++)
         {
-            mDevice->CreateSampler(&samplerDescs[samplerIndex], currentSamplerDescriptor);
+            mBackend->CreateSampler(samplerDescs[samplerIndex], currentSamplerDescriptor);
             currentSamplerDescriptor.ptr += mSamplerRenderPassDescriptorHeap->GetDescriptorSize();
         }
     }
 
     void Device::CreateWindowDependentResources(HWND windowHandle, Uint2 screenSize)
     {
-        DXGI_SWAP_CHAIN_DESC1 swapChainDesc = {};
-        ZeroMemory(&swapChainDesc, sizeof(swapChainDesc));
-        swapChainDesc.Width = lround(screenSize.x);
-        swapChainDesc.Height = lround(screenSize.y);
-        swapChainDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
-        swapChainDesc.Stereo = false;
-        swapChainDesc.SampleDesc.Count = 1;
-        swapChainDesc.SampleDesc.Quality = 0;
-        swapChainDesc.BufferUsage = DXGI_USAGE_RENDER_TARGET_OUTPUT;
-        swapChainDesc.BufferCount = NUM_BACK_BUFFERS;
-        swapChainDesc.SwapEffect = DXGI_SWAP_EFFECT_FLIP_DISCARD;
-        swapChainDesc.Flags = 0;
-        swapChainDesc.Scaling = DXGI_SCALING_NONE;
-        swapChainDesc.AlphaMode = DXGI_ALPHA_MODE_UNSPECIFIED;
-
-        IDXGISwapChain1* swapChain = nullptr;
-        AssertIfFailed(mDXGIFactory->CreateSwapChainForHwnd(mGraphicsQueue->GetDeviceQueue(), windowHandle, &swapChainDesc, nullptr, nullptr, &swapChain));
-        AssertIfFailed(swapChain->QueryInterface(__uuidof(IDXGISwapChain3), (void**)&mSwapChain));
-        SafeRelease(swapChain);
+        mBackend->CreateSwapChain(windowHandle, screenSize, mGraphicsQueue->GetBackendQueue());
 
         for (uint32_t bufferIndex = 0; bufferIndex < NUM_BACK_BUFFERS; bufferIndex++)
         {
-            ID3D12Resource* backBufferResource = nullptr;
             Descriptor backBufferRTVHandle = mRTVStagingDescriptorHeap->GetNewDescriptor();
 
             D3D12_RENDER_TARGET_VIEW_DESC rtvDesc = {};
@@ -1200,12 +2338,10 @@ namespace D3D12Lite
             rtvDesc.Texture2D.MipSlice = 0;
             rtvDesc.Texture2D.PlaneSlice = 0;
 
-            AssertIfFailed(mSwapChain->GetBuffer(bufferIndex, IID_PPV_ARGS(&backBufferResource)));
-            mDevice->CreateRenderTargetView(backBufferResource, &rtvDesc, backBufferRTVHandle.mCPUHandle);
-
             mBackBuffers[bufferIndex] = std::make_unique<TextureResource>();
-            mBackBuffers[bufferIndex]->mDesc = backBufferResource->GetDesc();
-            mBackBuffers[bufferIndex]->mResource = backBufferResource;
+            mBackend->GetSwapChainBuffer(bufferIndex, *mBackBuffers[bufferIndex]);
+            mBackend->CreateRenderTargetView(*mBackBuffers[bufferIndex], &rtvDesc, backBufferRTVHandle.mCPUHandle);
+
             mBackBuffers[bufferIndex]->mState = D3D12_RESOURCE_STATE_PRESENT;
             mBackBuffers[bufferIndex]->mRTVDescriptor = backBufferRTVHandle;
         }
@@ -1222,7 +2358,7 @@ namespace D3D12Lite
             mBackBuffers[bufferIndex] = nullptr;
         }
 
-        SafeRelease(mSwapChain);
+        mBackend->DestroySwapChain();
     }
 
     void Device::ProcessDestructions(uint32_t frameIndex)
@@ -1239,21 +2375,20 @@ namespace D3D12Lite
             if (bufferToDestroy->mSRVDescriptor.IsValid())
             {
                 mSRVStagingDescriptorHeap->FreeDescriptor(bufferToDestroy->mSRVDescriptor);
-                mFreeReservedDescriptorIndices.push_back(bufferToDestroy->mDescriptorHeapIndex);
             }
 
-            if (bufferToDestroy->mUAVDescriptor.IsValid())
+            //Storage left behind by defragmentation hands its views back, but the index stays with the buffer.
+            if (bufferToDestroy->mDescriptorHeapIndex != INVALID_RESOURCE_TABLE_INDEX)
             {
-                mSRVStagingDescriptorHeap->FreeDescriptor(bufferToDestroy->mUAVDescriptor);
+                FreeReservedDescriptorIndex(bufferToDestroy->mDescriptorHeapIndex);
             }
 
-            if (bufferToDestroy->mMappedResource != nullptr)
+            if (bufferToDestroy->mUAVDescriptor.IsValid())
             {
-                bufferToDestroy->mResource->Unmap(0, nullptr);
+                mSRVStagingDescriptorHeap->FreeDescriptor(bufferToDestroy->mUAVDescriptor);
             }
 
-            SafeRelease(bufferToDestroy->mResource);
-            SafeRelease(bufferToDestroy->mAllocation);
+            mBackend->ReleaseResource(*bufferToDestroy, bufferToDestroy->mMappedResource != nullptr);
         }
 
         for (auto& textureToDestroy : destructionQueueForFrame.mTexturesToDestroy)
@@ -1271,7 +2406,11 @@ namespace D3D12Lite
             if (textureToDestroy->mSRVDescriptor.IsValid())
             {
                 mSRVStagingDescriptorHeap->FreeDescriptor(textureToDestroy->mSRVDescriptor);
-                mFreeReservedDescriptorIndices.push_back(textureToDestroy->mDescriptorHeapIndex);
+            }
+
+            if (textureToDestroy->mDescriptorHeapIndex != INVALID_RESOURCE_TABLE_INDEX)
+            {
+                FreeReservedDescriptorIndex(textureToDestroy->mDescriptorHeapIndex);
             }
 
             if (textureToDestroy->mUAVDescriptor.IsValid())
@@ -1279,8 +2418,7 @@ namespace D3D12Lite
                 mSRVStagingDescriptorHeap->FreeDescriptor(textureToDestroy->mUAVDescriptor);
             }
 
-            SafeRelease(textureToDestroy->mResource);
-            SafeRelease(textureToDestroy->mAllocation);
+            mBackend->ReleaseResource(*textureToDestroy, false);
         }
 
         for (auto& pipelineToDestroy : destructionQueueForFrame.mPipelinesToDestroy)
@@ -1289,8 +2427,14 @@ namespace D3D12Lite
             SafeRelease(pipelineToDestroy->mPipeline);
         }
 
+        for (D3D12MA::Pool* poolToDestroy : destructionQueueForFrame.mBufferPoolsToDestroy)
+        {
+            mBackend->ReleasePool(poolToDestroy);
+        }
+
         destructionQueueForFrame.mBuffersToDestroy.clear();
         destructionQueueForFrame.mTexturesToDestroy.clear();
+        destructionQueueForFrame.mBufferPoolsToDestroy.clear();
         destructionQueueForFrame.mPipelinesToDestroy.clear();
         destructionQueueForFrame.mContextsToDestroy.clear();
     }
@@ -1305,6 +2449,30 @@ namespace D3D12Lite
         }
     }
 
+    uint32_t Device::AllocateReservedDescriptorIndex()
+    {
+        //Resources are created from loading threads while the render thread destroys others.
+        std::lock_guard<std::mutex> lockGuard(mReservedDescriptorMutex);
+
+        if (mFreeReservedDescriptorIndices.empty())
+        {
+            //AssertError compiles out in release, the resource then has no bindless index rather than an aliased one.
+            AssertError("Ran out of reserved bindless descriptors");
+            return INVALID_RESOURCE_TABLE_INDEX;
+        }
+
+        uint32_t index = mFreeReservedDescriptorIndices.back();
+        mFreeReservedDescriptorIndices.pop_back();
+
+        return index;
+    }
+
+    void Device::FreeReservedDescriptorIndex(uint32_t index)
+    {
+        std::lock_guard<std::mutex> lockGuard(mReservedDescriptorMutex);
+        mFreeReservedDescriptorIndices.push_back(index);
+    }
+
     void Device::BeginFrame()
     {
         mFrameId = (mFrameId + 1) % NUM_FRAMES_IN_FLIGHT;
@@ -1316,10 +2484,35 @@ namespace D3D12Lite
 
         ProcessDestructions(mFrameId);
 
+        for (const auto& descriptorPatch : mPendingReservedDescriptorPatches[mFrameId])
+        {
+            Descriptor targetDescriptor = mSRVRenderPassDescriptorHeaps[mFrameId]->GetReservedDescriptor(descriptorPatch.first);
+            CopyDescriptorsSimple(1, targetDescriptor.mCPUHandle, descriptorPatch.second.mCPUHandle, D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+        }
+
+        mPendingReservedDescriptorPatches[mFrameId].clear();
+
         mUploadContexts[mFrameId]->ResolveProcessedUploads();
+        mSRVRenderPassDescriptorHeaps[mFrameId]->Reset();
         mUploadContexts[mFrameId]->Reset();
+        mUploadContexts[mFrameId]->StageUploads(mUploadQueue, mUploadBudgetPerFrame, *mUploadWorkerPool);
+
+        {
+            std::lock_guard<std::mutex> lockGuard(mContextPoolMutex);
+            mNumAcquiredGraphicsContexts[mFrameId] = 0;
+        }
+
+        mLastFrameBarrierStatistics = mBarrierStatistics;
+        mBarrierStatistics = BarrierStatistics{};
+        mLastFrameStateFilterStatistics = mStateFilterStatistics;
+        mStateFilterStatistics = StateFilterStatistics{};
+
+        //The end of frame fences above cover every draw that read from this frame's slice of the ring.
+        mTransientConstantBufferOffset.store(0, std::memory_order_relaxed);
 
         mContextSubmissions[mFrameId].clear();
+
+        UpdateResourceDefragmentation();
     }
 
     void Device::EndFrame()
@@ -1333,24 +2526,39 @@ namespace D3D12Lite
 
     void Device::Present()
     {
-        mSwapChain->Present(0, 0);
+        mBackend->Present();
         mEndOfFrameFences[mFrameId].mGraphicsQueueFence = mGraphicsQueue->SignalFence();
     }
 
     void Device::CopyDescriptorsSimple(uint32_t numDescriptors, D3D12_CPU_DESCRIPTOR_HANDLE destDescriptorRangeStart, D3D12_CPU_DESCRIPTOR_HANDLE srcDescriptorRangeStart, D3D12_DESCRIPTOR_HEAP_TYPE descriptorType)
     {
-        mDevice->CopyDescriptorsSimple(numDescriptors, destDescriptorRangeStart, srcDescriptorRangeStart, descriptorType);
+        mBackend->CopyDescriptorsSimple(numDescriptors, destDescriptorRangeStart, srcDescriptorRangeStart, descriptorType);
     }
 
     void Device::CopyDescriptors(uint32_t numDestDescriptorRanges, const D3D12_CPU_DESCRIPTOR_HANDLE* destDescriptorRangeStarts, const uint32_t* destDescriptorRangeSizes,
         uint32_t numSrcDescriptorRanges, const D3D12_CPU_DESCRIPTOR_HANDLE* srcDescriptorRangeStarts, const uint32_t* srcDescriptorRangeSizes, D3D12_DESCRIPTOR_HEAP_TYPE descriptorType)
     {
-        mDevice->CopyDescriptors(numDestDescriptorRanges, destDescriptorRangeStarts, destDescriptorRangeSizes, numSrcDescriptorRanges, srcDescriptorRangeStarts, srcDescriptorRangeSizes, descriptorType);
+        mBackend->CopyDescriptors(numDestDescriptorRanges, destDescriptorRangeStarts, destDescriptorRangeSizes, numSrcDescriptorRanges, srcDescriptorRangeStarts, srcDescriptorRangeSizes, descriptorType);
     }
 
     TextureResource& Device::GetCurrentBackBuffer()
     {
-        return *mBackBuffers[mSwapChain->GetCurrentBackBufferIndex()];
+        return *mBackBuffers[mBackend->GetCurrentBackBufferIndex()];
+    }
+
+    ID3D12Device5* Device::GetDevice()
+    {
+        return mBackend->GetNativeDevice();
+    }
+
+    DeviceBackendType Device::GetBackendType() const
+    {
+        return mBackend->GetType();
+    }
+
+    PipelineCacheStatistics Device::GetPipelineCacheStatistics() const
+    {
+        return mPipelineCache->GetStatistics();
     }
 
     std::unique_ptr<BufferResource> Device::CreateBuffer(const BufferCreationDesc& desc)
@@ -1368,8 +2576,11 @@ namespace D3D12Lite
         newBuffer->mDesc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
         newBuffer->mDesc.Flags = D3D12_RESOURCE_FLAG_NONE;
         newBuffer->mStride = desc.mStride;
+        newBuffer->mIsRawAccess = desc.mIsRawAccess;
 
         uint32_t numElements = static_cast<uint32_t>(newBuffer->mStride > 0 ? desc.mSize / newBuffer->mStride : 1);
+        newBuffer->mNumElements = desc.mIsRawAccess ? (desc.mSize / 4) : numElements;
+
         bool isHostVisible = ((desc.mAccessFlags & BufferAccessFlags::hostWritable) == BufferAccessFlags::hostWritable);
         bool hasCBV = ((desc.mViewFlags & BufferViewFlags::cbv) == BufferViewFlags::cbv);
         bool hasSRV = ((desc.mViewFlags & BufferViewFlags::srv) == BufferViewFlags::srv);
@@ -1384,20 +2595,42 @@ namespace D3D12Lite
 
         newBuffer->mState = resourceState;
 
-        D3D12MA::ALLOCATION_DESC allocationDesc{};
-        allocationDesc.HeapType = isHostVisible ? D3D12_HEAP_TYPE_UPLOAD : D3D12_HEAP_TYPE_DEFAULT;
+        mBackend->CreateResource(isHostVisible ? D3D12_HEAP_TYPE_UPLOAD : D3D12_HEAP_TYPE_DEFAULT, desc.mPool, newBuffer->mDesc, resourceState, nullptr, *newBuffer);
+
+        CreateBufferViews(*newBuffer, hasCBV, hasSRV, hasUAV);
 
-        mAllocator->CreateResource(&allocationDesc, &newBuffer->mDesc, resourceState, nullptr, &newBuffer->mAllocation, IID_PPV_ARGS(&newBuffer->mResource));
-        newBuffer->mVirtualAddress = newBuffer->mResource->GetGPUVirtualAddress();
+        if (newBuffer->mSRVDescriptor.IsValid())
+        {
+            newBuffer->mDescriptorHeapIndex = AllocateReservedDescriptorIndex();
+
+            if (newBuffer->mDescriptorHeapIndex != INVALID_RESOURCE_TABLE_INDEX)
+            {
+                CopySRVHandleToReservedTable(newBuffer->mSRVDescriptor, newBuffer->mDescriptorHeapIndex);
+            }
+        }
+
+        if (isHostVisible)
+        {
+            newBuffer->mMappedResource = mBackend->MapResource(*newBuffer);
+        }
+
+        return newBuffer;
+    }
 
+    void Device::CreateBufferViews(BufferResource& buffer, bool hasCBV, bool hasSRV, bool hasUAV)
+    {
         if (hasCBV)
         {
             D3D12_CONSTANT_BUFFER_VIEW_DESC constantBufferViewDesc = {};
-            constantBufferViewDesc.BufferLocation = newBuffer->mResource->GetGPUVirtualAddress();
-            constantBufferViewDesc.SizeInBytes = static_cast<uint32_t>(newBuffer->mDesc.Width);
+            constantBufferViewDesc.BufferLocation = buffer.mVirtualAddress;
+            constantBufferViewDesc.SizeInBytes = static_cast<uint32_t>(buffer.mDesc.Width);
+
+            buffer.mCBVDescriptor = mSRVStagingDescriptorHeap->GetNewDescriptor();
 
-            newBuffer->mCBVDescriptor = mSRVStagingDescriptorHeap->GetNewDescriptor();
-            mDevice->CreateConstantBufferView(&constantBufferViewDesc, newBuffer->mCBVDescriptor.mCPUHandle);
+            if (buffer.mCBVDescriptor.IsValid())
+            {
+                mBackend->CreateConstantBufferView(constantBufferViewDesc, buffer.mCBVDescriptor.mCPUHandle);
+            }
         }
 
         if (hasSRV)
@@ -1405,67 +2638,46 @@ namespace D3D12Lite
             D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
             srvDesc.ViewDimension = D3D12_SRV_DIMENSION_BUFFER;
             srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
-            srvDesc.Format = desc.mIsRawAccess ? DXGI_FORMAT_R32_TYPELESS : DXGI_FORMAT_UNKNOWN;
+            srvDesc.Format = buffer.mIsRawAccess ? DXGI_FORMAT_R32_TYPELESS : DXGI_FORMAT_UNKNOWN;
             srvDesc.Buffer.FirstElement = 0;
-            srvDesc.Buffer.NumElements = static_cast<uint32_t>(desc.mIsRawAccess ? (desc.mSize / 4) : numElements);
-            srvDesc.Buffer.StructureByteStride = desc.mIsRawAccess ? 0 : newBuffer->mStride;
-            srvDesc.Buffer.Flags = desc.mIsRawAccess ? D3D12_BUFFER_SRV_FLAG_RAW : D3D12_BUFFER_SRV_FLAG_NONE;
+            srvDesc.Buffer.NumElements = buffer.mNumElements;
+            srvDesc.Buffer.StructureByteStride = buffer.mIsRawAccess ? 0 : buffer.mStride;
+            srvDesc.Buffer.Flags = buffer.mIsRawAccess ? D3D12_BUFFER_SRV_FLAG_RAW : D3D12_BUFFER_SRV_FLAG_NONE;
 
-            newBuffer->mSRVDescriptor = mSRVStagingDescriptorHeap->GetNewDescriptor();
-            mDevice->CreateShaderResourceView(newBuffer->mResource, &srvDesc, newBuffer->mSRVDescriptor.mCPUHandle);
+            buffer.mSRVDescriptor = mSRVStagingDescriptorHeap->GetNewDescriptor();
 
-            newBuffer->mDescriptorHeapIndex = mFreeReservedDescriptorIndices.back();
-            mFreeReservedDescriptorIndices.pop_back();
-
-            CopySRVHandleToReservedTable(newBuffer->mSRVDescriptor, newBuffer->mDescriptorHeapIndex);
+            if (buffer.mSRVDescriptor.IsValid())
+            {
+                mBackend->CreateShaderResourceView(buffer, &srvDesc, buffer.mSRVDescriptor.mCPUHandle);
+            }
         }
 
         if (hasUAV)
         {
             D3D12_UNORDERED_ACCESS_VIEW_DESC uavDesc = {};
             uavDesc.ViewDimension = D3D12_UAV_DIMENSION_BUFFER;
-            uavDesc.Format = desc.mIsRawAccess ? DXGI_FORMAT_R32_TYPELESS : DXGI_FORMAT_UNKNOWN;
+            uavDesc.Format = buffer.mIsRawAccess ? DXGI_FORMAT_R32_TYPELESS : DXGI_FORMAT_UNKNOWN;
             uavDesc.Buffer.CounterOffsetInBytes = 0;
             uavDesc.Buffer.FirstElement = 0;
-            uavDesc.Buffer.NumElements = static_cast<uint32_t>(desc.mIsRawAccess ? (desc.mSize / 4) : numElements);
-            uavDesc.Buffer.StructureByteStride = desc.mIsRawAccess ? 0 : newBuffer->mStride;
-            uavDesc.Buffer.Flags = desc.mIsRawAccess ? D3D12_BUFFER_UAV_FLAG_RAW : D3D12_BUFFER_UAV_FLAG_NONE;
+            uavDesc.Buffer.NumElements = buffer.mNumElements;
+            uavDesc.Buffer.StructureByteStride = buffer.mIsRawAccess ? 0 : buffer.mStride;
+            uavDesc.Buffer.Flags = buffer.mIsRawAccess ? D3D12_BUFFER_UAV_FLAG_RAW : D3D12_BUFFER_UAV_FLAG_NONE;
 
-            newBuffer->mUAVDescriptor = mSRVStagingDescriptorHeap->GetNewDescriptor();
-            mDevice->CreateUnorderedAccessView(newBuffer->mResource, nullptr, &uavDesc, newBuffer->mUAVDescriptor.mCPUHandle);
-        }
+            buffer.mUAVDescriptor = mSRVStagingDescriptorHeap->GetNewDescriptor();
 
-        if (isHostVisible)
-        {
-            newBuffer->mResource->Map(0, nullptr, reinterpret_cast<void**>(&newBuffer->mMappedResource));
+            if (buffer.mUAVDescriptor.IsValid())
+            {
+                mBackend->CreateUnorderedAccessView(buffer, &uavDesc, buffer.mUAVDescriptor.mCPUHandle);
+            }
         }
-
-        return newBuffer;
     }
 
-    std::unique_ptr<TextureResource> Device::CreateTexture(const TextureCreationDesc& desc)
+    namespace
     {
-        D3D12_RESOURCE_DESC textureDesc = desc.mResourceDesc;
-        textureDesc.Flags = D3D12_RESOURCE_FLAG_NONE;
-
-        bool hasRTV = ((desc.mViewFlags & TextureViewFlags::rtv) == TextureViewFlags::rtv);
-        bool hasDSV = ((desc.mViewFlags & TextureViewFlags::dsv) == TextureViewFlags::dsv);
-        bool hasSRV = ((desc.mViewFlags & TextureViewFlags::srv) == TextureViewFlags::srv);
-        bool hasUAV = ((desc.mViewFlags & TextureViewFlags::uav) == TextureViewFlags::uav);
-
-        D3D12_RESOURCE_STATES resourceState = D3D12_RESOURCE_STATE_COPY_DEST;
-        DXGI_FORMAT resourceFormat = textureDesc.Format;
-        DXGI_FORMAT shaderResourceViewFormat = textureDesc.Format;
-
-        if (hasRTV)
-        {
-            textureDesc.Flags |= D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET;
-            resourceState = D3D12_RESOURCE_STATE_RENDER_TARGET;
-        }
-
-        if (hasDSV)
+        //Depth stencil targets are created typeless so they can be read through an SRV as well.
+        void GetDepthStencilFormats(DXGI_FORMAT depthStencilFormat, DXGI_FORMAT& resourceFormat, DXGI_FORMAT& shaderResourceViewFormat)
         {
-            switch (desc.mResourceDesc.Format)
+            switch (depthStencilFormat)
             {
             case DXGI_FORMAT_D16_UNORM:
                 resourceFormat = DXGI_FORMAT_R16_TYPELESS;
@@ -1487,6 +2699,32 @@ namespace D3D12Lite
                 AssertError("Bad depth stencil format.");
                 break;
             }
+        }
+    }
+
+    std::unique_ptr<TextureResource> Device::CreateTexture(const TextureCreationDesc& desc)
+    {
+        D3D12_RESOURCE_DESC textureDesc = desc.mResourceDesc;
+        textureDesc.Flags = D3D12_RESOURCE_FLAG_NONE;
+
+        bool hasRTV = ((desc.mViewFlags & TextureViewFlags::rtv) == TextureViewFlags::rtv);
+        bool hasDSV = ((desc.mViewFlags & TextureViewFlags::dsv) == TextureViewFlags::dsv);
+        bool hasSRV = ((desc.mViewFlags & TextureViewFlags::srv) == TextureViewFlags::srv);
+        bool hasUAV = ((desc.mViewFlags & TextureViewFlags::uav) == TextureViewFlags::uav);
+
+        D3D12_RESOURCE_STATES resourceState = D3D12_RESOURCE_STATE_COPY_DEST;
+        DXGI_FORMAT resourceFormat = textureDesc.Format;
+
+        if (hasRTV)
+        {
+            textureDesc.Flags |= D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET;
+            resourceState = D3D12_RESOURCE_STATE_RENDER_TARGET;
+        }
+
+        if (hasDSV)
+        {
+            DXGI_FORMAT shaderResourceViewFormat = DXGI_FORMAT_UNKNOWN;
+            GetDepthStencilFormats(desc.mResourceDesc.Format, resourceFormat, shaderResourceViewFormat);
 
             textureDesc.Flags |= D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL;
             resourceState = D3D12_RESOURCE_STATE_DEPTH_WRITE;
@@ -1503,6 +2741,7 @@ namespace D3D12Lite
         std::unique_ptr<TextureResource> newTexture = std::make_unique<TextureResource>();
         newTexture->mDesc = textureDesc;
         newTexture->mState = resourceState;
+        newTexture->mDepthStencilFormat = hasDSV ? desc.mResourceDesc.Format : DXGI_FORMAT_UNKNOWN;
 
         D3D12_CLEAR_VALUE clearValue = {};
         clearValue.Format = desc.mResourceDesc.Format;
@@ -1512,17 +2751,42 @@ namespace D3D12Lite
             clearValue.DepthStencil.Depth = 1.0f;
         }
 
-        D3D12MA::ALLOCATION_DESC allocationDesc{};
-        allocationDesc.HeapType = D3D12_HEAP_TYPE_DEFAULT;
+        mBackend->CreateResource(D3D12_HEAP_TYPE_DEFAULT, nullptr, textureDesc, resourceState, (!hasRTV && !hasDSV) ? nullptr : &clearValue, *newTexture);
+
+        CreateTextureViews(*newTexture, hasRTV, hasSRV, hasUAV);
+
+        if (newTexture->mSRVDescriptor.IsValid())
+        {
+            newTexture->mDescriptorHeapIndex = AllocateReservedDescriptorIndex();
+
+            if (newTexture->mDescriptorHeapIndex != INVALID_RESOURCE_TABLE_INDEX)
+            {
+                CopySRVHandleToReservedTable(newTexture->mSRVDescriptor, newTexture->mDescriptorHeapIndex);
+            }
+        }
+
+        newTexture->mIsReady = (hasRTV || hasDSV);
+
+        return newTexture;
+    }
 
-        mAllocator->CreateResource(&allocationDesc, &textureDesc, resourceState, (!hasRTV && !hasDSV) ? nullptr : &clearValue, &newTexture->mAllocation, IID_PPV_ARGS(&newTexture->mResource));
+    void Device::CreateTextureViews(TextureResource& texture, bool hasRTV, bool hasSRV, bool hasUAV)
+    {
+        const bool hasDSV = texture.mDepthStencilFormat != DXGI_FORMAT_UNKNOWN;
 
         if (hasSRV)
         {
-            newTexture->mSRVDescriptor = mSRVStagingDescriptorHeap->GetNewDescriptor();
+            texture.mSRVDescriptor = mSRVStagingDescriptorHeap->GetNewDescriptor();
+        }
 
+        if (texture.mSRVDescriptor.IsValid())
+        {
             if (hasDSV)
             {
+                DXGI_FORMAT resourceFormat = DXGI_FORMAT_UNKNOWN;
+                DXGI_FORMAT shaderResourceViewFormat = DXGI_FORMAT_UNKNOWN;
+                GetDepthStencilFormats(texture.mDepthStencilFormat, resourceFormat, shaderResourceViewFormat);
+
                 D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
                 srvDesc.Format = shaderResourceViewFormat;
                 srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
@@ -1532,97 +2796,84 @@ namespace D3D12Lite
                 srvDesc.Texture2D.ResourceMinLODClamp = 0.0f;
                 srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
 
-                mDevice->CreateShaderResourceView(newTexture->mResource, &srvDesc, newTexture->mSRVDescriptor.mCPUHandle);
+                mBackend->CreateShaderResourceView(texture, &srvDesc, texture.mSRVDescriptor.mCPUHandle);
             }
             else
             {
                 D3D12_SHADER_RESOURCE_VIEW_DESC* srvDescPointer = nullptr;
                 D3D12_SHADER_RESOURCE_VIEW_DESC shaderResourceViewDesc = {};
-                bool isCubeMap = desc.mResourceDesc.Dimension == D3D12_RESOURCE_DIMENSION_TEXTURE2D && desc.mResourceDesc.DepthOrArraySize == 6;
+                bool isCubeMap = texture.mDesc.Dimension == D3D12_RESOURCE_DIMENSION_TEXTURE2D && texture.mDesc.DepthOrArraySize == 6;
 
                 if (isCubeMap)
                 {
                     shaderResourceViewDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURECUBE;
                     shaderResourceViewDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
                     shaderResourceViewDesc.TextureCube.MostDetailedMip = 0;
-                    shaderResourceViewDesc.TextureCube.MipLevels = desc.mResourceDesc.MipLevels;
+                    shaderResourceViewDesc.TextureCube.MipLevels = texture.mDesc.MipLevels;
                     shaderResourceViewDesc.TextureCube.ResourceMinLODClamp = 0.0f;
                     srvDescPointer = &shaderResourceViewDesc;
                 }
 
-                mDevice->CreateShaderResourceView(newTexture->mResource, srvDescPointer, newTexture->mSRVDescriptor.mCPUHandle);
+                mBackend->CreateShaderResourceView(texture, srvDescPointer, texture.mSRVDescriptor.mCPUHandle);
             }
-
-            newTexture->mDescriptorHeapIndex = mFreeReservedDescriptorIndices.back();
-            mFreeReservedDescriptorIndices.pop_back();
-
-            CopySRVHandleToReservedTable(newTexture->mSRVDescriptor, newTexture->mDescriptorHeapIndex);
         }
 
         if (hasRTV)
         {
-            newTexture->mRTVDescriptor = mRTVStagingDescriptorHeap->GetNewDescriptor();
-            mDevice->CreateRenderTargetView(newTexture->mResource, nullptr, newTexture->mRTVDescriptor.mCPUHandle);
+            texture.mRTVDescriptor = mRTVStagingDescriptorHeap->GetNewDescriptor();
+
+            if (texture.mRTVDescriptor.IsValid())
+            {
+                mBackend->CreateRenderTargetView(texture, nullptr, texture.mRTVDescriptor.mCPUHandle);
+            }
         }
 
         if (hasDSV)
         {
             D3D12_DEPTH_STENCIL_VIEW_DESC dsvDesc = {};
             dsvDesc.Flags = D3D12_DSV_FLAG_NONE;
-            dsvDesc.Format = desc.mResourceDesc.Format;
+            dsvDesc.Format = texture.mDepthStencilFormat;
             dsvDesc.Texture2D.MipSlice = 0;
             dsvDesc.ViewDimension = D3D12_DSV_DIMENSION_TEXTURE2D;
 
-            newTexture->mDSVDescriptor = mDSVStagingDescriptorHeap->GetNewDescriptor();
-            mDevice->CreateDepthStencilView(newTexture->mResource, &dsvDesc, newTexture->mDSVDescriptor.mCPUHandle);
+            texture.mDSVDescriptor = mDSVStagingDescriptorHeap->GetNewDescriptor();
+
+            if (texture.mDSVDescriptor.IsValid())
+            {
+                mBackend->CreateDepthStencilView(texture, &dsvDesc, texture.mDSVDescriptor.mCPUHandle);
+            }
         }
 
         if (hasUAV)
         {
-            newTexture->mUAVDescriptor = mSRVStagingDescriptorHeap->GetNewDescriptor();
-            mDevice->CreateUnorderedAccessView(newTexture->mResource, nullptr, nullptr, newTexture->mUAVDescriptor.mCPUHandle);
-        }
-
-        newTexture->mIsReady = (hasRTV || hasDSV);
+            texture.mUAVDescriptor = mSRVStagingDescriptorHeap->GetNewDescriptor();
 
-        return newTexture;
+            if (texture.mUAVDescriptor.IsValid())
+            {
+                mBackend->CreateUnorderedAccessView(texture, nullptr, texture.mUAVDescriptor.mCPUHandle);
+            }
+        }
     }
 
     std::unique_ptr<TextureResource> Device::CreateTextureFromFile(const std::string& texturePath)
     {
-        auto s2ws = [](const std::string& s)
-        {
-            //yoink https://stackoverflow.com/questions/27220/how-to-convert-stdstring-to-lpcwstr-in-c-unicode
-            int32_t len = 0;
-            int32_t slength = (int32_t)s.length() + 1;
-            len = MultiByteToWideChar(CP_ACP, 0, s.c_str(), slength, 0, 0);
-            wchar_t* buf = new wchar_t[len];
-            MultiByteToWideChar(CP_ACP, 0, s.c_str(), slength, buf, len);
-            std::wstring r(buf);
-            delete[] buf;
-            return r;
-        };
+        return CreateTextureFromFileData(LoadTextureFileData(texturePath));
+    }
 
-        std::unique_ptr<DirectX::ScratchImage> imageData = std::make_unique<DirectX::ScratchImage>();
-        HRESULT loadResult = DirectX::LoadFromDDSFile(s2ws(texturePath).c_str(), DirectX::DDS_FLAGS_NONE, nullptr, *imageData);
-        assert(loadResult == S_OK);
+    std::unique_ptr<TextureResource> Device::CreateTextureFromFileData(const TextureFileData& fileData, uint32_t firstMip, UploadPriority priority)
+    {
+        const D3D12_RESOURCE_DESC& fileDesc = fileData.mResourceDesc;
+        assert(firstMip < fileDesc.MipLevels);
 
-        const DirectX::TexMetadata& textureMetaData = imageData->GetMetadata();
-        DXGI_FORMAT textureFormat = textureMetaData.format;
-        bool is3DTexture = textureMetaData.dimension == DirectX::TEX_DIMENSION_TEXTURE3D;
+        const bool is3DTexture = fileDesc.Dimension == D3D12_RESOURCE_DIMENSION_TEXTURE3D;
+        const uint32_t arraySize = is3DTexture ? 1 : fileDesc.DepthOrArraySize;
 
         TextureCreationDesc desc;
-        desc.mResourceDesc.Format = textureFormat;
-        desc.mResourceDesc.Width = textureMetaData.width;
-        desc.mResourceDesc.Height = static_cast<UINT>(textureMetaData.height);
-        desc.mResourceDesc.Flags = D3D12_RESOURCE_FLAG_NONE;
-        desc.mResourceDesc.DepthOrArraySize = static_cast<UINT16>(is3DTexture ? textureMetaData.depth : textureMetaData.arraySize);
-        desc.mResourceDesc.MipLevels = static_cast<UINT16>(textureMetaData.mipLevels);
-        desc.mResourceDesc.SampleDesc.Count = 1;
-        desc.mResourceDesc.SampleDesc.Quality = 0;
-        desc.mResourceDesc.Dimension = is3DTexture ? D3D12_RESOURCE_DIMENSION_TEXTURE3D : D3D12_RESOURCE_DIMENSION_TEXTURE2D;
-        desc.mResourceDesc.Layout = D3D12_TEXTURE_LAYOUT_UNKNOWN;
-        desc.mResourceDesc.Alignment = 0;
+        desc.mResourceDesc = fileDesc;
+        desc.mResourceDesc.Width = (std::max)(fileDesc.Width >> firstMip, static_cast<uint64_t>(1));
+        desc.mResourceDesc.Height = (std::max)(fileDesc.Height >> firstMip, 1u);
+        desc.mResourceDesc.DepthOrArraySize = is3DTexture ? static_cast<UINT16>((std::max)(fileDesc.DepthOrArraySize >> firstMip, 1)) : fileDesc.DepthOrArraySize;
+        desc.mResourceDesc.MipLevels = static_cast<UINT16>(fileDesc.MipLevels - firstMip);
         desc.mViewFlags = TextureViewFlags::srv;
 
         auto newTexture = CreateTexture(desc);
@@ -1632,36 +2883,26 @@ namespace D3D12Lite
         uint64_t rowSizesInBytes[MAX_TEXTURE_SUBRESOURCE_COUNT];
 
         textureUpload->mTexture = newTexture.get();
-        textureUpload->mNumSubResources = static_cast<uint32_t>(textureMetaData.mipLevels * textureMetaData.arraySize);
+        textureUpload->mNumSubResources = desc.mResourceDesc.MipLevels * arraySize;
+        textureUpload->mPriority = priority;
+        assert(textureUpload->mNumSubResources <= MAX_TEXTURE_SUBRESOURCE_COUNT);
 
-        mDevice->GetCopyableFootprints(&desc.mResourceDesc, 0, textureUpload->mNumSubResources, 0, textureUpload->mSubResourceLayouts.data(), numRows, rowSizesInBytes, &textureUpload->mTextureDataSize);
+        mBackend->GetCopyableFootprints(desc.mResourceDesc, 0, textureUpload->mNumSubResources, 0, textureUpload->mSubResourceLayouts.data(), numRows, rowSizesInBytes, &textureUpload->mTextureDataSize);
 
-        textureUpload->mTextureData = std::make_unique<uint8_t[]>(textureUpload->mTextureDataSize);
+        textureUpload->mSourceOwner = fileData.mSourceOwner;
+        textureUpload->mSubResourceSources.resize(textureUpload->mNumSubResources);
 
-        for (uint64_t arrayIndex = 0; arrayIndex < textureMetaData.arraySize; arrayIndex++)
+        for (uint32_t arrayIndex = 0; arrayIndex < arraySize; arrayIndex++)
         {
-            for (uint64_t mipIndex = 0; mipIndex < textureMetaData.mipLevels; mipIndex++)
+            for (uint32_t mipIndex = 0; mipIndex < desc.mResourceDesc.MipLevels; mipIndex++)
             {
-                const uint64_t subResourceIndex = mipIndex + (arrayIndex * textureMetaData.mipLevels);
+                const uint32_t subResourceIndex = mipIndex + (arrayIndex * desc.mResourceDesc.MipLevels);
+                const uint32_t fileSubResourceIndex = (firstMip + mipIndex) + (arrayIndex * fileDesc.MipLevels);
 
-                const D3D12_PLACED_SUBRESOURCE_FOOTPRINT& subResourceLayout = textureUpload->mSubResourceLayouts[subResourceIndex];
-                const uint64_t subResourceHeight = numRows[subResourceIndex];
-                const uint64_t subResourcePitch = AlignU32(subResourceLayout.Footprint.RowPitch, D3D12_TEXTURE_DATA_PITCH_ALIGNMENT);
-                const uint64_t subResourceDepth = subResourceLayout.Footprint.Depth;
-                uint8_t* destinationSubResourceMemory = textureUpload->mTextureData.get() + subResourceLayout.Offset;
-
-                for (uint64_t sliceIndex = 0; sliceIndex < subResourceDepth; sliceIndex++)
-                {
-                    const DirectX::Image* subImage = imageData->GetImage(mipIndex, arrayIndex, sliceIndex);
-                    const uint8_t* sourceSubResourceMemory = subImage->pixels;
-
-                    for (uint64_t height = 0; height < subResourceHeight; height++)
-                    {
-                        memcpy(destinationSubResourceMemory, sourceSubResourceMemory, (std::min)(subResourcePitch, subImage->rowPitch));
-                        destinationSubResourceMemory += subResourcePitch;
-                        sourceSubResourceMemory += subImage->rowPitch;
-                    }
-                }
+                TextureUploadSource& subResourceSource = textureUpload->mSubResourceSources[subResourceIndex];
+                subResourceSource = fileData.mSubResourceSources[fileSubResourceIndex];
+                subResourceSource.mRowSize = (std::min)(static_cast<size_t>(rowSizesInBytes[subResourceIndex]), subResourceSource.mRowPitch);
+                subResourceSource.mNumRows = numRows[subResourceIndex];
             }
         }
 
@@ -1672,132 +2913,53 @@ namespace D3D12Lite
 
     std::unique_ptr<Shader> Device::CreateShader(const ShaderCreationDesc& desc)
     {
-        IDxcUtils* dxcUtils = nullptr;
-        IDxcCompiler3* dxcCompiler = nullptr;
-        IDxcIncludeHandler* dxcIncludeHandler = nullptr;
-
-        DxcCreateInstance(CLSID_DxcUtils, IID_PPV_ARGS(&dxcUtils));
-        DxcCreateInstance(CLSID_DxcCompiler, IID_PPV_ARGS(&dxcCompiler));
-        dxcUtils->CreateDefaultIncludeHandler(&dxcIncludeHandler);
-
-        std::wstring sourcePath;
-        sourcePath.append(SHADER_SOURCE_PATH);
-        sourcePath.append(desc.mShaderName);
-
-        IDxcBlobEncoding* sourceBlobEncoding = nullptr;
-        dxcUtils->LoadFile(sourcePath.c_str(), nullptr, &sourceBlobEncoding);
-
-        DxcBuffer sourceBuffer{};
-        sourceBuffer.Ptr = sourceBlobEncoding->GetBufferPointer();
-        sourceBuffer.Size = sourceBlobEncoding->GetBufferSize();
-        sourceBuffer.Encoding = DXC_CP_ACP;
-
-        LPCWSTR target = nullptr;
+        ShaderCompileRequest request;
+        request.mSourcePath = SHADER_SOURCE_PATH;
+        request.mSourcePath /= desc.mShaderName;
+        request.mSourceName = desc.mShaderName;
+        request.mEntryPoint = desc.mEntryPoint;
 
         switch (desc.mType)
         {
         case ShaderType::vertex:
-            target = L"vs_6_6";
+            request.mTarget = L"vs_6_6";
             break;
         case ShaderType::pixel:
-            target = L"ps_6_6";
+            request.mTarget = L"ps_6_6";
             break;
         case ShaderType::compute:
-            target = L"cs_6_6";
+            request.mTarget = L"cs_6_6";
             break;
         default:
             AssertError("Unimplemented shader type.");
             break;
         }
 
-        std::vector<LPCWSTR> arguments;
-        arguments.reserve(8);
-
-        arguments.push_back(desc.mShaderName.c_str());
-        arguments.push_back(L"-E");
-        arguments.push_back(desc.mEntryPoint.c_str());
-        arguments.push_back(L"-T");
-        arguments.push_back(target);
-        arguments.push_back(L"-Zi");
-        arguments.push_back(L"-WX");
-        arguments.push_back(L"-Qstrip_reflect");
-
-        IDxcResult* compilationResults = nullptr;
-        dxcCompiler->Compile(&sourceBuffer, arguments.data(), static_cast<uint32_t>(arguments.size()), dxcIncludeHandler, IID_PPV_ARGS(&compilationResults));
-
-        IDxcBlobUtf8* errors = nullptr;
-        HRESULT getCompilationResults = compilationResults->GetOutput(DXC_OUT_ERRORS, IID_PPV_ARGS(&errors), nullptr);
-
-        if (FAILED(getCompilationResults))
-        {
-            AssertError("Failed to get compilation result.");
-        }
-
-        if (errors != nullptr && errors->GetStringLength() != 0)
-        {
-            wprintf(L"Shader compilation error:\n%S\n", errors->GetStringPointer());
-            AssertError("Shader compilation error");
-        }
-
-        HRESULT statusResult;
-        compilationResults->GetStatus(&statusResult);
-        if (FAILED(statusResult))
-        {
-            AssertError("Shader compilation failed");
-        }
-
-        std::wstring dxilPath;
-        std::wstring pdbPath;
-
-        dxilPath.append(SHADER_OUTPUT_PATH);
-        dxilPath.append(desc.mShaderName);
-        dxilPath.erase(dxilPath.end() - 5, dxilPath.end());
-        dxilPath.append(L".dxil");
-
-        pdbPath = dxilPath;
-        pdbPath.append(L".pdb");
-
-        IDxcBlob* shaderBlob = nullptr;
-        compilationResults->GetOutput(DXC_OUT_OBJECT, IID_PPV_ARGS(&shaderBlob), nullptr);
-        if (shaderBlob != nullptr)
-        {
-            FILE* fp = nullptr;
-
-            _wfopen_s(&fp, dxilPath.c_str(), L"wb");
-            assert(fp);
-
-            fwrite(shaderBlob->GetBufferPointer(), shaderBlob->GetBufferSize(), 1, fp);
-            fclose(fp);
-        }
-
-        IDxcBlob* pdbBlob = nullptr;
-        compilationResults->GetOutput(DXC_OUT_PDB, IID_PPV_ARGS(&pdbBlob), nullptr);
+        for (const std::wstring& define : desc.mDefines)
         {
-            FILE* fp = nullptr;
-
-            _wfopen_s(&fp, pdbPath.c_str(), L"wb");
-
-            assert(fp);
-
-            fwrite(pdbBlob->GetBufferPointer(), pdbBlob->GetBufferSize(), 1, fp);
-            fclose(fp);
+            request.mArguments.push_back(L"-D" + define);
         }
 
-        SafeRelease(pdbBlob);
-        SafeRelease(errors);
-        SafeRelease(compilationResults);
-        SafeRelease(dxcIncludeHandler);
-        SafeRelease(dxcCompiler);
-        SafeRelease(dxcUtils);
+        request.mArguments.push_back(L"-Zi");
+        request.mArguments.push_back(L"-WX");
+        request.mArguments.push_back(L"-Qstrip_reflect");
 
         std::unique_ptr<Shader> shader = std::make_unique<Shader>();
-        shader->mShaderBlob = shaderBlob;
+        shader->mCompilation = mShaderCache->Request(request);
 
         return shader;
     }
 
-    ID3D12RootSignature* Device::CreateRootSignature(const PipelineResourceLayout& layout, PipelineResourceMapping& resourceMapping)
+    ID3D12RootSignature* Device::CreateRootSignature(const PipelineResourceLayout& layout, PipelineResourceMapping& resourceMapping, PipelineCacheKey& rootSignatureKey)
     {
+        rootSignatureKey = GetRootSignatureKey(layout);
+
+        ID3D12RootSignature* rootSignature = nullptr;
+        if (mPipelineCache->FindRootSignature(rootSignatureKey, rootSignature, resourceMapping))
+        {
+            return rootSignature;
+        }
+
         std::vector<D3D12_ROOT_PARAMETER1> rootParameters;
         std::array<std::vector<D3D12_DESCRIPTOR_RANGE1>, NUM_RESOURCE_SPACES> desciptorRanges;
 
@@ -1808,11 +2970,10 @@ namespace D3D12Lite
 
             if (currentSpace)
             {
-                const BufferResource* cbv = currentSpace->GetCBV();
                 auto& uavs = currentSpace->GetUAVs();
                 auto& srvs = currentSpace->GetSRVs();
 
-                if (cbv)
+                if (currentSpace->HasCBV())
                 {
                     D3D12_ROOT_PARAMETER1 rootParameter{};
                     rootParameter.ParameterType = D3D12_ROOT_PARAMETER_TYPE_CBV;
@@ -1874,14 +3035,7 @@ namespace D3D12Lite
         rootSignatureDesc.Desc_1_1.Flags = D3D12_ROOT_SIGNATURE_FLAG_CBV_SRV_UAV_HEAP_DIRECTLY_INDEXED | D3D12_ROOT_SIGNATURE_FLAG_SAMPLER_HEAP_DIRECTLY_INDEXED;
         rootSignatureDesc.Version = D3D_ROOT_SIGNATURE_VERSION_1_1;
 
-        ID3DBlob* rootSignatureBlob = nullptr;
-        ID3DBlob* errorBlob = nullptr;
-        AssertIfFailed(D3D12SerializeVersionedRootSignature(&rootSignatureDesc, &rootSignatureBlob, &errorBlob));
-
-        ID3D12RootSignature* rootSignature = nullptr;
-        AssertIfFailed(mDevice->CreateRootSignature(0, rootSignatureBlob->GetBufferPointer(), rootSignatureBlob->GetBufferSize(), IID_PPV_ARGS(&rootSignature)));
-
-        return rootSignature;
+        return mPipelineCache->AddRootSignature(rootSignatureKey, mBackend->CreateRootSignature(rootSignatureDesc), resourceMapping);
     }
 
     std::unique_ptr<PipelineStateObject> Device::CreateGraphicsPipeline(const GraphicsPipelineDesc& desc, const PipelineResourceLayout& layout)
@@ -1906,25 +3060,21 @@ namespace D3D12Lite
 
         if (desc.mVertexShader)
         {
-            pipelineDesc.VS.pShaderBytecode = desc.mVertexShader->mShaderBlob->GetBufferPointer();
-            pipelineDesc.VS.BytecodeLength = desc.mVertexShader->mShaderBlob->GetBufferSize();
+            pipelineDesc.VS = GetShaderByteCode(*desc.mVertexShader);
         }
 
         if (desc.mPixelShader)
         {
-            pipelineDesc.PS.pShaderBytecode = desc.mPixelShader->mShaderBlob->GetBufferPointer();
-            pipelineDesc.PS.BytecodeLength = desc.mPixelShader->mShaderBlob->GetBufferSize();
+            pipelineDesc.PS = GetShaderByteCode(*desc.mPixelShader);
         }
 
         std::unique_ptr<PipelineStateObject> newPipeline = std::make_unique<PipelineStateObject>();
         newPipeline->mPipelineType = PipelineType::graphics;
         
-        pipelineDesc.pRootSignature = CreateRootSignature(layout, newPipeline->mPipelineResourceMapping);
-
-        ID3D12PipelineState* graphicsPipeline = nullptr;
-        AssertIfFailed(mDevice->CreateGraphicsPipelineState(&pipelineDesc, IID_PPV_ARGS(&graphicsPipeline)));
+        PipelineCacheKey rootSignatureKey;
+        pipelineDesc.pRootSignature = CreateRootSignature(layout, newPipeline->mPipelineResourceMapping, rootSignatureKey);
 
-        newPipeline->mPipeline = graphicsPipeline;
+        newPipeline->mPipeline = mPipelineCache->GetGraphicsPipeline(pipelineDesc, GetGraphicsPipelineKey(pipelineDesc, rootSignatureKey));
         newPipeline->mRootSignature = pipelineDesc.pRootSignature;
 
         return newPipeline;
@@ -1937,14 +3087,11 @@ namespace D3D12Lite
 
         D3D12_COMPUTE_PIPELINE_STATE_DESC pipelineDesc{};
         pipelineDesc.NodeMask = 0;
-        pipelineDesc.CS.pShaderBytecode = desc.mComputeShader->mShaderBlob->GetBufferPointer();
-        pipelineDesc.CS.BytecodeLength = desc.mComputeShader->mShaderBlob->GetBufferSize();
-        pipelineDesc.pRootSignature = CreateRootSignature(layout, newPipeline->mPipelineResourceMapping);
+        pipelineDesc.CS = GetShaderByteCode(*desc.mComputeShader);
+        PipelineCacheKey rootSignatureKey;
+        pipelineDesc.pRootSignature = CreateRootSignature(layout, newPipeline->mPipelineResourceMapping, rootSignatureKey);
 
-        ID3D12PipelineState* computePipeline = nullptr;
-        AssertIfFailed(mDevice->CreateComputePipelineState(&pipelineDesc, IID_PPV_ARGS(&computePipeline)));
-
-        newPipeline->mPipeline = computePipeline;
+        newPipeline->mPipeline = mPipelineCache->GetComputePipeline(pipelineDesc, GetComputePipelineKey(pipelineDesc, rootSignatureKey));
         newPipeline->mRootSignature = pipelineDesc.pRootSignature;
 
         return newPipeline;
@@ -1964,19 +3111,302 @@ namespace D3D12Lite
         return newComputeContext;
     }
 
+    GraphicsContext& Device::AcquireGraphicsContext()
+    {
+        GraphicsContext* context = nullptr;
+
+        {
+            std::lock_guard<std::mutex> lockGuard(mContextPoolMutex);
+
+            auto& contextPool = mGraphicsContextPools[mFrameId];
+            uint32_t& numAcquiredContexts = mNumAcquiredGraphicsContexts[mFrameId];
+
+            if (numAcquiredContexts == contextPool.size())
+            {
+                contextPool.push_back(CreateGraphicsContext());
+            }
+
+            context = contextPool[numAcquiredContexts].get();
+            numAcquiredContexts++;
+        }
+
+        context->Reset();
+
+        return *context;
+    }
+
+    TransientConstantBuffer Device::AllocateTransientConstantBuffer(uint32_t size)
+    {
+        assert(size > 0);
+
+        const uint32_t alignedSize = AlignU32(size, D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT);
+        const uint32_t offset = mTransientConstantBufferOffset.fetch_add(alignedSize, std::memory_order_relaxed);
+
+        TransientConstantBuffer constantBuffer;
+
+        if (offset + alignedSize > TRANSIENT_CONSTANT_BUFFER_SIZE)
+        {
+            AssertError("Ran out of transient constant buffer memory this frame, need to increase TRANSIENT_CONSTANT_BUFFER_SIZE.");
+            return constantBuffer;
+        }
+
+        BufferResource& ringBuffer = *mTransientConstantBuffers[mFrameId];
+        constantBuffer.mMappedData = ringBuffer.mMappedResource + offset;
+        constantBuffer.mVirtualAddress = ringBuffer.mVirtualAddress + offset;
+        constantBuffer.mSize = alignedSize;
+
+        return constantBuffer;
+    }
+
+    D3D12MA::Pool* Device::CreateLinearBufferPool(uint64_t size, BufferAccessFlags accessFlags)
+    {
+        assert(size > 0);
+
+        bool isHostVisible = ((accessFlags & BufferAccessFlags::hostWritable) == BufferAccessFlags::hostWritable);
+
+        return mBackend->CreateLinearBufferPool(isHostVisible ? D3D12_HEAP_TYPE_UPLOAD : D3D12_HEAP_TYPE_DEFAULT, size);
+    }
+
     void Device::DestroyBuffer(std::unique_ptr<BufferResource> buffer)
     {
+        //Keeps defragmentation from moving it while the destruction is pending.
+        buffer->mIsReady = false;
         mDestructionQueues[mFrameId].mBuffersToDestroy.push_back(std::move(buffer));
     }
 
+    void Device::DestroyBufferPool(D3D12MA::Pool* pool)
+    {
+        if (pool)
+        {
+            mDestructionQueues[mFrameId].mBufferPoolsToDestroy.push_back(pool);
+        }
+    }
+
     void Device::DestroyTexture(std::unique_ptr<TextureResource> texture)
     {
+        texture->mIsReady = false;
         mDestructionQueues[mFrameId].mTexturesToDestroy.push_back(std::move(texture));
     }
 
+    void Device::SwapTextureStorage(TextureResource& texture, std::unique_ptr<TextureResource> newStorage)
+    {
+        assert(texture.mDescriptorHeapIndex != INVALID_RESOURCE_TABLE_INDEX && newStorage->mSRVDescriptor.IsValid());
+
+        //After the swap the old storage owns the index newStorage was created with, which goes back to the free list
+        //together with the old resource. The texture keeps the new allocation, whose private data still points at
+        //newStorage until it is updated.
+        std::swap(texture, *newStorage);
+        std::swap(texture.mDescriptorHeapIndex, newStorage->mDescriptorHeapIndex);
+        mBackend->UpdateResourceOwner(texture);
+        mBackend->UpdateResourceOwner(*newStorage);
+
+        PatchReservedDescriptor(texture.mDescriptorHeapIndex, texture.mSRVDescriptor);
+
+        mDestructionQueues[mFrameId].mTexturesToDestroy.push_back(std::move(newStorage));
+    }
+
+    void Device::PatchReservedDescriptor(uint32_t index, Descriptor srvHandle)
+    {
+        //Only this frame's table is safe to write, the other ones may still be read by frames in flight.
+        Descriptor targetDescriptor = mSRVRenderPassDescriptorHeaps[mFrameId]->GetReservedDescriptor(index);
+        CopyDescriptorsSimple(1, targetDescriptor.mCPUHandle, srvHandle.mCPUHandle, D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+
+        for (uint32_t frameIndex = 0; frameIndex < NUM_FRAMES_IN_FLIGHT; frameIndex++)
+        {
+            if (frameIndex != mFrameId)
+            {
+                mPendingReservedDescriptorPatches[frameIndex].push_back(std::make_pair(index, srvHandle));
+            }
+        }
+    }
+
+    void Device::BeginResourceDefragmentation(uint64_t maxBytesPerPass, uint32_t maxResourcesPerPass)
+    {
+        if (mIsDefragmentingResources)
+        {
+            return;
+        }
+
+        mDefragmentationStatistics = DefragmentationStatistics{};
+        mIsDefragmentingResources = mBackend->BeginDefragmentation(maxBytesPerPass, maxResourcesPerPass);
+    }
+
+    void Device::UpdateResourceDefragmentation()
+    {
+        if (!mIsDefragmentingResources)
+        {
+            return;
+        }
+
+        if (mIsDefragmentationPassInFlight)
+        {
+            //The copies went out when this frame slot came around last, so the GPU is done with the old places now.
+            if (mDefragmentationPassFrameId != mFrameId)
+            {
+                return;
+            }
+
+            mIsDefragmentationPassInFlight = false;
+
+            if (!mBackend->EndDefragmentationPass(mDefragmentationStatistics))
+            {
+                EndResourceDefragmentation();
+                return;
+            }
+        }
+
+        if (!mBackend->BeginDefragmentationPass(mDefragmentationMoves))
+        {
+            EndResourceDefragmentation();
+            return;
+        }
+
+        GraphicsContext* context = nullptr;
+
+        for (uint32_t moveIndex = 0; moveIndex < mDefragmentationMoves.size(); moveIndex++)
+        {
+            Resource* resource = mDefragmentationMoves[moveIndex];
+
+            //Mapped buffers would change their address under the caller, and resources that are not ready may still get
+            //an upload recorded into the old place.
+            if (resource == nullptr || !resource->mIsReady ||
+                (resource->mType == GPUResourceType::buffer && static_cast<BufferResource*>(resource)->mMappedResource != nullptr))
+            {
+                continue;
+            }
+
+            if (context == nullptr)
+            {
+                context = &AcquireGraphicsContext();
+            }
+
+            MoveResource(*context, moveIndex, *resource);
+        }
+
+        if (context == nullptr)
+        {
+            //Nothing was copied, so the pass can end right away and frees nothing.
+            mBackend->EndDefragmentationPass(mDefragmentationStatistics);
+            EndResourceDefragmentation();
+            return;
+        }
+
+        SubmitContextWork(*context);
+
+        mIsDefragmentationPassInFlight = true;
+        mDefragmentationPassFrameId = mFrameId;
+    }
+
+    void Device::MoveResource(GraphicsContext& context, uint32_t moveIndex, Resource& resource)
+    {
+        //Moves run at the start of the frame before anything else records, so the states in the resource are the current ones.
+        const D3D12_RESOURCE_STATES oldState = resource.mState;
+        const std::vector<D3D12_RESOURCE_STATES> oldSubresourceStates = resource.mSubresourceStates;
+
+        context.TrackCurrentState(resource);
+        context.AddBarrier(resource, D3D12_RESOURCE_STATE_COPY_SOURCE);
+        context.FlushBarriers();
+
+        //The new storage takes over the views and keeps the allocation and bindless index of the old one, which is
+        //destroyed once this frame slot comes around again, together with the end of the pass.
+        if (resource.mType == GPUResourceType::buffer)
+        {
+            BufferResource& buffer = static_cast<BufferResource&>(resource);
+
+            std::unique_ptr<BufferResource> newStorage = std::make_unique<BufferResource>();
+            newStorage->mDesc = buffer.mDesc;
+            newStorage->mStride = buffer.mStride;
+            newStorage->mNumElements = buffer.mNumElements;
+            newStorage->mIsRawAccess = buffer.mIsRawAccess;
+            newStorage->mState = D3D12_RESOURCE_STATE_COPY_DEST;
+            newStorage->mIsReady = true;
+
+            mBackend->CreateDefragmentationDestination(moveIndex, newStorage->mDesc, newStorage->mState, nullptr, *newStorage);
+            CreateBufferViews(*newStorage, buffer.mCBVDescriptor.IsValid(), buffer.mSRVDescriptor.IsValid(), buffer.mUAVDescriptor.IsValid());
+
+            context.CopyResource(*newStorage, buffer);
+
+            std::swap(buffer, *newStorage);
+            std::swap(buffer.mAllocation, newStorage->mAllocation);
+            std::swap(buffer.mDescriptorHeapIndex, newStorage->mDescriptorHeapIndex);
+
+            if (buffer.mSRVDescriptor.IsValid())
+            {
+                PatchReservedDescriptor(buffer.mDescriptorHeapIndex, buffer.mSRVDescriptor);
+            }
+
+            mDestructionQueues[mFrameId].mBuffersToDestroy.push_back(std::move(newStorage));
+        }
+        else
+        {
+            TextureResource& texture = static_cast<TextureResource&>(resource);
+
+            std::unique_ptr<TextureResource> newStorage = std::make_unique<TextureResource>();
+            newStorage->mDesc = texture.mDesc;
+            newStorage->mDepthStencilFormat = texture.mDepthStencilFormat;
+            newStorage->mState = D3D12_RESOURCE_STATE_COPY_DEST;
+            newStorage->mIsReady = true;
+
+            const bool hasRTV = texture.mRTVDescriptor.IsValid();
+            const bool hasDSV = texture.mDSVDescriptor.IsValid();
+
+            D3D12_CLEAR_VALUE clearValue = {};
+            clearValue.Format = hasDSV ? texture.mDepthStencilFormat : texture.mDesc.Format;
+
+            if (hasDSV)
+            {
+                clearValue.DepthStencil.Depth = 1.0f;
+            }
+
+            mBackend->CreateDefragmentationDestination(moveIndex, newStorage->mDesc, newStorage->mState, (!hasRTV && !hasDSV) ? nullptr : &clearValue, *newStorage);
+            CreateTextureViews(*newStorage, hasRTV, texture.mSRVDescriptor.IsValid(), texture.mUAVDescriptor.IsValid());
+
+            context.CopyResource(*newStorage, texture);
+
+            std::swap(texture, *newStorage);
+            std::swap(texture.mAllocation, newStorage->mAllocation);
+            std::swap(texture.mDescriptorHeapIndex, newStorage->mDescriptorHeapIndex);
+
+            if (texture.mSRVDescriptor.IsValid())
+            {
+                PatchReservedDescriptor(texture.mDescriptorHeapIndex, texture.mSRVDescriptor);
+            }
+
+            mDestructionQueues[mFrameId].mTexturesToDestroy.push_back(std::move(newStorage));
+        }
+
+        //The swapped in storage starts out in COPY_DEST.
+        context.TrackCurrentState(resource);
+
+        if (oldSubresourceStates.empty())
+        {
+            context.AddBarrier(resource, oldState);
+        }
+        else
+        {
+            for (uint32_t subresourceIndex = 0; subresourceIndex < oldSubresourceStates.size(); subresourceIndex++)
+            {
+                context.AddBarrier(resource, oldSubresourceStates[subresourceIndex], subresourceIndex);
+            }
+        }
+
+        context.FlushBarriers();
+    }
+
+    void Device::EndResourceDefragmentation()
+    {
+        mBackend->EndDefragmentation(mDefragmentationStatistics);
+        mIsDefragmentingResources = false;
+        mIsDefragmentationPassInFlight = false;
+    }
+
     void Device::DestroyShader(std::unique_ptr<Shader> shader)
     {
-        SafeRelease(shader->mShaderBlob);
+        //Pipelines keep their own copy of the bytecode, so a shader can go as soon as its compile is done.
+        if (shader->mCompilation.valid())
+        {
+            shader->mCompilation.wait();
+        }
     }
 
     void Device::DestroyPipelineStateObject(std::unique_ptr<PipelineStateObject> pso)
@@ -1991,33 +3421,74 @@ namespace D3D12Lite
 
     ContextSubmissionResult Device::SubmitContextWork(Context& context)
     {
-        uint64_t fenceResult = 0;
+        Context* contexts[] = { &context };
 
-        switch (context.GetCommandType())
+        return SubmitContextWork(contexts, 1);
+    }
+
+    ContextSubmissionResult Device::SubmitContextWork(Context* const* contexts, uint32_t numContexts)
+    {
+        assert(numContexts > 0 && numContexts <= MAX_BATCHED_CONTEXTS);
+
+        const D3D12_COMMAND_LIST_TYPE commandType = contexts[0]->GetCommandType();
+        std::array<CommandRecorder*, MAX_BATCHED_COMMAND_LISTS> commandRecorders{};
+        uint32_t numCommandRecorders = 0;
+
+        for (uint32_t contextIndex = 0; contextIndex < numContexts; contextIndex++)
         {
-        case D3D12_COMMAND_LIST_TYPE_DIRECT:
-            fenceResult = mGraphicsQueue->ExecuteCommandList(context.GetCommandList());
-            break;
-        case D3D12_COMMAND_LIST_TYPE_COMPUTE:
-            fenceResult = mComputeQueue->ExecuteCommandList(context.GetCommandList());
-            break;
-        case D3D12_COMMAND_LIST_TYPE_COPY:
-            fenceResult = mCopyQueue->ExecuteCommandList(context.GetCommandList());
-            break;
-        default:
-            AssertError("Unsupported submission type.");
-            break;
+            Context& context = *contexts[contextIndex];
+            assert(context.GetCommandType() == commandType);
+            assert(!context.HasPendingSplitBarriers());
+
+            context.FlushBarriers();
+
+            //Resolved in submission order, so each context starts from the states the ones before it in the batch left.
+            if (CommandRecorder* pendingBarrierRecorder = context.ResolvePendingBarriers())
+            {
+                commandRecorders[numCommandRecorders++] = pendingBarrierRecorder;
+            }
+
+            commandRecorders[numCommandRecorders++] = &context.GetCommandRecorder();
+
+            const BarrierStatistics& barrierStatistics = context.GetBarrierStatistics();
+            mBarrierStatistics.mNumBarriersIssued += barrierStatistics.mNumBarriersIssued;
+            mBarrierStatistics.mNumBarriersElided += barrierStatistics.mNumBarriersElided;
+            mBarrierStatistics.mNumBarrierBatches += barrierStatistics.mNumBarrierBatches;
+
+            const StateFilterStatistics& stateFilterStatistics = context.GetStateFilterStatistics();
+            mStateFilterStatistics.mNumStateCallsIssued += stateFilterStatistics.mNumStateCallsIssued;
+            mStateFilterStatistics.mNumStateCallsSkipped += stateFilterStatistics.mNumStateCallsSkipped;
+            mStateFilterStatistics.mNumDescriptorTablesReused += stateFilterStatistics.mNumDescriptorTablesReused;
         }
 
+        //One fence for the whole batch, the queue executes the lists in the order they were passed in.
+        uint64_t fenceResult = GetQueue(commandType).ExecuteCommandLists(numCommandRecorders, commandRecorders.data());
+
         ContextSubmissionResult submissionResult;
         submissionResult.mFrameId = mFrameId;
         submissionResult.mSubmissionIndex = static_cast<uint32_t>(mContextSubmissions[mFrameId].size());
 
-        mContextSubmissions[mFrameId].push_back(std::make_pair(fenceResult, context.GetCommandType()));
+        mContextSubmissions[mFrameId].push_back(std::make_pair(fenceResult, commandType));
 
         return submissionResult;
     }
 
+    Queue& Device::GetQueue(D3D12_COMMAND_LIST_TYPE commandType)
+    {
+        switch (commandType)
+        {
+        case D3D12_COMMAND_LIST_TYPE_DIRECT:
+            return *mGraphicsQueue;
+        case D3D12_COMMAND_LIST_TYPE_COMPUTE:
+            return *mComputeQueue;
+        case D3D12_COMMAND_LIST_TYPE_COPY:
+            return *mCopyQueue;
+        default:
+            AssertError("Unsupported submission type.");
+            return *mGraphicsQueue;
+        }
+    }
+
     void Device::WaitOnContextWork(ContextSubmissionResult submission, ContextWaitType waitType)
     {
         std::pair<uint64_t, D3D12_COMMAND_LIST_TYPE> contextSubmission = mContextSubmissions[submission.mFrameId][submission.mSubmissionIndex];
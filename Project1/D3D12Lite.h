@@ -4,9 +4,16 @@
 #include <cstdint>
 #include <array>
 #include <vector>
+#include <deque>
 #include <mutex>
+#include <future>
+#include <atomic>
 #include <optional>
+#include <unordered_map>
+#include <memory>
 #include "SimpleMath/SimpleMath.h"
+#include "D3D12LiteWorkerPool.h"
+#include "D3D12LiteShaderCache.h"
 
 using namespace DirectX::SimpleMath;
 struct IDxcBlob;
@@ -15,6 +22,7 @@ namespace D3D12MA
 {
     class Allocator;
     class Allocation;
+    class Pool;
 }
 
 namespace D3D12Lite
@@ -25,19 +33,33 @@ namespace D3D12Lite
     constexpr uint32_t NUM_DSV_STAGING_DESCRIPTORS = 32;
     constexpr uint32_t NUM_SRV_STAGING_DESCRIPTORS = 4096;
     constexpr uint32_t NUM_SAMPLER_DESCRIPTORS = 6;
+    constexpr uint32_t MAX_STAGING_DESCRIPTOR_BATCH_SIZE = 32;
     constexpr uint32_t MAX_QUEUED_BARRIERS = 16;
+    constexpr uint32_t MAX_DESCRIPTORS_PER_TABLE = 16;
     constexpr uint8_t PER_OBJECT_SPACE = 0;
     constexpr uint8_t PER_MATERIAL_SPACE = 1;
     constexpr uint8_t PER_PASS_SPACE = 2;
     constexpr uint8_t PER_FRAME_SPACE = 3;
     constexpr uint8_t NUM_RESOURCE_SPACES = 4;
+    constexpr uint32_t MAX_ROOT_PARAMETERS = NUM_RESOURCE_SPACES * 2;
     constexpr uint32_t NUM_RESERVED_SRV_DESCRIPTORS = 8192;
     constexpr uint32_t IMGUI_RESERVED_DESCRIPTOR_INDEX = 0;
     constexpr uint32_t NUM_SRV_RENDER_PASS_USER_DESCRIPTORS = 65536;
+    constexpr uint32_t RENDER_PASS_DESCRIPTOR_CHUNK_SIZE = 1024;
+    constexpr uint32_t MAX_BATCHED_CONTEXTS = 64;
+    //Every context of a batch may need a list with the barriers resolved at submission in front of its own.
+    constexpr uint32_t MAX_BATCHED_COMMAND_LISTS = MAX_BATCHED_CONTEXTS * 2;
     constexpr uint32_t INVALID_RESOURCE_TABLE_INDEX = UINT_MAX;
     constexpr uint32_t MAX_TEXTURE_SUBRESOURCE_COUNT = 32;
+    //Per frame in flight, enough for 100k draws with a 256 byte constant buffer each.
+    constexpr uint32_t TRANSIENT_CONSTANT_BUFFER_SIZE = 32 * 1024 * 1024;
+    constexpr uint32_t NUM_UPLOAD_PRIORITIES = 3;
+    constexpr uint32_t NUM_UPLOAD_WORKER_THREADS = 2;
+    constexpr size_t UPLOAD_STAGING_CHUNK_SIZE = 1024 * 1024;
+    constexpr size_t DEFAULT_UPLOAD_BUDGET_PER_FRAME = 16 * 1024 * 1024;
     static const wchar_t* SHADER_SOURCE_PATH = L"Shaders/";
     static const wchar_t* SHADER_OUTPUT_PATH = L"Shaders/Compiled/";
+    static const wchar_t* PIPELINE_LIBRARY_PATH = L"Shaders/Compiled/Pipelines.plib";
     static const char* RESOURCE_PATH = "Resources/";
 
     using SubResourceLayouts = std::array<D3D12_PLACED_SUBRESOURCE_FOOTPRINT, MAX_TEXTURE_SUBRESOURCE_COUNT>;
@@ -71,6 +93,13 @@ namespace D3D12Lite
         uav = 8
     };
 
+    enum class UploadPriority : uint8_t
+    {
+        high = 0,
+        normal,
+        low
+    };
+
     enum class ContextWaitType : uint8_t
     {
         host = 0,
@@ -92,6 +121,12 @@ namespace D3D12Lite
         compute
     };
 
+    enum class DeviceBackendType : uint8_t
+    {
+        d3d12 = 0,
+        null
+    };
+
     inline BufferAccessFlags operator|(BufferAccessFlags a, BufferAccessFlags b)
     {
         return static_cast<BufferAccessFlags>(static_cast<uint8_t>(a) | static_cast<uint8_t>(b));
@@ -158,12 +193,88 @@ namespace D3D12Lite
         return (uint64_t)((valueToAlign + alignment) & ~alignment);
     }
 
+    //Vector with its storage inline, for short lists that are rebuilt often and shouldn't allocate each time.
+    template<typename T, uint32_t Capacity>
+    class FixedVector
+    {
+    public:
+        void push_back(const T& value)
+        {
+            assert(mSize < Capacity);
+            mElements[mSize++] = value;
+        }
+
+        void pop_back() { assert(mSize > 0); mSize--; }
+        void clear() { mSize = 0; }
+        size_t size() const { return mSize; }
+        constexpr size_t capacity() const { return Capacity; }
+        bool empty() const { return mSize == 0; }
+
+        T& operator[](size_t index) { assert(index < mSize); return mElements[index]; }
+        const T& operator[](size_t index) const { assert(index < mSize); return mElements[index]; }
+        T* data() { return mElements.data(); }
+        const T* data() const { return mElements.data(); }
+        T* begin() { return mElements.data(); }
+        T* end() { return mElements.data() + mSize; }
+        const T* begin() const { return mElements.data(); }
+        const T* end() const { return mElements.data() + mSize; }
+
+    private:
+        std::array<T, Capacity> mElements{};
+        uint32_t mSize = 0;
+    };
+
     struct Uint2
     {
         uint32_t x = 0;
         uint32_t y = 0;
     };
 
+    struct NullDeviceDesc
+    {
+        //How long after being signaled a simulated fence reports completion.
+        uint32_t mFenceLatencyMicroseconds = 0;
+        //Where the simulated pipeline library is kept between runs, empty keeps it in memory.
+        std::wstring mPipelineLibraryPath;
+        //Where the stub compiler's output is cached, kept apart from the real shaders so neither is mistaken for the other.
+        std::wstring mShaderCachePath = L"Shaders/Compiled/Null/";
+    };
+
+    struct BarrierStatistics
+    {
+        uint64_t mNumBarriersIssued = 0;
+        uint64_t mNumBarriersElided = 0;
+        uint64_t mNumBarrierBatches = 0;
+    };
+
+    struct StateFilterStatistics
+    {
+        //State calls that reached the command list, and the ones dropped because they matched what it already had.
+        uint64_t mNumStateCallsIssued = 0;
+        uint64_t mNumStateCallsSkipped = 0;
+        //Descriptor tables that reused the block written for the same descriptors earlier, instead of copying them again.
+        uint64_t mNumDescriptorTablesReused = 0;
+    };
+
+    struct DefragmentationStatistics
+    {
+        uint64_t mBytesMoved = 0;
+        uint64_t mBytesFreed = 0;
+        uint32_t mNumResourcesMoved = 0;
+        uint32_t mNumHeapsFreed = 0;
+    };
+
+    struct PipelineCacheStatistics
+    {
+        uint32_t mNumRootSignatureHits = 0;
+        uint32_t mNumRootSignatureMisses = 0;
+        uint32_t mNumPipelineHits = 0;
+        //Pipelines that were not in memory yet, either loaded from the pipeline library or created by the driver.
+        uint32_t mNumLibraryHits = 0;
+        uint32_t mNumLibraryMisses = 0;
+        double mCreateMilliseconds = 0.0;
+    };
+
     struct ContextSubmissionResult
     {
         uint32_t mFrameId = 0;
@@ -177,6 +288,8 @@ namespace D3D12Lite
         BufferViewFlags mViewFlags = BufferViewFlags::none;
         BufferAccessFlags mAccessFlags = BufferAccessFlags::gpuOnly;
         bool mIsRawAccess = false;
+        //Pool from Device::CreateLinearBufferPool to place the buffer in, its access flags have to match the pool's.
+        D3D12MA::Pool* mPool = nullptr;
     };
 
     struct TextureCreationDesc
@@ -217,7 +330,10 @@ namespace D3D12Lite
         ID3D12Resource* mResource = nullptr;
         D3D12MA::Allocation* mAllocation = nullptr;
         D3D12_GPU_VIRTUAL_ADDRESS mVirtualAddress = 0;
+        //State after all work submitted so far, contexts track their own state while recording and update this one on submission.
         D3D12_RESOURCE_STATES mState = D3D12_RESOURCE_STATE_COMMON;
+        //Only filled while subresources are in different states, otherwise all of them are in mState.
+        std::vector<D3D12_RESOURCE_STATES> mSubresourceStates;
         bool mIsReady = false;
         uint32_t mDescriptorHeapIndex = INVALID_RESOURCE_TABLE_INDEX;
     };
@@ -237,6 +353,9 @@ namespace D3D12Lite
 
         uint8_t* mMappedResource = nullptr;
         uint32_t mStride = 0;
+        //Element count of the SRV and UAV, in 32 bit words for raw access.
+        uint32_t mNumElements = 0;
+        bool mIsRawAccess = false;
         Descriptor mCBVDescriptor{};
         Descriptor mSRVDescriptor{};
         Descriptor mUAVDescriptor{};
@@ -253,6 +372,24 @@ namespace D3D12Lite
         Descriptor mDSVDescriptor{};
         Descriptor mSRVDescriptor{};
         Descriptor mUAVDescriptor{};
+        //Only set for depth stencil targets, mDesc then holds the typeless format of the resource.
+        DXGI_FORMAT mDepthStencilFormat = DXGI_FORMAT_UNKNOWN;
+    };
+
+    //Slice of the per-frame constant buffer ring, only valid until the end of the frame it was allocated in.
+    struct TransientConstantBuffer
+    {
+        bool IsValid() const { return mVirtualAddress != 0; }
+
+        void SetMappedData(const void* data, size_t dataSize)
+        {
+            assert(mMappedData != nullptr && data != nullptr && dataSize > 0 && dataSize <= mSize);
+            memcpy_s(mMappedData, mSize, data, dataSize);
+        }
+
+        uint8_t* mMappedData = nullptr;
+        D3D12_GPU_VIRTUAL_ADDRESS mVirtualAddress = 0;
+        uint32_t mSize = 0;
     };
 
     struct PipelineResourceBinding
@@ -265,11 +402,14 @@ namespace D3D12Lite
     {
     public:
         void SetCBV(BufferResource* resource);
+        void SetTransientCBV(const TransientConstantBuffer& constantBuffer);
         void SetSRV(const PipelineResourceBinding& binding);
         void SetUAV(const PipelineResourceBinding& binding);
         void Lock();
 
         const BufferResource* GetCBV() const { return mCBV; }
+        bool HasCBV() const { return mCBV != nullptr || mTransientCBVAddress != 0; }
+        D3D12_GPU_VIRTUAL_ADDRESS GetCBVAddress() const { return mCBV ? mCBV->mVirtualAddress : mTransientCBVAddress; }
         const std::vector<PipelineResourceBinding>& GetUAVs() const { return mUAVs; }
         const std::vector<PipelineResourceBinding>& GetSRVs() const { return mSRVs; }
 
@@ -282,6 +422,7 @@ namespace D3D12Lite
         //as possible if they have the same update frequency (which is contained by a PipelineResourceSpace). Of course,
         //you can freely change this to a vector like the others if you want.
         BufferResource* mCBV = nullptr;
+        D3D12_GPU_VIRTUAL_ADDRESS mTransientCBVAddress = 0;
         std::vector<PipelineResourceBinding> mUAVs;
         std::vector<PipelineResourceBinding> mSRVs;
         bool mIsLocked = false;
@@ -304,11 +445,16 @@ namespace D3D12Lite
         std::wstring mShaderName;
         std::wstring mEntryPoint;
         ShaderType mType = ShaderType::compute;
+        //NAME or NAME=VALUE, each one is a separate permutation in the shader cache.
+        std::vector<std::wstring> mDefines;
     };
 
+    //Compiled, or loaded from the shader cache, on a compile thread. Creating a pipeline with it waits for the result.
     struct Shader
     {
-        IDxcBlob* mShaderBlob = nullptr;
+        std::shared_future<ShaderCacheResult> mCompilation;
+
+        const ShaderCacheResult& GetResult() const { return mCompilation.get(); }
     };
 
     struct GraphicsPipelineDesc
@@ -383,6 +529,8 @@ namespace D3D12Lite
     {
         std::array<std::optional<uint32_t>, NUM_RESOURCE_SPACES> mCbvMapping{};
         std::array<std::optional<uint32_t>, NUM_RESOURCE_SPACES> mTableMapping{};
+        //Same for every pipeline sharing a root signature, which keeps its root arguments when switching between them.
+        uint32_t mRootSignatureId = 0;
     };
 
     struct PipelineStateObject
@@ -396,7 +544,7 @@ namespace D3D12Lite
     struct PipelineInfo
     {
         PipelineStateObject* mPipeline = nullptr;
-        std::vector<TextureResource*> mRenderTargets;
+        FixedVector<TextureResource*, D3D12_SIMULTANEOUS_RENDER_TARGET_COUNT> mRenderTargets;
         TextureResource* mDepthStencilTarget = nullptr;
     };
 
@@ -405,6 +553,52 @@ namespace D3D12Lite
         BufferResource* mBuffer = nullptr;
         std::unique_ptr<uint8_t[]> mBufferData;
         size_t mBufferDataSize = 0;
+
+        //Alternative to mBufferData: bytes are copied into the staging heap straight from mSourceData, mSourceOwner keeps
+        //whatever it points into (a MappedFile) alive until the copy is done.
+        std::shared_ptr<void> mSourceOwner;
+        const uint8_t* mSourceData = nullptr;
+
+        UploadPriority mPriority = UploadPriority::normal;
+        std::promise<void> mCompletion;
+
+        //Buffers that don't fit in what is left of the staging heap are copied over several frames, a range at a time.
+        size_t mNextOffset = 0;
+    };
+
+    //Read-only mapping of a whole file, lets texture data be staged straight from the OS file cache. Maps through Win32
+    //on Windows and mmap everywhere else.
+    class MappedFile
+    {
+    public:
+        MappedFile() = default;
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+        ~MappedFile();
+
+        bool Open(const wchar_t* filePath);
+        const uint8_t* GetData() const { return mData; }
+        size_t GetSize() const { return mSize; }
+
+    private:
+#ifdef _WIN32
+        HANDLE mFileHandle = INVALID_HANDLE_VALUE;
+        HANDLE mMappingHandle = nullptr;
+#else
+        int mFileDescriptor = -1;
+#endif
+        const uint8_t* mData = nullptr;
+        size_t mSize = 0;
+    };
+
+    //Where the rows of one subresource live when they are copied out of their source image rather than mTextureData.
+    struct TextureUploadSource
+    {
+        const uint8_t* mPixels = nullptr;
+        size_t mRowPitch = 0;
+        size_t mSlicePitch = 0;
+        size_t mRowSize = 0;
+        uint32_t mNumRows = 0;
     };
 
     struct TextureUpload
@@ -412,14 +606,60 @@ namespace D3D12Lite
         TextureResource* mTexture = nullptr;
         std::unique_ptr<uint8_t[]> mTextureData;
         size_t mTextureDataSize = 0;
+
+        //Alternative to mTextureData: rows are copied from these into the staging heap at the footprint offsets.
+        //mSourceOwner keeps whatever the pointers reference (a MappedFile, a ScratchImage) alive until the copy is done.
+        std::shared_ptr<void> mSourceOwner;
+        std::vector<TextureUploadSource> mSubResourceSources;
+
         uint32_t mNumSubResources = 0;
         SubResourceLayouts mSubResourceLayouts{ 0 };
+        UploadPriority mPriority = UploadPriority::normal;
+        std::promise<void> mCompletion;
+
+        //Large textures can be staged over several frames, a range of subresources at a time. A subresource bigger than
+        //the whole staging heap is staged a range of rows or depth slices at a time, mNextRow counts rows over all slices.
+        uint32_t mNextSubResource = 0;
+        uint32_t mNextRow = 0;
+    };
+
+    //A texture file ready to upload, any trailing mip range of it can be turned into a texture.
+    struct TextureFileData
+    {
+        D3D12_RESOURCE_DESC mResourceDesc{};
+        std::shared_ptr<void> mSourceOwner;
+        //One per subresource of the full texture, mRowSize and mNumRows are filled in when the upload is built.
+        std::vector<TextureUploadSource> mSubResourceSources;
     };
 
+    TextureFileData LoadTextureFileData(const std::string& texturePath);
+
+    //Uploads waiting for staging space. Safe to add to from any thread, the futures become ready once the GPU copy finished.
+    class UploadQueue
+    {
+    public:
+        std::future<void> AddBufferUpload(std::unique_ptr<BufferUpload> bufferUpload);
+        std::future<void> AddTextureUpload(std::unique_ptr<TextureUpload> textureUpload);
+        size_t GetNumPendingUploads();
+
+    private:
+        friend class UploadContext;
+
+        std::array<std::deque<std::unique_ptr<BufferUpload>>, NUM_UPLOAD_PRIORITIES> mBufferUploads;
+        std::array<std::deque<std::unique_ptr<TextureUpload>>, NUM_UPLOAD_PRIORITIES> mTextureUploads;
+        std::mutex mQueueMutex;
+    };
+
+    class DeviceBackend;
+    class QueueBackend;
+    class CommandRecorder;
+    class PipelineCache;
+    struct PipelineCacheKey;
+
     class DescriptorHeap
     {
     public:
-        DescriptorHeap(ID3D12Device* device, D3D12_DESCRIPTOR_HEAP_TYPE heapType, uint32_t numDescriptors, bool isShaderVisible);
+        DescriptorHeap(DeviceBackend& backend, D3D12_DESCRIPTOR_HEAP_TYPE heapType, uint32_t numDescriptors, bool isShaderVisible);
         virtual ~DescriptorHeap();
 
         ID3D12DescriptorHeap* GetHeap() const { return mDescriptorHeap; }
@@ -441,38 +681,67 @@ namespace D3D12Lite
     class StagingDescriptorHeap final : public DescriptorHeap
     {
     public:
-        StagingDescriptorHeap(ID3D12Device* device, D3D12_DESCRIPTOR_HEAP_TYPE heapType, uint32_t numDescriptors);
+        StagingDescriptorHeap(DeviceBackend& backend, D3D12_DESCRIPTOR_HEAP_TYPE heapType, uint32_t numDescriptors);
         ~StagingDescriptorHeap();
 
+        //Returns an invalid descriptor once every descriptor of the heap is in use.
         Descriptor GetNewDescriptor();
         void FreeDescriptor(Descriptor descriptor);
 
+        uint64_t GetNumGlobalRefills() const { return mNumGlobalRefills.load(std::memory_order_relaxed); }
+        uint64_t GetNumGlobalReturns() const { return mNumGlobalReturns.load(std::memory_order_relaxed); }
+
     private:
-        std::vector<uint32_t> mFreeDescriptors;
-        uint32_t mCurrentDescriptorIndex = 0;
-        uint32_t mActiveHandleCount = 0;
-        std::mutex mUsageMutex;
+        //Each thread allocates from its own magazine of free indices and only touches the shared state
+        //(bump index and lock-free free list) when the magazine runs empty or overflows, a batch at a time.
+        struct Magazine
+        {
+            std::array<uint32_t, MAX_STAGING_DESCRIPTOR_BATCH_SIZE * 2> mDescriptorIndices{};
+            uint32_t mCount = 0;
+            int64_t mActiveHandleCount = 0;
+        };
+
+        struct ThreadMagazineCache;
+        static thread_local ThreadMagazineCache sThreadMagazineCache;
+
+        Magazine& GetThreadMagazine();
+        void RefillMagazine(Magazine& magazine);
+        void ReturnThreadMagazine(Magazine* magazine);
+        uint32_t PopFreeList(uint32_t* descriptorIndices, uint32_t maxCount);
+        void PushFreeList(const uint32_t* descriptorIndices, uint32_t count);
+
+        uint64_t mHeapID = 0;
+        uint32_t mBatchSize = 1;
+        std::atomic<uint32_t> mCurrentDescriptorIndex{ 0 };
+        std::atomic<uint64_t> mFreeListHead{ 0 };
+        std::unique_ptr<std::atomic<uint32_t>[]> mFreeListLinks;
+        std::vector<std::unique_ptr<Magazine>> mMagazines;
+        std::vector<Magazine*> mSpareMagazines;
+        std::mutex mMagazineMutex;
+        std::atomic<uint64_t> mNumGlobalRefills{ 0 };
+        std::atomic<uint64_t> mNumGlobalReturns{ 0 };
     };
 
     class RenderPassDescriptorHeap final : public DescriptorHeap
     {
     public:
-        RenderPassDescriptorHeap(ID3D12Device* device, D3D12_DESCRIPTOR_HEAP_TYPE heapType, uint32_t reservedCount, uint32_t userCount);
+        RenderPassDescriptorHeap(DeviceBackend& backend, D3D12_DESCRIPTOR_HEAP_TYPE heapType, uint32_t reservedCount, uint32_t userCount);
 
+        //Only safe once the GPU is done with the heap and no context is recording into it.
         void Reset();
+        //Returns an invalid descriptor once the user range can't fit count more.
         Descriptor AllocateUserDescriptorBlock(uint32_t count);
         Descriptor GetReservedDescriptor(uint32_t index);
 
     private:
         uint32_t mReservedHandleCount = 0;
-        uint32_t mCurrentDescriptorIndex = 0;
-        std::mutex mUsageMutex;
+        std::atomic<uint32_t> mCurrentDescriptorIndex{ 0 };
     };
 
     class Queue
     {
     public:
-        Queue(ID3D12Device* device, D3D12_COMMAND_LIST_TYPE commandType);
+        Queue(DeviceBackend& backend, D3D12_COMMAND_LIST_TYPE commandType);
         ~Queue();
 
         bool IsFenceComplete(uint64_t fenceValue);
@@ -485,19 +754,19 @@ namespace D3D12Lite
         uint64_t PollCurrentFenceValue();
         uint64_t GetLastCompletedFence() { return mLastCompletedFenceValue; }
         uint64_t GetNextFenceValue() { return mNextFenceValue; }
-        uint64_t ExecuteCommandList(ID3D12CommandList* commandList);
+        uint64_t ExecuteCommandList(CommandRecorder& commandRecorder);
+        uint64_t ExecuteCommandLists(uint32_t numCommandRecorders, CommandRecorder* const* commandRecorders);
         uint64_t SignalFence();
 
-        ID3D12CommandQueue* GetDeviceQueue() { return mQueue; }
-        ID3D12Fence* GetFence() { return mFence; }
+        ID3D12CommandQueue* GetDeviceQueue();
+        ID3D12Fence* GetFence();
+        QueueBackend& GetBackendQueue() { return *mQueue; }
 
     private:
         D3D12_COMMAND_LIST_TYPE mQueueType = D3D12_COMMAND_LIST_TYPE_DIRECT;
-        ID3D12CommandQueue* mQueue = nullptr;
-        ID3D12Fence* mFence = nullptr;
+        std::unique_ptr<QueueBackend> mQueue;
         uint64_t mNextFenceValue = 1;
         uint64_t mLastCompletedFenceValue = 0;
-        HANDLE mFenceEventHandle = 0;
         std::mutex mFenceMutex;
         std::mutex mEventMutex;
     };
@@ -509,27 +778,76 @@ namespace D3D12Lite
         virtual ~Context();
 
         D3D12_COMMAND_LIST_TYPE GetCommandType() { return mContextType; }
-        ID3D12GraphicsCommandList* GetCommandList() { return mCommandList; }
+        //Anything may be set on the list behind the context's back from here, so the state it filters against is forgotten.
+        ID3D12GraphicsCommandList* GetCommandList();
+        CommandRecorder& GetCommandRecorder() { InvalidateState(); return *mCommandRecorder; }
 
         void Reset();
-        void AddBarrier(Resource& resource, D3D12_RESOURCE_STATES newState);
+        void AddBarrier(Resource& resource, D3D12_RESOURCE_STATES newState, uint32_t subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES);
+        void BeginSplitBarrier(Resource& resource, D3D12_RESOURCE_STATES newState);
+        void EndSplitBarrier(Resource& resource);
         void FlushBarriers();
+        bool HasPendingSplitBarriers() const { return !mPendingSplitBarriers.empty(); }
+        //Starts tracking the resource from the state in the resource, instead of leaving its first barrier to submission.
+        //Only valid when no other context that is submitted before this one uses the resource.
+        void TrackCurrentState(Resource& resource);
+        //Called on submission. Turns the first barrier of each resource into a transition from the state it was left in by
+        //previously submitted work and stores the states this context ends with in the resources. Returns the list holding
+        //those transitions, which has to execute right before this context, or nullptr if none were needed.
+        CommandRecorder* ResolvePendingBarriers();
+        const BarrierStatistics& GetBarrierStatistics() const { return mBarrierStatistics; }
+        const StateFilterStatistics& GetStateFilterStatistics() const { return mStateFilterStatistics; }
         void CopyResource(const Resource& destination, const Resource& source);
         void CopyBufferRegion(Resource& destination, uint64_t destOffset, Resource& source, uint64_t sourceOffset, uint64_t numBytes);
-        void CopyTextureRegion(Resource& destination, Resource& source, size_t sourceOffset, SubResourceLayouts& subResourceLayouts, uint32_t numSubResources);
+        void CopyTextureRegion(Resource& destination, Resource& source, size_t sourceOffset, SubResourceLayouts& subResourceLayouts, uint32_t numSubResources, uint32_t firstSubResource = 0);
 
     protected:
+        virtual void InvalidateState() {}
         void BindDescriptorHeaps(uint32_t frameIndex);
+        Descriptor AllocateDescriptorBlock(uint32_t count);
+        void QueueTransition(Resource& resource, uint32_t subresource, D3D12_RESOURCE_STATES oldState, D3D12_RESOURCE_STATES newState);
+
+        struct QueuedBarrier
+        {
+            Resource* mResource = nullptr;
+            D3D12_RESOURCE_BARRIER mBarrier{};
+        };
+
+        static constexpr D3D12_RESOURCE_STATES UNKNOWN_RESOURCE_STATE = static_cast<D3D12_RESOURCE_STATES>(-1);
+
+        //Same layout as the state in Resource. States this context has not seen a barrier for yet are UNKNOWN_RESOURCE_STATE.
+        struct TrackedResourceState
+        {
+            D3D12_RESOURCE_STATES mState = UNKNOWN_RESOURCE_STATE;
+            std::vector<D3D12_RESOURCE_STATES> mSubresourceStates;
+        };
+
+        struct PendingBarrier
+        {
+            Resource* mResource = nullptr;
+            uint32_t mSubresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
+            D3D12_RESOURCE_STATES mState = D3D12_RESOURCE_STATE_COMMON;
+        };
+
+        void SetTrackedState(TrackedResourceState& trackedState, Resource& resource, uint32_t subresource, D3D12_RESOURCE_STATES newState);
 
         class Device& mDevice;
         D3D12_COMMAND_LIST_TYPE mContextType = D3D12_COMMAND_LIST_TYPE_DIRECT;
-        ID3D12GraphicsCommandList4* mCommandList = nullptr;
+        std::unique_ptr<CommandRecorder> mCommandRecorder;
         std::array<ID3D12DescriptorHeap*, D3D12_DESCRIPTOR_HEAP_TYPE_NUM_TYPES> mCurrentDescriptorHeaps{ nullptr };
-        std::array<ID3D12CommandAllocator*, NUM_FRAMES_IN_FLIGHT> mCommandAllocators{ nullptr };
-        std::array<D3D12_RESOURCE_BARRIER, MAX_QUEUED_BARRIERS> mResourceBarriers{};
-        uint32_t mNumQueuedBarriers = 0;
+        std::vector<QueuedBarrier> mQueuedBarriers;
+        std::vector<D3D12_RESOURCE_BARRIER> mResourceBarriers;
+        std::vector<QueuedBarrier> mPendingSplitBarriers;
+        std::unordered_map<Resource*, TrackedResourceState> mTrackedStates;
+        std::vector<PendingBarrier> mPendingBarriers;
+        std::unique_ptr<CommandRecorder> mPendingBarrierCommandRecorder;
+        BarrierStatistics mBarrierStatistics;
+        StateFilterStatistics mStateFilterStatistics;
         RenderPassDescriptorHeap* mCurrentSRVHeap = nullptr;
         D3D12_CPU_DESCRIPTOR_HANDLE mCurrentSRVHeapHandle{ 0 };
+        Descriptor mDescriptorRangeStart{};
+        uint32_t mDescriptorRangeSize = 0;
+        uint32_t mDescriptorRangeUsed = 0;
     };
 
     class GraphicsContext final : public Context
@@ -545,6 +863,7 @@ namespace D3D12Lite
         void SetPrimitiveTopology(D3D12_PRIMITIVE_TOPOLOGY topology);
         void SetPipeline(const PipelineInfo& pipelineBinding);
         void SetPipelineResources(uint32_t spaceId, const PipelineResourceSpace& resources);
+        void SetConstantBuffer(uint32_t spaceId, const TransientConstantBuffer& constantBuffer);
         void SetIndexBuffer(const BufferResource& indexBuffer);
         void ClearRenderTarget(const TextureResource& target, Color color);
         void ClearDepthStencilTarget(const TextureResource& target, float depth, uint8_t stencil);
@@ -559,9 +878,50 @@ namespace D3D12Lite
         void Dispatch3D(uint32_t threadCountX, uint32_t threadCountY, uint32_t threadCountZ, uint32_t groupSizeX, uint32_t groupSizeY, uint32_t groupSizeZ);
 
     private:
+        //What the command list was last given, so calls that wouldn't change anything can be dropped. Graphics and
+        //compute root arguments are separate on the command list, so they are tracked separately as well.
+        struct BoundRootArguments
+        {
+            uint32_t mRootSignatureId = 0;
+            std::array<D3D12_GPU_VIRTUAL_ADDRESS, MAX_ROOT_PARAMETERS> mConstantBuffers{};
+            std::array<D3D12_GPU_DESCRIPTOR_HANDLE, MAX_ROOT_PARAMETERS> mDescriptorTables{};
+        };
+
+        //The descriptors last copied into the render pass heap for a space, and where to, reused while they don't change.
+        struct BoundDescriptorTable
+        {
+            std::array<D3D12_CPU_DESCRIPTOR_HANDLE, MAX_DESCRIPTORS_PER_TABLE> mHandles{};
+            uint32_t mNumHandles = 0;
+            D3D12_GPU_DESCRIPTOR_HANDLE mBlockStart{ 0 };
+        };
+
+        struct BoundState
+        {
+            PipelineStateObject* mPipeline = nullptr;
+            std::array<BoundRootArguments, 2> mRootArguments;
+            std::array<D3D12_CPU_DESCRIPTOR_HANDLE, D3D12_SIMULTANEOUS_RENDER_TARGET_COUNT> mRenderTargets{};
+            uint32_t mNumRenderTargets = 0;
+            D3D12_CPU_DESCRIPTOR_HANDLE mDepthStencil{ 0 };
+            bool mAreTargetsBound = false;
+            D3D12_VIEWPORT mViewport{};
+            bool mIsViewportBound = false;
+            D3D12_RECT mScissorRect{};
+            bool mIsScissorRectBound = false;
+            D3D12_PRIMITIVE_TOPOLOGY mPrimitiveTopology = D3D_PRIMITIVE_TOPOLOGY_UNDEFINED;
+            D3D12_INDEX_BUFFER_VIEW mIndexBuffer{};
+            bool mIsIndexBufferBound = false;
+            std::array<BoundDescriptorTable, NUM_RESOURCE_SPACES> mDescriptorTables;
+        };
+
+        void InvalidateState() override;
+        bool SkipIfBound(bool isBound);
         void SetTargets(uint32_t numRenderTargets, const D3D12_CPU_DESCRIPTOR_HANDLE renderTargets[], D3D12_CPU_DESCRIPTOR_HANDLE depthStencil);
+        void SetIndexBufferView(const D3D12_INDEX_BUFFER_VIEW* indexBufferView);
+        void SetRootConstantBufferView(uint32_t rootParameter, D3D12_GPU_VIRTUAL_ADDRESS address);
+        void SetRootDescriptorTable(uint32_t rootParameter, D3D12_GPU_DESCRIPTOR_HANDLE blockStart);
 
         PipelineStateObject* mCurrentPipeline = nullptr;
+        BoundState mBoundState;
     };
 
     class ComputeContext final : public Context
@@ -571,6 +931,7 @@ namespace D3D12Lite
 
         void SetPipeline(const PipelineInfo& pipelineBinding);
         void SetPipelineResources(uint32_t spaceId, const PipelineResourceSpace& resources);
+        void SetConstantBuffer(uint32_t spaceId, const TransientConstantBuffer& constantBuffer);
         void Dispatch(uint32_t groupCountX, uint32_t groupCountY, uint32_t groupCountZ);
         void Dispatch1D(uint32_t threadCountX, uint32_t groupSizeX);
         void Dispatch2D(uint32_t threadCountX, uint32_t threadCountY, uint32_t groupSizeX, uint32_t groupSizeY);
@@ -589,31 +950,52 @@ namespace D3D12Lite
         std::unique_ptr<BufferResource> ReturnBufferHeap();
         std::unique_ptr<BufferResource> ReturnTextureHeap();
 
-        void AddBufferUpload(std::unique_ptr<BufferUpload> bufferUpload);
-        void AddTextureUpload(std::unique_ptr<TextureUpload> textureUpload);
+        std::future<void> AddBufferUpload(std::unique_ptr<BufferUpload> bufferUpload);
+        std::future<void> AddTextureUpload(std::unique_ptr<TextureUpload> textureUpload);
+
+        //Pulls as much as fits in the staging heaps and the byte budget from the queue, records the copies and hands
+        //the memcpys into the staging heaps to the worker pool. ProcessUploads waits for those before submission.
+        void StageUploads(UploadQueue& uploadQueue, size_t byteBudget, WorkerPool& workerPool);
         void ProcessUploads();
         void ResolveProcessedUploads();
 
     private:
-        std::vector<std::unique_ptr<BufferUpload>> mBufferUploads;
-        std::vector<std::unique_ptr<TextureUpload>> mTextureUploads;
-        std::vector<BufferResource*> mBufferUploadsInProgress;
-        std::vector<TextureResource*> mTextureUploadsInProgress;
+        struct StagingCopy
+        {
+            uint8_t* mDestination = nullptr;
+            const uint8_t* mSource = nullptr;
+            size_t mSize = 0;
+            size_t mDestinationPitch = 0;
+            size_t mSourcePitch = 0;
+            uint32_t mNumRows = 1;
+        };
+
+        size_t StageTextureRows(TextureUpload& textureUpload, size_t heapOffset, size_t maxSize);
+        void AddStagingCopy(uint8_t* destination, const uint8_t* source, size_t size);
+        void AddStagingRowCopy(uint8_t* destination, size_t destinationPitch, const uint8_t* source, size_t sourcePitch, size_t rowSize, uint32_t numRows);
+
+        std::vector<StagingCopy> mStagingCopies;
+        std::vector<std::unique_ptr<BufferUpload>> mBufferUploadsInProgress;
+        std::vector<std::unique_ptr<TextureUpload>> mTextureUploadsInProgress;
         std::unique_ptr<BufferResource> mBufferUploadHeap;
         std::unique_ptr<BufferResource> mTextureUploadHeap;
+        WorkerPool* mWorkerPool = nullptr;
     };
 
     class Device
     {
     public:
         Device(HWND windowHandle, Uint2 screenSize);
+        Device(const NullDeviceDesc& nullDeviceDesc, Uint2 screenSize);
         ~Device();
 
         void BeginFrame();
         void EndFrame();
         void Present();
 
-        ID3D12Device5* GetDevice() { return mDevice; }
+        ID3D12Device5* GetDevice();
+        DeviceBackend& GetBackend() { return *mBackend; }
+        DeviceBackendType GetBackendType() const;
         RenderPassDescriptorHeap& GetSamplerHeap() { return *mSamplerRenderPassDescriptorHeap; }
         RenderPassDescriptorHeap& GetSRVHeap(uint32_t frameIndex) { return *mSRVRenderPassDescriptorHeaps[frameIndex]; }
         TextureResource& GetCurrentBackBuffer();
@@ -621,23 +1003,66 @@ namespace D3D12Lite
         uint32_t GetFrameId() { return mFrameId; }
         Uint2 GetScreenSize() { return mScreenSize; }
         UploadContext& GetUploadContextForCurrentFrame() { return *mUploadContexts[mFrameId]; }
+        UploadQueue& GetUploadQueue() { return mUploadQueue; }
+        void SetUploadBudgetPerFrame(size_t byteBudget) { mUploadBudgetPerFrame = byteBudget; }
+        ShaderCacheStatistics GetShaderCacheStatistics() const { return mShaderCache->GetStatistics(); }
+        PipelineCacheStatistics GetPipelineCacheStatistics() const;
 
         std::unique_ptr<BufferResource> CreateBuffer(const BufferCreationDesc& desc);
         std::unique_ptr<TextureResource> CreateTexture(const TextureCreationDesc& desc);
         std::unique_ptr<TextureResource> CreateTextureFromFile(const std::string& texturePath);
+        std::unique_ptr<TextureResource> CreateTextureFromFileData(const TextureFileData& fileData, uint32_t firstMip = 0, UploadPriority priority = UploadPriority::normal);
         std::unique_ptr<Shader> CreateShader(const ShaderCreationDesc& desc);
         std::unique_ptr<PipelineStateObject> CreateGraphicsPipeline(const GraphicsPipelineDesc& desc, const PipelineResourceLayout& layout);
         std::unique_ptr<PipelineStateObject> CreateComputePipeline(const ComputePipelineDesc& desc, const PipelineResourceLayout& layout);
         std::unique_ptr<GraphicsContext> CreateGraphicsContext();
         std::unique_ptr<ComputeContext> CreateComputeContext();
+        TransientConstantBuffer AllocateTransientConstantBuffer(uint32_t size);
+
+        //Single heap of the given size that places buffers one after another instead of searching for the best fit.
+        //Freeing the oldest or the newest buffer is constant time, so it suits buffers destroyed in the order they were
+        //created, e.g. per-frame transient buffers, or in reverse order. Every buffer takes at least 64KB of it.
+        //Returns nullptr on backends without a memory allocator, buffers then go to the default heaps.
+        D3D12MA::Pool* CreateLinearBufferPool(uint64_t size, BufferAccessFlags accessFlags);
+
+        //Pooled contexts are reset and ready to record, and go back to the pool once this frame slot comes around again.
+        //Different contexts can record on different threads, each one tracks resource states on its own and they are
+        //reconciled in the order the contexts are submitted in.
+        GraphicsContext& AcquireGraphicsContext();
+
+        template<typename T>
+        TransientConstantBuffer AllocateTransientConstantBuffer(const T& data)
+        {
+            TransientConstantBuffer constantBuffer = AllocateTransientConstantBuffer(static_cast<uint32_t>(sizeof(T)));
+            constantBuffer.SetMappedData(&data, sizeof(T));
+            return constantBuffer;
+        }
 
         void DestroyBuffer(std::unique_ptr<BufferResource> buffer);
         void DestroyTexture(std::unique_ptr<TextureResource> texture);
         void DestroyShader(std::unique_ptr<Shader> shader);
         void DestroyPipelineStateObject(std::unique_ptr<PipelineStateObject> pso);
         void DestroyContext(std::unique_ptr<Context> context);
+        //Buffers in the pool have to be destroyed first.
+        void DestroyBufferPool(D3D12MA::Pool* pool);
+
+        //Moves the resource and views of newStorage into texture while it keeps its bindless index. The reserved descriptor
+        //of each frame is patched once that frame slot comes around, and the old resource is destroyed after that.
+        void SwapTextureStorage(TextureResource& texture, std::unique_ptr<TextureResource> newStorage);
+
+        //Moves resources in the default heaps closer together, so heaps left mostly empty by destroyed resources can be freed.
+        //Each pass copies at most the given bytes and resources on the graphics queue during BeginFrame and swaps the new
+        //resource and views into the objects the caller holds, bindless indices stay the same. The next pass starts once the
+        //frame slot of the previous one comes around again. Host-visible buffers, buffers in pools and resources that are not
+        //ready yet stay where they are. Does nothing on backends without a memory allocator.
+        void BeginResourceDefragmentation(uint64_t maxBytesPerPass, uint32_t maxResourcesPerPass);
+        bool IsDefragmentingResources() const { return mIsDefragmentingResources; }
+        const DefragmentationStatistics& GetDefragmentationStatistics() const { return mDefragmentationStatistics; }
 
         ContextSubmissionResult SubmitContextWork(Context& context);
+        ContextSubmissionResult SubmitContextWork(Context* const* contexts, uint32_t numContexts);
+        const BarrierStatistics& GetLastFrameBarrierStatistics() const { return mLastFrameBarrierStatistics; }
+        const StateFilterStatistics& GetLastFrameStateFilterStatistics() const { return mLastFrameStateFilterStatistics; }
         void WaitOnContextWork(ContextSubmissionResult submission, ContextWaitType waitType);
         void WaitForIdle();
 
@@ -646,14 +1071,23 @@ namespace D3D12Lite
                              uint32_t numSrcDescriptorRanges, const D3D12_CPU_DESCRIPTOR_HANDLE* srcDescriptorRangeStarts, const uint32_t* srcDescriptorRangeSizes, D3D12_DESCRIPTOR_HEAP_TYPE descriptorType);
 
     private:
-        void InitializeDeviceResources();
+        void InitializeDeviceResources(std::unique_ptr<DeviceBackend> backend, const std::wstring& pipelineLibraryPath, const std::wstring& shaderCachePath);
         void CreateSamplers();
         void CreateWindowDependentResources(HWND windowHandle, Uint2 screenSize);
         void DestroyWindowDependentResources();
         void ProcessDestructions(uint32_t frameIndex);
         void CopySRVHandleToReservedTable(Descriptor srvHandle, uint32_t index);
-
-        ID3D12RootSignature* CreateRootSignature(const PipelineResourceLayout& layout, PipelineResourceMapping& resourceMapping);
+        uint32_t AllocateReservedDescriptorIndex();
+        void FreeReservedDescriptorIndex(uint32_t index);
+        void PatchReservedDescriptor(uint32_t index, Descriptor srvHandle);
+        void CreateBufferViews(BufferResource& buffer, bool hasCBV, bool hasSRV, bool hasUAV);
+        void CreateTextureViews(TextureResource& texture, bool hasRTV, bool hasSRV, bool hasUAV);
+        void UpdateResourceDefragmentation();
+        void MoveResource(GraphicsContext& context, uint32_t moveIndex, Resource& resource);
+        void EndResourceDefragmentation();
+        Queue& GetQueue(D3D12_COMMAND_LIST_TYPE commandType);
+
+        ID3D12RootSignature* CreateRootSignature(const PipelineResourceLayout& layout, PipelineResourceMapping& resourceMapping, PipelineCacheKey& rootSignatureKey);
 
         struct EndOfFrameFences
         {
@@ -668,14 +1102,12 @@ namespace D3D12Lite
             std::vector<std::unique_ptr<TextureResource>> mTexturesToDestroy;
             std::vector<std::unique_ptr<PipelineStateObject>> mPipelinesToDestroy;
             std::vector<std::unique_ptr<Context>> mContextsToDestroy;
+            std::vector<D3D12MA::Pool*> mBufferPoolsToDestroy;
         };
 
         uint32_t mFrameId = 0;
         Uint2 mScreenSize{ 0, 0 };
-        ID3D12Device5* mDevice = nullptr;
-        IDXGIFactory7* mDXGIFactory = nullptr;
-        IDXGISwapChain4* mSwapChain = nullptr;
-        D3D12MA::Allocator* mAllocator = nullptr;
+        std::unique_ptr<DeviceBackend> mBackend;
         std::unique_ptr<Queue> mGraphicsQueue;
         std::unique_ptr<Queue> mComputeQueue;
         std::unique_ptr<Queue> mCopyQueue;
@@ -684,13 +1116,34 @@ namespace D3D12Lite
         std::unique_ptr<StagingDescriptorHeap> mSRVStagingDescriptorHeap;
         std::array<Descriptor, NUM_FRAMES_IN_FLIGHT> mImguiDescriptors;
         std::vector<uint32_t> mFreeReservedDescriptorIndices;
+        std::mutex mReservedDescriptorMutex;
         std::unique_ptr<RenderPassDescriptorHeap> mSamplerRenderPassDescriptorHeap;
         std::array<std::unique_ptr<RenderPassDescriptorHeap>, NUM_FRAMES_IN_FLIGHT> mSRVRenderPassDescriptorHeaps;
         std::array<std::unique_ptr<TextureResource>, NUM_BACK_BUFFERS> mBackBuffers;
         std::array<EndOfFrameFences, NUM_FRAMES_IN_FLIGHT> mEndOfFrameFences;
         std::array<std::unique_ptr<UploadContext>, NUM_FRAMES_IN_FLIGHT> mUploadContexts;
+        UploadQueue mUploadQueue;
+        std::unique_ptr<WorkerPool> mUploadWorkerPool;
+        std::unique_ptr<ShaderCache> mShaderCache;
+        std::unique_ptr<PipelineCache> mPipelineCache;
+        size_t mUploadBudgetPerFrame = DEFAULT_UPLOAD_BUDGET_PER_FRAME;
+        std::array<std::unique_ptr<BufferResource>, NUM_FRAMES_IN_FLIGHT> mTransientConstantBuffers;
+        std::atomic<uint32_t> mTransientConstantBufferOffset{ 0 };
+        std::array<std::vector<std::unique_ptr<GraphicsContext>>, NUM_FRAMES_IN_FLIGHT> mGraphicsContextPools;
+        std::array<uint32_t, NUM_FRAMES_IN_FLIGHT> mNumAcquiredGraphicsContexts{ 0 };
+        std::mutex mContextPoolMutex;
+        BarrierStatistics mBarrierStatistics;
+        BarrierStatistics mLastFrameBarrierStatistics;
+        StateFilterStatistics mStateFilterStatistics;
+        StateFilterStatistics mLastFrameStateFilterStatistics;
         std::array<std::vector<std::pair<uint64_t, D3D12_COMMAND_LIST_TYPE>>, NUM_FRAMES_IN_FLIGHT> mContextSubmissions;
         std::array<DestructionQueue, NUM_FRAMES_IN_FLIGHT> mDestructionQueues;
+        std::array<std::vector<std::pair<uint32_t, Descriptor>>, NUM_FRAMES_IN_FLIGHT> mPendingReservedDescriptorPatches;
+        bool mIsDefragmentingResources = false;
+        bool mIsDefragmentationPassInFlight = false;
+        uint32_t mDefragmentationPassFrameId = 0;
+        std::vector<Resource*> mDefragmentationMoves;
+        DefragmentationStatistics mDefragmentationStatistics;
     };
 }
 
@@ -0,0 +1,809 @@
+#include "D3D12LiteBackend.h"
+#include "D3D12MemoryAllocator/D3D12MemAlloc.h"
+#include "dxc/inc/dxcapi.h"
+#include <dxgidebug.h>
+
+namespace D3D12Lite
+{
+    class D3D12CommandRecorder final : public CommandRecorder
+    {
+    public:
+        D3D12CommandRecorder(ID3D12Device5* device, D3D12_COMMAND_LIST_TYPE commandType)
+        {
+            for (uint32_t frameIndex = 0; frameIndex < NUM_FRAMES_IN_FLIGHT; frameIndex++)
+            {
+                AssertIfFailed(device->CreateCommandAllocator(commandType, IID_PPV_ARGS(&mCommandAllocators[frameIndex])));
+            }
+
+            AssertIfFailed(device->CreateCommandList1(0, commandType, D3D12_COMMAND_LIST_FLAG_NONE, IID_PPV_ARGS(&mCommandList)));
+        }
+
+        ~D3D12CommandRecorder()
+        {
+            SafeRelease(mCommandList);
+
+            for (uint32_t frameIndex = 0; frameIndex < NUM_FRAMES_IN_FLIGHT; frameIndex++)
+            {
+                SafeRelease(mCommandAllocators[frameIndex]);
+            }
+        }
+
+        ID3D12GraphicsCommandList* GetNativeCommandList() override { return mCommandList; }
+
+        void Reset(uint32_t frameIndex) override
+        {
+            mCommandAllocators[frameIndex]->Reset();
+            mCommandList->Reset(mCommandAllocators[frameIndex], nullptr);
+        }
+
+        void Close() override
+        {
+            AssertIfFailed(mCommandList->Close());
+        }
+
+        void ResourceBarrier(uint32_t numBarriers, const D3D12_RESOURCE_BARRIER* barriers) override
+        {
+            mCommandList->ResourceBarrier(numBarriers, barriers);
+        }
+
+        void SetDescriptorHeaps(uint32_t numDescriptorHeaps, ID3D12DescriptorHeap* const* descriptorHeaps) override
+        {
+            mCommandList->SetDescriptorHeaps(numDescriptorHeaps, descriptorHeaps);
+        }
+
+        void CopyResource(const Resource& destination, const Resource& source) override
+        {
+            mCommandList->CopyResource(destination.mResource, source.mResource);
+        }
+
+        void CopyBufferRegion(const Resource& destination, uint64_t destOffset, const Resource& source, uint64_t sourceOffset, uint64_t numBytes) override
+        {
+            mCommandList->CopyBufferRegion(destination.mResource, destOffset, source.mResource, sourceOffset, numBytes);
+        }
+
+        void CopyTextureRegion(const D3D12_TEXTURE_COPY_LOCATION& destination, uint32_t destX, uint32_t destY, uint32_t destZ, const D3D12_TEXTURE_COPY_LOCATION& source, const D3D12_BOX* sourceBox) override
+        {
+            mCommandList->CopyTextureRegion(&destination, destX, destY, destZ, &source, sourceBox);
+        }
+
+        void RSSetViewports(uint32_t numViewports, const D3D12_VIEWPORT* viewports) override
+        {
+            mCommandList->RSSetViewports(numViewports, viewports);
+        }
+
+        void RSSetScissorRects(uint32_t numRects, const D3D12_RECT* rects) override
+        {
+            mCommandList->RSSetScissorRects(numRects, rects);
+        }
+
+        void OMSetStencilRef(uint32_t stencilRef) override
+        {
+            mCommandList->OMSetStencilRef(stencilRef);
+        }
+
+        void OMSetBlendFactor(const float blendFactor[4]) override
+        {
+            mCommandList->OMSetBlendFactor(blendFactor);
+        }
+
+        void OMSetRenderTargets(uint32_t numRenderTargets, const D3D12_CPU_DESCRIPTOR_HANDLE* renderTargets, const D3D12_CPU_DESCRIPTOR_HANDLE* depthStencil) override
+        {
+            mCommandList->OMSetRenderTargets(numRenderTargets, renderTargets, false, depthStencil);
+        }
+
+        void IASetPrimitiveTopology(D3D12_PRIMITIVE_TOPOLOGY topology) override
+        {
+            mCommandList->IASetPrimitiveTopology(topology);
+        }
+
+        void IASetIndexBuffer(const D3D12_INDEX_BUFFER_VIEW* indexBufferView) override
+        {
+            mCommandList->IASetIndexBuffer(indexBufferView);
+        }
+
+        void SetPipelineState(ID3D12PipelineState* pipelineState) override
+        {
+            mCommandList->SetPipelineState(pipelineState);
+        }
+
+        void SetGraphicsRootSignature(ID3D12RootSignature* rootSignature) override
+        {
+            mCommandList->SetGraphicsRootSignature(rootSignature);
+        }
+
+        void SetComputeRootSignature(ID3D12RootSignature* rootSignature) override
+        {
+            mCommandList->SetComputeRootSignature(rootSignature);
+        }
+
+        void SetGraphicsRootConstantBufferView(uint32_t rootParameterIndex, D3D12_GPU_VIRTUAL_ADDRESS bufferLocation) override
+        {
+            mCommandList->SetGraphicsRootConstantBufferView(rootParameterIndex, bufferLocation);
+        }
+
+        void SetComputeRootConstantBufferView(uint32_t rootParameterIndex, D3D12_GPU_VIRTUAL_ADDRESS bufferLocation) override
+        {
+            mCommandList->SetComputeRootConstantBufferView(rootParameterIndex, bufferLocation);
+        }
+
+        void SetGraphicsRootDescriptorTable(uint32_t rootParameterIndex, D3D12_GPU_DESCRIPTOR_HANDLE baseDescriptor) override
+        {
+            mCommandList->SetGraphicsRootDescriptorTable(rootParameterIndex, baseDescriptor);
+        }
+
+        void SetComputeRootDescriptorTable(uint32_t rootParameterIndex, D3D12_GPU_DESCRIPTOR_HANDLE baseDescriptor) override
+        {
+            mCommandList->SetComputeRootDescriptorTable(rootParameterIndex, baseDescriptor);
+        }
+
+        void ClearRenderTargetView(D3D12_CPU_DESCRIPTOR_HANDLE renderTarget, const float color[4]) override
+        {
+            mCommandList->ClearRenderTargetView(renderTarget, color, 0, nullptr);
+        }
+
+        void ClearDepthStencilView(D3D12_CPU_DESCRIPTOR_HANDLE depthStencil, D3D12_CLEAR_FLAGS clearFlags, float depth, uint8_t stencil) override
+        {
+            mCommandList->ClearDepthStencilView(depthStencil, clearFlags, depth, stencil, 0, nullptr);
+        }
+
+        void DrawInstanced(uint32_t vertexCountPerInstance, uint32_t instanceCount, uint32_t startVertexLocation, uint32_t startInstanceLocation) override
+        {
+            mCommandList->DrawInstanced(vertexCountPerInstance, instanceCount, startVertexLocation, startInstanceLocation);
+        }
+
+        void DrawIndexedInstanced(uint32_t indexCountPerInstance, uint32_t instanceCount, uint32_t startIndexLocation, int32_t baseVertexLocation, uint32_t startInstanceLocation) override
+        {
+            mCommandList->DrawIndexedInstanced(indexCountPerInstance, instanceCount, startIndexLocation, baseVertexLocation, startInstanceLocation);
+        }
+
+        void Dispatch(uint32_t groupCountX, uint32_t groupCountY, uint32_t groupCountZ) override
+        {
+            mCommandList->Dispatch(groupCountX, groupCountY, groupCountZ);
+        }
+
+    private:
+        ID3D12GraphicsCommandList4* mCommandList = nullptr;
+        std::array<ID3D12CommandAllocator*, NUM_FRAMES_IN_FLIGHT> mCommandAllocators{ nullptr };
+    };
+
+    class D3D12QueueBackend final : public QueueBackend
+    {
+    public:
+        D3D12QueueBackend(ID3D12Device5* device, D3D12_COMMAND_LIST_TYPE commandType)
+        {
+            D3D12_COMMAND_QUEUE_DESC queueDesc = {};
+            queueDesc.Type = commandType;
+            queueDesc.NodeMask = 0;
+            device->CreateCommandQueue(&queueDesc, IID_PPV_ARGS(&mQueue));
+
+            AssertIfFailed(device->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&mFence)));
+
+            mFence->Signal(0);
+
+            mFenceEventHandle = CreateEventEx(nullptr, nullptr, 0, EVENT_ALL_ACCESS);
+            assert(mFenceEventHandle != INVALID_HANDLE_VALUE);
+        }
+
+        ~D3D12QueueBackend()
+        {
+            CloseHandle(mFenceEventHandle);
+
+            SafeRelease(mFence);
+            SafeRelease(mQueue);
+        }
+
+        ID3D12CommandQueue* GetNativeQueue() override { return mQueue; }
+        ID3D12Fence* GetNativeFence() override { return mFence; }
+
+        void ExecuteCommandLists(uint32_t numCommandRecorders, CommandRecorder* const* commandRecorders) override
+        {
+            assert(numCommandRecorders <= MAX_BATCHED_COMMAND_LISTS);
+
+            std::array<ID3D12CommandList*, MAX_BATCHED_COMMAND_LISTS> commandLists{};
+
+            for (uint32_t recorderIndex = 0; recorderIndex < numCommandRecorders; recorderIndex++)
+            {
+                commandRecorders[recorderIndex]->Close();
+                commandLists[recorderIndex] = commandRecorders[recorderIndex]->GetNativeCommandList();
+            }
+
+            mQueue->ExecuteCommandLists(numCommandRecorders, commandLists.data());
+        }
+
+        void Signal(uint64_t fenceValue) override
+        {
+            mQueue->Signal(mFence, fenceValue);
+        }
+
+        void InsertWait(QueueBackend& sourceQueue, uint64_t fenceValue) override
+        {
+            mQueue->Wait(sourceQueue.GetNativeFence(), fenceValue);
+        }
+
+        uint64_t GetCompletedValue() override
+        {
+            return mFence->GetCompletedValue();
+        }
+
+        void WaitForFenceCPUBlocking(uint64_t fenceValue) override
+        {
+            mFence->SetEventOnCompletion(fenceValue, mFenceEventHandle);
+            WaitForSingleObjectEx(mFenceEventHandle, INFINITE, false);
+        }
+
+    private:
+        ID3D12CommandQueue* mQueue = nullptr;
+        ID3D12Fence* mFence = nullptr;
+        HANDLE mFenceEventHandle = 0;
+    };
+
+    //Keeps its DXC instances for every shader it compiles, the shader cache gives each compile thread its own.
+    class DXCShaderCompiler final : public ShaderCompiler
+    {
+    public:
+        DXCShaderCompiler()
+        {
+            AssertIfFailed(DxcCreateInstance(CLSID_DxcUtils, IID_PPV_ARGS(&mDxcUtils)));
+            AssertIfFailed(DxcCreateInstance(CLSID_DxcCompiler, IID_PPV_ARGS(&mDxcCompiler)));
+            AssertIfFailed(mDxcUtils->CreateDefaultIncludeHandler(&mDxcIncludeHandler));
+        }
+
+        ~DXCShaderCompiler()
+        {
+            SafeRelease(mDxcIncludeHandler);
+            SafeRelease(mDxcCompiler);
+            SafeRelease(mDxcUtils);
+        }
+
+        ShaderCompileOutput Compile(const ShaderCompileRequest& request, const std::string& source) override
+        {
+            ShaderCompileOutput output;
+
+            DxcBuffer sourceBuffer{};
+            sourceBuffer.Ptr = source.data();
+            sourceBuffer.Size = source.size();
+            sourceBuffer.Encoding = DXC_CP_ACP;
+
+            std::vector<LPCWSTR> arguments;
+            arguments.reserve(8 + request.mArguments.size());
+
+            arguments.push_back(request.mSourceName.c_str());
+            arguments.push_back(L"-E");
+            arguments.push_back(request.mEntryPoint.c_str());
+            arguments.push_back(L"-T");
+            arguments.push_back(request.mTarget.c_str());
+
+            for (const std::wstring& argument : request.mArguments)
+            {
+                arguments.push_back(argument.c_str());
+            }
+
+            IDxcResult* compilationResults = nullptr;
+            if (FAILED(mDxcCompiler->Compile(&sourceBuffer, arguments.data(), static_cast<uint32_t>(arguments.size()), mDxcIncludeHandler, IID_PPV_ARGS(&compilationResults))))
+            {
+                output.mErrors = "Failed to invoke the shader compiler.";
+                return output;
+            }
+
+            IDxcBlobUtf8* errors = nullptr;
+            compilationResults->GetOutput(DXC_OUT_ERRORS, IID_PPV_ARGS(&errors), nullptr);
+
+            if (errors != nullptr && errors->GetStringLength() != 0)
+            {
+                output.mErrors.assign(errors->GetStringPointer(), errors->GetStringLength());
+            }
+
+            HRESULT statusResult = E_FAIL;
+            compilationResults->GetStatus(&statusResult);
+
+            //-WX turns warnings into errors, so any error text fails the shader, same as before it was cached.
+            output.mSucceeded = SUCCEEDED(statusResult) && output.mErrors.empty();
+
+            if (output.mSucceeded)
+            {
+                IDxcBlob* shaderBlob = nullptr;
+                compilationResults->GetOutput(DXC_OUT_OBJECT, IID_PPV_ARGS(&shaderBlob), nullptr);
+                if (shaderBlob != nullptr)
+                {
+                    const uint8_t* byteCode = static_cast<const uint8_t*>(shaderBlob->GetBufferPointer());
+                    output.mByteCode.assign(byteCode, byteCode + shaderBlob->GetBufferSize());
+                }
+
+                IDxcBlob* pdbBlob = nullptr;
+                compilationResults->GetOutput(DXC_OUT_PDB, IID_PPV_ARGS(&pdbBlob), nullptr);
+                if (pdbBlob != nullptr)
+                {
+                    const uint8_t* debugData = static_cast<const uint8_t*>(pdbBlob->GetBufferPointer());
+                    output.mDebugData.assign(debugData, debugData + pdbBlob->GetBufferSize());
+                }
+
+                output.mSucceeded = !output.mByteCode.empty();
+
+                SafeRelease(pdbBlob);
+                SafeRelease(shaderBlob);
+            }
+
+            SafeRelease(errors);
+            SafeRelease(compilationResults);
+
+            return output;
+        }
+
+    private:
+        IDxcUtils* mDxcUtils = nullptr;
+        IDxcCompiler3* mDxcCompiler = nullptr;
+        IDxcIncludeHandler* mDxcIncludeHandler = nullptr;
+    };
+
+    class D3D12DeviceBackend final : public DeviceBackend
+    {
+    public:
+        D3D12DeviceBackend()
+        {
+#if defined(_DEBUG)
+            ID3D12Debug* debugController;
+            if (SUCCEEDED(D3D12GetDebugInterface(IID_PPV_ARGS(&debugController))))
+            {
+                debugController->EnableDebugLayer();
+                SafeRelease(debugController);
+            }
+#endif
+
+            AssertIfFailed(CreateDXGIFactory1(IID_PPV_ARGS(&mDXGIFactory)));
+
+            IDXGIAdapter1* adapter = nullptr;
+            uint32_t bestAdapterIndex = 0;
+            size_t bestAdapterMemory = 0;
+
+            for (uint32_t adapterIndex = 0; mDXGIFactory->EnumAdapters1(adapterIndex, &adapter) != DXGI_ERROR_NOT_FOUND; adapterIndex++)
+            {
+                DXGI_ADAPTER_DESC1 adapterDesc;
+                AssertIfFailed(adapter->GetDesc1(&adapterDesc));
+
+                if (adapterDesc.Flags & DXGI_ADAPTER_FLAG_SOFTWARE)
+                {
+                    continue;
+                }
+
+                if (FAILED(D3D12CreateDevice(adapter, D3D_FEATURE_LEVEL_12_2, _uuidof(ID3D12Device), nullptr)))
+                {
+                    continue;
+                }
+
+                if (adapterDesc.DedicatedVideoMemory > bestAdapterMemory)
+                {
+                    bestAdapterIndex = adapterIndex;
+                    bestAdapterMemory = adapterDesc.DedicatedVideoMemory;
+                }
+
+                SafeRelease(adapter);
+            }
+
+            if (bestAdapterMemory == 0)
+            {
+                AssertError("Failed to find an adapter.");
+            }
+
+            mDXGIFactory->EnumAdapters1(bestAdapterIndex, &adapter);
+
+            AssertIfFailed(D3D12CreateDevice(adapter, D3D_FEATURE_LEVEL_12_2, IID_PPV_ARGS(&mDevice)));
+
+            D3D12MA::ALLOCATOR_DESC desc = {};
+            desc.Flags = D3D12MA::ALLOCATOR_FLAG_NONE;
+            desc.pDevice = mDevice;
+            desc.pAdapter = adapter;
+
+            D3D12MA::CreateAllocator(&desc, &mAllocator);
+
+            SafeRelease(adapter);
+        }
+
+        ~D3D12DeviceBackend()
+        {
+            SafeRelease(mPipelineLibrary);
+            SafeRelease(mSwapChain);
+            SafeRelease(mAllocator);
+            SafeRelease(mDevice);
+            SafeRelease(mDXGIFactory);
+
+#ifdef _DEBUG
+            IDXGIDebug1* pDebug = nullptr;
+            if (SUCCEEDED(DXGIGetDebugInterface1(0, IID_PPV_ARGS(&pDebug))))
+            {
+                pDebug->ReportLiveObjects(DXGI_DEBUG_ALL, DXGI_DEBUG_RLO_FLAGS(DXGI_DEBUG_RLO_SUMMARY | DXGI_DEBUG_RLO_DETAIL | DXGI_DEBUG_RLO_IGNORE_INTERNAL));
+                SafeRelease(pDebug);
+            }
+#endif
+        }
+
+        DeviceBackendType GetType() const override { return DeviceBackendType::d3d12; }
+        ID3D12Device5* GetNativeDevice() override { return mDevice; }
+        D3D12MA::Allocator* GetAllocator() override { return mAllocator; }
+
+        std::unique_ptr<ShaderCompiler> CreateShaderCompiler() override { return std::make_unique<DXCShaderCompiler>(); }
+
+        std::unique_ptr<QueueBackend> CreateQueue(D3D12_COMMAND_LIST_TYPE commandType) override
+        {
+            return std::make_unique<D3D12QueueBackend>(mDevice, commandType);
+        }
+
+        std::unique_ptr<CommandRecorder> CreateCommandRecorder(D3D12_COMMAND_LIST_TYPE commandType) override
+        {
+            return std::make_unique<D3D12CommandRecorder>(mDevice, commandType);
+        }
+
+        ID3D12DescriptorHeap* CreateDescriptorHeap(const D3D12_DESCRIPTOR_HEAP_DESC& heapDesc, Descriptor& heapStart, uint32_t& descriptorSize) override
+        {
+            ID3D12DescriptorHeap* descriptorHeap = nullptr;
+            AssertIfFailed(mDevice->CreateDescriptorHeap(&heapDesc, IID_PPV_ARGS(&descriptorHeap)));
+
+            heapStart.mCPUHandle = descriptorHeap->GetCPUDescriptorHandleForHeapStart();
+
+            if (heapDesc.Flags & D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE)
+            {
+                heapStart.mGPUHandle = descriptorHeap->GetGPUDescriptorHandleForHeapStart();
+            }
+
+            descriptorSize = mDevice->GetDescriptorHandleIncrementSize(heapDesc.Type);
+
+            return descriptorHeap;
+        }
+
+        void CopyDescriptorsSimple(uint32_t numDescriptors, D3D12_CPU_DESCRIPTOR_HANDLE destDescriptorRangeStart, D3D12_CPU_DESCRIPTOR_HANDLE srcDescriptorRangeStart, D3D12_DESCRIPTOR_HEAP_TYPE descriptorType) override
+        {
+            mDevice->CopyDescriptorsSimple(numDescriptors, destDescriptorRangeStart, srcDescriptorRangeStart, descriptorType);
+        }
+
+        void CopyDescriptors(uint32_t numDestDescriptorRanges, const D3D12_CPU_DESCRIPTOR_HANDLE* destDescriptorRangeStarts, const uint32_t* destDescriptorRangeSizes,
+                             uint32_t numSrcDescriptorRanges, const D3D12_CPU_DESCRIPTOR_HANDLE* srcDescriptorRangeStarts, const uint32_t* srcDescriptorRangeSizes, D3D12_DESCRIPTOR_HEAP_TYPE descriptorType) override
+        {
+            mDevice->CopyDescriptors(numDestDescriptorRanges, destDescriptorRangeStarts, destDescriptorRangeSizes, numSrcDescriptorRanges, srcDescriptorRangeStarts, srcDescriptorRangeSizes, descriptorType);
+        }
+
+        void CreateResource(D3D12_HEAP_TYPE heapType, D3D12MA::Pool* pool, const D3D12_RESOURCE_DESC& resourceDesc, D3D12_RESOURCE_STATES initialState, const D3D12_CLEAR_VALUE* clearValue, Resource& resource) override
+        {
+            D3D12MA::ALLOCATION_DESC allocationDesc{};
+            allocationDesc.HeapType = heapType;
+            allocationDesc.CustomPool = pool;
+
+            mAllocator->CreateResource(&allocationDesc, &resourceDesc, initialState, clearValue, &resource.mAllocation, IID_PPV_ARGS(&resource.mResource));
+
+            //Lets defragmentation passes find the resource that owns an allocation.
+            resource.mAllocation->SetPrivateData(&resource);
+
+            if (resourceDesc.Dimension == D3D12_RESOURCE_DIMENSION_BUFFER)
+            {
+                resource.mVirtualAddress = resource.mResource->GetGPUVirtualAddress();
+            }
+        }
+
+        void UpdateResourceOwner(Resource& resource) override
+        {
+            if (resource.mAllocation != nullptr)
+            {
+                resource.mAllocation->SetPrivateData(&resource);
+            }
+        }
+
+        uint8_t* MapResource(Resource& resource) override
+        {
+            uint8_t* mappedResource = nullptr;
+            resource.mResource->Map(0, nullptr, reinterpret_cast<void**>(&mappedResource));
+
+            return mappedResource;
+        }
+
+        void ReleaseResource(Resource& resource, bool isMapped) override
+        {
+            if (isMapped)
+            {
+                resource.mResource->Unmap(0, nullptr);
+            }
+
+            //The pass frees the allocation together with its new place, the allocation has to stay valid until then.
+            for (uint32_t moveIndex = 0; moveIndex < mDefragmentationPass.MoveCount && resource.mAllocation != nullptr; moveIndex++)
+            {
+                D3D12MA::DEFRAGMENTATION_MOVE& move = mDefragmentationPass.pMoves[moveIndex];
+
+                if (move.pSrcAllocation == resource.mAllocation)
+                {
+                    move.Operation = D3D12MA::DEFRAGMENTATION_MOVE_OPERATION_DESTROY;
+                    resource.mAllocation = nullptr;
+                }
+            }
+
+            SafeRelease(resource.mResource);
+            SafeRelease(resource.mAllocation);
+        }
+
+        D3D12MA::Pool* CreateLinearBufferPool(D3D12_HEAP_TYPE heapType, uint64_t size) override
+        {
+            D3D12MA::POOL_DESC poolDesc = {};
+            poolDesc.Flags = D3D12MA::POOL_FLAG_ALGORITHM_LINEAR;
+            poolDesc.HeapProperties.Type = heapType;
+            poolDesc.HeapFlags = D3D12_HEAP_FLAG_ALLOW_ONLY_BUFFERS;
+            poolDesc.BlockSize = AlignU64(size, D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT);
+            poolDesc.MinBlockCount = 1;
+            poolDesc.MaxBlockCount = 1;
+
+            D3D12MA::Pool* pool = nullptr;
+            AssertIfFailed(mAllocator->CreatePool(&poolDesc, &pool));
+
+            return pool;
+        }
+
+        void ReleasePool(D3D12MA::Pool* pool) override
+        {
+            SafeRelease(pool);
+        }
+
+        bool BeginDefragmentation(uint64_t maxBytesPerPass, uint32_t maxResourcesPerPass) override
+        {
+            assert(mDefragmentationContext == nullptr);
+
+            D3D12MA::DEFRAGMENTATION_DESC defragmentationDesc = {};
+            defragmentationDesc.Flags = D3D12MA::DEFRAGMENTATION_FLAG_ALGORITHM_FULL;
+            defragmentationDesc.MaxBytesPerPass = maxBytesPerPass;
+            defragmentationDesc.MaxAllocationsPerPass = maxResourcesPerPass;
+
+            mAllocator->BeginDefragmentation(&defragmentationDesc, &mDefragmentationContext);
+
+            return true;
+        }
+
+        bool BeginDefragmentationPass(std::vector<Resource*>& movedResources) override
+        {
+            movedResources.clear();
+
+            if (mDefragmentationContext->BeginPass(&mDefragmentationPass) == S_OK)
+            {
+                return false;
+            }
+
+            for (uint32_t moveIndex = 0; moveIndex < mDefragmentationPass.MoveCount; moveIndex++)
+            {
+                D3D12MA::DEFRAGMENTATION_MOVE& move = mDefragmentationPass.pMoves[moveIndex];
+                move.Operation = D3D12MA::DEFRAGMENTATION_MOVE_OPERATION_IGNORE;
+
+                Resource* resource = static_cast<Resource*>(move.pSrcAllocation->GetPrivateData());
+                assert(resource == nullptr || resource->mAllocation == move.pSrcAllocation);
+
+                movedResources.push_back(resource);
+            }
+
+            return true;
+        }
+
+        void CreateDefragmentationDestination(uint32_t moveIndex, const D3D12_RESOURCE_DESC& resourceDesc, D3D12_RESOURCE_STATES initialState, const D3D12_CLEAR_VALUE* clearValue, Resource& resource) override
+        {
+            assert(moveIndex < mDefragmentationPass.MoveCount);
+
+            D3D12MA::DEFRAGMENTATION_MOVE& move = mDefragmentationPass.pMoves[moveIndex];
+            AssertIfFailed(mAllocator->CreateAliasingResource(move.pDstTmpAllocation, 0, &resourceDesc, initialState, clearValue, IID_PPV_ARGS(&resource.mResource)));
+
+            //Goes over to the moved allocation when the pass ends.
+            move.pDstTmpAllocation->SetResource(resource.mResource);
+            move.Operation = D3D12MA::DEFRAGMENTATION_MOVE_OPERATION_COPY;
+
+            if (resourceDesc.Dimension == D3D12_RESOURCE_DIMENSION_BUFFER)
+            {
+                resource.mVirtualAddress = resource.mResource->GetGPUVirtualAddress();
+            }
+        }
+
+        bool EndDefragmentationPass(DefragmentationStatistics& statistics) override
+        {
+            HRESULT result = mDefragmentationContext->EndPass(&mDefragmentationPass);
+            mDefragmentationPass = {};
+
+            GetDefragmentationStatistics(statistics);
+
+            return result == S_FALSE;
+        }
+
+        void EndDefragmentation(DefragmentationStatistics& statistics) override
+        {
+            if (mDefragmentationPass.MoveCount > 0)
+            {
+                mDefragmentationContext->EndPass(&mDefragmentationPass);
+                mDefragmentationPass = {};
+            }
+
+            GetDefragmentationStatistics(statistics);
+            SafeRelease(mDefragmentationContext);
+        }
+
+        void CreateConstantBufferView(const D3D12_CONSTANT_BUFFER_VIEW_DESC& viewDesc, D3D12_CPU_DESCRIPTOR_HANDLE destDescriptor) override
+        {
+            mDevice->CreateConstantBufferView(&viewDesc, destDescriptor);
+        }
+
+        void CreateShaderResourceView(const Resource& resource, const D3D12_SHADER_RESOURCE_VIEW_DESC* viewDesc, D3D12_CPU_DESCRIPTOR_HANDLE destDescriptor) override
+        {
+            mDevice->CreateShaderResourceView(resource.mResource, viewDesc, destDescriptor);
+        }
+
+        void CreateUnorderedAccessView(const Resource& resource, const D3D12_UNORDERED_ACCESS_VIEW_DESC* viewDesc, D3D12_CPU_DESCRIPTOR_HANDLE destDescriptor) override
+        {
+            mDevice->CreateUnorderedAccessView(resource.mResource, nullptr, viewDesc, destDescriptor);
+        }
+
+        void CreateRenderTargetView(const Resource& resource, const D3D12_RENDER_TARGET_VIEW_DESC* viewDesc, D3D12_CPU_DESCRIPTOR_HANDLE destDescriptor) override
+        {
+            mDevice->CreateRenderTargetView(resource.mResource, viewDesc, destDescriptor);
+        }
+
+        void CreateDepthStencilView(const Resource& resource, const D3D12_DEPTH_STENCIL_VIEW_DESC* viewDesc, D3D12_CPU_DESCRIPTOR_HANDLE destDescriptor) override
+        {
+            mDevice->CreateDepthStencilView(resource.mResource, viewDesc, destDescriptor);
+        }
+
+        void CreateSampler(const D3D12_SAMPLER_DESC& samplerDesc, D3D12_CPU_DESCRIPTOR_HANDLE destDescriptor) override
+        {
+            mDevice->CreateSampler(&samplerDesc, destDescriptor);
+        }
+
+        void GetCopyableFootprints(const D3D12_RESOURCE_DESC& resourceDesc, uint32_t firstSubresource, uint32_t numSubresources, uint64_t baseOffset,
+                                   D3D12_PLACED_SUBRESOURCE_FOOTPRINT* layouts, uint32_t* numRows, uint64_t* rowSizesInBytes, uint64_t* totalBytes) override
+        {
+            mDevice->GetCopyableFootprints(&resourceDesc, firstSubresource, numSubresources, baseOffset, layouts, numRows, rowSizesInBytes, totalBytes);
+        }
+
+        ID3D12RootSignature* CreateRootSignature(const D3D12_VERSIONED_ROOT_SIGNATURE_DESC& rootSignatureDesc) override
+        {
+            ID3DBlob* rootSignatureBlob = nullptr;
+            ID3DBlob* errorBlob = nullptr;
+            AssertIfFailed(D3D12SerializeVersionedRootSignature(&rootSignatureDesc, &rootSignatureBlob, &errorBlob));
+
+            ID3D12RootSignature* rootSignature = nullptr;
+            AssertIfFailed(mDevice->CreateRootSignature(0, rootSignatureBlob->GetBufferPointer(), rootSignatureBlob->GetBufferSize(), IID_PPV_ARGS(&rootSignature)));
+
+            SafeRelease(rootSignatureBlob);
+            SafeRelease(errorBlob);
+
+            return rootSignature;
+        }
+
+        ID3D12PipelineState* CreateGraphicsPipelineState(const D3D12_GRAPHICS_PIPELINE_STATE_DESC& pipelineDesc) override
+        {
+            ID3D12PipelineState* graphicsPipeline = nullptr;
+            AssertIfFailed(mDevice->CreateGraphicsPipelineState(&pipelineDesc, IID_PPV_ARGS(&graphicsPipeline)));
+
+            return graphicsPipeline;
+        }
+
+        ID3D12PipelineState* CreateComputePipelineState(const D3D12_COMPUTE_PIPELINE_STATE_DESC& pipelineDesc) override
+        {
+            ID3D12PipelineState* computePipeline = nullptr;
+            AssertIfFailed(mDevice->CreateComputePipelineState(&pipelineDesc, IID_PPV_ARGS(&computePipeline)));
+
+            return computePipeline;
+        }
+
+        bool OpenPipelineLibrary(std::vector<uint8_t> libraryData) override
+        {
+            SafeRelease(mPipelineLibrary);
+            mPipelineLibraryData = std::move(libraryData);
+
+            if (!mPipelineLibraryData.empty() && SUCCEEDED(mDevice->CreatePipelineLibrary(mPipelineLibraryData.data(), mPipelineLibraryData.size(), IID_PPV_ARGS(&mPipelineLibrary))))
+            {
+                return true;
+            }
+
+            //Drivers without pipeline library support leave mPipelineLibrary empty, every load then misses.
+            mPipelineLibraryData.clear();
+            mDevice->CreatePipelineLibrary(nullptr, 0, IID_PPV_ARGS(&mPipelineLibrary));
+
+            return false;
+        }
+
+        bool LoadGraphicsPipelineState(const wchar_t* name, const D3D12_GRAPHICS_PIPELINE_STATE_DESC& pipelineDesc, ID3D12PipelineState*& pipelineState) override
+        {
+            return mPipelineLibrary && SUCCEEDED(mPipelineLibrary->LoadGraphicsPipeline(name, &pipelineDesc, IID_PPV_ARGS(&pipelineState)));
+        }
+
+        bool LoadComputePipelineState(const wchar_t* name, const D3D12_COMPUTE_PIPELINE_STATE_DESC& pipelineDesc, ID3D12PipelineState*& pipelineState) override
+        {
+            return mPipelineLibrary && SUCCEEDED(mPipelineLibrary->LoadComputePipeline(name, &pipelineDesc, IID_PPV_ARGS(&pipelineState)));
+        }
+
+        bool StorePipelineState(const wchar_t* name, ID3D12PipelineState* pipelineState) override
+        {
+            if (!mPipelineLibrary || !pipelineState)
+            {
+                return false;
+            }
+
+            //E_INVALIDARG means the name is already in the library, which happens when two threads miss the same pipeline
+            //and both create it. Either copy is fine to keep.
+            HRESULT result = mPipelineLibrary->StorePipeline(name, pipelineState);
+
+            return SUCCEEDED(result) || result == E_INVALIDARG;
+        }
+
+        bool SerializePipelineLibrary(std::vector<uint8_t>& libraryData) override
+        {
+            if (!mPipelineLibrary)
+            {
+                return false;
+            }
+
+            libraryData.resize(mPipelineLibrary->GetSerializedSize());
+
+            return SUCCEEDED(mPipelineLibrary->Serialize(libraryData.data(), libraryData.size()));
+        }
+
+        void CreateSwapChain(HWND windowHandle, Uint2 screenSize, QueueBackend& presentQueue) override
+        {
+            DXGI_SWAP_CHAIN_DESC1 swapChainDesc = {};
+            ZeroMemory(&swapChainDesc, sizeof(swapChainDesc));
+            swapChainDesc.Width = lround(screenSize.x);
+            swapChainDesc.Height = lround(screenSize.y);
+            swapChainDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+            swapChainDesc.Stereo = false;
+            swapChainDesc.SampleDesc.Count = 1;
+            swapChainDesc.SampleDesc.Quality = 0;
+            swapChainDesc.BufferUsage = DXGI_USAGE_RENDER_TARGET_OUTPUT;
+            swapChainDesc.BufferCount = NUM_BACK_BUFFERS;
+            swapChainDesc.SwapEffect = DXGI_SWAP_EFFECT_FLIP_DISCARD;
+            swapChainDesc.Flags = 0;
+            swapChainDesc.Scaling = DXGI_SCALING_NONE;
+            swapChainDesc.AlphaMode = DXGI_ALPHA_MODE_UNSPECIFIED;
+
+            IDXGISwapChain1* swapChain = nullptr;
+            AssertIfFailed(mDXGIFactory->CreateSwapChainForHwnd(presentQueue.GetNativeQueue(), windowHandle, &swapChainDesc, nullptr, nullptr, &swapChain));
+            AssertIfFailed(swapChain->QueryInterface(__uuidof(IDXGISwapChain3), (void**)&mSwapChain));
+            SafeRelease(swapChain);
+        }
+
+        void GetSwapChainBuffer(uint32_t bufferIndex, TextureResource& backBuffer) override
+        {
+            ID3D12Resource* backBufferResource = nullptr;
+            AssertIfFailed(mSwapChain->GetBuffer(bufferIndex, IID_PPV_ARGS(&backBufferResource)));
+
+            backBuffer.mDesc = backBufferResource->GetDesc();
+            backBuffer.mResource = backBufferResource;
+        }
+
+        uint32_t GetCurrentBackBufferIndex() override
+        {
+            return mSwapChain->GetCurrentBackBufferIndex();
+        }
+
+        void Present() override
+        {
+            mSwapChain->Present(0, 0);
+        }
+
+        void DestroySwapChain() override
+        {
+            SafeRelease(mSwapChain);
+        }
+
+    private:
+        void GetDefragmentationStatistics(DefragmentationStatistics& statistics)
+        {
+            D3D12MA::DEFRAGMENTATION_STATS defragmentationStats = {};
+            mDefragmentationContext->GetStats(&defragmentationStats);
+
+            statistics.mBytesMoved = defragmentationStats.BytesMoved;
+            statistics.mBytesFreed = defragmentationStats.BytesFreed;
+            statistics.mNumResourcesMoved = defragmentationStats.AllocationsMoved;
+            statistics.mNumHeapsFreed = defragmentationStats.HeapsFreed;
+        }
+
+        ID3D12Device5* mDevice = nullptr;
+        IDXGIFactory7* mDXGIFactory = nullptr;
+        IDXGISwapChain4* mSwapChain = nullptr;
+        D3D12MA::Allocator* mAllocator = nullptr;
+        D3D12MA::DefragmentationContext* mDefragmentationContext = nullptr;
+        D3D12MA::DEFRAGMENTATION_PASS_MOVE_INFO mDefragmentationPass{};
+        ID3D12PipelineLibrary1* mPipelineLibrary = nullptr;
+        std::vector<uint8_t> mPipelineLibraryData;
+    };
+
+    std::unique_ptr<DeviceBackend> CreateD3D12DeviceBackend()
+    {
+        return std::make_unique<D3D12DeviceBackend>();
+    }
+}
@@ -0,0 +1,145 @@
+#pragma once
+#include "D3D12Lite.h"
+
+namespace D3D12Lite
+{
+    //Thin layer between D3D12Lite and the API it drives. Everything that used to call straight into ID3D12Device,
+    //ID3D12CommandQueue or ID3D12GraphicsCommandList goes through one of these interfaces instead, so the frame loop
+    //can run against the null backend (D3D12LiteNullBackend.h) when there is no GPU available. The D3D12 types still
+    //come from the Windows SDK headers, so that means a Windows machine without a GPU, e.g. a CI runner, not another OS.
+
+    class CommandRecorder
+    {
+    public:
+        virtual ~CommandRecorder() = default;
+
+        //Returns nullptr on backends without a native command list (e.g. the null backend).
+        virtual ID3D12GraphicsCommandList* GetNativeCommandList() = 0;
+
+        virtual void Reset(uint32_t frameIndex) = 0;
+        virtual void Close() = 0;
+
+        virtual void ResourceBarrier(uint32_t numBarriers, const D3D12_RESOURCE_BARRIER* barriers) = 0;
+        virtual void SetDescriptorHeaps(uint32_t numDescriptorHeaps, ID3D12DescriptorHeap* const* descriptorHeaps) = 0;
+        virtual void CopyResource(const Resource& destination, const Resource& source) = 0;
+        virtual void CopyBufferRegion(const Resource& destination, uint64_t destOffset, const Resource& source, uint64_t sourceOffset, uint64_t numBytes) = 0;
+        //sourceBox nullptr copies the whole source to the origin of the destination.
+        virtual void CopyTextureRegion(const D3D12_TEXTURE_COPY_LOCATION& destination, uint32_t destX, uint32_t destY, uint32_t destZ, const D3D12_TEXTURE_COPY_LOCATION& source, const D3D12_BOX* sourceBox) = 0;
+
+        virtual void RSSetViewports(uint32_t numViewports, const D3D12_VIEWPORT* viewports) = 0;
+        virtual void RSSetScissorRects(uint32_t numRects, const D3D12_RECT* rects) = 0;
+        virtual void OMSetStencilRef(uint32_t stencilRef) = 0;
+        virtual void OMSetBlendFactor(const float blendFactor[4]) = 0;
+        virtual void OMSetRenderTargets(uint32_t numRenderTargets, const D3D12_CPU_DESCRIPTOR_HANDLE* renderTargets, const D3D12_CPU_DESCRIPTOR_HANDLE* depthStencil) = 0;
+        virtual void IASetPrimitiveTopology(D3D12_PRIMITIVE_TOPOLOGY topology) = 0;
+        virtual void IASetIndexBuffer(const D3D12_INDEX_BUFFER_VIEW* indexBufferView) = 0;
+
+        virtual void SetPipelineState(ID3D12PipelineState* pipelineState) = 0;
+        virtual void SetGraphicsRootSignature(ID3D12RootSignature* rootSignature) = 0;
+        virtual void SetComputeRootSignature(ID3D12RootSignature* rootSignature) = 0;
+        virtual void SetGraphicsRootConstantBufferView(uint32_t rootParameterIndex, D3D12_GPU_VIRTUAL_ADDRESS bufferLocation) = 0;
+        virtual void SetComputeRootConstantBufferView(uint32_t rootParameterIndex, D3D12_GPU_VIRTUAL_ADDRESS bufferLocation) = 0;
+        virtual void SetGraphicsRootDescriptorTable(uint32_t rootParameterIndex, D3D12_GPU_DESCRIPTOR_HANDLE baseDescriptor) = 0;
+        virtual void SetComputeRootDescriptorTable(uint32_t rootParameterIndex, D3D12_GPU_DESCRIPTOR_HANDLE baseDescriptor) = 0;
+
+        virtual void ClearRenderTargetView(D3D12_CPU_DESCRIPTOR_HANDLE renderTarget, const float color[4]) = 0;
+        virtual void ClearDepthStencilView(D3D12_CPU_DESCRIPTOR_HANDLE depthStencil, D3D12_CLEAR_FLAGS clearFlags, float depth, uint8_t stencil) = 0;
+        virtual void DrawInstanced(uint32_t vertexCountPerInstance, uint32_t instanceCount, uint32_t startVertexLocation, uint32_t startInstanceLocation) = 0;
+        virtual void DrawIndexedInstanced(uint32_t indexCountPerInstance, uint32_t instanceCount, uint32_t startIndexLocation, int32_t baseVertexLocation, uint32_t startInstanceLocation) = 0;
+        virtual void Dispatch(uint32_t groupCountX, uint32_t groupCountY, uint32_t groupCountZ) = 0;
+    };
+
+    class QueueBackend
+    {
+    public:
+        virtual ~QueueBackend() = default;
+
+        virtual ID3D12CommandQueue* GetNativeQueue() = 0;
+        virtual ID3D12Fence* GetNativeFence() = 0;
+
+        //Closes the recorders and submits them in order as a single batch.
+        virtual void ExecuteCommandLists(uint32_t numCommandRecorders, CommandRecorder* const* commandRecorders) = 0;
+        virtual void Signal(uint64_t fenceValue) = 0;
+        virtual void InsertWait(QueueBackend& sourceQueue, uint64_t fenceValue) = 0;
+        virtual uint64_t GetCompletedValue() = 0;
+        virtual void WaitForFenceCPUBlocking(uint64_t fenceValue) = 0;
+    };
+
+    class DeviceBackend
+    {
+    public:
+        virtual ~DeviceBackend() = default;
+
+        virtual DeviceBackendType GetType() const = 0;
+        virtual ID3D12Device5* GetNativeDevice() = 0;
+        virtual D3D12MA::Allocator* GetAllocator() = 0;
+
+        //Called by the shader cache once per compile thread, from that thread.
+        virtual std::unique_ptr<ShaderCompiler> CreateShaderCompiler() = 0;
+
+        virtual std::unique_ptr<QueueBackend> CreateQueue(D3D12_COMMAND_LIST_TYPE commandType) = 0;
+        virtual std::unique_ptr<CommandRecorder> CreateCommandRecorder(D3D12_COMMAND_LIST_TYPE commandType) = 0;
+
+        virtual ID3D12DescriptorHeap* CreateDescriptorHeap(const D3D12_DESCRIPTOR_HEAP_DESC& heapDesc, Descriptor& heapStart, uint32_t& descriptorSize) = 0;
+        virtual void CopyDescriptorsSimple(uint32_t numDescriptors, D3D12_CPU_DESCRIPTOR_HANDLE destDescriptorRangeStart, D3D12_CPU_DESCRIPTOR_HANDLE srcDescriptorRangeStart, D3D12_DESCRIPTOR_HEAP_TYPE descriptorType) = 0;
+        virtual void CopyDescriptors(uint32_t numDestDescriptorRanges, const D3D12_CPU_DESCRIPTOR_HANDLE* destDescriptorRangeStarts, const uint32_t* destDescriptorRangeSizes,
+                                     uint32_t numSrcDescriptorRanges, const D3D12_CPU_DESCRIPTOR_HANDLE* srcDescriptorRangeStarts, const uint32_t* srcDescriptorRangeSizes, D3D12_DESCRIPTOR_HEAP_TYPE descriptorType) = 0;
+
+        //Fills mResource, mAllocation and mVirtualAddress of the given resource. When a pool is given the heap type is the pool's.
+        virtual void CreateResource(D3D12_HEAP_TYPE heapType, D3D12MA::Pool* pool, const D3D12_RESOURCE_DESC& resourceDesc, D3D12_RESOURCE_STATES initialState, const D3D12_CLEAR_VALUE* clearValue, Resource& resource) = 0;
+        virtual uint8_t* MapResource(Resource& resource) = 0;
+        virtual void ReleaseResource(Resource& resource, bool isMapped) = 0;
+        //Points the allocation back at its owner after a Resource was moved or swapped into another object.
+        virtual void UpdateResourceOwner(Resource& resource) = 0;
+
+        //Returns nullptr on backends without a memory allocator (e.g. the null backend).
+        virtual D3D12MA::Pool* CreateLinearBufferPool(D3D12_HEAP_TYPE heapType, uint64_t size) = 0;
+        virtual void ReleasePool(D3D12MA::Pool* pool) = 0;
+
+        //Defragmentation of the default heaps, returns false on backends without a memory allocator. Each pass hands out the
+        //resources it wants to move, nullptr for allocations not made through CreateResource. A move only happens if a
+        //resource was created in its new place with CreateDefragmentationDestination, the others are left where they are.
+        //Allocations released while a pass is in flight are freed when the pass ends.
+        virtual bool BeginDefragmentation(uint64_t maxBytesPerPass, uint32_t maxResourcesPerPass) = 0;
+        //Returns false once there is nothing left to move.
+        virtual bool BeginDefragmentationPass(std::vector<Resource*>& movedResources) = 0;
+        virtual void CreateDefragmentationDestination(uint32_t moveIndex, const D3D12_RESOURCE_DESC& resourceDesc, D3D12_RESOURCE_STATES initialState, const D3D12_CLEAR_VALUE* clearValue, Resource& resource) = 0;
+        //Returns true if another pass may free more. The GPU has to be done with the old places.
+        virtual bool EndDefragmentationPass(DefragmentationStatistics& statistics) = 0;
+        //Ends a pass that is still in flight.
+        virtual void EndDefragmentation(DefragmentationStatistics& statistics) = 0;
+
+        virtual void CreateConstantBufferView(const D3D12_CONSTANT_BUFFER_VIEW_DESC& viewDesc, D3D12_CPU_DESCRIPTOR_HANDLE destDescriptor) = 0;
+        virtual void CreateShaderResourceView(const Resource& resource, const D3D12_SHADER_RESOURCE_VIEW_DESC* viewDesc, D3D12_CPU_DESCRIPTOR_HANDLE destDescriptor) = 0;
+        virtual void CreateUnorderedAccessView(const Resource& resource, const D3D12_UNORDERED_ACCESS_VIEW_DESC* viewDesc, D3D12_CPU_DESCRIPTOR_HANDLE destDescriptor) = 0;
+        virtual void CreateRenderTargetView(const Resource& resource, const D3D12_RENDER_TARGET_VIEW_DESC* viewDesc, D3D12_CPU_DESCRIPTOR_HANDLE destDescriptor) = 0;
+        virtual void CreateDepthStencilView(const Resource& resource, const D3D12_DEPTH_STENCIL_VIEW_DESC* viewDesc, D3D12_CPU_DESCRIPTOR_HANDLE destDescriptor) = 0;
+        virtual void CreateSampler(const D3D12_SAMPLER_DESC& samplerDesc, D3D12_CPU_DESCRIPTOR_HANDLE destDescriptor) = 0;
+
+        virtual void GetCopyableFootprints(const D3D12_RESOURCE_DESC& resourceDesc, uint32_t firstSubresource, uint32_t numSubresources, uint64_t baseOffset,
+                                           D3D12_PLACED_SUBRESOURCE_FOOTPRINT* layouts, uint32_t* numRows, uint64_t* rowSizesInBytes, uint64_t* totalBytes) = 0;
+
+        virtual ID3D12RootSignature* CreateRootSignature(const D3D12_VERSIONED_ROOT_SIGNATURE_DESC& rootSignatureDesc) = 0;
+        virtual ID3D12PipelineState* CreateGraphicsPipelineState(const D3D12_GRAPHICS_PIPELINE_STATE_DESC& pipelineDesc) = 0;
+        virtual ID3D12PipelineState* CreateComputePipelineState(const D3D12_COMPUTE_PIPELINE_STATE_DESC& pipelineDesc) = 0;
+
+        //Pipeline library the pipeline cache persists compiled pipelines in. Opening takes over the data, as the library
+        //reads from it for as long as it lives, and falls back to an empty library when the data is missing or was written
+        //by another driver, in which case it returns false. Loads fail for names the library does not have or that were
+        //stored with a different desc. Storing returns whether the library holds the pipeline afterwards, which includes a
+        //name that was already stored, e.g. by another thread that missed the same pipeline.
+        virtual bool OpenPipelineLibrary(std::vector<uint8_t> libraryData) = 0;
+        virtual bool LoadGraphicsPipelineState(const wchar_t* name, const D3D12_GRAPHICS_PIPELINE_STATE_DESC& pipelineDesc, ID3D12PipelineState*& pipelineState) = 0;
+        virtual bool LoadComputePipelineState(const wchar_t* name, const D3D12_COMPUTE_PIPELINE_STATE_DESC& pipelineDesc, ID3D12PipelineState*& pipelineState) = 0;
+        virtual bool StorePipelineState(const wchar_t* name, ID3D12PipelineState* pipelineState) = 0;
+        virtual bool SerializePipelineLibrary(std::vector<uint8_t>& libraryData) = 0;
+
+        virtual void CreateSwapChain(HWND windowHandle, Uint2 screenSize, QueueBackend& presentQueue) = 0;
+        virtual void GetSwapChainBuffer(uint32_t bufferIndex, TextureResource& backBuffer) = 0;
+        virtual uint32_t GetCurrentBackBufferIndex() = 0;
+        virtual void Present() = 0;
+        virtual void DestroySwapChain() = 0;
+    };
+
+    std::unique_ptr<DeviceBackend> CreateD3D12DeviceBackend();
+}
@@ -0,0 +1,551 @@
+#include "D3D12LiteNullBackend.h"
+#include "DXTex/DirectXTex.h"
+#include <thread>
+
+namespace D3D12Lite
+{
+    void CommandStream::Record(RecordedCommandType type, uint64_t argument0, uint64_t argument1, uint64_t argument2, uint64_t argument3)
+    {
+        RecordedCommand& command = mCommands.emplace_back();
+        command.mType = type;
+        command.mArguments = { argument0, argument1, argument2, argument3 };
+
+        mCommandCounts[static_cast<uint32_t>(type)]++;
+    }
+
+    void CommandStream::Clear()
+    {
+        mCommands.clear();
+        mCommandCounts.fill(0);
+    }
+
+    void NullCommandRecorder::Reset(uint32_t frameIndex)
+    {
+        mCommandStream.Clear();
+        mIsClosed = false;
+    }
+
+    void NullCommandRecorder::Close()
+    {
+        assert(!mIsClosed);
+        mIsClosed = true;
+    }
+
+    void NullCommandRecorder::ResourceBarrier(uint32_t numBarriers, const D3D12_RESOURCE_BARRIER* barriers)
+    {
+        mCommandStream.Record(RecordedCommandType::resourceBarrier, numBarriers);
+    }
+
+    void NullCommandRecorder::SetDescriptorHeaps(uint32_t numDescriptorHeaps, ID3D12DescriptorHeap* const* descriptorHeaps)
+    {
+        mCommandStream.Record(RecordedCommandType::setDescriptorHeaps, numDescriptorHeaps);
+    }
+
+    void NullCommandRecorder::CopyResource(const Resource& destination, const Resource& source)
+    {
+        mCommandStream.Record(RecordedCommandType::copyResource, destination.mVirtualAddress, source.mVirtualAddress);
+    }
+
+    void NullCommandRecorder::CopyBufferRegion(const Resource& destination, uint64_t destOffset, const Resource& source, uint64_t sourceOffset, uint64_t numBytes)
+    {
+        mCommandStream.Record(RecordedCommandType::copyBufferRegion, destination.mVirtualAddress + destOffset, source.mVirtualAddress + sourceOffset, numBytes);
+    }
+
+    void NullCommandRecorder::CopyTextureRegion(const D3D12_TEXTURE_COPY_LOCATION& destination, uint32_t destX, uint32_t destY, uint32_t destZ, const D3D12_TEXTURE_COPY_LOCATION& source, const D3D12_BOX* sourceBox)
+    {
+        mCommandStream.Record(RecordedCommandType::copyTextureRegion, destination.SubresourceIndex, source.PlacedFootprint.Offset, destY, destZ);
+    }
+
+    void NullCommandRecorder::RSSetViewports(uint32_t numViewports, const D3D12_VIEWPORT* viewports)
+    {
+        mCommandStream.Record(RecordedCommandType::setViewports, numViewports);
+    }
+
+    void NullCommandRecorder::RSSetScissorRects(uint32_t numRects, const D3D12_RECT* rects)
+    {
+        mCommandStream.Record(RecordedCommandType::setScissorRects, numRects);
+    }
+
+    void NullCommandRecorder::OMSetStencilRef(uint32_t stencilRef)
+    {
+        mCommandStream.Record(RecordedCommandType::setStencilRef, stencilRef);
+    }
+
+    void NullCommandRecorder::OMSetBlendFactor(const float blendFactor[4])
+    {
+        mCommandStream.Record(RecordedCommandType::setBlendFactor);
+    }
+
+    void NullCommandRecorder::OMSetRenderTargets(uint32_t numRenderTargets, const D3D12_CPU_DESCRIPTOR_HANDLE* renderTargets, const D3D12_CPU_DESCRIPTOR_HANDLE* depthStencil)
+    {
+        mCommandStream.Record(RecordedCommandType::setRenderTargets, numRenderTargets, numRenderTargets > 0 ? renderTargets[0].ptr : 0, depthStencil ? depthStencil->ptr : 0);
+    }
+
+    void NullCommandRecorder::IASetPrimitiveTopology(D3D12_PRIMITIVE_TOPOLOGY topology)
+    {
+        mCommandStream.Record(RecordedCommandType::setPrimitiveTopology, topology);
+    }
+
+    void NullCommandRecorder::IASetIndexBuffer(const D3D12_INDEX_BUFFER_VIEW* indexBufferView)
+    {
+        mCommandStream.Record(RecordedCommandType::setIndexBuffer, indexBufferView ? indexBufferView->BufferLocation : 0, indexBufferView ? indexBufferView->SizeInBytes : 0);
+    }
+
+    void NullCommandRecorder::SetPipelineState(ID3D12PipelineState* pipelineState)
+    {
+        mCommandStream.Record(RecordedCommandType::setPipelineState, reinterpret_cast<uint64_t>(pipelineState));
+    }
+
+    void NullCommandRecorder::SetGraphicsRootSignature(ID3D12RootSignature* rootSignature)
+    {
+        mCommandStream.Record(RecordedCommandType::setGraphicsRootSignature, reinterpret_cast<uint64_t>(rootSignature));
+    }
+
+    void NullCommandRecorder::SetComputeRootSignature(ID3D12RootSignature* rootSignature)
+    {
+        mCommandStream.Record(RecordedCommandType::setComputeRootSignature, reinterpret_cast<uint64_t>(rootSignature));
+    }
+
+    void NullCommandRecorder::SetGraphicsRootConstantBufferView(uint32_t rootParameterIndex, D3D12_GPU_VIRTUAL_ADDRESS bufferLocation)
+    {
+        mCommandStream.Record(RecordedCommandType::setGraphicsRootConstantBufferView, rootParameterIndex, bufferLocation);
+    }
+
+    void NullCommandRecorder::SetComputeRootConstantBufferView(uint32_t rootParameterIndex, D3D12_GPU_VIRTUAL_ADDRESS bufferLocation)
+    {
+        mCommandStream.Record(RecordedCommandType::setComputeRootConstantBufferView, rootParameterIndex, bufferLocation);
+    }
+
+    void NullCommandRecorder::SetGraphicsRootDescriptorTable(uint32_t rootParameterIndex, D3D12_GPU_DESCRIPTOR_HANDLE baseDescriptor)
+    {
+        mCommandStream.Record(RecordedCommandType::setGraphicsRootDescriptorTable, rootParameterIndex, baseDescriptor.ptr);
+    }
+
+    void NullCommandRecorder::SetComputeRootDescriptorTable(uint32_t rootParameterIndex, D3D12_GPU_DESCRIPTOR_HANDLE baseDescriptor)
+    {
+        mCommandStream.Record(RecordedCommandType::setComputeRootDescriptorTable, rootParameterIndex, baseDescriptor.ptr);
+    }
+
+    void NullCommandRecorder::ClearRenderTargetView(D3D12_CPU_DESCRIPTOR_HANDLE renderTarget, const float color[4])
+    {
+        mCommandStream.Record(RecordedCommandType::clearRenderTarget, renderTarget.ptr);
+    }
+
+    void NullCommandRecorder::ClearDepthStencilView(D3D12_CPU_DESCRIPTOR_HANDLE depthStencil, D3D12_CLEAR_FLAGS clearFlags, float depth, uint8_t stencil)
+    {
+        mCommandStream.Record(RecordedCommandType::clearDepthStencil, depthStencil.ptr, clearFlags, stencil);
+    }
+
+    void NullCommandRecorder::DrawInstanced(uint32_t vertexCountPerInstance, uint32_t instanceCount, uint32_t startVertexLocation, uint32_t startInstanceLocation)
+    {
+        mCommandStream.Record(RecordedCommandType::drawInstanced, vertexCountPerInstance, instanceCount, startVertexLocation, startInstanceLocation);
+    }
+
+    void NullCommandRecorder::DrawIndexedInstanced(uint32_t indexCountPerInstance, uint32_t instanceCount, uint32_t startIndexLocation, int32_t baseVertexLocation, uint32_t startInstanceLocation)
+    {
+        mCommandStream.Record(RecordedCommandType::drawIndexedInstanced, indexCountPerInstance, instanceCount, startIndexLocation, static_cast<uint32_t>(baseVertexLocation));
+    }
+
+    void NullCommandRecorder::Dispatch(uint32_t groupCountX, uint32_t groupCountY, uint32_t groupCountZ)
+    {
+        mCommandStream.Record(RecordedCommandType::dispatch, groupCountX, groupCountY, groupCountZ);
+    }
+
+    NullQueueBackend::NullQueueBackend(NullDeviceBackend& device, std::chrono::microseconds fenceLatency)
+        :mDevice(device)
+        , mFenceLatency(fenceLatency)
+        , mEarliestNextCompletion(Clock::now())
+    {
+    }
+
+    void NullQueueBackend::ExecuteCommandLists(uint32_t numCommandRecorders, CommandRecorder* const* commandRecorders)
+    {
+        for (uint32_t recorderIndex = 0; recorderIndex < numCommandRecorders; recorderIndex++)
+        {
+            NullCommandRecorder& nullCommandRecorder = static_cast<NullCommandRecorder&>(*commandRecorders[recorderIndex]);
+            nullCommandRecorder.Close();
+
+            mDevice.AddSubmittedCommands(nullCommandRecorder.GetCommandStream());
+        }
+
+        mDevice.AddSubmissionBatch();
+    }
+
+    void NullQueueBackend::Signal(uint64_t fenceValue)
+    {
+        std::lock_guard<std::mutex> lockGuard(mSignalMutex);
+
+        PendingSignal signal;
+        signal.mFenceValue = fenceValue;
+        signal.mCompletionTime = (std::max)(Clock::now() + mFenceLatency, mEarliestNextCompletion);
+
+        //A queue executes in order, so a signal can't complete before the one in front of it.
+        if (!mPendingSignals.empty())
+        {
+            signal.mCompletionTime = (std::max)(signal.mCompletionTime, mPendingSignals.back().mCompletionTime);
+        }
+
+        mPendingSignals.push_back(signal);
+    }
+
+    void NullQueueBackend::InsertWait(QueueBackend& sourceQueue, uint64_t fenceValue)
+    {
+        Clock::time_point sourceCompletionTime = static_cast<NullQueueBackend&>(sourceQueue).GetCompletionTime(fenceValue);
+
+        std::lock_guard<std::mutex> lockGuard(mSignalMutex);
+        mEarliestNextCompletion = (std::max)(mEarliestNextCompletion, sourceCompletionTime);
+    }
+
+    uint64_t NullQueueBackend::GetCompletedValue()
+    {
+        std::lock_guard<std::mutex> lockGuard(mSignalMutex);
+
+        RetireCompletedSignals(Clock::now());
+
+        return mCompletedValue;
+    }
+
+    void NullQueueBackend::WaitForFenceCPUBlocking(uint64_t fenceValue)
+    {
+        Clock::time_point completionTime = GetCompletionTime(fenceValue);
+        std::this_thread::sleep_until(completionTime);
+
+        std::lock_guard<std::mutex> lockGuard(mSignalMutex);
+        RetireCompletedSignals((std::max)(Clock::now(), completionTime));
+    }
+
+    NullQueueBackend::Clock::time_point NullQueueBackend::GetCompletionTime(uint64_t fenceValue)
+    {
+        std::lock_guard<std::mutex> lockGuard(mSignalMutex);
+
+        for (const PendingSignal& pendingSignal : mPendingSignals)
+        {
+            if (pendingSignal.mFenceValue >= fenceValue)
+            {
+                return pendingSignal.mCompletionTime;
+            }
+        }
+
+        //Either already retired, or never signaled (which a real fence would hang on, so don't pretend otherwise).
+        assert(fenceValue <= mCompletedValue);
+        return Clock::time_point::min();
+    }
+
+    void NullQueueBackend::RetireCompletedSignals(Clock::time_point currentTime)
+    {
+        while (!mPendingSignals.empty() && mPendingSignals.front().mCompletionTime <= currentTime)
+        {
+            mCompletedValue = mPendingSignals.front().mFenceValue;
+            mPendingSignals.pop_front();
+        }
+    }
+
+    NullDeviceBackend::NullDeviceBackend(const NullDeviceDesc& desc)
+        :mDesc(desc)
+    {
+    }
+
+    void NullDeviceBackend::ResetStatistics()
+    {
+        std::lock_guard<std::mutex> lockGuard(mStatisticsMutex);
+        mStatistics = NullBackendStatistics();
+    }
+
+    void NullDeviceBackend::AddSubmittedCommands(const CommandStream& commandStream)
+    {
+        std::lock_guard<std::mutex> lockGuard(mStatisticsMutex);
+
+        const RecordedCommandCounts& commandCounts = commandStream.GetCommandCounts();
+        for (uint32_t commandTypeIndex = 0; commandTypeIndex < NUM_RECORDED_COMMAND_TYPES; commandTypeIndex++)
+        {
+            mStatistics.mSubmittedCommandCounts[commandTypeIndex] += commandCounts[commandTypeIndex];
+        }
+
+        mStatistics.mNumSubmittedCommandLists++;
+    }
+
+    void NullDeviceBackend::AddSubmissionBatch()
+    {
+        std::lock_guard<std::mutex> lockGuard(mStatisticsMutex);
+        mStatistics.mNumSubmissionBatches++;
+    }
+
+    namespace
+    {
+        //Nothing reads the bytecode on this backend, so a hash of everything the request compiles from stands in for it.
+        //It stays unique per shader and non-empty, which is all the pipeline creation above it needs.
+        class NullShaderCompiler final : public ShaderCompiler
+        {
+        public:
+            ShaderCompileOutput Compile(const ShaderCompileRequest& request, const std::string& source) override
+            {
+                Hasher hasher;
+                hasher.Add(source);
+                hasher.Add(request.mEntryPoint);
+                hasher.Add(request.mTarget);
+
+                const uint64_t hash = hasher.GetHash();
+
+                ShaderCompileOutput output;
+                output.mSucceeded = true;
+                output.mByteCode.resize(sizeof(hash));
+                memcpy(output.mByteCode.data(), &hash, sizeof(hash));
+
+                return output;
+            }
+        };
+    }
+
+    std::unique_ptr<ShaderCompiler> NullDeviceBackend::CreateShaderCompiler()
+    {
+        return std::make_unique<NullShaderCompiler>();
+    }
+
+    std::unique_ptr<QueueBackend> NullDeviceBackend::CreateQueue(D3D12_COMMAND_LIST_TYPE commandType)
+    {
+        return std::make_unique<NullQueueBackend>(*this, std::chrono::microseconds(mDesc.mFenceLatencyMicroseconds));
+    }
+
+    std::unique_ptr<CommandRecorder> NullDeviceBackend::CreateCommandRecorder(D3D12_COMMAND_LIST_TYPE commandType)
+    {
+        return std::make_unique<NullCommandRecorder>();
+    }
+
+    ID3D12DescriptorHeap* NullDeviceBackend::CreateDescriptorHeap(const D3D12_DESCRIPTOR_HEAP_DESC& heapDesc, Descriptor& heapStart, uint32_t& descriptorSize)
+    {
+        //Handles only need to be unique and non-zero, nothing ever dereferences them.
+        const uint64_t heapAddress = AllocateAddressRange(static_cast<uint64_t>(heapDesc.NumDescriptors) * NULL_BACKEND_DESCRIPTOR_SIZE);
+
+        heapStart.mCPUHandle.ptr = static_cast<SIZE_T>(heapAddress);
+
+        if (heapDesc.Flags & D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE)
+        {
+            heapStart.mGPUHandle.ptr = heapAddress;
+        }
+
+        descriptorSize = NULL_BACKEND_DESCRIPTOR_SIZE;
+
+        return nullptr;
+    }
+
+    void NullDeviceBackend::CreateResource(D3D12_HEAP_TYPE heapType, D3D12MA::Pool* pool, const D3D12_RESOURCE_DESC& resourceDesc, D3D12_RESOURCE_STATES initialState, const D3D12_CLEAR_VALUE* clearValue, Resource& resource)
+    {
+        if (resourceDesc.Dimension != D3D12_RESOURCE_DIMENSION_BUFFER)
+        {
+            //Textures have no GPU address on a real device, but a unique one lets them be told apart in recorded commands.
+            const uint32_t mipLevels = (std::max)(resourceDesc.MipLevels, static_cast<UINT16>(1));
+            const uint32_t arraySize = resourceDesc.Dimension == D3D12_RESOURCE_DIMENSION_TEXTURE3D ? 1 : resourceDesc.DepthOrArraySize;
+
+            uint64_t textureSize = 0;
+            GetCopyableFootprints(resourceDesc, 0, mipLevels * arraySize, 0, nullptr, nullptr, nullptr, &textureSize);
+
+            resource.mVirtualAddress = AllocateAddressRange(textureSize);
+            return;
+        }
+
+        resource.mVirtualAddress = AllocateAddressRange(resourceDesc.Width);
+
+        if (heapType == D3D12_HEAP_TYPE_UPLOAD)
+        {
+            std::lock_guard<std::mutex> lockGuard(mAllocationMutex);
+            mHostMemory[resource.mVirtualAddress] = std::make_unique<uint8_t[]>(resourceDesc.Width);
+        }
+    }
+
+    uint8_t* NullDeviceBackend::MapResource(Resource& resource)
+    {
+        std::lock_guard<std::mutex> lockGuard(mAllocationMutex);
+
+        auto hostMemory = mHostMemory.find(resource.mVirtualAddress);
+        assert(hostMemory != mHostMemory.end());
+
+        return hostMemory->second.get();
+    }
+
+    void NullDeviceBackend::ReleaseResource(Resource& resource, bool isMapped)
+    {
+        if (resource.mVirtualAddress != 0)
+        {
+            std::lock_guard<std::mutex> lockGuard(mAllocationMutex);
+            mHostMemory.erase(resource.mVirtualAddress);
+        }
+
+        resource.mVirtualAddress = 0;
+    }
+
+    void NullDeviceBackend::GetCopyableFootprints(const D3D12_RESOURCE_DESC& resourceDesc, uint32_t firstSubresource, uint32_t numSubresources, uint64_t baseOffset,
+                                                  D3D12_PLACED_SUBRESOURCE_FOOTPRINT* layouts, uint32_t* numRows, uint64_t* rowSizesInBytes, uint64_t* totalBytes)
+    {
+        //Mirrors the layout rules of ID3D12Device::GetCopyableFootprints for the non-planar formats D3D12Lite loads.
+        const uint32_t mipLevels = (std::max)(resourceDesc.MipLevels, static_cast<UINT16>(1));
+        const bool is3DTexture = resourceDesc.Dimension == D3D12_RESOURCE_DIMENSION_TEXTURE3D;
+        uint64_t currentOffset = baseOffset;
+        uint64_t requiredSize = 0;
+
+        for (uint32_t subResourceIndex = firstSubresource; subResourceIndex < firstSubresource + numSubresources; subResourceIndex++)
+        {
+            const uint32_t mipIndex = subResourceIndex % mipLevels;
+            const uint64_t width = (std::max)(resourceDesc.Width >> mipIndex, static_cast<uint64_t>(1));
+            const uint32_t height = (std::max)(resourceDesc.Height >> mipIndex, 1u);
+            const uint32_t depth = is3DTexture ? (std::max)(static_cast<uint32_t>(resourceDesc.DepthOrArraySize) >> mipIndex, 1u) : 1;
+
+            size_t rowPitch = 0;
+            size_t slicePitch = 0;
+            DirectX::ComputePitch(resourceDesc.Format, width, height, rowPitch, slicePitch);
+
+            const uint32_t rowCount = static_cast<uint32_t>(DirectX::ComputeScanlines(resourceDesc.Format, height));
+            const uint64_t alignedRowPitch = AlignU64(rowPitch, D3D12_TEXTURE_DATA_PITCH_ALIGNMENT);
+
+            currentOffset = AlignU64(currentOffset, D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT);
+
+            const uint32_t layoutIndex = subResourceIndex - firstSubresource;
+
+            if (layouts)
+            {
+                layouts[layoutIndex].Offset = currentOffset;
+                layouts[layoutIndex].Footprint.Format = resourceDesc.Format;
+                layouts[layoutIndex].Footprint.Width = static_cast<UINT>(width);
+                layouts[layoutIndex].Footprint.Height = height;
+                layouts[layoutIndex].Footprint.Depth = depth;
+                layouts[layoutIndex].Footprint.RowPitch = static_cast<UINT>(alignedRowPitch);
+            }
+
+            if (numRows)
+            {
+                numRows[layoutIndex] = rowCount;
+            }
+
+            if (rowSizesInBytes)
+            {
+                rowSizesInBytes[layoutIndex] = rowPitch;
+            }
+
+            requiredSize = currentOffset - baseOffset + alignedRowPitch * (static_cast<uint64_t>(rowCount) * depth - 1) + rowPitch;
+            currentOffset += alignedRowPitch * rowCount * depth;
+        }
+
+        if (totalBytes)
+        {
+            *totalBytes = requiredSize;
+        }
+    }
+
+    namespace
+    {
+        constexpr uint32_t NULL_PIPELINE_LIBRARY_MAGIC = 0x424C504E; //"NPLB"
+    }
+
+    //The magic followed by every stored name, each with its terminator.
+    bool NullDeviceBackend::OpenPipelineLibrary(std::vector<uint8_t> libraryData)
+    {
+        std::lock_guard<std::mutex> lockGuard(mPipelineLibraryMutex);
+        mPipelineLibraryNames.clear();
+
+        uint32_t magic = 0;
+        if (libraryData.size() < sizeof(magic) || (libraryData.size() - sizeof(magic)) % sizeof(wchar_t) != 0)
+        {
+            return false;
+        }
+
+        memcpy(&magic, libraryData.data(), sizeof(magic));
+        if (magic != NULL_PIPELINE_LIBRARY_MAGIC)
+        {
+            return false;
+        }
+
+        std::wstring name;
+        for (size_t offset = sizeof(magic); offset < libraryData.size(); offset += sizeof(wchar_t))
+        {
+            wchar_t character = 0;
+            memcpy(&character, libraryData.data() + offset, sizeof(wchar_t));
+
+            if (character == 0)
+            {
+                mPipelineLibraryNames.insert(name);
+                name.clear();
+            }
+            else
+            {
+                name.push_back(character);
+            }
+        }
+
+        return true;
+    }
+
+    bool NullDeviceBackend::LoadGraphicsPipelineState(const wchar_t* name, const D3D12_GRAPHICS_PIPELINE_STATE_DESC& pipelineDesc, ID3D12PipelineState*& pipelineState)
+    {
+        std::lock_guard<std::mutex> lockGuard(mPipelineLibraryMutex);
+        pipelineState = nullptr;
+
+        return mPipelineLibraryNames.count(name) != 0;
+    }
+
+    bool NullDeviceBackend::LoadComputePipelineState(const wchar_t* name, const D3D12_COMPUTE_PIPELINE_STATE_DESC& pipelineDesc, ID3D12PipelineState*& pipelineState)
+    {
+        std::lock_guard<std::mutex> lockGuard(mPipelineLibraryMutex);
+        pipelineState = nullptr;
+
+        return mPipelineLibraryNames.count(name) != 0;
+    }
+
+    bool NullDeviceBackend::StorePipelineState(const wchar_t* name, ID3D12PipelineState* pipelineState)
+    {
+        std::lock_guard<std::mutex> lockGuard(mPipelineLibraryMutex);
+        mPipelineLibraryNames.insert(name);
+
+        return true;
+    }
+
+    bool NullDeviceBackend::SerializePipelineLibrary(std::vector<uint8_t>& libraryData)
+    {
+        std::lock_guard<std::mutex> lockGuard(mPipelineLibraryMutex);
+
+        libraryData.resize(sizeof(NULL_PIPELINE_LIBRARY_MAGIC));
+        memcpy(libraryData.data(), &NULL_PIPELINE_LIBRARY_MAGIC, sizeof(NULL_PIPELINE_LIBRARY_MAGIC));
+
+        for (const std::wstring& name : mPipelineLibraryNames)
+        {
+            const uint8_t* nameBytes = reinterpret_cast<const uint8_t*>(name.c_str());
+            libraryData.insert(libraryData.end(), nameBytes, nameBytes + (name.size() + 1) * sizeof(wchar_t));
+        }
+
+        return true;
+    }
+
+    void NullDeviceBackend::CreateSwapChain(HWND windowHandle, Uint2 screenSize, QueueBackend& presentQueue)
+    {
+        mSwapChainSize = screenSize;
+        mCurrentBackBufferIndex = 0;
+    }
+
+    void NullDeviceBackend::GetSwapChainBuffer(uint32_t bufferIndex, TextureResource& backBuffer)
+    {
+        backBuffer.mDesc.Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
+        backBuffer.mDesc.Width = mSwapChainSize.x;
+        backBuffer.mDesc.Height = mSwapChainSize.y;
+        backBuffer.mDesc.DepthOrArraySize = 1;
+        backBuffer.mDesc.MipLevels = 1;
+        backBuffer.mDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+        backBuffer.mDesc.SampleDesc.Count = 1;
+        backBuffer.mDesc.Flags = D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET;
+    }
+
+    void NullDeviceBackend::Present()
+    {
+        mCurrentBackBufferIndex = (mCurrentBackBufferIndex + 1) % NUM_BACK_BUFFERS;
+
+        std::lock_guard<std::mutex> lockGuard(mStatisticsMutex);
+        mStatistics.mNumPresents++;
+    }
+
+    uint64_t NullDeviceBackend::AllocateAddressRange(uint64_t size)
+    {
+        std::lock_guard<std::mutex> lockGuard(mAllocationMutex);
+
+        const uint64_t address = mNextFakeAddress;
+        mNextFakeAddress = AlignU64(mNextFakeAddress + (std::max)(size, static_cast<uint64_t>(1)), D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT);
+
+        return address;
+    }
+}
@@ -0,0 +1,233 @@
+#pragma once
+#include "D3D12LiteBackend.h"
+#include <chrono>
+#include <deque>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace D3D12Lite
+{
+    constexpr uint32_t NULL_BACKEND_DESCRIPTOR_SIZE = 32;
+
+    enum class RecordedCommandType : uint8_t
+    {
+        resourceBarrier = 0,
+        setDescriptorHeaps,
+        copyResource,
+        copyBufferRegion,
+        copyTextureRegion,
+        setViewports,
+        setScissorRects,
+        setStencilRef,
+        setBlendFactor,
+        setRenderTargets,
+        setPrimitiveTopology,
+        setIndexBuffer,
+        setPipelineState,
+        setGraphicsRootSignature,
+        setComputeRootSignature,
+        setGraphicsRootConstantBufferView,
+        setComputeRootConstantBufferView,
+        setGraphicsRootDescriptorTable,
+        setComputeRootDescriptorTable,
+        clearRenderTarget,
+        clearDepthStencil,
+        drawInstanced,
+        drawIndexedInstanced,
+        dispatch,
+        count
+    };
+
+    constexpr uint32_t NUM_RECORDED_COMMAND_TYPES = static_cast<uint32_t>(RecordedCommandType::count);
+
+    struct RecordedCommand
+    {
+        RecordedCommandType mType = RecordedCommandType::count;
+        std::array<uint64_t, 4> mArguments{};
+    };
+
+    using RecordedCommandCounts = std::array<uint64_t, NUM_RECORDED_COMMAND_TYPES>;
+
+    class CommandStream
+    {
+    public:
+        void Record(RecordedCommandType type, uint64_t argument0 = 0, uint64_t argument1 = 0, uint64_t argument2 = 0, uint64_t argument3 = 0);
+        void Clear();
+
+        const std::vector<RecordedCommand>& GetCommands() const { return mCommands; }
+        const RecordedCommandCounts& GetCommandCounts() const { return mCommandCounts; }
+        uint64_t GetCommandCount(RecordedCommandType type) const { return mCommandCounts[static_cast<uint32_t>(type)]; }
+
+    private:
+        std::vector<RecordedCommand> mCommands;
+        RecordedCommandCounts mCommandCounts{};
+    };
+
+    struct NullBackendStatistics
+    {
+        RecordedCommandCounts mSubmittedCommandCounts{};
+        uint64_t mNumSubmittedCommandLists = 0;
+        uint64_t mNumSubmissionBatches = 0;
+        uint64_t mNumPresents = 0;
+    };
+
+    class NullCommandRecorder final : public CommandRecorder
+    {
+    public:
+        const CommandStream& GetCommandStream() const { return mCommandStream; }
+
+        ID3D12GraphicsCommandList* GetNativeCommandList() override { return nullptr; }
+
+        void Reset(uint32_t frameIndex) override;
+        void Close() override;
+
+        void ResourceBarrier(uint32_t numBarriers, const D3D12_RESOURCE_BARRIER* barriers) override;
+        void SetDescriptorHeaps(uint32_t numDescriptorHeaps, ID3D12DescriptorHeap* const* descriptorHeaps) override;
+        void CopyResource(const Resource& destination, const Resource& source) override;
+        void CopyBufferRegion(const Resource& destination, uint64_t destOffset, const Resource& source, uint64_t sourceOffset, uint64_t numBytes) override;
+        void CopyTextureRegion(const D3D12_TEXTURE_COPY_LOCATION& destination, uint32_t destX, uint32_t destY, uint32_t destZ, const D3D12_TEXTURE_COPY_LOCATION& source, const D3D12_BOX* sourceBox) override;
+
+        void RSSetViewports(uint32_t numViewports, const D3D12_VIEWPORT* viewports) override;
+        void RSSetScissorRects(uint32_t numRects, const D3D12_RECT* rects) override;
+        void OMSetStencilRef(uint32_t stencilRef) override;
+        void OMSetBlendFactor(const float blendFactor[4]) override;
+        void OMSetRenderTargets(uint32_t numRenderTargets, const D3D12_CPU_DESCRIPTOR_HANDLE* renderTargets, const D3D12_CPU_DESCRIPTOR_HANDLE* depthStencil) override;
+        void IASetPrimitiveTopology(D3D12_PRIMITIVE_TOPOLOGY topology) override;
+        void IASetIndexBuffer(const D3D12_INDEX_BUFFER_VIEW* indexBufferView) override;
+
+        void SetPipelineState(ID3D12PipelineState* pipelineState) override;
+        void SetGraphicsRootSignature(ID3D12RootSignature* rootSignature) override;
+        void SetComputeRootSignature(ID3D12RootSignature* rootSignature) override;
+        void SetGraphicsRootConstantBufferView(uint32_t rootParameterIndex, D3D12_GPU_VIRTUAL_ADDRESS bufferLocation) override;
+        void SetComputeRootConstantBufferView(uint32_t rootParameterIndex, D3D12_GPU_VIRTUAL_ADDRESS bufferLocation) override;
+        void SetGraphicsRootDescriptorTable(uint32_t rootParameterIndex, D3D12_GPU_DESCRIPTOR_HANDLE baseDescriptor) override;
+        void SetComputeRootDescriptorTable(uint32_t rootParameterIndex, D3D12_GPU_DESCRIPTOR_HANDLE baseDescriptor) override;
+
+        void ClearRenderTargetView(D3D12_CPU_DESCRIPTOR_HANDLE renderTarget, const float color[4]) override;
+        void ClearDepthStencilView(D3D12_CPU_DESCRIPTOR_HANDLE depthStencil, D3D12_CLEAR_FLAGS clearFlags, float depth, uint8_t stencil) override;
+        void DrawInstanced(uint32_t vertexCountPerInstance, uint32_t instanceCount, uint32_t startVertexLocation, uint32_t startInstanceLocation) override;
+        void DrawIndexedInstanced(uint32_t indexCountPerInstance, uint32_t instanceCount, uint32_t startIndexLocation, int32_t baseVertexLocation, uint32_t startInstanceLocation) override;
+        void Dispatch(uint32_t groupCountX, uint32_t groupCountY, uint32_t groupCountZ) override;
+
+    private:
+        CommandStream mCommandStream;
+        bool mIsClosed = false;
+    };
+
+    //Fences complete a fixed latency after they were signaled, and never before the fences they were told to wait on,
+    //which is enough to exercise the frame-in-flight throttling in Device::BeginFrame.
+    class NullQueueBackend final : public QueueBackend
+    {
+    public:
+        using Clock = std::chrono::steady_clock;
+
+        NullQueueBackend(class NullDeviceBackend& device, std::chrono::microseconds fenceLatency);
+
+        ID3D12CommandQueue* GetNativeQueue() override { return nullptr; }
+        ID3D12Fence* GetNativeFence() override { return nullptr; }
+
+        void ExecuteCommandLists(uint32_t numCommandRecorders, CommandRecorder* const* commandRecorders) override;
+        void Signal(uint64_t fenceValue) override;
+        void InsertWait(QueueBackend& sourceQueue, uint64_t fenceValue) override;
+        uint64_t GetCompletedValue() override;
+        void WaitForFenceCPUBlocking(uint64_t fenceValue) override;
+
+        Clock::time_point GetCompletionTime(uint64_t fenceValue);
+
+    private:
+        void RetireCompletedSignals(Clock::time_point currentTime);
+
+        struct PendingSignal
+        {
+            uint64_t mFenceValue = 0;
+            Clock::time_point mCompletionTime;
+        };
+
+        class NullDeviceBackend& mDevice;
+        std::chrono::microseconds mFenceLatency{ 0 };
+        std::deque<PendingSignal> mPendingSignals;
+        Clock::time_point mEarliestNextCompletion;
+        uint64_t mCompletedValue = 0;
+        std::mutex mSignalMutex;
+    };
+
+    class NullDeviceBackend final : public DeviceBackend
+    {
+    public:
+        NullDeviceBackend(const NullDeviceDesc& desc);
+
+        const NullBackendStatistics& GetStatistics() const { return mStatistics; }
+        void ResetStatistics();
+        void AddSubmittedCommands(const CommandStream& commandStream);
+        void AddSubmissionBatch();
+
+        DeviceBackendType GetType() const override { return DeviceBackendType::null; }
+        ID3D12Device5* GetNativeDevice() override { return nullptr; }
+        D3D12MA::Allocator* GetAllocator() override { return nullptr; }
+
+        std::unique_ptr<ShaderCompiler> CreateShaderCompiler() override;
+
+        std::unique_ptr<QueueBackend> CreateQueue(D3D12_COMMAND_LIST_TYPE commandType) override;
+        std::unique_ptr<CommandRecorder> CreateCommandRecorder(D3D12_COMMAND_LIST_TYPE commandType) override;
+
+        ID3D12DescriptorHeap* CreateDescriptorHeap(const D3D12_DESCRIPTOR_HEAP_DESC& heapDesc, Descriptor& heapStart, uint32_t& descriptorSize) override;
+        void CopyDescriptorsSimple(uint32_t numDescriptors, D3D12_CPU_DESCRIPTOR_HANDLE destDescriptorRangeStart, D3D12_CPU_DESCRIPTOR_HANDLE srcDescriptorRangeStart, D3D12_DESCRIPTOR_HEAP_TYPE descriptorType) override {}
+        void CopyDescriptors(uint32_t numDestDescriptorRanges, const D3D12_CPU_DESCRIPTOR_HANDLE* destDescriptorRangeStarts, const uint32_t* destDescriptorRangeSizes,
+                             uint32_t numSrcDescriptorRanges, const D3D12_CPU_DESCRIPTOR_HANDLE* srcDescriptorRangeStarts, const uint32_t* srcDescriptorRangeSizes, D3D12_DESCRIPTOR_HEAP_TYPE descriptorType) override {}
+
+        void CreateResource(D3D12_HEAP_TYPE heapType, D3D12MA::Pool* pool, const D3D12_RESOURCE_DESC& resourceDesc, D3D12_RESOURCE_STATES initialState, const D3D12_CLEAR_VALUE* clearValue, Resource& resource) override;
+        uint8_t* MapResource(Resource& resource) override;
+        void ReleaseResource(Resource& resource, bool isMapped) override;
+        void UpdateResourceOwner(Resource& resource) override {}
+
+        D3D12MA::Pool* CreateLinearBufferPool(D3D12_HEAP_TYPE heapType, uint64_t size) override { return nullptr; }
+        void ReleasePool(D3D12MA::Pool* pool) override {}
+
+        bool BeginDefragmentation(uint64_t maxBytesPerPass, uint32_t maxResourcesPerPass) override { return false; }
+        bool BeginDefragmentationPass(std::vector<Resource*>& movedResources) override { return false; }
+        void CreateDefragmentationDestination(uint32_t moveIndex, const D3D12_RESOURCE_DESC& resourceDesc, D3D12_RESOURCE_STATES initialState, const D3D12_CLEAR_VALUE* clearValue, Resource& resource) override {}
+        bool EndDefragmentationPass(DefragmentationStatistics& statistics) override { return false; }
+        void EndDefragmentation(DefragmentationStatistics& statistics) override {}
+
+        void CreateConstantBufferView(const D3D12_CONSTANT_BUFFER_VIEW_DESC& viewDesc, D3D12_CPU_DESCRIPTOR_HANDLE destDescriptor) override {}
+        void CreateShaderResourceView(const Resource& resource, const D3D12_SHADER_RESOURCE_VIEW_DESC* viewDesc, D3D12_CPU_DESCRIPTOR_HANDLE destDescriptor) override {}
+        void CreateUnorderedAccessView(const Resource& resource, const D3D12_UNORDERED_ACCESS_VIEW_DESC* viewDesc, D3D12_CPU_DESCRIPTOR_HANDLE destDescriptor) override {}
+        void CreateRenderTargetView(const Resource& resource, const D3D12_RENDER_TARGET_VIEW_DESC* viewDesc, D3D12_CPU_DESCRIPTOR_HANDLE destDescriptor) override {}
+        void CreateDepthStencilView(const Resource& resource, const D3D12_DEPTH_STENCIL_VIEW_DESC* viewDesc, D3D12_CPU_DESCRIPTOR_HANDLE destDescriptor) override {}
+        void CreateSampler(const D3D12_SAMPLER_DESC& samplerDesc, D3D12_CPU_DESCRIPTOR_HANDLE destDescriptor) override {}
+
+        void GetCopyableFootprints(const D3D12_RESOURCE_DESC& resourceDesc, uint32_t firstSubresource, uint32_t numSubresources, uint64_t baseOffset,
+                                   D3D12_PLACED_SUBRESOURCE_FOOTPRINT* layouts, uint32_t* numRows, uint64_t* rowSizesInBytes, uint64_t* totalBytes) override;
+
+        ID3D12RootSignature* CreateRootSignature(const D3D12_VERSIONED_ROOT_SIGNATURE_DESC& rootSignatureDesc) override { return nullptr; }
+        ID3D12PipelineState* CreateGraphicsPipelineState(const D3D12_GRAPHICS_PIPELINE_STATE_DESC& pipelineDesc) override { return nullptr; }
+        ID3D12PipelineState* CreateComputePipelineState(const D3D12_COMPUTE_PIPELINE_STATE_DESC& pipelineDesc) override { return nullptr; }
+
+        //Only remembers which names were stored, so the pipeline cache can be run through a save and load without a GPU.
+        bool OpenPipelineLibrary(std::vector<uint8_t> libraryData) override;
+        bool LoadGraphicsPipelineState(const wchar_t* name, const D3D12_GRAPHICS_PIPELINE_STATE_DESC& pipelineDesc, ID3D12PipelineState*& pipelineState) override;
+        bool LoadComputePipelineState(const wchar_t* name, const D3D12_COMPUTE_PIPELINE_STATE_DESC& pipelineDesc, ID3D12PipelineState*& pipelineState) override;
+        bool StorePipelineState(const wchar_t* name, ID3D12PipelineState* pipelineState) override;
+        bool SerializePipelineLibrary(std::vector<uint8_t>& libraryData) override;
+
+        void CreateSwapChain(HWND windowHandle, Uint2 screenSize, QueueBackend& presentQueue) override;
+        void GetSwapChainBuffer(uint32_t bufferIndex, TextureResource& backBuffer) override;
+        uint32_t GetCurrentBackBufferIndex() override { return mCurrentBackBufferIndex; }
+        void Present() override;
+        void DestroySwapChain() override {}
+
+    private:
+        uint64_t AllocateAddressRange(uint64_t size);
+
+        NullDeviceDesc mDesc;
+        Uint2 mSwapChainSize{ 0, 0 };
+        uint32_t mCurrentBackBufferIndex = 0;
+        uint64_t mNextFakeAddress = 0x10000;
+        std::unordered_map<D3D12_GPU_VIRTUAL_ADDRESS, std::unique_ptr<uint8_t[]>> mHostMemory;
+        std::unordered_set<std::wstring> mPipelineLibraryNames;
+        std::mutex mPipelineLibraryMutex;
+        NullBackendStatistics mStatistics;
+        std::mutex mAllocationMutex;
+        std::mutex mStatisticsMutex;
+    };
+}
@@ -0,0 +1,449 @@
+#include "D3D12LitePipelineCache.h"
+#include "D3D12LiteBackend.h"
+#include <fstream>
+#include <chrono>
+#include <cwchar>
+
+namespace D3D12Lite
+{
+    namespace
+    {
+        enum class PipelineKeyType : uint32_t
+        {
+            rootSignature = 0,
+            graphicsPipeline,
+            computePipeline
+        };
+
+        class PipelineKeyWriter
+        {
+        public:
+            PipelineKeyWriter(PipelineKeyType keyType)
+            {
+                Add(PIPELINE_CACHE_VERSION);
+                Add(static_cast<uint32_t>(keyType));
+            }
+
+            void Add(uint32_t value) { mKey.mWords.push_back(value); }
+            void AddBool(BOOL value) { Add(value ? 1 : 0); }
+
+            void AddFloat(float value)
+            {
+                uint32_t bits = 0;
+                memcpy(&bits, &value, sizeof(bits));
+                Add(bits);
+            }
+
+            void AddByteCode(const D3D12_SHADER_BYTECODE& byteCode)
+            {
+                Hasher hasher;
+                hasher.Add(byteCode.pShaderBytecode, byteCode.BytecodeLength);
+                uint64_t hash = byteCode.BytecodeLength ? hasher.GetHash() : 0;
+
+                Add(static_cast<uint32_t>(byteCode.BytecodeLength));
+                Add(static_cast<uint32_t>(hash));
+                Add(static_cast<uint32_t>(hash >> 32));
+            }
+
+            void AddKey(const PipelineCacheKey& key)
+            {
+                Add(static_cast<uint32_t>(key.mWords.size()));
+                mKey.mWords.insert(mKey.mWords.end(), key.mWords.begin(), key.mWords.end());
+            }
+
+            PipelineCacheKey Finish()
+            {
+                Hasher hasher;
+                hasher.Add(mKey.mWords.data(), mKey.mWords.size() * sizeof(uint32_t));
+                mKey.mHash = hasher.GetHash();
+
+                return std::move(mKey);
+            }
+
+        private:
+            PipelineCacheKey mKey;
+        };
+
+        void AddStencilOp(PipelineKeyWriter& writer, const D3D12_DEPTH_STENCILOP_DESC& stencilOp)
+        {
+            writer.Add(stencilOp.StencilFailOp);
+            writer.Add(stencilOp.StencilDepthFailOp);
+            writer.Add(stencilOp.StencilPassOp);
+            writer.Add(stencilOp.StencilFunc);
+        }
+
+        std::wstring GetLibraryName(const PipelineCacheKey& key)
+        {
+            wchar_t name[17];
+            swprintf(name, 17, L"%016llx", static_cast<unsigned long long>(key.mHash));
+
+            return name;
+        }
+
+        double GetMillisecondsSince(std::chrono::steady_clock::time_point startTime)
+        {
+            return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+        }
+
+        template<typename T>
+        void AddReference(T* object)
+        {
+            if (object)
+            {
+                object->AddRef();
+            }
+        }
+    }
+
+    PipelineCacheKey GetRootSignatureKey(const PipelineResourceLayout& layout)
+    {
+        PipelineKeyWriter writer(PipelineKeyType::rootSignature);
+
+        for (uint32_t spaceId = 0; spaceId < NUM_RESOURCE_SPACES; spaceId++)
+        {
+            const PipelineResourceSpace* space = layout.mSpaces[spaceId];
+            if (!space || (!space->HasCBV() && space->GetUAVs().empty() && space->GetSRVs().empty()))
+            {
+                continue;
+            }
+
+            //Table offsets follow the order bindings were added in, so that order is part of the key.
+            writer.Add(spaceId);
+            writer.AddBool(space->HasCBV());
+            writer.Add(static_cast<uint32_t>(space->GetUAVs().size()));
+
+            for (const PipelineResourceBinding& uav : space->GetUAVs())
+            {
+                writer.Add(uav.mBindingIndex);
+            }
+
+            writer.Add(static_cast<uint32_t>(space->GetSRVs().size()));
+
+            for (const PipelineResourceBinding& srv : space->GetSRVs())
+            {
+                writer.Add(srv.mBindingIndex);
+            }
+        }
+
+        return writer.Finish();
+    }
+
+    PipelineCacheKey GetGraphicsPipelineKey(const D3D12_GRAPHICS_PIPELINE_STATE_DESC& pipelineDesc, const PipelineCacheKey& rootSignatureKey)
+    {
+        PipelineKeyWriter writer(PipelineKeyType::graphicsPipeline);
+        writer.AddKey(rootSignatureKey);
+
+        writer.AddByteCode(pipelineDesc.VS);
+        writer.AddByteCode(pipelineDesc.PS);
+        writer.AddByteCode(pipelineDesc.DS);
+        writer.AddByteCode(pipelineDesc.HS);
+        writer.AddByteCode(pipelineDesc.GS);
+
+        const uint32_t numRenderTargets = (std::min)(pipelineDesc.NumRenderTargets, static_cast<UINT>(D3D12_SIMULTANEOUS_RENDER_TARGET_COUNT));
+        writer.Add(numRenderTargets);
+
+        for (uint32_t rtvIndex = 0; rtvIndex < numRenderTargets; rtvIndex++)
+        {
+            writer.Add(pipelineDesc.RTVFormats[rtvIndex]);
+        }
+
+        //The depth format has to match whatever depth target is bound even with depth and stencil disabled.
+        writer.Add(pipelineDesc.DSVFormat);
+
+        const D3D12_BLEND_DESC& blendDesc = pipelineDesc.BlendState;
+        writer.AddBool(blendDesc.AlphaToCoverageEnable);
+        writer.AddBool(blendDesc.IndependentBlendEnable);
+
+        //Without independent blending every target uses the first blend desc.
+        const uint32_t numBlendDescs = blendDesc.IndependentBlendEnable ? numRenderTargets : (std::min)(numRenderTargets, 1u);
+        for (uint32_t rtvIndex = 0; rtvIndex < numBlendDescs; rtvIndex++)
+        {
+            const D3D12_RENDER_TARGET_BLEND_DESC& renderTargetBlend = blendDesc.RenderTarget[rtvIndex];
+            writer.AddBool(renderTargetBlend.BlendEnable);
+            writer.AddBool(renderTargetBlend.LogicOpEnable);
+            writer.Add(renderTargetBlend.RenderTargetWriteMask);
+
+            if (renderTargetBlend.BlendEnable)
+            {
+                writer.Add(renderTargetBlend.SrcBlend);
+                writer.Add(renderTargetBlend.DestBlend);
+                writer.Add(renderTargetBlend.BlendOp);
+                writer.Add(renderTargetBlend.SrcBlendAlpha);
+                writer.Add(renderTargetBlend.DestBlendAlpha);
+                writer.Add(renderTargetBlend.BlendOpAlpha);
+            }
+
+            if (renderTargetBlend.LogicOpEnable)
+            {
+                writer.Add(renderTargetBlend.LogicOp);
+            }
+        }
+
+        writer.Add(pipelineDesc.SampleMask);
+
+        const D3D12_RASTERIZER_DESC& rasterDesc = pipelineDesc.RasterizerState;
+        writer.Add(rasterDesc.FillMode);
+        writer.Add(rasterDesc.CullMode);
+        writer.AddBool(rasterDesc.FrontCounterClockwise);
+        writer.Add(static_cast<uint32_t>(rasterDesc.DepthBias));
+        writer.AddFloat(rasterDesc.DepthBiasClamp);
+        writer.AddFloat(rasterDesc.SlopeScaledDepthBias);
+        writer.AddBool(rasterDesc.DepthClipEnable);
+        writer.AddBool(rasterDesc.MultisampleEnable);
+        writer.AddBool(rasterDesc.AntialiasedLineEnable);
+        writer.Add(rasterDesc.ForcedSampleCount);
+        writer.Add(rasterDesc.ConservativeRaster);
+
+        const D3D12_DEPTH_STENCIL_DESC& depthStencilDesc = pipelineDesc.DepthStencilState;
+        writer.AddBool(depthStencilDesc.DepthEnable);
+
+        if (depthStencilDesc.DepthEnable)
+        {
+            writer.Add(depthStencilDesc.DepthWriteMask);
+            writer.Add(depthStencilDesc.DepthFunc);
+        }
+
+        writer.AddBool(depthStencilDesc.StencilEnable);
+
+        if (depthStencilDesc.StencilEnable)
+        {
+            writer.Add(depthStencilDesc.StencilReadMask);
+            writer.Add(depthStencilDesc.StencilWriteMask);
+            AddStencilOp(writer, depthStencilDesc.FrontFace);
+            AddStencilOp(writer, depthStencilDesc.BackFace);
+        }
+
+        writer.Add(pipelineDesc.InputLayout.NumElements);
+
+        for (uint32_t elementIndex = 0; elementIndex < pipelineDesc.InputLayout.NumElements; elementIndex++)
+        {
+            const D3D12_INPUT_ELEMENT_DESC& element = pipelineDesc.InputLayout.pInputElementDescs[elementIndex];
+
+            Hasher semanticHasher;
+            semanticHasher.Add(std::string(element.SemanticName));
+
+            writer.Add(static_cast<uint32_t>(semanticHasher.GetHash()));
+            writer.Add(element.SemanticIndex);
+            writer.Add(element.Format);
+            writer.Add(element.InputSlot);
+            writer.Add(element.AlignedByteOffset);
+            writer.Add(element.InputSlotClass);
+            writer.Add(element.InstanceDataStepRate);
+        }
+
+        writer.Add(pipelineDesc.IBStripCutValue);
+        writer.Add(pipelineDesc.PrimitiveTopologyType);
+        writer.Add(pipelineDesc.SampleDesc.Count);
+        writer.Add(pipelineDesc.SampleDesc.Quality);
+        writer.Add(pipelineDesc.NodeMask);
+        writer.Add(pipelineDesc.Flags);
+
+        return writer.Finish();
+    }
+
+    PipelineCacheKey GetComputePipelineKey(const D3D12_COMPUTE_PIPELINE_STATE_DESC& pipelineDesc, const PipelineCacheKey& rootSignatureKey)
+    {
+        PipelineKeyWriter writer(PipelineKeyType::computePipeline);
+        writer.AddKey(rootSignatureKey);
+        writer.AddByteCode(pipelineDesc.CS);
+        writer.Add(pipelineDesc.NodeMask);
+        writer.Add(pipelineDesc.Flags);
+
+        return writer.Finish();
+    }
+
+    PipelineCache::PipelineCache(DeviceBackend& backend, const std::wstring& libraryPath)
+        : mBackend(backend)
+        , mLibraryPath(libraryPath)
+    {
+        std::vector<uint8_t> libraryData;
+
+        if (!mLibraryPath.empty())
+        {
+            std::ifstream file(std::filesystem::path(mLibraryPath), std::ios::binary | std::ios::ate);
+            if (file)
+            {
+                libraryData.resize(static_cast<size_t>(file.tellg()));
+                file.seekg(0, std::ios::beg);
+                file.read(reinterpret_cast<char*>(libraryData.data()), libraryData.size());
+
+                if (!file)
+                {
+                    libraryData.clear();
+                }
+            }
+        }
+
+        mBackend.OpenPipelineLibrary(std::move(libraryData));
+    }
+
+    PipelineCache::~PipelineCache()
+    {
+        for (auto& rootSignature : mRootSignatures)
+        {
+            SafeRelease(rootSignature.second.mRootSignature);
+        }
+
+        for (auto& pipeline : mPipelines)
+        {
+            SafeRelease(pipeline.second);
+        }
+    }
+
+    bool PipelineCache::FindRootSignature(const PipelineCacheKey& key, ID3D12RootSignature*& rootSignature, PipelineResourceMapping& resourceMapping)
+    {
+        std::lock_guard<std::mutex> lockGuard(mCacheMutex);
+
+        auto cachedRootSignature = mRootSignatures.find(key);
+        if (cachedRootSignature == mRootSignatures.end())
+        {
+            mStatistics.mNumRootSignatureMisses++;
+            return false;
+        }
+
+        mStatistics.mNumRootSignatureHits++;
+
+        rootSignature = cachedRootSignature->second.mRootSignature;
+        resourceMapping = cachedRootSignature->second.mResourceMapping;
+        AddReference(rootSignature);
+
+        return true;
+    }
+
+    ID3D12RootSignature* PipelineCache::AddRootSignature(const PipelineCacheKey& key, ID3D12RootSignature* rootSignature, PipelineResourceMapping& resourceMapping)
+    {
+        std::lock_guard<std::mutex> lockGuard(mCacheMutex);
+
+        resourceMapping.mRootSignatureId = mNextRootSignatureId;
+
+        auto insertion = mRootSignatures.insert(std::make_pair(key, CachedRootSignature{ rootSignature, resourceMapping }));
+        if (insertion.second)
+        {
+            mNextRootSignatureId++;
+        }
+        else
+        {
+            SafeRelease(rootSignature);
+            resourceMapping = insertion.first->second.mResourceMapping;
+        }
+
+        ID3D12RootSignature* cachedRootSignature = insertion.first->second.mRootSignature;
+        AddReference(cachedRootSignature);
+
+        return cachedRootSignature;
+    }
+
+    template<typename LoadFunction, typename CreateFunction>
+    ID3D12PipelineState* PipelineCache::GetPipeline(const PipelineCacheKey& key, LoadFunction&& load, CreateFunction&& create)
+    {
+        {
+            std::lock_guard<std::mutex> lockGuard(mCacheMutex);
+
+            auto cachedPipeline = mPipelines.find(key);
+            if (cachedPipeline != mPipelines.end())
+            {
+                mStatistics.mNumPipelineHits++;
+                AddReference(cachedPipeline->second);
+
+                return cachedPipeline->second;
+            }
+        }
+
+        //Loading and creating happen outside the lock, so pipelines created on different threads still compile in parallel.
+        const std::wstring libraryName = GetLibraryName(key);
+        auto startTime = std::chrono::steady_clock::now();
+
+        ID3D12PipelineState* pipeline = nullptr;
+        const bool wasLoaded = load(libraryName.c_str(), pipeline);
+        bool wasStored = false;
+
+        if (!wasLoaded)
+        {
+            pipeline = create();
+            wasStored = mBackend.StorePipelineState(libraryName.c_str(), pipeline);
+        }
+
+        const double createMilliseconds = GetMillisecondsSince(startTime);
+
+        std::lock_guard<std::mutex> lockGuard(mCacheMutex);
+
+        mStatistics.mNumLibraryHits += wasLoaded ? 1 : 0;
+        mStatistics.mNumLibraryMisses += wasLoaded ? 0 : 1;
+        mStatistics.mCreateMilliseconds += createMilliseconds;
+        mIsLibraryDirty |= wasStored;
+
+        auto insertion = mPipelines.insert(std::make_pair(key, pipeline));
+        if (!insertion.second)
+        {
+            SafeRelease(pipeline);
+        }
+
+        ID3D12PipelineState* cachedPipeline = insertion.first->second;
+        AddReference(cachedPipeline);
+
+        return cachedPipeline;
+    }
+
+    ID3D12PipelineState* PipelineCache::GetGraphicsPipeline(const D3D12_GRAPHICS_PIPELINE_STATE_DESC& pipelineDesc, const PipelineCacheKey& key)
+    {
+        return GetPipeline(key,
+            [&](const wchar_t* name, ID3D12PipelineState*& pipeline) { return mBackend.LoadGraphicsPipelineState(name, pipelineDesc, pipeline); },
+            [&]() { return mBackend.CreateGraphicsPipelineState(pipelineDesc); });
+    }
+
+    ID3D12PipelineState* PipelineCache::GetComputePipeline(const D3D12_COMPUTE_PIPELINE_STATE_DESC& pipelineDesc, const PipelineCacheKey& key)
+    {
+        return GetPipeline(key,
+            [&](const wchar_t* name, ID3D12PipelineState*& pipeline) { return mBackend.LoadComputePipelineState(name, pipelineDesc, pipeline); },
+            [&]() { return mBackend.CreateComputePipelineState(pipelineDesc); });
+    }
+
+    bool PipelineCache::SaveLibrary()
+    {
+        std::lock_guard<std::mutex> lockGuard(mCacheMutex);
+
+        if (!mIsLibraryDirty || mLibraryPath.empty())
+        {
+            return true;
+        }
+
+        std::vector<uint8_t> libraryData;
+        if (!mBackend.SerializePipelineLibrary(libraryData))
+        {
+            return false;
+        }
+
+        //Written next to the library first, so a crash halfway never leaves a truncated library behind.
+        std::filesystem::path libraryPath(mLibraryPath);
+        std::filesystem::path temporaryPath = libraryPath;
+        temporaryPath += ".tmp";
+
+        {
+            std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+            file.write(reinterpret_cast<const char*>(libraryData.data()), static_cast<std::streamsize>(libraryData.size()));
+
+            if (!file)
+            {
+                return false;
+            }
+        }
+
+        std::error_code errorCode;
+        std::filesystem::rename(temporaryPath, libraryPath, errorCode);
+        if (errorCode)
+        {
+            std::filesystem::remove(temporaryPath, errorCode);
+            return false;
+        }
+
+        mIsLibraryDirty = false;
+
+        return true;
+    }
+
+    PipelineCacheStatistics PipelineCache::GetStatistics() const
+    {
+        std::lock_guard<std::mutex> lockGuard(mCacheMutex);
+        return mStatistics;
+    }
+}
@@ -0,0 +1,74 @@
+#pragma once
+#include "D3D12Lite.h"
+#include <unordered_map>
+
+namespace D3D12Lite
+{
+    //Part of every key, bump it when the root signatures CreateRootSignature builds change shape.
+    constexpr uint32_t PIPELINE_CACHE_VERSION = 1;
+
+    //Canonical form of whatever decides what a root signature or pipeline ends up as. Fields the API ignores in a given
+    //desc, e.g. stencil ops with stencil disabled or render target formats past the ones in use, are left out, so descs
+    //that only differ in those share an entry. Lookups compare the words in full, the hash only picks the bucket.
+    struct PipelineCacheKey
+    {
+        std::vector<uint32_t> mWords;
+        uint64_t mHash = 0;
+
+        bool operator==(const PipelineCacheKey& other) const { return mHash == other.mHash && mWords == other.mWords; }
+    };
+
+    struct PipelineCacheKeyHash
+    {
+        size_t operator()(const PipelineCacheKey& key) const { return static_cast<size_t>(key.mHash); }
+    };
+
+    //Spaces without a CBV, SRV or UAV add nothing to a root signature, so they count the same as a missing space.
+    PipelineCacheKey GetRootSignatureKey(const PipelineResourceLayout& layout);
+    //Shader bytecode goes in as its size and a hash of its contents, the root signature as its key.
+    PipelineCacheKey GetGraphicsPipelineKey(const D3D12_GRAPHICS_PIPELINE_STATE_DESC& pipelineDesc, const PipelineCacheKey& rootSignatureKey);
+    PipelineCacheKey GetComputePipelineKey(const D3D12_COMPUTE_PIPELINE_STATE_DESC& pipelineDesc, const PipelineCacheKey& rootSignatureKey);
+
+    //Root signatures and pipelines by key, plus the backend's pipeline library, which is loaded from and written back to
+    //libraryPath so a second run skips the driver compile of every pipeline it already saw. Everything handed out carries
+    //a reference of its own, released like one fresh from the backend, while the cache keeps its reference until it is
+    //destroyed.
+    class PipelineCache
+    {
+    public:
+        //An empty libraryPath keeps the pipeline library in memory only.
+        PipelineCache(DeviceBackend& backend, const std::wstring& libraryPath);
+        ~PipelineCache();
+
+        bool FindRootSignature(const PipelineCacheKey& key, ID3D12RootSignature*& rootSignature, PipelineResourceMapping& resourceMapping);
+        //Fills in the mapping's root signature id. When another thread added the same key first, the given root signature
+        //is released and that one returned instead, along with its mapping.
+        ID3D12RootSignature* AddRootSignature(const PipelineCacheKey& key, ID3D12RootSignature* rootSignature, PipelineResourceMapping& resourceMapping);
+
+        ID3D12PipelineState* GetGraphicsPipeline(const D3D12_GRAPHICS_PIPELINE_STATE_DESC& pipelineDesc, const PipelineCacheKey& key);
+        ID3D12PipelineState* GetComputePipeline(const D3D12_COMPUTE_PIPELINE_STATE_DESC& pipelineDesc, const PipelineCacheKey& key);
+
+        //Writes the library if pipelines were stored in it since it was loaded.
+        bool SaveLibrary();
+        PipelineCacheStatistics GetStatistics() const;
+
+    private:
+        struct CachedRootSignature
+        {
+            ID3D12RootSignature* mRootSignature = nullptr;
+            PipelineResourceMapping mResourceMapping;
+        };
+
+        template<typename LoadFunction, typename CreateFunction>
+        ID3D12PipelineState* GetPipeline(const PipelineCacheKey& key, LoadFunction&& load, CreateFunction&& create);
+
+        DeviceBackend& mBackend;
+        std::wstring mLibraryPath;
+        bool mIsLibraryDirty = false;
+        uint32_t mNextRootSignatureId = 1;
+        std::unordered_map<PipelineCacheKey, CachedRootSignature, PipelineCacheKeyHash> mRootSignatures;
+        std::unordered_map<PipelineCacheKey, ID3D12PipelineState*, PipelineCacheKeyHash> mPipelines;
+        PipelineCacheStatistics mStatistics;
+        mutable std::mutex mCacheMutex;
+    };
+}
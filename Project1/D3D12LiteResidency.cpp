@@ -0,0 +1,165 @@
+#include "D3D12LiteResidency.h"
+#include "D3D12LiteBackend.h"
+#include "DXTex/DirectXTex.h"
+#include <algorithm>
+
+namespace D3D12Lite
+{
+    TextureResidencyManager::TextureResidencyManager(Device& device, uint64_t budgetBytes)
+        : mDevice(device)
+        , mBudgetBytes(budgetBytes)
+    {
+    }
+
+    TextureResidencyManager::~TextureResidencyManager()
+    {
+        for (auto& streamedTexture : mStreamedTextures)
+        {
+            if (streamedTexture.second->mPendingStorage)
+            {
+                mDevice.DestroyTexture(std::move(streamedTexture.second->mPendingStorage));
+            }
+        }
+
+        for (auto& orphanedStorage : mOrphanedStorage)
+        {
+            mDevice.DestroyTexture(std::move(orphanedStorage));
+        }
+    }
+
+    std::unique_ptr<TextureResource> TextureResidencyManager::CreateStreamedTexture(const std::string& texturePath)
+    {
+        auto streamedTexture = std::make_unique<StreamedTexture>();
+        streamedTexture->mFileData = LoadTextureFileData(texturePath);
+
+        const D3D12_RESOURCE_DESC& fileDesc = streamedTexture->mFileData.mResourceDesc;
+        const bool is3DTexture = fileDesc.Dimension == D3D12_RESOURCE_DIMENSION_TEXTURE3D;
+        const uint32_t arraySize = is3DTexture ? 1 : fileDesc.DepthOrArraySize;
+
+        std::vector<uint64_t> mipSizes(fileDesc.MipLevels, 0);
+
+        for (uint32_t arrayIndex = 0; arrayIndex < arraySize; arrayIndex++)
+        {
+            for (uint32_t mipIndex = 0; mipIndex < fileDesc.MipLevels; mipIndex++)
+            {
+                D3D12_PLACED_SUBRESOURCE_FOOTPRINT layout{};
+                uint32_t numRows = 0;
+
+                mDevice.GetBackend().GetCopyableFootprints(fileDesc, mipIndex + arrayIndex * fileDesc.MipLevels, 1, 0, &layout, &numRows, nullptr, nullptr);
+                mipSizes[mipIndex] += static_cast<uint64_t>(layout.Footprint.RowPitch) * numRows * layout.Footprint.Depth;
+            }
+        }
+
+        auto getMipDimension = [](uint64_t dimension, uint32_t mipIndex) { return (std::max)(dimension >> mipIndex, static_cast<uint64_t>(1)); };
+
+        uint32_t tailMip = 0;
+        while (tailMip + 1 < fileDesc.MipLevels && (getMipDimension(fileDesc.Width, tailMip) > TEXTURE_STREAMING_TAIL_SIZE || getMipDimension(fileDesc.Height, tailMip) > TEXTURE_STREAMING_TAIL_SIZE))
+        {
+            tailMip++;
+        }
+
+        //The top mip of a block compressed texture has to be a whole number of blocks.
+        while (tailMip > 0 && DirectX::IsCompressed(fileDesc.Format) && (getMipDimension(fileDesc.Width, tailMip) % 4 != 0 || getMipDimension(fileDesc.Height, tailMip) % 4 != 0))
+        {
+            tailMip--;
+        }
+
+        auto texture = mDevice.CreateTextureFromFileData(streamedTexture->mFileData, tailMip, UploadPriority::high);
+        streamedTexture->mTexture = texture.get();
+
+        std::lock_guard<std::mutex> lockGuard(mRequestMutex);
+
+        streamedTexture->mTextureId = mPolicy.AddTexture(mipSizes, tailMip);
+
+        if (streamedTexture->mTextureId >= mTexturesById.size())
+        {
+            mTexturesById.resize(streamedTexture->mTextureId + 1, nullptr);
+        }
+
+        mTexturesById[streamedTexture->mTextureId] = streamedTexture.get();
+        mStreamedTextures[texture.get()] = std::move(streamedTexture);
+
+        return texture;
+    }
+
+    void TextureResidencyManager::DestroyStreamedTexture(std::unique_ptr<TextureResource> texture)
+    {
+        std::lock_guard<std::mutex> lockGuard(mRequestMutex);
+
+        auto streamedTextureIterator = mStreamedTextures.find(texture.get());
+        assert(streamedTextureIterator != mStreamedTextures.end());
+
+        StreamedTexture& streamedTexture = *streamedTextureIterator->second;
+
+        //Storage with an upload still queued is referenced by the upload, it's only destroyed once that finished.
+        if (streamedTexture.mPendingStorage)
+        {
+            mOrphanedStorage.push_back(std::move(streamedTexture.mPendingStorage));
+        }
+
+        mPolicy.RemoveTexture(streamedTexture.mTextureId);
+        mTexturesById[streamedTexture.mTextureId] = nullptr;
+        mStreamedTextures.erase(streamedTextureIterator);
+
+        if (texture->mIsReady)
+        {
+            mDevice.DestroyTexture(std::move(texture));
+        }
+        else
+        {
+            mOrphanedStorage.push_back(std::move(texture));
+        }
+    }
+
+    void TextureResidencyManager::RequestMip(const TextureResource& texture, uint32_t desiredMip)
+    {
+        std::lock_guard<std::mutex> lockGuard(mRequestMutex);
+
+        auto streamedTextureIterator = mStreamedTextures.find(&texture);
+        assert(streamedTextureIterator != mStreamedTextures.end());
+
+        mPolicy.RequestMip(streamedTextureIterator->second->mTextureId, desiredMip, mFrameIndex);
+    }
+
+    void TextureResidencyManager::Update()
+    {
+        std::lock_guard<std::mutex> lockGuard(mRequestMutex);
+
+        for (auto& streamedTextureEntry : mStreamedTextures)
+        {
+            StreamedTexture& streamedTexture = *streamedTextureEntry.second;
+
+            if (streamedTexture.mPendingStorage && streamedTexture.mPendingStorage->mIsReady)
+            {
+                mDevice.SwapTextureStorage(*streamedTexture.mTexture, std::move(streamedTexture.mPendingStorage));
+                mPolicy.SetResidentMip(streamedTexture.mTextureId, streamedTexture.mPendingMip);
+            }
+        }
+
+        for (auto& orphanedStorage : mOrphanedStorage)
+        {
+            if (orphanedStorage->mIsReady)
+            {
+                mDevice.DestroyTexture(std::move(orphanedStorage));
+            }
+        }
+
+        mOrphanedStorage.erase(std::remove(mOrphanedStorage.begin(), mOrphanedStorage.end(), nullptr), mOrphanedStorage.end());
+
+        mPolicy.Plan(mFrameIndex, mBudgetBytes, mChanges);
+
+        //Evictions are issued first and at a higher priority, so the memory they give back is available to upgrades sooner.
+        auto isEviction = [this](const ResidencyChange& change) { return change.mResidentMip > mPolicy.GetResidentMip(change.mTextureId); };
+        std::stable_partition(mChanges.begin(), mChanges.end(), isEviction);
+
+        for (const ResidencyChange& change : mChanges)
+        {
+            StreamedTexture& streamedTexture = *mTexturesById[change.mTextureId];
+
+            streamedTexture.mPendingStorage = mDevice.CreateTextureFromFileData(streamedTexture.mFileData, change.mResidentMip, isEviction(change) ? UploadPriority::high : UploadPriority::normal);
+            streamedTexture.mPendingMip = change.mResidentMip;
+        }
+
+        mFrameIndex++;
+    }
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include "D3D12Lite.h"
+#include "D3D12LiteResidencyPolicy.h"
+#include <unordered_map>
+
+namespace D3D12Lite
+{
+    //Streamed textures start out with only their mip tail resident, the mips at or below this size in both dimensions.
+    constexpr uint32_t TEXTURE_STREAMING_TAIL_SIZE = 128;
+
+    //Owns the file data of streamed textures and turns the policy's decisions into new texture storage, which is swapped
+    //into the texture the caller holds once its upload finished. Call Update once per frame after Device::BeginFrame.
+    class TextureResidencyManager
+    {
+    public:
+        TextureResidencyManager(Device& device, uint64_t budgetBytes);
+        ~TextureResidencyManager();
+
+        std::unique_ptr<TextureResource> CreateStreamedTexture(const std::string& texturePath);
+        void DestroyStreamedTexture(std::unique_ptr<TextureResource> texture);
+
+        //Safe to call from any thread while recording.
+        void RequestMip(const TextureResource& texture, uint32_t desiredMip);
+
+        void Update();
+        void SetBudget(uint64_t budgetBytes) { mBudgetBytes = budgetBytes; }
+        const ResidencyStatistics& GetStatistics() const { return mPolicy.GetStatistics(); }
+
+    private:
+        struct StreamedTexture
+        {
+            TextureResource* mTexture = nullptr;
+            uint32_t mTextureId = 0;
+            TextureFileData mFileData;
+            std::unique_ptr<TextureResource> mPendingStorage;
+            uint32_t mPendingMip = 0;
+        };
+
+        Device& mDevice;
+        ResidencyPolicy mPolicy;
+        uint64_t mBudgetBytes = 0;
+        uint64_t mFrameIndex = 0;
+        std::unordered_map<const TextureResource*, std::unique_ptr<StreamedTexture>> mStreamedTextures;
+        std::vector<StreamedTexture*> mTexturesById;
+        std::vector<std::unique_ptr<TextureResource>> mOrphanedStorage;
+        std::vector<ResidencyChange> mChanges;
+        std::mutex mRequestMutex;
+    };
+}
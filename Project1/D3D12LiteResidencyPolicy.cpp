@@ -0,0 +1,189 @@
+#include "D3D12LiteResidencyPolicy.h"
+#include <algorithm>
+#include <cassert>
+
+namespace D3D12Lite
+{
+    uint32_t ResidencyPolicy::AddTexture(const std::vector<uint64_t>& mipSizes, uint32_t tailMip)
+    {
+        assert(!mipSizes.empty() && tailMip < mipSizes.size());
+
+        uint32_t textureId = static_cast<uint32_t>(mEntries.size());
+
+        if (!mFreeEntries.empty())
+        {
+            textureId = mFreeEntries.back();
+            mFreeEntries.pop_back();
+        }
+        else
+        {
+            mEntries.emplace_back();
+        }
+
+        Entry& entry = mEntries[textureId];
+        entry = Entry{};
+        entry.mIsInUse = true;
+        entry.mTailMip = tailMip;
+        entry.mResidentMip = tailMip;
+        entry.mTargetMip = tailMip;
+        entry.mDesiredMip = tailMip;
+
+        //Bytes taken when everything from a given mip down is resident.
+        entry.mResidentSizes.resize(mipSizes.size() + 1, 0);
+        for (size_t mipIndex = mipSizes.size(); mipIndex > 0; mipIndex--)
+        {
+            entry.mResidentSizes[mipIndex - 1] = entry.mResidentSizes[mipIndex] + mipSizes[mipIndex - 1];
+        }
+
+        mCommittedBytes += GetCommittedBytes(entry);
+
+        return textureId;
+    }
+
+    void ResidencyPolicy::RemoveTexture(uint32_t textureId)
+    {
+        Entry& entry = mEntries[textureId];
+        assert(entry.mIsInUse);
+
+        mCommittedBytes -= GetCommittedBytes(entry);
+        entry.mIsInUse = false;
+        entry.mResidentSizes.clear();
+        mFreeEntries.push_back(textureId);
+    }
+
+    void ResidencyPolicy::RequestMip(uint32_t textureId, uint32_t desiredMip, uint64_t frameIndex)
+    {
+        Entry& entry = mEntries[textureId];
+        assert(entry.mIsInUse);
+
+        desiredMip = (std::min)(desiredMip, entry.mTailMip);
+
+        if (entry.mLastRequestFrame != frameIndex)
+        {
+            entry.mLastRequestFrame = frameIndex;
+            entry.mDesiredMip = desiredMip;
+        }
+        else
+        {
+            entry.mDesiredMip = (std::min)(entry.mDesiredMip, desiredMip);
+        }
+    }
+
+    void ResidencyPolicy::SetResidentMip(uint32_t textureId, uint32_t residentMip)
+    {
+        Entry& entry = mEntries[textureId];
+        assert(entry.mIsInUse && entry.mTargetMip == residentMip);
+
+        entry.mResidentMip = residentMip;
+    }
+
+    void ResidencyPolicy::Plan(uint64_t frameIndex, uint64_t budgetBytes, std::vector<ResidencyChange>& changes)
+    {
+        struct Candidate
+        {
+            uint32_t mTextureId = 0;
+            uint32_t mMip = 0;
+            uint64_t mLastRequestFrame = 0;
+            uint64_t mSize = 0;
+        };
+
+        changes.clear();
+        mStatistics = ResidencyStatistics{};
+
+        std::vector<Candidate> upgrades;
+        std::vector<Candidate> evictions;
+
+        for (uint32_t textureId = 0; textureId < mEntries.size(); textureId++)
+        {
+            const Entry& entry = mEntries[textureId];
+
+            if (!entry.mIsInUse || entry.mTargetMip != entry.mResidentMip)
+            {
+                continue;
+            }
+
+            const bool isRequestedThisFrame = entry.mLastRequestFrame == frameIndex;
+            const bool isStale = entry.mLastRequestFrame + RESIDENCY_EVICTION_GRACE_FRAMES < frameIndex;
+
+            if (isRequestedThisFrame && entry.mDesiredMip < entry.mResidentMip)
+            {
+                upgrades.push_back({ textureId, entry.mDesiredMip, entry.mLastRequestFrame, entry.mResidentSizes[entry.mDesiredMip] - entry.mResidentSizes[entry.mResidentMip] });
+            }
+            else if (isStale && entry.mResidentMip < entry.mTailMip)
+            {
+                evictions.push_back({ textureId, entry.mTailMip, entry.mLastRequestFrame, entry.mResidentSizes[entry.mResidentMip] - entry.mResidentSizes[entry.mTailMip] });
+            }
+            else if (!isStale && entry.mDesiredMip > entry.mResidentMip)
+            {
+                //Still in use but needed at a coarser mip than resident, cheap to give back once the stale ones are gone.
+                evictions.push_back({ textureId, entry.mDesiredMip, entry.mLastRequestFrame, entry.mResidentSizes[entry.mResidentMip] - entry.mResidentSizes[entry.mDesiredMip] });
+            }
+        }
+
+        //Cheapest upgrades first so as many textures as possible sharpen up, least recently used evictions first.
+        std::sort(upgrades.begin(), upgrades.end(), [](const Candidate& a, const Candidate& b) { return a.mSize < b.mSize; });
+        std::sort(evictions.begin(), evictions.end(), [](const Candidate& a, const Candidate& b) { return a.mLastRequestFrame < b.mLastRequestFrame; });
+
+        size_t nextEviction = 0;
+        auto evictNext = [&]()
+        {
+            const Candidate& eviction = evictions[nextEviction++];
+            mEntries[eviction.mTextureId].mTargetMip = eviction.mMip;
+            mCommittedBytes -= eviction.mSize;
+            changes.push_back({ eviction.mTextureId, eviction.mMip });
+            mStatistics.mNumEvictions++;
+        };
+
+        //The budget may have shrunk below what is already resident.
+        while (mCommittedBytes > budgetBytes && nextEviction < evictions.size())
+        {
+            evictNext();
+        }
+
+        for (const Candidate& upgrade : upgrades)
+        {
+            Entry& entry = mEntries[upgrade.mTextureId];
+            uint32_t upgradeMip = upgrade.mMip;
+
+            //Settle for a coarser mip than requested when the finer ones can't be made to fit.
+            for (; upgradeMip < entry.mResidentMip; upgradeMip++)
+            {
+                const uint64_t upgradeSize = entry.mResidentSizes[upgradeMip] - entry.mResidentSizes[entry.mResidentMip];
+
+                while (mCommittedBytes + upgradeSize > budgetBytes && nextEviction < evictions.size())
+                {
+                    evictNext();
+                }
+
+                if (mCommittedBytes + upgradeSize <= budgetBytes)
+                {
+                    break;
+                }
+            }
+
+            if (upgradeMip == entry.mResidentMip)
+            {
+                mStatistics.mNumDeferredRequests++;
+                continue;
+            }
+
+            mCommittedBytes += entry.mResidentSizes[upgradeMip] - entry.mResidentSizes[entry.mResidentMip];
+            entry.mTargetMip = upgradeMip;
+            changes.push_back({ upgrade.mTextureId, upgradeMip });
+            mStatistics.mNumUpgrades++;
+        }
+
+        mStatistics.mResidentBytes = mCommittedBytes;
+    }
+
+    uint64_t ResidencyPolicy::GetResidentBytes(uint32_t textureId) const
+    {
+        const Entry& entry = mEntries[textureId];
+        return entry.mResidentSizes[entry.mResidentMip];
+    }
+
+    uint32_t ResidencyPolicy::GetResidentMip(uint32_t textureId) const
+    {
+        return mEntries[textureId].mResidentMip;
+    }
+}
@@ -0,0 +1,67 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+namespace D3D12Lite
+{
+    //Textures requested within this many frames are not evicted to make room for others.
+    constexpr uint64_t RESIDENCY_EVICTION_GRACE_FRAMES = 2;
+
+    struct ResidencyChange
+    {
+        uint32_t mTextureId = 0;
+        uint32_t mResidentMip = 0;
+    };
+
+    struct ResidencyStatistics
+    {
+        uint64_t mResidentBytes = 0;
+        uint32_t mNumUpgrades = 0;
+        uint32_t mNumEvictions = 0;
+        uint32_t mNumDeferredRequests = 0;
+    };
+
+    //Decides which mip each streamed texture should have resident. Only does bookkeeping on mip sizes and frame numbers,
+    //so it runs the same against a simulated budget as it does behind TextureResidencyManager.
+    class ResidencyPolicy
+    {
+    public:
+        //mipSizes holds the bytes every mip level takes across all array slices, tailMip is the largest mip that is always resident.
+        uint32_t AddTexture(const std::vector<uint64_t>& mipSizes, uint32_t tailMip);
+        void RemoveTexture(uint32_t textureId);
+
+        //The finest mip a texture was needed at this frame. Several requests in one frame keep the finest of them.
+        void RequestMip(uint32_t textureId, uint32_t desiredMip, uint64_t frameIndex);
+
+        //Called once a change handed out by Plan has taken effect.
+        void SetResidentMip(uint32_t textureId, uint32_t residentMip);
+
+        //Hands out upgrades towards the requested mips, cheapest first, and evicts least recently used textures
+        //down to their tail when an upgrade would not fit. Textures with a change in flight are left alone. The budget is
+        //checked against the mips textures are moving to, the overlap while old and new storage both exist is not counted.
+        void Plan(uint64_t frameIndex, uint64_t budgetBytes, std::vector<ResidencyChange>& changes);
+
+        uint64_t GetResidentBytes(uint32_t textureId) const;
+        uint32_t GetResidentMip(uint32_t textureId) const;
+        const ResidencyStatistics& GetStatistics() const { return mStatistics; }
+
+    private:
+        struct Entry
+        {
+            std::vector<uint64_t> mResidentSizes;
+            uint32_t mTailMip = 0;
+            uint32_t mResidentMip = 0;
+            uint32_t mTargetMip = 0;
+            uint32_t mDesiredMip = 0;
+            uint64_t mLastRequestFrame = 0;
+            bool mIsInUse = false;
+        };
+
+        uint64_t GetCommittedBytes(const Entry& entry) const { return entry.mResidentSizes[entry.mTargetMip]; }
+
+        std::vector<Entry> mEntries;
+        std::vector<uint32_t> mFreeEntries;
+        uint64_t mCommittedBytes = 0;
+        ResidencyStatistics mStatistics;
+    };
+}
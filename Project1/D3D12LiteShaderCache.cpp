@@ -0,0 +1,459 @@
+#include "D3D12LiteShaderCache.h"
+#include <fstream>
+#include <chrono>
+#include <unordered_set>
+#include <cstdio>
+#include <cstring>
+#include <random>
+
+namespace D3D12Lite
+{
+    namespace
+    {
+        double GetMillisecondsSince(std::chrono::steady_clock::time_point startTime)
+        {
+            return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+        }
+
+        template<typename T>
+        bool ReadWholeFile(const std::filesystem::path& path, T& contents)
+        {
+            std::ifstream file(path, std::ios::binary | std::ios::ate);
+            if (!file)
+            {
+                return false;
+            }
+
+            std::streamoff fileSize = file.tellg();
+            file.seekg(0, std::ios::beg);
+
+            contents.resize(static_cast<size_t>(fileSize));
+            file.read(reinterpret_cast<char*>(contents.data()), fileSize);
+
+            return static_cast<bool>(file);
+        }
+
+        //Unique per write, so threads or processes storing the same key never write into each other's temporary file.
+        std::filesystem::path GetTemporaryPath(const std::filesystem::path& path)
+        {
+            thread_local std::mt19937_64 randomGenerator(std::random_device{}() ^ std::hash<std::thread::id>{}(std::this_thread::get_id()));
+
+            char suffix[24];
+            snprintf(suffix, sizeof(suffix), ".%016llx.tmp", static_cast<unsigned long long>(randomGenerator()));
+
+            std::filesystem::path temporaryPath = path;
+            temporaryPath += suffix;
+
+            return temporaryPath;
+        }
+
+        //Written next to the destination first, so a crash never leaves a truncated file under a valid key.
+        bool WriteWholeFile(const std::filesystem::path& path, const std::vector<uint8_t>& contents)
+        {
+            const std::filesystem::path temporaryPath = GetTemporaryPath(path);
+
+            {
+                std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+                if (!file)
+                {
+                    return false;
+                }
+
+                file.write(reinterpret_cast<const char*>(contents.data()), static_cast<std::streamsize>(contents.size()));
+                if (!file)
+                {
+                    return false;
+                }
+            }
+
+            std::error_code errorCode;
+            std::filesystem::rename(temporaryPath, path, errorCode);
+            if (errorCode)
+            {
+                std::filesystem::remove(temporaryPath, errorCode);
+                return false;
+            }
+
+            return true;
+        }
+
+        constexpr uint32_t CACHED_SHADER_MAGIC = 0x48534443; //"CDSH"
+
+        //In front of the bytecode of every cached shader, so an entry that was cut short or written over by something else
+        //is compiled again instead of being handed to the driver.
+        struct CachedShaderHeader
+        {
+            uint32_t mMagic = CACHED_SHADER_MAGIC;
+            uint32_t mVersion = SHADER_CACHE_VERSION;
+            uint64_t mByteCodeSize = 0;
+            uint64_t mByteCodeHash = 0;
+        };
+
+        uint64_t HashByteCode(const std::vector<uint8_t>& byteCode)
+        {
+            Hasher hasher;
+            hasher.Add(byteCode.data(), byteCode.size());
+
+            return hasher.GetHash();
+        }
+
+        bool ReadCachedShader(const std::filesystem::path& path, std::vector<uint8_t>& byteCode)
+        {
+            std::vector<uint8_t> contents;
+            if (!ReadWholeFile(path, contents) || contents.size() <= sizeof(CachedShaderHeader))
+            {
+                return false;
+            }
+
+            CachedShaderHeader header;
+            memcpy(&header, contents.data(), sizeof(header));
+
+            if (header.mMagic != CACHED_SHADER_MAGIC || header.mVersion != SHADER_CACHE_VERSION || header.mByteCodeSize != contents.size() - sizeof(header))
+            {
+                return false;
+            }
+
+            std::vector<uint8_t> cachedByteCode(contents.begin() + sizeof(header), contents.end());
+            if (HashByteCode(cachedByteCode) != header.mByteCodeHash)
+            {
+                return false;
+            }
+
+            byteCode = std::move(cachedByteCode);
+
+            return true;
+        }
+
+        bool WriteCachedShader(const std::filesystem::path& path, const std::vector<uint8_t>& byteCode)
+        {
+            CachedShaderHeader header;
+            header.mByteCodeSize = byteCode.size();
+            header.mByteCodeHash = HashByteCode(byteCode);
+
+            std::vector<uint8_t> contents(sizeof(header) + byteCode.size());
+            memcpy(contents.data(), &header, sizeof(header));
+            memcpy(contents.data() + sizeof(header), byteCode.data(), byteCode.size());
+
+            return WriteWholeFile(path, contents);
+        }
+
+        //Only looks at the directive itself, includes in inactive #if blocks or comments are hashed as well, which costs
+        //an occasional needless recompile and never a stale hit.
+        void FindIncludes(const std::string& source, std::vector<std::string>& includes)
+        {
+            size_t lineStart = 0;
+
+            while (lineStart < source.size())
+            {
+                size_t lineEnd = source.find('\n', lineStart);
+                if (lineEnd == std::string::npos)
+                {
+                    lineEnd = source.size();
+                }
+
+                size_t position = source.find_first_not_of(" \t", lineStart);
+                if (position < lineEnd && source[position] == '#')
+                {
+                    position = source.find_first_not_of(" \t", position + 1);
+                    if (position < lineEnd && source.compare(position, 7, "include") == 0)
+                    {
+                        position = source.find_first_not_of(" \t", position + 7);
+                        if (position < lineEnd && (source[position] == '"' || source[position] == '<'))
+                        {
+                            char closingDelimiter = source[position] == '"' ? '"' : '>';
+                            size_t nameEnd = source.find(closingDelimiter, position + 1);
+
+                            if (nameEnd < lineEnd)
+                            {
+                                includes.push_back(source.substr(position + 1, nameEnd - position - 1));
+                            }
+                        }
+                    }
+                }
+
+                lineStart = lineEnd + 1;
+            }
+        }
+
+        void HashIncludes(const std::filesystem::path& includingPath, const std::string& source, uint32_t depth,
+            std::unordered_set<std::wstring>& visitedPaths, Hasher& hasher)
+        {
+            if (depth >= MAX_SHADER_INCLUDE_DEPTH)
+            {
+                return;
+            }
+
+            std::vector<std::string> includes;
+            FindIncludes(source, includes);
+
+            for (const std::string& include : includes)
+            {
+                hasher.Add(include);
+
+                std::filesystem::path candidates[] = { includingPath.parent_path() / include, std::filesystem::path(include) };
+                std::string includeSource;
+                std::filesystem::path includePath;
+
+                for (const std::filesystem::path& candidate : candidates)
+                {
+                    if (ReadWholeFile(candidate, includeSource))
+                    {
+                        includePath = candidate.lexically_normal();
+                        break;
+                    }
+                }
+
+                if (includePath.empty())
+                {
+                    continue;
+                }
+
+                //Every file only counts once, which also keeps #pragma once headers and include cycles from recursing forever.
+                if (!visitedPaths.insert(includePath.wstring()).second)
+                {
+                    continue;
+                }
+
+                hasher.Add(includeSource);
+                HashIncludes(includePath, includeSource, depth + 1, visitedPaths, hasher);
+            }
+        }
+
+        uint64_t HashRequestIdentity(const ShaderCompileRequest& request)
+        {
+            Hasher hasher;
+            hasher.Add(request.mSourcePath.wstring());
+            hasher.Add(request.mSourceName);
+            hasher.Add(request.mEntryPoint);
+            hasher.Add(request.mTarget);
+
+            for (const std::wstring& argument : request.mArguments)
+            {
+                hasher.Add(argument);
+            }
+
+            return hasher.GetHash();
+        }
+    }
+
+    void Hasher::Add(const void* data, size_t size)
+    {
+        const uint8_t* bytes = static_cast<const uint8_t*>(data);
+
+        for (size_t byteIndex = 0; byteIndex < size; byteIndex++)
+        {
+            mHash ^= bytes[byteIndex];
+            mHash *= 0x100000001b3ull;
+        }
+    }
+
+    //Strings are prefixed with their length, so moving characters from one field to the next changes the hash.
+    void Hasher::Add(const std::string& text)
+    {
+        Add(static_cast<uint64_t>(text.size()));
+        Add(text.data(), text.size());
+    }
+
+    void Hasher::Add(const std::wstring& text)
+    {
+        Add(static_cast<uint64_t>(text.size()));
+        Add(text.data(), text.size() * sizeof(wchar_t));
+    }
+
+    bool HashShaderRequest(const ShaderCompileRequest& request, std::string& source, uint64_t& hash, std::string& errors)
+    {
+        if (!ReadWholeFile(request.mSourcePath, source))
+        {
+            errors = "Failed to read shader source " + request.mSourcePath.string();
+            return false;
+        }
+
+        Hasher hasher;
+        hasher.Add(static_cast<uint64_t>(SHADER_CACHE_VERSION));
+        hasher.Add(request.mEntryPoint);
+        hasher.Add(request.mTarget);
+        hasher.Add(static_cast<uint64_t>(request.mArguments.size()));
+
+        for (const std::wstring& argument : request.mArguments)
+        {
+            hasher.Add(argument);
+        }
+
+        hasher.Add(source);
+
+        //The compiler resolves includes in the main file against the name it is given, not where it was read from.
+        std::unordered_set<std::wstring> visitedPaths;
+        HashIncludes(std::filesystem::path(request.mSourceName), source, 0, visitedPaths, hasher);
+
+        hash = hasher.GetHash();
+
+        return true;
+    }
+
+    ShaderCache::ShaderCache(const std::filesystem::path& cachePath, ShaderCompilerFactory compilerFactory, uint32_t numThreads)
+        : mCachePath(cachePath)
+        , mCompilerFactory(std::move(compilerFactory))
+        , mWorkerPool(numThreads)
+    {
+        std::error_code errorCode;
+        std::filesystem::create_directories(mCachePath, errorCode);
+    }
+
+    ShaderCache::~ShaderCache()
+    {
+        mWorkerPool.WaitForIdle();
+    }
+
+    std::shared_future<ShaderCacheResult> ShaderCache::Request(const ShaderCompileRequest& request)
+    {
+        uint64_t requestKey = HashRequestIdentity(request);
+
+        std::shared_ptr<std::promise<ShaderCacheResult>> promise;
+        std::shared_future<ShaderCacheResult> future;
+
+        {
+            std::lock_guard<std::mutex> lockGuard(mRequestMutex);
+
+            auto requestInFlight = mRequestsInFlight.find(requestKey);
+            if (requestInFlight != mRequestsInFlight.end())
+            {
+                future = requestInFlight->second;
+            }
+            else
+            {
+                promise = std::make_shared<std::promise<ShaderCacheResult>>();
+                future = promise->get_future().share();
+                mRequestsInFlight.insert(std::make_pair(requestKey, future));
+            }
+        }
+
+        {
+            std::lock_guard<std::mutex> lockGuard(mStatisticsMutex);
+            mStatistics.mNumRequests++;
+            mStatistics.mNumDeduplicated += promise ? 0 : 1;
+        }
+
+        if (promise)
+        {
+            mWorkerPool.AddJob([this, request, requestKey, promise]()
+            {
+                promise->set_value(Process(request));
+
+                //Gone once it is answered, so the next request for it sees any source changes made since.
+                std::lock_guard<std::mutex> lockGuard(mRequestMutex);
+                mRequestsInFlight.erase(requestKey);
+            });
+        }
+
+        return future;
+    }
+
+    void ShaderCache::WaitForIdle()
+    {
+        mWorkerPool.WaitForIdle();
+    }
+
+    std::filesystem::path ShaderCache::GetCachedPath(const ShaderCompileRequest& request, uint64_t hash) const
+    {
+        char hashText[17];
+        snprintf(hashText, sizeof(hashText), "%016llx", static_cast<unsigned long long>(hash));
+
+        std::filesystem::path fileName = std::filesystem::path(request.mSourceName).stem();
+        fileName += "_";
+        fileName += request.mEntryPoint;
+        fileName += "_";
+        fileName += hashText;
+        fileName += ".dxil";
+
+        return mCachePath / fileName;
+    }
+
+    ShaderCacheStatistics ShaderCache::GetStatistics() const
+    {
+        std::lock_guard<std::mutex> lockGuard(mStatisticsMutex);
+        return mStatistics;
+    }
+
+    ShaderCacheResult ShaderCache::Process(const ShaderCompileRequest& request)
+    {
+        ShaderCacheResult result;
+        std::string source;
+
+        auto startTime = std::chrono::steady_clock::now();
+        bool hashed = HashShaderRequest(request, source, result.mHash, result.mErrors);
+        double hashMilliseconds = GetMillisecondsSince(startTime);
+
+        if (!hashed)
+        {
+            std::lock_guard<std::mutex> lockGuard(mStatisticsMutex);
+            mStatistics.mNumFailures++;
+            mStatistics.mHashMilliseconds += hashMilliseconds;
+
+            return result;
+        }
+
+        std::filesystem::path cachedPath = GetCachedPath(request, result.mHash);
+
+        startTime = std::chrono::steady_clock::now();
+        if (ReadCachedShader(cachedPath, result.mByteCode))
+        {
+            result.mSucceeded = true;
+            result.mWasCached = true;
+
+            std::lock_guard<std::mutex> lockGuard(mStatisticsMutex);
+            mStatistics.mNumHits++;
+            mStatistics.mHashMilliseconds += hashMilliseconds;
+            mStatistics.mLoadMilliseconds += GetMillisecondsSince(startTime);
+
+            return result;
+        }
+
+        //Whatever is there under this key failed validation and gets written over below.
+        std::error_code errorCode;
+        const bool isCorruptEntry = std::filesystem::exists(cachedPath, errorCode);
+
+        startTime = std::chrono::steady_clock::now();
+        ShaderCompileOutput output = GetCompilerForThisThread().Compile(request, source);
+        double compileMilliseconds = GetMillisecondsSince(startTime);
+
+        result.mSucceeded = output.mSucceeded;
+        result.mErrors = std::move(output.mErrors);
+
+        //Failed compiles are never cached, they are retried on the next request in case the source is fixed by then.
+        if (output.mSucceeded)
+        {
+            result.mByteCode = std::move(output.mByteCode);
+
+            WriteCachedShader(cachedPath, result.mByteCode);
+
+            if (!output.mDebugData.empty())
+            {
+                std::filesystem::path debugDataPath = cachedPath;
+                debugDataPath += ".pdb";
+                WriteWholeFile(debugDataPath, output.mDebugData);
+            }
+        }
+
+        std::lock_guard<std::mutex> lockGuard(mStatisticsMutex);
+        mStatistics.mNumMisses++;
+        mStatistics.mNumCorruptEntries += isCorruptEntry ? 1 : 0;
+        mStatistics.mNumFailures += output.mSucceeded ? 0 : 1;
+        mStatistics.mHashMilliseconds += hashMilliseconds;
+        mStatistics.mCompileMilliseconds += compileMilliseconds;
+
+        return result;
+    }
+
+    ShaderCompiler& ShaderCache::GetCompilerForThisThread()
+    {
+        std::lock_guard<std::mutex> lockGuard(mCompilerMutex);
+
+        std::unique_ptr<ShaderCompiler>& compiler = mCompilers[std::this_thread::get_id()];
+        if (!compiler)
+        {
+            compiler = mCompilerFactory();
+        }
+
+        return *compiler;
+    }
+}
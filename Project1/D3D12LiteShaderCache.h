@@ -0,0 +1,125 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <memory>
+#include <future>
+#include <mutex>
+#include <unordered_map>
+#include <filesystem>
+#include "D3D12LiteWorkerPool.h"
+
+namespace D3D12Lite
+{
+    //Part of every cache key, bump it when the compiler, the arguments every shader is compiled with or the layout of
+    //the cached files change.
+    constexpr uint32_t SHADER_CACHE_VERSION = 2;
+    constexpr uint32_t NUM_SHADER_COMPILE_THREADS = 4;
+    constexpr uint32_t MAX_SHADER_INCLUDE_DEPTH = 32;
+
+    struct ShaderCompileRequest
+    {
+        //Where the source is read from, and the name the compiler sees it under, which is also what its includes are
+        //resolved against.
+        std::filesystem::path mSourcePath;
+        std::wstring mSourceName;
+        std::wstring mEntryPoint;
+        std::wstring mTarget;
+        //Passed to the compiler after the entry point and target, defines included.
+        std::vector<std::wstring> mArguments;
+    };
+
+    struct ShaderCompileOutput
+    {
+        bool mSucceeded = false;
+        std::vector<uint8_t> mByteCode;
+        std::vector<uint8_t> mDebugData;
+        std::string mErrors;
+    };
+
+    //Turns source into bytecode. A ShaderCache creates one per compile thread and only calls it from that thread, so
+    //implementations can hold on to expensive compiler state between calls.
+    class ShaderCompiler
+    {
+    public:
+        virtual ~ShaderCompiler() = default;
+        virtual ShaderCompileOutput Compile(const ShaderCompileRequest& request, const std::string& source) = 0;
+    };
+
+    using ShaderCompilerFactory = std::function<std::unique_ptr<ShaderCompiler>()>;
+
+    struct ShaderCacheResult
+    {
+        bool mSucceeded = false;
+        bool mWasCached = false;
+        uint64_t mHash = 0;
+        std::vector<uint8_t> mByteCode;
+        std::string mErrors;
+    };
+
+    struct ShaderCacheStatistics
+    {
+        uint32_t mNumRequests = 0;
+        //Requests that were handed the future of an identical one still in flight.
+        uint32_t mNumDeduplicated = 0;
+        uint32_t mNumHits = 0;
+        uint32_t mNumMisses = 0;
+        //Misses that found a cached file which failed validation.
+        uint32_t mNumCorruptEntries = 0;
+        uint32_t mNumFailures = 0;
+        //Summed over the compile threads, so they can add up to more than the time that passed.
+        double mHashMilliseconds = 0.0;
+        double mLoadMilliseconds = 0.0;
+        double mCompileMilliseconds = 0.0;
+    };
+
+    //64 bit FNV-1a.
+    class Hasher
+    {
+    public:
+        void Add(const void* data, size_t size);
+        void Add(const std::string& text);
+        void Add(const std::wstring& text);
+        void Add(uint64_t value) { Add(&value, sizeof(value)); }
+        uint64_t GetHash() const { return mHash; }
+
+    private:
+        uint64_t mHash = 0xcbf29ce484222325ull;
+    };
+
+    //Reads the request's source and every file it includes, resolved against the including file and then the working
+    //directory, and hashes them together with the entry point, target and arguments. Includes that can't be found only
+    //have their name hashed and are left for the compiler to report. Fails when the source itself can't be read.
+    bool HashShaderRequest(const ShaderCompileRequest& request, std::string& source, uint64_t& hash, std::string& errors);
+
+    //Compiled shaders on disk, keyed by HashShaderRequest. Hits are loaded without creating a compiler at all.
+    class ShaderCache
+    {
+    public:
+        ShaderCache(const std::filesystem::path& cachePath, ShaderCompilerFactory compilerFactory, uint32_t numThreads = NUM_SHADER_COMPILE_THREADS);
+        ~ShaderCache();
+
+        //Returns right away, hashing, loading and compiling all happen on the compile threads. Requests identical to
+        //one still in flight share its future.
+        std::shared_future<ShaderCacheResult> Request(const ShaderCompileRequest& request);
+        void WaitForIdle();
+
+        std::filesystem::path GetCachedPath(const ShaderCompileRequest& request, uint64_t hash) const;
+        ShaderCacheStatistics GetStatistics() const;
+
+    private:
+        ShaderCacheResult Process(const ShaderCompileRequest& request);
+        ShaderCompiler& GetCompilerForThisThread();
+
+        std::filesystem::path mCachePath;
+        ShaderCompilerFactory mCompilerFactory;
+        std::unordered_map<std::thread::id, std::unique_ptr<ShaderCompiler>> mCompilers;
+        std::mutex mCompilerMutex;
+        std::unordered_map<uint64_t, std::shared_future<ShaderCacheResult>> mRequestsInFlight;
+        std::mutex mRequestMutex;
+        ShaderCacheStatistics mStatistics;
+        mutable std::mutex mStatisticsMutex;
+        //Declared last so the threads are joined before anything they use goes away.
+        WorkerPool mWorkerPool;
+    };
+}
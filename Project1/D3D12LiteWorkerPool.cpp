@@ -0,0 +1,74 @@
+#include "D3D12LiteWorkerPool.h"
+
+namespace D3D12Lite
+{
+    WorkerPool::WorkerPool(uint32_t numThreads)
+    {
+        for (uint32_t threadIndex = 0; threadIndex < numThreads; threadIndex++)
+        {
+            mThreads.emplace_back([this]() { WorkerLoop(); });
+        }
+    }
+
+    WorkerPool::~WorkerPool()
+    {
+        {
+            std::lock_guard<std::mutex> lockGuard(mJobMutex);
+            mIsShuttingDown = true;
+        }
+
+        mJobCondition.notify_all();
+
+        for (auto& thread : mThreads)
+        {
+            thread.join();
+        }
+    }
+
+    void WorkerPool::AddJob(std::function<void()> job)
+    {
+        {
+            std::lock_guard<std::mutex> lockGuard(mJobMutex);
+            mJobs.push_back(std::move(job));
+            mNumUnfinishedJobs++;
+        }
+
+        mJobCondition.notify_one();
+    }
+
+    void WorkerPool::WaitForIdle()
+    {
+        std::unique_lock<std::mutex> lock(mJobMutex);
+        mIdleCondition.wait(lock, [this]() { return mNumUnfinishedJobs == 0; });
+    }
+
+    void WorkerPool::WorkerLoop()
+    {
+        while (true)
+        {
+            std::function<void()> job;
+
+            {
+                std::unique_lock<std::mutex> lock(mJobMutex);
+                mJobCondition.wait(lock, [this]() { return mIsShuttingDown || !mJobs.empty(); });
+
+                if (mJobs.empty())
+                {
+                    return;
+                }
+
+                job = std::move(mJobs.front());
+                mJobs.pop_front();
+            }
+
+            job();
+
+            {
+                std::lock_guard<std::mutex> lockGuard(mJobMutex);
+                mNumUnfinishedJobs--;
+            }
+
+            mIdleCondition.notify_all();
+        }
+    }
+}
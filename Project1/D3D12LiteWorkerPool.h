@@ -0,0 +1,35 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <functional>
+
+namespace D3D12Lite
+{
+    //Plain FIFO job pool. Staging copies of uploads run on one, and anything else that wants CPU work spread over a few
+    //threads can own its own, since WaitForIdle waits for every job in the pool.
+    class WorkerPool
+    {
+    public:
+        WorkerPool(uint32_t numThreads);
+        ~WorkerPool();
+
+        void AddJob(std::function<void()> job);
+        void WaitForIdle();
+        uint32_t GetNumThreads() const { return static_cast<uint32_t>(mThreads.size()); }
+
+    private:
+        void WorkerLoop();
+
+        std::vector<std::thread> mThreads;
+        std::deque<std::function<void()>> mJobs;
+        std::mutex mJobMutex;
+        std::condition_variable mJobCondition;
+        std::condition_variable mIdleCondition;
+        uint32_t mNumUnfinishedJobs = 0;
+        bool mIsShuttingDown = false;
+    };
+}
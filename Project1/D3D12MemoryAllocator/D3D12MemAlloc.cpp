@@ -40,6 +40,10 @@
     #include <shared_mutex>
 #endif
 
+#ifdef _MSC_VER
+    #include <intrin.h> // for _BitScanForward64, _BitScanReverse64
+#endif
+
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
 //
@@ -278,6 +282,72 @@ inline bool IsPow2(T x)
     return (x & (x-1)) == 0;
 }
 
+// Returns index of the lowest set bit, UINT8_MAX if mask is 0.
+static inline UINT8 BitScanLSB(UINT64 mask)
+{
+#if defined(_MSC_VER) && defined(_WIN64)
+    unsigned long pos;
+    if(_BitScanForward64(&pos, mask))
+        return static_cast<UINT8>(pos);
+    return UINT8_MAX;
+#elif defined(__GNUC__) || defined(__clang__)
+    return mask ? static_cast<UINT8>(__builtin_ctzll(mask)) : UINT8_MAX;
+#else
+    for(UINT8 pos = 0; pos < 64; ++pos)
+    {
+        if(mask & (1ull << pos))
+            return pos;
+    }
+    return UINT8_MAX;
+#endif
+}
+static inline UINT8 BitScanLSB(UINT32 mask)
+{
+#ifdef _MSC_VER
+    unsigned long pos;
+    if(_BitScanForward(&pos, mask))
+        return static_cast<UINT8>(pos);
+    return UINT8_MAX;
+#elif defined(__GNUC__) || defined(__clang__)
+    return mask ? static_cast<UINT8>(__builtin_ctz(mask)) : UINT8_MAX;
+#else
+    return BitScanLSB(static_cast<UINT64>(mask));
+#endif
+}
+
+// Returns index of the highest set bit, UINT8_MAX if mask is 0.
+static inline UINT8 BitScanMSB(UINT64 mask)
+{
+#if defined(_MSC_VER) && defined(_WIN64)
+    unsigned long pos;
+    if(_BitScanReverse64(&pos, mask))
+        return static_cast<UINT8>(pos);
+    return UINT8_MAX;
+#elif defined(__GNUC__) || defined(__clang__)
+    return mask ? static_cast<UINT8>(63 - __builtin_clzll(mask)) : UINT8_MAX;
+#else
+    for(UINT8 pos = 64; pos--; )
+    {
+        if(mask & (1ull << pos))
+            return pos;
+    }
+    return UINT8_MAX;
+#endif
+}
+static inline UINT8 BitScanMSB(UINT32 mask)
+{
+#ifdef _MSC_VER
+    unsigned long pos;
+    if(_BitScanReverse(&pos, mask))
+        return static_cast<UINT8>(pos);
+    return UINT8_MAX;
+#elif defined(__GNUC__) || defined(__clang__)
+    return mask ? static_cast<UINT8>(31 - __builtin_clz(mask)) : UINT8_MAX;
+#else
+    return BitScanMSB(static_cast<UINT64>(mask));
+#endif
+}
+
 // Aligns given value up to nearest multiply of align value. For example: AlignUp(11, 8) = 16.
 // Use types like UINT, uint64_t as T.
 template <typename T>
@@ -2509,6 +2579,7 @@ struct AllocationRequest
     UINT64 sumFreeSize; // Sum size of free items that overlap with proposed allocation.
     UINT64 sumItemSize; // Sum size of items to make lost that overlap with proposed allocation.
     SuballocationList::iterator item;
+    void* algorithmData; // Used by algorithms other than generic: free block the allocation goes to for TLSF, place of the allocation for linear.
     BOOL zeroInitialized;
 };
 
@@ -2598,6 +2669,7 @@ public:
     virtual bool CreateAllocationRequest(
         UINT64 allocSize,
         UINT64 allocAlignment,
+        bool upperAddress,
         AllocationRequest* pAllocationRequest) = 0;
 
     // Makes actual allocation based on request. Request must already be checked and valid.
@@ -2612,10 +2684,15 @@ public:
     virtual void Clear() = 0;
 
     virtual void SetAllocationUserData(UINT64 offset, void* userData) = 0;
+    // Appends all allocations of this block to the list, in order of increasing offset.
+    virtual void AddAllocationsToList(Vector<Suballocation>& inoutList) const = 0;
 
     virtual void CalcAllocationStatInfo(StatInfo& outInfo) const = 0;
     virtual void WriteAllocationInfoToJson(JsonWriter& json) const = 0;
 
+    // Percentage of free bytes outside of the biggest free range. 0 means all free space is one range.
+    UINT CalcFragmentationPercent() const;
+
 protected:
     const ALLOCATION_CALLBACKS* GetAllocs() const { return m_pAllocationCallbacks; }
 
@@ -2645,6 +2722,7 @@ public:
     virtual bool CreateAllocationRequest(
         UINT64 allocSize,
         UINT64 allocAlignment,
+        bool upperAddress,
         AllocationRequest* pAllocationRequest);
 
     virtual void Alloc(
@@ -2656,6 +2734,7 @@ public:
     virtual void Clear();
 
     virtual void SetAllocationUserData(UINT64 offset, void* userData);
+    virtual void AddAllocationsToList(Vector<Suballocation>& inoutList) const;
 
     virtual void CalcAllocationStatInfo(StatInfo& outInfo) const;
     virtual void WriteAllocationInfoToJson(JsonWriter& json) const;
@@ -2698,6 +2777,222 @@ private:
     D3D12MA_CLASS_NO_COPY(BlockMetadata_Generic)
 };
 
+/*
+Two-level segregated fit (TLSF) allocation algorithm.
+
+Free ranges are kept in lists segregated by size. The first level is the power of two of the size
+(memory class), the second level splits each power of two linearly into SECOND_LEVEL_COUNT lists.
+Bitmaps of the non-empty lists find a free range that is big enough in constant time, and physically
+adjacent ranges are linked, so freeing merges neighbors without any search. Allocations are looked up by
+offset through an open addressing hash map.
+*/
+class BlockMetadata_TLSF : public BlockMetadata
+{
+public:
+    BlockMetadata_TLSF(const ALLOCATION_CALLBACKS* allocationCallbacks, bool isVirtual);
+    virtual ~BlockMetadata_TLSF();
+    virtual void Init(UINT64 size);
+
+    virtual bool Validate() const;
+    virtual size_t GetAllocationCount() const { return m_AllocCount; }
+    virtual UINT64 GetSumFreeSize() const { return m_SumFreeSize; }
+    virtual UINT64 GetUnusedRangeSizeMax() const;
+    virtual bool IsEmpty() const { return m_AllocCount == 0; }
+
+    virtual void GetAllocationInfo(UINT64 offset, VIRTUAL_ALLOCATION_INFO& outInfo) const;
+
+    virtual bool CreateAllocationRequest(
+        UINT64 allocSize,
+        UINT64 allocAlignment,
+        bool upperAddress,
+        AllocationRequest* pAllocationRequest);
+
+    virtual void Alloc(
+        const AllocationRequest& request,
+        UINT64 allocSize,
+        void* userData);
+
+    virtual void FreeAtOffset(UINT64 offset);
+    virtual void Clear();
+
+    virtual void SetAllocationUserData(UINT64 offset, void* userData);
+    virtual void AddAllocationsToList(Vector<Suballocation>& inoutList) const;
+
+    virtual void CalcAllocationStatInfo(StatInfo& outInfo) const;
+    virtual void WriteAllocationInfoToJson(JsonWriter& json) const;
+
+private:
+    // Sizes below SMALL_BUFFER_SIZE all fall into memory class 0, which is split linearly.
+    static const UINT8 SECOND_LEVEL_INDEX = 5;
+    static const UINT SECOND_LEVEL_COUNT = 1u << SECOND_LEVEL_INDEX;
+    static const UINT64 SMALL_BUFFER_SIZE = 256;
+    static const UINT8 MEMORY_CLASS_SHIFT = 7;
+    static const UINT8 MAX_MEMORY_CLASSES = 64 - MEMORY_CLASS_SHIFT;
+    static const size_t MIN_TAKEN_MAP_CAPACITY = 16;
+
+    struct Block
+    {
+        UINT64 offset;
+        UINT64 size;
+        Block* prevPhysical;
+        Block* nextPhysical;
+        // Neighbors in the free list, only used while the block is free.
+        Block* prevFree;
+        Block* nextFree;
+        void* userData;
+        bool isFree;
+    };
+
+    size_t m_AllocCount;
+    UINT m_FreeCount;
+    UINT64 m_SumFreeSize;
+    UINT64 m_IsFreeBitmap;
+    UINT32 m_InnerIsFreeBitmap[MAX_MEMORY_CLASSES];
+    UINT32 m_ListsCount;
+    Block** m_FreeList;
+    // Block at offset 0. Merging always keeps the lower block, so it lives until the metadata is destroyed.
+    Block* m_FirstBlock;
+    PoolAllocator<Block> m_BlockAllocator;
+    // Taken blocks by offset, linear probing. Capacity is a power of 2 and kept at least twice the count.
+    Block** m_TakenBlocks;
+    size_t m_TakenCapacity;
+    ZeroInitializedRange m_ZeroInitializedRange;
+
+    static UINT8 SizeToMemoryClass(UINT64 size);
+    static UINT32 SizeToSecondIndex(UINT64 size, UINT8 memoryClass);
+    static UINT32 GetListIndex(UINT8 memoryClass, UINT32 secondIndex);
+    static UINT32 GetListIndex(UINT64 size);
+
+    void InsertFreeBlock(Block* block);
+    void RemoveFreeBlock(Block* block);
+    // Returns first block of the first non-empty free list at or after given list index, NULL if there is none.
+    Block* FindFreeBlock(UINT32 listIndex) const;
+    // Checks if requested allocation fits in given free block. If yes, fills pOffset and returns true.
+    bool CheckBlock(const Block& block, UINT64 allocSize, UINT64 allocAlignment, UINT64* pOffset) const;
+    // Splits given block at lowerSize, returns the new block holding the upper part.
+    Block* SplitBlock(Block* block, UINT64 lowerSize);
+    // Given block absorbs the physically next one.
+    void MergeWithNext(Block* block);
+
+    size_t HashOffset(UINT64 offset) const;
+    size_t FindTakenSlot(UINT64 offset) const;
+    Block* FindTakenBlock(UINT64 offset) const;
+    void InsertTakenBlock(Block* block);
+    void RemoveTakenBlock(Block* block);
+    void ResizeTakenMap(size_t newCapacity);
+
+    D3D12MA_CLASS_NO_COPY(BlockMetadata_TLSF)
+};
+
+/*
+Linear allocation algorithm.
+
+New allocations are always placed after the last one, space of allocations freed in between is not reused
+until everything before or after it is freed too. Allocations live in two vectors sorted by offset:
+
+- 1st vector holds allocations growing up from the beginning of the block.
+- 2nd vector is empty, or holds allocations that wrapped around to the beginning of the block when
+  the block is used as a ring buffer, or allocations growing down from the end of the block when
+  it is used as a double stack.
+
+Freeing the first or the last allocation of a vector takes constant time. Allocations freed from the middle
+are only marked as free and the 1st vector is compacted once they make up most of it.
+*/
+class BlockMetadata_Linear : public BlockMetadata
+{
+public:
+    BlockMetadata_Linear(const ALLOCATION_CALLBACKS* allocationCallbacks, bool isVirtual);
+    virtual ~BlockMetadata_Linear() { }
+    virtual void Init(UINT64 size);
+
+    virtual bool Validate() const;
+    virtual size_t GetAllocationCount() const;
+    virtual UINT64 GetSumFreeSize() const { return m_SumFreeSize; }
+    virtual UINT64 GetUnusedRangeSizeMax() const;
+    virtual bool IsEmpty() const { return GetAllocationCount() == 0; }
+
+    virtual void GetAllocationInfo(UINT64 offset, VIRTUAL_ALLOCATION_INFO& outInfo) const;
+
+    virtual bool CreateAllocationRequest(
+        UINT64 allocSize,
+        UINT64 allocAlignment,
+        bool upperAddress,
+        AllocationRequest* pAllocationRequest);
+
+    virtual void Alloc(
+        const AllocationRequest& request,
+        UINT64 allocSize,
+        void* userData);
+
+    virtual void FreeAtOffset(UINT64 offset);
+    virtual void Clear();
+
+    virtual void SetAllocationUserData(UINT64 offset, void* userData);
+    virtual void AddAllocationsToList(Vector<Suballocation>& inoutList) const;
+
+    virtual void CalcAllocationStatInfo(StatInfo& outInfo) const;
+    virtual void WriteAllocationInfoToJson(JsonWriter& json) const;
+
+private:
+    using SuballocationVectorType = Vector<Suballocation>;
+
+    enum SECOND_VECTOR_MODE
+    {
+        SECOND_VECTOR_EMPTY,
+        // Suballocations in 2nd vector are created later than the ones in 1st, but they all have smaller offsets.
+        SECOND_VECTOR_RING_BUFFER,
+        // Suballocations in 2nd vector are upper side of double stack. They all have offsets higher than those
+        // in 1st vector. Top of this stack means smaller offsets, but higher indices in this vector.
+        SECOND_VECTOR_DOUBLE_STACK,
+    };
+
+    // Where the allocation of a request goes, stored in AllocationRequest::algorithmData.
+    enum ALLOCATION_REQUEST_TYPE
+    {
+        ALLOCATION_REQUEST_UPPER_ADDRESS,
+        ALLOCATION_REQUEST_END_OF_1ST,
+        ALLOCATION_REQUEST_END_OF_2ND,
+    };
+
+    UINT64 m_SumFreeSize;
+    SuballocationVectorType m_Suballocations0, m_Suballocations1;
+    UINT32 m_1stVectorIndex;
+    SECOND_VECTOR_MODE m_2ndVectorMode;
+    // Number of items in 1st vector marked as free at the beginning.
+    size_t m_1stNullItemsBeginCount;
+    // Number of other items in 1st vector marked as free.
+    size_t m_1stNullItemsMiddleCount;
+    // Number of items in 2nd vector marked as free.
+    size_t m_2ndNullItemsCount;
+    ZeroInitializedRange m_ZeroInitializedRange;
+
+    SuballocationVectorType& AccessSuballocations1st() { return m_1stVectorIndex ? m_Suballocations1 : m_Suballocations0; }
+    SuballocationVectorType& AccessSuballocations2nd() { return m_1stVectorIndex ? m_Suballocations0 : m_Suballocations1; }
+    const SuballocationVectorType& AccessSuballocations1st() const { return m_1stVectorIndex ? m_Suballocations1 : m_Suballocations0; }
+    const SuballocationVectorType& AccessSuballocations2nd() const { return m_1stVectorIndex ? m_Suballocations0 : m_Suballocations1; }
+
+    // Returns the allocation at given offset, NULL if there is none.
+    const Suballocation* FindSuballocation(UINT64 offset) const;
+    bool ShouldCompact1st() const;
+    void CleanupAfterFree();
+
+    bool CreateAllocationRequest_LowerAddress(
+        UINT64 allocSize,
+        UINT64 allocAlignment,
+        AllocationRequest* pAllocationRequest);
+    bool CreateAllocationRequest_UpperAddress(
+        UINT64 allocSize,
+        UINT64 allocAlignment,
+        AllocationRequest* pAllocationRequest);
+
+    // Calls func(offset, size, pSuballoc) for every allocation and every free range between them in order of
+    // offsets. pSuballoc is NULL for free ranges.
+    template<typename Func>
+    void EnumerateRanges(Func func) const;
+
+    D3D12MA_CLASS_NO_COPY(BlockMetadata_Linear)
+};
+
 ////////////////////////////////////////////////////////////////////////////////
 // Private class MemoryBlock definition
 
@@ -2760,7 +3055,7 @@ public:
         UINT64 size,
         UINT id);
     virtual ~NormalBlock();
-    HRESULT Init(ID3D12ProtectedResourceSession* pProtectedSession);
+    HRESULT Init(UINT32 algorithm, ID3D12ProtectedResourceSession* pProtectedSession);
 
     BlockVector* GetBlockVector() const { return m_BlockVector; }
 
@@ -2843,6 +3138,7 @@ Synchronized internally with a mutex.
 class BlockVector
 {
     D3D12MA_CLASS_NO_COPY(BlockVector)
+    friend class DefragmentationContextPimpl;
 public:
     BlockVector(
         AllocatorPimpl* hAllocator,
@@ -2853,6 +3149,7 @@ public:
         size_t maxBlockCount,
         bool explicitBlockSize,
         UINT64 minAllocationAlignment,
+        UINT32 algorithm,
         ID3D12ProtectedResourceSession* pProtectedSession);
     ~BlockVector();
 
@@ -2860,6 +3157,7 @@ public:
 
     const D3D12_HEAP_PROPERTIES& GetHeapProperties() const { return m_HeapProps; }
     UINT64 GetPreferredBlockSize() const { return m_PreferredBlockSize; }
+    UINT32 GetAlgorithm() const { return m_Algorithm; }
 
     bool IsEmpty();
 
@@ -2911,6 +3209,7 @@ private:
     const size_t m_MaxBlockCount;
     const bool m_ExplicitBlockSize;
     const UINT64 m_MinAllocationAlignment;
+    const UINT32 m_Algorithm;
     ID3D12ProtectedResourceSession* const m_ProtectedSession;
     /* There can be at most one allocation that is completely empty - a
     hysteresis to avoid pessimistic case of alternating creation and destruction
@@ -2949,6 +3248,59 @@ private:
         size_t* pNewBlockIndex);
 };
 
+////////////////////////////////////////////////////////////////////////////////
+// Private class DefragmentationContextPimpl definition
+
+/*
+Plans the moves of defragmentation passes over one custom pool or all default pools.
+
+Blocks are ordered by the number of bytes in use, descending. Allocations are only moved
+towards the more used blocks, or towards lower offsets within their own block, so every pass makes
+progress and the process ends. Planning only touches BlockMetadata, the heaps are not accessed
+until EndPass frees the places the allocations moved from.
+*/
+class DefragmentationContextPimpl
+{
+    D3D12MA_CLASS_NO_COPY(DefragmentationContextPimpl)
+public:
+    DefragmentationContextPimpl(
+        AllocatorPimpl* hAllocator,
+        const DEFRAGMENTATION_DESC& desc,
+        BlockVector* poolVector);
+    ~DefragmentationContextPimpl();
+
+    void GetStats(DEFRAGMENTATION_STATS& outStats) { outStats = m_GlobalStats; }
+    const ALLOCATION_CALLBACKS& GetAllocs() const;
+
+    HRESULT DefragmentPassBegin(DEFRAGMENTATION_PASS_MOVE_INFO& moveInfo);
+    HRESULT DefragmentPassEnd(DEFRAGMENTATION_PASS_MOVE_INFO& moveInfo);
+
+private:
+    AllocatorPimpl* const m_hAllocator;
+    const UINT64 m_MaxPassBytes;
+    const UINT32 m_MaxPassAllocations;
+    const UINT32 m_Algorithm;
+
+    Vector<BlockVector*> m_BlockVectors;
+    Vector<DEFRAGMENTATION_MOVE> m_Moves;
+    // Scratch data of ComputeMoves, kept to reuse the memory between passes.
+    Vector<NormalBlock*> m_SortedBlocks;
+    // Allocations that existed when the pass began, grouped by block in the order of m_SortedBlocks.
+    Vector<Suballocation> m_Candidates;
+    Vector<size_t> m_BlockCandidateEnds;
+
+    DEFRAGMENTATION_STATS m_PassStats;
+    DEFRAGMENTATION_STATS m_GlobalStats;
+
+    // Plans moves in given block vector. Returns false once a limit of the pass was reached.
+    bool ComputeMoves(BlockVector& blockVector);
+    // Tries to reserve the new place for given allocation in the block, at an offset lower than maxOffset.
+    // Returns the temporary allocation holding it, NULL if there is no such place.
+    Allocation* AllocateMoveDestination(BlockVector& blockVector, NormalBlock* block, const Allocation* src, UINT64 maxOffset);
+    // Deletes the empty blocks the pass left behind, except those needed for the minimum block count.
+    void FreeEmptyBlocks(BlockVector& blockVector);
+};
+
 ////////////////////////////////////////////////////////////////////////////////
 // Private class AllocatorPimpl definition
 
@@ -3145,6 +3497,7 @@ public:
 private:
     friend class Allocator;
     friend class Pool;
+    friend class DefragmentationContextPimpl;
 
     /*
     Heuristics that decides whether a resource should better be placed in its own,
@@ -3266,6 +3619,16 @@ BlockMetadata::BlockMetadata(const ALLOCATION_CALLBACKS* allocationCallbacks, bo
     D3D12MA_ASSERT(allocationCallbacks);
 }
 
+UINT BlockMetadata::CalcFragmentationPercent() const
+{
+    const UINT64 sumFreeSize = GetSumFreeSize();
+    if(sumFreeSize == 0)
+    {
+        return 0;
+    }
+    return (UINT)((sumFreeSize - GetUnusedRangeSizeMax()) * 100 / sumFreeSize);
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // Private class BlockMetadata_Generic implementation
 
@@ -3416,9 +3779,11 @@ void BlockMetadata_Generic::GetAllocationInfo(UINT64 offset, VIRTUAL_ALLOCATION_
 bool BlockMetadata_Generic::CreateAllocationRequest(
     UINT64 allocSize,
     UINT64 allocAlignment,
+    bool upperAddress,
     AllocationRequest* pAllocationRequest)
 {
     D3D12MA_ASSERT(allocSize > 0);
+    D3D12MA_ASSERT(!upperAddress && "ALLOCATION_FLAG_UPPER_ADDRESS can be used only with linear algorithm.");
     D3D12MA_ASSERT(pAllocationRequest != NULL);
     D3D12MA_HEAVY_ASSERT(Validate());
 
@@ -3780,6 +4145,17 @@ void BlockMetadata_Generic::SetAllocationUserData(UINT64 offset, void* userData)
     suballoc.userData = userData;
 }
 
+void BlockMetadata_Generic::AddAllocationsToList(Vector<Suballocation>& inoutList) const
+{
+    for(const auto& suballoc : m_Suballocations)
+    {
+        if(suballoc.type != SUBALLOCATION_TYPE_FREE)
+        {
+            inoutList.push_back(suballoc);
+        }
+    }
+}
+
 void BlockMetadata_Generic::CalcAllocationStatInfo(StatInfo& outInfo) const
 {
     outInfo.BlockCount = 1;
@@ -3822,6 +4198,8 @@ void BlockMetadata_Generic::WriteAllocationInfoToJson(JsonWriter& json) const
     json.WriteNumber(GetAllocationCount());
     json.WriteString(L"UnusedRanges");
     json.WriteNumber(m_FreeCount);
+    json.WriteString(L"Fragmentation");
+    json.WriteNumber(CalcFragmentationPercent());
     json.WriteString(L"Suballocations");
     json.BeginArray();
     for(const auto& suballoc : m_Suballocations)
@@ -3861,88 +4239,1533 @@ void BlockMetadata_Generic::WriteAllocationInfoToJson(JsonWriter& json) const
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-// Private class NormalBlock implementation
+// Private class BlockMetadata_TLSF implementation
 
-NormalBlock::NormalBlock(
-    AllocatorPimpl* allocator,
-    BlockVector* blockVector,
-    const D3D12_HEAP_PROPERTIES& heapProps,
-    D3D12_HEAP_FLAGS heapFlags,
-    UINT64 size,
-    UINT id) :
-    MemoryBlock(allocator, heapProps, heapFlags, size, id),
-    m_pMetadata(NULL),
-    m_BlockVector(blockVector)
+BlockMetadata_TLSF::BlockMetadata_TLSF(const ALLOCATION_CALLBACKS* allocationCallbacks, bool isVirtual) :
+    BlockMetadata(allocationCallbacks, isVirtual),
+    m_AllocCount(0),
+    m_FreeCount(0),
+    m_SumFreeSize(0),
+    m_IsFreeBitmap(0),
+    m_ListsCount(0),
+    m_FreeList(NULL),
+    m_FirstBlock(NULL),
+    m_BlockAllocator(*allocationCallbacks, 128),
+    m_TakenBlocks(NULL),
+    m_TakenCapacity(0)
 {
+    D3D12MA_ASSERT(allocationCallbacks);
+    ZeroMemory(m_InnerIsFreeBitmap, sizeof(m_InnerIsFreeBitmap));
 }
 
-NormalBlock::~NormalBlock()
+BlockMetadata_TLSF::~BlockMetadata_TLSF()
 {
-    if(m_pMetadata != NULL)
-    {
-        // THIS IS THE MOST IMPORTANT ASSERT IN THE ENTIRE LIBRARY!
-        // Hitting it means you have some memory leak - unreleased Allocation objects.
-        D3D12MA_ASSERT(m_pMetadata->IsEmpty() && "Some allocations were not freed before destruction of this memory block!");
-
-        D3D12MA_DELETE(m_Allocator->GetAllocs(), m_pMetadata);
-    }
+    D3D12MA_DELETE_ARRAY(*GetAllocs(), m_FreeList, m_ListsCount);
+    D3D12MA_DELETE_ARRAY(*GetAllocs(), m_TakenBlocks, m_TakenCapacity);
 }
 
-HRESULT NormalBlock::Init(ID3D12ProtectedResourceSession* pProtectedSession)
+void BlockMetadata_TLSF::Init(UINT64 size)
 {
-    HRESULT hr = MemoryBlock::Init(pProtectedSession);
-    if(FAILED(hr))
-    {
-        return hr;
-    }
+    BlockMetadata::Init(size);
+    D3D12MA_ASSERT(size > 0);
 
-    m_pMetadata = D3D12MA_NEW(m_Allocator->GetAllocs(), BlockMetadata_Generic)(&m_Allocator->GetAllocs(), false);
-    m_pMetadata->Init(m_Size);
+    // Free ranges can't be bigger than the block, so there are no lists past the one of its size.
+    m_ListsCount = GetListIndex(size) + 1;
+    m_FreeList = D3D12MA_NEW_ARRAY(*GetAllocs(), Block*, m_ListsCount);
+    ZeroMemory(m_FreeList, m_ListsCount * sizeof(Block*));
 
-    return hr;
+    ResizeTakenMap(MIN_TAKEN_MAP_CAPACITY);
+
+    m_FirstBlock = m_BlockAllocator.Alloc();
+    Clear();
 }
 
-bool NormalBlock::Validate() const
+bool BlockMetadata_TLSF::Validate() const
 {
-    D3D12MA_VALIDATE(GetHeap() &&
-        m_pMetadata &&
-        m_pMetadata->GetSize() != 0 &&
-        m_pMetadata->GetSize() == GetSize());
-    return m_pMetadata->Validate();
-}
+    D3D12MA_VALIDATE(m_FirstBlock != NULL);
+    D3D12MA_VALIDATE(m_FirstBlock->prevPhysical == NULL);
 
-////////////////////////////////////////////////////////////////////////////////
-// Private class MemoryBlock definition
+    UINT64 calculatedOffset = 0;
+    UINT64 calculatedSumFreeSize = 0;
+    size_t calculatedAllocCount = 0;
+    UINT calculatedFreeCount = 0;
+    bool prevFree = false;
 
-MemoryBlock::MemoryBlock(
-    AllocatorPimpl* allocator,
-    const D3D12_HEAP_PROPERTIES& heapProps,
-    D3D12_HEAP_FLAGS heapFlags,
-    UINT64 size,
-    UINT id) :
-    m_Allocator(allocator),
-    m_HeapProps(heapProps),
-    m_HeapFlags(heapFlags),
-    m_Size(size),
-    m_Id(id)
-{
+    for(const Block* block = m_FirstBlock; block != NULL; block = block->nextPhysical)
+    {
+        D3D12MA_VALIDATE(block->offset == calculatedOffset);
+        D3D12MA_VALIDATE(block->size > 0);
+        D3D12MA_VALIDATE(block->nextPhysical == NULL || block->nextPhysical->prevPhysical == block);
+
+        if(block->isFree)
+        {
+            // Two adjacent free blocks are invalid. They should be merged.
+            D3D12MA_VALIDATE(!prevFree);
+            // Margin required between allocations - every free space must be at least that large.
+            D3D12MA_VALIDATE(block->size >= D3D12MA_DEBUG_MARGIN);
+
+            // Free block must be in the list of its size.
+            const Block* freeBlock = m_FreeList[GetListIndex(block->size)];
+            while(freeBlock != NULL && freeBlock != block)
+            {
+                freeBlock = freeBlock->nextFree;
+            }
+            D3D12MA_VALIDATE(freeBlock == block);
+
+            calculatedSumFreeSize += block->size;
+            ++calculatedFreeCount;
+        }
+        else
+        {
+            D3D12MA_VALIDATE(FindTakenBlock(block->offset) == block);
+            if(!IsVirtual())
+            {
+                const Allocation* const alloc = (Allocation*)block->userData;
+                D3D12MA_VALIDATE(alloc != NULL);
+                D3D12MA_VALIDATE(alloc->GetOffset() == block->offset);
+                D3D12MA_VALIDATE(alloc->GetSize() == block->size);
+            }
+
+            // Margin required between allocations - previous allocation must be free.
+            D3D12MA_VALIDATE(D3D12MA_DEBUG_MARGIN == 0 || prevFree);
+
+            ++calculatedAllocCount;
+        }
+
+        calculatedOffset += block->size;
+        prevFree = block->isFree;
+    }
+
+    // Bitmaps must match the lists that actually hold blocks.
+    for(UINT32 listIndex = 0; listIndex < m_ListsCount; ++listIndex)
+    {
+        const UINT8 memoryClass = (UINT8)(listIndex / SECOND_LEVEL_COUNT);
+        const UINT32 secondIndex = listIndex % SECOND_LEVEL_COUNT;
+        const bool listUsed = (m_InnerIsFreeBitmap[memoryClass] & (1u << secondIndex)) != 0;
+        D3D12MA_VALIDATE(listUsed == (m_FreeList[listIndex] != NULL));
+        D3D12MA_VALIDATE(!listUsed || (m_IsFreeBitmap & (1ull << memoryClass)) != 0);
+        D3D12MA_VALIDATE(!listUsed || m_FreeList[listIndex]->prevFree == NULL);
+    }
+
+    D3D12MA_VALIDATE(calculatedOffset == GetSize());
+    D3D12MA_VALIDATE(calculatedSumFreeSize == m_SumFreeSize);
+    D3D12MA_VALIDATE(calculatedAllocCount == m_AllocCount);
+    D3D12MA_VALIDATE(calculatedFreeCount == m_FreeCount);
+    D3D12MA_VALIDATE(m_AllocCount * 2 <= m_TakenCapacity);
+
+    return true;
 }
 
-MemoryBlock::~MemoryBlock()
+UINT64 BlockMetadata_TLSF::GetUnusedRangeSizeMax() const
 {
-    if(m_Heap)
+    if(m_IsFreeBitmap == 0)
     {
-        m_Allocator->m_Budget.m_BlockBytes[HeapTypeToIndex(m_HeapProps.Type)] -= m_Size;
-        m_Heap->Release();
+        return 0;
+    }
+
+    // Biggest free range is somewhere in the highest non-empty list.
+    const UINT8 memoryClass = BitScanMSB(m_IsFreeBitmap);
+    const UINT32 listIndex = GetListIndex(memoryClass, BitScanMSB(m_InnerIsFreeBitmap[memoryClass]));
+
+    UINT64 result = 0;
+    for(const Block* block = m_FreeList[listIndex]; block != NULL; block = block->nextFree)
+    {
+        result = D3D12MA_MAX(result, block->size);
     }
+    return result;
 }
 
-HRESULT MemoryBlock::Init(ID3D12ProtectedResourceSession* pProtectedSession)
+void BlockMetadata_TLSF::GetAllocationInfo(UINT64 offset, VIRTUAL_ALLOCATION_INFO& outInfo) const
 {
-    D3D12MA_ASSERT(m_Heap == NULL && m_Size > 0);
+    const Block* const block = FindTakenBlock(offset);
+    D3D12MA_ASSERT(block && "Not found!");
+    outInfo.size = block->size;
+    outInfo.pUserData = block->userData;
+}
 
-    D3D12_HEAP_DESC heapDesc = {};
-    heapDesc.SizeInBytes = m_Size;
+bool BlockMetadata_TLSF::CreateAllocationRequest(
+    UINT64 allocSize,
+    UINT64 allocAlignment,
+    bool upperAddress,
+    AllocationRequest* pAllocationRequest)
+{
+    D3D12MA_ASSERT(allocSize > 0);
+    D3D12MA_ASSERT(!upperAddress && "ALLOCATION_FLAG_UPPER_ADDRESS can be used only with linear algorithm.");
+    D3D12MA_ASSERT(pAllocationRequest != NULL);
+    D3D12MA_HEAVY_ASSERT(Validate());
+
+    const UINT64 requiredSize = allocSize + 2 * D3D12MA_DEBUG_MARGIN;
+
+    // There is not enough total free space in this block to fullfill the request: Early return.
+    if(m_SumFreeSize < requiredSize)
+    {
+        return false;
+    }
+
+    // Every block in the lists after the one requiredSize falls into is big enough,
+    // so the first one found fits unless alignment padding gets in the way.
+    const UINT32 listIndex = GetListIndex(requiredSize);
+    UINT64 offset = 0;
+    Block* block = NULL;
+    Block* listHead = FindFreeBlock(listIndex + 1);
+    if(listHead != NULL && CheckBlock(*listHead, allocSize, allocAlignment, &offset))
+    {
+        block = listHead;
+    }
+
+    // Blocks in the lists after the one of requiredSize plus the worst case padding fit with any alignment,
+    // take the first of them rather than walking lists of blocks the padding doesn't fit into.
+    if(block == NULL && listHead != NULL)
+    {
+        block = FindFreeBlock(GetListIndex(requiredSize + allocAlignment - 1) + 1);
+        if(block != NULL)
+        {
+            const bool fits = CheckBlock(*block, allocSize, allocAlignment, &offset);
+            D3D12MA_ASSERT(fits);
+            (void)fits;
+        }
+    }
+
+    // Close to full, check remaining blocks one by one.
+    while(block == NULL && listHead != NULL)
+    {
+        for(Block* candidate = listHead; candidate != NULL; candidate = candidate->nextFree)
+        {
+            if(CheckBlock(*candidate, allocSize, allocAlignment, &offset))
+            {
+                block = candidate;
+                break;
+            }
+        }
+        if(block == NULL)
+        {
+            listHead = FindFreeBlock(GetListIndex(listHead->size) + 1);
+        }
+    }
+
+    // Blocks in the list of requiredSize itself may be smaller than it, check them one by one.
+    if(block == NULL && listIndex < m_ListsCount)
+    {
+        for(block = m_FreeList[listIndex]; block != NULL; block = block->nextFree)
+        {
+            if(CheckBlock(*block, allocSize, allocAlignment, &offset))
+            {
+                break;
+            }
+        }
+    }
+
+    if(block == NULL)
+    {
+        return false;
+    }
+
+    pAllocationRequest->offset = offset;
+    pAllocationRequest->sumFreeSize = block->size;
+    pAllocationRequest->sumItemSize = 0;
+    pAllocationRequest->algorithmData = block;
+    pAllocationRequest->zeroInitialized = m_ZeroInitializedRange.IsRangeZeroInitialized(offset, offset + allocSize);
+    return true;
+}
+
+void BlockMetadata_TLSF::Alloc(
+    const AllocationRequest& request,
+    UINT64 allocSize,
+    void* userData)
+{
+    Block* block = (Block*)request.algorithmData;
+    D3D12MA_ASSERT(block != NULL && block->isFree);
+    // Given offset is inside this block.
+    D3D12MA_ASSERT(request.offset >= block->offset);
+    const UINT64 paddingBegin = request.offset - block->offset;
+    D3D12MA_ASSERT(block->size >= paddingBegin + allocSize);
+    const UINT64 paddingEnd = block->size - paddingBegin - allocSize;
+
+    RemoveFreeBlock(block);
+
+    // If there are any free bytes remaining at the beginning, they stay free in the lower block.
+    if(paddingBegin)
+    {
+        Block* const taken = SplitBlock(block, paddingBegin);
+        InsertFreeBlock(block);
+        block = taken;
+    }
+
+    // If there are any free bytes remaining at the end, they become a new free block.
+    if(paddingEnd)
+    {
+        InsertFreeBlock(SplitBlock(block, allocSize));
+    }
+
+    block->isFree = false;
+    block->userData = userData;
+    InsertTakenBlock(block);
+
+    ++m_AllocCount;
+    m_SumFreeSize -= allocSize;
+
+    m_ZeroInitializedRange.MarkRangeAsUsed(request.offset, request.offset + allocSize);
+}
+
+void BlockMetadata_TLSF::FreeAtOffset(UINT64 offset)
+{
+    Block* block = FindTakenBlock(offset);
+    D3D12MA_ASSERT(block && "Not found!");
+
+    RemoveTakenBlock(block);
+    block->userData = NULL;
+
+    --m_AllocCount;
+    m_SumFreeSize += block->size;
+
+    // Merge with next and/or previous block if it's also free.
+    Block* const nextBlock = block->nextPhysical;
+    if(nextBlock != NULL && nextBlock->isFree)
+    {
+        RemoveFreeBlock(nextBlock);
+        MergeWithNext(block);
+    }
+
+    Block* const prevBlock = block->prevPhysical;
+    if(prevBlock != NULL && prevBlock->isFree)
+    {
+        RemoveFreeBlock(prevBlock);
+        MergeWithNext(prevBlock);
+        block = prevBlock;
+    }
+
+    InsertFreeBlock(block);
+}
+
+void BlockMetadata_TLSF::Clear()
+{
+    for(Block* block = m_FirstBlock->nextPhysical; block != NULL; )
+    {
+        Block* const nextBlock = block->nextPhysical;
+        m_BlockAllocator.Free(block);
+        block = nextBlock;
+    }
+
+    m_AllocCount = 0;
+    m_FreeCount = 0;
+    m_SumFreeSize = 0;
+    m_IsFreeBitmap = 0;
+    ZeroMemory(m_InnerIsFreeBitmap, sizeof(m_InnerIsFreeBitmap));
+    ZeroMemory(m_FreeList, m_ListsCount * sizeof(Block*));
+    ZeroMemory(m_TakenBlocks, m_TakenCapacity * sizeof(Block*));
+    m_ZeroInitializedRange.Reset(GetSize());
+
+    ZeroMemory(m_FirstBlock, sizeof(Block));
+    m_FirstBlock->size = GetSize();
+    InsertFreeBlock(m_FirstBlock);
+    m_SumFreeSize = GetSize();
+}
+
+void BlockMetadata_TLSF::SetAllocationUserData(UINT64 offset, void* userData)
+{
+    Block* const block = FindTakenBlock(offset);
+    D3D12MA_ASSERT(block && "Not found!");
+    block->userData = userData;
+}
+
+void BlockMetadata_TLSF::AddAllocationsToList(Vector<Suballocation>& inoutList) const
+{
+    for(const Block* block = m_FirstBlock; block != NULL; block = block->nextPhysical)
+    {
+        if(!block->isFree)
+        {
+            const Suballocation suballoc = { block->offset, block->size, block->userData, SUBALLOCATION_TYPE_ALLOCATION };
+            inoutList.push_back(suballoc);
+        }
+    }
+}
+
+void BlockMetadata_TLSF::CalcAllocationStatInfo(StatInfo& outInfo) const
+{
+    outInfo.BlockCount = 1;
+
+    outInfo.AllocationCount = (UINT)m_AllocCount;
+    outInfo.UnusedRangeCount = m_FreeCount;
+
+    outInfo.UsedBytes = GetSize() - m_SumFreeSize;
+    outInfo.UnusedBytes = m_SumFreeSize;
+
+    outInfo.AllocationSizeMin = UINT64_MAX;
+    outInfo.AllocationSizeMax = 0;
+    outInfo.UnusedRangeSizeMin = UINT64_MAX;
+    outInfo.UnusedRangeSizeMax = 0;
+
+    for(const Block* block = m_FirstBlock; block != NULL; block = block->nextPhysical)
+    {
+        if(block->isFree)
+        {
+            outInfo.UnusedRangeSizeMin = D3D12MA_MIN(block->size, outInfo.UnusedRangeSizeMin);
+            outInfo.UnusedRangeSizeMax = D3D12MA_MAX(block->size, outInfo.UnusedRangeSizeMax);
+        }
+        else
+        {
+            outInfo.AllocationSizeMin = D3D12MA_MIN(block->size, outInfo.AllocationSizeMin);
+            outInfo.AllocationSizeMax = D3D12MA_MAX(block->size, outInfo.AllocationSizeMax);
+        }
+    }
+}
+
+void BlockMetadata_TLSF::WriteAllocationInfoToJson(JsonWriter& json) const
+{
+    json.BeginObject();
+    json.WriteString(L"Algorithm");
+    json.WriteString(L"TLSF");
+    json.WriteString(L"TotalBytes");
+    json.WriteNumber(GetSize());
+    json.WriteString(L"UnusuedBytes");
+    json.WriteNumber(GetSumFreeSize());
+    json.WriteString(L"Allocations");
+    json.WriteNumber(GetAllocationCount());
+    json.WriteString(L"UnusedRanges");
+    json.WriteNumber(m_FreeCount);
+    json.WriteString(L"Fragmentation");
+    json.WriteNumber(CalcFragmentationPercent());
+    json.WriteString(L"Suballocations");
+    json.BeginArray();
+    for(const Block* block = m_FirstBlock; block != NULL; block = block->nextPhysical)
+    {
+        json.BeginObject(true);
+        json.WriteString(L"Offset");
+        json.WriteNumber(block->offset);
+        if(block->isFree)
+        {
+            json.WriteString(L"Type");
+            json.WriteString(L"FREE");
+            json.WriteString(L"Size");
+            json.WriteNumber(block->size);
+        }
+        else if(IsVirtual())
+        {
+            json.WriteString(L"Type");
+            json.WriteString(L"ALLOCATION");
+            json.WriteString(L"Size");
+            json.WriteNumber(block->size);
+            if(block->userData)
+            {
+                json.WriteString(L"UserData");
+                json.WriteNumber((uintptr_t)block->userData);
+            }
+        }
+        else
+        {
+            const Allocation* const alloc = (const Allocation*)block->userData;
+            D3D12MA_ASSERT(alloc);
+            json.AddAllocationToObject(*alloc);
+        }
+        json.EndObject();
+    }
+    json.EndArray();
+    json.EndObject();
+}
+
+UINT8 BlockMetadata_TLSF::SizeToMemoryClass(UINT64 size)
+{
+    if(size >= SMALL_BUFFER_SIZE)
+    {
+        return (UINT8)(BitScanMSB(size) - MEMORY_CLASS_SHIFT);
+    }
+    return 0;
+}
+
+UINT32 BlockMetadata_TLSF::SizeToSecondIndex(UINT64 size, UINT8 memoryClass)
+{
+    if(memoryClass == 0)
+    {
+        return (UINT32)(size / (SMALL_BUFFER_SIZE / SECOND_LEVEL_COUNT));
+    }
+    // Bits right below the highest one pick the list inside the power of two.
+    return (UINT32)(size >> (memoryClass + MEMORY_CLASS_SHIFT - SECOND_LEVEL_INDEX)) ^ SECOND_LEVEL_COUNT;
+}
+
+UINT32 BlockMetadata_TLSF::GetListIndex(UINT8 memoryClass, UINT32 secondIndex)
+{
+    return memoryClass * SECOND_LEVEL_COUNT + secondIndex;
+}
+
+UINT32 BlockMetadata_TLSF::GetListIndex(UINT64 size)
+{
+    const UINT8 memoryClass = SizeToMemoryClass(size);
+    return GetListIndex(memoryClass, SizeToSecondIndex(size, memoryClass));
+}
+
+void BlockMetadata_TLSF::InsertFreeBlock(Block* block)
+{
+    D3D12MA_ASSERT(block->size > 0);
+
+    const UINT8 memoryClass = SizeToMemoryClass(block->size);
+    const UINT32 secondIndex = SizeToSecondIndex(block->size, memoryClass);
+    const UINT32 listIndex = GetListIndex(memoryClass, secondIndex);
+    D3D12MA_ASSERT(listIndex < m_ListsCount);
+
+    block->isFree = true;
+    block->userData = NULL;
+    block->prevFree = NULL;
+    block->nextFree = m_FreeList[listIndex];
+    if(block->nextFree != NULL)
+    {
+        block->nextFree->prevFree = block;
+    }
+    else
+    {
+        m_InnerIsFreeBitmap[memoryClass] |= 1u << secondIndex;
+        m_IsFreeBitmap |= 1ull << memoryClass;
+    }
+    m_FreeList[listIndex] = block;
+    ++m_FreeCount;
+}
+
+void BlockMetadata_TLSF::RemoveFreeBlock(Block* block)
+{
+    D3D12MA_ASSERT(block->isFree);
+
+    if(block->nextFree != NULL)
+    {
+        block->nextFree->prevFree = block->prevFree;
+    }
+    if(block->prevFree != NULL)
+    {
+        block->prevFree->nextFree = block->nextFree;
+    }
+    else
+    {
+        const UINT8 memoryClass = SizeToMemoryClass(block->size);
+        const UINT32 secondIndex = SizeToSecondIndex(block->size, memoryClass);
+        const UINT32 listIndex = GetListIndex(memoryClass, secondIndex);
+        D3D12MA_ASSERT(m_FreeList[listIndex] == block);
+
+        m_FreeList[listIndex] = block->nextFree;
+        if(block->nextFree == NULL)
+        {
+            m_InnerIsFreeBitmap[memoryClass] &= ~(1u << secondIndex);
+            if(m_InnerIsFreeBitmap[memoryClass] == 0)
+            {
+                m_IsFreeBitmap &= ~(1ull << memoryClass);
+            }
+        }
+    }
+
+    block->isFree = false;
+    block->prevFree = NULL;
+    block->nextFree = NULL;
+    --m_FreeCount;
+}
+
+BlockMetadata_TLSF::Block* BlockMetadata_TLSF::FindFreeBlock(UINT32 listIndex) const
+{
+    if(listIndex >= m_ListsCount)
+    {
+        return NULL;
+    }
+
+    UINT8 memoryClass = (UINT8)(listIndex / SECOND_LEVEL_COUNT);
+    UINT32 innerFreeMap = m_InnerIsFreeBitmap[memoryClass] & (~0u << (listIndex % SECOND_LEVEL_COUNT));
+    if(innerFreeMap == 0)
+    {
+        // Check higher memory classes for available blocks.
+        const UINT64 freeMap = m_IsFreeBitmap & (~0ull << (memoryClass + 1));
+        if(freeMap == 0)
+        {
+            return NULL;
+        }
+        memoryClass = BitScanLSB(freeMap);
+        innerFreeMap = m_InnerIsFreeBitmap[memoryClass];
+        D3D12MA_ASSERT(innerFreeMap != 0);
+    }
+
+    return m_FreeList[GetListIndex(memoryClass, BitScanLSB(innerFreeMap))];
+}
+
+bool BlockMetadata_TLSF::CheckBlock(const Block& block, UINT64 allocSize, UINT64 allocAlignment, UINT64* pOffset) const
+{
+    D3D12MA_ASSERT(block.isFree);
+
+    // Size of this block is too small for this request: Early return.
+    if(block.size < allocSize + 2 * D3D12MA_DEBUG_MARGIN)
+    {
+        return false;
+    }
+
+    // Apply D3D12MA_DEBUG_MARGIN at the beginning, then alignment.
+    const UINT64 offset = AlignUp(block.offset + D3D12MA_DEBUG_MARGIN, allocAlignment);
+
+    // Fail if requested size plus margin after it doesn't fit in the rest of the block.
+    if(offset + allocSize + D3D12MA_DEBUG_MARGIN > block.offset + block.size)
+    {
+        return false;
+    }
+
+    *pOffset = offset;
+    return true;
+}
+
+BlockMetadata_TLSF::Block* BlockMetadata_TLSF::SplitBlock(Block* block, UINT64 lowerSize)
+{
+    D3D12MA_ASSERT(lowerSize > 0 && lowerSize < block->size);
+
+    Block* const upperBlock = m_BlockAllocator.Alloc();
+    ZeroMemory(upperBlock, sizeof(Block));
+    upperBlock->offset = block->offset + lowerSize;
+    upperBlock->size = block->size - lowerSize;
+    upperBlock->prevPhysical = block;
+    upperBlock->nextPhysical = block->nextPhysical;
+    if(block->nextPhysical != NULL)
+    {
+        block->nextPhysical->prevPhysical = upperBlock;
+    }
+    block->nextPhysical = upperBlock;
+    block->size = lowerSize;
+    return upperBlock;
+}
+
+void BlockMetadata_TLSF::MergeWithNext(Block* block)
+{
+    Block* const nextBlock = block->nextPhysical;
+    D3D12MA_ASSERT(nextBlock != NULL && !nextBlock->isFree);
+
+    block->size += nextBlock->size;
+    block->nextPhysical = nextBlock->nextPhysical;
+    if(nextBlock->nextPhysical != NULL)
+    {
+        nextBlock->nextPhysical->prevPhysical = block;
+    }
+    m_BlockAllocator.Free(nextBlock);
+}
+
+size_t BlockMetadata_TLSF::HashOffset(UINT64 offset) const
+{
+    // Offsets are mostly multiples of big alignments, so mix the bits before masking.
+    return (size_t)((offset * 0x9E3779B97F4A7C15ull) >> 32) & (m_TakenCapacity - 1);
+}
+
+size_t BlockMetadata_TLSF::FindTakenSlot(UINT64 offset) const
+{
+    size_t slot = HashOffset(offset);
+    while(m_TakenBlocks[slot] != NULL && m_TakenBlocks[slot]->offset != offset)
+    {
+        slot = (slot + 1) & (m_TakenCapacity - 1);
+    }
+    return slot;
+}
+
+BlockMetadata_TLSF::Block* BlockMetadata_TLSF::FindTakenBlock(UINT64 offset) const
+{
+    return m_TakenBlocks[FindTakenSlot(offset)];
+}
+
+void BlockMetadata_TLSF::InsertTakenBlock(Block* block)
+{
+    if((m_AllocCount + 1) * 2 > m_TakenCapacity)
+    {
+        ResizeTakenMap(m_TakenCapacity * 2);
+    }
+
+    const size_t slot = FindTakenSlot(block->offset);
+    D3D12MA_ASSERT(m_TakenBlocks[slot] == NULL);
+    m_TakenBlocks[slot] = block;
+}
+
+void BlockMetadata_TLSF::RemoveTakenBlock(Block* block)
+{
+    size_t hole = FindTakenSlot(block->offset);
+    D3D12MA_ASSERT(m_TakenBlocks[hole] == block);
+
+    // Backward shift deletion: move later entries of the probe sequence into the hole so lookups
+    // never stop early at it.
+    const size_t mask = m_TakenCapacity - 1;
+    for(size_t slot = (hole + 1) & mask; m_TakenBlocks[slot] != NULL; slot = (slot + 1) & mask)
+    {
+        const size_t home = HashOffset(m_TakenBlocks[slot]->offset);
+        if(((slot - home) & mask) >= ((slot - hole) & mask))
+        {
+            m_TakenBlocks[hole] = m_TakenBlocks[slot];
+            hole = slot;
+        }
+    }
+    m_TakenBlocks[hole] = NULL;
+}
+
+void BlockMetadata_TLSF::ResizeTakenMap(size_t newCapacity)
+{
+    D3D12MA_ASSERT(IsPow2(newCapacity) && newCapacity >= MIN_TAKEN_MAP_CAPACITY);
+
+    Block** const oldBlocks = m_TakenBlocks;
+    const size_t oldCapacity = m_TakenCapacity;
+
+    m_TakenBlocks = D3D12MA_NEW_ARRAY(*GetAllocs(), Block*, newCapacity);
+    ZeroMemory(m_TakenBlocks, newCapacity * sizeof(Block*));
+    m_TakenCapacity = newCapacity;
+
+    for(size_t i = 0; i < oldCapacity; ++i)
+    {
+        if(oldBlocks[i] != NULL)
+        {
+            m_TakenBlocks[FindTakenSlot(oldBlocks[i]->offset)] = oldBlocks[i];
+        }
+    }
+    D3D12MA_DELETE_ARRAY(*GetAllocs(), oldBlocks, oldCapacity);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Private class BlockMetadata_Linear implementation
+
+BlockMetadata_Linear::BlockMetadata_Linear(const ALLOCATION_CALLBACKS* allocationCallbacks, bool isVirtual) :
+    BlockMetadata(allocationCallbacks, isVirtual),
+    m_SumFreeSize(0),
+    m_Suballocations0(*allocationCallbacks),
+    m_Suballocations1(*allocationCallbacks),
+    m_1stVectorIndex(0),
+    m_2ndVectorMode(SECOND_VECTOR_EMPTY),
+    m_1stNullItemsBeginCount(0),
+    m_1stNullItemsMiddleCount(0),
+    m_2ndNullItemsCount(0)
+{
+    D3D12MA_ASSERT(allocationCallbacks);
+}
+
+void BlockMetadata_Linear::Init(UINT64 size)
+{
+    BlockMetadata::Init(size);
+    m_SumFreeSize = size;
+    m_ZeroInitializedRange.Reset(size);
+}
+
+template<typename Func>
+void BlockMetadata_Linear::EnumerateRanges(Func func) const
+{
+    const SuballocationVectorType& suballocations1st = AccessSuballocations1st();
+    const SuballocationVectorType& suballocations2nd = AccessSuballocations2nd();
+
+    UINT64 lastOffset = 0;
+    // Reports the free range before given suballocation, if any, then the suballocation itself.
+    auto visit = [&](const Suballocation& suballoc)
+    {
+        if(suballoc.type == SUBALLOCATION_TYPE_FREE)
+        {
+            return;
+        }
+        if(suballoc.offset > lastOffset)
+        {
+            func(lastOffset, suballoc.offset - lastOffset, (const Suballocation*)NULL);
+        }
+        func(suballoc.offset, suballoc.size, &suballoc);
+        lastOffset = suballoc.offset + suballoc.size;
+    };
+
+    if(m_2ndVectorMode == SECOND_VECTOR_RING_BUFFER)
+    {
+        for(size_t i = 0; i < suballocations2nd.size(); ++i)
+        {
+            visit(suballocations2nd[i]);
+        }
+    }
+    for(size_t i = m_1stNullItemsBeginCount; i < suballocations1st.size(); ++i)
+    {
+        visit(suballocations1st[i]);
+    }
+    if(m_2ndVectorMode == SECOND_VECTOR_DOUBLE_STACK)
+    {
+        for(size_t i = suballocations2nd.size(); i--; )
+        {
+            visit(suballocations2nd[i]);
+        }
+    }
+
+    if(lastOffset < GetSize())
+    {
+        func(lastOffset, GetSize() - lastOffset, (const Suballocation*)NULL);
+    }
+}
+
+bool BlockMetadata_Linear::Validate() const
+{
+    const SuballocationVectorType& suballocations1st = AccessSuballocations1st();
+    const SuballocationVectorType& suballocations2nd = AccessSuballocations2nd();
+
+    D3D12MA_VALIDATE(suballocations2nd.empty() == (m_2ndVectorMode == SECOND_VECTOR_EMPTY));
+    D3D12MA_VALIDATE(!suballocations1st.empty() || m_2ndVectorMode != SECOND_VECTOR_RING_BUFFER);
+    D3D12MA_VALIDATE(m_1stNullItemsBeginCount + m_1stNullItemsMiddleCount <= suballocations1st.size());
+    D3D12MA_VALIDATE(m_2ndNullItemsCount <= suballocations2nd.size());
+
+    if(!suballocations1st.empty())
+    {
+        // Null item at the beginning should be accounted into m_1stNullItemsBeginCount.
+        D3D12MA_VALIDATE(m_1stNullItemsBeginCount < suballocations1st.size());
+        D3D12MA_VALIDATE(suballocations1st[m_1stNullItemsBeginCount].type != SUBALLOCATION_TYPE_FREE);
+        // Null item at the end should be just pop_back().
+        D3D12MA_VALIDATE(suballocations1st.back().type != SUBALLOCATION_TYPE_FREE);
+    }
+    if(!suballocations2nd.empty())
+    {
+        // Null item at the end should be just pop_back().
+        D3D12MA_VALIDATE(suballocations2nd.back().type != SUBALLOCATION_TYPE_FREE);
+    }
+
+    for(size_t i = 0; i < m_1stNullItemsBeginCount; ++i)
+    {
+        D3D12MA_VALIDATE(suballocations1st[i].type == SUBALLOCATION_TYPE_FREE);
+        D3D12MA_VALIDATE(suballocations1st[i].userData == NULL);
+    }
+
+    // Walk all items in order of offsets, the same way EnumerateRanges does.
+    UINT64 offset = 0;
+    UINT64 sumUsedSize = 0;
+    size_t nullItem1stCount = m_1stNullItemsBeginCount;
+    size_t nullItem2ndCount = 0;
+
+    if(m_2ndVectorMode == SECOND_VECTOR_RING_BUFFER)
+    {
+        for(size_t i = 0; i < suballocations2nd.size(); ++i)
+        {
+            const Suballocation& suballoc = suballocations2nd[i];
+            D3D12MA_VALIDATE(suballoc.offset >= offset);
+            if(suballoc.type == SUBALLOCATION_TYPE_FREE)
+            {
+                D3D12MA_VALIDATE(suballoc.userData == NULL);
+                ++nullItem2ndCount;
+            }
+            else
+            {
+                D3D12MA_VALIDATE(IsVirtual() || suballoc.userData != NULL);
+                sumUsedSize += suballoc.size;
+            }
+            offset = suballoc.offset + suballoc.size;
+        }
+    }
+
+    for(size_t i = m_1stNullItemsBeginCount; i < suballocations1st.size(); ++i)
+    {
+        const Suballocation& suballoc = suballocations1st[i];
+        D3D12MA_VALIDATE(suballoc.offset >= offset);
+        if(suballoc.type == SUBALLOCATION_TYPE_FREE)
+        {
+            D3D12MA_VALIDATE(suballoc.userData == NULL);
+            ++nullItem1stCount;
+        }
+        else
+        {
+            D3D12MA_VALIDATE(IsVirtual() || suballoc.userData != NULL);
+            sumUsedSize += suballoc.size;
+        }
+        offset = suballoc.offset + suballoc.size;
+    }
+
+    if(m_2ndVectorMode == SECOND_VECTOR_DOUBLE_STACK)
+    {
+        for(size_t i = suballocations2nd.size(); i--; )
+        {
+            const Suballocation& suballoc = suballocations2nd[i];
+            D3D12MA_VALIDATE(suballoc.offset >= offset);
+            if(suballoc.type == SUBALLOCATION_TYPE_FREE)
+            {
+                D3D12MA_VALIDATE(suballoc.userData == NULL);
+                ++nullItem2ndCount;
+            }
+            else
+            {
+                D3D12MA_VALIDATE(IsVirtual() || suballoc.userData != NULL);
+                sumUsedSize += suballoc.size;
+            }
+            offset = suballoc.offset + suballoc.size;
+        }
+    }
+
+    D3D12MA_VALIDATE(offset <= GetSize());
+    D3D12MA_VALIDATE(nullItem1stCount == m_1stNullItemsBeginCount + m_1stNullItemsMiddleCount);
+    D3D12MA_VALIDATE(nullItem2ndCount == m_2ndNullItemsCount);
+    D3D12MA_VALIDATE(m_SumFreeSize == GetSize() - sumUsedSize);
+
+    return true;
+}
+
+size_t BlockMetadata_Linear::GetAllocationCount() const
+{
+    return AccessSuballocations1st().size() - (m_1stNullItemsBeginCount + m_1stNullItemsMiddleCount) +
+        AccessSuballocations2nd().size() - m_2ndNullItemsCount;
+}
+
+UINT64 BlockMetadata_Linear::GetUnusedRangeSizeMax() const
+{
+    UINT64 result = 0;
+    EnumerateRanges([&result](UINT64, UINT64 size, const Suballocation* suballoc)
+    {
+        if(suballoc == NULL)
+        {
+            result = D3D12MA_MAX(result, size);
+        }
+    });
+    return result;
+}
+
+void BlockMetadata_Linear::GetAllocationInfo(UINT64 offset, VIRTUAL_ALLOCATION_INFO& outInfo) const
+{
+    const Suballocation* const suballoc = FindSuballocation(offset);
+    D3D12MA_ASSERT(suballoc && "Not found!");
+    outInfo.size = suballoc->size;
+    outInfo.pUserData = suballoc->userData;
+}
+
+bool BlockMetadata_Linear::CreateAllocationRequest(
+    UINT64 allocSize,
+    UINT64 allocAlignment,
+    bool upperAddress,
+    AllocationRequest* pAllocationRequest)
+{
+    D3D12MA_ASSERT(allocSize > 0);
+    D3D12MA_ASSERT(pAllocationRequest != NULL);
+    D3D12MA_HEAVY_ASSERT(Validate());
+
+    // There is not enough total free space in this block to fullfill the request: Early return.
+    if(m_SumFreeSize < allocSize + 2 * D3D12MA_DEBUG_MARGIN)
+    {
+        return false;
+    }
+
+    const bool found = upperAddress ?
+        CreateAllocationRequest_UpperAddress(allocSize, allocAlignment, pAllocationRequest) :
+        CreateAllocationRequest_LowerAddress(allocSize, allocAlignment, pAllocationRequest);
+    if(!found)
+    {
+        return false;
+    }
+
+    pAllocationRequest->sumItemSize = 0;
+    pAllocationRequest->zeroInitialized = m_ZeroInitializedRange.IsRangeZeroInitialized(
+        pAllocationRequest->offset, pAllocationRequest->offset + allocSize);
+    return true;
+}
+
+bool BlockMetadata_Linear::CreateAllocationRequest_LowerAddress(
+    UINT64 allocSize,
+    UINT64 allocAlignment,
+    AllocationRequest* pAllocationRequest)
+{
+    const UINT64 blockSize = GetSize();
+    const SuballocationVectorType& suballocations1st = AccessSuballocations1st();
+    const SuballocationVectorType& suballocations2nd = AccessSuballocations2nd();
+
+    if(m_2ndVectorMode == SECOND_VECTOR_EMPTY || m_2ndVectorMode == SECOND_VECTOR_DOUBLE_STACK)
+    {
+        // Try to allocate at the end of 1st vector.
+        UINT64 resultBaseOffset = 0;
+        if(!suballocations1st.empty())
+        {
+            const Suballocation& lastSuballoc = suballocations1st.back();
+            resultBaseOffset = lastSuballoc.offset + lastSuballoc.size;
+        }
+        // Apply D3D12MA_DEBUG_MARGIN and alignment at the beginning.
+        const UINT64 resultOffset = AlignUp(resultBaseOffset + D3D12MA_DEBUG_MARGIN, allocAlignment);
+
+        // Free space ends at the top of the upper stack, if there is one.
+        const UINT64 freeSpaceEnd = m_2ndVectorMode == SECOND_VECTOR_DOUBLE_STACK ?
+            suballocations2nd.back().offset : blockSize;
+
+        // There is enough free space at the end after alignment.
+        if(resultOffset + allocSize + D3D12MA_DEBUG_MARGIN <= freeSpaceEnd)
+        {
+            pAllocationRequest->offset = resultOffset;
+            pAllocationRequest->sumFreeSize = freeSpaceEnd - resultBaseOffset;
+            pAllocationRequest->algorithmData = (void*)(uintptr_t)ALLOCATION_REQUEST_END_OF_1ST;
+            return true;
+        }
+    }
+
+    // Wrap-around to end of 2nd vector. Try to allocate there, watching for the
+    // beginning of 1st vector as the end of free space.
+    if((m_2ndVectorMode == SECOND_VECTOR_EMPTY || m_2ndVectorMode == SECOND_VECTOR_RING_BUFFER) &&
+        !suballocations1st.empty())
+    {
+        UINT64 resultBaseOffset = 0;
+        if(!suballocations2nd.empty())
+        {
+            const Suballocation& lastSuballoc = suballocations2nd.back();
+            resultBaseOffset = lastSuballoc.offset + lastSuballoc.size;
+        }
+        // Apply D3D12MA_DEBUG_MARGIN and alignment at the beginning.
+        const UINT64 resultOffset = AlignUp(resultBaseOffset + D3D12MA_DEBUG_MARGIN, allocAlignment);
+
+        const UINT64 freeSpaceEnd = suballocations1st[m_1stNullItemsBeginCount].offset;
+
+        // There is enough free space before the oldest allocation after alignment.
+        if(resultOffset + allocSize + D3D12MA_DEBUG_MARGIN <= freeSpaceEnd)
+        {
+            pAllocationRequest->offset = resultOffset;
+            pAllocationRequest->sumFreeSize = freeSpaceEnd - resultBaseOffset;
+            pAllocationRequest->algorithmData = (void*)(uintptr_t)ALLOCATION_REQUEST_END_OF_2ND;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool BlockMetadata_Linear::CreateAllocationRequest_UpperAddress(
+    UINT64 allocSize,
+    UINT64 allocAlignment,
+    AllocationRequest* pAllocationRequest)
+{
+    const SuballocationVectorType& suballocations1st = AccessSuballocations1st();
+    const SuballocationVectorType& suballocations2nd = AccessSuballocations2nd();
+
+    if(m_2ndVectorMode == SECOND_VECTOR_RING_BUFFER)
+    {
+        D3D12MA_ASSERT(0 && "Trying to use pool with linear algorithm as double stack, while it is already being used as ring buffer.");
+        return false;
+    }
+
+    // Try to allocate before 2nd.back(), or end of block if 2nd.empty().
+    const UINT64 resultBaseOffset = suballocations2nd.empty() ? GetSize() : suballocations2nd.back().offset;
+    if(allocSize + D3D12MA_DEBUG_MARGIN > resultBaseOffset)
+    {
+        return false;
+    }
+    // Apply D3D12MA_DEBUG_MARGIN and alignment at the end.
+    const UINT64 resultOffset = AlignDown(resultBaseOffset - allocSize - D3D12MA_DEBUG_MARGIN, allocAlignment);
+
+    UINT64 endOf1st = 0;
+    if(!suballocations1st.empty())
+    {
+        const Suballocation& lastSuballoc = suballocations1st.back();
+        endOf1st = lastSuballoc.offset + lastSuballoc.size;
+    }
+
+    // There is enough free space between the end of 1st vector and the allocation.
+    if(endOf1st + D3D12MA_DEBUG_MARGIN <= resultOffset)
+    {
+        pAllocationRequest->offset = resultOffset;
+        pAllocationRequest->sumFreeSize = resultBaseOffset - endOf1st;
+        pAllocationRequest->algorithmData = (void*)(uintptr_t)ALLOCATION_REQUEST_UPPER_ADDRESS;
+        return true;
+    }
+
+    return false;
+}
+
+void BlockMetadata_Linear::Alloc(
+    const AllocationRequest& request,
+    UINT64 allocSize,
+    void* userData)
+{
+    const Suballocation newSuballoc = { request.offset, allocSize, userData, SUBALLOCATION_TYPE_ALLOCATION };
+
+    switch((ALLOCATION_REQUEST_TYPE)(uintptr_t)request.algorithmData)
+    {
+    case ALLOCATION_REQUEST_UPPER_ADDRESS:
+    {
+        D3D12MA_ASSERT(m_2ndVectorMode != SECOND_VECTOR_RING_BUFFER &&
+            "CRITICAL ERROR: Trying to use linear allocator as double stack while it was already used as ring buffer.");
+        SuballocationVectorType& suballocations2nd = AccessSuballocations2nd();
+        suballocations2nd.push_back(newSuballoc);
+        m_2ndVectorMode = SECOND_VECTOR_DOUBLE_STACK;
+        break;
+    }
+    case ALLOCATION_REQUEST_END_OF_1ST:
+    {
+        SuballocationVectorType& suballocations1st = AccessSuballocations1st();
+        D3D12MA_ASSERT(suballocations1st.empty() ||
+            request.offset >= suballocations1st.back().offset + suballocations1st.back().size);
+        // Check if it fits before the end of the block.
+        D3D12MA_ASSERT(request.offset + allocSize <= GetSize());
+        suballocations1st.push_back(newSuballoc);
+        break;
+    }
+    case ALLOCATION_REQUEST_END_OF_2ND:
+    {
+        SuballocationVectorType& suballocations1st = AccessSuballocations1st();
+        // New allocation at the end of 2-part ring buffer, so before first allocation from 1st vector.
+        D3D12MA_ASSERT(!suballocations1st.empty() &&
+            request.offset + allocSize <= suballocations1st[m_1stNullItemsBeginCount].offset);
+        SuballocationVectorType& suballocations2nd = AccessSuballocations2nd();
+
+        switch(m_2ndVectorMode)
+        {
+        case SECOND_VECTOR_EMPTY:
+            // First allocation from second part ring buffer.
+            D3D12MA_ASSERT(suballocations2nd.empty());
+            m_2ndVectorMode = SECOND_VECTOR_RING_BUFFER;
+            break;
+        case SECOND_VECTOR_RING_BUFFER:
+            // 2-part ring buffer is already started.
+            D3D12MA_ASSERT(!suballocations2nd.empty());
+            break;
+        case SECOND_VECTOR_DOUBLE_STACK:
+            D3D12MA_ASSERT(0 && "CRITICAL ERROR: Trying to use linear allocator as ring buffer while it was already used as double stack.");
+            break;
+        default:
+            D3D12MA_ASSERT(0);
+        }
+
+        suballocations2nd.push_back(newSuballoc);
+        break;
+    }
+    default:
+        D3D12MA_ASSERT(0 && "CRITICAL INTERNAL ERROR.");
+    }
+
+    m_SumFreeSize -= newSuballoc.size;
+    m_ZeroInitializedRange.MarkRangeAsUsed(request.offset, request.offset + allocSize);
+}
+
+void BlockMetadata_Linear::FreeAtOffset(UINT64 offset)
+{
+    SuballocationVectorType& suballocations1st = AccessSuballocations1st();
+    SuballocationVectorType& suballocations2nd = AccessSuballocations2nd();
+
+    if(!suballocations1st.empty())
+    {
+        // First allocation: Mark it as next empty at the beginning.
+        Suballocation& firstSuballoc = suballocations1st[m_1stNullItemsBeginCount];
+        if(firstSuballoc.offset == offset)
+        {
+            firstSuballoc.type = SUBALLOCATION_TYPE_FREE;
+            firstSuballoc.userData = NULL;
+            m_SumFreeSize += firstSuballoc.size;
+            ++m_1stNullItemsBeginCount;
+            CleanupAfterFree();
+            return;
+        }
+
+        // Last allocation in 1st vector.
+        const Suballocation& lastSuballoc = suballocations1st.back();
+        if(lastSuballoc.offset == offset)
+        {
+            m_SumFreeSize += lastSuballoc.size;
+            suballocations1st.pop_back();
+            CleanupAfterFree();
+            return;
+        }
+    }
+
+    // Last allocation in 2-part ring buffer or top of upper stack (same logic).
+    if(m_2ndVectorMode == SECOND_VECTOR_RING_BUFFER ||
+        m_2ndVectorMode == SECOND_VECTOR_DOUBLE_STACK)
+    {
+        const Suballocation& lastSuballoc = suballocations2nd.back();
+        if(lastSuballoc.offset == offset)
+        {
+            m_SumFreeSize += lastSuballoc.size;
+            suballocations2nd.pop_back();
+            CleanupAfterFree();
+            return;
+        }
+    }
+
+    Suballocation refSuballoc;
+    refSuballoc.offset = offset;
+    // Rest of members stays uninitialized intentionally for better performance.
+
+    // Item from the middle of 1st vector.
+    {
+        const SuballocationVectorType::iterator it = BinaryFindSorted(
+            suballocations1st.begin() + m_1stNullItemsBeginCount,
+            suballocations1st.end(),
+            refSuballoc,
+            SuballocationOffsetLess());
+        if(it != suballocations1st.end())
+        {
+            D3D12MA_ASSERT(it->type != SUBALLOCATION_TYPE_FREE && "Allocation freed twice!");
+            it->type = SUBALLOCATION_TYPE_FREE;
+            it->userData = NULL;
+            ++m_1stNullItemsMiddleCount;
+            m_SumFreeSize += it->size;
+            CleanupAfterFree();
+            return;
+        }
+    }
+
+    if(m_2ndVectorMode != SECOND_VECTOR_EMPTY)
+    {
+        // Item from the middle of 2nd vector.
+        const SuballocationVectorType::iterator it = m_2ndVectorMode == SECOND_VECTOR_RING_BUFFER ?
+            BinaryFindSorted(suballocations2nd.begin(), suballocations2nd.end(), refSuballoc, SuballocationOffsetLess()) :
+            BinaryFindSorted(suballocations2nd.begin(), suballocations2nd.end(), refSuballoc, SuballocationOffsetGreater());
+        if(it != suballocations2nd.end())
+        {
+            D3D12MA_ASSERT(it->type != SUBALLOCATION_TYPE_FREE && "Allocation freed twice!");
+            it->type = SUBALLOCATION_TYPE_FREE;
+            it->userData = NULL;
+            ++m_2ndNullItemsCount;
+            m_SumFreeSize += it->size;
+            CleanupAfterFree();
+            return;
+        }
+    }
+
+    D3D12MA_ASSERT(0 && "Allocation to free not found in linear allocator!");
+}
+
+void BlockMetadata_Linear::Clear()
+{
+    m_SumFreeSize = GetSize();
+    m_Suballocations0.clear();
+    m_Suballocations1.clear();
+    // Leaving m_1stVectorIndex unchanged - it doesn't matter.
+    m_2ndVectorMode = SECOND_VECTOR_EMPTY;
+    m_1stNullItemsBeginCount = 0;
+    m_1stNullItemsMiddleCount = 0;
+    m_2ndNullItemsCount = 0;
+    m_ZeroInitializedRange.Reset(GetSize());
+}
+
+void BlockMetadata_Linear::SetAllocationUserData(UINT64 offset, void* userData)
+{
+    Suballocation* const suballoc = const_cast<Suballocation*>(FindSuballocation(offset));
+    D3D12MA_ASSERT(suballoc && "Not found!");
+    suballoc->userData = userData;
+}
+
+void BlockMetadata_Linear::AddAllocationsToList(Vector<Suballocation>& inoutList) const
+{
+    EnumerateRanges([&inoutList](UINT64, UINT64, const Suballocation* suballoc)
+    {
+        if(suballoc != NULL)
+        {
+            inoutList.push_back(*suballoc);
+        }
+    });
+}
+
+void BlockMetadata_Linear::CalcAllocationStatInfo(StatInfo& outInfo) const
+{
+    outInfo.BlockCount = 1;
+
+    outInfo.AllocationCount = (UINT)GetAllocationCount();
+    outInfo.UnusedRangeCount = 0;
+
+    outInfo.UsedBytes = GetSize() - m_SumFreeSize;
+    outInfo.UnusedBytes = m_SumFreeSize;
+
+    outInfo.AllocationSizeMin = UINT64_MAX;
+    outInfo.AllocationSizeMax = 0;
+    outInfo.UnusedRangeSizeMin = UINT64_MAX;
+    outInfo.UnusedRangeSizeMax = 0;
+
+    EnumerateRanges([&outInfo](UINT64, UINT64 size, const Suballocation* suballoc)
+    {
+        if(suballoc == NULL)
+        {
+            ++outInfo.UnusedRangeCount;
+            outInfo.UnusedRangeSizeMin = D3D12MA_MIN(size, outInfo.UnusedRangeSizeMin);
+            outInfo.UnusedRangeSizeMax = D3D12MA_MAX(size, outInfo.UnusedRangeSizeMax);
+        }
+        else
+        {
+            outInfo.AllocationSizeMin = D3D12MA_MIN(size, outInfo.AllocationSizeMin);
+            outInfo.AllocationSizeMax = D3D12MA_MAX(size, outInfo.AllocationSizeMax);
+        }
+    });
+}
+
+void BlockMetadata_Linear::WriteAllocationInfoToJson(JsonWriter& json) const
+{
+    StatInfo stats;
+    CalcAllocationStatInfo(stats);
+
+    json.BeginObject();
+    json.WriteString(L"Algorithm");
+    json.WriteString(L"Linear");
+    json.WriteString(L"TotalBytes");
+    json.WriteNumber(GetSize());
+    json.WriteString(L"UnusuedBytes");
+    json.WriteNumber(GetSumFreeSize());
+    json.WriteString(L"Allocations");
+    json.WriteNumber(GetAllocationCount());
+    json.WriteString(L"UnusedRanges");
+    json.WriteNumber(stats.UnusedRangeCount);
+    json.WriteString(L"Fragmentation");
+    json.WriteNumber(CalcFragmentationPercent());
+    json.WriteString(L"Suballocations");
+    json.BeginArray();
+    const bool isVirtual = IsVirtual();
+    EnumerateRanges([&json, isVirtual](UINT64 offset, UINT64 size, const Suballocation* suballoc)
+    {
+        json.BeginObject(true);
+        json.WriteString(L"Offset");
+        json.WriteNumber(offset);
+        if(suballoc == NULL)
+        {
+            json.WriteString(L"Type");
+            json.WriteString(L"FREE");
+            json.WriteString(L"Size");
+            json.WriteNumber(size);
+        }
+        else if(isVirtual)
+        {
+            json.WriteString(L"Type");
+            json.WriteString(L"ALLOCATION");
+            json.WriteString(L"Size");
+            json.WriteNumber(size);
+            if(suballoc->userData)
+            {
+                json.WriteString(L"UserData");
+                json.WriteNumber((uintptr_t)suballoc->userData);
+            }
+        }
+        else
+        {
+            const Allocation* const alloc = (const Allocation*)suballoc->userData;
+            D3D12MA_ASSERT(alloc);
+            json.AddAllocationToObject(*alloc);
+        }
+        json.EndObject();
+    });
+    json.EndArray();
+    json.EndObject();
+}
+
+const Suballocation* BlockMetadata_Linear::FindSuballocation(UINT64 offset) const
+{
+    const SuballocationVectorType& suballocations1st = AccessSuballocations1st();
+    const SuballocationVectorType& suballocations2nd = AccessSuballocations2nd();
+
+    Suballocation refSuballoc;
+    refSuballoc.offset = offset;
+    // Rest of members stays uninitialized intentionally for better performance.
+
+    // Item from the 1st vector.
+    {
+        const Suballocation* const end1st = suballocations1st.data() + suballocations1st.size();
+        const Suballocation* const it = BinaryFindSorted(
+            suballocations1st.data() + m_1stNullItemsBeginCount,
+            end1st,
+            refSuballoc,
+            SuballocationOffsetLess());
+        if(it != end1st && it->type != SUBALLOCATION_TYPE_FREE)
+        {
+            return it;
+        }
+    }
+
+    if(m_2ndVectorMode != SECOND_VECTOR_EMPTY)
+    {
+        // Rest of members stays uninitialized intentionally for better performance.
+        const Suballocation* const begin2nd = suballocations2nd.data();
+        const Suballocation* const end2nd = begin2nd + suballocations2nd.size();
+        const Suballocation* const it = m_2ndVectorMode == SECOND_VECTOR_RING_BUFFER ?
+            BinaryFindSorted(begin2nd, end2nd, refSuballoc, SuballocationOffsetLess()) :
+            BinaryFindSorted(begin2nd, end2nd, refSuballoc, SuballocationOffsetGreater());
+        if(it != end2nd && it->type != SUBALLOCATION_TYPE_FREE)
+        {
+            return it;
+        }
+    }
+
+    return NULL;
+}
+
+bool BlockMetadata_Linear::ShouldCompact1st() const
+{
+    const size_t nullItemCount = m_1stNullItemsBeginCount + m_1stNullItemsMiddleCount;
+    const size_t suballocCount = AccessSuballocations1st().size();
+    return suballocCount > 32 && nullItemCount * 2 >= (suballocCount - nullItemCount) * 3;
+}
+
+void BlockMetadata_Linear::CleanupAfterFree()
+{
+    SuballocationVectorType& suballocations1st = AccessSuballocations1st();
+    SuballocationVectorType& suballocations2nd = AccessSuballocations2nd();
+
+    if(IsEmpty())
+    {
+        suballocations1st.clear();
+        suballocations2nd.clear();
+        m_1stNullItemsBeginCount = 0;
+        m_1stNullItemsMiddleCount = 0;
+        m_2ndNullItemsCount = 0;
+        m_2ndVectorMode = SECOND_VECTOR_EMPTY;
+    }
+    else
+    {
+        const size_t suballoc1stCount = suballocations1st.size();
+        const size_t nullItem1stCount = m_1stNullItemsBeginCount + m_1stNullItemsMiddleCount;
+        D3D12MA_ASSERT(nullItem1stCount <= suballoc1stCount);
+
+        // Find more null items at the beginning of 1st vector.
+        while(m_1stNullItemsBeginCount < suballoc1stCount &&
+            suballocations1st[m_1stNullItemsBeginCount].type == SUBALLOCATION_TYPE_FREE)
+        {
+            ++m_1stNullItemsBeginCount;
+            --m_1stNullItemsMiddleCount;
+        }
+
+        // Find more null items at the end of 1st vector.
+        while(m_1stNullItemsMiddleCount > 0 &&
+            suballocations1st.back().type == SUBALLOCATION_TYPE_FREE)
+        {
+            --m_1stNullItemsMiddleCount;
+            suballocations1st.pop_back();
+        }
+
+        // Find more null items at the end of 2nd vector.
+        while(m_2ndNullItemsCount > 0 &&
+            suballocations2nd.back().type == SUBALLOCATION_TYPE_FREE)
+        {
+            --m_2ndNullItemsCount;
+            suballocations2nd.pop_back();
+        }
+
+        // Find more null items at the beginning of 2nd vector.
+        while(m_2ndNullItemsCount > 0 &&
+            suballocations2nd[0].type == SUBALLOCATION_TYPE_FREE)
+        {
+            --m_2ndNullItemsCount;
+            suballocations2nd.remove(0);
+        }
+
+        if(ShouldCompact1st())
+        {
+            const size_t nonNullItemCount = suballoc1stCount - nullItem1stCount;
+            size_t srcIndex = m_1stNullItemsBeginCount;
+            for(size_t dstIndex = 0; dstIndex < nonNullItemCount; ++dstIndex)
+            {
+                while(suballocations1st[srcIndex].type == SUBALLOCATION_TYPE_FREE)
+                {
+                    ++srcIndex;
+                }
+                if(dstIndex != srcIndex)
+                {
+                    suballocations1st[dstIndex] = suballocations1st[srcIndex];
+                }
+                ++srcIndex;
+            }
+            suballocations1st.resize(nonNullItemCount);
+            m_1stNullItemsBeginCount = 0;
+            m_1stNullItemsMiddleCount = 0;
+        }
+
+        // 2nd vector became empty.
+        if(suballocations2nd.empty())
+        {
+            m_2ndVectorMode = SECOND_VECTOR_EMPTY;
+        }
+
+        // 1st vector became empty.
+        if(suballocations1st.size() - m_1stNullItemsBeginCount == 0)
+        {
+            suballocations1st.clear();
+            m_1stNullItemsBeginCount = 0;
+
+            if(!suballocations2nd.empty() && m_2ndVectorMode == SECOND_VECTOR_RING_BUFFER)
+            {
+                // Swap 1st with 2nd. Now 2nd is empty.
+                m_2ndVectorMode = SECOND_VECTOR_EMPTY;
+                m_1stNullItemsMiddleCount = m_2ndNullItemsCount;
+                while(m_1stNullItemsBeginCount < suballocations2nd.size() &&
+                    suballocations2nd[m_1stNullItemsBeginCount].type == SUBALLOCATION_TYPE_FREE)
+                {
+                    ++m_1stNullItemsBeginCount;
+                    --m_1stNullItemsMiddleCount;
+                }
+                m_2ndNullItemsCount = 0;
+                m_1stVectorIndex ^= 1;
+            }
+        }
+    }
+
+    D3D12MA_HEAVY_ASSERT(Validate());
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Private class NormalBlock implementation
+
+NormalBlock::NormalBlock(
+    AllocatorPimpl* allocator,
+    BlockVector* blockVector,
+    const D3D12_HEAP_PROPERTIES& heapProps,
+    D3D12_HEAP_FLAGS heapFlags,
+    UINT64 size,
+    UINT id) :
+    MemoryBlock(allocator, heapProps, heapFlags, size, id),
+    m_pMetadata(NULL),
+    m_BlockVector(blockVector)
+{
+}
+
+NormalBlock::~NormalBlock()
+{
+    if(m_pMetadata != NULL)
+    {
+        // THIS IS THE MOST IMPORTANT ASSERT IN THE ENTIRE LIBRARY!
+        // Hitting it means you have some memory leak - unreleased Allocation objects.
+        D3D12MA_ASSERT(m_pMetadata->IsEmpty() && "Some allocations were not freed before destruction of this memory block!");
+
+        D3D12MA_DELETE(m_Allocator->GetAllocs(), m_pMetadata);
+    }
+}
+
+HRESULT NormalBlock::Init(UINT32 algorithm, ID3D12ProtectedResourceSession* pProtectedSession)
+{
+    HRESULT hr = MemoryBlock::Init(pProtectedSession);
+    if(FAILED(hr))
+    {
+        return hr;
+    }
+
+    switch(algorithm)
+    {
+    case POOL_FLAG_ALGORITHM_TLSF:
+        m_pMetadata = D3D12MA_NEW(m_Allocator->GetAllocs(), BlockMetadata_TLSF)(&m_Allocator->GetAllocs(), false);
+        break;
+    case POOL_FLAG_ALGORITHM_LINEAR:
+        m_pMetadata = D3D12MA_NEW(m_Allocator->GetAllocs(), BlockMetadata_Linear)(&m_Allocator->GetAllocs(), false);
+        break;
+    default:
+        D3D12MA_ASSERT(0);
+        // Fall-through.
+    case 0:
+        m_pMetadata = D3D12MA_NEW(m_Allocator->GetAllocs(), BlockMetadata_Generic)(&m_Allocator->GetAllocs(), false);
+        break;
+    }
+    m_pMetadata->Init(m_Size);
+
+    return hr;
+}
+
+bool NormalBlock::Validate() const
+{
+    D3D12MA_VALIDATE(GetHeap() &&
+        m_pMetadata &&
+        m_pMetadata->GetSize() != 0 &&
+        m_pMetadata->GetSize() == GetSize());
+    return m_pMetadata->Validate();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Private class MemoryBlock definition
+
+MemoryBlock::MemoryBlock(
+    AllocatorPimpl* allocator,
+    const D3D12_HEAP_PROPERTIES& heapProps,
+    D3D12_HEAP_FLAGS heapFlags,
+    UINT64 size,
+    UINT id) :
+    m_Allocator(allocator),
+    m_HeapProps(heapProps),
+    m_HeapFlags(heapFlags),
+    m_Size(size),
+    m_Id(id)
+{
+}
+
+MemoryBlock::~MemoryBlock()
+{
+    if(m_Heap)
+    {
+        m_Allocator->m_Budget.m_BlockBytes[HeapTypeToIndex(m_HeapProps.Type)] -= m_Size;
+        m_Heap->Release();
+    }
+}
+
+HRESULT MemoryBlock::Init(ID3D12ProtectedResourceSession* pProtectedSession)
+{
+    D3D12MA_ASSERT(m_Heap == NULL && m_Size > 0);
+
+    D3D12_HEAP_DESC heapDesc = {};
+    heapDesc.SizeInBytes = m_Size;
     heapDesc.Properties = m_HeapProps;
     heapDesc.Alignment = HeapFlagsToAlignment(m_HeapFlags);
     heapDesc.Flags = m_HeapFlags;
@@ -4043,6 +5866,7 @@ BlockVector::BlockVector(
     size_t maxBlockCount,
     bool explicitBlockSize,
     UINT64 minAllocationAlignment,
+    UINT32 algorithm,
     ID3D12ProtectedResourceSession* pProtectedSession) :
     m_hAllocator(hAllocator),
     m_HeapProps(heapProps),
@@ -4052,6 +5876,7 @@ BlockVector::BlockVector(
     m_MaxBlockCount(maxBlockCount),
     m_ExplicitBlockSize(explicitBlockSize),
     m_MinAllocationAlignment(minAllocationAlignment),
+    m_Algorithm(algorithm),
     m_ProtectedSession(pProtectedSession),
     m_HasEmptyBlock(false),
     m_Blocks(hAllocator->GetAllocs()),
@@ -4154,6 +5979,26 @@ HRESULT BlockVector::AllocatePage(
         freeMemory >= size;
 
     // 1. Search existing allocations
+    if(m_Algorithm == POOL_FLAG_ALGORITHM_LINEAR)
+    {
+        // Use only last block.
+        if(!m_Blocks.empty())
+        {
+            NormalBlock* const pCurrBlock = m_Blocks.back();
+            D3D12MA_ASSERT(pCurrBlock);
+            HRESULT hr = AllocateFromBlock(
+                pCurrBlock,
+                size,
+                alignment,
+                allocDesc.Flags,
+                pAllocation);
+            if(SUCCEEDED(hr))
+            {
+                return hr;
+            }
+        }
+    }
+    else
     {
         // Forward order in m_Blocks - prefer blocks with smallest amount of free space.
         for(size_t blockIndex = 0; blockIndex < m_Blocks.size(); ++blockIndex )
@@ -4299,7 +6144,11 @@ void BlockVector::Free(Allocation* hAllocation)
             }
         }
 
-        IncrementallySortBlocks();
+        // Linear algorithm allocates only from the last block, which must stay last.
+        if(m_Algorithm != POOL_FLAG_ALGORITHM_LINEAR)
+        {
+            IncrementallySortBlocks();
+        }
     }
 
     // Destruction of a free Allocation. Deferred until this point, outside of mutex
@@ -4473,6 +6322,7 @@ HRESULT BlockVector::AllocateFromBlock(
     if(pBlock->m_pMetadata->CreateAllocationRequest(
         size,
         alignment,
+        (allocFlags & ALLOCATION_FLAG_UPPER_ADDRESS) != 0,
         &currRequest))
     {
         // We no longer have an empty Allocation.
@@ -4502,7 +6352,7 @@ HRESULT BlockVector::CreateBlock(
         m_HeapFlags,
         blockSize,
         m_NextBlockId++);
-    HRESULT hr = pBlock->Init(m_ProtectedSession);
+    HRESULT hr = pBlock->Init(m_Algorithm, m_ProtectedSession);
     if(FAILED(hr))
     {
         D3D12MA_DELETE(m_hAllocator->GetAllocs(), pBlock);
@@ -4573,6 +6423,290 @@ void BlockVector::WriteBlockInfoToJson(JsonWriter& json)
     json.EndObject();
 }
 
+////////////////////////////////////////////////////////////////////////////////
+// Private class DefragmentationContextPimpl implementation
+
+DefragmentationContextPimpl::DefragmentationContextPimpl(
+    AllocatorPimpl* hAllocator,
+    const DEFRAGMENTATION_DESC& desc,
+    BlockVector* poolVector) :
+    m_hAllocator(hAllocator),
+    m_MaxPassBytes(desc.MaxBytesPerPass != 0 ? desc.MaxBytesPerPass : UINT64_MAX),
+    m_MaxPassAllocations(desc.MaxAllocationsPerPass != 0 ? desc.MaxAllocationsPerPass : UINT32_MAX),
+    m_Algorithm((desc.Flags & DEFRAGMENTATION_FLAG_ALGORITHM_MASK) == DEFRAGMENTATION_FLAG_ALGORITHM_FAST ?
+        DEFRAGMENTATION_FLAG_ALGORITHM_FAST : DEFRAGMENTATION_FLAG_ALGORITHM_FULL),
+    m_BlockVectors(hAllocator->GetAllocs()),
+    m_Moves(hAllocator->GetAllocs()),
+    m_SortedBlocks(hAllocator->GetAllocs()),
+    m_Candidates(hAllocator->GetAllocs()),
+    m_BlockCandidateEnds(hAllocator->GetAllocs())
+{
+    ZeroMemory(&m_PassStats, sizeof(m_PassStats));
+    ZeroMemory(&m_GlobalStats, sizeof(m_GlobalStats));
+
+    if(poolVector != NULL)
+    {
+        D3D12MA_ASSERT(poolVector->GetAlgorithm() != POOL_FLAG_ALGORITHM_LINEAR);
+        m_BlockVectors.push_back(poolVector);
+    }
+    else
+    {
+        for(UINT i = 0; i < DEFAULT_POOL_MAX_COUNT; ++i)
+        {
+            if(hAllocator->m_BlockVectors[i] != NULL)
+            {
+                m_BlockVectors.push_back(hAllocator->m_BlockVectors[i]);
+            }
+        }
+    }
+}
+
+DefragmentationContextPimpl::~DefragmentationContextPimpl()
+{
+    D3D12MA_ASSERT(m_Moves.empty() && "Defragmentation pass begun but not ended.");
+}
+
+const ALLOCATION_CALLBACKS& DefragmentationContextPimpl::GetAllocs() const
+{
+    return m_hAllocator->GetAllocs();
+}
+
+HRESULT DefragmentationContextPimpl::DefragmentPassBegin(DEFRAGMENTATION_PASS_MOVE_INFO& moveInfo)
+{
+    D3D12MA_ASSERT(m_Moves.empty() && "Previous defragmentation pass not ended.");
+    ZeroMemory(&m_PassStats, sizeof(m_PassStats));
+
+    for(size_t i = 0; i < m_BlockVectors.size(); ++i)
+    {
+        BlockVector* const blockVector = m_BlockVectors[i];
+        MutexLockWrite lock(blockVector->m_Mutex, m_hAllocator->UseMutex());
+        if(!ComputeMoves(*blockVector))
+        {
+            break;
+        }
+    }
+
+    moveInfo.MoveCount = (UINT32)m_Moves.size();
+    if(moveInfo.MoveCount > 0)
+    {
+        moveInfo.pMoves = m_Moves.data();
+        return S_FALSE;
+    }
+
+    moveInfo.pMoves = NULL;
+    return S_OK;
+}
+
+HRESULT DefragmentationContextPimpl::DefragmentPassEnd(DEFRAGMENTATION_PASS_MOVE_INFO& moveInfo)
+{
+    D3D12MA_ASSERT(moveInfo.MoveCount == m_Moves.size() && moveInfo.pMoves == m_Moves.data());
+    D3D12MA_ASSERT(m_BlockVectors.size() <= DEFAULT_POOL_MAX_COUNT);
+
+    // Blocks can also be deleted by BlockVector::Free while the old places are released,
+    // so freed heaps are counted from the difference.
+    UINT64 blockBytesBefore[DEFAULT_POOL_MAX_COUNT];
+    size_t blockCountBefore[DEFAULT_POOL_MAX_COUNT];
+    for(size_t i = 0; i < m_BlockVectors.size(); ++i)
+    {
+        MutexLockRead lock(m_BlockVectors[i]->m_Mutex, m_hAllocator->UseMutex());
+        blockBytesBefore[i] = m_BlockVectors[i]->CalcSumBlockSize();
+        blockCountBefore[i] = m_BlockVectors[i]->m_Blocks.size();
+    }
+
+    for(UINT32 i = 0; i < moveInfo.MoveCount; ++i)
+    {
+        DEFRAGMENTATION_MOVE& move = moveInfo.pMoves[i];
+        switch(move.Operation)
+        {
+        case DEFRAGMENTATION_MOVE_OPERATION_COPY:
+        {
+            BlockVector* const blockVector = move.pSrcAllocation->m_Placed.block->GetBlockVector();
+            {
+                MutexLockWrite lock(blockVector->m_Mutex, m_hAllocator->UseMutex());
+                move.pSrcAllocation->SwapBlockAllocation(move.pDstTmpAllocation);
+            }
+            // Now holds the old place and the old resource.
+            move.pDstTmpAllocation->Release();
+            break;
+        }
+        case DEFRAGMENTATION_MOVE_OPERATION_IGNORE:
+            m_PassStats.BytesMoved -= move.pSrcAllocation->GetSize();
+            --m_PassStats.AllocationsMoved;
+            move.pDstTmpAllocation->Release();
+            break;
+        case DEFRAGMENTATION_MOVE_OPERATION_DESTROY:
+            m_PassStats.BytesMoved -= move.pSrcAllocation->GetSize();
+            --m_PassStats.AllocationsMoved;
+            move.pSrcAllocation->Release();
+            move.pDstTmpAllocation->Release();
+            break;
+        default:
+            D3D12MA_ASSERT(0);
+        }
+    }
+    m_Moves.clear();
+
+    for(size_t i = 0; i < m_BlockVectors.size(); ++i)
+    {
+        BlockVector* const blockVector = m_BlockVectors[i];
+        FreeEmptyBlocks(*blockVector);
+
+        MutexLockRead lock(blockVector->m_Mutex, m_hAllocator->UseMutex());
+        const UINT64 blockBytesAfter = blockVector->CalcSumBlockSize();
+        const size_t blockCountAfter = blockVector->m_Blocks.size();
+        if(blockCountAfter < blockCountBefore[i])
+        {
+            m_PassStats.HeapsFreed += (UINT32)(blockCountBefore[i] - blockCountAfter);
+        }
+        if(blockBytesAfter < blockBytesBefore[i])
+        {
+            m_PassStats.BytesFreed += blockBytesBefore[i] - blockBytesAfter;
+        }
+    }
+
+    m_GlobalStats.BytesMoved += m_PassStats.BytesMoved;
+    m_GlobalStats.BytesFreed += m_PassStats.BytesFreed;
+    m_GlobalStats.AllocationsMoved += m_PassStats.AllocationsMoved;
+    m_GlobalStats.HeapsFreed += m_PassStats.HeapsFreed;
+
+    // Moves free space that the next pass may be able to use. If every move was ignored,
+    // the next pass would only find the same ones again.
+    return m_PassStats.AllocationsMoved > 0 ? S_FALSE : S_OK;
+}
+
+bool DefragmentationContextPimpl::ComputeMoves(BlockVector& blockVector)
+{
+    Vector<NormalBlock*>& blocks = m_SortedBlocks;
+    blocks.clear();
+    for(size_t i = 0; i < blockVector.m_Blocks.size(); ++i)
+    {
+        blocks.push_back(blockVector.m_Blocks[i]);
+    }
+    // Most used first, these are the destinations.
+    std::sort(blocks.begin(), blocks.end(), [](const NormalBlock* lhs, const NormalBlock* rhs)
+    {
+        return lhs->m_pMetadata->GetSize() - lhs->m_pMetadata->GetSumFreeSize() >
+            rhs->m_pMetadata->GetSize() - rhs->m_pMetadata->GetSumFreeSize();
+    });
+
+    // Taken before any move, so that the temporary destination allocations are never moved themselves.
+    m_Candidates.clear();
+    m_BlockCandidateEnds.clear();
+    for(size_t i = 0; i < blocks.size(); ++i)
+    {
+        blocks[i]->m_pMetadata->AddAllocationsToList(m_Candidates);
+        m_BlockCandidateEnds.push_back(m_Candidates.size());
+    }
+
+    for(size_t srcIndex = blocks.size(); srcIndex--; )
+    {
+        NormalBlock* const srcBlock = blocks[srcIndex];
+        const size_t candidatesBegin = srcIndex > 0 ? m_BlockCandidateEnds[srcIndex - 1] : 0;
+        // Highest offsets first, so that compacting the block fills its beginning.
+        for(size_t candidateIndex = m_BlockCandidateEnds[srcIndex]; candidateIndex-- > candidatesBegin; )
+        {
+            const Suballocation& suballoc = m_Candidates[candidateIndex];
+            // Could never be moved within the limit.
+            if(suballoc.size > m_MaxPassBytes)
+            {
+                continue;
+            }
+            if(m_PassStats.AllocationsMoved >= m_MaxPassAllocations ||
+                m_PassStats.BytesMoved + suballoc.size > m_MaxPassBytes)
+            {
+                return false;
+            }
+
+            const Allocation* const src = (const Allocation*)suballoc.userData;
+            Allocation* dst = NULL;
+            for(size_t dstIndex = 0; dstIndex < srcIndex && dst == NULL; ++dstIndex)
+            {
+                dst = AllocateMoveDestination(blockVector, blocks[dstIndex], src, UINT64_MAX);
+            }
+            if(dst == NULL && m_Algorithm == DEFRAGMENTATION_FLAG_ALGORITHM_FULL)
+            {
+                dst = AllocateMoveDestination(blockVector, srcBlock, src, suballoc.offset);
+            }
+
+            if(dst != NULL)
+            {
+                DEFRAGMENTATION_MOVE move = { DEFRAGMENTATION_MOVE_OPERATION_COPY, (Allocation*)src, dst };
+                m_Moves.push_back(move);
+                ++m_PassStats.AllocationsMoved;
+                m_PassStats.BytesMoved += suballoc.size;
+            }
+        }
+    }
+    return true;
+}
+
+Allocation* DefragmentationContextPimpl::AllocateMoveDestination(BlockVector& blockVector, NormalBlock* block, const Allocation* src, UINT64 maxOffset)
+{
+    BlockMetadata* const metadata = block->m_pMetadata;
+    const UINT64 size = src->GetSize();
+    const UINT64 alignment = src->m_Placed.alignment;
+    if(metadata->GetSumFreeSize() < size)
+    {
+        return NULL;
+    }
+
+    AllocationRequest request = {};
+    if(!metadata->CreateAllocationRequest(size, alignment, false, &request) ||
+        request.offset >= maxOffset)
+    {
+        return NULL;
+    }
+
+    if(metadata->IsEmpty())
+    {
+        blockVector.m_HasEmptyBlock = false;
+    }
+
+    Allocation* const dst = m_hAllocator->GetAllocationObjectAllocator().Allocate(m_hAllocator, size, request.zeroInitialized);
+    metadata->Alloc(request, size, dst);
+    dst->InitPlaced(request.offset, alignment, block);
+    D3D12MA_HEAVY_ASSERT(block->Validate());
+    m_hAllocator->m_Budget.AddAllocation(HeapTypeToIndex(block->GetHeapProperties().Type), size);
+    return dst;
+}
+
+void DefragmentationContextPimpl::FreeEmptyBlocks(BlockVector& blockVector)
+{
+    Vector<NormalBlock*>& blocksToDelete = m_SortedBlocks;
+    blocksToDelete.clear();
+
+    // Scope for lock.
+    {
+        MutexLockWrite lock(blockVector.m_Mutex, m_hAllocator->UseMutex());
+
+        for(size_t i = blockVector.m_Blocks.size(); i-- && blockVector.m_Blocks.size() > blockVector.m_MinBlockCount; )
+        {
+            NormalBlock* const block = blockVector.m_Blocks[i];
+            if(block->m_pMetadata->IsEmpty())
+            {
+                blocksToDelete.push_back(block);
+                blockVector.m_Blocks.remove(i);
+            }
+        }
+
+        blockVector.m_HasEmptyBlock = false;
+        for(size_t i = 0; i < blockVector.m_Blocks.size(); ++i)
+        {
+            if(blockVector.m_Blocks[i]->m_pMetadata->IsEmpty())
+            {
+                blockVector.m_HasEmptyBlock = true;
+                break;
+            }
+        }
+    }
+
+    // Deferred until this point, outside of mutex lock, like in BlockVector::Free.
+    for(size_t i = 0; i < blocksToDelete.size(); ++i)
+    {
+        D3D12MA_DELETE(m_hAllocator->GetAllocs(), blocksToDelete[i]);
+    }
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // Private class PoolPimpl
 
@@ -4596,6 +6730,7 @@ PoolPimpl::PoolPimpl(AllocatorPimpl* allocator, const POOL_DESC& desc) :
         desc.MinBlockCount, maxBlockCount,
         explicitBlockSize,
         D3D12MA_MAX(desc.MinAllocationAlignment, (UINT64)D3D12MA_DEBUG_ALIGNMENT),
+        desc.Flags & POOL_FLAG_ALGORITHM_MASK,
         desc.pProtectedSession);
 }
 
@@ -4696,6 +6831,22 @@ LPCWSTR Pool::GetName() const
     return m_Pimpl->GetName();
 }
 
+HRESULT Pool::BeginDefragmentation(const DEFRAGMENTATION_DESC* pDesc, DefragmentationContext** ppContext)
+{
+    D3D12MA_ASSERT(pDesc && ppContext);
+
+    // Allocations of a linear pool are not meant to live long enough to be worth moving.
+    if(m_Pimpl->GetBlockVector()->GetAlgorithm() == POOL_FLAG_ALGORITHM_LINEAR)
+    {
+        return E_NOINTERFACE;
+    }
+
+    D3D12MA_DEBUG_GLOBAL_MUTEX_LOCK
+    AllocatorPimpl* const allocator = m_Pimpl->GetAllocator();
+    *ppContext = D3D12MA_NEW(allocator->GetAllocs(), DefragmentationContext)(allocator, *pDesc, m_Pimpl->GetBlockVector());
+    return S_OK;
+}
+
 Pool::Pool(Allocator* allocator, const POOL_DESC &desc) :
     m_Pimpl(D3D12MA_NEW(allocator->m_Pimpl->GetAllocs(), PoolPimpl)(allocator->m_Pimpl, desc))
 {
@@ -4792,6 +6943,7 @@ HRESULT AllocatorPimpl::Init(const ALLOCATOR_DESC& desc)
             SIZE_MAX, // maxBlockCount
             false, // explicitBlockSize
             D3D12MA_DEBUG_ALIGNMENT, // minAllocationAlignment
+            0, // algorithm
             NULL); // pProtectedSession
         // No need to call m_pBlockVectors[i]->CreateMinBlocks here, becase minBlockCount is 0.
     }
@@ -5247,10 +7399,18 @@ HRESULT AllocatorPimpl::CalcAllocationParams(const ALLOCATION_DESC& allocDesc, U
     outCommittedAllocationParams = CommittedAllocationParameters();
     outPreferCommitted = false;
 
+    const bool upperAddress = (allocDesc.Flags & ALLOCATION_FLAG_UPPER_ADDRESS) != 0;
+
     if(allocDesc.CustomPool != NULL)
     {
         PoolPimpl* const pool = allocDesc.CustomPool->m_Pimpl;
 
+        if(upperAddress &&
+            ((pool->GetDesc().Flags & POOL_FLAG_ALGORITHM_MASK) != POOL_FLAG_ALGORITHM_LINEAR || pool->GetDesc().MaxBlockCount != 1))
+        {
+            return E_INVALIDARG;
+        }
+
         outBlockVector = pool->GetBlockVector();
 
         outCommittedAllocationParams.m_ProtectedSession = pool->GetDesc().pProtectedSession;
@@ -5260,7 +7420,7 @@ HRESULT AllocatorPimpl::CalcAllocationParams(const ALLOCATION_DESC& allocDesc, U
     }
     else
     {
-        if(!IsHeapTypeStandard(allocDesc.HeapType))
+        if(!IsHeapTypeStandard(allocDesc.HeapType) || upperAddress)
         {
             return E_INVALIDARG;
         }
@@ -6047,6 +8207,22 @@ ID3D12Heap* Allocation::GetHeap() const
     }
 }
 
+void Allocation::SetResource(ID3D12Resource* pResource)
+{
+    if(pResource != m_Resource)
+    {
+        if(m_Resource != NULL)
+        {
+            m_Resource->Release();
+        }
+        m_Resource = pResource;
+        if(m_Resource != NULL)
+        {
+            m_Resource->AddRef();
+        }
+    }
+}
+
 void Allocation::SetName(LPCWSTR Name)
 {
     FreeName();
@@ -6064,7 +8240,8 @@ Allocation::Allocation(AllocatorPimpl* allocator, UINT64 size, BOOL wasZeroIniti
     m_Size{size},
     m_Resource{NULL},
     m_CreationFrameIndex{allocator->GetCurrentFrameIndex()},
-    m_Name{NULL}
+    m_Name{NULL},
+    m_pPrivateData{NULL}
 {
     D3D12MA_ASSERT(allocator);
 
@@ -6087,6 +8264,7 @@ void Allocation::InitPlaced(UINT64 offset, UINT64 alignment, NormalBlock* block)
 {
     m_PackedData.SetType(TYPE_PLACED);
     m_Placed.offset = offset;
+    m_Placed.alignment = alignment;
     m_Placed.block = block;
 }
 
@@ -6109,6 +8287,20 @@ void Allocation::SetResource(ID3D12Resource* resource, const D3D12_RESOURCE_DESC
     m_PackedData.SetTextureLayout(pResourceDesc->Layout);
 }
 
+void Allocation::SwapBlockAllocation(Allocation* allocation)
+{
+    D3D12MA_ASSERT(allocation != NULL);
+    D3D12MA_ASSERT(m_PackedData.GetType() == TYPE_PLACED);
+    D3D12MA_ASSERT(allocation->m_PackedData.GetType() == TYPE_PLACED);
+
+    D3D12MA_SWAP(m_Resource, allocation->m_Resource);
+    D3D12MA_SWAP(m_Placed.offset, allocation->m_Placed.offset);
+    D3D12MA_SWAP(m_Placed.alignment, allocation->m_Placed.alignment);
+    D3D12MA_SWAP(m_Placed.block, allocation->m_Placed.block);
+    m_Placed.block->m_pMetadata->SetAllocationUserData(m_Placed.offset, this);
+    allocation->m_Placed.block->m_pMetadata->SetAllocationUserData(allocation->m_Placed.offset, allocation);
+}
+
 void Allocation::FreeName()
 {
     if(m_Name)
@@ -6327,6 +8519,58 @@ void Allocator::FreeStatsString(WCHAR* pStatsString) const
     }
 }
 
+void Allocator::BeginDefragmentation(const DEFRAGMENTATION_DESC* pDesc, DefragmentationContext** ppContext)
+{
+    D3D12MA_ASSERT(pDesc && ppContext);
+    D3D12MA_DEBUG_GLOBAL_MUTEX_LOCK
+    *ppContext = D3D12MA_NEW(m_Pimpl->GetAllocs(), DefragmentationContext)(m_Pimpl, *pDesc, NULL);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Public class DefragmentationContext implementation
+
+HRESULT DefragmentationContext::BeginPass(DEFRAGMENTATION_PASS_MOVE_INFO* pPassInfo)
+{
+    D3D12MA_ASSERT(pPassInfo);
+    D3D12MA_DEBUG_GLOBAL_MUTEX_LOCK
+    return m_Pimpl->DefragmentPassBegin(*pPassInfo);
+}
+
+HRESULT DefragmentationContext::EndPass(DEFRAGMENTATION_PASS_MOVE_INFO* pPassInfo)
+{
+    D3D12MA_ASSERT(pPassInfo);
+    D3D12MA_DEBUG_GLOBAL_MUTEX_LOCK
+    return m_Pimpl->DefragmentPassEnd(*pPassInfo);
+}
+
+void DefragmentationContext::GetStats(DEFRAGMENTATION_STATS* pStats)
+{
+    D3D12MA_ASSERT(pStats);
+    m_Pimpl->GetStats(*pStats);
+}
+
+void DefragmentationContext::ReleaseThis()
+{
+    if(this == NULL)
+    {
+        return;
+    }
+
+    D3D12MA_DELETE(m_Pimpl->GetAllocs(), this);
+}
+
+DefragmentationContext::DefragmentationContext(AllocatorPimpl* allocator,
+    const DEFRAGMENTATION_DESC& desc,
+    BlockVector* poolVector) :
+    m_Pimpl(D3D12MA_NEW(allocator->GetAllocs(), DefragmentationContextPimpl)(allocator, desc, poolVector))
+{
+}
+
+DefragmentationContext::~DefragmentationContext()
+{
+    D3D12MA_DELETE(m_Pimpl->GetAllocs(), m_Pimpl);
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // Private class VirtualBlockPimpl definition
 
@@ -6335,25 +8579,47 @@ class VirtualBlockPimpl
 public:
     const ALLOCATION_CALLBACKS m_AllocationCallbacks;
     const UINT64 m_Size;
-    BlockMetadata_Generic m_Metadata;
+    BlockMetadata* m_Metadata;
 
-    VirtualBlockPimpl(const ALLOCATION_CALLBACKS& allocationCallbacks, UINT64 size);
+    VirtualBlockPimpl(const ALLOCATION_CALLBACKS& allocationCallbacks, const VIRTUAL_BLOCK_DESC& desc);
+    ~VirtualBlockPimpl();
 };
 
-VirtualBlockPimpl::VirtualBlockPimpl(const ALLOCATION_CALLBACKS& allocationCallbacks, UINT64 size) :
+VirtualBlockPimpl::VirtualBlockPimpl(const ALLOCATION_CALLBACKS& allocationCallbacks, const VIRTUAL_BLOCK_DESC& desc) :
     m_AllocationCallbacks(allocationCallbacks),
-    m_Size(size),
-    m_Metadata(&m_AllocationCallbacks,
-        true) // isVirtual
+    m_Size(desc.Size)
+{
+    switch(desc.Flags & VIRTUAL_BLOCK_FLAG_ALGORITHM_MASK)
+    {
+    case VIRTUAL_BLOCK_FLAG_ALGORITHM_TLSF:
+        m_Metadata = D3D12MA_NEW(m_AllocationCallbacks, BlockMetadata_TLSF)(&m_AllocationCallbacks,
+            true); // isVirtual
+        break;
+    case VIRTUAL_BLOCK_FLAG_ALGORITHM_LINEAR:
+        m_Metadata = D3D12MA_NEW(m_AllocationCallbacks, BlockMetadata_Linear)(&m_AllocationCallbacks,
+            true); // isVirtual
+        break;
+    default:
+        D3D12MA_ASSERT(0);
+        // Fall-through.
+    case 0:
+        m_Metadata = D3D12MA_NEW(m_AllocationCallbacks, BlockMetadata_Generic)(&m_AllocationCallbacks,
+            true); // isVirtual
+        break;
+    }
+    m_Metadata->Init(m_Size);
+}
+
+VirtualBlockPimpl::~VirtualBlockPimpl()
 {
-    m_Metadata.Init(m_Size);
+    D3D12MA_DELETE(m_AllocationCallbacks, m_Metadata);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 // Public class VirtualBlock implementation
 
 VirtualBlock::VirtualBlock(const ALLOCATION_CALLBACKS& allocationCallbacks, const VIRTUAL_BLOCK_DESC& desc) :
-    m_Pimpl(D3D12MA_NEW(allocationCallbacks, VirtualBlockPimpl)(allocationCallbacks, desc.Size))
+    m_Pimpl(D3D12MA_NEW(allocationCallbacks, VirtualBlockPimpl)(allocationCallbacks, desc))
 {
 }
 
@@ -6361,7 +8627,7 @@ VirtualBlock::~VirtualBlock()
 {
     // THIS IS AN IMPORTANT ASSERT!
     // Hitting it means you have some memory leak - unreleased allocations in this virtual block.
-    D3D12MA_ASSERT(m_Pimpl->m_Metadata.IsEmpty() && "Some allocations were not freed before destruction of this virtual block!");
+    D3D12MA_ASSERT(m_Pimpl->m_Metadata->IsEmpty() && "Some allocations were not freed before destruction of this virtual block!");
 
     D3D12MA_DELETE(m_Pimpl->m_AllocationCallbacks, m_Pimpl);
 }
@@ -6377,7 +8643,7 @@ BOOL VirtualBlock::IsEmpty() const
 {
     D3D12MA_DEBUG_GLOBAL_MUTEX_LOCK
 
-    return m_Pimpl->m_Metadata.IsEmpty() ? TRUE : FALSE;
+    return m_Pimpl->m_Metadata->IsEmpty() ? TRUE : FALSE;
 }
 
 void VirtualBlock::GetAllocationInfo(UINT64 offset, VIRTUAL_ALLOCATION_INFO* pInfo) const
@@ -6386,7 +8652,7 @@ void VirtualBlock::GetAllocationInfo(UINT64 offset, VIRTUAL_ALLOCATION_INFO* pIn
 
     D3D12MA_DEBUG_GLOBAL_MUTEX_LOCK
 
-    m_Pimpl->m_Metadata.GetAllocationInfo(offset, *pInfo);
+    m_Pimpl->m_Metadata->GetAllocationInfo(offset, *pInfo);
 }
 
 HRESULT VirtualBlock::Allocate(const VIRTUAL_ALLOCATION_DESC* pDesc, UINT64* pOffset)
@@ -6402,11 +8668,12 @@ HRESULT VirtualBlock::Allocate(const VIRTUAL_ALLOCATION_DESC* pDesc, UINT64* pOf
     D3D12MA_DEBUG_GLOBAL_MUTEX_LOCK
         
     const UINT64 alignment = pDesc->Alignment != 0 ? pDesc->Alignment : 1;
+    const bool upperAddress = (pDesc->Flags & VIRTUAL_ALLOCATION_FLAG_UPPER_ADDRESS) != 0;
     AllocationRequest allocRequest = {};
-    if(m_Pimpl->m_Metadata.CreateAllocationRequest(pDesc->Size, alignment, &allocRequest))
+    if(m_Pimpl->m_Metadata->CreateAllocationRequest(pDesc->Size, alignment, upperAddress, &allocRequest))
     {
-        m_Pimpl->m_Metadata.Alloc(allocRequest, pDesc->Size, pDesc->pUserData);
-        D3D12MA_HEAVY_ASSERT(m_Pimpl->m_Metadata.Validate());
+        m_Pimpl->m_Metadata->Alloc(allocRequest, pDesc->Size, pDesc->pUserData);
+        D3D12MA_HEAVY_ASSERT(m_Pimpl->m_Metadata->Validate());
         *pOffset = allocRequest.offset;
         return S_OK;
     }
@@ -6422,16 +8689,16 @@ void VirtualBlock::FreeAllocation(UINT64 offset)
 
     D3D12MA_ASSERT(offset != UINT64_MAX);
         
-    m_Pimpl->m_Metadata.FreeAtOffset(offset);
-    D3D12MA_HEAVY_ASSERT(m_Pimpl->m_Metadata.Validate());
+    m_Pimpl->m_Metadata->FreeAtOffset(offset);
+    D3D12MA_HEAVY_ASSERT(m_Pimpl->m_Metadata->Validate());
 }
 
 void VirtualBlock::Clear()
 {
     D3D12MA_DEBUG_GLOBAL_MUTEX_LOCK
 
-    m_Pimpl->m_Metadata.Clear();
-    D3D12MA_HEAVY_ASSERT(m_Pimpl->m_Metadata.Validate());
+    m_Pimpl->m_Metadata->Clear();
+    D3D12MA_HEAVY_ASSERT(m_Pimpl->m_Metadata->Validate());
 }
 
 void VirtualBlock::SetAllocationUserData(UINT64 offset, void* pUserData)
@@ -6440,7 +8707,7 @@ void VirtualBlock::SetAllocationUserData(UINT64 offset, void* pUserData)
 
     D3D12MA_DEBUG_GLOBAL_MUTEX_LOCK
 
-    m_Pimpl->m_Metadata.SetAllocationUserData(offset, pUserData);
+    m_Pimpl->m_Metadata->SetAllocationUserData(offset, pUserData);
 }
 
 void VirtualBlock::CalculateStats(StatInfo* pInfo) const
@@ -6449,8 +8716,8 @@ void VirtualBlock::CalculateStats(StatInfo* pInfo) const
 
     D3D12MA_DEBUG_GLOBAL_MUTEX_LOCK
 
-    D3D12MA_HEAVY_ASSERT(m_Pimpl->m_Metadata.Validate());
-    m_Pimpl->m_Metadata.CalcAllocationStatInfo(*pInfo);
+    D3D12MA_HEAVY_ASSERT(m_Pimpl->m_Metadata->Validate());
+    m_Pimpl->m_Metadata->CalcAllocationStatInfo(*pInfo);
 }
 
 void VirtualBlock::BuildStatsString(WCHAR** ppStatsString) const
@@ -6462,8 +8729,8 @@ void VirtualBlock::BuildStatsString(WCHAR** ppStatsString) const
     StringBuilder sb(m_Pimpl->m_AllocationCallbacks);
     {
         JsonWriter json(m_Pimpl->m_AllocationCallbacks, sb);
-        D3D12MA_HEAVY_ASSERT(m_Pimpl->m_Metadata.Validate());
-        m_Pimpl->m_Metadata.WriteAllocationInfoToJson(json);
+        D3D12MA_HEAVY_ASSERT(m_Pimpl->m_Metadata->Validate());
+        m_Pimpl->m_Metadata->WriteAllocationInfoToJson(json);
     } // Scope for JsonWriter
 
     const size_t length = sb.GetLength();
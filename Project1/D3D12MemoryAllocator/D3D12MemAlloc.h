@@ -40,6 +40,7 @@ Documentation of all members: D3D12MemAlloc.h
         - [Mapping memory](@ref quick_start_mapping_memory)
     - \subpage custom_pools
     - \subpage resource_aliasing
+    - \subpage defragmentation
     - \subpage virtual_allocator
 - \subpage configuration
   - [Custom CPU memory allocator](@ref custom_memory_allocator)
@@ -158,10 +159,12 @@ class BlockVector;
 class CommittedAllocationList;
 class JsonWriter;
 class VirtualBlockPimpl;
+class DefragmentationContextPimpl;
 /// \endcond
 
 class Pool;
 class Allocator;
+class DefragmentationContext;
 struct StatInfo;
 
 /// Pointer to custom callback function that allocates CPU memory.
@@ -212,6 +215,13 @@ enum ALLOCATION_FLAGS
     memory budget. Otherwise return `E_OUTOFMEMORY`.
     */
     ALLOCATION_FLAG_WITHIN_BUDGET = 0x4,
+
+    /** Allocation will be created from upper stack in a double stack pool.
+
+    This flag is only allowed for custom pools created with #POOL_FLAG_ALGORITHM_LINEAR flag
+    and D3D12MA::POOL_DESC::MaxBlockCount = 1.
+    */
+    ALLOCATION_FLAG_UPPER_ADDRESS = 0x8,
 };
 
 /// \brief Parameters of created D3D12MA::Allocation object. To be used with Allocator::CreateResource.
@@ -335,12 +345,32 @@ public:
     */
     BOOL WasZeroInitialized() const { return m_PackedData.WasZeroInitialized(); }
 
+    /** \brief Releases the resource currently bound to the allocation, if any, and binds the new one.
+
+    The allocation takes its own reference to `pResource`, you still have to `Release` yours.
+    This is meant for D3D12MA::DEFRAGMENTATION_MOVE::pDstTmpAllocation: create a resource in its place
+    with D3D12MA::Allocator::CreateAliasingResource and bind it here, so that it takes the place of the
+    resource of the source allocation when the pass ends.
+    */
+    void SetResource(ID3D12Resource* pResource);
+
+    /** \brief Associates an opaque pointer with the allocation, e.g. the object that owns the resource.
+
+    The library never accesses it. It is useful to find your own object back from
+    D3D12MA::DEFRAGMENTATION_MOVE::pSrcAllocation during defragmentation.
+    */
+    void SetPrivateData(void* pPrivateData) { m_pPrivateData = pPrivateData; }
+
+    /// Returns the pointer set with Allocation::SetPrivateData, null by default.
+    void* GetPrivateData() const { return m_pPrivateData; }
+
 protected:
     virtual void ReleaseThis();
 
 private:
     friend class AllocatorPimpl;
     friend class BlockVector;
+    friend class DefragmentationContextPimpl;
     friend class CommittedAllocationList;
     friend class JsonWriter;
     friend struct CommittedAllocationListItemTraits;
@@ -360,6 +390,7 @@ private:
     ID3D12Resource* m_Resource;
     UINT m_CreationFrameIndex;
     wchar_t* m_Name;
+    void* m_pPrivateData;
 
     union
     {
@@ -373,6 +404,8 @@ private:
         struct
         {
             UINT64 offset;
+            // Needed again to place the allocation somewhere else during defragmentation.
+            UINT64 alignment;
             NormalBlock* block;
         } m_Placed;
 
@@ -421,14 +454,222 @@ private:
     void InitHeap(CommittedAllocationList* list, ID3D12Heap* heap);
     template<typename D3D12_RESOURCE_DESC_T>
     void SetResource(ID3D12Resource* resource, const D3D12_RESOURCE_DESC_T* pResourceDesc);
+    // Exchanges the place in the heap and the resource with given allocation. Both must be placed.
+    void SwapBlockAllocation(Allocation* allocation);
     void FreeName();
 
     D3D12MA_CLASS_NO_COPY(Allocation)
 };
 
+/// \brief Bit flags to be used with DEFRAGMENTATION_DESC::Flags.
+enum DEFRAGMENTATION_FLAGS
+{
+    /** Only moves allocations out of the least used heaps into the more used ones, so that whole heaps
+    become empty and can be released. Allocations are never moved within the same heap.
+    */
+    DEFRAGMENTATION_FLAG_ALGORITHM_FAST = 0x1,
+    /** Like #DEFRAGMENTATION_FLAG_ALGORITHM_FAST, and additionally moves allocations towards the beginning
+    of their own heap, which merges free ranges into bigger ones. Used when no algorithm is specified.
+    */
+    DEFRAGMENTATION_FLAG_ALGORITHM_FULL = 0x2,
+
+    /// A bit mask to extract only `ALGORITHM` bits from entire set of flags.
+    DEFRAGMENTATION_FLAG_ALGORITHM_MASK =
+        DEFRAGMENTATION_FLAG_ALGORITHM_FAST |
+        DEFRAGMENTATION_FLAG_ALGORITHM_FULL
+};
+
+/** \brief Parameters for defragmentation.
+
+To be used with functions Allocator::BeginDefragmentation() and Pool::BeginDefragmentation().
+*/
+struct DEFRAGMENTATION_DESC
+{
+    /// Flags.
+    DEFRAGMENTATION_FLAGS Flags;
+    /** \brief Maximum numbers of bytes that can be copied during single pass, while moving allocations to different places.
+
+    0 means no limit.
+    */
+    UINT64 MaxBytesPerPass;
+    /** \brief Maximum number of allocations that can be moved during single pass to a different place.
+
+    0 means no limit.
+    */
+    UINT32 MaxAllocationsPerPass;
+};
+
+/// Operation performed on single defragmentation move.
+enum DEFRAGMENTATION_MOVE_OPERATION
+{
+    /** The resource has been recreated at `pDstTmpAllocation` and its data copied there. The source allocation
+    takes over the new place and resource when the pass ends, the old place and resource are released.
+
+    This is the default value set by DefragmentationContext::BeginPass().
+    */
+    DEFRAGMENTATION_MOVE_OPERATION_COPY = 0,
+    /// The move is skipped, the source allocation stays where it is. Use it for resources that cannot be moved right now.
+    DEFRAGMENTATION_MOVE_OPERATION_IGNORE = 1,
+    /** The resource is not needed anymore. The source allocation is released together with its resource,
+    so you must not release it yourself.
+    */
+    DEFRAGMENTATION_MOVE_OPERATION_DESTROY = 2,
+};
+
+/// Single move of an allocation to be done for defragmentation.
+struct DEFRAGMENTATION_MOVE
+{
+    /** \brief Operation to be performed on the allocation by DefragmentationContext::EndPass().
+
+    Default value is #DEFRAGMENTATION_MOVE_OPERATION_COPY. You can modify it.
+    */
+    DEFRAGMENTATION_MOVE_OPERATION Operation;
+    /// %Allocation that should be moved.
+    Allocation* pSrcAllocation;
+    /** \brief Temporary allocation pointing to destination memory that will replace `pSrcAllocation`.
+
+    Use it to create a resource in its place with Allocator::CreateAliasingResource(), bind that resource
+    with Allocation::SetResource(), and record the copy from the resource of `pSrcAllocation`.
+
+    \warning Do not store this allocation in your data structures! It exists only temporarily, for the duration of the pass,
+    and is released by DefragmentationContext::EndPass().
+    */
+    Allocation* pDstTmpAllocation;
+};
+
+/** \brief Parameters for incremental defragmentation steps.
+
+To be used with function DefragmentationContext::BeginPass().
+*/
+struct DEFRAGMENTATION_PASS_MOVE_INFO
+{
+    /// Number of elements in the `pMoves` array.
+    UINT32 MoveCount;
+    /** \brief Array of moves to be performed by the user in the current defragmentation pass.
+
+    Pointer to an array of `MoveCount` elements, owned by the library, filled by DefragmentationContext::BeginPass().
+
+    For each element, either record the copy as described by D3D12MA::DEFRAGMENTATION_MOVE::pDstTmpAllocation,
+    or change its `Operation`. The copies must have finished executing on the GPU, and nothing may use
+    the old resource anymore, before DefragmentationContext::EndPass() is called.
+    */
+    DEFRAGMENTATION_MOVE* pMoves;
+};
+
+/// %Statistics returned for defragmentation process by function DefragmentationContext::GetStats().
+struct DEFRAGMENTATION_STATS
+{
+    /// Total number of bytes that have been copied while moving allocations to different places.
+    UINT64 BytesMoved;
+    /// Total number of bytes that have been released to the system by freeing empty heaps.
+    UINT64 BytesFreed;
+    /// Number of allocations that have been moved to different places.
+    UINT32 AllocationsMoved;
+    /// Number of empty `ID3D12Heap` objects that have been released to the system.
+    UINT32 HeapsFreed;
+};
+
+/** \brief Represents defragmentation process in progress.
+
+You can create this object using Allocator::BeginDefragmentation() for the default pools,
+or Pool::BeginDefragmentation() for a custom pool. Call `Release()` to destroy it.
+
+Every pass only plans moves with bookkeeping of the heaps, nothing is done to the device
+until DefragmentationContext::EndPass() releases the places allocations were moved from.
+*/
+class D3D12MA_API DefragmentationContext : public IUnknownImpl
+{
+public:
+    /** \brief Starts single defragmentation pass.
+
+    \param[out] pPassInfo Computed information for current pass.
+    \returns
+    - `S_OK` if no more moves are possible. Then you can omit call to DefragmentationContext::EndPass() and simply end whole defragmentation.
+    - `S_FALSE` if there are pending moves returned in `pPassInfo`. You need to perform them, call DefragmentationContext::EndPass(),
+      and then preferably try another pass with DefragmentationContext::BeginPass().
+    */
+    HRESULT BeginPass(DEFRAGMENTATION_PASS_MOVE_INFO* pPassInfo);
+    /** \brief Ends single defragmentation pass.
+
+    \param pPassInfo Computed information for current pass filled by DefragmentationContext::BeginPass() and possibly modified by you.
+    \return Returns `S_OK` if no more moves are possible or `S_FALSE` if more defragmentations are possible.
+
+    Ends incremental defragmentation pass and commits all defragmentation moves from `pPassInfo`.
+    After this call:
+
+    - %Allocation at `pPassInfo[i].pSrcAllocation` that had `pPassInfo[i].Operation ==` #DEFRAGMENTATION_MOVE_OPERATION_COPY
+      (which is the default) will be pointing to the new destination place and own the resource bound to `pDstTmpAllocation`.
+    - %Allocation at `pPassInfo[i].pSrcAllocation` that had `pPassInfo[i].Operation ==` #DEFRAGMENTATION_MOVE_OPERATION_DESTROY
+      will be released.
+    */
+    HRESULT EndPass(DEFRAGMENTATION_PASS_MOVE_INFO* pPassInfo);
+    /** \brief Returns statistics of the defragmentation performed so far.
+    */
+    void GetStats(DEFRAGMENTATION_STATS* pStats);
+
+protected:
+    virtual void ReleaseThis();
+
+private:
+    friend class Pool;
+    friend class Allocator;
+    template<typename T> friend void D3D12MA_DELETE(const ALLOCATION_CALLBACKS&, T*);
+
+    DefragmentationContextPimpl* m_Pimpl;
+
+    DefragmentationContext(AllocatorPimpl* allocator,
+        const DEFRAGMENTATION_DESC& desc,
+        BlockVector* poolVector);
+    ~DefragmentationContext();
+
+    D3D12MA_CLASS_NO_COPY(DefragmentationContext)
+};
+
+/// \brief Bit flags to be used with POOL_DESC::Flags.
+enum POOL_FLAGS
+{
+    /// Zero
+    POOL_FLAG_NONE = 0,
+
+    /** \brief Enables alternative, TLSF allocation algorithm in the heaps of this pool.
+
+    Free ranges are kept in two-level segregated lists with bitmaps of the non-empty ones, so finding,
+    splitting and merging a free range take constant time regardless of how many allocations a block holds.
+    Prefer it for pools holding many small allocations, e.g. thousands of buffers in one heap.
+    By default the generic algorithm keeping free ranges sorted by size is used.
+    */
+    POOL_FLAG_ALGORITHM_TLSF = 0x1,
+
+    /** \brief Enables alternative, linear allocation algorithm in this pool.
+
+    Specify this flag to enable linear allocation algorithm, which always creates
+    new allocations after last one and doesn't reuse space from allocations freed in
+    between. It trades memory consumption for simplified algorithm and data
+    structure, which has better performance and uses less memory for metadata.
+
+    Freeing the oldest or the most recent allocation takes constant time, so the pool can be used as:
+
+    - stack - allocations freed in reverse order of creation,
+    - ring buffer - allocations freed in order of creation, e.g. per-frame transient buffers,
+    - double stack - together with #ALLOCATION_FLAG_UPPER_ADDRESS, allocations created from both ends of the heap.
+
+    Ring buffer and double stack require D3D12MA::POOL_DESC::MaxBlockCount = 1, and usually an explicit
+    D3D12MA::POOL_DESC::BlockSize.
+    */
+    POOL_FLAG_ALGORITHM_LINEAR = 0x2,
+
+    /// Bit mask to extract only `ALGORITHM` bits from entire set of flags.
+    POOL_FLAG_ALGORITHM_MASK = POOL_FLAG_ALGORITHM_TLSF | POOL_FLAG_ALGORITHM_LINEAR,
+};
+
 /// \brief Parameters of created D3D12MA::Pool object. To be used with D3D12MA::Allocator::CreatePool.
 struct POOL_DESC
 {
+    /** \brief Flags.
+
+    Use #POOL_FLAG_ALGORITHM_TLSF or #POOL_FLAG_ALGORITHM_LINEAR to pick the allocation algorithm used inside the heaps of this pool.
+    */
+    POOL_FLAGS Flags;
     /** \brief The parameters of memory heap where allocations of this pool should be placed.
 
     In the simplest case, just fill it with zeros and set `Type` to one of: `D3D12_HEAP_TYPE_DEFAULT`,
@@ -517,6 +758,20 @@ public:
     */
     LPCWSTR GetName() const;
 
+    /** \brief Begins defragmentation process of the current pool.
+
+    \param pDesc Structure filled with parameters of defragmentation.
+    \param[out] ppContext Context object that will manage defragmentation.
+    \returns
+    - `S_OK` if defragmentation can begin.
+    - `E_NOINTERFACE` if defragmentation is not supported, which is the case for pools created with #POOL_FLAG_ALGORITHM_LINEAR.
+
+    Only allocations placed in the heaps of the pool are moved, committed allocations are left alone.
+    For more information about defragmentation, see documentation chapter:
+    [Defragmentation](@ref defragmentation).
+    */
+    HRESULT BeginDefragmentation(const DEFRAGMENTATION_DESC* pDesc, DefragmentationContext** ppContext);
+
 protected:
     virtual void ReleaseThis();
 
@@ -844,6 +1099,17 @@ public:
     /// Frees memory of a string returned from Allocator::BuildStatsString.
     void FreeStatsString(WCHAR* pStatsString) const;
 
+    /** \brief Begins defragmentation process of the default pools.
+
+    \param pDesc Structure filled with parameters of defragmentation.
+    \param[out] ppContext Context object that will manage defragmentation.
+
+    Custom pools are not included, defragment them with Pool::BeginDefragmentation().
+    For more information about defragmentation, see documentation chapter:
+    [Defragmentation](@ref defragmentation).
+    */
+    void BeginDefragmentation(const DEFRAGMENTATION_DESC* pDesc, DefragmentationContext** ppContext);
+
 protected:
     virtual void ReleaseThis();
 
@@ -860,9 +1126,36 @@ private:
     D3D12MA_CLASS_NO_COPY(Allocator)
 };
 
+/// \brief Bit flags to be used with VIRTUAL_BLOCK_DESC::Flags.
+enum VIRTUAL_BLOCK_FLAGS
+{
+    /// Zero
+    VIRTUAL_BLOCK_FLAG_NONE = 0,
+
+    /** \brief Enables alternative, TLSF allocation algorithm in virtual block.
+
+    Same algorithm as D3D12MA::POOL_FLAG_ALGORITHM_TLSF.
+    */
+    VIRTUAL_BLOCK_FLAG_ALGORITHM_TLSF = 0x1,
+
+    /** \brief Enables alternative, linear allocation algorithm in virtual block.
+
+    Same algorithm as D3D12MA::POOL_FLAG_ALGORITHM_LINEAR.
+    */
+    VIRTUAL_BLOCK_FLAG_ALGORITHM_LINEAR = 0x2,
+
+    /// Bit mask to extract only `ALGORITHM` bits from entire set of flags.
+    VIRTUAL_BLOCK_FLAG_ALGORITHM_MASK = VIRTUAL_BLOCK_FLAG_ALGORITHM_TLSF | VIRTUAL_BLOCK_FLAG_ALGORITHM_LINEAR,
+};
+
 /// Parameters of created D3D12MA::VirtualBlock object to be passed to CreateVirtualBlock().
 struct VIRTUAL_BLOCK_DESC
 {
+    /** \brief Flags.
+
+    Use #VIRTUAL_BLOCK_FLAG_ALGORITHM_TLSF or #VIRTUAL_BLOCK_FLAG_ALGORITHM_LINEAR to pick the allocation algorithm.
+    */
+    VIRTUAL_BLOCK_FLAGS Flags;
     /** \brief Total size of the block.
 
     Sizes can be expressed in bytes or any units you want as long as you are consistent in using them.
@@ -876,9 +1169,24 @@ struct VIRTUAL_BLOCK_DESC
     const ALLOCATION_CALLBACKS* pAllocationCallbacks;
 };
 
+/// \brief Bit flags to be used with VIRTUAL_ALLOCATION_DESC::Flags.
+enum VIRTUAL_ALLOCATION_FLAGS
+{
+    /// Zero
+    VIRTUAL_ALLOCATION_FLAG_NONE = 0,
+
+    /** \brief Allocation will be created from upper stack in a double stack block.
+
+    This flag is only allowed for virtual blocks created with #VIRTUAL_BLOCK_FLAG_ALGORITHM_LINEAR flag.
+    */
+    VIRTUAL_ALLOCATION_FLAG_UPPER_ADDRESS = ALLOCATION_FLAG_UPPER_ADDRESS,
+};
+
 /// Parameters of created virtual allocation to be passed to VirtualBlock::Allocate().
 struct VIRTUAL_ALLOCATION_DESC
 {
+    /// Flags.
+    VIRTUAL_ALLOCATION_FLAGS Flags;
     /** \brief Size of the allocation.
     
     Cannot be zero.
@@ -993,6 +1301,10 @@ D3D12MA_API HRESULT CreateVirtualBlock(const VIRTUAL_BLOCK_DESC* pDesc, VirtualB
 /// \cond INTERNAL
 DEFINE_ENUM_FLAG_OPERATORS(D3D12MA::ALLOCATION_FLAGS);
 DEFINE_ENUM_FLAG_OPERATORS(D3D12MA::ALLOCATOR_FLAGS);
+DEFINE_ENUM_FLAG_OPERATORS(D3D12MA::POOL_FLAGS);
+DEFINE_ENUM_FLAG_OPERATORS(D3D12MA::VIRTUAL_BLOCK_FLAGS);
+DEFINE_ENUM_FLAG_OPERATORS(D3D12MA::VIRTUAL_ALLOCATION_FLAGS);
+DEFINE_ENUM_FLAG_OPERATORS(D3D12MA::DEFRAGMENTATION_FLAGS);
 /// \endcond
 
 /**
@@ -1242,6 +1554,10 @@ more opportunities for internal optimizations, custom pools may be useful in fol
   `D3D12_HEAP_PROPERTIES` (member D3D12MA::POOL_DESC::HeapProperties) and `D3D12_HEAP_FLAGS`
   (D3D12MA::POOL_DESC::HeapFlags), which is useful e.g. for cross-adapter sharing or UMA
   (see also D3D12MA::Allocator::IsUMA).
+- To use a different allocation algorithm inside the heaps. Set D3D12MA::POOL_FLAG_ALGORITHM_TLSF in
+  D3D12MA::POOL_DESC::Flags to keep allocation and freeing constant time when a heap holds thousands of small
+  allocations, or D3D12MA::POOL_FLAG_ALGORITHM_LINEAR to use the heap as a stack, ring buffer or double stack,
+  e.g. for per-frame transient buffers.
 
 New versions of this library support creating **committed allocations in custom pools**.
 It is supported only when D3D12MA::POOL_DESC::BlockSize = 0.
@@ -1379,6 +1695,146 @@ Additional considerations:
   Otherwise they must be placed in different memory heap types, and thus aliasing them is not possible.
 
 
+\page defragmentation Defragmentation
+
+Interleaved allocations and deallocations of many objects of varying size can
+cause fragmentation over time, which can lead to a situation where the library is unable
+to find a continuous range of free memory for a new allocation despite there is
+enough free space, just scattered across many small free ranges between existing
+allocations, and heaps that are kept alive by only a few small allocations.
+
+To mitigate this problem, you can use defragmentation feature.
+It doesn't happen automatically though and needs your cooperation,
+because D3D12MA is a low level library that only allocates memory.
+It cannot recreate buffers and textures in a new place as it doesn't remember their parameters,
+it cannot copy their contents as it doesn't record any commands to a command list,
+and it doesn't know when the GPU is done with the old ones.
+
+Example:
+
+\code
+D3D12MA::DEFRAGMENTATION_DESC defragDesc = {};
+defragDesc.Flags = D3D12MA::DEFRAGMENTATION_FLAG_ALGORITHM_FAST;
+defragDesc.MaxBytesPerPass = 32ull * 1024 * 1024;
+
+D3D12MA::DefragmentationContext* defragCtx;
+allocator->BeginDefragmentation(&defragDesc, &defragCtx);
+
+for(;;)
+{
+    D3D12MA::DEFRAGMENTATION_PASS_MOVE_INFO pass;
+    HRESULT hr = defragCtx->BeginPass(&pass);
+    if(hr == S_OK)
+        break;
+    else if(hr != S_FALSE)
+        // Handle error...
+
+    for(UINT i = 0; i < pass.MoveCount; ++i)
+    {
+        // Inspect pass.pMoves[i].pSrcAllocation, identify what buffer/texture it represents.
+        MyEngineResourceData* resData = (MyEngineResourceData*)pass.pMoves[i].pSrcAllocation->GetPrivateData();
+            
+        // Recreate this buffer/texture as placed at pass.pMoves[i].pDstTmpAllocation.
+        D3D12_RESOURCE_DESC resDesc = ...
+        ID3D12Resource* newRes;
+        hr = allocator->CreateAliasingResource(
+            pass.pMoves[i].pDstTmpAllocation,
+            0, // AllocationLocalOffset
+            resData->desc,
+            D3D12_RESOURCE_STATE_COPY_DEST,
+            NULL, // pOptimizedClearValue
+            IID_PPV_ARGS(&newRes));
+        // Check hr...
+
+        // Store new resource in the pDstTmpAllocation.
+        pass.pMoves[i].pDstTmpAllocation->SetResource(newRes);
+
+        // Copy its content to the new place.
+        cmdList->CopyResource(
+            pass.pMoves[i].pDstTmpAllocation->GetResource(),
+            pass.pMoves[i].pSrcAllocation->GetResource());
+    }
+        
+    // Make sure the copy commands finished executing and nothing uses the old resources anymore.
+    cmdQueue->ExecuteCommandLists(...);
+    // Wait for fence...
+        
+    // Update your references to the new resources, release your references to the old ones.
+    // The allocations stay the same objects.
+    for(UINT i = 0; i < pass.MoveCount; ++i)
+    {
+        MyEngineResourceData* resData = (MyEngineResourceData*)pass.pMoves[i].pSrcAllocation->GetPrivateData();
+        resData->resource->Release();
+        // Takes over the reference returned by CreateAliasingResource.
+        resData->resource = pass.pMoves[i].pDstTmpAllocation->GetResource();
+    }
+        
+    hr = defragCtx->EndPass(&pass);
+    if(hr == S_OK)
+        break;
+    else if(hr != S_FALSE)
+        // Handle error...
+}
+
+D3D12MA::DEFRAGMENTATION_STATS stats = {};
+defragCtx->GetStats(&stats);
+defragCtx->Release();
+\endcode
+
+Although functions like D3D12MA::Allocator::CreateResource() create an allocation and a buffer/texture at once,
+these are just a shortcut for allocating memory and creating a placed resource.
+Defragmentation works on memory allocations only. You must handle the rest manually.
+Defragmentation is an iterative process that should repeat "passes" as long as related functions
+return `S_FALSE` not `S_OK`.
+In each pass:
+
+1. D3D12MA::DefragmentationContext::BeginPass() function call:
+   - Calculates and returns the list of allocations to be moved in this pass.
+     Note this can be a time-consuming process.
+   - Reserves destination memory for them by creating temporary destination allocations
+     that you can query for their D3D12MA::Allocation::GetHeap() + D3D12MA::Allocation::GetOffset().
+2. Inside the pass, **you should**:
+   - Inspect the returned list of allocations to be moved.
+   - Create new buffers/textures as placed at the returned destination temporary allocations.
+   - Copy data from source to destination resources if necessary.
+   - Wait until the copies and all earlier GPU work that uses the source resources has finished.
+   - Update your references to the new resources and release the old ones.
+3. D3D12MA::DefragmentationContext::EndPass() function call:
+   - Frees the source memory reserved for the allocations that are moved.
+   - Modifies source D3D12MA::Allocation objects that are moved to point to the destination reserved memory
+     and destination resource, while source resource is released.
+   - Frees `ID3D12Heap` blocks that became empty.
+
+Defragmentation algorithm tries to move all suitable allocations.
+You can, however, refuse to move some of them inside a defragmentation pass, by setting
+`pass.pMoves[i].Operation` to D3D12MA::DEFRAGMENTATION_MOVE_OPERATION_IGNORE.
+This is not recommended and may result in suboptimal packing of the allocations after defragmentation.
+If you cannot ensure any allocation can be moved, it is better to keep movable allocations separate in a custom pool.
+
+Inside a pass, for each allocation that should be moved:
+
+- You should copy its data from the source to the destination place by calling e.g. `CopyResource()`.
+  - You need to make sure these commands finished executing before the source resource is released by
+    D3D12MA::DefragmentationContext::EndPass().
+- If a resource doesn't contain any meaningful data, e.g. it is a transient render-target texture to be cleared,
+  filled, and used temporarily in each rendering frame, you can just recreate it and skip the copy.
+- If the resource will not be used in the future, you can set `pass.pMoves[i].Operation` to
+  D3D12MA::DEFRAGMENTATION_MOVE_OPERATION_DESTROY.
+
+You can defragment a specific custom pool by calling D3D12MA::Pool::BeginDefragmentation
+or all the default pools by calling D3D12MA::Allocator::BeginDefragmentation (like in the example above).
+
+Defragmentation is always performed in each pool separately.
+Allocations are never moved between different heap types.
+The size of the destination memory reserved for a moved allocation is the same as the original one.
+Alignment of an allocation as it was determined using `GetResourceAllocationInfo()` is also respected after defragmentation.
+Buffers/textures should be recreated with the same `D3D12_RESOURCE_DESC` parameters as the original ones.
+
+Computing the moves only touches the bookkeeping of the heaps, never the device. Custom pools created with
+D3D12MA::POOL_FLAG_ALGORITHM_LINEAR cannot be defragmented, as their allocations are not meant to live long.
+Do not free the source allocations yourself during a pass, change their `Operation` instead.
+
+
 \page virtual_allocator Virtual allocator
 
 As an extra feature, the core allocation algorithm of the library is exposed through a simple and convenient API of "virtual allocator".
@@ -1602,7 +2058,6 @@ Near future: feature parity with [Vulkan Memory Allocator](https://github.com/GP
 
 Later:
 
-- Memory defragmentation
 - Support for multi-GPU (multi-adapter)
 
 \section general_considerations_features_not_supported Features not supported
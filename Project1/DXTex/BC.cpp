@@ -34,6 +34,10 @@ namespace DirectX
 static const HDRColorA g_Luminance   (0.2125f / 0.7154f, 1.0f, 0.0721f / 0.7154f, 1.0f);
 static const HDRColorA g_LuminanceInv(0.7154f / 0.2125f, 1.0f, 0.7154f / 0.0721f, 1.0f);
 
+// Newton iterations OptimizeRGB refines the endpoints with, BC_FLAGS_FAST and BC_FLAGS_ULTRAFAST take fewer
+static const size_t g_OptimizeIterations     = 8;
+static const size_t g_OptimizeIterationsFast = 2;
+
 //-------------------------------------------------------------------------------------
 // Decode/Encode RGB 5/6/5 colors
 //-------------------------------------------------------------------------------------
@@ -210,8 +214,9 @@ static void OptimizeRGB(_Out_ HDRColorA *pX, _Out_ HDRColorA *pY,
 
     // Use Newton's Method to find local minima of sum-of-squares error.
     float fSteps = (float) (cSteps - 1);
+    const size_t cIterations = (flags & (BC_FLAGS_FAST|BC_FLAGS_ULTRAFAST)) ? g_OptimizeIterationsFast : g_OptimizeIterations;
 
-    for(size_t iIteration = 0; iIteration < 8; iIteration++)
+    for(size_t iIteration = 0; iIteration < cIterations; iIteration++)
     {
         // Calculate new steps
         HDRColorA pSteps[4];
@@ -319,9 +324,9 @@ static void OptimizeRGB(_Out_ HDRColorA *pX, _Out_ HDRColorA *pY,
 
 
 //-------------------------------------------------------------------------------------
-inline static void DecodeBC1( _Out_writes_(NUM_PIXELS_PER_BLOCK) XMVECTOR *pColor, _In_ const D3DX_BC1 *pBC, _In_ bool isbc1 )
+inline static void DecodeBC1Palette( _Out_writes_(4) XMVECTOR *pPalette, _In_ const D3DX_BC1 *pBC, _In_ bool isbc1 )
 {
-    assert( pColor && pBC );
+    assert( pPalette && pBC );
     static_assert( sizeof(D3DX_BC1) == 8, "D3DX_BC1 should be 8 bytes" );
 
     static XMVECTORF32 s_Scale = { 1.f/31.f, 1.f/63.f, 1.f/31.f, 1.f };
@@ -350,23 +355,150 @@ inline static void DecodeBC1( _Out_writes_(NUM_PIXELS_PER_BLOCK) XMVECTOR *pColo
         clr3 = XMVectorLerp( clr0, clr1, 2.f/3.f );
     }
 
+    pPalette[0] = clr0;
+    pPalette[1] = clr1;
+    pPalette[2] = clr2;
+    pPalette[3] = clr3;
+}
+
+inline static void DecodeBC1( _Out_writes_(NUM_PIXELS_PER_BLOCK) XMVECTOR *pColor, _In_ const D3DX_BC1 *pBC, _In_ bool isbc1 )
+{
+    assert( pColor && pBC );
+
+    XMVECTOR clr[4];
+    DecodeBC1Palette( clr, pBC, isbc1 );
+
     uint32_t dw = pBC->bitmap;
 
     for(size_t i = 0; i < NUM_PIXELS_PER_BLOCK; ++i, dw >>= 2)
     {
-        switch(dw & 3)
-        {
-        case 0: pColor[i] = clr0; break;
-        case 1: pColor[i] = clr1; break;
-        case 2: pColor[i] = clr2; break;
+        pColor[i] = clr[dw & 3];
+    }
+}
 
-        case 3:
-        default: pColor[i] = clr3; break;
-        }
+inline static void DecodeBC3Alpha( _Out_writes_(8) float *fAlpha, _In_ const D3DX_BC3 *pBC3 )
+{
+    fAlpha[0] = ((float) pBC3->alpha[0]) * (1.0f / 255.0f);
+    fAlpha[1] = ((float) pBC3->alpha[1]) * (1.0f / 255.0f);
+
+    if(pBC3->alpha[0] > pBC3->alpha[1]) 
+    {
+        for(size_t i = 1; i < 7; ++i)
+            fAlpha[i + 1] = (fAlpha[0] * (7 - i) + fAlpha[1] * i) * (1.0f / 7.0f);
+    }
+    else 
+    {
+        for(size_t i = 1; i < 5; ++i)
+            fAlpha[i + 1] = (fAlpha[0] * (5 - i) + fAlpha[1] * i) * (1.0f / 5.0f);
+
+        fAlpha[6] = 0.0f;
+        fAlpha[7] = 1.0f;
     }
 }
 
 
+//-------------------------------------------------------------------------------------
+// Quantizes the endpoints found by OptimizeRGB, orders them for the block's mode and
+// sets up the color steps and the direction pixels are projected onto. Returns false
+// when a 4 step block collapses to a single color, pBC is complete then.
+//-------------------------------------------------------------------------------------
+static bool QuantizeBC1Endpoints(_Out_ D3DX_BC1 *pBC, _Out_writes_(4) HDRColorA *Step, _Out_ HDRColorA *pDir,
+                                 _In_ HDRColorA ColorA, _In_ HDRColorA ColorB, _In_ size_t uSteps, _In_ DWORD flags)
+{
+    HDRColorA ColorC, ColorD;
+
+    if ( flags & BC_FLAGS_UNIFORM )
+    {
+        ColorC = ColorA;
+        ColorD = ColorB;
+    }
+    else
+    {
+        ColorC.r = ColorA.r * g_LuminanceInv.r;
+        ColorC.g = ColorA.g * g_LuminanceInv.g;
+        ColorC.b = ColorA.b * g_LuminanceInv.b;
+
+        ColorD.r = ColorB.r * g_LuminanceInv.r;
+        ColorD.g = ColorB.g * g_LuminanceInv.g;
+        ColorD.b = ColorB.b * g_LuminanceInv.b;
+    }
+
+    uint16_t wColorA = Encode565(&ColorC);
+    uint16_t wColorB = Encode565(&ColorD);
+
+    if((uSteps == 4) && (wColorA == wColorB))
+    {
+        pBC->rgb[0] = wColorA;
+        pBC->rgb[1] = wColorB;
+        pBC->bitmap = 0x00000000;
+        return false;
+    }
+
+    Decode565(&ColorC, wColorA);
+    Decode565(&ColorD, wColorB);
+
+    if ( flags & BC_FLAGS_UNIFORM )
+    {
+        ColorA = ColorC;
+        ColorB = ColorD;
+    }
+    else
+    {
+        ColorA.r = ColorC.r * g_Luminance.r;
+        ColorA.g = ColorC.g * g_Luminance.g;
+        ColorA.b = ColorC.b * g_Luminance.b;
+
+        ColorB.r = ColorD.r * g_Luminance.r;
+        ColorB.g = ColorD.g * g_Luminance.g;
+        ColorB.b = ColorD.b * g_Luminance.b;
+    }
+
+    // Calculate color steps
+    if((3 == uSteps) == (wColorA <= wColorB))
+    {
+        pBC->rgb[0] = wColorA;
+        pBC->rgb[1] = wColorB;
+
+        Step[0] = ColorA;
+        Step[1] = ColorB;
+    }
+    else
+    {
+        pBC->rgb[0] = wColorB;
+        pBC->rgb[1] = wColorA;
+
+        Step[0] = ColorB;
+        Step[1] = ColorA;
+    }
+
+    if(3 == uSteps)
+    {
+        HDRColorALerp(&Step[2], &Step[0], &Step[1], 0.5f);
+    }
+    else
+    {
+        HDRColorALerp(&Step[2], &Step[0], &Step[1], 1.0f / 3.0f);
+        HDRColorALerp(&Step[3], &Step[0], &Step[1], 2.0f / 3.0f);
+    }
+
+    // Calculate color direction
+    HDRColorA Dir;
+
+    Dir.r = Step[1].r - Step[0].r;
+    Dir.g = Step[1].g - Step[0].g;
+    Dir.b = Step[1].b - Step[0].b;
+
+    float fSteps = (float) (uSteps - 1);
+    float fScale = (wColorA != wColorB) ? (fSteps / (Dir.r * Dir.r + Dir.g * Dir.g + Dir.b * Dir.b)) : 0.0f;
+
+    Dir.r *= fScale;
+    Dir.g *= fScale;
+    Dir.b *= fScale;
+
+    *pDir = Dir;
+    return true;
+}
+
 //-------------------------------------------------------------------------------------
 
 static void EncodeBC1(_Out_ D3DX_BC1 *pBC, _In_reads_(NUM_PIXELS_PER_BLOCK) const HDRColorA *pColor,
@@ -487,107 +619,18 @@ static void EncodeBC1(_Out_ D3DX_BC1 *pBC, _In_reads_(NUM_PIXELS_PER_BLOCK) cons
 
     // Perform 6D root finding function to find two endpoints of color axis.
     // Then quantize and sort the endpoints depending on mode.
-    HDRColorA ColorA, ColorB, ColorC, ColorD;
+    HDRColorA ColorA, ColorB;
 
     OptimizeRGB(&ColorA, &ColorB, Color, uSteps, flags);
 
-    if ( flags & BC_FLAGS_UNIFORM )
-    {
-        ColorC = ColorA;
-        ColorD = ColorB;
-    }
-    else
-    {
-        ColorC.r = ColorA.r * g_LuminanceInv.r;
-        ColorC.g = ColorA.g * g_LuminanceInv.g;
-        ColorC.b = ColorA.b * g_LuminanceInv.b;
-
-        ColorD.r = ColorB.r * g_LuminanceInv.r;
-        ColorD.g = ColorB.g * g_LuminanceInv.g;
-        ColorD.b = ColorB.b * g_LuminanceInv.b;
-    }
-
-    uint16_t wColorA = Encode565(&ColorC);
-    uint16_t wColorB = Encode565(&ColorD);
-
-    if((uSteps == 4) && (wColorA == wColorB))
-    {
-        pBC->rgb[0] = wColorA;
-        pBC->rgb[1] = wColorB;
-        pBC->bitmap = 0x00000000;
+    HDRColorA Step[4], Dir;
+    if ( !QuantizeBC1Endpoints(pBC, Step, &Dir, ColorA, ColorB, uSteps, flags) )
         return;
-    }
-
-    Decode565(&ColorC, wColorA);
-    Decode565(&ColorD, wColorB);
-
-    if ( flags & BC_FLAGS_UNIFORM )
-    {
-        ColorA = ColorC;
-        ColorB = ColorD;
-    }
-    else
-    {
-        ColorA.r = ColorC.r * g_Luminance.r;
-        ColorA.g = ColorC.g * g_Luminance.g;
-        ColorA.b = ColorC.b * g_Luminance.b;
-
-        ColorB.r = ColorD.r * g_Luminance.r;
-        ColorB.g = ColorD.g * g_Luminance.g;
-        ColorB.b = ColorD.b * g_Luminance.b;
-    }
-
-    // Calculate color steps
-    HDRColorA Step[4];
-
-    if((3 == uSteps) == (wColorA <= wColorB))
-    {
-        pBC->rgb[0] = wColorA;
-        pBC->rgb[1] = wColorB;
-
-        Step[0] = ColorA;
-        Step[1] = ColorB;
-    }
-    else
-    {
-        pBC->rgb[0] = wColorB;
-        pBC->rgb[1] = wColorA;
-
-        Step[0] = ColorB;
-        Step[1] = ColorA;
-    }
 
     static const size_t pSteps3[] = { 0, 2, 1 };
     static const size_t pSteps4[] = { 0, 2, 3, 1 };
-    const size_t *pSteps;
-
-    if(3 == uSteps)
-    {
-        pSteps = pSteps3;
-
-        HDRColorALerp(&Step[2], &Step[0], &Step[1], 0.5f);
-    }
-    else
-    {
-        pSteps = pSteps4;
-
-        HDRColorALerp(&Step[2], &Step[0], &Step[1], 1.0f / 3.0f);
-        HDRColorALerp(&Step[3], &Step[0], &Step[1], 2.0f / 3.0f);
-    }
-
-    // Calculate color direction
-    HDRColorA Dir;
-
-    Dir.r = Step[1].r - Step[0].r;
-    Dir.g = Step[1].g - Step[0].g;
-    Dir.b = Step[1].b - Step[0].b;
-
+    const size_t *pSteps = (3 == uSteps) ? pSteps3 : pSteps4;
     float fSteps = (float) (uSteps - 1);
-    float fScale = (wColorA != wColorB) ? (fSteps / (Dir.r * Dir.r + Dir.g * Dir.g + Dir.b * Dir.b)) : 0.0f;
-
-    Dir.r *= fScale;
-    Dir.g *= fScale;
-    Dir.b *= fScale;
 
     // Encode colors
     uint32_t dw = 0;
@@ -711,45 +754,570 @@ static void EncodeSolidBC1(_Out_ D3DX_BC1 *pBC, _In_reads_(NUM_PIXELS_PER_BLOCK)
 #endif // COLOR_WEIGHTS
 
 
-//=====================================================================================
-// Entry points
-//=====================================================================================
-
 //-------------------------------------------------------------------------------------
-// BC1 Compression
-//-------------------------------------------------------------------------------------
-_Use_decl_annotations_
-void D3DXDecodeBC1(XMVECTOR *pColor, const uint8_t *pBC)
-{
-    auto pBC1 = reinterpret_cast<const D3DX_BC1 *>(pBC);
-    DecodeBC1( pColor, pBC1, true );
-}
-
-_Use_decl_annotations_
-void D3DXEncodeBC1(uint8_t *pBC, const XMVECTOR *pColor, float alphaRef, DWORD flags)
+static void EncodeBC3Alpha(_Inout_ D3DX_BC3 *pBC3, _In_reads_(NUM_PIXELS_PER_BLOCK) const HDRColorA *Color, _In_ DWORD flags)
 {
-    assert( pBC && pColor );
+    // Quantize block to A8, using Floyd Stienberg error diffusion.  This 
+    // increases the chance that colors will map directly to the quantized 
+    // axis endpoints.
+    float fAlpha[NUM_PIXELS_PER_BLOCK];
+    float fError[NUM_PIXELS_PER_BLOCK];
 
-    HDRColorA Color[NUM_PIXELS_PER_BLOCK];
+    float fMinAlpha = Color[0].a;
+    float fMaxAlpha = Color[0].a;
 
     if (flags & BC_FLAGS_DITHER_A)
-    {
-        float fError[NUM_PIXELS_PER_BLOCK];
         memset(fError, 0x00, NUM_PIXELS_PER_BLOCK * sizeof(float));
 
-        for(size_t i = 0; i < NUM_PIXELS_PER_BLOCK; ++i)
-        {
-            HDRColorA clr;
-            XMStoreFloat4( reinterpret_cast<XMFLOAT4*>( &clr ), pColor[i] );
-
-            float fAlph = clr.a + fError[i];
-
-            Color[i].r = clr.r;
-            Color[i].g = clr.g;
-            Color[i].b = clr.b;
-            Color[i].a = (float) static_cast<int32_t>(clr.a + fError[i] + 0.5f);
+    for(size_t i = 0; i < NUM_PIXELS_PER_BLOCK; ++i)
+    {
+        float fAlph = Color[i].a;
+        if (flags & BC_FLAGS_DITHER_A)
+            fAlph += fError[i];
 
-            float fDiff = fAlph - Color[i].a;
+        fAlpha[i] = static_cast<int32_t>(fAlph * 255.0f + 0.5f) * (1.0f / 255.0f);
+
+        if(fAlpha[i] < fMinAlpha)
+            fMinAlpha = fAlpha[i];
+        else if(fAlpha[i] > fMaxAlpha)
+            fMaxAlpha = fAlpha[i];
+    
+        if (flags & BC_FLAGS_DITHER_A)
+        {
+            float fDiff = fAlph - fAlpha[i];
+
+            if(3 != (i & 3))
+            {
+                assert( i < 15 );
+                _Analysis_assume_( i < 15 );
+                fError[i + 1] += fDiff * (7.0f / 16.0f);
+            }
+
+            if(i < 12)
+            {
+                if(i & 3)
+                    fError[i + 3] += fDiff * (3.0f / 16.0f);
+
+                fError[i + 4] += fDiff * (5.0f / 16.0f);
+
+                if(3 != (i & 3))
+                {
+                    assert( i < 11 );
+                    _Analysis_assume_( i < 11 );
+                    fError[i + 5] += fDiff * (1.0f / 16.0f);
+                }
+            }
+        }
+    }
+
+#ifdef COLOR_WEIGHTS
+    if(0.0f == fMaxAlpha)
+    {
+        EncodeSolidBC1(&pBC3->dxt1, Color);
+        pBC3->alpha[0] = 0x00;
+        pBC3->alpha[1] = 0x00;
+        memset(pBC3->bitmap, 0x00, 6);
+    }
+#endif
+
+    // Alpha part
+    if(1.0f == fMinAlpha)
+    {
+        pBC3->alpha[0] = 0xff;
+        pBC3->alpha[1] = 0xff;
+        memset(pBC3->bitmap, 0x00, 6);
+        return;
+    }
+
+    // Optimize and Quantize Min and Max values
+    size_t uSteps = ((0.0f == fMinAlpha) || (1.0f == fMaxAlpha)) ? 6 : 8;
+
+    float fAlphaA, fAlphaB;
+    OptimizeAlpha<false>(&fAlphaA, &fAlphaB, fAlpha, uSteps);
+
+    uint8_t bAlphaA = (uint8_t) static_cast<int32_t>(fAlphaA * 255.0f + 0.5f);
+    uint8_t bAlphaB = (uint8_t) static_cast<int32_t>(fAlphaB * 255.0f + 0.5f);
+
+    fAlphaA = (float) bAlphaA * (1.0f / 255.0f);
+    fAlphaB = (float) bAlphaB * (1.0f / 255.0f);
+
+    // Setup block
+    if((8 == uSteps) && (bAlphaA == bAlphaB))
+    {
+        pBC3->alpha[0] = bAlphaA;
+        pBC3->alpha[1] = bAlphaB;
+        memset(pBC3->bitmap, 0x00, 6);
+        return;
+    }
+
+    static const size_t pSteps6[] = { 0, 2, 3, 4, 5, 1 };
+    static const size_t pSteps8[] = { 0, 2, 3, 4, 5, 6, 7, 1 };
+
+    const size_t *pSteps;
+    float fStep[8];
+
+    if(6 == uSteps)
+    {
+        pBC3->alpha[0] = bAlphaA;
+        pBC3->alpha[1] = bAlphaB;
+
+        fStep[0] = fAlphaA;
+        fStep[1] = fAlphaB;
+
+        for(size_t i = 1; i < 5; ++i)
+            fStep[i + 1] = (fStep[0] * (5 - i) + fStep[1] * i) * (1.0f / 5.0f);
+
+        fStep[6] = 0.0f;
+        fStep[7] = 1.0f;
+
+        pSteps = pSteps6;
+    }
+    else
+    {
+        pBC3->alpha[0] = bAlphaB;
+        pBC3->alpha[1] = bAlphaA;
+
+        fStep[0] = fAlphaB;
+        fStep[1] = fAlphaA;
+
+        for(size_t i = 1; i < 7; ++i)
+            fStep[i + 1] = (fStep[0] * (7 - i) + fStep[1] * i) * (1.0f / 7.0f);
+
+        pSteps = pSteps8;
+    }
+
+    // Encode alpha bitmap
+    float fSteps = (float) (uSteps - 1);
+    float fScale = (fStep[0] != fStep[1]) ? (fSteps / (fStep[1] - fStep[0])) : 0.0f;
+
+    if (flags & BC_FLAGS_DITHER_A)
+        memset(fError, 0x00, NUM_PIXELS_PER_BLOCK * sizeof(float));
+
+    for(size_t iSet = 0; iSet < 2; iSet++)
+    {
+        uint32_t dw = 0;
+
+        size_t iMin = iSet * 8;
+        size_t iLim = iMin + 8;
+
+        for(size_t i = iMin; i < iLim; ++i)
+        {
+            float fAlph = Color[i].a;
+            if (flags & BC_FLAGS_DITHER_A)
+                fAlph += fError[i];
+            float fDot = (fAlph - fStep[0]) * fScale;
+
+            uint32_t iStep;
+            if(fDot <= 0.0f)
+                iStep = ((6 == uSteps) && (fAlph <= fStep[0] * 0.5f)) ? 6 : 0;
+            else if(fDot >= fSteps)
+                iStep = ((6 == uSteps) && (fAlph >= (fStep[1] + 1.0f) * 0.5f)) ? 7 : 1;
+            else
+                iStep = static_cast<uint32_t>( pSteps[static_cast<size_t>(fDot + 0.5f)] );
+
+            dw = (iStep << 21) | (dw >> 3);
+
+            if (flags & BC_FLAGS_DITHER_A)
+            {
+                float fDiff = (fAlph - fStep[iStep]);
+
+                if(3 != (i & 3))
+                    fError[i + 1] += fDiff * (7.0f / 16.0f);
+
+                if(i < 12)
+                {
+                    if(i & 3)
+                        fError[i + 3] += fDiff * (3.0f / 16.0f);
+
+                    fError[i + 4] += fDiff * (5.0f / 16.0f);
+
+                    if(3 != (i & 3))
+                        fError[i + 5] += fDiff * (1.0f / 16.0f);
+                }
+            }
+        }
+
+        pBC3->bitmap[0 + iSet * 3] = ((uint8_t *) &dw)[0];
+        pBC3->bitmap[1 + iSet * 3] = ((uint8_t *) &dw)[1];
+        pBC3->bitmap[2 + iSet * 3] = ((uint8_t *) &dw)[2];
+    }
+}
+
+
+#ifndef COLOR_WEIGHTS
+//-------------------------------------------------------------------------------------
+// Batched BC1 color encoding. Lane n of every vector belongs to block n of the batch,
+// the math follows OptimizeRGB and EncodeBC1 operation for operation so a block
+// encodes exactly as it does on its own. Only takes 4 step blocks without dithering.
+//-------------------------------------------------------------------------------------
+struct BC1Batch
+{
+    XMVECTOR r[NUM_PIXELS_PER_BLOCK];
+    XMVECTOR g[NUM_PIXELS_PER_BLOCK];
+    XMVECTOR b[NUM_PIXELS_PER_BLOCK];
+};
+
+inline static XMVECTOR Dot3Batch(_In_ FXMVECTOR r0, _In_ FXMVECTOR g0, _In_ FXMVECTOR b0,
+                                 _In_ GXMVECTOR r1, _In_ HXMVECTOR g1, _In_ HXMVECTOR b1)
+{
+    return XMVectorAdd( XMVectorAdd( XMVectorMultiply( r0, r1 ), XMVectorMultiply( g0, g1 ) ), XMVectorMultiply( b0, b1 ) );
+}
+
+// Masks are nested, every lane set in m3 is set in m2 and m1 as well
+inline static XMVECTOR SelectStepBatch(_In_ FXMVECTOR v0, _In_ FXMVECTOR v1, _In_ FXMVECTOR v2, _In_ GXMVECTOR v3,
+                                       _In_ HXMVECTOR m1, _In_ HXMVECTOR m2, _In_ CXMVECTOR m3)
+{
+    XMVECTOR v = XMVectorSelect( v0, v1, m1 );
+    v = XMVectorSelect( v, v2, m2 );
+    return XMVectorSelect( v, v3, m3 );
+}
+
+static void OptimizeRGBBatch(_Out_writes_(3) XMVECTOR *pX, _Out_writes_(3) XMVECTOR *pY, _In_ const BC1Batch &Points, _In_ DWORD flags)
+{
+    static const float fEpsilon = (0.25f / 64.0f) * (0.25f / 64.0f);
+    static const float pC4[] = { 3.0f/3.0f, 2.0f/3.0f, 1.0f/3.0f, 0.0f/3.0f };
+    static const float pD4[] = { 0.0f/3.0f, 1.0f/3.0f, 2.0f/3.0f, 3.0f/3.0f };
+
+    const XMVECTOR vZero = XMVectorZero();
+    const XMVECTOR vTrue = XMVectorTrueInt();
+    const XMVECTOR vFalse = XMVectorFalseInt();
+    const XMVECTOR *pPoints[3] = { Points.r, Points.g, Points.b };
+
+    // Find Min and Max points, as starting point
+    XMVECTOR X[3], Y[3];
+    if (flags & BC_FLAGS_UNIFORM)
+    {
+        X[0] = X[1] = X[2] = g_XMOne;
+    }
+    else
+    {
+        X[0] = XMVectorReplicate(g_Luminance.r);
+        X[1] = XMVectorReplicate(g_Luminance.g);
+        X[2] = XMVectorReplicate(g_Luminance.b);
+    }
+    Y[0] = Y[1] = Y[2] = vZero;
+
+    for(size_t iPoint = 0; iPoint < NUM_PIXELS_PER_BLOCK; iPoint++)
+    {
+        for(size_t iChannel = 0; iChannel < 3; iChannel++)
+        {
+            X[iChannel] = XMVectorMin(pPoints[iChannel][iPoint], X[iChannel]);
+            Y[iChannel] = XMVectorMax(pPoints[iChannel][iPoint], Y[iChannel]);
+        }
+    }
+
+    // Diagonal axis
+    XMVECTOR AB[3];
+    for(size_t iChannel = 0; iChannel < 3; iChannel++)
+        AB[iChannel] = XMVectorSubtract(Y[iChannel], X[iChannel]);
+
+    XMVECTOR fAB = Dot3Batch(AB[0], AB[1], AB[2], AB[0], AB[1], AB[2]);
+
+    // Single color blocks keep their min and max points
+    XMVECTOR vSingle = XMVectorLess(fAB, XMVectorReplicate(FLT_MIN));
+
+    // Try all four axis directions, to determine which diagonal best fits data
+    XMVECTOR fABInv = XMVectorDivide(g_XMOne, fAB);
+
+    XMVECTOR Dir[3], Mid[3];
+    for(size_t iChannel = 0; iChannel < 3; iChannel++)
+    {
+        Dir[iChannel] = XMVectorMultiply(AB[iChannel], fABInv);
+        Mid[iChannel] = XMVectorMultiply(XMVectorAdd(X[iChannel], Y[iChannel]), g_XMOneHalf);
+    }
+
+    XMVECTOR fDir[4] = { vZero, vZero, vZero, vZero };
+
+    for(size_t iPoint = 0; iPoint < NUM_PIXELS_PER_BLOCK; iPoint++)
+    {
+        XMVECTOR Ptr = XMVectorMultiply(XMVectorSubtract(Points.r[iPoint], Mid[0]), Dir[0]);
+        XMVECTOR Ptg = XMVectorMultiply(XMVectorSubtract(Points.g[iPoint], Mid[1]), Dir[1]);
+        XMVECTOR Ptb = XMVectorMultiply(XMVectorSubtract(Points.b[iPoint], Mid[2]), Dir[2]);
+
+        XMVECTOR f = XMVectorAdd(XMVectorAdd(Ptr, Ptg), Ptb);
+        fDir[0] = XMVectorAdd(fDir[0], XMVectorMultiply(f, f));
+
+        f = XMVectorSubtract(XMVectorAdd(Ptr, Ptg), Ptb);
+        fDir[1] = XMVectorAdd(fDir[1], XMVectorMultiply(f, f));
+
+        f = XMVectorAdd(XMVectorSubtract(Ptr, Ptg), Ptb);
+        fDir[2] = XMVectorAdd(fDir[2], XMVectorMultiply(f, f));
+
+        f = XMVectorSubtract(XMVectorSubtract(Ptr, Ptg), Ptb);
+        fDir[3] = XMVectorAdd(fDir[3], XMVectorMultiply(f, f));
+    }
+
+    // First direction with the largest sum wins, its index bits pick the swaps
+    XMVECTOR fDirMax = fDir[0];
+    XMVECTOR vBit0 = vFalse;
+    XMVECTOR vBit1 = vFalse;
+
+    for(size_t iDir = 1; iDir < 4; iDir++)
+    {
+        XMVECTOR vLarger = XMVectorGreater(fDir[iDir], fDirMax);
+        fDirMax = XMVectorSelect(fDirMax, fDir[iDir], vLarger);
+        vBit0 = XMVectorSelect(vBit0, (iDir & 1) ? vTrue : vFalse, vLarger);
+        vBit1 = XMVectorSelect(vBit1, (iDir & 2) ? vTrue : vFalse, vLarger);
+    }
+
+    XMVECTOR vSwapG = XMVectorAndCInt(vBit1, vSingle);
+    XMVECTOR vSwapB = XMVectorAndCInt(vBit0, vSingle);
+
+    XMVECTOR f = X[1];
+    X[1] = XMVectorSelect(X[1], Y[1], vSwapG);
+    Y[1] = XMVectorSelect(Y[1], f, vSwapG);
+
+    f = X[2];
+    X[2] = XMVectorSelect(X[2], Y[2], vSwapB);
+    Y[2] = XMVectorSelect(Y[2], f, vSwapB);
+
+    // Two color blocks are done as well
+    XMVECTOR vDone = XMVectorOrInt(vSingle, XMVectorLess(fAB, XMVectorReplicate(1.0f / 4096.0f)));
+
+    // Use Newton's Method to find local minima of sum-of-squares error.
+    const XMVECTOR fSteps = XMVectorReplicate(3.0f);
+    const XMVECTOR vTwo = XMVectorReplicate(2.0f);
+    const XMVECTOR vEighth = XMVectorReplicate(1.0f / 8.0f);
+    const XMVECTOR vEpsilon = XMVectorReplicate(fEpsilon);
+    const XMVECTOR vC[4] = { XMVectorReplicate(pC4[0]), XMVectorReplicate(pC4[1]), XMVectorReplicate(pC4[2]), XMVectorReplicate(pC4[3]) };
+    const XMVECTOR vD[4] = { XMVectorReplicate(pD4[0]), XMVectorReplicate(pD4[1]), XMVectorReplicate(pD4[2]), XMVectorReplicate(pD4[3]) };
+    const size_t cIterations = (flags & (BC_FLAGS_FAST|BC_FLAGS_ULTRAFAST)) ? g_OptimizeIterationsFast : g_OptimizeIterations;
+
+    for(size_t iIteration = 0; iIteration < cIterations; iIteration++)
+    {
+        if (XMVector4EqualInt(vDone, vTrue))
+            break;
+
+        // Calculate new steps
+        XMVECTOR pSteps[4][3];
+
+        for(size_t iStep = 0; iStep < 4; iStep++)
+        {
+            for(size_t iChannel = 0; iChannel < 3; iChannel++)
+                pSteps[iStep][iChannel] = XMVectorAdd(XMVectorMultiply(X[iChannel], vC[iStep]), XMVectorMultiply(Y[iChannel], vD[iStep]));
+        }
+
+        // Calculate color direction
+        for(size_t iChannel = 0; iChannel < 3; iChannel++)
+            Dir[iChannel] = XMVectorSubtract(Y[iChannel], X[iChannel]);
+
+        XMVECTOR fLen = Dot3Batch(Dir[0], Dir[1], Dir[2], Dir[0], Dir[1], Dir[2]);
+
+        XMVECTOR vShort = XMVectorLess(fLen, XMVectorReplicate(1.0f / 4096.0f));
+        XMVECTOR vActive = XMVectorAndCInt(XMVectorAndCInt(vTrue, vDone), vShort);
+        vDone = XMVectorOrInt(vDone, vShort);
+
+        XMVECTOR fScale = XMVectorDivide(fSteps, fLen);
+
+        for(size_t iChannel = 0; iChannel < 3; iChannel++)
+            Dir[iChannel] = XMVectorMultiply(Dir[iChannel], fScale);
+
+        // Evaluate function, and derivatives
+        XMVECTOR d2X = vZero, d2Y = vZero;
+        XMVECTOR dX[3] = { vZero, vZero, vZero };
+        XMVECTOR dY[3] = { vZero, vZero, vZero };
+
+        for(size_t iPoint = 0; iPoint < NUM_PIXELS_PER_BLOCK; iPoint++)
+        {
+            XMVECTOR fDot = Dot3Batch(XMVectorSubtract(Points.r[iPoint], X[0]), XMVectorSubtract(Points.g[iPoint], X[1]),
+                                      XMVectorSubtract(Points.b[iPoint], X[2]), Dir[0], Dir[1], Dir[2]);
+
+            // Same as the clamped round to nearest step, as masks for steps 1, 2 and 3
+            XMVECTOR fStep = XMVectorAdd(XMVectorClamp(fDot, vZero, fSteps), g_XMOneHalf);
+            XMVECTOR m1 = XMVectorGreaterOrEqual(fStep, g_XMOne);
+            XMVECTOR m2 = XMVectorGreaterOrEqual(fStep, vTwo);
+            XMVECTOR m3 = XMVectorGreaterOrEqual(fStep, fSteps);
+
+            XMVECTOR fC = SelectStepBatch(vC[0], vC[1], vC[2], vC[3], m1, m2, m3);
+            XMVECTOR fD = SelectStepBatch(vD[0], vD[1], vD[2], vD[3], m1, m2, m3);
+
+            d2X = XMVectorAdd(d2X, XMVectorMultiply(XMVectorMultiply(fC, vEighth), fC));
+            d2Y = XMVectorAdd(d2Y, XMVectorMultiply(XMVectorMultiply(fD, vEighth), fD));
+
+            for(size_t iChannel = 0; iChannel < 3; iChannel++)
+            {
+                XMVECTOR Diff = XMVectorSubtract(SelectStepBatch(pSteps[0][iChannel], pSteps[1][iChannel], pSteps[2][iChannel], pSteps[3][iChannel],
+                                                                 m1, m2, m3), pPoints[iChannel][iPoint]);
+
+                dX[iChannel] = XMVectorAdd(dX[iChannel], XMVectorMultiply(XMVectorMultiply(fC, vEighth), Diff));
+                dY[iChannel] = XMVectorAdd(dY[iChannel], XMVectorMultiply(XMVectorMultiply(fD, vEighth), Diff));
+            }
+        }
+
+        // Move endpoints
+        XMVECTOR vMoveX = XMVectorAndInt(vActive, XMVectorGreater(d2X, vZero));
+        XMVECTOR vMoveY = XMVectorAndInt(vActive, XMVectorGreater(d2Y, vZero));
+        XMVECTOR fX = XMVectorDivide(g_XMNegativeOne, d2X);
+        XMVECTOR fY = XMVectorDivide(g_XMNegativeOne, d2Y);
+        XMVECTOR vConverged = vTrue;
+
+        for(size_t iChannel = 0; iChannel < 3; iChannel++)
+        {
+            X[iChannel] = XMVectorSelect(X[iChannel], XMVectorAdd(X[iChannel], XMVectorMultiply(dX[iChannel], fX)), vMoveX);
+            Y[iChannel] = XMVectorSelect(Y[iChannel], XMVectorAdd(Y[iChannel], XMVectorMultiply(dY[iChannel], fY)), vMoveY);
+
+            vConverged = XMVectorAndInt(vConverged, XMVectorLess(XMVectorMultiply(dX[iChannel], dX[iChannel]), vEpsilon));
+            vConverged = XMVectorAndInt(vConverged, XMVectorLess(XMVectorMultiply(dY[iChannel], dY[iChannel]), vEpsilon));
+        }
+
+        vDone = XMVectorOrInt(vDone, XMVectorAndInt(vActive, vConverged));
+    }
+
+    for(size_t iChannel = 0; iChannel < 3; iChannel++)
+    {
+        pX[iChannel] = X[iChannel];
+        pY[iChannel] = Y[iChannel];
+    }
+}
+
+static void EncodeBC1Batch(_In_reads_(nBlocks) D3DX_BC1 *const *ppBC, _In_reads_(nBlocks) const HDRColorA *const *ppColor,
+                           _In_ size_t nBlocks, _In_ DWORD flags)
+{
+    assert( ppBC && ppColor && nBlocks > 0 && nBlocks <= BC_BATCH_BLOCKS );
+
+    static const float fScale[3] = { 31.0f, 63.0f, 31.0f };
+    static const float fScaleInv[3] = { 1.0f / 31.0f, 1.0f / 63.0f, 1.0f / 31.0f };
+    const float fLuminance[3] = { g_Luminance.r, g_Luminance.g, g_Luminance.b };
+
+    // Quantize blocks to R5G6B5, weighted colors go to OptimizeRGB and the unquantized ones pick the indices.
+    // Lanes past nBlocks repeat the last block.
+    BC1Batch Points, Colors;
+    XMVECTOR *pPoints[3] = { Points.r, Points.g, Points.b };
+    XMVECTOR *pColors[3] = { Colors.r, Colors.g, Colors.b };
+
+    for(size_t i = 0; i < NUM_PIXELS_PER_BLOCK; ++i)
+    {
+        XMMATRIX M;
+        for(size_t n = 0; n < BC_BATCH_BLOCKS; ++n)
+        {
+            const HDRColorA *pColor = ppColor[ (n < nBlocks) ? n : (nBlocks - 1) ];
+            M.r[n] = XMLoadFloat4( reinterpret_cast<const XMFLOAT4*>( &pColor[i] ) );
+        }
+
+        M = XMMatrixTranspose( M );
+
+        for(size_t iChannel = 0; iChannel < 3; iChannel++)
+        {
+            XMVECTOR vQuantized = XMVectorAdd( XMVectorMultiply( M.r[iChannel], XMVectorReplicate( fScale[iChannel] ) ), g_XMOneHalf );
+            vQuantized = XMVectorMultiply( XMVectorTruncate( vQuantized ), XMVectorReplicate( fScaleInv[iChannel] ) );
+
+            if ( flags & BC_FLAGS_UNIFORM )
+            {
+                pPoints[iChannel][i] = vQuantized;
+                pColors[iChannel][i] = M.r[iChannel];
+            }
+            else
+            {
+                XMVECTOR vLuminance = XMVectorReplicate( fLuminance[iChannel] );
+                pPoints[iChannel][i] = XMVectorMultiply( vQuantized, vLuminance );
+                pColors[iChannel][i] = XMVectorMultiply( M.r[iChannel], vLuminance );
+            }
+        }
+    }
+
+    XMVECTOR X[3], Y[3];
+    OptimizeRGBBatch( X, Y, Points, flags );
+
+    float fX[3][BC_BATCH_BLOCKS], fY[3][BC_BATCH_BLOCKS];
+    for(size_t iChannel = 0; iChannel < 3; iChannel++)
+    {
+        XMStoreFloat4( reinterpret_cast<XMFLOAT4*>( fX[iChannel] ), X[iChannel] );
+        XMStoreFloat4( reinterpret_cast<XMFLOAT4*>( fY[iChannel] ), Y[iChannel] );
+    }
+
+    // Endpoints are quantized and ordered one block at a time, that is a handful of operations next to the rest
+    float fStep0[3][BC_BATCH_BLOCKS] = {};
+    float fDir[3][BC_BATCH_BLOCKS] = {};
+    bool bEncode[BC_BATCH_BLOCKS] = {};
+
+    for(size_t n = 0; n < nBlocks; ++n)
+    {
+        HDRColorA ColorA(fX[0][n], fX[1][n], fX[2][n], 1.0f);
+        HDRColorA ColorB(fY[0][n], fY[1][n], fY[2][n], 1.0f);
+
+        HDRColorA Step[4], Dir;
+        bEncode[n] = QuantizeBC1Endpoints(ppBC[n], Step, &Dir, ColorA, ColorB, 4, flags);
+        if ( bEncode[n] )
+        {
+            fStep0[0][n] = Step[0].r; fStep0[1][n] = Step[0].g; fStep0[2][n] = Step[0].b;
+            fDir[0][n] = Dir.r; fDir[1][n] = Dir.g; fDir[2][n] = Dir.b;
+        }
+    }
+
+    XMVECTOR Step0[3], Dir[3];
+    for(size_t iChannel = 0; iChannel < 3; iChannel++)
+    {
+        Step0[iChannel] = XMLoadFloat4( reinterpret_cast<const XMFLOAT4*>( fStep0[iChannel] ) );
+        Dir[iChannel] = XMLoadFloat4( reinterpret_cast<const XMFLOAT4*>( fDir[iChannel] ) );
+    }
+
+    // Encode colors
+    static const uint32_t pSteps4[] = { 0, 2, 3, 1 };
+    const XMVECTOR fSteps = XMVectorReplicate(3.0f);
+    uint32_t dw[BC_BATCH_BLOCKS] = {};
+
+    for(size_t i = 0; i < NUM_PIXELS_PER_BLOCK; ++i)
+    {
+        XMVECTOR fDot = Dot3Batch( XMVectorSubtract( Colors.r[i], Step0[0] ), XMVectorSubtract( Colors.g[i], Step0[1] ),
+                                   XMVectorSubtract( Colors.b[i], Step0[2] ), Dir[0], Dir[1], Dir[2] );
+
+        XMVECTOR vStep = XMConvertVectorFloatToInt( XMVectorAdd( XMVectorClamp( fDot, XMVectorZero(), fSteps ), g_XMOneHalf ), 0 );
+
+        uint32_t iStep[BC_BATCH_BLOCKS];
+        XMStoreInt4( iStep, vStep );
+
+        for(size_t n = 0; n < nBlocks; ++n)
+            dw[n] |= pSteps4[ iStep[n] ] << (2 * i);
+    }
+
+    for(size_t n = 0; n < nBlocks; ++n)
+    {
+        if ( bEncode[n] )
+            ppBC[n]->bitmap = dw[n];
+    }
+}
+#endif // !COLOR_WEIGHTS
+
+
+//=====================================================================================
+// Entry points
+//=====================================================================================
+
+//-------------------------------------------------------------------------------------
+// BC1 Compression
+//-------------------------------------------------------------------------------------
+_Use_decl_annotations_
+void D3DXDecodeBC1(XMVECTOR *pColor, const uint8_t *pBC)
+{
+    auto pBC1 = reinterpret_cast<const D3DX_BC1 *>(pBC);
+    DecodeBC1( pColor, pBC1, true );
+}
+
+_Use_decl_annotations_
+void D3DXEncodeBC1(uint8_t *pBC, const XMVECTOR *pColor, float alphaRef, DWORD flags)
+{
+    assert( pBC && pColor );
+
+    HDRColorA Color[NUM_PIXELS_PER_BLOCK];
+
+    if (flags & BC_FLAGS_DITHER_A)
+    {
+        float fError[NUM_PIXELS_PER_BLOCK];
+        memset(fError, 0x00, NUM_PIXELS_PER_BLOCK * sizeof(float));
+
+        for(size_t i = 0; i < NUM_PIXELS_PER_BLOCK; ++i)
+        {
+            HDRColorA clr;
+            XMStoreFloat4( reinterpret_cast<XMFLOAT4*>( &clr ), pColor[i] );
+
+            float fAlph = clr.a + fError[i];
+
+            Color[i].r = clr.r;
+            Color[i].g = clr.g;
+            Color[i].b = clr.b;
+            Color[i].a = (float) static_cast<int32_t>(clr.a + fError[i] + 0.5f);
+
+            float fDiff = fAlph - Color[i].a;
 
             if(3 != (i & 3))
             {
@@ -787,6 +1355,59 @@ void D3DXEncodeBC1(uint8_t *pBC, const XMVECTOR *pColor, float alphaRef, DWORD f
 }
 
 
+_Use_decl_annotations_
+void D3DXEncodeBC1Batch(uint8_t *pBC, const XMVECTOR *pColor, size_t nBlocks, float alphaRef, DWORD flags)
+{
+    assert( pBC && pColor );
+
+#ifndef COLOR_WEIGHTS
+    if ( !(flags & (BC_FLAGS_DITHER_RGB | BC_FLAGS_DITHER_A)) )
+    {
+        for(size_t iBlock = 0; iBlock < nBlocks; iBlock += BC_BATCH_BLOCKS)
+        {
+            HDRColorA Color[BC_BATCH_BLOCKS][NUM_PIXELS_PER_BLOCK];
+            D3DX_BC1 *ppBC[BC_BATCH_BLOCKS];
+            const HDRColorA *ppColor[BC_BATCH_BLOCKS];
+            size_t nBatch = 0;
+
+            for(size_t n = 0; n < BC_BATCH_BLOCKS && iBlock + n < nBlocks; ++n)
+            {
+                const XMVECTOR *pBlockColor = pColor + (iBlock + n) * NUM_PIXELS_PER_BLOCK;
+                bool bColorKey = false;
+                for(size_t i = 0; i < NUM_PIXELS_PER_BLOCK; ++i)
+                {
+                    XMStoreFloat4( reinterpret_cast<XMFLOAT4*>( &Color[n][i] ), pBlockColor[i] );
+                    bColorKey |= (Color[n][i].a < alphaRef);
+                }
+
+                // Blocks with transparent pixels use the 3 step mode, they are encoded on their own
+                auto pBC1 = reinterpret_cast<D3DX_BC1 *>(pBC + (iBlock + n) * sizeof(D3DX_BC1));
+                if ( bColorKey )
+                {
+                    EncodeBC1(pBC1, Color[n], true, alphaRef, flags);
+                }
+                else
+                {
+                    ppBC[nBatch] = pBC1;
+                    ppColor[nBatch] = Color[n];
+                    ++nBatch;
+                }
+            }
+
+            if ( nBatch > 0 )
+                EncodeBC1Batch(ppBC, ppColor, nBatch, flags);
+        }
+        return;
+    }
+#endif // !COLOR_WEIGHTS
+
+    for(size_t iBlock = 0; iBlock < nBlocks; ++iBlock)
+    {
+        D3DXEncodeBC1(pBC + iBlock * sizeof(D3DX_BC1), pColor + iBlock * NUM_PIXELS_PER_BLOCK, alphaRef, flags);
+    }
+}
+
+
 //-------------------------------------------------------------------------------------
 // BC2 Compression
 //-------------------------------------------------------------------------------------
@@ -906,23 +1527,7 @@ void D3DXDecodeBC3(XMVECTOR *pColor, const uint8_t *pBC)
 
     // Adaptive 3-bit alpha part
     float fAlpha[8];
-
-    fAlpha[0] = ((float) pBC3->alpha[0]) * (1.0f / 255.0f);
-    fAlpha[1] = ((float) pBC3->alpha[1]) * (1.0f / 255.0f);
-
-    if(pBC3->alpha[0] > pBC3->alpha[1]) 
-    {
-        for(size_t i = 1; i < 7; ++i)
-            fAlpha[i + 1] = (fAlpha[0] * (7 - i) + fAlpha[1] * i) * (1.0f / 7.0f);
-    }
-    else 
-    {
-        for(size_t i = 1; i < 5; ++i)
-            fAlpha[i + 1] = (fAlpha[0] * (5 - i) + fAlpha[1] * i) * (1.0f / 5.0f);
-
-        fAlpha[6] = 0.0f;
-        fAlpha[7] = 1.0f;
-    }
+    DecodeBC3Alpha( fAlpha, pBC3 );
 
     DWORD dw = pBC3->bitmap[0] | (pBC3->bitmap[1] << 8) | (pBC3->bitmap[2] << 16);
 
@@ -935,6 +1540,31 @@ void D3DXDecodeBC3(XMVECTOR *pColor, const uint8_t *pBC)
         pColor[i] = XMVectorSetW( pColor[i], fAlpha[dw & 0x7] );
 }
 
+//-------------------------------------------------------------------------------------
+// Block palettes, every decoded pixel is one of these entries (BC2/BC3 pair a color
+// entry with an alpha entry)
+//-------------------------------------------------------------------------------------
+_Use_decl_annotations_
+void D3DXDecodeBC1Palette(XMVECTOR *pColor, const uint8_t *pBC, bool isbc1)
+{
+    auto pBC1 = reinterpret_cast<const D3DX_BC1 *>(pBC);
+    DecodeBC1Palette( pColor, pBC1, isbc1 );
+}
+
+_Use_decl_annotations_
+void D3DXDecodeBC2AlphaPalette(float *pAlpha)
+{
+    for(size_t i = 0; i < 16; ++i)
+        pAlpha[i] = (float) i * (1.0f / 15.0f);
+}
+
+_Use_decl_annotations_
+void D3DXDecodeBC3AlphaPalette(float *pAlpha, const uint8_t *pBC)
+{
+    auto pBC3 = reinterpret_cast<const D3DX_BC3 *>(pBC);
+    DecodeBC3Alpha( pAlpha, pBC3 );
+}
+
 _Use_decl_annotations_
 void D3DXEncodeBC3(uint8_t *pBC, const XMVECTOR *pColor, DWORD flags)
 {
@@ -949,192 +1579,54 @@ void D3DXEncodeBC3(uint8_t *pBC, const XMVECTOR *pColor, DWORD flags)
 
     auto pBC3 = reinterpret_cast<D3DX_BC3 *>(pBC);
 
-    // Quantize block to A8, using Floyd Stienberg error diffusion.  This 
-    // increases the chance that colors will map directly to the quantized 
-    // axis endpoints.
-    float fAlpha[NUM_PIXELS_PER_BLOCK];
-    float fError[NUM_PIXELS_PER_BLOCK];
+    // Alpha part
+    EncodeBC3Alpha(pBC3, Color, flags);
 
-    float fMinAlpha = Color[0].a;
-    float fMaxAlpha = Color[0].a;
+    // RGB part
+    EncodeBC1(&pBC3->bc1, Color, false, 0.f, flags);
+}
 
-    if (flags & BC_FLAGS_DITHER_A)
-        memset(fError, 0x00, NUM_PIXELS_PER_BLOCK * sizeof(float));
+_Use_decl_annotations_
+void D3DXEncodeBC3Batch(uint8_t *pBC, const XMVECTOR *pColor, size_t nBlocks, DWORD flags)
+{
+    assert( pBC && pColor );
 
-    for(size_t i = 0; i < NUM_PIXELS_PER_BLOCK; ++i)
+#ifndef COLOR_WEIGHTS
+    if ( !(flags & BC_FLAGS_DITHER_RGB) )
     {
-        float fAlph = Color[i].a;
-        if (flags & BC_FLAGS_DITHER_A)
-            fAlph += fError[i];
-
-        fAlpha[i] = static_cast<int32_t>(fAlph * 255.0f + 0.5f) * (1.0f / 255.0f);
-
-        if(fAlpha[i] < fMinAlpha)
-            fMinAlpha = fAlpha[i];
-        else if(fAlpha[i] > fMaxAlpha)
-            fMaxAlpha = fAlpha[i];
-    
-        if (flags & BC_FLAGS_DITHER_A)
+        for(size_t iBlock = 0; iBlock < nBlocks; iBlock += BC_BATCH_BLOCKS)
         {
-            float fDiff = fAlph - fAlpha[i];
-
-            if(3 != (i & 3))
-            {
-                assert( i < 15 );
-                _Analysis_assume_( i < 15 );
-                fError[i + 1] += fDiff * (7.0f / 16.0f);
-            }
+            HDRColorA Color[BC_BATCH_BLOCKS][NUM_PIXELS_PER_BLOCK];
+            D3DX_BC1 *ppBC[BC_BATCH_BLOCKS];
+            const HDRColorA *ppColor[BC_BATCH_BLOCKS];
+            size_t nBatch = 0;
 
-            if(i < 12)
+            for(size_t n = 0; n < BC_BATCH_BLOCKS && iBlock + n < nBlocks; ++n)
             {
-                if(i & 3)
-                    fError[i + 3] += fDiff * (3.0f / 16.0f);
-
-                fError[i + 4] += fDiff * (5.0f / 16.0f);
-
-                if(3 != (i & 3))
+                const XMVECTOR *pBlockColor = pColor + (iBlock + n) * NUM_PIXELS_PER_BLOCK;
+                for(size_t i = 0; i < NUM_PIXELS_PER_BLOCK; ++i)
                 {
-                    assert( i < 11 );
-                    _Analysis_assume_( i < 11 );
-                    fError[i + 5] += fDiff * (1.0f / 16.0f);
+                    XMStoreFloat4( reinterpret_cast<XMFLOAT4*>( &Color[n][i] ), pBlockColor[i] );
                 }
-            }
-        }
-    }
-
-#ifdef COLOR_WEIGHTS
-    if(0.0f == fMaxAlpha)
-    {
-        EncodeSolidBC1(&pBC3->dxt1, Color);
-        pBC3->alpha[0] = 0x00;
-        pBC3->alpha[1] = 0x00;
-        memset(pBC3->bitmap, 0x00, 6);
-    }
-#endif
-
-    // RGB part
-    EncodeBC1(&pBC3->bc1, Color, false, 0.f, flags);
-
-    // Alpha part
-    if(1.0f == fMinAlpha)
-    {
-        pBC3->alpha[0] = 0xff;
-        pBC3->alpha[1] = 0xff;
-        memset(pBC3->bitmap, 0x00, 6);
-        return;
-    }
-
-    // Optimize and Quantize Min and Max values
-    size_t uSteps = ((0.0f == fMinAlpha) || (1.0f == fMaxAlpha)) ? 6 : 8;
 
-    float fAlphaA, fAlphaB;
-    OptimizeAlpha<false>(&fAlphaA, &fAlphaB, fAlpha, uSteps);
-
-    uint8_t bAlphaA = (uint8_t) static_cast<int32_t>(fAlphaA * 255.0f + 0.5f);
-    uint8_t bAlphaB = (uint8_t) static_cast<int32_t>(fAlphaB * 255.0f + 0.5f);
+                // Alpha is encoded one block at a time, the colors go through the batch
+                auto pBC3 = reinterpret_cast<D3DX_BC3 *>(pBC + (iBlock + n) * sizeof(D3DX_BC3));
+                EncodeBC3Alpha(pBC3, Color[n], flags);
 
-    fAlphaA = (float) bAlphaA * (1.0f / 255.0f);
-    fAlphaB = (float) bAlphaB * (1.0f / 255.0f);
+                ppBC[nBatch] = &pBC3->bc1;
+                ppColor[nBatch] = Color[n];
+                ++nBatch;
+            }
 
-    // Setup block
-    if((8 == uSteps) && (bAlphaA == bAlphaB))
-    {
-        pBC3->alpha[0] = bAlphaA;
-        pBC3->alpha[1] = bAlphaB;
-        memset(pBC3->bitmap, 0x00, 6);
+            EncodeBC1Batch(ppBC, ppColor, nBatch, flags);
+        }
         return;
     }
+#endif // !COLOR_WEIGHTS
 
-    static const size_t pSteps6[] = { 0, 2, 3, 4, 5, 1 };
-    static const size_t pSteps8[] = { 0, 2, 3, 4, 5, 6, 7, 1 };
-
-    const size_t *pSteps;
-    float fStep[8];
-
-    if(6 == uSteps)
-    {
-        pBC3->alpha[0] = bAlphaA;
-        pBC3->alpha[1] = bAlphaB;
-
-        fStep[0] = fAlphaA;
-        fStep[1] = fAlphaB;
-
-        for(size_t i = 1; i < 5; ++i)
-            fStep[i + 1] = (fStep[0] * (5 - i) + fStep[1] * i) * (1.0f / 5.0f);
-
-        fStep[6] = 0.0f;
-        fStep[7] = 1.0f;
-
-        pSteps = pSteps6;
-    }
-    else
-    {
-        pBC3->alpha[0] = bAlphaB;
-        pBC3->alpha[1] = bAlphaA;
-
-        fStep[0] = fAlphaB;
-        fStep[1] = fAlphaA;
-
-        for(size_t i = 1; i < 7; ++i)
-            fStep[i + 1] = (fStep[0] * (7 - i) + fStep[1] * i) * (1.0f / 7.0f);
-
-        pSteps = pSteps8;
-    }
-
-    // Encode alpha bitmap
-    float fSteps = (float) (uSteps - 1);
-    float fScale = (fStep[0] != fStep[1]) ? (fSteps / (fStep[1] - fStep[0])) : 0.0f;
-
-    if (flags & BC_FLAGS_DITHER_A)
-        memset(fError, 0x00, NUM_PIXELS_PER_BLOCK * sizeof(float));
-
-    for(size_t iSet = 0; iSet < 2; iSet++)
+    for(size_t iBlock = 0; iBlock < nBlocks; ++iBlock)
     {
-        uint32_t dw = 0;
-
-        size_t iMin = iSet * 8;
-        size_t iLim = iMin + 8;
-
-        for(size_t i = iMin; i < iLim; ++i)
-        {
-            float fAlph = Color[i].a;
-            if (flags & BC_FLAGS_DITHER_A)
-                fAlph += fError[i];
-            float fDot = (fAlph - fStep[0]) * fScale;
-
-            uint32_t iStep;
-            if(fDot <= 0.0f)
-                iStep = ((6 == uSteps) && (fAlph <= fStep[0] * 0.5f)) ? 6 : 0;
-            else if(fDot >= fSteps)
-                iStep = ((6 == uSteps) && (fAlph >= (fStep[1] + 1.0f) * 0.5f)) ? 7 : 1;
-            else
-                iStep = static_cast<uint32_t>( pSteps[static_cast<size_t>(fDot + 0.5f)] );
-
-            dw = (iStep << 21) | (dw >> 3);
-
-            if (flags & BC_FLAGS_DITHER_A)
-            {
-                float fDiff = (fAlph - fStep[iStep]);
-
-                if(3 != (i & 3))
-                    fError[i + 1] += fDiff * (7.0f / 16.0f);
-
-                if(i < 12)
-                {
-                    if(i & 3)
-                        fError[i + 3] += fDiff * (3.0f / 16.0f);
-
-                    fError[i + 4] += fDiff * (5.0f / 16.0f);
-
-                    if(3 != (i & 3))
-                        fError[i + 5] += fDiff * (1.0f / 16.0f);
-                }
-            }
-        }
-
-        pBC3->bitmap[0 + iSet * 3] = ((uint8_t *) &dw)[0];
-        pBC3->bitmap[1 + iSet * 3] = ((uint8_t *) &dw)[1];
-        pBC3->bitmap[2 + iSet * 3] = ((uint8_t *) &dw)[2];
+        D3DXEncodeBC3(pBC + iBlock * sizeof(D3DX_BC3), pColor + iBlock * NUM_PIXELS_PER_BLOCK, flags);
     }
 }
 
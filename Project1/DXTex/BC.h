@@ -45,6 +45,8 @@ const size_t BC6H_MAX_SHAPES = 32;
 const size_t BC7_NUM_CHANNELS = 4;
 const size_t BC7_MAX_SHAPES = 64;
 
+const size_t BC_BATCH_BLOCKS = 4;   // Blocks the batched BC1/BC3 encoders work on side by side
+
 const int32_t BC67_WEIGHT_MAX = 64;
 const uint32_t BC67_WEIGHT_SHIFT = 6;
 const int32_t BC67_WEIGHT_ROUND = 32;
@@ -60,6 +62,9 @@ enum BC_FLAGS
     BC_FLAGS_DITHER_A   = 0x20000,  // Enables dithering for Alpha channel for BC1-3
     BC_FLAGS_UNIFORM    = 0x40000,  // By default, uses perceptual weighting for BC1-3; this flag makes it a uniform weighting
     BC_FLAGS_USE_3SUBSETS = 0x80000,// By default, BC7 skips mode 0 & 2; this flag adds those modes back
+    BC_FLAGS_FAST       = 0x100000, // Fewer endpoint refinement iterations for BC1-3, prunes BC6H/BC7 modes and partitions from block statistics
+    BC_FLAGS_ULTRAFAST  = 0x200000, // As BC_FLAGS_FAST for BC1-3, BC6H/BC7 only try the single subset modes plus one ranked partition
+    BC_FLAGS_SLOW       = 0x400000, // BC6H/BC7 refine a few more partitions per mode, BC7 also tries mode 0 & 2
 };
 
 //-------------------------------------------------------------------------------------
@@ -520,7 +525,7 @@ class D3DX_BC6H : private CBits< 16 >
 {
 public:
     void Decode(_In_ bool bSigned, _Out_writes_(NUM_PIXELS_PER_BLOCK) HDRColorA* pOut) const;
-    void Encode(_In_ bool bSigned, _In_reads_(NUM_PIXELS_PER_BLOCK) const HDRColorA* const pIn);
+    void Encode(_In_ bool bSigned, _In_ DWORD flags, _In_reads_(NUM_PIXELS_PER_BLOCK) const HDRColorA* const pIn);
 
 private:
 #pragma warning(push)
@@ -624,7 +629,7 @@ class D3DX_BC7 : private CBits< 16 >
 {
 public:
     void Decode(_Out_writes_(NUM_PIXELS_PER_BLOCK) HDRColorA* pOut) const;
-    void Encode(bool skip3subsets, _In_reads_(NUM_PIXELS_PER_BLOCK) const HDRColorA* const pIn);
+    void Encode(_In_ DWORD flags, _In_reads_(NUM_PIXELS_PER_BLOCK) const HDRColorA* const pIn);
 
 private:
     struct ModeInfo
@@ -875,9 +880,24 @@ void D3DXDecodeBC6HU(_Out_writes_(NUM_PIXELS_PER_BLOCK) XMVECTOR *pColor, _In_re
 void D3DXDecodeBC6HS(_Out_writes_(NUM_PIXELS_PER_BLOCK) XMVECTOR *pColor, _In_reads_(16) const uint8_t *pBC);
 void D3DXDecodeBC7(_Out_writes_(NUM_PIXELS_PER_BLOCK) XMVECTOR *pColor, _In_reads_(16) const uint8_t *pBC);
 
+// Palettes of the entries a block's indices select from, BC2/BC3 take the color palette from the trailing 8 bytes
+// and BC5 is two BC4 blocks. Decoding through these matches the per-pixel decoders above exactly.
+void D3DXDecodeBC1Palette(_Out_writes_(4) XMVECTOR *pColor, _In_reads_(8) const uint8_t *pBC, _In_ bool isbc1);
+void D3DXDecodeBC2AlphaPalette(_Out_writes_(16) float *pAlpha);
+void D3DXDecodeBC3AlphaPalette(_Out_writes_(8) float *pAlpha, _In_reads_(8) const uint8_t *pBC);
+void D3DXDecodeBC4UPalette(_Out_writes_(8) float *pValues, _In_reads_(8) const uint8_t *pBC);
+void D3DXDecodeBC4SPalette(_Out_writes_(8) float *pValues, _In_reads_(8) const uint8_t *pBC);
+
 void D3DXEncodeBC1(_Out_writes_(8) uint8_t *pBC, _In_reads_(NUM_PIXELS_PER_BLOCK) const XMVECTOR *pColor, _In_ float alphaRef, _In_ DWORD flags);
     // BC1 requires one additional parameter, so it doesn't match signature of BC_ENCODE above
 
+// Batched variants take nBlocks blocks of NUM_PIXELS_PER_BLOCK colors back to back and write the blocks back to back,
+// each block comes out exactly as the single block encoder produces it
+void D3DXEncodeBC1Batch(_Out_writes_(nBlocks * 8) uint8_t *pBC, _In_reads_(nBlocks * NUM_PIXELS_PER_BLOCK) const XMVECTOR *pColor,
+                        _In_ size_t nBlocks, _In_ float alphaRef, _In_ DWORD flags);
+void D3DXEncodeBC3Batch(_Out_writes_(nBlocks * 16) uint8_t *pBC, _In_reads_(nBlocks * NUM_PIXELS_PER_BLOCK) const XMVECTOR *pColor,
+                        _In_ size_t nBlocks, _In_ DWORD flags);
+
 void D3DXEncodeBC2(_Out_writes_(16) uint8_t *pBC, _In_reads_(NUM_PIXELS_PER_BLOCK) const XMVECTOR *pColor, _In_ DWORD flags);
 void D3DXEncodeBC3(_Out_writes_(16) uint8_t *pBC, _In_reads_(NUM_PIXELS_PER_BLOCK) const XMVECTOR *pColor, _In_ DWORD flags);
 void D3DXEncodeBC4U(_Out_writes_(8) uint8_t *pBC, _In_reads_(NUM_PIXELS_PER_BLOCK) const XMVECTOR *pColor, _In_ DWORD flags);
@@ -398,6 +398,32 @@ void D3DXDecodeBC4S(XMVECTOR *pColor, const uint8_t *pBC)
     }       
 }
 
+_Use_decl_annotations_
+void D3DXDecodeBC4UPalette(float *pValues, const uint8_t *pBC)
+{
+    assert( pValues && pBC );
+
+    auto pBC4 = reinterpret_cast<const BC4_UNORM*>(pBC);
+
+    for (size_t i = 0; i < 8; ++i)
+    {
+        pValues[i] = pBC4->DecodeFromIndex(i);
+    }
+}
+
+_Use_decl_annotations_
+void D3DXDecodeBC4SPalette(float *pValues, const uint8_t *pBC)
+{
+    assert( pValues && pBC );
+
+    auto pBC4 = reinterpret_cast<const BC4_SNORM*>(pBC);
+
+    for (size_t i = 0; i < 8; ++i)
+    {
+        pValues[i] = pBC4->DecodeFromIndex(i);
+    }
+}
+
 _Use_decl_annotations_
 void D3DXEncodeBC4U( uint8_t *pBC, const XMVECTOR *pColor, DWORD flags )
 {
@@ -31,6 +31,25 @@ static const float pD3[] = { 0.0f/2.0f, 1.0f/2.0f, 2.0f/2.0f };
 static const float pC4[] = { 3.0f/3.0f, 2.0f/3.0f, 1.0f/3.0f, 0.0f/3.0f };
 static const float pD4[] = { 0.0f/3.0f, 1.0f/3.0f, 2.0f/3.0f, 3.0f/3.0f };
 
+// Encoder profiles, BC_FLAGS_ULTRAFAST and BC_FLAGS_FAST prune the mode/partition search, BC_FLAGS_SLOW widens it
+enum BC67_PROFILE
+{
+    BC67_PROFILE_ULTRAFAST,
+    BC67_PROFILE_FAST,
+    BC67_PROFILE_NORMAL,
+    BC67_PROFILE_SLOW,
+};
+
+static const size_t BC67_ULTRAFAST_SHAPE_CANDIDATES = 2;    // shapes per mode that still get a RoughMSE after ranking
+static const size_t BC67_FAST_SHAPE_CANDIDATES = 8;
+static const size_t BC67_SLOW_EXTRA_ITEMS = 4;              // refined on top of the uShapes/4 the normal profile refines
+static const int BC7_LOW_VARIANCE_RANGE = 8;                // largest channel spread, in 8-bit units, a single subset is used for
+static const int BC6H_LOW_VARIANCE_RANGE = 32;              // same in half float units
+static const float BC7_ULTRAFAST_EARLY_OUT_ERROR = 64.0f;   // block error the pruned profiles stop searching at
+static const float BC7_FAST_EARLY_OUT_ERROR = 16.0f;
+static const float BC6H_ULTRAFAST_EARLY_OUT_ERROR = 64.0f;
+static const float BC6H_FAST_EARLY_OUT_ERROR = 16.0f;
+
 const int g_aWeights2[] = {0, 21, 43, 64};
 const int g_aWeights3[] = {0, 9, 18, 27, 37, 46, 55, 64};
 const int g_aWeights4[] = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
@@ -1069,6 +1088,81 @@ inline static void FillWithErrorColors( _Out_writes_(NUM_PIXELS_PER_BLOCK) HDRCo
 }
 
 
+inline static BC67_PROFILE GetProfile( _In_ DWORD flags )
+{
+    if(flags & BC_FLAGS_ULTRAFAST)
+        return BC67_PROFILE_ULTRAFAST;
+    if(flags & BC_FLAGS_FAST)
+        return BC67_PROFILE_FAST;
+    if(flags & BC_FLAGS_SLOW)
+        return BC67_PROFILE_SLOW;
+    return BC67_PROFILE_NORMAL;
+}
+
+
+//-------------------------------------------------------------------------------------
+// Ranks the shapes of a partitioned mode by how far the pixels of each region spread
+// around the region mean, and moves the uCandidates most compact shapes to the front
+// of auShape. All four channels of every region are accumulated at once, which costs
+// far less than fitting endpoints for each shape as RoughMSE does.
+//-------------------------------------------------------------------------------------
+static void RankShapes( _In_reads_(NUM_PIXELS_PER_BLOCK) const XMVECTOR* pPixels, _In_range_(1,2) size_t uPartitions,
+                        _In_range_(1,BC7_MAX_SHAPES) size_t uShapes, _In_ size_t uCandidates,
+                        _Out_writes_(uShapes) size_t auShape[] )
+{
+    assert( pPixels && auShape );
+    assert( uPartitions < BC7_MAX_REGIONS && uShapes <= BC7_MAX_SHAPES );
+    _Analysis_assume_( uPartitions < BC7_MAX_REGIONS && uShapes <= BC7_MAX_SHAPES );
+
+    float afSpread[BC7_MAX_SHAPES];
+
+    for(size_t s = 0; s < uShapes; ++s)
+    {
+        XMVECTOR vSum[BC7_MAX_REGIONS];
+        XMVECTOR vSumSq[BC7_MAX_REGIONS];
+        size_t auCount[BC7_MAX_REGIONS];
+        for(size_t p = 0; p <= uPartitions; ++p)
+        {
+            vSum[p] = vSumSq[p] = XMVectorZero();
+            auCount[p] = 0;
+        }
+
+        for(size_t i = 0; i < NUM_PIXELS_PER_BLOCK; ++i)
+        {
+            const uint8_t uRegion = g_aPartitionTable[uPartitions][s][i];
+            vSum[uRegion] = XMVectorAdd( vSum[uRegion], pPixels[i] );
+            vSumSq[uRegion] = XMVectorMultiplyAdd( pPixels[i], pPixels[i], vSumSq[uRegion] );
+            ++auCount[uRegion];
+        }
+
+        // sum(x^2) - sum(x)^2 / n per region
+        XMVECTOR vSpread = XMVectorZero();
+        for(size_t p = 0; p <= uPartitions; ++p)
+        {
+            assert( auCount[p] > 0 );
+            XMVECTOR vMeanSq = XMVectorScale( XMVectorMultiply( vSum[p], vSum[p] ), 1.0f / float(auCount[p]) );
+            vSpread = XMVectorAdd( vSpread, XMVectorSubtract( vSumSq[p], vMeanSq ) );
+        }
+
+        afSpread[s] = XMVectorGetX( XMVector4Dot( vSpread, g_XMOne ) );
+        auShape[s] = s;
+    }
+
+    uCandidates = std::min<size_t>(uCandidates, uShapes);
+    for(size_t i = 0; i < uCandidates; i++)
+    {
+        for(size_t j = i + 1; j < uShapes; j++)
+        {
+            if(afSpread[i] > afSpread[j])
+            {
+                std::swap(afSpread[i], afSpread[j]);
+                std::swap(auShape[i], auShape[j]);
+            }
+        }
+    }
+}
+
+
 //-------------------------------------------------------------------------------------
 // BC6H Compression
 //-------------------------------------------------------------------------------------
@@ -1234,33 +1328,107 @@ void D3DX_BC6H::Decode(bool bSigned, HDRColorA* pOut) const
 }
 
 _Use_decl_annotations_
-void D3DX_BC6H::Encode(bool bSigned, const HDRColorA* const pIn)
+void D3DX_BC6H::Encode(bool bSigned, DWORD flags, const HDRColorA* const pIn)
 {
     assert( pIn );
 
     EncodeParams EP(pIn, bSigned);
+    const BC67_PROFILE profile = GetProfile(flags);
+
+    // Block statistics the pruned profiles pick modes from
+    INTColor minColor = EP.aIPixels[0];
+    INTColor maxColor = EP.aIPixels[0];
+    for(size_t i = 1; i < NUM_PIXELS_PER_BLOCK; ++i)
+    {
+        minColor.r = std::min<int>(minColor.r, EP.aIPixels[i].r);
+        minColor.g = std::min<int>(minColor.g, EP.aIPixels[i].g);
+        minColor.b = std::min<int>(minColor.b, EP.aIPixels[i].b);
+        maxColor.r = std::max<int>(maxColor.r, EP.aIPixels[i].r);
+        maxColor.g = std::max<int>(maxColor.g, EP.aIPixels[i].g);
+        maxColor.b = std::max<int>(maxColor.b, EP.aIPixels[i].b);
+    }
+    const int iRange = std::max<int>(maxColor.r - minColor.r, std::max<int>(maxColor.g - minColor.g, maxColor.b - minColor.b));
+    const bool bLowVariance = iRange <= BC6H_LOW_VARIANCE_RANGE;
 
-    for(EP.uMode = 0; EP.uMode < ARRAYSIZE(ms_aInfo) && EP.fBestErr > 0; ++EP.uMode)
+    // Single region modes are tried first by the pruned profiles, they are cheap and often good enough to stop at
+    uint8_t auModes[ARRAYSIZE(ms_aInfo)];
+    size_t uNumModes = 0;
+    size_t uCandidates = BC6H_MAX_SHAPES;
+    float fEarlyOut = 0.0f;
+    switch(profile)
     {
+    case BC67_PROFILE_ULTRAFAST:
+    case BC67_PROFILE_FAST:
+        for(uint8_t uMode = 0; uMode < ARRAYSIZE(ms_aInfo); ++uMode)
+        {
+            if(!ms_aInfo[uMode].uPartitions)
+                auModes[uNumModes++] = uMode;
+        }
+        if(profile == BC67_PROFILE_FAST && !bLowVariance)
+        {
+            for(uint8_t uMode = 0; uMode < ARRAYSIZE(ms_aInfo); ++uMode)
+            {
+                if(ms_aInfo[uMode].uPartitions)
+                    auModes[uNumModes++] = uMode;
+            }
+        }
+        uCandidates = (profile == BC67_PROFILE_FAST) ? BC67_FAST_SHAPE_CANDIDATES : BC67_ULTRAFAST_SHAPE_CANDIDATES;
+        fEarlyOut = (profile == BC67_PROFILE_FAST) ? BC6H_FAST_EARLY_OUT_ERROR : BC6H_ULTRAFAST_EARLY_OUT_ERROR;
+        break;
+
+    default:
+        for(uint8_t uMode = 0; uMode < ARRAYSIZE(ms_aInfo); ++uMode)
+            auModes[uNumModes++] = uMode;
+        break;
+    }
+
+    XMVECTOR aPixels[NUM_PIXELS_PER_BLOCK];
+    if(uCandidates < BC6H_MAX_SHAPES)
+    {
+        for(size_t i = 0; i < NUM_PIXELS_PER_BLOCK; ++i)
+            aPixels[i] = XMVectorSet( float(EP.aIPixels[i].r), float(EP.aIPixels[i].g), float(EP.aIPixels[i].b), 0.0f );
+    }
+
+    for(size_t m = 0; m < uNumModes && EP.fBestErr > fEarlyOut; ++m)
+    {
+        EP.uMode = auModes[m];
+
         const uint8_t uShapes = ms_aInfo[EP.uMode].uPartitions ? 32 : 1;
         // Number of rough cases to look at. reasonable values of this are 1, uShapes/4, and uShapes
         // uShapes/4 gets nearly all the cases; you can increase that a bit (say by 3 or 4) if you really want to squeeze the last bit out
-        const size_t uItems = std::max<size_t>(1, uShapes >> 2);
+        size_t uItems = std::max<size_t>(1, uShapes >> 2);
+        size_t uRoughShapes = uShapes;
         float afRoughMSE[BC6H_MAX_SHAPES];
-        uint8_t auShape[BC6H_MAX_SHAPES];
+        size_t auShape[BC6H_MAX_SHAPES];
+
+        if(profile == BC67_PROFILE_SLOW)
+        {
+            uItems = std::min<size_t>(uShapes, uItems + BC67_SLOW_EXTRA_ITEMS);
+        }
+        else if(uCandidates < uShapes)
+        {
+            // only the most compact shapes get a rough fit, and only the best of those is refined
+            RankShapes(aPixels, ms_aInfo[EP.uMode].uPartitions, uShapes, uCandidates, auShape);
+            uRoughShapes = uCandidates;
+            uItems = 1;
+        }
+        else
+        {
+            for(size_t s = 0; s < uShapes; ++s)
+                auShape[s] = s;
+        }
 
         // pick the best uItems shapes and refine these.
-        for(EP.uShape = 0; EP.uShape < uShapes; ++EP.uShape)
+        for(size_t i = 0; i < uRoughShapes; ++i)
         {
-            size_t uShape = EP.uShape;
-            afRoughMSE[uShape] = RoughMSE(&EP);
-            auShape[uShape] = static_cast<uint8_t>(uShape);
+            EP.uShape = static_cast<uint8_t>(auShape[i]);
+            afRoughMSE[i] = RoughMSE(&EP);
         }
 
         // Bubble up the first uItems items
         for(register size_t i = 0; i < uItems; i++)
         {
-            for(register size_t j = i + 1; j < uShapes; j++)
+            for(register size_t j = i + 1; j < uRoughShapes; j++)
             {
                 if(afRoughMSE[i] > afRoughMSE[j])
                 {
@@ -1270,9 +1438,9 @@ void D3DX_BC6H::Encode(bool bSigned, const HDRColorA* const pIn)
             }
         }
 
-        for(size_t i = 0; i < uItems && EP.fBestErr > 0; i++)
+        for(size_t i = 0; i < uItems && EP.fBestErr > fEarlyOut; i++)
         {
-            EP.uShape = auShape[i];
+            EP.uShape = static_cast<uint8_t>(auShape[i]);
             Refine(&EP);
         }
     }
@@ -2142,13 +2310,14 @@ void D3DX_BC7::Decode(HDRColorA* pOut) const
 }
 
 _Use_decl_annotations_
-void D3DX_BC7::Encode(bool skip3subsets, const HDRColorA* const pIn)
+void D3DX_BC7::Encode(DWORD flags, const HDRColorA* const pIn)
 {
     assert( pIn );
 
     D3DX_BC7 final = *this;
     EncodeParams EP(pIn);
     float fMSEBest = FLT_MAX;
+    const BC67_PROFILE profile = GetProfile(flags);
     
     for(size_t i = 0; i < NUM_PIXELS_PER_BLOCK; ++i)
     {
@@ -2158,27 +2327,125 @@ void D3DX_BC7::Encode(bool skip3subsets, const HDRColorA* const pIn)
         EP.aLDRPixels[i].a = uint8_t( std::max<float>( 0.0f, std::min<float>( 255.0f, pIn[i].a * 255.0f + 0.01f ) ) );
     }
 
-    for(EP.uMode = 0; EP.uMode < 8 && fMSEBest > 0; ++EP.uMode)
-    {
-        if ( skip3subsets && (EP.uMode == 0 || EP.uMode == 2) )
+    // Block statistics the pruned profiles pick modes from
+    LDRColorA minColor = EP.aLDRPixels[0];
+    LDRColorA maxColor = EP.aLDRPixels[0];
+    for(size_t i = 1; i < NUM_PIXELS_PER_BLOCK; ++i)
+    {
+        minColor.r = std::min<uint8_t>(minColor.r, EP.aLDRPixels[i].r);
+        minColor.g = std::min<uint8_t>(minColor.g, EP.aLDRPixels[i].g);
+        minColor.b = std::min<uint8_t>(minColor.b, EP.aLDRPixels[i].b);
+        minColor.a = std::min<uint8_t>(minColor.a, EP.aLDRPixels[i].a);
+        maxColor.r = std::max<uint8_t>(maxColor.r, EP.aLDRPixels[i].r);
+        maxColor.g = std::max<uint8_t>(maxColor.g, EP.aLDRPixels[i].g);
+        maxColor.b = std::max<uint8_t>(maxColor.b, EP.aLDRPixels[i].b);
+        maxColor.a = std::max<uint8_t>(maxColor.a, EP.aLDRPixels[i].a);
+    }
+    const int iRange = std::max<int>( std::max<int>(maxColor.r - minColor.r, maxColor.g - minColor.g),
+                                      std::max<int>(maxColor.b - minColor.b, maxColor.a - minColor.a) );
+    const bool bOpaque = minColor.a == 255;
+    const bool bSolid = iRange == 0;
+    const bool bLowVariance = iRange <= BC7_LOW_VARIANCE_RANGE;
+
+    // The pruned profiles start with mode 6, which handles any block with a single subset, and only
+    // try the modes that suit the block after it: separate alpha for translucent blocks, and the
+    // partitioned color or color+alpha modes for blocks with enough spread to need more than one subset
+    uint8_t auModes[8];
+    size_t uNumModes = 0;
+    size_t uCandidates = BC7_MAX_SHAPES;
+    float fEarlyOut = 0.0f;
+    switch(profile)
+    {
+    case BC67_PROFILE_ULTRAFAST:
+        auModes[uNumModes++] = 6;
+        if(!bLowVariance)
+            auModes[uNumModes++] = bOpaque ? 1 : 7;
+        uCandidates = BC67_ULTRAFAST_SHAPE_CANDIDATES;
+        fEarlyOut = BC7_ULTRAFAST_EARLY_OUT_ERROR;
+        break;
+
+    case BC67_PROFILE_FAST:
+        auModes[uNumModes++] = 6;
+        if(!bSolid && !bOpaque)
+        {
+            auModes[uNumModes++] = 5;
+            auModes[uNumModes++] = 4;
+        }
+        if(!bLowVariance)
+        {
+            if(bOpaque)
+            {
+                auModes[uNumModes++] = 1;
+                auModes[uNumModes++] = 3;
+            }
+            else
+            {
+                auModes[uNumModes++] = 7;
+            }
+        }
+        uCandidates = BC67_FAST_SHAPE_CANDIDATES;
+        fEarlyOut = BC7_FAST_EARLY_OUT_ERROR;
+        break;
+
+    default:
+        for(uint8_t uMode = 0; uMode < 8; ++uMode)
         {
-            // 3 subset modes tend to be used rarely and add significant compression time
-            continue;
+            if ( profile == BC67_PROFILE_NORMAL && !(flags & BC_FLAGS_USE_3SUBSETS) && (uMode == 0 || uMode == 2) )
+            {
+                // 3 subset modes tend to be used rarely and add significant compression time
+                continue;
+            }
+            auModes[uNumModes++] = uMode;
         }
+        break;
+    }
+
+    // the pruned profiles only look at the first rotation, and ultrafast only at the first index mode
+    const bool bPruned = profile == BC67_PROFILE_ULTRAFAST || profile == BC67_PROFILE_FAST;
+
+    XMVECTOR aPixels[NUM_PIXELS_PER_BLOCK];
+    if(bPruned)
+    {
+        for(size_t i = 0; i < NUM_PIXELS_PER_BLOCK; ++i)
+            aPixels[i] = XMLoadUByte4( reinterpret_cast<const XMUBYTE4*>( &EP.aLDRPixels[i] ) );
+    }
+
+    for(size_t m = 0; m < uNumModes && fMSEBest > fEarlyOut; ++m)
+    {
+        EP.uMode = auModes[m];
 
         const size_t uShapes = size_t(1) << ms_aInfo[EP.uMode].uPartitionBits;
         assert( uShapes <= BC7_MAX_SHAPES );
         _Analysis_assume_( uShapes <= BC7_MAX_SHAPES );
 
-        const size_t uNumRots = size_t(1) << ms_aInfo[EP.uMode].uRotationBits;
-        const size_t uNumIdxMode = size_t(1) << ms_aInfo[EP.uMode].uIndexModeBits;
+        const size_t uNumRots = bPruned ? 1 : size_t(1) << ms_aInfo[EP.uMode].uRotationBits;
+        const size_t uNumIdxMode = profile == BC67_PROFILE_ULTRAFAST ? 1 : size_t(1) << ms_aInfo[EP.uMode].uIndexModeBits;
         // Number of rough cases to look at. reasonable values of this are 1, uShapes/4, and uShapes
         // uShapes/4 gets nearly all the cases; you can increase that a bit (say by 3 or 4) if you really want to squeeze the last bit out
-        const size_t uItems = std::max<size_t>(1, uShapes >> 2);
+        size_t uItems = std::max<size_t>(1, uShapes >> 2);
+        size_t uRoughShapes = uShapes;
         float afRoughMSE[BC7_MAX_SHAPES];
         size_t auShape[BC7_MAX_SHAPES];
+        size_t auRanked[BC7_MAX_SHAPES];
+
+        if(profile == BC67_PROFILE_SLOW)
+        {
+            uItems = std::min<size_t>(uShapes, uItems + BC67_SLOW_EXTRA_ITEMS);
+        }
+        else if(bPruned && uCandidates < uShapes)
+        {
+            // partitioned modes have no rotations, so the ranking holds for every index mode
+            RankShapes(aPixels, ms_aInfo[EP.uMode].uPartitions, uShapes, uCandidates, auRanked);
+            uRoughShapes = uCandidates;
+            uItems = 1;
+        }
+        else
+        {
+            for(size_t s = 0; s < uShapes; ++s)
+                auRanked[s] = s;
+        }
 
-        for(size_t r = 0; r < uNumRots && fMSEBest > 0; ++r)
+        for(size_t r = 0; r < uNumRots && fMSEBest > fEarlyOut; ++r)
         {
             switch(r)
             {
@@ -2187,19 +2454,19 @@ void D3DX_BC7::Encode(bool skip3subsets, const HDRColorA* const pIn)
             case 3: for(register size_t i = 0; i < NUM_PIXELS_PER_BLOCK; i++) std::swap(EP.aLDRPixels[i].b, EP.aLDRPixels[i].a); break;
             }
 
-            for(size_t im = 0; im < uNumIdxMode && fMSEBest > 0; ++im)
+            for(size_t im = 0; im < uNumIdxMode && fMSEBest > fEarlyOut; ++im)
             {
                 // pick the best uItems shapes and refine these.
-                for(size_t s = 0; s < uShapes; s++)
+                for(size_t i = 0; i < uRoughShapes; i++)
                 {
-                    afRoughMSE[s] = RoughMSE(&EP, s, im);
-                    auShape[s] = s;
+                    afRoughMSE[i] = RoughMSE(&EP, auRanked[i], im);
+                    auShape[i] = auRanked[i];
                 }
 
                 // Bubble up the first uItems items
                 for(size_t i = 0; i < uItems; i++)
                 {
-                    for(size_t j = i + 1; j < uShapes; j++)
+                    for(size_t j = i + 1; j < uRoughShapes; j++)
                     {
                         if(afRoughMSE[i] > afRoughMSE[j])
                         {
@@ -2209,7 +2476,7 @@ void D3DX_BC7::Encode(bool skip3subsets, const HDRColorA* const pIn)
                     }
                 }
 
-                for(size_t i = 0; i < uItems && fMSEBest > 0; i++)
+                for(size_t i = 0; i < uItems && fMSEBest > fEarlyOut; i++)
                 {
                     float fMSE = Refine(&EP, auShape[i], r, im);
                     if(fMSE < fMSEBest)
@@ -2835,19 +3102,17 @@ void D3DXDecodeBC6HS(XMVECTOR *pColor, const uint8_t *pBC)
 _Use_decl_annotations_
 void D3DXEncodeBC6HU(uint8_t *pBC, const XMVECTOR *pColor, DWORD flags)
 {
-    UNREFERENCED_PARAMETER(flags);
     assert( pBC && pColor );
     static_assert( sizeof(D3DX_BC6H) == 16, "D3DX_BC6H should be 16 bytes" );
-    reinterpret_cast< D3DX_BC6H* >( pBC )->Encode(false, reinterpret_cast<const HDRColorA*>(pColor));
+    reinterpret_cast< D3DX_BC6H* >( pBC )->Encode(false, flags, reinterpret_cast<const HDRColorA*>(pColor));
 }
 
 _Use_decl_annotations_
 void D3DXEncodeBC6HS(uint8_t *pBC, const XMVECTOR *pColor, DWORD flags)
 {
-    UNREFERENCED_PARAMETER(flags);
     assert( pBC && pColor );
     static_assert( sizeof(D3DX_BC6H) == 16, "D3DX_BC6H should be 16 bytes" );
-    reinterpret_cast< D3DX_BC6H* >( pBC )->Encode(true, reinterpret_cast<const HDRColorA*>(pColor));
+    reinterpret_cast< D3DX_BC6H* >( pBC )->Encode(true, flags, reinterpret_cast<const HDRColorA*>(pColor));
 }
 
 
@@ -2867,7 +3132,7 @@ void D3DXEncodeBC7(uint8_t *pBC, const XMVECTOR *pColor, DWORD flags)
 {
     assert( pBC && pColor );
     static_assert( sizeof(D3DX_BC7) == 16, "D3DX_BC7 should be 16 bytes" );
-    reinterpret_cast< D3DX_BC7* >( pBC )->Encode( !(flags& BC_FLAGS_USE_3SUBSETS), reinterpret_cast<const HDRColorA*>(pColor));
+    reinterpret_cast< D3DX_BC7* >( pBC )->Encode( flags, reinterpret_cast<const HDRColorA*>(pColor));
 }
 
 } // namespace
@@ -319,6 +319,10 @@ namespace DirectX
                                        _Out_opt_ TexMetadata* metadata, _Out_ ScratchImage& image );
     HRESULT __cdecl LoadFromDDSFile( _In_z_ LPCWSTR szFile, _In_ DWORD flags,
                                      _Out_opt_ TexMetadata* metadata, _Out_ ScratchImage& image );
+    HRESULT __cdecl GetImagesFromDDSMemory( _In_reads_bytes_(size) LPCVOID pSource, _In_ size_t size, _In_ DWORD flags,
+                                            _Out_ TexMetadata& metadata, _Out_writes_opt_(nImages) Image* images, _Inout_ size_t& nImages );
+        // Describes the surfaces of a DDS in memory in place, without copying any pixel data. Pass images == nullptr
+        // to query the required count. Fails with ERROR_NOT_SUPPORTED when the data needs conversion on load.
 
     HRESULT __cdecl SaveToDDSMemory( _In_ const Image& image, _In_ DWORD flags,
                                      _Out_ Blob& blob );
@@ -425,6 +429,9 @@ namespace DirectX
 
         TEX_FILTER_FORCE_WIC        = 0x20000000,
             // Forces use of the WIC path even when logic would have picked a non-WIC path when both are an option
+
+        TEX_FILTER_PARALLEL         = 0x40000000,
+            // Non-WIC conversions, resizes and mipmap generation are free to use multithreading to improve performance (by default they do not use multithreading)
     };
 
     HRESULT __cdecl Resize( _In_ const Image& srcImage, _In_ size_t width, _In_ size_t height, _In_ DWORD filter,
@@ -496,6 +503,16 @@ namespace DirectX
         TEX_COMPRESS_BC7_USE_3SUBSETS = 0x80000,
             // Enables exhaustive search for BC7 compress for mode 0 and 2; by default skips trying these modes
 
+        TEX_COMPRESS_FAST           = 0x100000,
+            // Fewer endpoint refinement iterations for BC1-3 compression, trades some quality for speed
+            // For BC6H/BC7 skips modes the block cannot use (opaque, solid or low-variance blocks) and only refines the best ranked partition
+
+        TEX_COMPRESS_ULTRAFAST      = 0x200000,
+            // BC6H/BC7 compression only tries the single subset modes and one ranked partition per mode; BC1-3 behave as TEX_COMPRESS_FAST
+
+        TEX_COMPRESS_SLOW           = 0x400000,
+            // BC6H/BC7 compression refines more partitions per mode and includes BC7 mode 0 and 2
+
         TEX_COMPRESS_SRGB_IN        = 0x1000000,
         TEX_COMPRESS_SRGB_OUT       = 0x2000000,
         TEX_COMPRESS_SRGB           = ( TEX_COMPRESS_SRGB_IN | TEX_COMPRESS_SRGB_OUT ),
@@ -22,6 +22,11 @@
 
 #include "BC.h"
 
+#if defined(_M_IX86) || defined(_M_X64)
+#include <intrin.h>
+#include <tmmintrin.h>
+#endif
+
 
 namespace DirectX
 {
@@ -33,7 +38,10 @@ inline static DWORD _GetBCFlags( _In_ DWORD compress )
     static_assert( TEX_COMPRESS_DITHER == (BC_FLAGS_DITHER_RGB | BC_FLAGS_DITHER_A), "TEX_COMPRESS_* flags should match BC_FLAGS_*"  );
     static_assert( TEX_COMPRESS_UNIFORM == BC_FLAGS_UNIFORM, "TEX_COMPRESS_* flags should match BC_FLAGS_*"  );
     static_assert( TEX_COMPRESS_BC7_USE_3SUBSETS == BC_FLAGS_USE_3SUBSETS, "TEX_COMPRESS_* flags should match BC_FLAGS_*"  );
-    return ( compress & (BC_FLAGS_DITHER_RGB|BC_FLAGS_DITHER_A|BC_FLAGS_UNIFORM|BC_FLAGS_USE_3SUBSETS) );
+    static_assert( TEX_COMPRESS_FAST == BC_FLAGS_FAST, "TEX_COMPRESS_* flags should match BC_FLAGS_*"  );
+    static_assert( TEX_COMPRESS_ULTRAFAST == BC_FLAGS_ULTRAFAST, "TEX_COMPRESS_* flags should match BC_FLAGS_*"  );
+    static_assert( TEX_COMPRESS_SLOW == BC_FLAGS_SLOW, "TEX_COMPRESS_* flags should match BC_FLAGS_*"  );
+    return ( compress & (BC_FLAGS_DITHER_RGB|BC_FLAGS_DITHER_A|BC_FLAGS_UNIFORM|BC_FLAGS_USE_3SUBSETS|BC_FLAGS_FAST|BC_FLAGS_ULTRAFAST|BC_FLAGS_SLOW) );
 }
 
 inline static DWORD _GetSRGBFlags( _In_ DWORD compress )
@@ -70,8 +78,23 @@ inline static bool _DetermineEncoderSettings( _In_ DXGI_FORMAT format, _Out_ BC_
 
 
 //-------------------------------------------------------------------------------------
-static HRESULT _CompressBC( _In_ const Image& image, _In_ const Image& result, _In_ DWORD bcflags,
-                            _In_ DWORD srgb, _In_ float alphaRef )
+namespace
+{
+    // A band should have at least this many block rows to be worth a thread
+    const size_t BC_COMPRESS_BAND_BLOCK_ROWS = 2;
+
+    struct BCEncodeContext
+    {
+        DXGI_FORMAT     format;
+        size_t          sbpp;
+        BC_ENCODE       pfEncode;       // nullptr for BC1, which takes alphaRef
+        size_t          blocksize;
+        DWORD           cflags;
+        bool            batched;        // BC1 and BC3 encode BC_BATCH_BLOCKS blocks per call
+    };
+}
+
+static HRESULT _SetupCompressBC( _In_ const Image& image, _In_ const Image& result, _Out_ BCEncodeContext& ctx )
 {
     if ( !image.pixels || !result.pixels )
         return E_POINTER;
@@ -93,23 +116,35 @@ static HRESULT _CompressBC( _In_ const Image& image, _In_ const Image& result, _
     // Round to bytes
     sbpp = ( sbpp + 7 ) / 8;
 
-    uint8_t *pDest = result.pixels;
-
     // Determine BC format encoder
-    BC_ENCODE pfEncode;
-    size_t blocksize;
-    DWORD cflags;
-    if ( !_DetermineEncoderSettings( result.format, pfEncode, blocksize, cflags ) )
+    if ( !_DetermineEncoderSettings( result.format, ctx.pfEncode, ctx.blocksize, ctx.cflags ) )
         return HRESULT_FROM_WIN32( ERROR_NOT_SUPPORTED );
 
-    XMVECTOR temp[16];
-    const uint8_t *pSrc = image.pixels;
+    ctx.format = format;
+    ctx.sbpp = sbpp;
+    ctx.batched = ( ctx.pfEncode == nullptr || ctx.pfEncode == D3DXEncodeBC3 );
+
+    return S_OK;
+}
+
+static HRESULT _CompressBCRows( _In_ const Image& image, _In_ const Image& result, _In_ const BCEncodeContext& ctx, _In_ DWORD bcflags,
+                                _In_ DWORD srgb, _In_ float alphaRef, _In_ size_t blockRowStart, _In_ size_t blockRowEnd )
+{
+    const DXGI_FORMAT format = ctx.format;
+    const size_t sbpp = ctx.sbpp;
+    const size_t blocksize = ctx.blocksize;
+
+    XMVECTOR temp[NUM_PIXELS_PER_BLOCK * BC_BATCH_BLOCKS];
+    const uint8_t *pSrc = image.pixels + image.rowPitch * 4 * blockRowStart;
     const uint8_t *pEnd = image.pixels + image.slicePitch;
+    uint8_t *pDest = result.pixels + result.rowPitch * blockRowStart;
     const size_t rowPitch = image.rowPitch;
-    for( size_t h=0; h < image.height; h += 4 )
+    for( size_t h = blockRowStart * 4; h < blockRowEnd * 4 && h < image.height; h += 4 )
     {
         const uint8_t *sptr = pSrc;
         uint8_t* dptr = pDest;
+        uint8_t* batchDest = pDest;
+        size_t nBatch = 0;
         size_t ph = std::min<size_t>( 4, image.height - h );
         size_t w = 0;
         for( size_t count = 0; (count < result.rowPitch) && (w < image.width); count += blocksize, w += 4 )
@@ -117,28 +152,30 @@ static HRESULT _CompressBC( _In_ const Image& image, _In_ const Image& result, _
             size_t pw = std::min<size_t>( 4, image.width - w );
             assert( pw > 0 && ph > 0 );
 
+            XMVECTOR* block = &temp[ NUM_PIXELS_PER_BLOCK * nBatch ];
+
             ptrdiff_t bytesLeft = pEnd - sptr;
             assert( bytesLeft > 0 );
             size_t bytesToRead = std::min<size_t>( rowPitch, bytesLeft );
-            if ( !_LoadScanline( &temp[0], pw, sptr, bytesToRead, format ) )
+            if ( !_LoadScanline( &block[0], pw, sptr, bytesToRead, format ) )
                 return E_FAIL;
 
             if ( ph > 1 )
             {
                 bytesToRead = std::min<size_t>( rowPitch, bytesLeft - rowPitch );
-                if ( !_LoadScanline( &temp[4], pw, sptr + rowPitch, bytesToRead, format ) )
+                if ( !_LoadScanline( &block[4], pw, sptr + rowPitch, bytesToRead, format ) )
                     return E_FAIL;
 
                 if ( ph > 2 )
                 {
                     bytesToRead = std::min<size_t>( rowPitch, bytesLeft - rowPitch * 2 );
-                    if ( !_LoadScanline( &temp[8], pw, sptr + rowPitch*2, bytesToRead, format ) )
+                    if ( !_LoadScanline( &block[8], pw, sptr + rowPitch*2, bytesToRead, format ) )
                         return E_FAIL;
 
                     if ( ph > 3 )
                     {
                         bytesToRead = std::min<size_t>( rowPitch, bytesLeft - rowPitch * 3 );
-                        if ( !_LoadScanline( &temp[12], pw, sptr + rowPitch*3, bytesToRead, format ) )
+                        if ( !_LoadScanline( &block[12], pw, sptr + rowPitch*3, bytesToRead, format ) )
                             return E_FAIL;
                     }
                 }
@@ -156,7 +193,7 @@ static HRESULT _CompressBC( _In_ const Image& image, _In_ const Image& result, _
                         for( size_t s = pw; s < 4; ++s )
                         {
 #pragma prefast(suppress: 26000, "PREFAST false positive")
-                            temp[ (t << 2) | s ] = temp[ (t << 2) | uSrc[s] ]; 
+                            block[ (t << 2) | s ] = block[ (t << 2) | uSrc[s] ]; 
                         }
                     }
                 }
@@ -168,18 +205,29 @@ static HRESULT _CompressBC( _In_ const Image& image, _In_ const Image& result, _
                         for( size_t s = 0; s < 4; ++s )
                         {
 #pragma prefast(suppress: 26000, "PREFAST false positive")
-                            temp[ (t << 2) | s ] = temp[ (uSrc[t] << 2) | s ]; 
+                            block[ (t << 2) | s ] = block[ (uSrc[t] << 2) | s ]; 
                         }
                     }
                 }
             }
 
-            _ConvertScanline( temp, 16, result.format, format, cflags | srgb );
-            
-            if ( pfEncode )
-                pfEncode( dptr, temp, bcflags );
-            else
-                D3DXEncodeBC1( dptr, temp, alphaRef, bcflags );
+            _ConvertScanline( block, 16, result.format, format, ctx.cflags | srgb );
+
+            if ( !ctx.batched )
+            {
+                ctx.pfEncode( dptr, block, bcflags );
+            }
+            else if ( ++nBatch == BC_BATCH_BLOCKS || (count + blocksize >= result.rowPitch) || (w + 4 >= image.width) )
+            {
+                // Batch is full or the row ends
+                if ( ctx.pfEncode )
+                    D3DXEncodeBC3Batch( batchDest, temp, nBatch, bcflags );
+                else
+                    D3DXEncodeBC1Batch( batchDest, temp, nBatch, alphaRef, bcflags );
+
+                batchDest = dptr + blocksize;
+                nBatch = 0;
+            }
 
             sptr += sbpp*4;
             dptr += blocksize;
@@ -192,6 +240,24 @@ static HRESULT _CompressBC( _In_ const Image& image, _In_ const Image& result, _
     return S_OK;
 }
 
+static HRESULT _CompressBC( _In_ const Image& image, _In_ const Image& result, _In_ DWORD bcflags,
+                            _In_ DWORD srgb, _In_ float alphaRef, _In_ bool parallel )
+{
+    BCEncodeContext ctx;
+    HRESULT hr = _SetupCompressBC( image, result, ctx );
+    if ( FAILED(hr) )
+        return hr;
+
+    const size_t blockRows = ( image.height + 3 ) / 4;
+    if ( !parallel )
+        return _CompressBCRows( image, result, ctx, bcflags, srgb, alphaRef, 0, blockRows );
+
+    return _ProcessRowBands( blockRows, BC_COMPRESS_BAND_BLOCK_ROWS, [&]( size_t start, size_t end ) -> HRESULT
+    {
+        return _CompressBCRows( image, result, ctx, bcflags, srgb, alphaRef, start, end );
+    } );
+}
+
 
 //-------------------------------------------------------------------------------------
 #ifdef _OPENMP
@@ -373,7 +439,134 @@ static DXGI_FORMAT _DefaultDecompress( _In_ DXGI_FORMAT format )
 
 
 //-------------------------------------------------------------------------------------
-static HRESULT _DecompressBC( _In_ const Image& cImage, _In_ const Image& result )
+// Block decompression
+//-------------------------------------------------------------------------------------
+namespace
+{
+    // BC1-BC5 blocks are decoded from their palettes: each palette is decoded and converted to
+    // the output format once per block and pixels are copied from it by index
+    enum BC_PALETTE_MODE
+    {
+        BC_PALETTE_NONE = 0,    // decode every pixel with the block decoder
+        BC_PALETTE_BC1,
+        BC_PALETTE_BC2,
+        BC_PALETTE_BC3,
+        BC_PALETTE_BC4U,
+        BC_PALETTE_BC4S,
+        BC_PALETTE_BC5U,
+        BC_PALETTE_BC5S,
+    };
+
+    const size_t BC_MAX_PIXEL_BYTES = 16;
+
+    // Image is split into bands of at least this many block rows, one per thread
+    const size_t BC_DECOMPRESS_BAND_BLOCK_ROWS = 16;
+
+    struct BCDecodeContext
+    {
+        DXGI_FORMAT     format;
+        DXGI_FORMAT     cformat;
+        BC_DECODE       pfDecode;
+        BC_PALETTE_MODE mode;
+        size_t          sbpp;
+        size_t          dbpp;
+        size_t          secondaryOffset;    // Output bytes from here on come from the secondary palette
+        bool            useSSSE3;
+    };
+
+    struct BCBlockPalette
+    {
+        uint8_t     primary[8 * BC_MAX_PIXEL_BYTES];
+        uint8_t     secondary[16 * BC_MAX_PIXEL_BYTES];
+        uint8_t     secondaryLane[16];  // Byte 3 of each 4 byte secondary entry
+        uint8_t     primaryIndex[NUM_PIXELS_PER_BLOCK];
+        uint8_t     secondaryIndex[NUM_PIXELS_PER_BLOCK];
+        uint64_t    key;                // Endpoint bytes the palettes were decoded from
+        bool        valid;
+    };
+}
+
+static bool _HasSSSE3()
+{
+#if defined(_M_IX86) || defined(_M_X64)
+    int info[4];
+    __cpuid( info, 1 );
+    return ( info[2] & (1 << 9) ) != 0;
+#else
+    return false;
+#endif
+}
+
+static BC_PALETTE_MODE _GetPaletteMode( _In_ DXGI_FORMAT cformat, _In_ DXGI_FORMAT format, _In_ size_t dbpp, _Out_ size_t& secondaryOffset )
+{
+    secondaryOffset = dbpp;
+
+    if ( dbpp > BC_MAX_PIXEL_BYTES )
+        return BC_PALETTE_NONE;
+
+    // These store pixel pairs, so a pixel can't be copied out of a palette entry
+    switch( static_cast<int>(format) )
+    {
+    case DXGI_FORMAT_R8G8_B8G8_UNORM:
+    case DXGI_FORMAT_G8R8_G8B8_UNORM:
+    case DXGI_FORMAT_YUY2:
+    case DXGI_FORMAT_Y210:
+    case DXGI_FORMAT_Y216:
+        return BC_PALETTE_NONE;
+    }
+
+    switch( cformat )
+    {
+    case DXGI_FORMAT_BC1_UNORM:
+    case DXGI_FORMAT_BC1_UNORM_SRGB:    return BC_PALETTE_BC1;
+    case DXGI_FORMAT_BC4_UNORM:         return BC_PALETTE_BC4U;
+    case DXGI_FORMAT_BC4_SNORM:         return BC_PALETTE_BC4S;
+
+    case DXGI_FORMAT_BC2_UNORM:
+    case DXGI_FORMAT_BC2_UNORM_SRGB:
+    case DXGI_FORMAT_BC3_UNORM:
+    case DXGI_FORMAT_BC3_UNORM_SRGB:
+        // Alpha comes from its own palette, so it has to end up in bytes no other channel touches
+        switch( format )
+        {
+        case DXGI_FORMAT_R32G32B32A32_FLOAT:
+        case DXGI_FORMAT_R16G16B16A16_FLOAT:
+        case DXGI_FORMAT_R16G16B16A16_UNORM:
+        case DXGI_FORMAT_R8G8B8A8_UNORM:
+        case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB:
+        case DXGI_FORMAT_B8G8R8A8_UNORM:
+        case DXGI_FORMAT_B8G8R8A8_UNORM_SRGB:
+            secondaryOffset = dbpp - dbpp / 4;
+            return ( cformat == DXGI_FORMAT_BC2_UNORM || cformat == DXGI_FORMAT_BC2_UNORM_SRGB ) ? BC_PALETTE_BC2 : BC_PALETTE_BC3;
+
+        default:
+            return BC_PALETTE_NONE;
+        }
+
+    case DXGI_FORMAT_BC5_UNORM:
+    case DXGI_FORMAT_BC5_SNORM:
+        // Same for green, which comes from the second BC4 block
+        switch( format )
+        {
+        case DXGI_FORMAT_R32G32_FLOAT:
+        case DXGI_FORMAT_R16G16_FLOAT:
+        case DXGI_FORMAT_R16G16_UNORM:
+        case DXGI_FORMAT_R16G16_SNORM:
+        case DXGI_FORMAT_R8G8_UNORM:
+        case DXGI_FORMAT_R8G8_SNORM:
+            secondaryOffset = dbpp / 2;
+            return ( cformat == DXGI_FORMAT_BC5_UNORM ) ? BC_PALETTE_BC5U : BC_PALETTE_BC5S;
+
+        default:
+            return BC_PALETTE_NONE;
+        }
+
+    default:
+        return BC_PALETTE_NONE;
+    }
+}
+
+static HRESULT _SetupDecompressBC( _In_ const Image& cImage, _In_ const Image& result, _Out_ BCDecodeContext& ctx )
 {
     if ( !cImage.pixels || !result.pixels )
         return E_POINTER;
@@ -395,10 +588,6 @@ static HRESULT _DecompressBC( _In_ const Image& cImage, _In_ const Image& result
     // Round to bytes
     dbpp = ( dbpp + 7 ) / 8;
 
-    uint8_t *pDest = result.pixels;
-    if ( !pDest )
-        return E_POINTER;
-
     // Promote "typeless" BC formats
     DXGI_FORMAT cformat;
     switch( cImage.format )
@@ -436,10 +625,277 @@ static HRESULT _DecompressBC( _In_ const Image& cImage, _In_ const Image& result
         return HRESULT_FROM_WIN32( ERROR_NOT_SUPPORTED );
     }
 
-    XMVECTOR temp[16];
-    const uint8_t *pSrc = cImage.pixels;
+    static const bool s_hasSSSE3 = _HasSSSE3();
+
+    ctx.format = format;
+    ctx.cformat = cformat;
+    ctx.pfDecode = pfDecode;
+    ctx.mode = _GetPaletteMode( cformat, format, dbpp, ctx.secondaryOffset );
+    ctx.sbpp = sbpp;
+    ctx.dbpp = dbpp;
+    ctx.useSSSE3 = s_hasSSSE3 && ( dbpp == 4 );
+
+    return S_OK;
+}
+
+//-------------------------------------------------------------------------------------
+static inline uint64_t _LoadIndexBits48( _In_reads_(6) const uint8_t* pBits )
+{
+    return uint64_t( pBits[0] ) | ( uint64_t( pBits[1] ) << 8 ) | ( uint64_t( pBits[2] ) << 16 )
+         | ( uint64_t( pBits[3] ) << 24 ) | ( uint64_t( pBits[4] ) << 32 ) | ( uint64_t( pBits[5] ) << 40 );
+}
+
+static inline uint32_t _LoadIndexBits32( _In_reads_(4) const uint8_t* pBits )
+{
+    return uint32_t( pBits[0] ) | ( uint32_t( pBits[1] ) << 8 ) | ( uint32_t( pBits[2] ) << 16 ) | ( uint32_t( pBits[3] ) << 24 );
+}
+
+static bool _StorePalette( _Out_writes_bytes_(count * ctx.dbpp) uint8_t* pDest, _Inout_updates_(count) XMVECTOR* pEntries, _In_ size_t count,
+                           _In_ const BCDecodeContext& ctx )
+{
+    _ConvertScanline( pEntries, count, ctx.format, ctx.cformat, 0 );
+    return _StoreScanline( pDest, count * ctx.dbpp, ctx.format, pEntries, count );
+}
+
+static bool _StoreSecondaryPalette( _In_reads_(count) const float* pValues, _In_ size_t count, _In_ size_t channel,
+                                    _In_ const BCDecodeContext& ctx, _Inout_ BCBlockPalette& palette )
+{
+    XMVECTOR entries[16];
+    for( size_t i = 0; i < count; ++i )
+    {
+        entries[i] = ( channel == 3 ) ? XMVectorSet( 0, 0, 0, pValues[i] ) : XMVectorSet( 0, pValues[i], 0, 1.0f );
+    }
+
+    if ( !_StorePalette( palette.secondary, entries, count, ctx ) )
+        return false;
+
+    if ( ctx.dbpp == 4 )
+    {
+        for( size_t i = 0; i < count; ++i )
+            palette.secondaryLane[i] = palette.secondary[i * 4 + 3];
+    }
+
+    return true;
+}
+
+static bool _DecodeBlockPalette( _In_reads_(ctx.sbpp) const uint8_t* pBC, _In_ const BCDecodeContext& ctx, _Inout_ BCBlockPalette& palette )
+{
+    // Indices change every block
+    uint64_t primaryBits = 0;
+    uint64_t secondaryBits = 0;
+    size_t primaryShift = 2;
+    size_t secondaryShift = 0;
+    uint64_t key = 0;
+    switch( ctx.mode )
+    {
+    case BC_PALETTE_BC1:
+        primaryBits = _LoadIndexBits32( pBC + 4 );
+        key = _LoadIndexBits32( pBC );
+        break;
+
+    case BC_PALETTE_BC2:
+        primaryBits = _LoadIndexBits32( pBC + 12 );
+        secondaryBits = _LoadIndexBits32( pBC ) | ( uint64_t( _LoadIndexBits32( pBC + 4 ) ) << 32 );
+        secondaryShift = 4;
+        key = _LoadIndexBits32( pBC + 8 );
+        break;
+
+    case BC_PALETTE_BC3:
+        primaryBits = _LoadIndexBits32( pBC + 12 );
+        secondaryBits = _LoadIndexBits48( pBC + 2 );
+        secondaryShift = 3;
+        key = _LoadIndexBits32( pBC + 8 ) | ( uint64_t( pBC[0] ) << 32 ) | ( uint64_t( pBC[1] ) << 40 );
+        break;
+
+    case BC_PALETTE_BC4U:
+    case BC_PALETTE_BC4S:
+        primaryBits = _LoadIndexBits48( pBC + 2 );
+        primaryShift = 3;
+        key = uint64_t( pBC[0] ) | ( uint64_t( pBC[1] ) << 8 );
+        break;
+
+    case BC_PALETTE_BC5U:
+    case BC_PALETTE_BC5S:
+        primaryBits = _LoadIndexBits48( pBC + 2 );
+        primaryShift = 3;
+        secondaryBits = _LoadIndexBits48( pBC + 10 );
+        secondaryShift = 3;
+        key = uint64_t( pBC[0] ) | ( uint64_t( pBC[1] ) << 8 ) | ( uint64_t( pBC[8] ) << 16 ) | ( uint64_t( pBC[9] ) << 24 );
+        break;
+
+    default:
+        return false;
+    }
+
+    const uint64_t primaryMask = ( uint64_t(1) << primaryShift ) - 1;
+    const uint64_t secondaryMask = ( uint64_t(1) << secondaryShift ) - 1;
+    for( size_t i = 0; i < NUM_PIXELS_PER_BLOCK; ++i )
+    {
+        palette.primaryIndex[i] = static_cast<uint8_t>( ( primaryBits >> ( i * primaryShift ) ) & primaryMask );
+        palette.secondaryIndex[i] = static_cast<uint8_t>( ( secondaryBits >> ( i * secondaryShift ) ) & secondaryMask );
+    }
+
+    // Neighbouring blocks often share endpoints, their palettes are the same then
+    if ( palette.valid && palette.key == key )
+        return true;
+
+    XMVECTOR entries[8];
+    float values[8];
+    switch( ctx.mode )
+    {
+    case BC_PALETTE_BC1:
+        D3DXDecodeBC1Palette( entries, pBC, true );
+        if ( !_StorePalette( palette.primary, entries, 4, ctx ) )
+            return false;
+        break;
+
+    case BC_PALETTE_BC2:
+        D3DXDecodeBC1Palette( entries, pBC + 8, false );
+        if ( !_StorePalette( palette.primary, entries, 4, ctx ) )
+            return false;
+
+        // The alpha palette is the same for every block
+        if ( !palette.valid )
+        {
+            float alpha[16];
+            D3DXDecodeBC2AlphaPalette( alpha );
+            if ( !_StoreSecondaryPalette( alpha, 16, 3, ctx, palette ) )
+                return false;
+        }
+        break;
+
+    case BC_PALETTE_BC3:
+        D3DXDecodeBC1Palette( entries, pBC + 8, false );
+        if ( !_StorePalette( palette.primary, entries, 4, ctx ) )
+            return false;
+
+        D3DXDecodeBC3AlphaPalette( values, pBC );
+        if ( !_StoreSecondaryPalette( values, 8, 3, ctx, palette ) )
+            return false;
+        break;
+
+    case BC_PALETTE_BC4U:
+    case BC_PALETTE_BC5U:
+    case BC_PALETTE_BC4S:
+    case BC_PALETTE_BC5S:
+        {
+            const bool snorm = ( ctx.mode == BC_PALETTE_BC4S || ctx.mode == BC_PALETTE_BC5S );
+            if ( snorm )
+                D3DXDecodeBC4SPalette( values, pBC );
+            else
+                D3DXDecodeBC4UPalette( values, pBC );
+
+            for( size_t i = 0; i < 8; ++i )
+                entries[i] = XMVectorSet( values[i], 0, 0, 1.0f );
+
+            if ( !_StorePalette( palette.primary, entries, 8, ctx ) )
+                return false;
+
+            if ( ctx.mode == BC_PALETTE_BC5U || ctx.mode == BC_PALETTE_BC5S )
+            {
+                if ( snorm )
+                    D3DXDecodeBC4SPalette( values, pBC + 8 );
+                else
+                    D3DXDecodeBC4UPalette( values, pBC + 8 );
+
+                if ( !_StoreSecondaryPalette( values, 8, 1, ctx, palette ) )
+                    return false;
+            }
+        }
+        break;
+    }
+
+    palette.key = key;
+    palette.valid = true;
+    return true;
+}
+
+//-------------------------------------------------------------------------------------
+#if defined(_M_IX86) || defined(_M_X64)
+static void _WriteBlockSSSE3( _Out_ uint8_t* pDest, _In_ size_t rowPitch, _In_ size_t ph, _In_ const BCDecodeContext& ctx,
+                              _In_ const BCBlockPalette& palette )
+{
+    // Four 4 byte entries fill one register, each row of the block is a single shuffle of it
+    const __m128i primary = _mm_loadu_si128( reinterpret_cast<const __m128i*>( palette.primary ) );
+    const __m128i secondary = _mm_loadu_si128( reinterpret_cast<const __m128i*>( palette.secondaryLane ) );
+    const __m128i secondaryMask = _mm_set1_epi32( int( 0xFF000000u ) );
+    const bool hasSecondary = ( ctx.secondaryOffset < ctx.dbpp );
+
+    for( size_t y = 0; y < ph; ++y )
+    {
+        const uint8_t* pIndex = palette.primaryIndex + y * 4;
+        const __m128i control = _mm_set_epi32( int( pIndex[3] * 0x04040404u + 0x03020100u ), int( pIndex[2] * 0x04040404u + 0x03020100u ),
+                                               int( pIndex[1] * 0x04040404u + 0x03020100u ), int( pIndex[0] * 0x04040404u + 0x03020100u ) );
+        __m128i row = _mm_shuffle_epi8( primary, control );
+
+        if ( hasSecondary )
+        {
+            // Zeroes all but the top byte of each pixel
+            const uint8_t* sIndex = palette.secondaryIndex + y * 4;
+            const __m128i scontrol = _mm_set_epi32( int( ( uint32_t( sIndex[3] ) << 24 ) | 0x808080u ), int( ( uint32_t( sIndex[2] ) << 24 ) | 0x808080u ),
+                                                    int( ( uint32_t( sIndex[1] ) << 24 ) | 0x808080u ), int( ( uint32_t( sIndex[0] ) << 24 ) | 0x808080u ) );
+            row = _mm_or_si128( _mm_andnot_si128( secondaryMask, row ), _mm_shuffle_epi8( secondary, scontrol ) );
+        }
+
+        _mm_storeu_si128( reinterpret_cast<__m128i*>( pDest + rowPitch * y ), row );
+    }
+}
+#endif
+
+static void _WriteBlock( _Out_ uint8_t* pDest, _In_ size_t rowPitch, _In_ size_t pw, _In_ size_t ph, _In_ const BCDecodeContext& ctx,
+                         _In_ const BCBlockPalette& palette )
+{
+    const size_t dbpp = ctx.dbpp;
+    const size_t secondaryOffset = ctx.secondaryOffset;
+
+    if ( dbpp == 4 )
+    {
+        const uint32_t secondaryMask = ( secondaryOffset < 4 ) ? 0xFF000000 : 0;
+        auto primary = reinterpret_cast<const uint32_t*>( palette.primary );
+        auto secondary = reinterpret_cast<const uint32_t*>( palette.secondary );
+        for( size_t y = 0; y < ph; ++y )
+        {
+            auto dptr = reinterpret_cast<uint32_t*>( pDest + rowPitch * y );
+            for( size_t x = 0; x < pw; ++x )
+            {
+                const size_t i = y * 4 + x;
+                uint32_t pixel = primary[ palette.primaryIndex[i] ];
+                if ( secondaryMask )
+                    pixel = ( pixel & ~secondaryMask ) | ( secondary[ palette.secondaryIndex[i] ] & secondaryMask );
+                dptr[x] = pixel;
+            }
+        }
+        return;
+    }
+
+    for( size_t y = 0; y < ph; ++y )
+    {
+        uint8_t* dptr = pDest + rowPitch * y;
+        for( size_t x = 0; x < pw; ++x, dptr += dbpp )
+        {
+            const size_t i = y * 4 + x;
+            memcpy( dptr, palette.primary + palette.primaryIndex[i] * dbpp, secondaryOffset );
+            if ( secondaryOffset < dbpp )
+                memcpy( dptr + secondaryOffset, palette.secondary + palette.secondaryIndex[i] * dbpp + secondaryOffset, dbpp - secondaryOffset );
+        }
+    }
+}
+
+//-------------------------------------------------------------------------------------
+static HRESULT _DecompressBCRows( _In_ const Image& cImage, _In_ const Image& result, _In_ const BCDecodeContext& ctx,
+                                  _In_ size_t blockRowStart, _In_ size_t blockRowEnd )
+{
+    const size_t sbpp = ctx.sbpp;
+    const size_t dbpp = ctx.dbpp;
     const size_t rowPitch = result.rowPitch;
-    for( size_t h=0; h < cImage.height; h += 4 )
+    const uint8_t *pSrc = cImage.pixels + cImage.rowPitch * blockRowStart;
+    uint8_t *pDest = result.pixels + rowPitch * 4 * blockRowStart;
+
+    BCBlockPalette palette;
+    memset( &palette, 0, sizeof(palette) );
+
+    XMVECTOR temp[16];
+    for( size_t h = blockRowStart * 4; h < blockRowEnd * 4 && h < cImage.height; h += 4 )
     {
         const uint8_t *sptr = pSrc;
         uint8_t* dptr = pDest;
@@ -447,30 +903,30 @@ static HRESULT _DecompressBC( _In_ const Image& cImage, _In_ const Image& result
         size_t w = 0;
         for( size_t count = 0; (count < cImage.rowPitch) && (w < cImage.width); count += sbpp, w += 4 )
         {
-            pfDecode( temp, sptr );
-            _ConvertScanline( temp, 16, format, cformat, 0 );
-
             size_t pw = std::min<size_t>( 4, cImage.width - w );
             assert( pw > 0 && ph > 0 );
 
-            if ( !_StoreScanline( dptr, rowPitch, format, &temp[0], pw ) )
-                return E_FAIL;
-
-            if ( ph > 1 )
+            if ( ctx.mode != BC_PALETTE_NONE )
             {
-                if ( !_StoreScanline( dptr + rowPitch, rowPitch, format, &temp[4], pw ) )
+                if ( !_DecodeBlockPalette( sptr, ctx, palette ) )
                     return E_FAIL;
 
-                if ( ph > 2 )
+#if defined(_M_IX86) || defined(_M_X64)
+                if ( ctx.useSSSE3 && pw == 4 && ctx.mode <= BC_PALETTE_BC3 )
+                    _WriteBlockSSSE3( dptr, rowPitch, ph, ctx, palette );
+                else
+#endif
+                    _WriteBlock( dptr, rowPitch, pw, ph, ctx, palette );
+            }
+            else
+            {
+                ctx.pfDecode( temp, sptr );
+                _ConvertScanline( temp, 16, ctx.format, ctx.cformat, 0 );
+
+                for( size_t y = 0; y < ph; ++y )
                 {
-                    if ( !_StoreScanline( dptr + rowPitch*2, rowPitch, format, &temp[8], pw ) )
+                    if ( !_StoreScanline( dptr + rowPitch * y, rowPitch, ctx.format, &temp[y * 4], pw ) )
                         return E_FAIL;
-
-                    if ( ph > 3 )
-                    {
-                        if ( !_StoreScanline( dptr + rowPitch*3, rowPitch, format, &temp[12], pw ) )
-                            return E_FAIL;
-                    }
                 }
             }
 
@@ -485,6 +941,20 @@ static HRESULT _DecompressBC( _In_ const Image& cImage, _In_ const Image& result
     return S_OK;
 }
 
+static HRESULT _DecompressBC( _In_ const Image& cImage, _In_ const Image& result )
+{
+    BCDecodeContext ctx;
+    HRESULT hr = _SetupDecompressBC( cImage, result, ctx );
+    if ( FAILED(hr) )
+        return hr;
+
+    // Block rows are independent, so bands of them are decompressed on their own threads
+    return _ProcessRowBands( ( cImage.height + 3 ) / 4, BC_DECOMPRESS_BAND_BLOCK_ROWS, [&]( size_t start, size_t end ) -> HRESULT
+    {
+        return _DecompressBCRows( cImage, result, ctx, start, end );
+    } );
+}
+
 
 //-------------------------------------------------------------------------------------
 bool _IsAlphaAllOpaqueBC( _In_ const Image& cImage )
@@ -605,14 +1075,14 @@ HRESULT Compress( const Image& srcImage, DXGI_FORMAT format, DWORD compress, flo
     if (compress & TEX_COMPRESS_PARALLEL)
     {
 #ifndef _OPENMP
-        return E_NOTIMPL;
+        hr = _CompressBC( srcImage, *img, _GetBCFlags( compress ), _GetSRGBFlags( compress ), alphaRef, true );
 #else
         hr = _CompressBC_Parallel( srcImage, *img, _GetBCFlags( compress ), _GetSRGBFlags( compress ), alphaRef );
 #endif // _OPENMP
     }
     else
     {
-        hr = _CompressBC( srcImage, *img, _GetBCFlags( compress ), _GetSRGBFlags( compress ), alphaRef );
+        hr = _CompressBC( srcImage, *img, _GetBCFlags( compress ), _GetSRGBFlags( compress ), alphaRef, false );
     }
 
     if ( FAILED(hr) )
@@ -671,22 +1141,19 @@ HRESULT Compress( const Image* srcImages, size_t nimages, const TexMetadata& met
         if ( (compress & TEX_COMPRESS_PARALLEL) )
         {
 #ifndef _OPENMP
-            return E_NOTIMPL;
+            hr = _CompressBC( src, dest[ index ], _GetBCFlags( compress ), _GetSRGBFlags( compress ), alphaRef, true );
 #else
-            if ( compress & TEX_COMPRESS_PARALLEL )
+            hr = _CompressBC_Parallel( src, dest[ index ], _GetBCFlags( compress ), _GetSRGBFlags( compress ), alphaRef );
+#endif // _OPENMP
+            if ( FAILED(hr) )
             {
-                hr = _CompressBC_Parallel( src, dest[ index ], _GetBCFlags( compress ), _GetSRGBFlags( compress ), alphaRef );
-                if ( FAILED(hr) )
-                {
-                    cImages.Release();
-                    return  hr;
-                }
+                cImages.Release();
+                return  hr;
             }
-#endif // _OPENMP
         }
         else
         {
-            hr = _CompressBC( src, dest[ index ], _GetBCFlags( compress ), _GetSRGBFlags( compress ), alphaRef );
+            hr = _CompressBC( src, dest[ index ], _GetBCFlags( compress ), _GetSRGBFlags( compress ), alphaRef, false );
             if ( FAILED(hr) )
             {
                 cImages.Release();
@@ -15,6 +15,10 @@
 
 #include "DirectXTexP.h"
 
+#if defined(_M_IX86) || defined(_M_X64)
+#include <intrin.h>
+#endif
+
 using namespace DirectX::PackedVector;
 using Microsoft::WRL::ComPtr;
 
@@ -4072,6 +4076,249 @@ bool _StoreScanlineDither( LPVOID pDestination, size_t size, DXGI_FORMAT format,
 #undef STORE_SCANLINE1
 
 
+//-------------------------------------------------------------------------------------
+// Direct format-pair conversions
+//-------------------------------------------------------------------------------------
+namespace
+{
+    // A band should have at least this many rows to be worth a thread
+    const size_t CONVERT_BAND_ROWS = 16;
+
+    enum DIRECT_CONVERT_KIND
+    {
+        DIRECT_CONVERT_BYTE4 = 0,       // 8:8:8:8 UNORM formats, per-channel table plus optional R/B swap
+        DIRECT_CONVERT_HALF_TO_FLOAT,   // 16-bit float channels to 32-bit float channels
+        DIRECT_CONVERT_FLOAT_TO_HALF,   // 32-bit float channels to 16-bit float channels
+    };
+
+    struct DirectConvertData
+    {
+        DXGI_FORMAT         inFormat;
+        DXGI_FORMAT         outFormat;
+        DIRECT_CONVERT_KIND kind;
+        size_t              channels;
+    };
+
+    // Format pairs converted row to row without going through XMVECTOR scanlines
+    const DirectConvertData g_DirectConvertTable[] =
+    {
+        { DXGI_FORMAT_R8G8B8A8_UNORM,       DXGI_FORMAT_R8G8B8A8_UNORM_SRGB,    DIRECT_CONVERT_BYTE4, 4 },
+        { DXGI_FORMAT_R8G8B8A8_UNORM,       DXGI_FORMAT_B8G8R8A8_UNORM,         DIRECT_CONVERT_BYTE4, 4 },
+        { DXGI_FORMAT_R8G8B8A8_UNORM,       DXGI_FORMAT_B8G8R8A8_UNORM_SRGB,    DIRECT_CONVERT_BYTE4, 4 },
+        { DXGI_FORMAT_R8G8B8A8_UNORM_SRGB,  DXGI_FORMAT_R8G8B8A8_UNORM,         DIRECT_CONVERT_BYTE4, 4 },
+        { DXGI_FORMAT_R8G8B8A8_UNORM_SRGB,  DXGI_FORMAT_B8G8R8A8_UNORM,         DIRECT_CONVERT_BYTE4, 4 },
+        { DXGI_FORMAT_R8G8B8A8_UNORM_SRGB,  DXGI_FORMAT_B8G8R8A8_UNORM_SRGB,    DIRECT_CONVERT_BYTE4, 4 },
+        { DXGI_FORMAT_B8G8R8A8_UNORM,       DXGI_FORMAT_R8G8B8A8_UNORM,         DIRECT_CONVERT_BYTE4, 4 },
+        { DXGI_FORMAT_B8G8R8A8_UNORM,       DXGI_FORMAT_R8G8B8A8_UNORM_SRGB,    DIRECT_CONVERT_BYTE4, 4 },
+        { DXGI_FORMAT_B8G8R8A8_UNORM,       DXGI_FORMAT_B8G8R8A8_UNORM_SRGB,    DIRECT_CONVERT_BYTE4, 4 },
+        { DXGI_FORMAT_B8G8R8A8_UNORM_SRGB,  DXGI_FORMAT_R8G8B8A8_UNORM,         DIRECT_CONVERT_BYTE4, 4 },
+        { DXGI_FORMAT_B8G8R8A8_UNORM_SRGB,  DXGI_FORMAT_R8G8B8A8_UNORM_SRGB,    DIRECT_CONVERT_BYTE4, 4 },
+        { DXGI_FORMAT_B8G8R8A8_UNORM_SRGB,  DXGI_FORMAT_B8G8R8A8_UNORM,         DIRECT_CONVERT_BYTE4, 4 },
+        { DXGI_FORMAT_R16_FLOAT,            DXGI_FORMAT_R32_FLOAT,              DIRECT_CONVERT_HALF_TO_FLOAT, 1 },
+        { DXGI_FORMAT_R16G16_FLOAT,         DXGI_FORMAT_R32G32_FLOAT,           DIRECT_CONVERT_HALF_TO_FLOAT, 2 },
+        { DXGI_FORMAT_R16G16B16A16_FLOAT,   DXGI_FORMAT_R32G32B32A32_FLOAT,     DIRECT_CONVERT_HALF_TO_FLOAT, 4 },
+        { DXGI_FORMAT_R32_FLOAT,            DXGI_FORMAT_R16_FLOAT,              DIRECT_CONVERT_FLOAT_TO_HALF, 1 },
+    };
+
+    struct DirectConversion
+    {
+        const DirectConvertData*    data;
+        bool                        swapRB;
+        bool                        identity;   // tables map every value to itself, rows are copied or swizzled
+        bool                        f16c;
+        uint8_t                     table[4][256];  // indexed by destination byte, then source value
+    };
+}
+
+static bool _HasF16C()
+{
+#if defined(_M_IX86) || defined(_M_X64)
+    int info[4];
+    __cpuid( info, 1 );
+    // F16C is VEX encoded, so it also needs AVX with the OS saving the YMM state (OSXSAVE)
+    const int required = (1 << 29) | (1 << 28) | (1 << 27);
+    if ( ( info[2] & required ) != required )
+        return false;
+    return ( _xgetbv( 0 ) & 0x6 ) == 0x6;
+#else
+    return false;
+#endif
+}
+
+static const DirectConvertData* _FindDirectConversion( _In_ DXGI_FORMAT inFormat, _In_ DXGI_FORMAT outFormat, _In_ DWORD filter )
+{
+    if ( filter & (TEX_FILTER_DITHER | TEX_FILTER_DITHER_DIFFUSION) )
+    {
+        // Dithered stores don't round the way the direct kernels do
+        return nullptr;
+    }
+
+    for( size_t index = 0; index < _countof(g_DirectConvertTable); ++index )
+    {
+        const DirectConvertData& data = g_DirectConvertTable[ index ];
+        if ( data.inFormat != inFormat || data.outFormat != outFormat )
+            continue;
+
+        if ( data.kind != DIRECT_CONVERT_BYTE4 )
+        {
+            // Float channels are copied as-is, a requested sRGB curve needs the scanline path
+            DWORD srgb = filter & TEX_FILTER_SRGB;
+            if ( srgb != 0 && srgb != TEX_FILTER_SRGB )
+                return nullptr;
+        }
+
+        return &data;
+    }
+
+    return nullptr;
+}
+
+static bool _SetupDirectConversion( _In_ const DirectConvertData* data, _In_ DWORD filter, _In_ float threshold, _Out_ DirectConversion& conv )
+{
+    assert( data );
+
+    static const bool s_hasF16C = _HasF16C();
+
+    conv.data = data;
+    conv.swapRB = false;
+    conv.identity = true;
+    conv.f16c = s_hasF16C;
+
+    if ( data->kind != DIRECT_CONVERT_BYTE4 )
+        return true;
+
+    const bool inBGR = ( data->inFormat == DXGI_FORMAT_B8G8R8A8_UNORM || data->inFormat == DXGI_FORMAT_B8G8R8A8_UNORM_SRGB );
+    const bool outBGR = ( data->outFormat == DXGI_FORMAT_B8G8R8A8_UNORM || data->outFormat == DXGI_FORMAT_B8G8R8A8_UNORM_SRGB );
+    conv.swapRB = ( inBGR != outBGR );
+
+    // Every channel is converted on its own, so running each 8-bit value through the scanline path
+    // once gives tables that produce exactly what that path would for any pixel
+    ScopedAlignedArrayXMVECTOR scanline( reinterpret_cast<XMVECTOR*>( _aligned_malloc( sizeof(XMVECTOR)*256, 16 ) ) );
+    if ( !scanline )
+        return false;
+
+    uint8_t source[ 256 * 4 ];
+    uint8_t dest[ 256 * 4 ];
+    for( size_t value = 0; value < 256; ++value )
+    {
+        memset( &source[ value * 4 ], static_cast<int>( value ), 4 );
+    }
+
+    if ( !_LoadScanline( scanline.get(), 256, source, sizeof(source), data->inFormat ) )
+        return false;
+
+    _ConvertScanline( scanline.get(), 256, data->outFormat, data->inFormat, filter );
+
+    if ( !_StoreScanline( dest, sizeof(dest), data->outFormat, scanline.get(), 256, threshold ) )
+        return false;
+
+    for( size_t value = 0; value < 256; ++value )
+    {
+        for( size_t c = 0; c < 4; ++c )
+        {
+            conv.table[c][value] = dest[ value * 4 + c ];
+            if ( conv.table[c][value] != value )
+                conv.identity = false;
+        }
+    }
+
+    return true;
+}
+
+static void _SwapRBRow( _Out_writes_(width) uint32_t* pDest, _In_reads_(width) const uint32_t* pSource, _In_ size_t width )
+{
+    size_t i = 0;
+
+#if defined(_M_IX86) || defined(_M_X64)
+    const __m128i maskGA = _mm_set1_epi32( 0xFF00FF00 );
+    const __m128i maskLow = _mm_set1_epi32( 0xFF );
+    for( ; i + 4 <= width; i += 4 )
+    {
+        __m128i v = _mm_loadu_si128( reinterpret_cast<const __m128i*>( pSource + i ) );
+        __m128i ga = _mm_and_si128( v, maskGA );
+        __m128i r = _mm_and_si128( _mm_srli_epi32( v, 16 ), maskLow );
+        __m128i b = _mm_slli_epi32( _mm_and_si128( v, maskLow ), 16 );
+        _mm_storeu_si128( reinterpret_cast<__m128i*>( pDest + i ), _mm_or_si128( ga, _mm_or_si128( r, b ) ) );
+    }
+#endif
+
+    for( ; i < width; ++i )
+    {
+        uint32_t t = pSource[i];
+        pDest[i] = ( t & 0xFF00FF00 ) | ( ( t >> 16 ) & 0xFF ) | ( ( t & 0xFF ) << 16 );
+    }
+}
+
+static void _HalfToFloatRow( _Out_writes_(count) float* pDest, _In_reads_(count) const HALF* pSource, _In_ size_t count, _In_ bool f16c )
+{
+    size_t i = 0;
+
+#if defined(_M_IX86) || defined(_M_X64)
+    if ( f16c )
+    {
+        for( ; i + 4 <= count; i += 4 )
+        {
+            __m128i h = _mm_loadl_epi64( reinterpret_cast<const __m128i*>( pSource + i ) );
+            _mm_storeu_ps( pDest + i, _mm_cvtph_ps( h ) );
+        }
+    }
+#else
+    UNREFERENCED_PARAMETER(f16c);
+#endif
+
+    for( ; i < count; ++i )
+    {
+        pDest[i] = XMConvertHalfToFloat( pSource[i] );
+    }
+}
+
+static void _ConvertRowDirect( _Out_ uint8_t* pDest, _In_ const uint8_t* pSource, _In_ size_t width, _In_ const DirectConversion& conv )
+{
+    switch( conv.data->kind )
+    {
+    case DIRECT_CONVERT_BYTE4:
+        if ( conv.identity )
+        {
+            if ( conv.swapRB )
+                _SwapRBRow( reinterpret_cast<uint32_t*>( pDest ), reinterpret_cast<const uint32_t*>( pSource ), width );
+            else
+                memcpy( pDest, pSource, width * 4 );
+        }
+        else
+        {
+            const size_t r = conv.swapRB ? 2 : 0;
+            const size_t b = conv.swapRB ? 0 : 2;
+            for( size_t i = 0; i < width; ++i, pDest += 4, pSource += 4 )
+            {
+                pDest[0] = conv.table[0][ pSource[r] ];
+                pDest[1] = conv.table[1][ pSource[1] ];
+                pDest[2] = conv.table[2][ pSource[b] ];
+                pDest[3] = conv.table[3][ pSource[3] ];
+            }
+        }
+        break;
+
+    case DIRECT_CONVERT_HALF_TO_FLOAT:
+        _HalfToFloatRow( reinterpret_cast<float*>( pDest ), reinterpret_cast<const HALF*>( pSource ), width * conv.data->channels, conv.f16c );
+        break;
+
+    case DIRECT_CONVERT_FLOAT_TO_HALF:
+        {
+            // Same clamp as _StoreScanline
+            HALF* dPtr = reinterpret_cast<HALF*>( pDest );
+            const float* sPtr = reinterpret_cast<const float*>( pSource );
+            const size_t count = width * conv.data->channels;
+            for( size_t i = 0; i < count; ++i )
+            {
+                float v = std::max<float>( std::min<float>( sPtr[i], 65504.f ), -65504.f );
+                dPtr[i] = XMConvertFloatToHalf( v );
+            }
+        }
+        break;
+    }
+}
+
+
 //-------------------------------------------------------------------------------------
 // Selection logic for using WIC vs. our own routines
 //-------------------------------------------------------------------------------------
@@ -4099,6 +4346,12 @@ static inline bool _UseWICConversion( _In_ DWORD filter, _In_ DXGI_FORMAT sforma
         return true;
     }
 
+    if ( _FindDirectConversion( sformat, tformat, filter ) )
+    {
+        // Direct format-pair conversions are faster than going through WIC
+        return false;
+    }
+
     if ( filter & TEX_FILTER_SEPARATE_ALPHA )
     {
         // Alpha is not premultiplied, so use non-WIC code paths
@@ -4233,6 +4486,73 @@ static HRESULT _ConvertUsingWIC( _In_ const Image& srcImage, _In_ const WICPixel
 }
 
 
+//-------------------------------------------------------------------------------------
+// Convert a band of rows of the source image (not using WIC)
+//-------------------------------------------------------------------------------------
+static HRESULT _ConvertRows( _In_ const Image& srcImage, _In_ DWORD filter, _In_ const Image& destImage, _In_ float threshold, _In_ size_t z,
+                             _In_opt_ const DirectConversion* pDirect, _In_ size_t startRow, _In_ size_t endRow )
+{
+    const uint8_t *pSrc = srcImage.pixels + startRow * srcImage.rowPitch;
+    uint8_t *pDest = destImage.pixels + startRow * destImage.rowPitch;
+
+    size_t width = srcImage.width;
+
+    if ( pDirect )
+    {
+        for( size_t h = startRow; h < endRow; ++h )
+        {
+            _ConvertRowDirect( pDest, pSrc, width, *pDirect );
+
+            pSrc += srcImage.rowPitch;
+            pDest += destImage.rowPitch;
+        }
+
+        return S_OK;
+    }
+
+    ScopedAlignedArrayXMVECTOR scanline( reinterpret_cast<XMVECTOR*>( _aligned_malloc( (sizeof(XMVECTOR)*width), 16 ) ) );
+    if ( !scanline )
+        return E_OUTOFMEMORY;
+
+    if ( filter & TEX_FILTER_DITHER )
+    {
+        // Ordered dithering
+        for( size_t h = startRow; h < endRow; ++h )
+        {
+            if ( !_LoadScanline( scanline.get(), width, pSrc, srcImage.rowPitch, srcImage.format ) )
+                return E_FAIL;
+
+            _ConvertScanline( scanline.get(), width, destImage.format, srcImage.format, filter );
+
+            if ( !_StoreScanlineDither( pDest, destImage.rowPitch, destImage.format, scanline.get(), width, threshold, h, z, nullptr ) )
+                return E_FAIL;
+
+            pSrc += srcImage.rowPitch;
+            pDest += destImage.rowPitch;
+        }
+    }
+    else
+    {
+        // No dithering
+        for( size_t h = startRow; h < endRow; ++h )
+        {
+            if ( !_LoadScanline( scanline.get(), width, pSrc, srcImage.rowPitch, srcImage.format ) )
+                return E_FAIL;
+
+            _ConvertScanline( scanline.get(), width, destImage.format, srcImage.format, filter );
+
+            if ( !_StoreScanline( pDest, destImage.rowPitch, destImage.format, scanline.get(), width, threshold ) )
+                return E_FAIL;
+
+            pSrc += srcImage.rowPitch;
+            pDest += destImage.rowPitch;
+        }
+    }
+
+    return S_OK;
+}
+
+
 //-------------------------------------------------------------------------------------
 // Convert the source image (not using WIC)
 //-------------------------------------------------------------------------------------
@@ -4250,7 +4570,7 @@ static HRESULT _Convert( _In_ const Image& srcImage, _In_ DWORD filter, _In_ con
 
     if ( filter & TEX_FILTER_DITHER_DIFFUSION )
     {
-        // Error diffusion dithering (aka Floyd-Steinberg dithering)
+        // Error diffusion dithering (aka Floyd-Steinberg dithering), errors carry from row to row so this stays on one thread
         ScopedAlignedArrayXMVECTOR scanline( reinterpret_cast<XMVECTOR*>( _aligned_malloc( (sizeof(XMVECTOR)*(width*2 + 2)), 16 ) ) );
         if ( !scanline )
             return E_OUTOFMEMORY;
@@ -4271,50 +4591,27 @@ static HRESULT _Convert( _In_ const Image& srcImage, _In_ DWORD filter, _In_ con
             pSrc += srcImage.rowPitch;
             pDest += destImage.rowPitch;
         }
-    }
-    else
-    {
-        ScopedAlignedArrayXMVECTOR scanline( reinterpret_cast<XMVECTOR*>( _aligned_malloc( (sizeof(XMVECTOR)*width), 16 ) ) );
-        if ( !scanline )
-            return E_OUTOFMEMORY;
-
-        if ( filter & TEX_FILTER_DITHER )
-        {
-            // Ordered dithering
-            for( size_t h = 0; h < srcImage.height; ++h )
-            {
-                if ( !_LoadScanline( scanline.get(), width, pSrc, srcImage.rowPitch, srcImage.format ) )
-                    return E_FAIL;
-
-                _ConvertScanline( scanline.get(), width, destImage.format, srcImage.format, filter );
-
-                if ( !_StoreScanlineDither( pDest, destImage.rowPitch, destImage.format, scanline.get(), width, threshold, h, z, nullptr ) )
-                    return E_FAIL;
-
-                pSrc += srcImage.rowPitch;
-                pDest += destImage.rowPitch;
-            }
-        }
-        else
-        {
-            // No dithering
-            for( size_t h = 0; h < srcImage.height; ++h )
-            {
-                if ( !_LoadScanline( scanline.get(), width, pSrc, srcImage.rowPitch, srcImage.format ) )
-                    return E_FAIL;
 
-                _ConvertScanline( scanline.get(), width, destImage.format, srcImage.format, filter );
-
-                if ( !_StoreScanline( pDest, destImage.rowPitch, destImage.format, scanline.get(), width, threshold ) )
-                    return E_FAIL;
+        return S_OK;
+    }
 
-                pSrc += srcImage.rowPitch;
-                pDest += destImage.rowPitch;
-            }
-        }
+    DirectConversion direct;
+    const DirectConversion* pDirect = nullptr;
+    const DirectConvertData* directData = _FindDirectConversion( srcImage.format, destImage.format, filter );
+    if ( directData )
+    {
+        if ( !_SetupDirectConversion( directData, filter, threshold, direct ) )
+            return E_FAIL;
+        pDirect = &direct;
     }
 
-    return S_OK;
+    if ( !( filter & TEX_FILTER_PARALLEL ) )
+        return _ConvertRows( srcImage, filter, destImage, threshold, z, pDirect, 0, srcImage.height );
+
+    return _ProcessRowBands( srcImage.height, CONVERT_BAND_ROWS, [&]( size_t start, size_t end ) -> HRESULT
+    {
+        return _ConvertRows( srcImage, filter, destImage, threshold, z, pDirect, start, end );
+    } );
 }
 
 
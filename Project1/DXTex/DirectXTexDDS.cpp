@@ -1462,6 +1462,57 @@ HRESULT LoadFromDDSMemory( LPCVOID pSource, size_t size, DWORD flags, TexMetadat
 }
 
 
+//-------------------------------------------------------------------------------------
+// Describe the images of a DDS file in memory without copying them
+//-------------------------------------------------------------------------------------
+_Use_decl_annotations_
+HRESULT GetImagesFromDDSMemory( LPCVOID pSource, size_t size, DWORD flags, TexMetadata& metadata, Image* images, size_t& nImages )
+{
+    if ( !pSource || size == 0 )
+        return E_INVALIDARG;
+
+    DWORD convFlags = 0;
+    HRESULT hr = _DecodeDDSHeader( pSource, size, flags, metadata, convFlags );
+    if ( FAILED(hr) )
+        return hr;
+
+    // Only data that is stored exactly as it would be loaded can be referenced in place
+    if ( convFlags & ~(CONV_FLAGS_DX10 | CONV_FLAGS_PMALPHA) )
+        return HRESULT_FROM_WIN32( ERROR_NOT_SUPPORTED );
+
+    size_t offset = sizeof(uint32_t) + sizeof(DDS_HEADER);
+    if ( convFlags & CONV_FLAGS_DX10 )
+        offset += sizeof(DDS_HEADER_DXT10);
+
+    if ( size < offset )
+        return E_FAIL;
+
+    DWORD cpFlags = (flags & DDS_FLAGS_LEGACY_DWORD) ? CP_FLAGS_LEGACY_DWORD : CP_FLAGS_NONE;
+
+    size_t pixelSize, nimages;
+    _DetermineImageArray( metadata, cpFlags, nimages, pixelSize );
+    if ( !nimages || pixelSize > (size - offset) )
+        return E_FAIL;
+
+    if ( !images )
+    {
+        nImages = nimages;
+        return S_OK;
+    }
+
+    if ( nImages < nimages )
+        return E_INVALIDARG;
+
+    nImages = nimages;
+
+    auto pPixels = const_cast<uint8_t*>( reinterpret_cast<const uint8_t*>(pSource) + offset );
+    if ( !_SetupImageArray( pPixels, size - offset, metadata, cpFlags, images, nimages ) )
+        return E_FAIL;
+
+    return S_OK;
+}
+
+
 //-------------------------------------------------------------------------------------
 // Load a DDS file from disk
 //-------------------------------------------------------------------------------------
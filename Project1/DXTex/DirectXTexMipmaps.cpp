@@ -629,8 +629,18 @@ static HRESULT _Setup2DMips( _In_reads_(nimages) const Image* baseImages, _In_ s
     return S_OK;
 }
 
-//--- 2D Point Filter ---
-static HRESULT _Generate2DMipsPointFilter( _In_ size_t levels, _In_ const ScratchImage& mipChain, _In_ size_t item )
+//--- 2D mips using the resize filters ---
+// Point, linear, cubic and triangle mips resize each level from the one above it, so they share the
+// separable (and with TEX_FILTER_PARALLEL, multithreaded) resize code
+extern HRESULT _ResizePointFilter( _In_ const Image& srcImage, _In_ DWORD filter, _In_ const Image& destImage );
+extern HRESULT _ResizeLinearFilter( _In_ const Image& srcImage, _In_ DWORD filter, _In_ const Image& destImage );
+extern HRESULT _ResizeCubicFilter( _In_ const Image& srcImage, _In_ DWORD filter, _In_ const Image& destImage );
+extern HRESULT _ResizeTriangleFilter( _In_ const Image& srcImage, _In_ DWORD filter, _In_ const Image& destImage );
+
+typedef HRESULT (*ResizeLevelFunc)( const Image&, DWORD, const Image& );
+
+static HRESULT _Generate2DMipsUsingResize( _In_ size_t levels, _In_ DWORD filter, _In_ const ScratchImage& mipChain, _In_ size_t item,
+                                           _In_ ResizeLevelFunc resizeLevel )
 {
     if ( !mipChain.GetImages() )
         return E_INVALIDARG;
@@ -639,288 +649,113 @@ static HRESULT _Generate2DMipsPointFilter( _In_ size_t levels, _In_ const Scratc
 
     assert( levels > 1 );
 
-    size_t width = mipChain.GetMetadata().width;
-    size_t height = mipChain.GetMetadata().height;
-
-    // Allocate temporary space (2 scanlines)
-    ScopedAlignedArrayXMVECTOR scanline( reinterpret_cast<XMVECTOR*>( _aligned_malloc( (sizeof(XMVECTOR)*width*2), 16 ) ) );
-    if ( !scanline )
-        return E_OUTOFMEMORY;
-
-    XMVECTOR* target = scanline.get();
-
-    XMVECTOR* row = target + width;
-
     // Resize base image to each target mip level
     for( size_t level=1; level < levels; ++level )
     {
-#ifdef _DEBUG
-        memset( row, 0xCD, sizeof(XMVECTOR)*width );
-#endif
-
-        // 2D point filter
         const Image* src = mipChain.GetImage( level-1, item, 0 );
         const Image* dest = mipChain.GetImage( level, item, 0 );
 
         if ( !src || !dest )
             return E_POINTER;
 
-        const uint8_t* pSrc = src->pixels;
-        uint8_t* pDest = dest->pixels;
-
-        size_t rowPitch = src->rowPitch;
-
-        size_t nwidth = (width > 1) ? (width >> 1) : 1;
-        size_t nheight = (height > 1) ? (height >> 1) : 1;
-
-        size_t xinc = ( width << 16 ) / nwidth;
-        size_t yinc = ( height << 16 ) / nheight;
-
-        size_t lasty = size_t(-1);
-
-        size_t sy = 0;
-        for( size_t y = 0; y < nheight; ++y )
-        {
-            if ( (lasty ^ sy) >> 16 )
-            {
-                if ( !_LoadScanline( row, width, pSrc + ( rowPitch * (sy >> 16) ), rowPitch, src->format ) )
-                    return E_FAIL;
-                lasty = sy;
-            }
-
-            size_t sx = 0;
-            for( size_t x = 0; x < nwidth; ++x )
-            {
-                target[ x ] = row[ sx >> 16 ];
-                sx += xinc;
-            }
-
-            if ( !_StoreScanline( pDest, dest->rowPitch, dest->format, target, nwidth ) )
-                return E_FAIL;
-            pDest += dest->rowPitch;
-
-            sy += yinc;
-        }
-
-        if ( height > 1 )
-            height >>= 1;
-
-        if ( width > 1 )
-            width >>= 1;
+        HRESULT hr = resizeLevel( *src, filter, *dest );
+        if ( FAILED(hr) )
+            return hr;
     }
 
     return S_OK;
 }
 
 
-//--- 2D Box Filter ---
-static HRESULT _Generate2DMipsBoxFilter( _In_ size_t levels, _In_ DWORD filter, _In_ const ScratchImage& mipChain, _In_ size_t item )
+//--- 2D Point Filter ---
+static HRESULT _Generate2DMipsPointFilter( _In_ size_t levels, _In_ DWORD filter, _In_ const ScratchImage& mipChain, _In_ size_t item )
 {
-    if ( !mipChain.GetImages() )
-        return E_INVALIDARG;
+    return _Generate2DMipsUsingResize( levels, filter, mipChain, item, _ResizePointFilter );
+}
 
-    // This assumes that the base image is already placed into the mipChain at the top level... (see _Setup2DMips)
 
-    assert( levels > 1 );
+//--- 2D Box Filter ---
+namespace
+{
+    // Level 1 rows one thread cascades down the chain with TEX_FILTER_PARALLEL, must be 1 << MIP_CASCADE_TILE_SHIFT
+    const size_t MIP_CASCADE_TILE_SHIFT = 5;
+    const size_t MIP_CASCADE_TILE_ROWS = size_t(1) << MIP_CASCADE_TILE_SHIFT;
+}
 
-    size_t width = mipChain.GetMetadata().width;
-    size_t height = mipChain.GetMetadata().height;
+// Averages row y of a level from the two rows above it, then keeps going down the chain while the rows
+// it just wrote (still in cache) complete a row of the next level
+static HRESULT _Generate2DMipsBoxRow( _In_ size_t level, _In_ size_t y, _In_ size_t lastLevel, _In_ DWORD filter,
+                                      _In_ const ScratchImage& mipChain, _In_ size_t item, _Inout_ XMVECTOR* scanline )
+{
+    const Image* src = mipChain.GetImage( level-1, item, 0 );
+    const Image* dest = mipChain.GetImage( level, item, 0 );
 
-    if ( !ispow2(width) || !ispow2(height) )
-        return E_FAIL;
+    if ( !src || !dest )
+        return E_POINTER;
 
-    // Allocate temporary space (3 scanlines)
-    ScopedAlignedArrayXMVECTOR scanline( reinterpret_cast<XMVECTOR*>( _aligned_malloc( (sizeof(XMVECTOR)*width*3), 16 ) ) );
-    if ( !scanline )
-        return E_OUTOFMEMORY;
+    size_t width = src->width;
+    size_t height = src->height;
 
-    XMVECTOR* target = scanline.get();
+    XMVECTOR* target = scanline;
 
     XMVECTOR* urow0 = target + width;
-    XMVECTOR* urow1 = target + width*2;
-
-    const XMVECTOR* urow2 = urow0 + 1;
-    const XMVECTOR* urow3 = urow1 + 1;
-
-    // Resize base image to each target mip level
-    for( size_t level=1; level < levels; ++level )
-    {
-        if ( height <= 1 )
-        {
-            urow1 = urow0;
-        }
-
-        if ( width <= 1 )
-        {
-            urow2 = urow0;
-            urow3 = urow1;
-        }
+    XMVECTOR* urow1 = ( height > 1 ) ? urow0 + width : urow0;
 
-        // 2D box filter
-        const Image* src = mipChain.GetImage( level-1, item, 0 );
-        const Image* dest = mipChain.GetImage( level, item, 0 );
+    const XMVECTOR* urow2 = ( width > 1 ) ? urow0 + 1 : urow0;
+    const XMVECTOR* urow3 = ( width > 1 ) ? urow1 + 1 : urow1;
 
-        if ( !src || !dest )
-            return E_POINTER;
-
-        const uint8_t* pSrc = src->pixels;
-        uint8_t* pDest = dest->pixels;
-
-        size_t rowPitch = src->rowPitch;
-
-        size_t nwidth = (width > 1) ? (width >> 1) : 1;
-        size_t nheight = (height > 1) ? (height >> 1) : 1;
+    size_t rowPitch = src->rowPitch;
 
-        for( size_t y = 0; y < nheight; ++y )
-        {
-            if ( !_LoadScanlineLinear( urow0, width, pSrc, rowPitch, src->format, filter ) )
-                return E_FAIL;
-            pSrc += rowPitch;
+    const uint8_t* pSrc = src->pixels + ( rowPitch * ( ( height > 1 ) ? ( y << 1 ) : y ) );
 
-            if ( urow0 != urow1 )
-            {
-                if ( !_LoadScanlineLinear( urow1, width, pSrc, rowPitch, src->format, filter ) )
-                    return E_FAIL;
-                pSrc += rowPitch;
-            }
+    if ( !_LoadScanlineLinear( urow0, width, pSrc, rowPitch, src->format, filter ) )
+        return E_FAIL;
 
-            for( size_t x = 0; x < nwidth; ++x )
-            {
-                size_t x2 = x << 1;
+    if ( urow0 != urow1 )
+    {
+        if ( !_LoadScanlineLinear( urow1, width, pSrc + rowPitch, rowPitch, src->format, filter ) )
+            return E_FAIL;
+    }
 
-                AVERAGE4( target[ x ], urow0[ x2 ], urow1[ x2 ], urow2[ x2 ], urow3[ x2 ] );
-            }
+    for( size_t x = 0; x < dest->width; ++x )
+    {
+        size_t x2 = x << 1;
 
-            if ( !_StoreScanlineLinear( pDest, dest->rowPitch, dest->format, target, nwidth, filter ) )
-                return E_FAIL;
-            pDest += dest->rowPitch;
-        }
+        AVERAGE4( target[ x ], urow0[ x2 ], urow1[ x2 ], urow2[ x2 ], urow3[ x2 ] );
+    }
 
-        if ( height > 1 )
-            height >>= 1;
+    if ( !_StoreScanlineLinear( dest->pixels + ( dest->rowPitch * y ), dest->rowPitch, dest->format, target, dest->width, filter ) )
+        return E_FAIL;
 
-        if ( width > 1 )
-            width >>= 1;
-    }
+    if ( ( level + 1 < lastLevel ) && ( ( dest->height <= 1 ) || ( y & 1 ) ) )
+        return _Generate2DMipsBoxRow( level + 1, y >> 1, lastLevel, filter, mipChain, item, scanline );
 
     return S_OK;
 }
 
-
-//--- 2D Linear Filter ---
-static HRESULT _Generate2DMipsLinearFilter( _In_ size_t levels, _In_ DWORD filter, _In_ const ScratchImage& mipChain, _In_ size_t item )
+static HRESULT _Generate2DMipsBoxRows( _In_ size_t level, _In_ size_t startRow, _In_ size_t endRow, _In_ size_t lastLevel, _In_ DWORD filter,
+                                       _In_ const ScratchImage& mipChain, _In_ size_t item )
 {
-    if ( !mipChain.GetImages() )
-        return E_INVALIDARG;
-
-    // This assumes that the base image is already placed into the mipChain at the top level... (see _Setup2DMips)
-
-    assert( levels > 1 );
-
-    size_t width = mipChain.GetMetadata().width;
-    size_t height = mipChain.GetMetadata().height;
-
-    // Allocate temporary space (3 scanlines, plus X and Y filters)
-    ScopedAlignedArrayXMVECTOR scanline( reinterpret_cast<XMVECTOR*>( _aligned_malloc( (sizeof(XMVECTOR)*width*3), 16 ) ) );
+    // Allocate temporary space (3 scanlines), shared by every level the rows cascade through
+    ScopedAlignedArrayXMVECTOR scanline( reinterpret_cast<XMVECTOR*>( _aligned_malloc( (sizeof(XMVECTOR)*mipChain.GetMetadata().width*3), 16 ) ) );
     if ( !scanline )
         return E_OUTOFMEMORY;
 
-    std::unique_ptr<LinearFilter[]> lf( new (std::nothrow) LinearFilter[ width+height ] );
-    if ( !lf )
-        return E_OUTOFMEMORY;
-
-    LinearFilter* lfX = lf.get();
-    LinearFilter* lfY = lf.get() + width;
- 
-    XMVECTOR* target = scanline.get();
-
-    XMVECTOR* row0 = target + width;
-    XMVECTOR* row1 = target + width*2;
-
-    // Resize base image to each target mip level
-    for( size_t level=1; level < levels; ++level )
-    {
-        // 2D linear filter
-        const Image* src = mipChain.GetImage( level-1, item, 0 );
-        const Image* dest = mipChain.GetImage( level, item, 0 );
-
-        if ( !src || !dest )
-            return E_POINTER;
-
-        const uint8_t* pSrc = src->pixels;
-        uint8_t* pDest = dest->pixels;
-
-        size_t rowPitch = src->rowPitch;
-
-        size_t nwidth = (width > 1) ? (width >> 1) : 1;
-        _CreateLinearFilter( width, nwidth, (filter & TEX_FILTER_WRAP_U) != 0, lfX );
-
-        size_t nheight = (height > 1) ? (height >> 1) : 1;
-        _CreateLinearFilter( height, nheight, (filter & TEX_FILTER_WRAP_V) != 0, lfY );
-
 #ifdef _DEBUG
-        memset( row0, 0xCD, sizeof(XMVECTOR)*width );
-        memset( row1, 0xDD, sizeof(XMVECTOR)*width );
+    memset( scanline.get(), 0xCD, sizeof(XMVECTOR)*mipChain.GetMetadata().width*3 );
 #endif
 
-        size_t u0 = size_t(-1);
-        size_t u1 = size_t(-1);
-
-        for( size_t y = 0; y < nheight; ++y )
-        {
-            auto& toY = lfY[ y ];
-
-            if ( toY.u0 != u0 )
-            {
-                if ( toY.u0 != u1 )
-                {
-                    u0 = toY.u0;
-
-                    if ( !_LoadScanlineLinear( row0, width, pSrc + (rowPitch * u0), rowPitch, src->format, filter ) )
-                        return E_FAIL;
-                }
-                else
-                {
-                    u0 = u1;
-                    u1 = size_t(-1);
-
-                    std::swap( row0, row1 );
-                }
-            }
-
-            if ( toY.u1 != u1 )
-            {
-                u1 = toY.u1;
-
-                if ( !_LoadScanlineLinear( row1, width, pSrc + (rowPitch * u1), rowPitch, src->format, filter ) )
-                    return E_FAIL;
-            }
-
-            for( size_t x = 0; x < nwidth; ++x )
-            {
-                auto& toX = lfX[ x ];
-
-                BILINEAR_INTERPOLATE( target[x], toX, toY, row0, row1 );
-            }
-
-            if ( !_StoreScanlineLinear( pDest, dest->rowPitch, dest->format, target, nwidth, filter ) )
-                return E_FAIL;
-            pDest += dest->rowPitch;
-        }
-
-        if ( height > 1 )
-            height >>= 1;
-
-        if ( width > 1 )
-            width >>= 1;
+    for( size_t y = startRow; y < endRow; ++y )
+    {
+        HRESULT hr = _Generate2DMipsBoxRow( level, y, lastLevel, filter, mipChain, item, scanline.get() );
+        if ( FAILED(hr) )
+            return hr;
     }
 
     return S_OK;
 }
 
-
-//--- 2D Cubic Filter ---
-static HRESULT _Generate2DMipsCubicFilter( _In_ size_t levels, _In_ DWORD filter, _In_ const ScratchImage& mipChain, _In_ size_t item )
+static HRESULT _Generate2DMipsBoxFilter( _In_ size_t levels, _In_ DWORD filter, _In_ const ScratchImage& mipChain, _In_ size_t item )
 {
     if ( !mipChain.GetImages() )
         return E_INVALIDARG;
@@ -932,386 +767,59 @@ static HRESULT _Generate2DMipsCubicFilter( _In_ size_t levels, _In_ DWORD filter
     size_t width = mipChain.GetMetadata().width;
     size_t height = mipChain.GetMetadata().height;
 
-    // Allocate temporary space (5 scanlines, plus X and Y filters)
-    ScopedAlignedArrayXMVECTOR scanline( reinterpret_cast<XMVECTOR*>( _aligned_malloc( (sizeof(XMVECTOR)*width*5), 16 ) ) );
-    if ( !scanline )
-        return E_OUTOFMEMORY;
+    if ( !ispow2(width) || !ispow2(height) )
+        return E_FAIL;
 
-    std::unique_ptr<CubicFilter[]> cf( new (std::nothrow) CubicFilter[ width+height ] );
-    if ( !cf )
-        return E_OUTOFMEMORY;
+    size_t height1 = (height > 1) ? (height >> 1) : 1;
 
-    CubicFilter* cfX = cf.get();
-    CubicFilter* cfY = cf.get() + width;
- 
-    XMVECTOR* target = scanline.get();
+    if ( !( filter & TEX_FILTER_PARALLEL ) || ( height1 < MIP_CASCADE_TILE_ROWS*2 ) )
+    {
+        // Every level 1 row cascades all the way down the chain
+        return _Generate2DMipsBoxRows( 1, 0, height1, levels, filter, mipChain, item );
+    }
 
-    XMVECTOR* row0 = target + width;
-    XMVECTOR* row1 = target + width*2;
-    XMVECTOR* row2 = target + width*3;
-    XMVECTOR* row3 = target + width*4;
+    // Tiles of level 1 rows cascade independently as long as each level still has whole rows in the tile,
+    // the few small levels after that are generated serially
+    size_t lastTileLevel = std::min<size_t>( levels, MIP_CASCADE_TILE_SHIFT + 2 );
 
-    // Resize base image to each target mip level
-    for( size_t level=1; level < levels; ++level )
+    HRESULT hr = _ProcessRowBands( height1 >> MIP_CASCADE_TILE_SHIFT, 1, [&]( size_t startTile, size_t endTile ) -> HRESULT
     {
-        // 2D cubic filter
-        const Image* src = mipChain.GetImage( level-1, item, 0 );
-        const Image* dest = mipChain.GetImage( level, item, 0 );
+        return _Generate2DMipsBoxRows( 1, startTile << MIP_CASCADE_TILE_SHIFT, endTile << MIP_CASCADE_TILE_SHIFT, lastTileLevel, filter, mipChain, item );
+    } );
+    if ( FAILED(hr) )
+        return hr;
 
-        if (  !src || !dest )
+    if ( lastTileLevel < levels )
+    {
+        const Image* dest = mipChain.GetImage( lastTileLevel, item, 0 );
+        if ( !dest )
             return E_POINTER;
 
-        const uint8_t* pSrc = src->pixels;
-        uint8_t* pDest = dest->pixels;
-
-        size_t rowPitch = src->rowPitch;
-
-        size_t nwidth = (width > 1) ? (width >> 1) : 1;
-        _CreateCubicFilter( width, nwidth, (filter & TEX_FILTER_WRAP_U) != 0, (filter & TEX_FILTER_MIRROR_U) != 0, cfX );
-
-        size_t nheight = (height > 1) ? (height >> 1) : 1;
-        _CreateCubicFilter( height, nheight, (filter & TEX_FILTER_WRAP_V) != 0, (filter & TEX_FILTER_MIRROR_V) != 0, cfY );
-
-#ifdef _DEBUG
-        memset( row0, 0xCD, sizeof(XMVECTOR)*width );
-        memset( row1, 0xDD, sizeof(XMVECTOR)*width );
-        memset( row2, 0xED, sizeof(XMVECTOR)*width );
-        memset( row3, 0xFD, sizeof(XMVECTOR)*width );
-#endif
-
-        size_t u0 = size_t(-1);
-        size_t u1 = size_t(-1);
-        size_t u2 = size_t(-1);
-        size_t u3 = size_t(-1);
-
-        for( size_t y = 0; y < nheight; ++y )
-        {
-            auto& toY = cfY[ y ];
-
-            // Scanline 1
-            if ( toY.u0 != u0 )
-            {
-                if ( toY.u0 != u1 && toY.u0 != u2 && toY.u0 != u3 )
-                {
-                    u0 = toY.u0;
-
-                    if ( !_LoadScanlineLinear( row0, width, pSrc + (rowPitch * u0), rowPitch, src->format, filter ) )
-                        return E_FAIL;
-                }
-                else if ( toY.u0 == u1 )
-                {
-                    u0 = u1;
-                    u1 = size_t(-1);
-
-                    std::swap( row0, row1 );
-                }
-                else if ( toY.u0 == u2 )
-                {
-                    u0 = u2;
-                    u2 = size_t(-1);
-
-                    std::swap( row0, row2 );
-                }
-                else if ( toY.u0 == u3 )
-                {
-                    u0 = u3;
-                    u3 = size_t(-1);
-
-                    std::swap( row0, row3 );
-                }
-            }
-
-            // Scanline 2
-            if ( toY.u1 != u1 )
-            {
-                if ( toY.u1 != u2 && toY.u1 != u3 )
-                {
-                    u1 = toY.u1;
-
-                    if ( !_LoadScanlineLinear( row1, width, pSrc + (rowPitch * u1), rowPitch, src->format, filter ) )
-                        return E_FAIL;
-                }
-                else if ( toY.u1 == u2 )
-                {
-                    u1 = u2;
-                    u2 = size_t(-1);
-
-                    std::swap( row1, row2 );
-                }
-                else if ( toY.u1 == u3 )
-                {
-                    u1 = u3;
-                    u3 = size_t(-1);
-
-                    std::swap( row1, row3 );
-                }
-            }
-
-            // Scanline 3
-            if ( toY.u2 != u2 )
-            {
-                if ( toY.u2 != u3 )
-                {
-                    u2 = toY.u2;
-
-                    if ( !_LoadScanlineLinear( row2, width, pSrc + (rowPitch * u2), rowPitch, src->format, filter ) )
-                        return E_FAIL;
-                }
-                else
-                {
-                    u2 = u3;
-                    u3 = size_t(-1);
-
-                    std::swap( row2, row3 );
-                }
-            }
-
-            // Scanline 4
-            if ( toY.u3 != u3 )
-            {
-                u3 = toY.u3;
-
-                if ( !_LoadScanlineLinear( row3, width, pSrc + (rowPitch * u3), rowPitch, src->format, filter ) )
-                    return E_FAIL;
-            }
-
-            for( size_t x = 0; x < nwidth; ++x )
-            {
-                auto& toX = cfX[ x ];
+        hr = _Generate2DMipsBoxRows( lastTileLevel, 0, dest->height, levels, filter, mipChain, item );
+    }
 
-                XMVECTOR C0, C1, C2, C3;
+    return hr;
+}
 
-                CUBIC_INTERPOLATE( C0, toX.x, row0[ toX.u0 ], row0[ toX.u1 ], row0[ toX.u2 ], row0[ toX.u3 ] );
-                CUBIC_INTERPOLATE( C1, toX.x, row1[ toX.u0 ], row1[ toX.u1 ], row1[ toX.u2 ], row1[ toX.u3 ] );
-                CUBIC_INTERPOLATE( C2, toX.x, row2[ toX.u0 ], row2[ toX.u1 ], row2[ toX.u2 ], row2[ toX.u3 ] );
-                CUBIC_INTERPOLATE( C3, toX.x, row3[ toX.u0 ], row3[ toX.u1 ], row3[ toX.u2 ], row3[ toX.u3 ] );
 
-                CUBIC_INTERPOLATE( target[x], toY.x, C0, C1, C2, C3 );
-            }
-
-            if ( !_StoreScanlineLinear( pDest, dest->rowPitch, dest->format, target, nwidth, filter ) )
-                return E_FAIL;
-            pDest += dest->rowPitch;
-        }
-
-        if ( height > 1 )
-            height >>= 1;
+//--- 2D Linear Filter ---
+static HRESULT _Generate2DMipsLinearFilter( _In_ size_t levels, _In_ DWORD filter, _In_ const ScratchImage& mipChain, _In_ size_t item )
+{
+    return _Generate2DMipsUsingResize( levels, filter, mipChain, item, _ResizeLinearFilter );
+}
 
-        if ( width > 1 )
-            width >>= 1;
-    }
 
-    return S_OK;
+//--- 2D Cubic Filter ---
+static HRESULT _Generate2DMipsCubicFilter( _In_ size_t levels, _In_ DWORD filter, _In_ const ScratchImage& mipChain, _In_ size_t item )
+{
+    return _Generate2DMipsUsingResize( levels, filter, mipChain, item, _ResizeCubicFilter );
 }
 
 
 //--- 2D Triangle Filter ---
 static HRESULT _Generate2DMipsTriangleFilter( _In_ size_t levels, _In_ DWORD filter, _In_ const ScratchImage& mipChain, _In_ size_t item )
 {
-    if ( !mipChain.GetImages() )
-        return E_INVALIDARG;
-
-    using namespace TriangleFilter;
-
-    // This assumes that the base image is already placed into the mipChain at the top level... (see _Setup2DMips)
-
-    assert( levels > 1 );
-
-    size_t width = mipChain.GetMetadata().width;
-    size_t height = mipChain.GetMetadata().height;
-
-    // Allocate initial temporary space (1 scanline, accumulation rows, plus X and Y filters)
-    ScopedAlignedArrayXMVECTOR scanline( reinterpret_cast<XMVECTOR*>( _aligned_malloc( sizeof(XMVECTOR) * width, 16 ) ) );
-    if ( !scanline )
-        return E_OUTOFMEMORY;
-
-    std::unique_ptr<TriangleRow[]> rowActive( new (std::nothrow) TriangleRow[ height ] );
-    if ( !rowActive )
-        return E_OUTOFMEMORY;
-
-    TriangleRow * rowFree = nullptr;
-
-    std::unique_ptr<Filter> tfX, tfY;
-
-    XMVECTOR* row = scanline.get();
-
-    // Resize base image to each target mip level
-    for( size_t level=1; level < levels; ++level )
-    {
-        // 2D triangle filter
-        const Image* src = mipChain.GetImage( level-1, item, 0 );
-        const Image* dest = mipChain.GetImage( level, item, 0 );
-
-        if ( !src || !dest )
-            return E_POINTER;
-
-        const uint8_t* pSrc = src->pixels;
-        size_t rowPitch = src->rowPitch;
-        const uint8_t* pEndSrc = pSrc + rowPitch * height;
-
-        uint8_t* pDest = dest->pixels;
-
-        size_t nwidth = (width > 1) ? (width >> 1) : 1;
-        HRESULT hr = _Create( width, nwidth, (filter & TEX_FILTER_WRAP_U) != 0, tfX );
-        if ( FAILED(hr) )
-            return hr;
-        
-        size_t nheight = (height > 1) ? (height >> 1) : 1;
-        hr = _Create( height, nheight, (filter & TEX_FILTER_WRAP_V) != 0, tfY );
-        if ( FAILED(hr) )
-            return hr;
-
-#ifdef _DEBUG
-        memset( row, 0xCD, sizeof(XMVECTOR)*width );
-#endif
-
-        auto xFromEnd = reinterpret_cast<const FilterFrom*>( reinterpret_cast<const uint8_t*>( tfX.get() ) + tfX->sizeInBytes );
-        auto yFromEnd = reinterpret_cast<const FilterFrom*>( reinterpret_cast<const uint8_t*>( tfY.get() ) + tfY->sizeInBytes );
-
-        // Count times rows get written (and clear out any leftover accumulation rows from last miplevel)
-        for( FilterFrom* yFrom = tfY->from; yFrom < yFromEnd; )
-        {
-            for ( size_t j = 0; j < yFrom->count; ++j )
-            {
-                size_t v = yFrom->to[ j ].u;
-                assert( v < nheight );
-                TriangleRow* rowAcc = &rowActive[ v ];
-
-                ++rowAcc->remaining;
-
-                if ( rowAcc->scanline )
-                {
-                    memset( rowAcc->scanline.get(), 0, sizeof(XMVECTOR) * nwidth );
-                }
-            }
-
-            yFrom = reinterpret_cast<FilterFrom*>( reinterpret_cast<uint8_t*>( yFrom ) + yFrom->sizeInBytes );
-        }
-
-        // Filter image
-        for( FilterFrom* yFrom = tfY->from; yFrom < yFromEnd; )
-        {
-            // Create accumulation rows as needed
-            for ( size_t j = 0; j < yFrom->count; ++j )
-            {
-                size_t v = yFrom->to[ j ].u;
-                assert( v < nheight );
-                TriangleRow* rowAcc = &rowActive[ v ];
-
-                if ( !rowAcc->scanline )
-                {
-                    if ( rowFree )
-                    {
-                        // Steal and reuse scanline from 'free row' list
-                        // (it will always be at least as wide as nwidth due to loop decending order)
-                        assert( rowFree->scanline != 0 );
-                        rowAcc->scanline.reset( rowFree->scanline.release() );
-                        rowFree = rowFree->next;
-                    }
-                    else
-                    {
-                        rowAcc->scanline.reset( reinterpret_cast<XMVECTOR*>( _aligned_malloc( sizeof(XMVECTOR) * nwidth, 16 ) ) );
-                        if ( !rowAcc->scanline )
-                            return E_OUTOFMEMORY;
-                    }
-
-                    memset( rowAcc->scanline.get(), 0, sizeof(XMVECTOR) * nwidth );
-                }
-            }
-
-            // Load source scanline
-            if ( (pSrc + rowPitch) > pEndSrc )
-                return E_FAIL;
-
-            if ( !_LoadScanlineLinear( row, width, pSrc, rowPitch, src->format, filter ) )
-                return E_FAIL;
-
-            pSrc += rowPitch;
-
-            // Process row
-            size_t x = 0;
-            for( FilterFrom* xFrom = tfX->from; xFrom < xFromEnd; ++x )
-            {
-                for ( size_t j = 0; j < yFrom->count; ++j )
-                {
-                    size_t v = yFrom->to[ j ].u;
-                    assert( v < nheight );
-                    float yweight = yFrom->to[ j ].weight;
-
-                    XMVECTOR* accPtr = rowActive[ v ].scanline.get();
-                    if ( !accPtr )
-                        return E_POINTER;
-
-                    for ( size_t k = 0; k < xFrom->count; ++k )
-                    {
-                        size_t u = xFrom->to[ k ].u;
-                        assert( u < nwidth );
-
-                        XMVECTOR weight = XMVectorReplicate( yweight * xFrom->to[ k ].weight );
-
-                        assert( x < width );
-                        accPtr[ u ] = XMVectorMultiplyAdd( row[ x ], weight, accPtr[ u ] );
-                    }
-                }
-
-                xFrom = reinterpret_cast<FilterFrom*>( reinterpret_cast<uint8_t*>( xFrom ) + xFrom->sizeInBytes );
-            }
-
-            // Write completed accumulation rows
-            for ( size_t j = 0; j < yFrom->count; ++j )
-            {
-                size_t v = yFrom->to[ j ].u;
-                assert( v < nheight );
-                TriangleRow* rowAcc = &rowActive[ v ];
-
-                assert( rowAcc->remaining > 0 );
-                --rowAcc->remaining;
-
-                if ( !rowAcc->remaining )
-                {
-                    XMVECTOR* pAccSrc = rowAcc->scanline.get();
-                    if ( !pAccSrc )
-                        return E_POINTER;
-
-                    switch( dest->format )
-                    {
-                    case DXGI_FORMAT_R10G10B10A2_UNORM:
-                    case DXGI_FORMAT_R10G10B10A2_UINT:
-                        {
-                            // Need to slightly bias results for floating-point error accumulation which can
-                            // be visible with harshly quantized values
-                            static const XMVECTORF32 Bias = { 0.f, 0.f, 0.f, 0.1f };
-                       
-                            XMVECTOR* ptr = pAccSrc;
-                            for( size_t i=0; i < dest->width; ++i, ++ptr )
-                            {
-                                *ptr = XMVectorAdd( *ptr, Bias );
-                            }
-                        }
-                        break;
-                    }
-
-                    // This performs any required clamping
-                    if ( !_StoreScanlineLinear( pDest + (dest->rowPitch * v), dest->rowPitch, dest->format, pAccSrc, dest->width, filter ) )
-                        return E_FAIL;
-
-                    // Put row on freelist to reuse it's allocated scanline
-                    rowAcc->next = rowFree;
-                    rowFree = rowAcc;
-                }
-            }
-
-            yFrom = reinterpret_cast<FilterFrom*>( reinterpret_cast<uint8_t*>( yFrom ) + yFrom->sizeInBytes );
-        }
-
-        if ( height > 1 )
-            height >>= 1;
-
-        if ( width > 1 )
-            width >>= 1;
-    }
-
-    return S_OK;
+    return _Generate2DMipsUsingResize( levels, filter, mipChain, item, _ResizeTriangleFilter );
 }
 
 
@@ -2634,7 +2142,7 @@ HRESULT GenerateMipMaps( const Image& baseImage, DWORD filter, size_t levels, Sc
                 if ( FAILED(hr) )
                     return hr;
 
-                hr = _Generate2DMipsPointFilter( levels, mipChain, 0 );
+                hr = _Generate2DMipsPointFilter( levels, filter, mipChain, 0 );
                 if ( FAILED(hr) )
                     mipChain.Release();
                 return hr;
@@ -2827,7 +2335,7 @@ HRESULT GenerateMipMaps( const Image* srcImages, size_t nimages, const TexMetada
 
                 for( size_t item = 0; item < metadata.arraySize; ++item )
                 {
-                    hr = _Generate2DMipsPointFilter( levels, mipChain, item );
+                    hr = _Generate2DMipsPointFilter( levels, filter, mipChain, item );
                     if ( FAILED(hr) )
                         mipChain.Release();
                 }
@@ -40,6 +40,7 @@
 #include <memory>
 
 #include <vector>
+#include <thread>
 
 #include <stdlib.h>
 #include <search.h>
@@ -222,6 +223,61 @@ namespace DirectX
     void __cdecl _ConvertScanline( _Inout_updates_all_(count) XMVECTOR* pBuffer, _In_ size_t count,
                                    _In_ DXGI_FORMAT outFormat, _In_ DXGI_FORMAT inFormat, _In_ DWORD flags );
 
+    //---------------------------------------------------------------------------------
+    // Threading helpers
+
+    // Splits an image's rows (or block rows) into bands and processes each band on its own thread,
+    // bands that didn't get a thread run on the calling one
+    template<typename ProcessRows>
+    HRESULT _ProcessRowBands( _In_ size_t rows, _In_ size_t minBandRows, _In_ ProcessRows processRows )
+    {
+        size_t bandCount = std::min<size_t>( std::thread::hardware_concurrency(), rows / minBandRows );
+        if ( bandCount <= 1 )
+            return processRows( 0, rows );
+
+        std::vector<HRESULT> results( bandCount, S_OK );
+        std::vector<std::thread> threads;
+        threads.reserve( bandCount - 1 );
+
+        size_t band = 1;
+        try
+        {
+            for( ; band < bandCount; ++band )
+            {
+                const size_t start = rows * band / bandCount;
+                const size_t end = rows * ( band + 1 ) / bandCount;
+                HRESULT* pResult = &results[band];
+                threads.emplace_back( [&processRows, pResult, start, end]()
+                {
+                    *pResult = processRows( start, end );
+                } );
+            }
+        }
+        catch( ... )
+        {
+            // Out of threads, the remaining bands run below
+        }
+
+        results[0] = processRows( 0, rows / bandCount );
+        for( size_t remaining = band; remaining < bandCount; ++remaining )
+        {
+            results[remaining] = processRows( rows * remaining / bandCount, rows * ( remaining + 1 ) / bandCount );
+        }
+
+        for( auto& thread : threads )
+        {
+            thread.join();
+        }
+
+        for( auto bandResult : results )
+        {
+            if ( FAILED(bandResult) )
+                return bandResult;
+        }
+
+        return S_OK;
+    }
+
     //---------------------------------------------------------------------------------
     // DDS helper functions
     HRESULT __cdecl _EncodeDDSHeader( _In_ const TexMetadata& metadata, DWORD flags,
@@ -238,12 +238,27 @@ static bool _UseWICFiltering( _In_ DXGI_FORMAT format, _In_ DWORD filter )
 // Resize custom filters
 //-------------------------------------------------------------------------------------
 
-//--- Point Filter ---
-static HRESULT _ResizePointFilter( _In_ const Image& srcImage, _In_ const Image& destImage )
+namespace
 {
-    assert( srcImage.pixels && destImage.pixels );
-    assert( srcImage.format == destImage.format );
+    // A band should have at least this many destination rows to be worth a thread
+    const size_t RESIZE_BAND_ROWS = 16;
+}
+
+// Destination rows are independent of each other for every custom filter, so TEX_FILTER_PARALLEL
+// splits them into bands that each keep their own scanlines
+template<typename ProcessRows>
+static HRESULT _ProcessResizeRows( _In_ DWORD filter, _In_ size_t rows, _In_ ProcessRows processRows )
+{
+    if ( !( filter & TEX_FILTER_PARALLEL ) )
+        return processRows( 0, rows );
 
+    return _ProcessRowBands( rows, RESIZE_BAND_ROWS, processRows );
+}
+
+
+//--- Point Filter ---
+static HRESULT _ResizePointRows( _In_ const Image& srcImage, _In_ const Image& destImage, _In_ size_t startRow, _In_ size_t endRow )
+{
     // Allocate temporary space (2 scanlines)
     ScopedAlignedArrayXMVECTOR scanline( reinterpret_cast<XMVECTOR*>( _aligned_malloc(
                                          ( sizeof(XMVECTOR) * (srcImage.width + destImage.width ) ), 16 ) ) );
@@ -259,7 +274,7 @@ static HRESULT _ResizePointFilter( _In_ const Image& srcImage, _In_ const Image&
 #endif
 
     const uint8_t* pSrc = srcImage.pixels;
-    uint8_t* pDest = destImage.pixels;
+    uint8_t* pDest = destImage.pixels + ( destImage.rowPitch * startRow );
 
     size_t rowPitch = srcImage.rowPitch;
 
@@ -268,8 +283,8 @@ static HRESULT _ResizePointFilter( _In_ const Image& srcImage, _In_ const Image&
 
     size_t lasty = size_t(-1);
 
-    size_t sy = 0;
-    for( size_t y = 0; y < destImage.height; ++y )
+    size_t sy = yinc * startRow;
+    for( size_t y = startRow; y < endRow; ++y )
     {
         if ( (lasty ^ sy) >> 16 )
         {
@@ -295,16 +310,21 @@ static HRESULT _ResizePointFilter( _In_ const Image& srcImage, _In_ const Image&
     return S_OK;
 }
 
-
-//--- Box Filter ---
-static HRESULT _ResizeBoxFilter( _In_ const Image& srcImage, _In_ DWORD filter, _In_ const Image& destImage )
+HRESULT _ResizePointFilter( _In_ const Image& srcImage, _In_ DWORD filter, _In_ const Image& destImage )
 {
     assert( srcImage.pixels && destImage.pixels );
     assert( srcImage.format == destImage.format );
 
-    if ( ( (destImage.width << 1) != srcImage.width ) || ( (destImage.height << 1) != srcImage.height ) )
-        return E_FAIL;
+    return _ProcessResizeRows( filter, destImage.height, [&]( size_t start, size_t end ) -> HRESULT
+    {
+        return _ResizePointRows( srcImage, destImage, start, end );
+    } );
+}
 
+
+//--- Box Filter ---
+static HRESULT _ResizeBoxRows( _In_ const Image& srcImage, _In_ DWORD filter, _In_ const Image& destImage, _In_ size_t startRow, _In_ size_t endRow )
+{
     // Allocate temporary space (3 scanlines)
     ScopedAlignedArrayXMVECTOR scanline( reinterpret_cast<XMVECTOR*>( _aligned_malloc(
                                          ( sizeof(XMVECTOR) * ( srcImage.width*2 + destImage.width ) ), 16 ) ) );
@@ -324,12 +344,12 @@ static HRESULT _ResizeBoxFilter( _In_ const Image& srcImage, _In_ DWORD filter,
     const XMVECTOR* urow2 = urow0 + 1;
     const XMVECTOR* urow3 = urow1 + 1;
 
-    const uint8_t* pSrc = srcImage.pixels;
-    uint8_t* pDest = destImage.pixels;
-
     size_t rowPitch = srcImage.rowPitch;
 
-    for( size_t y = 0; y < destImage.height; ++y )
+    const uint8_t* pSrc = srcImage.pixels + ( rowPitch * startRow * 2 );
+    uint8_t* pDest = destImage.pixels + ( destImage.rowPitch * startRow );
+
+    for( size_t y = startRow; y < endRow; ++y )
     {
         if ( !_LoadScanlineLinear( urow0, srcImage.width, pSrc, rowPitch, srcImage.format, filter ) )
             return E_FAIL;
@@ -357,48 +377,68 @@ static HRESULT _ResizeBoxFilter( _In_ const Image& srcImage, _In_ DWORD filter,
     return S_OK;
 }
 
-
-//--- Linear Filter ---
-static HRESULT _ResizeLinearFilter( _In_ const Image& srcImage, _In_ DWORD filter, _In_ const Image& destImage )
+static HRESULT _ResizeBoxFilter( _In_ const Image& srcImage, _In_ DWORD filter, _In_ const Image& destImage )
 {
     assert( srcImage.pixels && destImage.pixels );
     assert( srcImage.format == destImage.format );
 
-    // Allocate temporary space (3 scanlines, plus X and Y filters)
-    ScopedAlignedArrayXMVECTOR scanline( reinterpret_cast<XMVECTOR*>( _aligned_malloc(
-                                         ( sizeof(XMVECTOR) * ( srcImage.width*2 + destImage.width ) ), 16 ) ) );
-    if ( !scanline )
-        return E_OUTOFMEMORY;
+    if ( ( (destImage.width << 1) != srcImage.width ) || ( (destImage.height << 1) != srcImage.height ) )
+        return E_FAIL;
 
-    std::unique_ptr<LinearFilter[]> lf( new (std::nothrow) LinearFilter[ destImage.width + destImage.height ] );
-    if ( !lf )
-        return E_OUTOFMEMORY;
+    return _ProcessResizeRows( filter, destImage.height, [&]( size_t start, size_t end ) -> HRESULT
+    {
+        return _ResizeBoxRows( srcImage, filter, destImage, start, end );
+    } );
+}
 
-    LinearFilter* lfX = lf.get();
-    LinearFilter* lfY = lf.get() + destImage.width;
 
-    _CreateLinearFilter( srcImage.width, destImage.width, (filter & TEX_FILTER_WRAP_U) != 0, lfX );
-    _CreateLinearFilter( srcImage.height, destImage.height, (filter & TEX_FILTER_WRAP_V) != 0, lfY );
+//--- Linear Filter ---
+// The filter is separable, so each source row is filtered horizontally once when it is loaded
+// and destination rows only blend two of those filtered rows
+static bool _LoadLinearRow( _Out_writes_(destWidth) XMVECTOR* pFiltered, _Out_writes_(srcImage.width) XMVECTOR* row,
+                            _In_ const Image& srcImage, _In_ DWORD filter, _In_ size_t u,
+                            _In_reads_(destWidth) const LinearFilter* lfX, _In_ size_t destWidth )
+{
+    if ( !_LoadScanlineLinear( row, srcImage.width, srcImage.pixels + (srcImage.rowPitch * u), srcImage.rowPitch, srcImage.format, filter ) )
+        return false;
+
+    for( size_t x = 0; x < destWidth; ++x )
+    {
+        auto& toX = lfX[ x ];
+
+        pFiltered[ x ] = row[ toX.u0 ] * toX.weight0 + row[ toX.u1 ] * toX.weight1;
+    }
+
+    return true;
+}
+
+static HRESULT _ResizeLinearRows( _In_ const Image& srcImage, _In_ DWORD filter, _In_ const Image& destImage,
+                                  _In_reads_(destImage.width) const LinearFilter* lfX, _In_reads_(destImage.height) const LinearFilter* lfY,
+                                  _In_ size_t startRow, _In_ size_t endRow )
+{
+    // Allocate temporary space (1 source scanline, 2 filtered rows, plus the target)
+    ScopedAlignedArrayXMVECTOR scanline( reinterpret_cast<XMVECTOR*>( _aligned_malloc(
+                                         ( sizeof(XMVECTOR) * ( srcImage.width + destImage.width*3 ) ), 16 ) ) );
+    if ( !scanline )
+        return E_OUTOFMEMORY;
 
     XMVECTOR* target = scanline.get();
 
     XMVECTOR* row0 = target + destImage.width;
-    XMVECTOR* row1 = row0 + srcImage.width;
+    XMVECTOR* row1 = row0 + destImage.width;
+    XMVECTOR* row = row1 + destImage.width;
 
 #ifdef _DEBUG
-    memset( row0, 0xCD, sizeof(XMVECTOR)*srcImage.width );
-    memset( row1, 0xDD, sizeof(XMVECTOR)*srcImage.width );
+    memset( row0, 0xCD, sizeof(XMVECTOR)*destImage.width );
+    memset( row1, 0xDD, sizeof(XMVECTOR)*destImage.width );
 #endif
 
-    const uint8_t* pSrc = srcImage.pixels;
-    uint8_t* pDest = destImage.pixels;
-
-    size_t rowPitch = srcImage.rowPitch;
+    uint8_t* pDest = destImage.pixels + ( destImage.rowPitch * startRow );
 
     size_t u0 = size_t(-1);
     size_t u1 = size_t(-1);
 
-    for( size_t y = 0; y < destImage.height; ++y )
+    for( size_t y = startRow; y < endRow; ++y )
     {
         auto& toY = lfY[ y ];
 
@@ -408,7 +448,7 @@ static HRESULT _ResizeLinearFilter( _In_ const Image& srcImage, _In_ DWORD filte
             {
                 u0 = toY.u0;
 
-                if ( !_LoadScanlineLinear( row0, srcImage.width, pSrc + (rowPitch * u0), rowPitch, srcImage.format, filter ) )
+                if ( !_LoadLinearRow( row0, row, srcImage, filter, u0, lfX, destImage.width ) )
                     return E_FAIL;
             }
             else
@@ -424,15 +464,13 @@ static HRESULT _ResizeLinearFilter( _In_ const Image& srcImage, _In_ DWORD filte
         {
             u1 = toY.u1;
 
-            if ( !_LoadScanlineLinear( row1, srcImage.width, pSrc + (rowPitch * u1), rowPitch, srcImage.format, filter ) )
+            if ( !_LoadLinearRow( row1, row, srcImage, filter, u1, lfX, destImage.width ) )
                 return E_FAIL;
         }
 
         for( size_t x = 0; x < destImage.width; ++x )
         {
-            auto& toX = lfX[ x ];
-
-            BILINEAR_INTERPOLATE( target[x], toX, toY, row0, row1 );
+            target[x] = ( toY.weight0 * row0[x] ) + ( toY.weight1 * row1[x] );
         }
 
         if ( !_StoreScanlineLinear( pDest, destImage.rowPitch, destImage.format, target, destImage.width, filter ) )
@@ -443,54 +481,81 @@ static HRESULT _ResizeLinearFilter( _In_ const Image& srcImage, _In_ DWORD filte
     return S_OK;
 }
 
-
-//--- Cubic Filter ---
-static HRESULT _ResizeCubicFilter( _In_ const Image& srcImage, _In_ DWORD filter, _In_ const Image& destImage )
+HRESULT _ResizeLinearFilter( _In_ const Image& srcImage, _In_ DWORD filter, _In_ const Image& destImage )
 {
     assert( srcImage.pixels && destImage.pixels );
     assert( srcImage.format == destImage.format );
 
-    // Allocate temporary space (5 scanlines, plus X and Y filters)
-    ScopedAlignedArrayXMVECTOR scanline( reinterpret_cast<XMVECTOR*>( _aligned_malloc(
-                                         ( sizeof(XMVECTOR) * ( srcImage.width*4 + destImage.width ) ), 16 ) ) );
-    if ( !scanline )
+    // X and Y filters are built once and shared by all bands
+    std::unique_ptr<LinearFilter[]> lf( new (std::nothrow) LinearFilter[ destImage.width + destImage.height ] );
+    if ( !lf )
         return E_OUTOFMEMORY;
 
-    std::unique_ptr<CubicFilter[]> cf( new (std::nothrow) CubicFilter[ destImage.width + destImage.height ] );
-    if ( !cf )
-        return E_OUTOFMEMORY;
+    LinearFilter* lfX = lf.get();
+    LinearFilter* lfY = lf.get() + destImage.width;
 
-    CubicFilter* cfX = cf.get();
-    CubicFilter* cfY = cf.get() + destImage.width;
+    _CreateLinearFilter( srcImage.width, destImage.width, (filter & TEX_FILTER_WRAP_U) != 0, lfX );
+    _CreateLinearFilter( srcImage.height, destImage.height, (filter & TEX_FILTER_WRAP_V) != 0, lfY );
 
-    _CreateCubicFilter( srcImage.width, destImage.width, (filter & TEX_FILTER_WRAP_U) != 0, (filter & TEX_FILTER_MIRROR_U) != 0, cfX );
-    _CreateCubicFilter( srcImage.height, destImage.height, (filter & TEX_FILTER_WRAP_V) != 0, (filter & TEX_FILTER_MIRROR_V) != 0, cfY );
+    return _ProcessResizeRows( filter, destImage.height, [&]( size_t start, size_t end ) -> HRESULT
+    {
+        return _ResizeLinearRows( srcImage, filter, destImage, lfX, lfY, start, end );
+    } );
+}
+
+
+//--- Cubic Filter ---
+// Separable like the linear filter, each source row is filtered horizontally once when it is loaded
+static bool _LoadCubicRow( _Out_writes_(destWidth) XMVECTOR* pFiltered, _Out_writes_(srcImage.width) XMVECTOR* row,
+                           _In_ const Image& srcImage, _In_ DWORD filter, _In_ size_t u,
+                           _In_reads_(destWidth) const CubicFilter* cfX, _In_ size_t destWidth )
+{
+    if ( !_LoadScanlineLinear( row, srcImage.width, srcImage.pixels + (srcImage.rowPitch * u), srcImage.rowPitch, srcImage.format, filter ) )
+        return false;
+
+    for( size_t x = 0; x < destWidth; ++x )
+    {
+        auto& toX = cfX[ x ];
+
+        CUBIC_INTERPOLATE( pFiltered[ x ], toX.x, row[ toX.u0 ], row[ toX.u1 ], row[ toX.u2 ], row[ toX.u3 ] );
+    }
+
+    return true;
+}
+
+static HRESULT _ResizeCubicRows( _In_ const Image& srcImage, _In_ DWORD filter, _In_ const Image& destImage,
+                                 _In_reads_(destImage.width) const CubicFilter* cfX, _In_reads_(destImage.height) const CubicFilter* cfY,
+                                 _In_ size_t startRow, _In_ size_t endRow )
+{
+    // Allocate temporary space (1 source scanline, 4 filtered rows, plus the target)
+    ScopedAlignedArrayXMVECTOR scanline( reinterpret_cast<XMVECTOR*>( _aligned_malloc(
+                                         ( sizeof(XMVECTOR) * ( srcImage.width + destImage.width*5 ) ), 16 ) ) );
+    if ( !scanline )
+        return E_OUTOFMEMORY;
 
     XMVECTOR* target = scanline.get();
 
     XMVECTOR* row0 = target + destImage.width;
-    XMVECTOR* row1 = row0 + srcImage.width;
-    XMVECTOR* row2 = row0 + srcImage.width*2;
-    XMVECTOR* row3 = row0 + srcImage.width*3;
+    XMVECTOR* row1 = row0 + destImage.width;
+    XMVECTOR* row2 = row0 + destImage.width*2;
+    XMVECTOR* row3 = row0 + destImage.width*3;
+    XMVECTOR* row = row0 + destImage.width*4;
 
 #ifdef _DEBUG
-    memset( row0, 0xCD, sizeof(XMVECTOR)*srcImage.width );
-    memset( row1, 0xDD, sizeof(XMVECTOR)*srcImage.width );
-    memset( row2, 0xED, sizeof(XMVECTOR)*srcImage.width );
-    memset( row3, 0xFD, sizeof(XMVECTOR)*srcImage.width );
+    memset( row0, 0xCD, sizeof(XMVECTOR)*destImage.width );
+    memset( row1, 0xDD, sizeof(XMVECTOR)*destImage.width );
+    memset( row2, 0xED, sizeof(XMVECTOR)*destImage.width );
+    memset( row3, 0xFD, sizeof(XMVECTOR)*destImage.width );
 #endif
 
-    const uint8_t* pSrc = srcImage.pixels;
-    uint8_t* pDest = destImage.pixels;
-
-    size_t rowPitch = srcImage.rowPitch;
+    uint8_t* pDest = destImage.pixels + ( destImage.rowPitch * startRow );
 
     size_t u0 = size_t(-1);
     size_t u1 = size_t(-1);
     size_t u2 = size_t(-1);
     size_t u3 = size_t(-1);
 
-    for( size_t y = 0; y < destImage.height; ++y )
+    for( size_t y = startRow; y < endRow; ++y )
     {
         auto& toY = cfY[ y ];
 
@@ -501,7 +566,7 @@ static HRESULT _ResizeCubicFilter( _In_ const Image& srcImage, _In_ DWORD filter
             {
                 u0 = toY.u0;
 
-                if ( !_LoadScanlineLinear( row0, srcImage.width, pSrc + (rowPitch * u0), rowPitch, srcImage.format, filter ) )
+                if ( !_LoadCubicRow( row0, row, srcImage, filter, u0, cfX, destImage.width ) )
                     return E_FAIL;
             }
             else if ( toY.u0 == u1 )
@@ -534,7 +599,7 @@ static HRESULT _ResizeCubicFilter( _In_ const Image& srcImage, _In_ DWORD filter
             {
                 u1 = toY.u1;
 
-                if ( !_LoadScanlineLinear( row1, srcImage.width, pSrc + (rowPitch * u1), rowPitch, srcImage.format, filter ) )
+                if ( !_LoadCubicRow( row1, row, srcImage, filter, u1, cfX, destImage.width ) )
                     return E_FAIL;
             }
             else if ( toY.u1 == u2 )
@@ -560,7 +625,7 @@ static HRESULT _ResizeCubicFilter( _In_ const Image& srcImage, _In_ DWORD filter
             {
                 u2 = toY.u2;
 
-                if ( !_LoadScanlineLinear( row2, srcImage.width, pSrc + (rowPitch * u2), rowPitch, srcImage.format, filter ) )
+                if ( !_LoadCubicRow( row2, row, srcImage, filter, u2, cfX, destImage.width ) )
                     return E_FAIL;
             }
             else
@@ -577,22 +642,13 @@ static HRESULT _ResizeCubicFilter( _In_ const Image& srcImage, _In_ DWORD filter
         {
             u3 = toY.u3;
 
-            if ( !_LoadScanlineLinear( row3, srcImage.width, pSrc + (rowPitch * u3), rowPitch, srcImage.format, filter ) )
+            if ( !_LoadCubicRow( row3, row, srcImage, filter, u3, cfX, destImage.width ) )
                 return E_FAIL;
         }
 
         for( size_t x = 0; x < destImage.width; ++x )
         {
-            auto& toX = cfX[ x ];
-
-            XMVECTOR C0, C1, C2, C3;
-
-            CUBIC_INTERPOLATE( C0, toX.x, row0[ toX.u0 ], row0[ toX.u1 ], row0[ toX.u2 ], row0[ toX.u3 ] );
-            CUBIC_INTERPOLATE( C1, toX.x, row1[ toX.u0 ], row1[ toX.u1 ], row1[ toX.u2 ], row1[ toX.u3 ] );
-            CUBIC_INTERPOLATE( C2, toX.x, row2[ toX.u0 ], row2[ toX.u1 ], row2[ toX.u2 ], row2[ toX.u3 ] );
-            CUBIC_INTERPOLATE( C3, toX.x, row3[ toX.u0 ], row3[ toX.u1 ], row3[ toX.u2 ], row3[ toX.u3 ] );
-
-            CUBIC_INTERPOLATE( target[x], toY.x, C0, C1, C2, C3 );
+            CUBIC_INTERPOLATE( target[x], toY.x, row0[ x ], row1[ x ], row2[ x ], row3[ x ] );
         }
 
         if ( !_StoreScanlineLinear( pDest, destImage.rowPitch, destImage.format, target, destImage.width, filter ) )
@@ -603,56 +659,70 @@ static HRESULT _ResizeCubicFilter( _In_ const Image& srcImage, _In_ DWORD filter
     return S_OK;
 }
 
-
-//--- Triangle Filter ---
-static HRESULT _ResizeTriangleFilter( _In_ const Image& srcImage, _In_ DWORD filter, _In_ const Image& destImage )
+HRESULT _ResizeCubicFilter( _In_ const Image& srcImage, _In_ DWORD filter, _In_ const Image& destImage )
 {
     assert( srcImage.pixels && destImage.pixels );
     assert( srcImage.format == destImage.format );
 
+    // X and Y filters are built once and shared by all bands
+    std::unique_ptr<CubicFilter[]> cf( new (std::nothrow) CubicFilter[ destImage.width + destImage.height ] );
+    if ( !cf )
+        return E_OUTOFMEMORY;
+
+    CubicFilter* cfX = cf.get();
+    CubicFilter* cfY = cf.get() + destImage.width;
+
+    _CreateCubicFilter( srcImage.width, destImage.width, (filter & TEX_FILTER_WRAP_U) != 0, (filter & TEX_FILTER_MIRROR_U) != 0, cfX );
+    _CreateCubicFilter( srcImage.height, destImage.height, (filter & TEX_FILTER_WRAP_V) != 0, (filter & TEX_FILTER_MIRROR_V) != 0, cfY );
+
+    return _ProcessResizeRows( filter, destImage.height, [&]( size_t start, size_t end ) -> HRESULT
+    {
+        return _ResizeCubicRows( srcImage, filter, destImage, cfX, cfY, start, end );
+    } );
+}
+
+
+//--- Triangle Filter ---
+// Source rows are accumulated into the destination rows they touch. A band only accumulates into
+// its own destination rows and skips source rows that touch none of them.
+static HRESULT _ResizeTriangleRows( _In_ const Image& srcImage, _In_ DWORD filter, _In_ const Image& destImage,
+                                    _In_ const TriangleFilter::Filter* tfX, _In_ const TriangleFilter::Filter* tfY,
+                                    _In_ size_t startRow, _In_ size_t endRow )
+{
     using namespace TriangleFilter;
 
-    // Allocate initial temporary space (1 scanline, accumulation rows, plus X and Y filters)
+    // Allocate initial temporary space (1 scanline, accumulation rows)
     ScopedAlignedArrayXMVECTOR scanline( reinterpret_cast<XMVECTOR*>( _aligned_malloc( sizeof(XMVECTOR) * srcImage.width, 16 ) ) );
     if ( !scanline )
         return E_OUTOFMEMORY;
 
-    std::unique_ptr<TriangleRow[]> rowActive( new (std::nothrow) TriangleRow[ destImage.height ] );
+    std::unique_ptr<TriangleRow[]> rowActive( new (std::nothrow) TriangleRow[ endRow - startRow ] );
     if ( !rowActive )
         return E_OUTOFMEMORY;
 
     TriangleRow * rowFree = nullptr;
 
-    std::unique_ptr<Filter> tfX;
-    HRESULT hr = _Create( srcImage.width, destImage.width, (filter & TEX_FILTER_WRAP_U) != 0, tfX );
-    if ( FAILED(hr) )
-        return hr;
-
-    std::unique_ptr<Filter> tfY;
-    hr = _Create( srcImage.height, destImage.height, (filter & TEX_FILTER_WRAP_V) != 0, tfY );
-    if ( FAILED(hr) )
-        return hr;
-
     XMVECTOR* row = scanline.get();
 
 #ifdef _DEBUG
     memset( row, 0xCD, sizeof(XMVECTOR)*srcImage.width );
 #endif
 
-    auto xFromEnd = reinterpret_cast<const FilterFrom*>( reinterpret_cast<const uint8_t*>( tfX.get() ) + tfX->sizeInBytes );
-    auto yFromEnd = reinterpret_cast<const FilterFrom*>( reinterpret_cast<const uint8_t*>( tfY.get() ) + tfY->sizeInBytes );
+    auto xFromEnd = reinterpret_cast<const FilterFrom*>( reinterpret_cast<const uint8_t*>( tfX ) + tfX->sizeInBytes );
+    auto yFromEnd = reinterpret_cast<const FilterFrom*>( reinterpret_cast<const uint8_t*>( tfY ) + tfY->sizeInBytes );
 
     // Count times rows get written
-    for( FilterFrom* yFrom = tfY->from; yFrom < yFromEnd; )
+    for( const FilterFrom* yFrom = tfY->from; yFrom < yFromEnd; )
     {
         for ( size_t j = 0; j < yFrom->count; ++j )
         {
             size_t v = yFrom->to[ j ].u;
             assert( v < destImage.height );
-            ++rowActive[ v ].remaining;
+            if ( v >= startRow && v < endRow )
+                ++rowActive[ v - startRow ].remaining;
         }
 
-        yFrom = reinterpret_cast<FilterFrom*>( reinterpret_cast<uint8_t*>( yFrom ) + yFrom->sizeInBytes );
+        yFrom = reinterpret_cast<const FilterFrom*>( reinterpret_cast<const uint8_t*>( yFrom ) + yFrom->sizeInBytes );
     }
 
     // Filter image
@@ -662,14 +732,21 @@ static HRESULT _ResizeTriangleFilter( _In_ const Image& srcImage, _In_ DWORD fil
 
     uint8_t* pDest = destImage.pixels;
 
-    for( FilterFrom* yFrom = tfY->from; yFrom < yFromEnd; )
+    for( const FilterFrom* yFrom = tfY->from; yFrom < yFromEnd; )
     {
+        bool inBand = false;
+
         // Create accumulation rows as needed
         for ( size_t j = 0; j < yFrom->count; ++j )
         {
             size_t v = yFrom->to[ j ].u;
             assert( v < destImage.height );
-            TriangleRow* rowAcc = &rowActive[ v ];
+            if ( v < startRow || v >= endRow )
+                continue;
+
+            inBand = true;
+
+            TriangleRow* rowAcc = &rowActive[ v - startRow ];
 
             if ( !rowAcc->scanline )
             {
@@ -691,6 +768,14 @@ static HRESULT _ResizeTriangleFilter( _In_ const Image& srcImage, _In_ DWORD fil
             }
         }
 
+        if ( !inBand )
+        {
+            // Source row only feeds destination rows of other bands
+            pSrc += rowPitch;
+            yFrom = reinterpret_cast<const FilterFrom*>( reinterpret_cast<const uint8_t*>( yFrom ) + yFrom->sizeInBytes );
+            continue;
+        }
+
         // Load source scanline
         if ( (pSrc + rowPitch) > pEndSrc )
             return E_FAIL;
@@ -702,15 +787,18 @@ static HRESULT _ResizeTriangleFilter( _In_ const Image& srcImage, _In_ DWORD fil
 
         // Process row
         size_t x = 0;
-        for( FilterFrom* xFrom = tfX->from; xFrom < xFromEnd; ++x )
+        for( const FilterFrom* xFrom = tfX->from; xFrom < xFromEnd; ++x )
         {
             for ( size_t j = 0; j < yFrom->count; ++j )
             {
                 size_t v = yFrom->to[ j ].u;
                 assert( v < destImage.height );
+                if ( v < startRow || v >= endRow )
+                    continue;
+
                 float yweight = yFrom->to[ j ].weight;
 
-                XMVECTOR* accPtr = rowActive[ v ].scanline.get();
+                XMVECTOR* accPtr = rowActive[ v - startRow ].scanline.get();
                 if ( !accPtr )
                     return E_POINTER;
 
@@ -726,7 +814,7 @@ static HRESULT _ResizeTriangleFilter( _In_ const Image& srcImage, _In_ DWORD fil
                 }
             }
 
-            xFrom = reinterpret_cast<FilterFrom*>( reinterpret_cast<uint8_t*>( xFrom ) + xFrom->sizeInBytes );
+            xFrom = reinterpret_cast<const FilterFrom*>( reinterpret_cast<const uint8_t*>( xFrom ) + xFrom->sizeInBytes );
         }
 
         // Write completed accumulation rows
@@ -734,7 +822,10 @@ static HRESULT _ResizeTriangleFilter( _In_ const Image& srcImage, _In_ DWORD fil
         {
             size_t v = yFrom->to[ j ].u;
             assert( v < destImage.height );
-            TriangleRow* rowAcc = &rowActive[ v ];
+            if ( v < startRow || v >= endRow )
+                continue;
+
+            TriangleRow* rowAcc = &rowActive[ v - startRow ];
 
             assert( rowAcc->remaining > 0 );
             --rowAcc->remaining;
@@ -773,12 +864,36 @@ static HRESULT _ResizeTriangleFilter( _In_ const Image& srcImage, _In_ DWORD fil
             }
         }
 
-        yFrom = reinterpret_cast<FilterFrom*>( reinterpret_cast<uint8_t*>( yFrom ) + yFrom->sizeInBytes );
+        yFrom = reinterpret_cast<const FilterFrom*>( reinterpret_cast<const uint8_t*>( yFrom ) + yFrom->sizeInBytes );
     }
 
     return S_OK;
 }
 
+HRESULT _ResizeTriangleFilter( _In_ const Image& srcImage, _In_ DWORD filter, _In_ const Image& destImage )
+{
+    assert( srcImage.pixels && destImage.pixels );
+    assert( srcImage.format == destImage.format );
+
+    using namespace TriangleFilter;
+
+    // X and Y filters are built once and shared by all bands
+    std::unique_ptr<Filter> tfX;
+    HRESULT hr = _Create( srcImage.width, destImage.width, (filter & TEX_FILTER_WRAP_U) != 0, tfX );
+    if ( FAILED(hr) )
+        return hr;
+
+    std::unique_ptr<Filter> tfY;
+    hr = _Create( srcImage.height, destImage.height, (filter & TEX_FILTER_WRAP_V) != 0, tfY );
+    if ( FAILED(hr) )
+        return hr;
+
+    return _ProcessResizeRows( filter, destImage.height, [&]( size_t start, size_t end ) -> HRESULT
+    {
+        return _ResizeTriangleRows( srcImage, filter, destImage, tfX.get(), tfY.get(), start, end );
+    } );
+}
+
 
 //--- Custom filter resize ---
 static HRESULT _PerformResizeUsingCustomFilters( _In_ const Image& srcImage, _In_ DWORD filter, _In_ const Image& destImage )
@@ -799,7 +914,7 @@ static HRESULT _PerformResizeUsingCustomFilters( _In_ const Image& srcImage, _In
     switch( filter_select )
     {
     case TEX_FILTER_POINT:
-        return _ResizePointFilter( srcImage, destImage );
+        return _ResizePointFilter( srcImage, filter, destImage );
         
     case TEX_FILTER_BOX:
         return _ResizeBoxFilter( srcImage, filter, destImage );
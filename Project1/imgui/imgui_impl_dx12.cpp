@@ -52,16 +52,23 @@ static ID3D12Resource*              g_pFontTextureResource = NULL;
 static D3D12_CPU_DESCRIPTOR_HANDLE  g_hFontSrvCpuDescHandles[2] = {};
 static D3D12_GPU_DESCRIPTOR_HANDLE  g_hFontSrvGpuDescHandles[2] = {};
 
+// Vertices and indices of a frame share one upload buffer that stays mapped for as long as it lives.
+// It only gets reallocated when a frame needs more than it holds, and then at least doubles in size.
 struct FrameResources
 {
-    ID3D12Resource*     IndexBuffer;
-    ID3D12Resource*     VertexBuffer;
-    int                 IndexBufferSize;
-    int                 VertexBufferSize;
+    ID3D12Resource*             UploadBuffer;
+    unsigned char*              UploadBufferData;
+    UINT64                      UploadBufferSize;
+    D3D12_VERTEX_BUFFER_VIEW    VertexBufferView;
+    D3D12_INDEX_BUFFER_VIEW     IndexBufferView;
 };
 static FrameResources*  g_pFrameResources = NULL;
 static UINT             g_numFramesInFlight = 0;
 static UINT             g_frameIndex = UINT_MAX;
+static ImGui_ImplDX12_RenderStats g_RenderStats = {};
+
+static const UINT64     g_InitialUploadBufferSize = 256 * 1024;
+static const UINT64     g_IndexDataAlignment = 16;
 
 template<typename T>
 static void SafeRelease(T*& res)
@@ -107,20 +114,8 @@ static void ImGui_ImplDX12_SetupRenderState(ImDrawData* draw_data, ID3D12Graphic
     ctx->RSSetViewports(1, &vp);
 
     // Bind shader and vertex buffers
-    unsigned int stride = sizeof(ImDrawVert);
-    unsigned int offset = 0;
-    D3D12_VERTEX_BUFFER_VIEW vbv;
-    memset(&vbv, 0, sizeof(D3D12_VERTEX_BUFFER_VIEW));
-    vbv.BufferLocation = fr->VertexBuffer->GetGPUVirtualAddress() + offset;
-    vbv.SizeInBytes = fr->VertexBufferSize * stride;
-    vbv.StrideInBytes = stride;
-    ctx->IASetVertexBuffers(0, 1, &vbv);
-    D3D12_INDEX_BUFFER_VIEW ibv;
-    memset(&ibv, 0, sizeof(D3D12_INDEX_BUFFER_VIEW));
-    ibv.BufferLocation = fr->IndexBuffer->GetGPUVirtualAddress();
-    ibv.SizeInBytes = fr->IndexBufferSize * sizeof(ImDrawIdx);
-    ibv.Format = sizeof(ImDrawIdx) == 2 ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT;
-    ctx->IASetIndexBuffer(&ibv);
+    ctx->IASetVertexBuffers(0, 1, &fr->VertexBufferView);
+    ctx->IASetIndexBuffer(&fr->IndexBufferView);
     ctx->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
     ctx->SetPipelineState(g_pPipelineState);
     ctx->SetGraphicsRootSignature(g_pRootSignature);
@@ -142,12 +137,29 @@ void ImGui_ImplDX12_RenderDrawData(ImDrawData* draw_data, ID3D12GraphicsCommandL
     // If not, we can't just re-allocate the IB or VB, we'll have to do a proper allocator.
     g_frameIndex = g_frameIndex + 1;
     FrameResources* fr = &g_pFrameResources[g_frameIndex % g_numFramesInFlight];
+    memset(&g_RenderStats, 0, sizeof(g_RenderStats));
+
+    const UINT64 vtx_size = (UINT64)draw_data->TotalVtxCount * sizeof(ImDrawVert);
+    const UINT64 idx_offset = (vtx_size + g_IndexDataAlignment - 1) & ~(g_IndexDataAlignment - 1);
+    const UINT64 idx_size = (UINT64)draw_data->TotalIdxCount * sizeof(ImDrawIdx);
+    const UINT64 required_size = idx_offset + idx_size;
 
-    // Create and grow vertex/index buffers if needed
-    if (fr->VertexBuffer == NULL || fr->VertexBufferSize < draw_data->TotalVtxCount)
+    // Grow the upload buffer geometrically so a UI that keeps getting bigger settles after a few frames
+    if (fr->UploadBuffer == NULL || fr->UploadBufferSize < required_size)
     {
-        SafeRelease(fr->VertexBuffer);
-        fr->VertexBufferSize = draw_data->TotalVtxCount + 5000;
+        UINT64 new_size = fr->UploadBufferSize > 0 ? fr->UploadBufferSize : g_InitialUploadBufferSize;
+        while (new_size < required_size)
+            new_size *= 2;
+
+        if (fr->UploadBuffer != NULL)
+        {
+            fr->UploadBuffer->Unmap(0, NULL);
+            SafeRelease(fr->UploadBuffer);
+            g_RenderStats.BufferGrowths++;
+        }
+        fr->UploadBufferData = NULL;
+        fr->UploadBufferSize = 0;
+
         D3D12_HEAP_PROPERTIES props;
         memset(&props, 0, sizeof(D3D12_HEAP_PROPERTIES));
         props.Type = D3D12_HEAP_TYPE_UPLOAD;
@@ -156,7 +168,7 @@ void ImGui_ImplDX12_RenderDrawData(ImDrawData* draw_data, ID3D12GraphicsCommandL
         D3D12_RESOURCE_DESC desc;
         memset(&desc, 0, sizeof(D3D12_RESOURCE_DESC));
         desc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
-        desc.Width = fr->VertexBufferSize * sizeof(ImDrawVert);
+        desc.Width = new_size;
         desc.Height = 1;
         desc.DepthOrArraySize = 1;
         desc.MipLevels = 1;
@@ -164,43 +176,25 @@ void ImGui_ImplDX12_RenderDrawData(ImDrawData* draw_data, ID3D12GraphicsCommandL
         desc.SampleDesc.Count = 1;
         desc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
         desc.Flags = D3D12_RESOURCE_FLAG_NONE;
-        if (g_pd3dDevice->CreateCommittedResource(&props, D3D12_HEAP_FLAG_NONE, &desc, D3D12_RESOURCE_STATE_GENERIC_READ, NULL, IID_PPV_ARGS(&fr->VertexBuffer)) < 0)
+        if (g_pd3dDevice->CreateCommittedResource(&props, D3D12_HEAP_FLAG_NONE, &desc, D3D12_RESOURCE_STATE_GENERIC_READ, NULL, IID_PPV_ARGS(&fr->UploadBuffer)) < 0)
             return;
-    }
-    if (fr->IndexBuffer == NULL || fr->IndexBufferSize < draw_data->TotalIdxCount)
-    {
-        SafeRelease(fr->IndexBuffer);
-        fr->IndexBufferSize = draw_data->TotalIdxCount + 10000;
-        D3D12_HEAP_PROPERTIES props;
-        memset(&props, 0, sizeof(D3D12_HEAP_PROPERTIES));
-        props.Type = D3D12_HEAP_TYPE_UPLOAD;
-        props.CPUPageProperty = D3D12_CPU_PAGE_PROPERTY_UNKNOWN;
-        props.MemoryPoolPreference = D3D12_MEMORY_POOL_UNKNOWN;
-        D3D12_RESOURCE_DESC desc;
-        memset(&desc, 0, sizeof(D3D12_RESOURCE_DESC));
-        desc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
-        desc.Width = fr->IndexBufferSize * sizeof(ImDrawIdx);
-        desc.Height = 1;
-        desc.DepthOrArraySize = 1;
-        desc.MipLevels = 1;
-        desc.Format = DXGI_FORMAT_UNKNOWN;
-        desc.SampleDesc.Count = 1;
-        desc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
-        desc.Flags = D3D12_RESOURCE_FLAG_NONE;
-        if (g_pd3dDevice->CreateCommittedResource(&props, D3D12_HEAP_FLAG_NONE, &desc, D3D12_RESOURCE_STATE_GENERIC_READ, NULL, IID_PPV_ARGS(&fr->IndexBuffer)) < 0)
+
+        // The CPU never reads from it
+        D3D12_RANGE range;
+        memset(&range, 0, sizeof(D3D12_RANGE));
+        void* mapped = NULL;
+        if (fr->UploadBuffer->Map(0, &range, &mapped) != S_OK)
+        {
+            SafeRelease(fr->UploadBuffer);
             return;
+        }
+        fr->UploadBufferData = (unsigned char*)mapped;
+        fr->UploadBufferSize = new_size;
     }
 
     // Upload vertex/index data into a single contiguous GPU buffer
-    void* vtx_resource, *idx_resource;
-    D3D12_RANGE range;
-    memset(&range, 0, sizeof(D3D12_RANGE));
-    if (fr->VertexBuffer->Map(0, &range, &vtx_resource) != S_OK)
-        return;
-    if (fr->IndexBuffer->Map(0, &range, &idx_resource) != S_OK)
-        return;
-    ImDrawVert* vtx_dst = (ImDrawVert*)vtx_resource;
-    ImDrawIdx* idx_dst = (ImDrawIdx*)idx_resource;
+    ImDrawVert* vtx_dst = (ImDrawVert*)fr->UploadBufferData;
+    ImDrawIdx* idx_dst = (ImDrawIdx*)(fr->UploadBufferData + idx_offset);
     for (int n = 0; n < draw_data->CmdListsCount; n++)
     {
         const ImDrawList* cmd_list = draw_data->CmdLists[n];
@@ -209,17 +203,29 @@ void ImGui_ImplDX12_RenderDrawData(ImDrawData* draw_data, ID3D12GraphicsCommandL
         vtx_dst += cmd_list->VtxBuffer.Size;
         idx_dst += cmd_list->IdxBuffer.Size;
     }
-    fr->VertexBuffer->Unmap(0, &range);
-    fr->IndexBuffer->Unmap(0, &range);
+    g_RenderStats.BytesUploaded += vtx_size + idx_size;
+
+    const D3D12_GPU_VIRTUAL_ADDRESS buffer_address = fr->UploadBuffer->GetGPUVirtualAddress();
+    fr->VertexBufferView.BufferLocation = buffer_address;
+    fr->VertexBufferView.SizeInBytes = (UINT)vtx_size;
+    fr->VertexBufferView.StrideInBytes = sizeof(ImDrawVert);
+    fr->IndexBufferView.BufferLocation = buffer_address + idx_offset;
+    fr->IndexBufferView.SizeInBytes = (UINT)idx_size;
+    fr->IndexBufferView.Format = sizeof(ImDrawIdx) == 2 ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT;
 
     // Setup desired DX state
     ImGui_ImplDX12_SetupRenderState(draw_data, ctx, fr);
 
     // Render command lists
     // (Because we merged all buffers into a single one, we maintain our own offset into them)
+    // The bound texture and scissor rectangle are tracked so they are only set when they change. User callbacks may
+    // change either of them behind our back, so the tracking is reset after each one.
     int global_vtx_offset = 0;
     int global_idx_offset = 0;
     ImVec2 clip_off = draw_data->DisplayPos;
+    D3D12_GPU_DESCRIPTOR_HANDLE bound_texture_handle = {};
+    D3D12_RECT bound_scissor_rect = {};
+    bool is_scissor_rect_bound = false;
     for (int n = 0; n < draw_data->CmdListsCount; n++)
     {
         const ImDrawList* cmd_list = draw_data->CmdLists[n];
@@ -234,18 +240,43 @@ void ImGui_ImplDX12_RenderDrawData(ImDrawData* draw_data, ID3D12GraphicsCommandL
                     ImGui_ImplDX12_SetupRenderState(draw_data, ctx, fr);
                 else
                     pcmd->UserCallback(cmd_list, pcmd);
+                bound_texture_handle.ptr = 0;
+                is_scissor_rect_bound = false;
             }
             else
             {
+                // Fold the commands that follow into this draw as long as they continue its index range with the same state
+                unsigned int elem_count = pcmd->ElemCount;
+                while (cmd_i + 1 < cmd_list->CmdBuffer.Size)
+                {
+                    const ImDrawCmd* next_cmd = &cmd_list->CmdBuffer[cmd_i + 1];
+                    if (next_cmd->UserCallback != NULL || next_cmd->GetTexID() != pcmd->GetTexID() || next_cmd->VtxOffset != pcmd->VtxOffset ||
+                        next_cmd->IdxOffset != pcmd->IdxOffset + elem_count || memcmp(&next_cmd->ClipRect, &pcmd->ClipRect, sizeof(ImVec4)) != 0)
+                        break;
+                    elem_count += next_cmd->ElemCount;
+                    g_RenderStats.MergedDrawCmds++;
+                    cmd_i++;
+                }
+
                 // Apply Scissor, Bind texture, Draw
                 const D3D12_RECT r = { (LONG)(pcmd->ClipRect.x - clip_off.x), (LONG)(pcmd->ClipRect.y - clip_off.y), (LONG)(pcmd->ClipRect.z - clip_off.x), (LONG)(pcmd->ClipRect.w - clip_off.y) };
                 if (r.right > r.left && r.bottom > r.top)
                 {
                     D3D12_GPU_DESCRIPTOR_HANDLE texture_handle = {};
                     texture_handle.ptr = g_hFontSrvGpuDescHandles[(g_frameIndex + 1) % g_numFramesInFlight].ptr;//(UINT64)(intptr_t)pcmd->GetTexID();
-                    ctx->SetGraphicsRootDescriptorTable(1, texture_handle);
-                    ctx->RSSetScissorRects(1, &r);
-                    ctx->DrawIndexedInstanced(pcmd->ElemCount, 1, pcmd->IdxOffset + global_idx_offset, pcmd->VtxOffset + global_vtx_offset, 0);
+                    if (texture_handle.ptr != bound_texture_handle.ptr)
+                    {
+                        ctx->SetGraphicsRootDescriptorTable(1, texture_handle);
+                        bound_texture_handle = texture_handle;
+                    }
+                    if (!is_scissor_rect_bound || memcmp(&r, &bound_scissor_rect, sizeof(D3D12_RECT)) != 0)
+                    {
+                        ctx->RSSetScissorRects(1, &r);
+                        bound_scissor_rect = r;
+                        is_scissor_rect_bound = true;
+                    }
+                    ctx->DrawIndexedInstanced(elem_count, 1, pcmd->IdxOffset + global_idx_offset, pcmd->VtxOffset + global_vtx_offset, 0);
+                    g_RenderStats.DrawCalls++;
                 }
             }
         }
@@ -254,6 +285,11 @@ void ImGui_ImplDX12_RenderDrawData(ImDrawData* draw_data, ID3D12GraphicsCommandL
     }
 }
 
+void ImGui_ImplDX12_GetRenderStats(ImGui_ImplDX12_RenderStats* out_stats)
+{
+    *out_stats = g_RenderStats;
+}
+
 static void ImGui_ImplDX12_CreateFontsTexture()
 {
     // Build texture atlas
@@ -651,8 +687,11 @@ void    ImGui_ImplDX12_InvalidateDeviceObjects()
     for (UINT i = 0; i < g_numFramesInFlight; i++)
     {
         FrameResources* fr = &g_pFrameResources[i];
-        SafeRelease(fr->IndexBuffer);
-        SafeRelease(fr->VertexBuffer);
+        if (fr->UploadBuffer != NULL)
+            fr->UploadBuffer->Unmap(0, NULL);
+        SafeRelease(fr->UploadBuffer);
+        fr->UploadBufferData = NULL;
+        fr->UploadBufferSize = 0;
     }
 }
 
@@ -676,14 +715,11 @@ bool ImGui_ImplDX12_Init(ID3D12Device* device, int num_frames_in_flight, DXGI_FO
     g_frameIndex = UINT_MAX;
     IM_UNUSED(cbv_srv_heap); // Unused in master branch (will be used by multi-viewports)
 
-    // Create buffers with a default size (they will later be grown as needed)
+    // Upload buffers are created by the first frame that renders with them, and grown as needed
     for (int i = 0; i < num_frames_in_flight; i++)
     {
         FrameResources* fr = &g_pFrameResources[i];
-        fr->IndexBuffer = NULL;
-        fr->VertexBuffer = NULL;
-        fr->IndexBufferSize = 10000;
-        fr->VertexBufferSize = 5000;
+        memset(fr, 0, sizeof(FrameResources));
     }
 
     return true;
@@ -40,6 +40,16 @@ IMGUI_IMPL_API void     ImGui_ImplDX12_Shutdown();
 IMGUI_IMPL_API void     ImGui_ImplDX12_NewFrame();
 IMGUI_IMPL_API void     ImGui_ImplDX12_RenderDrawData(ImDrawData* draw_data, ID3D12GraphicsCommandList* graphics_command_list);
 
+// Counters of the last ImGui_ImplDX12_RenderDrawData() call.
+struct ImGui_ImplDX12_RenderStats
+{
+    size_t  BytesUploaded;      // Vertex and index bytes written to the frame's upload buffer
+    int     DrawCalls;          // DrawIndexedInstanced() calls issued
+    int     MergedDrawCmds;     // ImDrawCmd folded into the draw call of the one before it
+    int     BufferGrowths;      // Upload buffer reallocations, should stay at 0 once the UI settled
+};
+IMGUI_IMPL_API void     ImGui_ImplDX12_GetRenderStats(ImGui_ImplDX12_RenderStats* out_stats);
+
 // Use if you want to reset your rendering device without losing Dear ImGui state.
 IMGUI_IMPL_API void     ImGui_ImplDX12_InvalidateDeviceObjects();
 IMGUI_IMPL_API bool     ImGui_ImplDX12_CreateDeviceObjects();
@@ -1,13 +1,63 @@
 #include "D3D12Lite.h"
 #include "WindowManager.h"
 #include "Renderer.h"
+#include "Benchmarks.h"
+#include "Tests.h"
+#include <chrono>
+#include <iostream>
+#include <string>
 
 using namespace D3D12Lite;
 
-int main()
+//Renders the mesh tutorial on the null backend and reports how fast the CPU side of a frame runs.
+int RunHeadless(Uint2 screenSize, uint32_t numFrames, uint32_t numMeshInstances)
+{
+	std::unique_ptr<Renderer> renderer = std::make_unique<Renderer>(NullDeviceDesc{}, screenSize);
+	renderer->SetNumMeshInstances(numMeshInstances);
+
+	auto startTime = std::chrono::high_resolution_clock::now();
+
+	for (uint32_t frameIndex = 0; frameIndex < numFrames; frameIndex++)
+	{
+		renderer->RenderMeshTutorial();
+	}
+
+	std::chrono::duration<double> elapsedTime = std::chrono::high_resolution_clock::now() - startTime;
+
+	std::cout << "Headless: " << numFrames << " frames of " << numMeshInstances << " meshes in " << elapsedTime.count() * 1000.0 << " ms, "
+		<< numFrames / elapsedTime.count() << " frames per second" << std::endl;
+
+	renderer = nullptr;
+
+	return 0;
+}
+
+int main(int argc, char* argv[])
 {
 	std::wstring applicationName = L"D3D12 Tutorial";
 	Uint2 windowSize = { 1600, 900 };
+
+	//--bench [resource directory]
+	if (argc > 1 && std::string(argv[1]) == "--bench")
+	{
+		return RunBenchmarks(argc > 2 ? argv[2] : RESOURCE_PATH);
+	}
+
+	//--test
+	if (argc > 1 && std::string(argv[1]) == "--test")
+	{
+		return RunTests();
+	}
+
+	//--headless [frames] [meshes]
+	if (argc > 1 && std::string(argv[1]) == "--headless")
+	{
+		uint32_t numFrames = argc > 2 ? static_cast<uint32_t>(std::stoul(argv[2])) : 1000;
+		uint32_t numMeshInstances = argc > 3 ? static_cast<uint32_t>(std::stoul(argv[3])) : 1;
+
+		return RunHeadless(windowSize, numFrames, numMeshInstances);
+	}
+
 	HINSTANCE moduleHandle = GetModuleHandle(nullptr);
 
 	WindowManager windowManager = WindowManager(applicationName, windowSize);
@@ -0,0 +1,1028 @@
+#include "Benchmarks.h"
+#include "Renderer.h"
+#include "TransformHierarchy.h"
+#include "EntityStore.h"
+#include "Model.h"
+#include "D3D12LiteNullBackend.h"
+#include "D3D12MemoryAllocator/D3D12MemAlloc.h"
+#include "DXTex/DirectXTex.h"
+#include "DXTex/BC.h"
+#include "DXTex/DirectXTexP.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <thread>
+
+namespace
+{
+    constexpr uint32_t NUM_WARMUP_FRAMES = 8;
+    constexpr uint32_t NUM_TIMED_FRAMES = 20;
+
+    double GetMillisecondsSince(std::chrono::steady_clock::time_point startTime)
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+    }
+
+    uint32_t GetNumHardwareThreads()
+    {
+        return (std::max)(std::thread::hardware_concurrency(), 1u);
+    }
+
+    // Every thread takes a handful of descriptors and gives them back, over and over, on a heap shared by all of them.
+    void RunDescriptorBenchmark(Device& device)
+    {
+        constexpr uint32_t NUM_HEAP_DESCRIPTORS = 65536;
+        constexpr uint32_t NUM_HELD_DESCRIPTORS = 64;
+        constexpr uint32_t NUM_ROUNDS_PER_THREAD = 16384;
+
+        std::cout << "Staging descriptors, " << NUM_ROUNDS_PER_THREAD * NUM_HELD_DESCRIPTORS << " allocations and frees per thread" << std::endl;
+
+        double singleThreadOperationsPerSecond = 0.0;
+
+        for (uint32_t numThreads = 1; numThreads <= 32; numThreads *= 2)
+        {
+            StagingDescriptorHeap heap(device.GetBackend(), D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, NUM_HEAP_DESCRIPTORS);
+            std::vector<std::thread> threads;
+
+            auto startTime = std::chrono::steady_clock::now();
+
+            for (uint32_t threadIndex = 0; threadIndex < numThreads; threadIndex++)
+            {
+                threads.emplace_back([&heap]()
+                {
+                    std::array<Descriptor, NUM_HELD_DESCRIPTORS> descriptors;
+
+                    for (uint32_t roundIndex = 0; roundIndex < NUM_ROUNDS_PER_THREAD; roundIndex++)
+                    {
+                        for (Descriptor& descriptor : descriptors)
+                        {
+                            descriptor = heap.GetNewDescriptor();
+                        }
+
+                        for (const Descriptor& descriptor : descriptors)
+                        {
+                            heap.FreeDescriptor(descriptor);
+                        }
+                    }
+                });
+            }
+
+            for (std::thread& thread : threads)
+            {
+                thread.join();
+            }
+
+            const double milliseconds = GetMillisecondsSince(startTime);
+            const double operationsPerSecond = 2.0 * NUM_ROUNDS_PER_THREAD * NUM_HELD_DESCRIPTORS * numThreads / (milliseconds / 1000.0);
+
+            if (numThreads == 1)
+            {
+                singleThreadOperationsPerSecond = operationsPerSecond;
+            }
+
+            std::cout << "  " << numThreads << " threads: " << milliseconds << " ms, " << operationsPerSecond / 1000000.0 << " M operations/s ("
+                << operationsPerSecond / singleThreadOperationsPerSecond << "x), " << heap.GetNumGlobalRefills() << " global refills, "
+                << heap.GetNumGlobalReturns() << " global returns" << std::endl;
+        }
+    }
+
+    void PrintFrameStatistics(Device& device)
+    {
+        const BarrierStatistics& barrierStatistics = device.GetLastFrameBarrierStatistics();
+        const StateFilterStatistics& stateFilterStatistics = device.GetLastFrameStateFilterStatistics();
+
+        std::cout << "    barriers " << barrierStatistics.mNumBarriersIssued << " issued / " << barrierStatistics.mNumBarriersElided << " elided in "
+            << barrierStatistics.mNumBarrierBatches << " batches, state calls " << stateFilterStatistics.mNumStateCallsIssued << " issued / "
+            << stateFilterStatistics.mNumStateCallsSkipped << " skipped, " << stateFilterStatistics.mNumDescriptorTablesReused
+            << " descriptor tables reused" << std::endl;
+    }
+
+    // The mesh tutorial's grid of cubes, recorded on a growing number of contexts and threads.
+    void RunDrawScalingBenchmark(Renderer& renderer)
+    {
+        constexpr uint32_t NUM_DRAWS = 100000;
+
+        std::cout << "Draw recording, " << NUM_DRAWS << " draws" << std::endl;
+
+        renderer.SetNumMeshInstances(NUM_DRAWS);
+
+        double singleThreadMilliseconds = 0.0;
+
+        for (uint32_t numThreads = 1; numThreads <= 8; numThreads *= 2)
+        {
+            renderer.SetNumMeshRecordingThreads(numThreads);
+
+            for (uint32_t frameIndex = 0; frameIndex < NUM_WARMUP_FRAMES; frameIndex++)
+            {
+                renderer.RenderMeshTutorial();
+            }
+
+            auto startTime = std::chrono::steady_clock::now();
+
+            for (uint32_t frameIndex = 0; frameIndex < NUM_TIMED_FRAMES; frameIndex++)
+            {
+                renderer.RenderMeshTutorial();
+            }
+
+            const double frameMilliseconds = GetMillisecondsSince(startTime) / NUM_TIMED_FRAMES;
+
+            if (numThreads == 1)
+            {
+                singleThreadMilliseconds = frameMilliseconds;
+            }
+
+            std::cout << "  " << numThreads << " threads: " << frameMilliseconds << " ms per frame (" << singleThreadMilliseconds / frameMilliseconds << "x)" << std::endl;
+            PrintFrameStatistics(renderer.GetDevice());
+        }
+    }
+
+    // Every draw binds its pipeline, resources, viewport and topology again, the contexts drop what did not change.
+    void RunStateFilterBenchmark(Renderer& renderer)
+    {
+        constexpr uint32_t NUM_DRAWS = 50000;
+
+        std::cout << "State filtering, " << NUM_DRAWS << " draws binding all of their state" << std::endl;
+
+        renderer.SetNumMeshInstances(NUM_DRAWS);
+        renderer.SetRebindMeshStatePerDraw(true);
+
+        // The statistics are those of the frame before the last one rendered.
+        renderer.RenderMeshTutorial();
+        renderer.RenderMeshTutorial();
+
+        PrintFrameStatistics(renderer.GetDevice());
+
+        NullDeviceBackend& nullBackend = static_cast<NullDeviceBackend&>(renderer.GetDevice().GetBackend());
+        nullBackend.ResetStatistics();
+        renderer.RenderMeshTutorial();
+
+        const NullBackendStatistics& nullStatistics = nullBackend.GetStatistics();
+        auto getSubmittedCount = [&nullStatistics](RecordedCommandType type) { return nullStatistics.mSubmittedCommandCounts[static_cast<uint32_t>(type)]; };
+
+        std::cout << "    submitted: " << getSubmittedCount(RecordedCommandType::drawInstanced) << " draws, "
+            << getSubmittedCount(RecordedCommandType::setPipelineState) << " pipeline states, "
+            << getSubmittedCount(RecordedCommandType::setGraphicsRootSignature) << " root signatures, "
+            << getSubmittedCount(RecordedCommandType::setGraphicsRootDescriptorTable) << " descriptor tables, "
+            << getSubmittedCount(RecordedCommandType::setViewports) << " viewports, "
+            << getSubmittedCount(RecordedCommandType::setPrimitiveTopology) << " topologies, "
+            << getSubmittedCount(RecordedCommandType::setGraphicsRootConstantBufferView) << " root CBVs in "
+            << nullStatistics.mNumSubmittedCommandLists << " command lists" << std::endl;
+
+        renderer.SetRebindMeshStatePerDraw(false);
+        renderer.SetNumMeshInstances(1);
+    }
+
+    void RunTextureBenchmark(Renderer& renderer, const std::string& textureDirectory)
+    {
+        std::vector<std::string> texturePaths;
+        std::error_code errorCode;
+
+        for (const auto& entry : std::filesystem::directory_iterator(textureDirectory, errorCode))
+        {
+            if (entry.is_regular_file() && entry.path().extension() == ".dds")
+            {
+                texturePaths.push_back(entry.path().string());
+            }
+        }
+
+        if (texturePaths.empty())
+        {
+            std::cout << "Texture loading skipped, no .dds files in \"" << textureDirectory << "\"" << std::endl;
+            return;
+        }
+
+        std::cout << "Texture loading, " << texturePaths.size() << " files from \"" << textureDirectory << "\"" << std::endl;
+
+        Device& device = renderer.GetDevice();
+        std::vector<std::unique_ptr<TextureResource>> textures;
+        uint64_t totalFileBytes = 0;
+
+        auto startTime = std::chrono::steady_clock::now();
+
+        for (const std::string& texturePath : texturePaths)
+        {
+            textures.push_back(device.CreateTextureFromFile(texturePath));
+            totalFileBytes += std::filesystem::file_size(texturePath, errorCode);
+        }
+
+        const double createMilliseconds = GetMillisecondsSince(startTime);
+        uint32_t numUploadFrames = 0;
+
+        while (std::any_of(textures.begin(), textures.end(), [](const std::unique_ptr<TextureResource>& texture) { return !texture->mIsReady; }))
+        {
+            renderer.RenderClearColorTutorial();
+            numUploadFrames++;
+        }
+
+        const double totalMilliseconds = GetMillisecondsSince(startTime);
+        const double totalMegabytes = totalFileBytes / (1024.0 * 1024.0);
+
+        std::cout << "  " << totalMegabytes << " MB, created in " << createMilliseconds << " ms, ready after " << numUploadFrames << " frames and "
+            << totalMilliseconds << " ms, " << totalMegabytes / (totalMilliseconds / 1000.0) << " MB/s" << std::endl;
+
+        for (std::unique_ptr<TextureResource>& texture : textures)
+        {
+            device.DestroyTexture(std::move(texture));
+        }
+    }
+
+    void PrintModelLoadStatistics(const ModelLoadStatistics& statistics)
+    {
+        std::cout << "    " << statistics.mLoadMilliseconds << " ms";
+
+        if (statistics.mWasCooked)
+        {
+            std::cout << ", Assimp import " << statistics.mCook.mImportMilliseconds << " ms, optimize " << statistics.mCook.mOptimizeMilliseconds
+                << " ms, cook " << statistics.mCook.mCookMilliseconds << " ms, " << statistics.mCook.mFileSize << " bytes cooked";
+        }
+
+        std::cout << ", " << statistics.mMeshlets.mNumMeshlets << " meshlets in " << statistics.mMeshlets.mBuildMilliseconds << " ms, vertex fill "
+            << statistics.mMeshlets.mVertexFillRate * 100.0f << "%, triangle fill " << statistics.mMeshlets.mTriangleFillRate * 100.0f << "%" << std::endl;
+    }
+
+    // Every model is loaded cold, with its cooked file removed so Assimp and the mesh optimizer run, then warm from the
+    // cooked file that load wrote.
+    void RunModelLoadBenchmark(Device& device, const std::string& modelDirectory)
+    {
+        const std::vector<std::string> modelExtensions = { ".obj", ".fbx", ".gltf", ".glb", ".dae" };
+        std::vector<std::string> modelPaths;
+        std::error_code errorCode;
+
+        for (const auto& entry : std::filesystem::directory_iterator(modelDirectory, errorCode))
+        {
+            if (entry.is_regular_file() && std::find(modelExtensions.begin(), modelExtensions.end(), entry.path().extension().string()) != modelExtensions.end())
+            {
+                modelPaths.push_back(entry.path().string());
+            }
+        }
+
+        if (modelPaths.empty())
+        {
+            std::cout << "Model loading skipped, no model files in \"" << modelDirectory << "\"" << std::endl;
+            return;
+        }
+
+        std::cout << "Model loading, " << modelPaths.size() << " files from \"" << modelDirectory << "\"" << std::endl;
+
+        for (const std::string& modelPath : modelPaths)
+        {
+            std::filesystem::remove(modelPath + MODEL_FILE_EXTENSION, errorCode);
+
+            Model coldModel;
+            if (!coldModel.LoadFromFile(modelPath, device))
+            {
+                std::cout << "  " << modelPath << " failed to load" << std::endl;
+                continue;
+            }
+
+            const ModelLoadStatistics& coldStatistics = coldModel.GetLoadStatistics();
+            std::cout << "  " << modelPath << ", " << coldModel.GetMeshes().size() << " meshes" << std::endl;
+            std::cout << "  cold" << std::endl;
+            PrintModelLoadStatistics(coldStatistics);
+
+            for (size_t meshIndex = 0; meshIndex < coldStatistics.mCook.mMeshes.size(); meshIndex++)
+            {
+                const ModelMeshCookStatistics& meshStatistics = coldStatistics.mCook.mMeshes[meshIndex];
+                std::cout << "    mesh " << meshIndex << ": ACMR " << meshStatistics.mImported.mACMR << " -> " << meshStatistics.mOptimized.mACMR
+                    << ", ATVR " << meshStatistics.mImported.mATVR << " -> " << meshStatistics.mOptimized.mATVR << std::endl;
+            }
+
+            Model warmModel;
+            if (warmModel.LoadFromFile(modelPath, device))
+            {
+                std::cout << "  warm" << std::endl;
+                PrintModelLoadStatistics(warmModel.GetLoadStatistics());
+            }
+        }
+    }
+
+    double GetMegapixelsPerSecond(size_t numPixels, double milliseconds)
+    {
+        return numPixels / (milliseconds * 1000.0);
+    }
+
+    // Smooth gradients on the left, noise on the right and a hard edged checkerboard over the bottom quarter, so the
+    // codecs and filters see the kinds of blocks real textures have.
+    void CreateBenchmarkImage(size_t width, size_t height, DirectX::ScratchImage& image)
+    {
+        image.Initialize2D(DXGI_FORMAT_R8G8B8A8_UNORM, width, height, 1, 1);
+        const DirectX::Image& pixels = *image.GetImage(0, 0, 0);
+
+        std::mt19937 randomGenerator(0);
+        std::uniform_int_distribution<uint32_t> randomByte(0, 255);
+
+        for (size_t y = 0; y < height; y++)
+        {
+            uint8_t* row = pixels.pixels + y * pixels.rowPitch;
+
+            for (size_t x = 0; x < width; x++)
+            {
+                uint8_t* pixel = row + x * 4;
+
+                if (y >= height * 3 / 4)
+                {
+                    const uint8_t value = (x / 8 + y / 8) % 2 == 0 ? 20 : 230;
+                    pixel[0] = value;
+                    pixel[1] = value;
+                    pixel[2] = 255 - value;
+                    pixel[3] = 255;
+                }
+                else if (x < width / 2)
+                {
+                    pixel[0] = static_cast<uint8_t>(x * 510 / width);
+                    pixel[1] = static_cast<uint8_t>(y * 340 / height);
+                    pixel[2] = static_cast<uint8_t>(255 - x * 510 / width);
+                    pixel[3] = static_cast<uint8_t>(128 + y * 127 / height);
+                }
+                else
+                {
+                    pixel[0] = static_cast<uint8_t>(randomByte(randomGenerator));
+                    pixel[1] = static_cast<uint8_t>(randomByte(randomGenerator));
+                    pixel[2] = static_cast<uint8_t>(randomByte(randomGenerator));
+                    pixel[3] = 255;
+                }
+            }
+        }
+    }
+
+    // BC1-BC5 decompressed to 8 bit and float RGBA, next to the per block reference decoder the palette path replaced.
+    void RunDecompressionBenchmark(const DirectX::Image& sourceImage)
+    {
+        struct DecompressionFormat
+        {
+            const char* mName;
+            DXGI_FORMAT mFormat;
+            void (*mDecodeBlock)(DirectX::XMVECTOR*, const uint8_t*);
+            size_t mBlockSize;
+        };
+
+        const DecompressionFormat formats[] =
+        {
+            { "BC1", DXGI_FORMAT_BC1_UNORM, DirectX::D3DXDecodeBC1, 8 },
+            { "BC2", DXGI_FORMAT_BC2_UNORM, DirectX::D3DXDecodeBC2, 16 },
+            { "BC3", DXGI_FORMAT_BC3_UNORM, DirectX::D3DXDecodeBC3, 16 },
+            { "BC4", DXGI_FORMAT_BC4_UNORM, DirectX::D3DXDecodeBC4U, 8 },
+            { "BC5", DXGI_FORMAT_BC5_UNORM, DirectX::D3DXDecodeBC5U, 16 },
+        };
+
+        const size_t numPixels = sourceImage.width * sourceImage.height;
+
+        std::cout << "BC decompression, " << sourceImage.width << "x" << sourceImage.height << " on " << GetNumHardwareThreads() << " threads" << std::endl;
+
+        for (const DecompressionFormat& format : formats)
+        {
+            DirectX::ScratchImage compressedImage;
+            DirectX::Compress(sourceImage, format.mFormat, DirectX::TEX_COMPRESS_PARALLEL, 0.5f, compressedImage);
+            const DirectX::Image& compressed = *compressedImage.GetImage(0, 0, 0);
+
+            // The blocks are summed up so the decoding can't be optimized away.
+            DirectX::XMVECTOR blockColors[NUM_PIXELS_PER_BLOCK];
+            DirectX::XMVECTOR referenceSum = DirectX::XMVectorZero();
+
+            auto startTime = std::chrono::steady_clock::now();
+
+            for (size_t blockOffset = 0; blockOffset < compressed.slicePitch; blockOffset += format.mBlockSize)
+            {
+                format.mDecodeBlock(blockColors, compressed.pixels + blockOffset);
+                referenceSum = DirectX::XMVectorAdd(referenceSum, blockColors[0]);
+            }
+
+            const double referenceMilliseconds = GetMillisecondsSince(startTime);
+
+            DirectX::ScratchImage decompressedImage;
+
+            startTime = std::chrono::steady_clock::now();
+            DirectX::Decompress(compressed, DXGI_FORMAT_R8G8B8A8_UNORM, decompressedImage);
+            const double rgba8Milliseconds = GetMillisecondsSince(startTime);
+
+            startTime = std::chrono::steady_clock::now();
+            DirectX::Decompress(compressed, DXGI_FORMAT_R32G32B32A32_FLOAT, decompressedImage);
+            const double floatMilliseconds = GetMillisecondsSince(startTime);
+
+            std::cout << "  " << format.mName << ": reference decoder " << GetMegapixelsPerSecond(numPixels, referenceMilliseconds) << " MPix/s, to RGBA8 "
+                << GetMegapixelsPerSecond(numPixels, rgba8Milliseconds) << " MPix/s, to float " << GetMegapixelsPerSecond(numPixels, floatMilliseconds)
+                << " MPix/s (reference sum " << DirectX::XMVectorGetX(referenceSum) << ")" << std::endl;
+        }
+    }
+
+    // In dB over the channels flags doesn't ignore, compressed images are decompressed for the comparison.
+    double GetPSNR(const DirectX::Image& sourceImage, const DirectX::Image& compressedImage, DWORD flags)
+    {
+        float meanSquaredError = 0.0f;
+        DirectX::ComputeMSE(sourceImage, compressedImage, meanSquaredError, nullptr, flags);
+
+        return meanSquaredError > 0.0f ? 10.0 * std::log10(1.0 / meanSquaredError) : std::numeric_limits<double>::infinity();
+    }
+
+    // The scalar encoder a block at a time, which is how every block was compressed before the batched path.
+    void EncodeBlocksScalar(const DirectX::Image& sourceImage, const DirectX::Image& compressedImage)
+    {
+        const bool isBC3 = compressedImage.format == DXGI_FORMAT_BC3_UNORM;
+        uint8_t* block = compressedImage.pixels;
+        DirectX::XMVECTOR blockColors[NUM_PIXELS_PER_BLOCK];
+
+        for (size_t blockY = 0; blockY < sourceImage.height; blockY += 4)
+        {
+            for (size_t blockX = 0; blockX < sourceImage.width; blockX += 4)
+            {
+                for (size_t pixelIndex = 0; pixelIndex < NUM_PIXELS_PER_BLOCK; pixelIndex++)
+                {
+                    const uint8_t* pixel = sourceImage.pixels + (blockY + pixelIndex / 4) * sourceImage.rowPitch + (blockX + pixelIndex % 4) * 4;
+                    blockColors[pixelIndex] = DirectX::PackedVector::XMLoadUByteN4(reinterpret_cast<const DirectX::PackedVector::XMUBYTEN4*>(pixel));
+                }
+
+                if (isBC3)
+                {
+                    DirectX::D3DXEncodeBC3(block, blockColors, DirectX::BC_FLAGS_NONE);
+                    block += 16;
+                }
+                else
+                {
+                    DirectX::D3DXEncodeBC1(block, blockColors, 0.5f, DirectX::BC_FLAGS_NONE);
+                    block += 8;
+                }
+            }
+        }
+    }
+
+    // The scalar encoder on one thread against the batched one, serial, on every thread and with the fast setting.
+    void RunBC1BC3CompressionBenchmark(const DirectX::Image& sourceImage)
+    {
+        struct CompressionVariant
+        {
+            const char* mName;
+            DWORD mFlags;
+        };
+
+        const CompressionVariant variants[] =
+        {
+            { "batched", DirectX::TEX_COMPRESS_DEFAULT },
+            { "batched, parallel", DirectX::TEX_COMPRESS_PARALLEL },
+            { "batched, parallel, fast", DirectX::TEX_COMPRESS_PARALLEL | DirectX::TEX_COMPRESS_FAST },
+        };
+
+        const size_t numPixels = sourceImage.width * sourceImage.height;
+
+        std::cout << "BC1/BC3 compression, " << sourceImage.width << "x" << sourceImage.height << " on " << GetNumHardwareThreads() << " threads" << std::endl;
+
+        for (DXGI_FORMAT format : { DXGI_FORMAT_BC1_UNORM, DXGI_FORMAT_BC3_UNORM })
+        {
+            // BC1 alpha is punch-through only, so its PSNR is over RGB.
+            const DWORD mseFlags = format == DXGI_FORMAT_BC1_UNORM ? DirectX::CMSE_IGNORE_ALPHA : DirectX::CMSE_DEFAULT;
+
+            DirectX::ScratchImage compressedImage;
+            compressedImage.Initialize2D(format, sourceImage.width, sourceImage.height, 1, 1);
+
+            auto startTime = std::chrono::steady_clock::now();
+            EncodeBlocksScalar(sourceImage, *compressedImage.GetImage(0, 0, 0));
+            const double scalarMilliseconds = GetMillisecondsSince(startTime);
+
+            std::cout << "  " << (format == DXGI_FORMAT_BC1_UNORM ? "BC1" : "BC3") << " scalar: " << GetMegapixelsPerSecond(numPixels, scalarMilliseconds)
+                << " MPix/s, PSNR " << GetPSNR(sourceImage, *compressedImage.GetImage(0, 0, 0), mseFlags) << " dB" << std::endl;
+
+            for (const CompressionVariant& variant : variants)
+            {
+                startTime = std::chrono::steady_clock::now();
+                DirectX::Compress(sourceImage, format, variant.mFlags, 0.5f, compressedImage);
+                const double milliseconds = GetMillisecondsSince(startTime);
+
+                std::cout << "    " << variant.mName << ": " << GetMegapixelsPerSecond(numPixels, milliseconds) << " MPix/s ("
+                    << scalarMilliseconds / milliseconds << "x), PSNR " << GetPSNR(sourceImage, *compressedImage.GetImage(0, 0, 0), mseFlags) << " dB" << std::endl;
+            }
+        }
+    }
+
+    // Every encoder profile on all threads, with the speedup over the default one and the quality it costs.
+    void RunBC6HBC7CompressionBenchmark(const DirectX::Image& sourceImage)
+    {
+        struct CompressionProfile
+        {
+            const char* mName;
+            DWORD mFlags;
+        };
+
+        constexpr size_t NUM_PROFILES = 4;
+        constexpr size_t DEFAULT_PROFILE_INDEX = 2;
+
+        const CompressionProfile profiles[NUM_PROFILES] =
+        {
+            { "ultrafast", DirectX::TEX_COMPRESS_ULTRAFAST },
+            { "fast", DirectX::TEX_COMPRESS_FAST },
+            { "default", DirectX::TEX_COMPRESS_DEFAULT },
+            { "slow", DirectX::TEX_COMPRESS_SLOW },
+        };
+
+        const size_t numPixels = sourceImage.width * sourceImage.height;
+
+        DirectX::ScratchImage halfFloatImage;
+        DirectX::Convert(sourceImage, DXGI_FORMAT_R16G16B16A16_FLOAT, DirectX::TEX_FILTER_DEFAULT, 0.5f, halfFloatImage);
+
+        std::cout << "BC6H/BC7 compression, " << sourceImage.width << "x" << sourceImage.height << " on " << GetNumHardwareThreads() << " threads" << std::endl;
+
+        for (DXGI_FORMAT format : { DXGI_FORMAT_BC7_UNORM, DXGI_FORMAT_BC6H_UF16 })
+        {
+            const bool isBC6H = format == DXGI_FORMAT_BC6H_UF16;
+            const DirectX::Image& formatSourceImage = isBC6H ? *halfFloatImage.GetImage(0, 0, 0) : sourceImage;
+            const DWORD mseFlags = isBC6H ? DirectX::CMSE_IGNORE_ALPHA : DirectX::CMSE_DEFAULT;
+
+            std::cout << "  " << (isBC6H ? "BC6H" : "BC7") << std::endl;
+
+            std::array<double, NUM_PROFILES> milliseconds{};
+            std::array<double, NUM_PROFILES> psnr{};
+
+            for (size_t profileIndex = 0; profileIndex < NUM_PROFILES; profileIndex++)
+            {
+                DirectX::ScratchImage compressedImage;
+
+                auto startTime = std::chrono::steady_clock::now();
+                DirectX::Compress(formatSourceImage, format, profiles[profileIndex].mFlags | DirectX::TEX_COMPRESS_PARALLEL, 0.5f, compressedImage);
+                milliseconds[profileIndex] = GetMillisecondsSince(startTime);
+                psnr[profileIndex] = GetPSNR(formatSourceImage, *compressedImage.GetImage(0, 0, 0), mseFlags);
+            }
+
+            for (size_t profileIndex = 0; profileIndex < NUM_PROFILES; profileIndex++)
+            {
+                std::cout << "    " << profiles[profileIndex].mName << ": " << GetMegapixelsPerSecond(numPixels, milliseconds[profileIndex]) << " MPix/s ("
+                    << milliseconds[DEFAULT_PROFILE_INDEX] / milliseconds[profileIndex] << "x), PSNR " << psnr[profileIndex] << " dB" << std::endl;
+            }
+        }
+    }
+
+    // What Convert does for every pair without a direct kernel: each row widened to an XMVECTOR scanline and back.
+    void ConvertRowsThroughScanline(const DirectX::Image& sourceImage, const DirectX::Image& convertedImage)
+    {
+        std::vector<DirectX::XMVECTOR> scanline(sourceImage.width);
+
+        for (size_t y = 0; y < sourceImage.height; y++)
+        {
+            DirectX::_LoadScanline(scanline.data(), sourceImage.width, sourceImage.pixels + y * sourceImage.rowPitch, sourceImage.rowPitch, sourceImage.format);
+            DirectX::_ConvertScanline(scanline.data(), sourceImage.width, convertedImage.format, sourceImage.format, DirectX::TEX_FILTER_DEFAULT);
+            DirectX::_StoreScanline(convertedImage.pixels + y * convertedImage.rowPitch, convertedImage.rowPitch, convertedImage.format, scanline.data(), sourceImage.width, 0.5f);
+        }
+    }
+
+    // The format pairs with direct kernels, each through the scanline path, then Convert on one thread and on all of them.
+    void RunConversionBenchmark(const DirectX::Image& sourceImage)
+    {
+        struct ConversionPair
+        {
+            const char* mName;
+            DXGI_FORMAT mSourceFormat;
+            DXGI_FORMAT mConvertedFormat;
+        };
+
+        const ConversionPair pairs[] =
+        {
+            { "RGBA8 -> BGRA8", DXGI_FORMAT_R8G8B8A8_UNORM, DXGI_FORMAT_B8G8R8A8_UNORM },
+            { "BGRA8 -> RGBA8", DXGI_FORMAT_B8G8R8A8_UNORM, DXGI_FORMAT_R8G8B8A8_UNORM },
+            { "RGBA8 -> RGBA8 sRGB", DXGI_FORMAT_R8G8B8A8_UNORM, DXGI_FORMAT_R8G8B8A8_UNORM_SRGB },
+            { "RGBA8 sRGB -> RGBA8", DXGI_FORMAT_R8G8B8A8_UNORM_SRGB, DXGI_FORMAT_R8G8B8A8_UNORM },
+            { "RGBA8 -> BGRA8 sRGB", DXGI_FORMAT_R8G8B8A8_UNORM, DXGI_FORMAT_B8G8R8A8_UNORM_SRGB },
+            { "R16F -> R32F", DXGI_FORMAT_R16_FLOAT, DXGI_FORMAT_R32_FLOAT },
+            { "RG16F -> RG32F", DXGI_FORMAT_R16G16_FLOAT, DXGI_FORMAT_R32G32_FLOAT },
+            { "RGBA16F -> RGBA32F", DXGI_FORMAT_R16G16B16A16_FLOAT, DXGI_FORMAT_R32G32B32A32_FLOAT },
+            { "R32F -> R16F", DXGI_FORMAT_R32_FLOAT, DXGI_FORMAT_R16_FLOAT },
+        };
+
+        const size_t numPixels = sourceImage.width * sourceImage.height;
+
+        std::cout << "Format conversion, " << sourceImage.width << "x" << sourceImage.height << " on " << GetNumHardwareThreads() << " threads" << std::endl;
+
+        for (const ConversionPair& pair : pairs)
+        {
+            // Convert refuses to convert to the format an image already has.
+            DirectX::ScratchImage pairSourceImage;
+            if (pair.mSourceFormat == sourceImage.format)
+            {
+                pairSourceImage.InitializeFromImage(sourceImage);
+            }
+            else
+            {
+                DirectX::Convert(sourceImage, pair.mSourceFormat, DirectX::TEX_FILTER_DEFAULT, 0.5f, pairSourceImage);
+            }
+
+            const DirectX::Image& pairSource = *pairSourceImage.GetImage(0, 0, 0);
+
+            DirectX::ScratchImage convertedImage;
+            convertedImage.Initialize2D(pair.mConvertedFormat, pairSource.width, pairSource.height, 1, 1);
+
+            auto startTime = std::chrono::steady_clock::now();
+            ConvertRowsThroughScanline(pairSource, *convertedImage.GetImage(0, 0, 0));
+            const double scanlineMilliseconds = GetMillisecondsSince(startTime);
+
+            startTime = std::chrono::steady_clock::now();
+            DirectX::Convert(pairSource, pair.mConvertedFormat, DirectX::TEX_FILTER_FORCE_NON_WIC, 0.5f, convertedImage);
+            const double directMilliseconds = GetMillisecondsSince(startTime);
+
+            startTime = std::chrono::steady_clock::now();
+            DirectX::Convert(pairSource, pair.mConvertedFormat, DirectX::TEX_FILTER_FORCE_NON_WIC | DirectX::TEX_FILTER_PARALLEL, 0.5f, convertedImage);
+            const double parallelMilliseconds = GetMillisecondsSince(startTime);
+
+            std::cout << "  " << pair.mName << ": scanline " << GetMegapixelsPerSecond(numPixels, scanlineMilliseconds) << " MPix/s, direct "
+                << GetMegapixelsPerSecond(numPixels, directMilliseconds) << " MPix/s (" << scanlineMilliseconds / directMilliseconds << "x), direct parallel "
+                << GetMegapixelsPerSecond(numPixels, parallelMilliseconds) << " MPix/s (" << scanlineMilliseconds / parallelMilliseconds << "x)" << std::endl;
+        }
+    }
+
+    // Each filter on the non-WIC path, halving the image and generating its full mip chain, serial and parallel. Source
+    // pixels per second, so the resize and the mip chain can be compared.
+    void RunResizeBenchmark(const DirectX::Image& sourceImage)
+    {
+        struct ResizeFilter
+        {
+            const char* mName;
+            DWORD mFilter;
+        };
+
+        const ResizeFilter filters[] =
+        {
+            { "point", DirectX::TEX_FILTER_POINT },
+            { "box", DirectX::TEX_FILTER_BOX },
+            { "linear", DirectX::TEX_FILTER_LINEAR },
+            { "cubic", DirectX::TEX_FILTER_CUBIC },
+            { "triangle", DirectX::TEX_FILTER_TRIANGLE },
+        };
+
+        const size_t numPixels = sourceImage.width * sourceImage.height;
+
+        std::cout << "Resize and mip generation, " << sourceImage.width << "x" << sourceImage.height << " on " << GetNumHardwareThreads() << " threads" << std::endl;
+
+        for (const ResizeFilter& filter : filters)
+        {
+            std::cout << "  " << filter.mName << ":";
+
+            for (bool isParallel : { false, true })
+            {
+                const DWORD flags = filter.mFilter | DirectX::TEX_FILTER_FORCE_NON_WIC | (isParallel ? DirectX::TEX_FILTER_PARALLEL : 0);
+                DirectX::ScratchImage resultImage;
+
+                auto startTime = std::chrono::steady_clock::now();
+                DirectX::Resize(sourceImage, sourceImage.width / 2, sourceImage.height / 2, flags, resultImage);
+                const double resizeMilliseconds = GetMillisecondsSince(startTime);
+
+                startTime = std::chrono::steady_clock::now();
+                DirectX::GenerateMipMaps(sourceImage, flags, 0, resultImage);
+                const double mipMilliseconds = GetMillisecondsSince(startTime);
+
+                std::cout << (isParallel ? ", parallel" : " serial") << " resize " << GetMegapixelsPerSecond(numPixels, resizeMilliseconds)
+                    << " MPix/s, mips " << GetMegapixelsPerSecond(numPixels, mipMilliseconds) << " MPix/s";
+            }
+
+            std::cout << std::endl;
+        }
+    }
+
+    struct AllocatorTraceOperation
+    {
+        bool mIsAllocation = false;
+        uint64_t mSize = 0;
+        uint32_t mFreeSelector = 0;
+    };
+
+    const char* GetAllocatorAlgorithmName(D3D12MA::VIRTUAL_BLOCK_FLAGS flags)
+    {
+        switch (flags & D3D12MA::VIRTUAL_BLOCK_FLAG_ALGORITHM_MASK)
+        {
+        case D3D12MA::VIRTUAL_BLOCK_FLAG_ALGORITHM_TLSF:
+            return "TLSF";
+        case D3D12MA::VIRTUAL_BLOCK_FLAG_ALGORITHM_LINEAR:
+            return "linear";
+        default:
+            return "generic";
+        }
+    }
+
+    void PrintAllocatorResult(D3D12MA::VirtualBlock& block, D3D12MA::VIRTUAL_BLOCK_FLAGS flags, size_t numOperations, double milliseconds, uint64_t numFailed)
+    {
+        D3D12MA::StatInfo statistics{};
+        block.CalculateStats(&statistics);
+
+        // Share of the free space that the biggest free range can't serve.
+        const double fragmentation = statistics.UnusedBytes > 0 ? 1.0 - static_cast<double>(statistics.UnusedRangeSizeMax) / statistics.UnusedBytes : 0.0;
+
+        std::cout << "  " << GetAllocatorAlgorithmName(flags) << ": " << milliseconds << " ms, " << milliseconds * 1000000.0 / numOperations << " ns/op, "
+            << numFailed << " failed, " << statistics.AllocationCount << " live allocations, " << statistics.UnusedRangeCount << " free ranges, fragmentation "
+            << fragmentation * 100.0 << "%" << std::endl;
+    }
+
+    // Allocations and frees in random order, the frees picking a random live allocation.
+    void RunRandomAllocatorTrace(const std::vector<AllocatorTraceOperation>& trace, uint64_t blockSize, D3D12MA::VIRTUAL_BLOCK_FLAGS flags)
+    {
+        D3D12MA::VIRTUAL_BLOCK_DESC blockDesc{};
+        blockDesc.Flags = flags;
+        blockDesc.Size = blockSize;
+
+        D3D12MA::VirtualBlock* block = nullptr;
+        D3D12MA::CreateVirtualBlock(&blockDesc, &block);
+
+        std::vector<uint64_t> liveOffsets;
+        liveOffsets.reserve(trace.size());
+        uint64_t numFailed = 0;
+
+        auto startTime = std::chrono::steady_clock::now();
+
+        for (const AllocatorTraceOperation& operation : trace)
+        {
+            if (operation.mIsAllocation || liveOffsets.empty())
+            {
+                D3D12MA::VIRTUAL_ALLOCATION_DESC allocationDesc{};
+                allocationDesc.Size = operation.mSize;
+                allocationDesc.Alignment = D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT;
+
+                uint64_t offset = 0;
+                if (SUCCEEDED(block->Allocate(&allocationDesc, &offset)))
+                {
+                    liveOffsets.push_back(offset);
+                }
+                else
+                {
+                    numFailed++;
+                }
+            }
+            else
+            {
+                const size_t liveIndex = operation.mFreeSelector % liveOffsets.size();
+                block->FreeAllocation(liveOffsets[liveIndex]);
+                liveOffsets[liveIndex] = liveOffsets.back();
+                liveOffsets.pop_back();
+            }
+        }
+
+        const double milliseconds = GetMillisecondsSince(startTime);
+        PrintAllocatorResult(*block, flags, trace.size(), milliseconds, numFailed);
+
+        block->Clear();
+        block->Release();
+    }
+
+    // Per frame transient allocations, freed in allocation order once their frame slot comes around again.
+    void RunFrameAllocatorTrace(const std::vector<uint64_t>& allocationSizes, uint32_t numAllocationsPerFrame, uint64_t blockSize, D3D12MA::VIRTUAL_BLOCK_FLAGS flags)
+    {
+        D3D12MA::VIRTUAL_BLOCK_DESC blockDesc{};
+        blockDesc.Flags = flags;
+        blockDesc.Size = blockSize;
+
+        D3D12MA::VirtualBlock* block = nullptr;
+        D3D12MA::CreateVirtualBlock(&blockDesc, &block);
+
+        std::array<std::vector<uint64_t>, NUM_FRAMES_IN_FLIGHT> frameOffsets;
+        uint64_t numFailed = 0;
+
+        auto startTime = std::chrono::steady_clock::now();
+
+        for (size_t firstAllocation = 0; firstAllocation < allocationSizes.size(); firstAllocation += numAllocationsPerFrame)
+        {
+            std::vector<uint64_t>& offsets = frameOffsets[(firstAllocation / numAllocationsPerFrame) % NUM_FRAMES_IN_FLIGHT];
+
+            for (uint64_t offset : offsets)
+            {
+                block->FreeAllocation(offset);
+            }
+
+            offsets.clear();
+
+            const size_t lastAllocation = (std::min)(firstAllocation + numAllocationsPerFrame, allocationSizes.size());
+
+            for (size_t allocationIndex = firstAllocation; allocationIndex < lastAllocation; allocationIndex++)
+            {
+                D3D12MA::VIRTUAL_ALLOCATION_DESC allocationDesc{};
+                allocationDesc.Size = allocationSizes[allocationIndex];
+                allocationDesc.Alignment = D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT;
+
+                uint64_t offset = 0;
+                if (SUCCEEDED(block->Allocate(&allocationDesc, &offset)))
+                {
+                    offsets.push_back(offset);
+                }
+                else
+                {
+                    numFailed++;
+                }
+            }
+        }
+
+        const double milliseconds = GetMillisecondsSince(startTime);
+        PrintAllocatorResult(*block, flags, allocationSizes.size() * 2, milliseconds, numFailed);
+
+        block->Clear();
+        block->Release();
+    }
+
+    void RunAllocatorBenchmarks()
+    {
+        constexpr uint32_t NUM_RANDOM_OPERATIONS = 1000000;
+        constexpr uint32_t NUM_FRAME_ALLOCATIONS = 1000000;
+        constexpr uint32_t NUM_ALLOCATIONS_PER_FRAME = 10000;
+        constexpr uint64_t BLOCK_SIZE = 256 * 1024 * 1024;
+
+        std::mt19937 randomGenerator(0);
+        std::uniform_int_distribution<uint64_t> randomSize(256, 64 * 1024);
+        std::uniform_int_distribution<uint32_t> randomSelector;
+        std::bernoulli_distribution randomIsAllocation(0.55);
+
+        std::vector<AllocatorTraceOperation> randomTrace(NUM_RANDOM_OPERATIONS);
+        for (AllocatorTraceOperation& operation : randomTrace)
+        {
+            operation.mIsAllocation = randomIsAllocation(randomGenerator);
+            operation.mSize = randomSize(randomGenerator);
+            operation.mFreeSelector = randomSelector(randomGenerator);
+        }
+
+        std::cout << "Virtual block, " << NUM_RANDOM_OPERATIONS << " random allocations and frees" << std::endl;
+        RunRandomAllocatorTrace(randomTrace, BLOCK_SIZE, D3D12MA::VIRTUAL_BLOCK_FLAG_NONE);
+        RunRandomAllocatorTrace(randomTrace, BLOCK_SIZE, D3D12MA::VIRTUAL_BLOCK_FLAG_ALGORITHM_TLSF);
+
+        std::uniform_int_distribution<uint64_t> randomConstantSize(64, 4096);
+        std::vector<uint64_t> frameAllocationSizes(NUM_FRAME_ALLOCATIONS);
+        for (uint64_t& size : frameAllocationSizes)
+        {
+            size = randomConstantSize(randomGenerator);
+        }
+
+        std::cout << "Virtual block, " << NUM_ALLOCATIONS_PER_FRAME << " allocations per frame freed in order, " << NUM_FRAME_ALLOCATIONS << " in total" << std::endl;
+        RunFrameAllocatorTrace(frameAllocationSizes, NUM_ALLOCATIONS_PER_FRAME, BLOCK_SIZE, D3D12MA::VIRTUAL_BLOCK_FLAG_NONE);
+        RunFrameAllocatorTrace(frameAllocationSizes, NUM_ALLOCATIONS_PER_FRAME, BLOCK_SIZE, D3D12MA::VIRTUAL_BLOCK_FLAG_ALGORITHM_TLSF);
+        RunFrameAllocatorTrace(frameAllocationSizes, NUM_ALLOCATIONS_PER_FRAME, BLOCK_SIZE, D3D12MA::VIRTUAL_BLOCK_FLAG_ALGORITHM_LINEAR);
+    }
+
+    void PrintTransformStatistics(const TransformHierarchyStatistics& statistics)
+    {
+        std::cout << statistics.mNumTransforms << " transforms in " << statistics.mNumLevels << " levels, " << statistics.mNumUpdated << " updated, "
+            << statistics.mNumLevelsSkipped << " levels skipped, sort " << statistics.mSortMilliseconds << " ms, update " << statistics.mUpdateMilliseconds
+            << " ms" << std::endl;
+    }
+
+    // A tree where every transform has eight children, so one root ends up above all of them.
+    void RunTransformBenchmark()
+    {
+        constexpr uint32_t NUM_TRANSFORMS = 1000000;
+        constexpr uint32_t NUM_CHILDREN = 8;
+        constexpr uint32_t NUM_SCATTERED_CHANGES = 1000;
+
+        std::cout << "Transform hierarchy, " << NUM_TRANSFORMS << " transforms on " << GetNumHardwareThreads() << " threads" << std::endl;
+
+        TransformHierarchy hierarchy(GetNumHardwareThreads());
+        std::vector<uint32_t> ids(NUM_TRANSFORMS);
+
+        for (uint32_t transformIndex = 0; transformIndex < NUM_TRANSFORMS; transformIndex++)
+        {
+            ids[transformIndex] = hierarchy.Add(transformIndex == 0 ? INVALID_TRANSFORM_ID : ids[(transformIndex - 1) / NUM_CHILDREN]);
+            hierarchy.SetLocalPosition(ids[transformIndex], Vector3(1.0f, 0.0f, 0.0f));
+        }
+
+        hierarchy.Update();
+        std::cout << "  first update: ";
+        PrintTransformStatistics(hierarchy.GetStatistics());
+
+        hierarchy.SetLocalRotation(ids[0], Quaternion::CreateFromAxisAngle(Vector3(0.0f, 1.0f, 0.0f), 0.5f));
+        hierarchy.Update();
+        std::cout << "  root changed: ";
+        PrintTransformStatistics(hierarchy.GetStatistics());
+
+        std::mt19937 randomGenerator(0);
+        std::uniform_int_distribution<uint32_t> randomTransform(0, NUM_TRANSFORMS - 1);
+
+        for (uint32_t changeIndex = 0; changeIndex < NUM_SCATTERED_CHANGES; changeIndex++)
+        {
+            hierarchy.SetLocalPosition(ids[randomTransform(randomGenerator)], Vector3(2.0f, 0.0f, 0.0f));
+        }
+
+        hierarchy.Update();
+        std::cout << "  " << NUM_SCATTERED_CHANGES << " scattered changes: ";
+        PrintTransformStatistics(hierarchy.GetStatistics());
+
+        hierarchy.Update();
+        std::cout << "  nothing changed: ";
+        PrintTransformStatistics(hierarchy.GetStatistics());
+    }
+
+    struct BenchmarkPosition
+    {
+        Vector3 mValue;
+    };
+
+    struct BenchmarkVelocity
+    {
+        Vector3 mValue;
+    };
+
+    struct BenchmarkHealth
+    {
+        float mValue = 100.0f;
+    };
+
+    void PrintEntityStatistics(const EntityStore& store)
+    {
+        const EntityStoreStatistics statistics = store.GetStatistics();
+
+        std::cout << " (" << statistics.mNumEntities << " entities, " << statistics.mNumArchetypes << " archetypes, " << statistics.mNumChunks << " chunks, "
+            << statistics.mChunkOccupancy * 100.0f << "% occupancy)" << std::endl;
+    }
+
+    void RunEntityBenchmark()
+    {
+        constexpr uint32_t NUM_ENTITIES = 1000000;
+        constexpr float DELTA_TIME = 1.0f / 60.0f;
+
+        std::cout << "Entity store, " << NUM_ENTITIES << " entities on " << GetNumHardwareThreads() << " threads" << std::endl;
+
+        EntityStore store(GetNumHardwareThreads());
+        std::vector<Entity> entities(NUM_ENTITIES);
+
+        auto startTime = std::chrono::steady_clock::now();
+
+        for (Entity& entity : entities)
+        {
+            entity = store.Create(BenchmarkPosition{}, BenchmarkVelocity{ Vector3(1.0f, 0.0f, 0.0f) });
+        }
+
+        std::cout << "  create: " << GetMillisecondsSince(startTime) << " ms";
+        PrintEntityStatistics(store);
+
+        auto integrate = [](BenchmarkPosition& position, const BenchmarkVelocity& velocity) { position.mValue += velocity.mValue * DELTA_TIME; };
+
+        startTime = std::chrono::steady_clock::now();
+        store.ForEach<BenchmarkPosition, BenchmarkVelocity>(integrate);
+        std::cout << "  ForEach: " << GetMillisecondsSince(startTime) << " ms" << std::endl;
+
+        startTime = std::chrono::steady_clock::now();
+        store.ParallelForEach<BenchmarkPosition, BenchmarkVelocity>(integrate);
+        std::cout << "  ParallelForEach: " << GetMillisecondsSince(startTime) << " ms" << std::endl;
+
+        startTime = std::chrono::steady_clock::now();
+        for (Entity entity : entities)
+        {
+            store.Add<BenchmarkHealth>(entity);
+        }
+
+        std::cout << "  add component: " << GetMillisecondsSince(startTime) << " ms";
+        PrintEntityStatistics(store);
+
+        startTime = std::chrono::steady_clock::now();
+        for (Entity entity : entities)
+        {
+            store.Remove<BenchmarkHealth>(entity);
+        }
+
+        std::cout << "  remove component: " << GetMillisecondsSince(startTime) << " ms";
+        PrintEntityStatistics(store);
+
+        // Every other entity adds a component again and every fourth one is destroyed, recorded from the worker threads.
+        EntityCommandBuffer commandBuffer;
+
+        startTime = std::chrono::steady_clock::now();
+        store.ParallelForEach<BenchmarkPosition>([&commandBuffer](Entity entity, BenchmarkPosition& position)
+        {
+            if (entity.mIndex % 4 == 0)
+            {
+                commandBuffer.Destroy(entity);
+            }
+            else if (entity.mIndex % 2 == 0)
+            {
+                commandBuffer.Add<BenchmarkHealth>(entity);
+            }
+        });
+
+        const double recordMilliseconds = GetMillisecondsSince(startTime);
+
+        startTime = std::chrono::steady_clock::now();
+        commandBuffer.Playback(store);
+
+        std::cout << "  command buffer: " << recordMilliseconds << " ms recording, " << GetMillisecondsSince(startTime) << " ms playback";
+        PrintEntityStatistics(store);
+    }
+}
+
+int RunBenchmarks(const std::string& resourceDirectory)
+{
+    Renderer renderer(NullDeviceDesc{}, Uint2{ 1600, 900 });
+
+    RunDescriptorBenchmark(renderer.GetDevice());
+    RunDrawScalingBenchmark(renderer);
+    RunStateFilterBenchmark(renderer);
+    RunTextureBenchmark(renderer, resourceDirectory);
+    RunModelLoadBenchmark(renderer.GetDevice(), resourceDirectory);
+
+    DirectX::ScratchImage benchmarkImage;
+    CreateBenchmarkImage(2048, 2048, benchmarkImage);
+
+    RunDecompressionBenchmark(*benchmarkImage.GetImage(0, 0, 0));
+    RunBC1BC3CompressionBenchmark(*benchmarkImage.GetImage(0, 0, 0));
+    RunConversionBenchmark(*benchmarkImage.GetImage(0, 0, 0));
+    RunResizeBenchmark(*benchmarkImage.GetImage(0, 0, 0));
+
+    // The default BC7 profile takes minutes on the full size image.
+    DirectX::ScratchImage smallBenchmarkImage;
+    CreateBenchmarkImage(512, 512, smallBenchmarkImage);
+
+    RunBC6HBC7CompressionBenchmark(*smallBenchmarkImage.GetImage(0, 0, 0));
+    RunAllocatorBenchmarks();
+    RunTransformBenchmark();
+    RunEntityBenchmark();
+
+    return 0;
+}
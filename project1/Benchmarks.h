@@ -0,0 +1,7 @@
+#pragma once
+
+#include <string>
+
+// Runs every benchmark headless on the null backend and prints the timings together with the statistics the systems
+// expose. Textures and models are loaded from resourceDirectory, either benchmark is skipped when it finds no files.
+int RunBenchmarks(const std::string& resourceDirectory);
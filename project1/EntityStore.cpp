@@ -0,0 +1,442 @@
+#include "EntityStore.h"
+#include <algorithm>
+
+namespace
+{
+    constexpr size_t ENTITY_CHUNK_ALIGNMENT = 64;
+
+    std::array<ComponentInfo, MAX_COMPONENT_TYPES> gComponentInfos;
+    uint32_t gNumComponentTypes = 0;
+    std::mutex gComponentInfoMutex;
+
+    uint8_t* AllocateChunk()
+    {
+        return static_cast<uint8_t*>(::operator new(ENTITY_CHUNK_SIZE, std::align_val_t(ENTITY_CHUNK_ALIGNMENT)));
+    }
+
+    void FreeChunk(uint8_t* data)
+    {
+        ::operator delete(data, std::align_val_t(ENTITY_CHUNK_ALIGNMENT));
+    }
+
+    size_t AlignOffset(size_t offset, size_t alignment)
+    {
+        return (offset + alignment - 1) & ~(alignment - 1);
+    }
+}
+
+uint32_t RegisterComponentType(const ComponentInfo& info)
+{
+    std::lock_guard<std::mutex> lockGuard(gComponentInfoMutex);
+
+    assert(gNumComponentTypes < MAX_COMPONENT_TYPES);
+    assert(info.mAlignment <= ENTITY_CHUNK_ALIGNMENT);
+
+    gComponentInfos[gNumComponentTypes] = info;
+    return gNumComponentTypes++;
+}
+
+const ComponentInfo& GetComponentInfo(uint32_t componentType)
+{
+    // Entries are written once, before the id that leads to them is handed out, and never move.
+    return gComponentInfos[componentType];
+}
+
+EntityStore::EntityStore(uint32_t numThreads)
+    : mWorkerPool(numThreads)
+{
+}
+
+EntityStore::~EntityStore()
+{
+    for (std::unique_ptr<Archetype>& archetype : mArchetypes) {
+        for (EntityChunk& chunk : archetype->mChunks) {
+            for (uint32_t componentType : archetype->mComponentTypes) {
+                const ComponentInfo& info = GetComponentInfo(componentType);
+                uint8_t* components = chunk.mData + archetype->mComponentOffsets[componentType];
+
+                for (uint32_t row = 0; row < chunk.mNumEntities; row++) {
+                    info.mDestroy(components + row * info.mSize);
+                }
+            }
+
+            FreeChunk(chunk.mData);
+        }
+    }
+}
+
+void EntityStore::Destroy(Entity entity)
+{
+    assert(mNumIterations == 0);
+
+    if (!IsAlive(entity)) {
+        return;
+    }
+
+    EntityRecord& record = mEntityRecords[entity.mIndex];
+    const Archetype& archetype = *mArchetypes[record.mArchetype];
+
+    for (uint32_t componentType : archetype.mComponentTypes) {
+        GetComponentInfo(componentType).mDestroy(GetComponentPointer(entity, componentType));
+    }
+
+    FreeRow(record);
+
+    // Handles to this entity stop matching from here on.
+    record.mGeneration++;
+    mFreeEntityIndices.push_back(entity.mIndex);
+    mNumEntities--;
+}
+
+bool EntityStore::IsAlive(Entity entity) const
+{
+    return entity.mIndex < mEntityRecords.size() && mEntityRecords[entity.mIndex].mGeneration == entity.mGeneration;
+}
+
+EntityStoreStatistics EntityStore::GetStatistics() const
+{
+    EntityStoreStatistics statistics;
+    statistics.mNumEntities = static_cast<uint32_t>(mNumEntities);
+    statistics.mNumArchetypes = static_cast<uint32_t>(mArchetypes.size());
+
+    size_t numSlots = 0;
+    for (const std::unique_ptr<Archetype>& archetype : mArchetypes) {
+        statistics.mNumChunks += static_cast<uint32_t>(archetype->mChunks.size());
+        numSlots += archetype->mChunks.size() * archetype->mChunkCapacity;
+    }
+
+    statistics.mChunkOccupancy = numSlots > 0 ? static_cast<float>(mNumEntities) / static_cast<float>(numSlots) : 0.0f;
+
+    return statistics;
+}
+
+Entity EntityStore::CreateEntity(ComponentMask mask, bool constructComponents)
+{
+    assert(mNumIterations == 0);
+
+    uint32_t entityIndex;
+    if (!mFreeEntityIndices.empty()) {
+        entityIndex = mFreeEntityIndices.back();
+        mFreeEntityIndices.pop_back();
+    } else {
+        entityIndex = static_cast<uint32_t>(mEntityRecords.size());
+        mEntityRecords.emplace_back();
+    }
+
+    const Entity entity{ entityIndex, mEntityRecords[entityIndex].mGeneration };
+    AllocateRow(GetArchetype(mask), entityIndex);
+    mNumEntities++;
+
+    if (constructComponents) {
+        for (uint32_t componentType : mArchetypes[mEntityRecords[entityIndex].mArchetype]->mComponentTypes) {
+            GetComponentInfo(componentType).mConstruct(GetComponentPointer(entity, componentType));
+        }
+    }
+
+    return entity;
+}
+
+void* EntityStore::AddComponent(Entity entity, uint32_t componentType, void* component)
+{
+    assert(mNumIterations == 0);
+    assert(IsAlive(entity));
+
+    const ComponentInfo& info = GetComponentInfo(componentType);
+    const uint32_t archetypeIndex = mEntityRecords[entity.mIndex].mArchetype;
+    const ComponentMask componentBit = ComponentMask(1) << componentType;
+
+    if (mArchetypes[archetypeIndex]->mMask & componentBit) {
+        void* existingComponent = GetComponentPointer(entity, componentType);
+        info.mDestroy(existingComponent);
+        info.mMoveConstruct(existingComponent, component);
+        return existingComponent;
+    }
+
+    auto edge = mArchetypes[archetypeIndex]->mAddEdges.find(componentType);
+    uint32_t targetArchetypeIndex;
+
+    if (edge != mArchetypes[archetypeIndex]->mAddEdges.end()) {
+        targetArchetypeIndex = edge->second;
+    } else {
+        targetArchetypeIndex = GetArchetype(mArchetypes[archetypeIndex]->mMask | componentBit);
+        mArchetypes[archetypeIndex]->mAddEdges.insert(std::make_pair(componentType, targetArchetypeIndex));
+    }
+
+    MoveToArchetype(entity.mIndex, targetArchetypeIndex);
+
+    void* addedComponent = GetComponentPointer(entity, componentType);
+    info.mMoveConstruct(addedComponent, component);
+
+    return addedComponent;
+}
+
+void EntityStore::RemoveComponent(Entity entity, uint32_t componentType)
+{
+    assert(mNumIterations == 0);
+    assert(IsAlive(entity));
+
+    const uint32_t archetypeIndex = mEntityRecords[entity.mIndex].mArchetype;
+    const ComponentMask componentBit = ComponentMask(1) << componentType;
+
+    if (!(mArchetypes[archetypeIndex]->mMask & componentBit)) {
+        return;
+    }
+
+    auto edge = mArchetypes[archetypeIndex]->mRemoveEdges.find(componentType);
+    uint32_t targetArchetypeIndex;
+
+    if (edge != mArchetypes[archetypeIndex]->mRemoveEdges.end()) {
+        targetArchetypeIndex = edge->second;
+    } else {
+        targetArchetypeIndex = GetArchetype(mArchetypes[archetypeIndex]->mMask & ~componentBit);
+        mArchetypes[archetypeIndex]->mRemoveEdges.insert(std::make_pair(componentType, targetArchetypeIndex));
+    }
+
+    MoveToArchetype(entity.mIndex, targetArchetypeIndex);
+}
+
+ComponentMask EntityStore::GetEntityMask(Entity entity) const
+{
+    assert(IsAlive(entity));
+    return mArchetypes[mEntityRecords[entity.mIndex].mArchetype]->mMask;
+}
+
+void* EntityStore::GetComponentPointer(Entity entity, uint32_t componentType) const
+{
+    assert(IsAlive(entity));
+
+    const EntityRecord& record = mEntityRecords[entity.mIndex];
+    const Archetype& archetype = *mArchetypes[record.mArchetype];
+    const uint32_t offset = archetype.mComponentOffsets[componentType];
+
+    if (offset == UINT_MAX) {
+        return nullptr;
+    }
+
+    return archetype.mChunks[record.mChunk].mData + offset + static_cast<size_t>(record.mRow) * GetComponentInfo(componentType).mSize;
+}
+
+uint32_t EntityStore::GetArchetype(ComponentMask mask)
+{
+    auto existingArchetype = mArchetypeOfMask.find(mask);
+    if (existingArchetype != mArchetypeOfMask.end()) {
+        return existingArchetype->second;
+    }
+
+    std::unique_ptr<Archetype> archetype = std::make_unique<Archetype>();
+    archetype->mMask = mask;
+    archetype->mComponentOffsets.fill(UINT_MAX);
+
+    size_t bytesPerEntity = sizeof(Entity);
+    for (uint32_t componentType = 0; componentType < MAX_COMPONENT_TYPES; componentType++) {
+        if (mask & (ComponentMask(1) << componentType)) {
+            archetype->mComponentTypes.push_back(componentType);
+            bytesPerEntity += GetComponentInfo(componentType).mSize;
+        }
+    }
+
+    // Largest capacity whose arrays, each aligned for its component, still fit in a chunk.
+    uint32_t chunkCapacity = static_cast<uint32_t>(ENTITY_CHUNK_SIZE / bytesPerEntity);
+    for (; chunkCapacity > 0; chunkCapacity--) {
+        size_t offset = chunkCapacity * sizeof(Entity);
+
+        for (uint32_t componentType : archetype->mComponentTypes) {
+            const ComponentInfo& info = GetComponentInfo(componentType);
+            offset = AlignOffset(offset, info.mAlignment);
+            archetype->mComponentOffsets[componentType] = static_cast<uint32_t>(offset);
+            offset += chunkCapacity * info.mSize;
+        }
+
+        if (offset <= ENTITY_CHUNK_SIZE) {
+            break;
+        }
+    }
+
+    // Components that together take more than a chunk for a single entity aren't supported.
+    assert(chunkCapacity > 0);
+    archetype->mChunkCapacity = chunkCapacity;
+
+    const uint32_t archetypeIndex = static_cast<uint32_t>(mArchetypes.size());
+    mArchetypes.push_back(std::move(archetype));
+    mArchetypeOfMask.insert(std::make_pair(mask, archetypeIndex));
+
+    return archetypeIndex;
+}
+
+const std::vector<uint32_t>& EntityStore::GetMatchingArchetypes(ComponentMask mask)
+{
+    QueryCache& queryCache = mQueryCaches[mask];
+
+    // Archetypes are never removed, so only the ones created since the last query with this mask need checking.
+    for (; queryCache.mNumArchetypesChecked < mArchetypes.size(); queryCache.mNumArchetypesChecked++) {
+        if ((mArchetypes[queryCache.mNumArchetypesChecked]->mMask & mask) == mask) {
+            queryCache.mArchetypes.push_back(queryCache.mNumArchetypesChecked);
+        }
+    }
+
+    return queryCache.mArchetypes;
+}
+
+void EntityStore::AllocateRow(uint32_t archetypeIndex, uint32_t entityIndex)
+{
+    Archetype& archetype = *mArchetypes[archetypeIndex];
+
+    if (archetype.mChunks.empty() || archetype.mChunks.back().mNumEntities == archetype.mChunkCapacity) {
+        archetype.mChunks.push_back(EntityChunk{ AllocateChunk(), 0 });
+    }
+
+    EntityChunk& chunk = archetype.mChunks.back();
+    EntityRecord& record = mEntityRecords[entityIndex];
+    record.mArchetype = archetypeIndex;
+    record.mChunk = static_cast<uint32_t>(archetype.mChunks.size() - 1);
+    record.mRow = chunk.mNumEntities++;
+
+    reinterpret_cast<Entity*>(chunk.mData)[record.mRow] = Entity{ entityIndex, record.mGeneration };
+}
+
+// The row's components have to be destroyed or moved out already. The archetype's last entity moves into it.
+void EntityStore::FreeRow(const EntityRecord& record)
+{
+    Archetype& archetype = *mArchetypes[record.mArchetype];
+    EntityChunk& chunk = archetype.mChunks[record.mChunk];
+    EntityChunk& lastChunk = archetype.mChunks.back();
+    const uint32_t lastRow = lastChunk.mNumEntities - 1;
+
+    if (&chunk != &lastChunk || record.mRow != lastRow) {
+        for (uint32_t componentType : archetype.mComponentTypes) {
+            const ComponentInfo& info = GetComponentInfo(componentType);
+            const uint32_t offset = archetype.mComponentOffsets[componentType];
+            uint8_t* source = lastChunk.mData + offset + static_cast<size_t>(lastRow) * info.mSize;
+
+            info.mMoveConstruct(chunk.mData + offset + static_cast<size_t>(record.mRow) * info.mSize, source);
+            info.mDestroy(source);
+        }
+
+        const Entity movedEntity = reinterpret_cast<Entity*>(lastChunk.mData)[lastRow];
+        reinterpret_cast<Entity*>(chunk.mData)[record.mRow] = movedEntity;
+
+        EntityRecord& movedRecord = mEntityRecords[movedEntity.mIndex];
+        movedRecord.mChunk = record.mChunk;
+        movedRecord.mRow = record.mRow;
+    }
+
+    if (--lastChunk.mNumEntities == 0) {
+        FreeChunk(lastChunk.mData);
+        archetype.mChunks.pop_back();
+    }
+}
+
+// Components both archetypes have are moved over, the ones only the old one has are destroyed, and the ones only the
+// new one has are left for the caller to construct.
+void EntityStore::MoveToArchetype(uint32_t entityIndex, uint32_t archetypeIndex)
+{
+    const EntityRecord oldRecord = mEntityRecords[entityIndex];
+    const Archetype& oldArchetype = *mArchetypes[oldRecord.mArchetype];
+    const Archetype& newArchetype = *mArchetypes[archetypeIndex];
+
+    AllocateRow(archetypeIndex, entityIndex);
+
+    const EntityRecord& newRecord = mEntityRecords[entityIndex];
+    uint8_t* oldData = oldArchetype.mChunks[oldRecord.mChunk].mData;
+    uint8_t* newData = newArchetype.mChunks[newRecord.mChunk].mData;
+
+    for (uint32_t componentType : oldArchetype.mComponentTypes) {
+        const ComponentInfo& info = GetComponentInfo(componentType);
+        uint8_t* source = oldData + oldArchetype.mComponentOffsets[componentType] + static_cast<size_t>(oldRecord.mRow) * info.mSize;
+
+        if (newArchetype.mComponentOffsets[componentType] != UINT_MAX) {
+            info.mMoveConstruct(newData + newArchetype.mComponentOffsets[componentType] + static_cast<size_t>(newRecord.mRow) * info.mSize, source);
+        }
+
+        info.mDestroy(source);
+    }
+
+    FreeRow(oldRecord);
+}
+
+EntityCommandBuffer::~EntityCommandBuffer()
+{
+    Clear();
+}
+
+void EntityCommandBuffer::Destroy(Entity entity)
+{
+    std::lock_guard<std::mutex> lockGuard(mMutex);
+    mCommands.push_back(Command{ CommandType::destroy, entity, 0, 0, nullptr });
+}
+
+void EntityCommandBuffer::Playback(EntityStore& store)
+{
+    std::lock_guard<std::mutex> lockGuard(mMutex);
+
+    Entity createdEntity;
+
+    for (Command& command : mCommands) {
+        switch (command.mType) {
+        case CommandType::create:
+            createdEntity = store.CreateEntity(command.mMask, false);
+            break;
+        case CommandType::addToCreated: {
+            const ComponentInfo& info = GetComponentInfo(command.mComponentType);
+            info.mMoveConstruct(store.GetComponentPointer(createdEntity, command.mComponentType), command.mComponent);
+            info.mDestroy(command.mComponent);
+            command.mComponent = nullptr;
+            break;
+        }
+        case CommandType::destroy:
+            store.Destroy(command.mEntity);
+            break;
+        case CommandType::add:
+            if (store.IsAlive(command.mEntity)) {
+                store.AddComponent(command.mEntity, command.mComponentType, command.mComponent);
+                GetComponentInfo(command.mComponentType).mDestroy(command.mComponent);
+                command.mComponent = nullptr;
+            }
+            break;
+        case CommandType::remove:
+            if (store.IsAlive(command.mEntity)) {
+                store.RemoveComponent(command.mEntity, command.mComponentType);
+            }
+            break;
+        }
+    }
+
+    Clear();
+}
+
+void* EntityCommandBuffer::Allocate(size_t size, size_t alignment)
+{
+    // Components bigger than a block get one of their own, put in front so the current block keeps being filled.
+    if (size + alignment > COMMAND_BUFFER_BLOCK_SIZE) {
+        std::unique_ptr<uint8_t[]> block(new uint8_t[size + alignment]);
+        uint8_t* storage = block.get() + AlignOffset(reinterpret_cast<uintptr_t>(block.get()), alignment) - reinterpret_cast<uintptr_t>(block.get());
+        mBlocks.insert(mBlocks.begin(), std::move(block));
+        return storage;
+    }
+
+    uintptr_t blockStart = mBlocks.empty() ? 0 : reinterpret_cast<uintptr_t>(mBlocks.back().get());
+    size_t offset = AlignOffset(blockStart + mBlockUsed, alignment) - blockStart;
+
+    if (mBlocks.empty() || offset + size > COMMAND_BUFFER_BLOCK_SIZE) {
+        mBlocks.emplace_back(new uint8_t[COMMAND_BUFFER_BLOCK_SIZE]);
+        blockStart = reinterpret_cast<uintptr_t>(mBlocks.back().get());
+        offset = AlignOffset(blockStart, alignment) - blockStart;
+    }
+
+    mBlockUsed = offset + size;
+    return mBlocks.back().get() + offset;
+}
+
+void EntityCommandBuffer::Clear()
+{
+    // Components of commands that were never played back still need destroying.
+    for (const Command& command : mCommands) {
+        if (command.mComponent) {
+            GetComponentInfo(command.mComponentType).mDestroy(command.mComponent);
+        }
+    }
+
+    mCommands.clear();
+    mBlocks.clear();
+    mBlockUsed = COMMAND_BUFFER_BLOCK_SIZE;
+}
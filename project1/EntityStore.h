@@ -0,0 +1,330 @@
+#pragma once
+
+#include <cstdint>
+#include <climits>
+#include <cassert>
+#include <algorithm>
+#include <array>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include "D3D12LiteWorkerPool.h"
+
+constexpr uint32_t ENTITY_CHUNK_SIZE = 16 * 1024;
+// Component types are tracked in a 64 bit mask per archetype.
+constexpr uint32_t MAX_COMPONENT_TYPES = 64;
+// Chunks one ParallelForEach job iterates.
+constexpr uint32_t ENTITY_CHUNKS_PER_JOB = 16;
+constexpr uint32_t INVALID_ENTITY_INDEX = UINT_MAX;
+constexpr size_t COMMAND_BUFFER_BLOCK_SIZE = 64 * 1024;
+
+using ComponentMask = uint64_t;
+
+// Index into the store's entity records plus the generation the record was at when the entity was created, so handles
+// to destroyed entities are told apart from whatever reuses their record.
+struct Entity {
+    uint32_t mIndex = INVALID_ENTITY_INDEX;
+    uint32_t mGeneration = 0;
+
+    bool operator==(const Entity& other) const { return mIndex == other.mIndex && mGeneration == other.mGeneration; }
+    bool operator!=(const Entity& other) const { return !(*this == other); }
+};
+
+// How the store constructs, moves and destroys a component type it only knows by id.
+struct ComponentInfo {
+    uint32_t mSize = 0;
+    uint32_t mAlignment = 0;
+    void (*mConstruct)(void* component) = nullptr;
+    void (*mMoveConstruct)(void* destination, void* source) = nullptr;
+    void (*mDestroy)(void* component) = nullptr;
+};
+
+uint32_t RegisterComponentType(const ComponentInfo& info);
+const ComponentInfo& GetComponentInfo(uint32_t componentType);
+
+// Ids are handed out the first time a type is used, so they can differ from run to run.
+template<typename T>
+uint32_t GetComponentType()
+{
+    static_assert(std::is_same_v<T, std::decay_t<T>>, "Components are plain types, not references or const");
+
+    static const uint32_t componentType = RegisterComponentType(ComponentInfo{
+        static_cast<uint32_t>(sizeof(T)),
+        static_cast<uint32_t>(alignof(T)),
+        [](void* component) { new (component) T(); },
+        [](void* destination, void* source) { new (destination) T(std::move(*static_cast<T*>(source))); },
+        [](void* component) { static_cast<T*>(component)->~T(); } });
+
+    return componentType;
+}
+
+template<typename... Components>
+ComponentMask GetComponentMask()
+{
+    return (ComponentMask(0) | ... | (ComponentMask(1) << GetComponentType<Components>()));
+}
+
+struct EntityStoreStatistics {
+    uint32_t mNumEntities = 0;
+    uint32_t mNumArchetypes = 0;
+    uint32_t mNumChunks = 0;
+    // Share of the chunks' entity slots in use.
+    float mChunkOccupancy = 0.0f;
+};
+
+class EntityCommandBuffer;
+
+// Entities grouped by the set of components they have, their archetype. Every archetype stores its entities in 16 KB
+// chunks, each holding an array of entity handles followed by one array per component, so iterating a component of an
+// archetype walks contiguous memory. Entities are kept packed, removing one moves the archetype's last entity into its
+// place.
+//
+// Adding or removing a component moves the entity to another archetype. These structural changes aren't allowed while
+// iterating, ForEach and ParallelForEach callbacks record them in an EntityCommandBuffer instead.
+class EntityStore {
+public:
+    EntityStore(uint32_t numThreads);
+    ~EntityStore();
+
+    EntityStore(const EntityStore&) = delete;
+    EntityStore& operator=(const EntityStore&) = delete;
+
+    template<typename... Components>
+    Entity Create(Components... components)
+    {
+        const Entity entity = CreateEntity(GetComponentMask<Components...>(), false);
+        (new (GetComponentPointer(entity, GetComponentType<Components>())) Components(std::move(components)), ...);
+        return entity;
+    }
+
+    void Destroy(Entity entity);
+    bool IsAlive(Entity entity) const;
+
+    // Replaces the component if the entity has one already.
+    template<typename T>
+    T& Add(Entity entity, T component = T())
+    {
+        return *static_cast<T*>(AddComponent(entity, GetComponentType<T>(), &component));
+    }
+
+    template<typename T>
+    void Remove(Entity entity)
+    {
+        RemoveComponent(entity, GetComponentType<T>());
+    }
+
+    template<typename T>
+    bool Has(Entity entity) const
+    {
+        return (GetEntityMask(entity) & (ComponentMask(1) << GetComponentType<T>())) != 0;
+    }
+
+    // Null when the entity doesn't have the component. Only valid until the next structural change.
+    template<typename T>
+    T* Get(Entity entity)
+    {
+        return static_cast<T*>(GetComponentPointer(entity, GetComponentType<T>()));
+    }
+
+    // Calls function for every entity that has all of the components, with a reference to each and optionally the
+    // entity first, i.e. function(Components&...) or function(Entity, Components&...).
+    template<typename... Components, typename Function>
+    void ForEach(Function&& function)
+    {
+        const ComponentMask mask = GetComponentMask<Components...>();
+
+        mNumIterations++;
+        for (uint32_t archetypeIndex : GetMatchingArchetypes(mask)) {
+            Archetype& archetype = *mArchetypes[archetypeIndex];
+            for (EntityChunk& chunk : archetype.mChunks) {
+                ForEachInChunk<Components...>(archetype, chunk, function);
+            }
+        }
+        mNumIterations--;
+    }
+
+    // Same as ForEach with the chunks spread over the worker threads, so function is called concurrently for different
+    // entities and has to be safe to call that way.
+    template<typename... Components, typename Function>
+    void ParallelForEach(Function&& function)
+    {
+        const ComponentMask mask = GetComponentMask<Components...>();
+
+        mParallelChunks.clear();
+        for (uint32_t archetypeIndex : GetMatchingArchetypes(mask)) {
+            Archetype& archetype = *mArchetypes[archetypeIndex];
+            for (EntityChunk& chunk : archetype.mChunks) {
+                mParallelChunks.emplace_back(&archetype, &chunk);
+            }
+        }
+
+        mNumIterations++;
+        const uint32_t numChunks = static_cast<uint32_t>(mParallelChunks.size());
+
+        for (uint32_t firstChunk = 0; firstChunk < numChunks; firstChunk += ENTITY_CHUNKS_PER_JOB) {
+            const uint32_t lastChunk = (std::min)(firstChunk + ENTITY_CHUNKS_PER_JOB, numChunks);
+
+            mWorkerPool.AddJob([this, &function, firstChunk, lastChunk]() {
+                for (uint32_t chunkIndex = firstChunk; chunkIndex < lastChunk; chunkIndex++) {
+                    ForEachInChunk<Components...>(*mParallelChunks[chunkIndex].first, *mParallelChunks[chunkIndex].second, function);
+                }
+            });
+        }
+
+        mWorkerPool.WaitForIdle();
+        mNumIterations--;
+    }
+
+    size_t GetNumEntities() const { return mNumEntities; }
+    EntityStoreStatistics GetStatistics() const;
+
+private:
+    friend class EntityCommandBuffer;
+
+    struct EntityChunk {
+        uint8_t* mData = nullptr;
+        uint32_t mNumEntities = 0;
+    };
+
+    struct Archetype {
+        ComponentMask mMask = 0;
+        std::vector<uint32_t> mComponentTypes;
+        // Where each component's array starts in a chunk, UINT_MAX for components the archetype doesn't have.
+        std::array<uint32_t, MAX_COMPONENT_TYPES> mComponentOffsets;
+        uint32_t mChunkCapacity = 0;
+        std::vector<EntityChunk> mChunks;
+        // Archetypes reached by adding or removing one component, filled in as they are first needed.
+        std::unordered_map<uint32_t, uint32_t> mAddEdges;
+        std::unordered_map<uint32_t, uint32_t> mRemoveEdges;
+    };
+
+    struct EntityRecord {
+        uint32_t mArchetype = 0;
+        uint32_t mChunk = 0;
+        uint32_t mRow = 0;
+        uint32_t mGeneration = 0;
+    };
+
+    // The archetypes a query's mask matched, and how many of the store's archetypes have been checked against it.
+    struct QueryCache {
+        std::vector<uint32_t> mArchetypes;
+        uint32_t mNumArchetypesChecked = 0;
+    };
+
+    template<typename... Components, typename Function>
+    static void ForEachInChunk(Archetype& archetype, EntityChunk& chunk, Function& function)
+    {
+        const Entity* entities = reinterpret_cast<const Entity*>(chunk.mData);
+        const std::tuple<Components*...> componentArrays(reinterpret_cast<Components*>(chunk.mData + archetype.mComponentOffsets[GetComponentType<Components>()])...);
+
+        for (uint32_t row = 0; row < chunk.mNumEntities; row++) {
+            if constexpr (std::is_invocable_v<Function&, Entity, Components&...>) {
+                function(entities[row], std::get<Components*>(componentArrays)[row]...);
+            } else {
+                function(std::get<Components*>(componentArrays)[row]...);
+            }
+        }
+    }
+
+    Entity CreateEntity(ComponentMask mask, bool constructComponents);
+    void* AddComponent(Entity entity, uint32_t componentType, void* component);
+    void RemoveComponent(Entity entity, uint32_t componentType);
+    ComponentMask GetEntityMask(Entity entity) const;
+    void* GetComponentPointer(Entity entity, uint32_t componentType) const;
+
+    uint32_t GetArchetype(ComponentMask mask);
+    const std::vector<uint32_t>& GetMatchingArchetypes(ComponentMask mask);
+    void AllocateRow(uint32_t archetypeIndex, uint32_t entityIndex);
+    void FreeRow(const EntityRecord& record);
+    void MoveToArchetype(uint32_t entityIndex, uint32_t archetypeIndex);
+
+    std::vector<std::unique_ptr<Archetype>> mArchetypes;
+    std::unordered_map<ComponentMask, uint32_t> mArchetypeOfMask;
+    std::unordered_map<ComponentMask, QueryCache> mQueryCaches;
+    std::vector<EntityRecord> mEntityRecords;
+    std::vector<uint32_t> mFreeEntityIndices;
+    size_t mNumEntities = 0;
+    // Structural changes would move entities under a running ForEach.
+    uint32_t mNumIterations = 0;
+    std::vector<std::pair<Archetype*, EntityChunk*>> mParallelChunks;
+    D3D12Lite::WorkerPool mWorkerPool;
+};
+
+// Structural changes recorded to be made later, typically from inside ForEach or ParallelForEach. Recording is thread
+// safe, commands from different threads are played back in the order they were recorded in.
+class EntityCommandBuffer {
+public:
+    EntityCommandBuffer() = default;
+    ~EntityCommandBuffer();
+
+    EntityCommandBuffer(const EntityCommandBuffer&) = delete;
+    EntityCommandBuffer& operator=(const EntityCommandBuffer&) = delete;
+
+    template<typename... Components>
+    void Create(Components... components)
+    {
+        std::lock_guard<std::mutex> lockGuard(mMutex);
+        mCommands.push_back(Command{ CommandType::create, Entity(), GetComponentMask<Components...>(), 0, nullptr });
+        (mCommands.push_back(Command{ CommandType::addToCreated, Entity(), 0, GetComponentType<Components>(), Store(std::move(components)) }), ...);
+    }
+
+    void Destroy(Entity entity);
+
+    template<typename T>
+    void Add(Entity entity, T component = T())
+    {
+        std::lock_guard<std::mutex> lockGuard(mMutex);
+        mCommands.push_back(Command{ CommandType::add, entity, 0, GetComponentType<T>(), Store(std::move(component)) });
+    }
+
+    template<typename T>
+    void Remove(Entity entity)
+    {
+        std::lock_guard<std::mutex> lockGuard(mMutex);
+        mCommands.push_back(Command{ CommandType::remove, entity, 0, GetComponentType<T>(), nullptr });
+    }
+
+    // Commands for entities destroyed in the meantime are dropped. Leaves the buffer empty.
+    void Playback(EntityStore& store);
+    bool IsEmpty() const { return mCommands.empty(); }
+
+private:
+    enum class CommandType : uint8_t {
+        create,
+        addToCreated,
+        destroy,
+        add,
+        remove
+    };
+
+    struct Command {
+        CommandType mType = CommandType::create;
+        Entity mEntity;
+        // Every component a created entity starts with, each of which follows in an addToCreated command.
+        ComponentMask mMask = 0;
+        uint32_t mComponentType = 0;
+        // The component to add, in mBlocks.
+        void* mComponent = nullptr;
+    };
+
+    template<typename T>
+    void* Store(T&& component)
+    {
+        void* storage = Allocate(sizeof(T), alignof(T));
+        new (storage) std::decay_t<T>(std::move(component));
+        return storage;
+    }
+
+    void* Allocate(size_t size, size_t alignment);
+    void Clear();
+
+    std::vector<Command> mCommands;
+    // Components are kept in blocks that never move, so types that aren't trivially relocatable are safe in them.
+    std::vector<std::unique_ptr<uint8_t[]>> mBlocks;
+    size_t mBlockUsed = COMMAND_BUFFER_BLOCK_SIZE;
+    std::mutex mMutex;
+};
@@ -1,2 +1,55 @@
 #include "GameObject.h"
-#include "Transform.h"
+#include "Scene.h"
+
+GameObject::GameObject()
+{
+}
+
+GameObject::GameObject(Scene& scene, Entity entity) : mScene(&scene), mEntity(entity)
+{
+}
+
+EntityStore& GameObject::GetEntities() const
+{
+	return mScene->GetEntities();
+}
+
+bool GameObject::IsValid() const
+{
+	return mScene && mScene->GetEntities().IsAlive(mEntity);
+}
+
+Entity GameObject::GetEntity() const
+{
+	return mEntity;
+}
+
+Scene* GameObject::GetScene() const
+{
+	return mScene;
+}
+
+Transform GameObject::GetTransform() const
+{
+	return Transform(mScene->GetTransforms(), GetComponent<TransformComponent>()->mTransformId);
+}
+
+GameObject GameObject::GetParent() const
+{
+	const uint32_t parentId = mScene->GetTransforms().GetParent(GetComponent<TransformComponent>()->mTransformId);
+
+	if (parentId == INVALID_TRANSFORM_ID)
+	{
+		return GameObject();
+	}
+
+	return mScene->GetGameObject(parentId);
+}
+
+void GameObject::SetParent(const GameObject& parent)
+{
+	assert(!parent.IsValid() || parent.mScene == mScene);
+
+	const uint32_t parentId = parent.IsValid() ? parent.GetComponent<TransformComponent>()->mTransformId : INVALID_TRANSFORM_ID;
+	mScene->GetTransforms().SetParent(GetComponent<TransformComponent>()->mTransformId, parentId);
+}
@@ -1,21 +1,56 @@
 #pragma once
-#include <iostream>
-#include <vector>
+#include <type_traits>
 #include "D3D12Lite.h"
+#include "EntityStore.h"
 #include "Transform.h"
 
+class Scene;
+
+// Handle to a game object's entity in a Scene. Copies refer to the same game object, and its components live in the
+// scene's EntityStore.
 class GameObject
 {
 private:
+	Scene* mScene = nullptr;
+	Entity mEntity;
 
-	Transform mTransform;
-	std::vector<GameObject*> mChildren;
+	EntityStore& GetEntities() const;
 
 public:
 	GameObject();
-	GameObject(Transform);
-	~GameObject();
+	GameObject(Scene& scene, Entity entity);
 
+	bool IsValid() const;
+	Entity GetEntity() const;
+	Scene* GetScene() const;
+	Transform GetTransform() const;
+	// Invalid for game objects at the root.
+	GameObject GetParent() const;
+	void SetParent(const GameObject& parent);
 
-};
+	template<typename T>
+	T& AddComponent(T component = T())
+	{
+		return GetEntities().Add<T>(mEntity, std::move(component));
+	}
+
+	template<typename T>
+	void RemoveComponent()
+	{
+		static_assert(!std::is_same_v<T, TransformComponent>, "Every game object keeps its transform");
+		GetEntities().Remove<T>(mEntity);
+	}
 
+	template<typename T>
+	bool HasComponent() const
+	{
+		return GetEntities().Has<T>(mEntity);
+	}
+
+	// Only valid until components are next added to or removed from any game object of the scene.
+	template<typename T>
+	T* GetComponent() const
+	{
+		return GetEntities().Get<T>(mEntity);
+	}
+};
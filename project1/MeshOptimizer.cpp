@@ -0,0 +1,370 @@
+#include "MeshOptimizer.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <vector>
+#include "ModelFile.h"
+
+namespace
+{
+    // Cache the Forsyth scores are tuned for, larger than the one we analyze with so the heuristic looks a bit further ahead.
+    constexpr uint32_t FORSYTH_CACHE_SIZE = 32;
+    constexpr float FORSYTH_CACHE_DECAY_POWER = 1.5f;
+    constexpr float FORSYTH_LAST_TRIANGLE_SCORE = 0.75f;
+    constexpr float FORSYTH_VALENCE_BOOST_SCALE = 2.0f;
+    constexpr float FORSYTH_VALENCE_BOOST_POWER = 0.5f;
+
+    float ScoreVertex(int32_t cachePosition, uint32_t numRemainingTriangles)
+    {
+        if (numRemainingTriangles == 0) {
+            return -1.0f;
+        }
+
+        float score = 0.0f;
+        if (cachePosition >= 0) {
+            // The triangle just emitted is in the first three slots, using those again doesn't add much.
+            if (cachePosition < 3) {
+                score = FORSYTH_LAST_TRIANGLE_SCORE;
+            }
+            else {
+                const float scale = 1.0f / (FORSYTH_CACHE_SIZE - 3);
+                score = std::pow(1.0f - (cachePosition - 3) * scale, FORSYTH_CACHE_DECAY_POWER);
+            }
+        }
+
+        // Vertices with few triangles left are finished off early so they don't linger as cache misses later.
+        score += FORSYTH_VALENCE_BOOST_SCALE * std::pow(static_cast<float>(numRemainingTriangles), -FORSYTH_VALENCE_BOOST_POWER);
+        return score;
+    }
+
+    // Counts transforms of the next triangle in a FIFO cache, kept as the time each vertex last entered it.
+    struct FifoCache
+    {
+        FifoCache(size_t numVertices, uint32_t cacheSize) : mTimestamps(numVertices, 0), mCacheSize(cacheSize), mTimestamp(cacheSize + 1) {}
+
+        uint32_t AddTriangle(const uint32_t* triangleIndices)
+        {
+            uint32_t numMisses = 0;
+            for (uint32_t k = 0; k < 3; k++) {
+                const uint32_t vertex = triangleIndices[k];
+                if (mTimestamp - mTimestamps[vertex] > mCacheSize) {
+                    mTimestamps[vertex] = mTimestamp++;
+                    numMisses++;
+                }
+            }
+            return numMisses;
+        }
+
+        void Reset() { mTimestamp += mCacheSize + 1; }
+
+        std::vector<uint32_t> mTimestamps;
+        uint32_t mCacheSize;
+        uint32_t mTimestamp;
+    };
+}
+
+VertexCacheStatistics AnalyzeVertexCache(const uint32_t* indices, size_t numIndices, size_t numVertices, uint32_t cacheSize)
+{
+    VertexCacheStatistics statistics;
+    if (numIndices < 3 || numVertices == 0) {
+        return statistics;
+    }
+
+    FifoCache cache(numVertices, cacheSize);
+    std::vector<uint8_t> isUsed(numVertices, 0);
+    size_t numUsedVertices = 0;
+
+    for (size_t i = 0; i + 2 < numIndices; i += 3) {
+        statistics.mNumTransformedVertices += cache.AddTriangle(indices + i);
+    }
+
+    for (size_t i = 0; i < numIndices; i++) {
+        numUsedVertices += isUsed[indices[i]] ? 0 : 1;
+        isUsed[indices[i]] = 1;
+    }
+
+    statistics.mACMR = static_cast<float>(statistics.mNumTransformedVertices) / static_cast<float>(numIndices / 3);
+    statistics.mATVR = static_cast<float>(statistics.mNumTransformedVertices) / static_cast<float>(numUsedVertices);
+    return statistics;
+}
+
+void OptimizeVertexCache(uint32_t* indices, size_t numIndices, size_t numVertices)
+{
+    const size_t numTriangles = numIndices / 3;
+    if (numTriangles == 0) {
+        return;
+    }
+
+    // Triangles still waiting to be emitted, per vertex. Emitted ones are swapped out of the end of each vertex's range.
+    std::vector<uint32_t> numVertexTriangles(numVertices, 0);
+    std::vector<uint32_t> vertexTriangleOffsets(numVertices, 0);
+    std::vector<uint32_t> vertexTriangles(numTriangles * 3);
+
+    for (size_t i = 0; i < numTriangles * 3; i++) {
+        numVertexTriangles[indices[i]]++;
+    }
+
+    uint32_t offset = 0;
+    for (size_t vertex = 0; vertex < numVertices; vertex++) {
+        vertexTriangleOffsets[vertex] = offset;
+        offset += numVertexTriangles[vertex];
+    }
+
+    std::vector<uint32_t> vertexTriangleCursors = vertexTriangleOffsets;
+    for (size_t i = 0; i < numTriangles * 3; i++) {
+        vertexTriangles[vertexTriangleCursors[indices[i]]++] = static_cast<uint32_t>(i / 3);
+    }
+
+    std::vector<int32_t> cachePositions(numVertices, -1);
+    std::vector<float> vertexScores(numVertices);
+    for (size_t vertex = 0; vertex < numVertices; vertex++) {
+        vertexScores[vertex] = ScoreVertex(-1, numVertexTriangles[vertex]);
+    }
+
+    std::vector<float> triangleScores(numTriangles);
+    for (size_t triangle = 0; triangle < numTriangles; triangle++) {
+        const uint32_t* triangleIndices = indices + triangle * 3;
+        triangleScores[triangle] = vertexScores[triangleIndices[0]] + vertexScores[triangleIndices[1]] + vertexScores[triangleIndices[2]];
+    }
+
+    std::vector<uint8_t> isTriangleEmitted(numTriangles, 0);
+    std::vector<uint32_t> output(numTriangles * 3);
+    std::array<uint32_t, FORSYTH_CACHE_SIZE + 3> cache;
+    std::array<uint32_t, FORSYTH_CACHE_SIZE + 3> newCache;
+    uint32_t cacheSize = 0;
+    size_t nextUnemittedTriangle = 0;
+    int64_t bestTriangle = -1;
+
+    for (size_t outputTriangle = 0; outputTriangle < numTriangles; outputTriangle++) {
+        // Nothing in the cache has triangles left, so restart from the first triangle not emitted yet. Scanning for the
+        // best score here instead would make the whole thing quadratic for a small gain.
+        if (bestTriangle < 0) {
+            while (isTriangleEmitted[nextUnemittedTriangle]) {
+                nextUnemittedTriangle++;
+            }
+            bestTriangle = static_cast<int64_t>(nextUnemittedTriangle);
+        }
+
+        const uint32_t triangle = static_cast<uint32_t>(bestTriangle);
+        const uint32_t* triangleIndices = indices + size_t(triangle) * 3;
+        isTriangleEmitted[triangle] = 1;
+        memcpy(output.data() + outputTriangle * 3, triangleIndices, 3 * sizeof(uint32_t));
+
+        for (uint32_t k = 0; k < 3; k++) {
+            const uint32_t vertex = triangleIndices[k];
+            uint32_t* triangles = vertexTriangles.data() + vertexTriangleOffsets[vertex];
+            const uint32_t numRemainingTriangles = numVertexTriangles[vertex];
+
+            for (uint32_t i = 0; i < numRemainingTriangles; i++) {
+                if (triangles[i] == triangle) {
+                    triangles[i] = triangles[numRemainingTriangles - 1];
+                    break;
+                }
+            }
+            numVertexTriangles[vertex]--;
+        }
+
+        // Move the triangle's vertices to the front of the LRU cache, anything pushed past its end drops out.
+        uint32_t newCacheSize = 0;
+        for (uint32_t k = 0; k < 3; k++) {
+            if (std::find(newCache.begin(), newCache.begin() + newCacheSize, triangleIndices[k]) == newCache.begin() + newCacheSize) {
+                newCache[newCacheSize++] = triangleIndices[k];
+            }
+        }
+
+        for (uint32_t i = 0; i < cacheSize; i++) {
+            const uint32_t vertex = cache[i];
+            if (vertex != triangleIndices[0] && vertex != triangleIndices[1] && vertex != triangleIndices[2]) {
+                newCache[newCacheSize++] = vertex;
+            }
+        }
+
+        // Rescore everything whose cache position changed and push the difference into its remaining triangles.
+        for (uint32_t i = 0; i < newCacheSize; i++) {
+            const uint32_t vertex = newCache[i];
+            cachePositions[vertex] = i < FORSYTH_CACHE_SIZE ? static_cast<int32_t>(i) : -1;
+
+            const float score = ScoreVertex(cachePositions[vertex], numVertexTriangles[vertex]);
+            const float scoreDelta = score - vertexScores[vertex];
+            vertexScores[vertex] = score;
+
+            const uint32_t* triangles = vertexTriangles.data() + vertexTriangleOffsets[vertex];
+            for (uint32_t j = 0; j < numVertexTriangles[vertex]; j++) {
+                triangleScores[triangles[j]] += scoreDelta;
+            }
+        }
+
+        // Only triangles touching the cache can have gained score, so the next one is picked among those.
+        bestTriangle = -1;
+        float bestScore = -1.0f;
+        cacheSize = (std::min)(newCacheSize, FORSYTH_CACHE_SIZE);
+
+        for (uint32_t i = 0; i < cacheSize; i++) {
+            const uint32_t vertex = newCache[i];
+            cache[i] = vertex;
+
+            const uint32_t* triangles = vertexTriangles.data() + vertexTriangleOffsets[vertex];
+            for (uint32_t j = 0; j < numVertexTriangles[vertex]; j++) {
+                if (triangleScores[triangles[j]] > bestScore) {
+                    bestScore = triangleScores[triangles[j]];
+                    bestTriangle = triangles[j];
+                }
+            }
+        }
+    }
+
+    memcpy(indices, output.data(), output.size() * sizeof(uint32_t));
+}
+
+void OptimizeOverdraw(uint32_t* indices, size_t numIndices, const ModelFileVertex* vertices, size_t numVertices, float threshold)
+{
+    const size_t numTriangles = numIndices / 3;
+    if (numTriangles == 0) {
+        return;
+    }
+
+    // Hard boundaries are where every vertex of a triangle misses, the cache order restarted there and cutting is free.
+    std::vector<uint32_t> hardClusters;
+    {
+        FifoCache cache(numVertices, VERTEX_CACHE_ANALYSIS_SIZE);
+        for (size_t triangle = 0; triangle < numTriangles; triangle++) {
+            if (cache.AddTriangle(indices + triangle * 3) == 3 || triangle == 0) {
+                hardClusters.push_back(static_cast<uint32_t>(triangle));
+            }
+        }
+    }
+
+    // Soft boundaries split a hard cluster further wherever the part before the cut already has an ACMR within
+    // threshold of the whole cluster's, the cache is cold again after every cut.
+    std::vector<uint32_t> clusters;
+    {
+        FifoCache cache(numVertices, VERTEX_CACHE_ANALYSIS_SIZE);
+        for (size_t clusterIndex = 0; clusterIndex < hardClusters.size(); clusterIndex++) {
+            const size_t start = hardClusters[clusterIndex];
+            const size_t end = clusterIndex + 1 < hardClusters.size() ? hardClusters[clusterIndex + 1] : numTriangles;
+
+            uint32_t clusterMisses = 0;
+            cache.Reset();
+            for (size_t triangle = start; triangle < end; triangle++) {
+                clusterMisses += cache.AddTriangle(indices + triangle * 3);
+            }
+
+            const float clusterThreshold = threshold * static_cast<float>(clusterMisses) / static_cast<float>(end - start);
+
+            size_t subStart = start;
+            uint32_t subMisses = 0;
+            clusters.push_back(static_cast<uint32_t>(start));
+            cache.Reset();
+
+            for (size_t triangle = start; triangle < end; triangle++) {
+                subMisses += cache.AddTriangle(indices + triangle * 3);
+
+                if (triangle + 1 < end && static_cast<float>(subMisses) / static_cast<float>(triangle + 1 - subStart) <= clusterThreshold) {
+                    clusters.push_back(static_cast<uint32_t>(triangle + 1));
+                    subStart = triangle + 1;
+                    subMisses = 0;
+                    cache.Reset();
+                }
+            }
+        }
+    }
+
+    // Area weighted centroid of the whole mesh, and of every cluster together with its average normal.
+    struct ClusterSortKey
+    {
+        float mKey = 0.0f;
+        uint32_t mCluster = 0;
+    };
+
+    std::vector<float> clusterData(clusters.size() * 7, 0.0f);
+    float meshCentroid[3] = {};
+    float meshArea = 0.0f;
+
+    for (size_t clusterIndex = 0; clusterIndex < clusters.size(); clusterIndex++) {
+        const size_t start = clusters[clusterIndex];
+        const size_t end = clusterIndex + 1 < clusters.size() ? clusters[clusterIndex + 1] : numTriangles;
+        float* data = clusterData.data() + clusterIndex * 7;
+
+        for (size_t triangle = start; triangle < end; triangle++) {
+            const float* p0 = vertices[indices[triangle * 3 + 0]].mPosition;
+            const float* p1 = vertices[indices[triangle * 3 + 1]].mPosition;
+            const float* p2 = vertices[indices[triangle * 3 + 2]].mPosition;
+
+            const float e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+            const float e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+            const float normal[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+            const float area = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+
+            for (uint32_t axis = 0; axis < 3; axis++) {
+                const float centroid = (p0[axis] + p1[axis] + p2[axis]) / 3.0f;
+                data[axis] += centroid * area;
+                data[3 + axis] += normal[axis];
+                meshCentroid[axis] += centroid * area;
+            }
+
+            data[6] += area;
+            meshArea += area;
+        }
+    }
+
+    if (meshArea > 0.0f) {
+        for (uint32_t axis = 0; axis < 3; axis++) {
+            meshCentroid[axis] /= meshArea;
+        }
+    }
+
+    // Clusters far out along their own normal tend to cover the rest of the mesh, so they are drawn first.
+    std::vector<ClusterSortKey> sortKeys(clusters.size());
+    for (size_t clusterIndex = 0; clusterIndex < clusters.size(); clusterIndex++) {
+        const float* data = clusterData.data() + clusterIndex * 7;
+        const float normalLength = std::sqrt(data[3] * data[3] + data[4] * data[4] + data[5] * data[5]);
+        float key = 0.0f;
+
+        if (data[6] > 0.0f && normalLength > 0.0f) {
+            for (uint32_t axis = 0; axis < 3; axis++) {
+                key += (data[axis] / data[6] - meshCentroid[axis]) * (data[3 + axis] / normalLength);
+            }
+        }
+
+        sortKeys[clusterIndex].mKey = key;
+        sortKeys[clusterIndex].mCluster = static_cast<uint32_t>(clusterIndex);
+    }
+
+    std::stable_sort(sortKeys.begin(), sortKeys.end(), [](const ClusterSortKey& a, const ClusterSortKey& b) { return a.mKey > b.mKey; });
+
+    std::vector<uint32_t> output;
+    output.reserve(numTriangles * 3);
+
+    for (const ClusterSortKey& sortKey : sortKeys) {
+        const size_t start = clusters[sortKey.mCluster];
+        const size_t end = sortKey.mCluster + 1 < clusters.size() ? clusters[sortKey.mCluster + 1] : numTriangles;
+        output.insert(output.end(), indices + start * 3, indices + end * 3);
+    }
+
+    memcpy(indices, output.data(), output.size() * sizeof(uint32_t));
+}
+
+uint32_t OptimizeVertexFetch(uint32_t* indices, size_t numIndices, ModelFileVertex* vertices, size_t numVertices)
+{
+    std::vector<uint32_t> remap(numVertices, UINT32_MAX);
+    uint32_t numUsedVertices = 0;
+
+    for (size_t i = 0; i < numIndices; i++) {
+        uint32_t& newIndex = remap[indices[i]];
+        if (newIndex == UINT32_MAX) {
+            newIndex = numUsedVertices++;
+        }
+        indices[i] = newIndex;
+    }
+
+    std::vector<ModelFileVertex> reordered(numUsedVertices);
+    for (size_t vertex = 0; vertex < numVertices; vertex++) {
+        if (remap[vertex] != UINT32_MAX) {
+            reordered[remap[vertex]] = vertices[vertex];
+        }
+    }
+
+    memcpy(vertices, reordered.data(), reordered.size() * sizeof(ModelFileVertex));
+    return numUsedVertices;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+struct ModelFileVertex;
+
+// FIFO size the statistics below are measured with, close to what current GPUs reuse post-transform.
+constexpr uint32_t VERTEX_CACHE_ANALYSIS_SIZE = 16;
+// How much worse than the vertex cache order the overdraw pass may make a cluster's ACMR.
+constexpr float OVERDRAW_CACHE_THRESHOLD = 1.05f;
+
+struct VertexCacheStatistics {
+    uint32_t mNumTransformedVertices = 0;
+    // Average cache miss ratio, vertex shader runs per triangle. 0.5 is the floor on a regular grid, 3 is no reuse at all.
+    float mACMR = 0.0f;
+    // Average transform to vertex ratio, vertex shader runs per unique vertex. 1 is ideal.
+    float mATVR = 0.0f;
+};
+
+// All of these work on triangle lists indexed from 0 up to numVertices.
+VertexCacheStatistics AnalyzeVertexCache(const uint32_t* indices, size_t numIndices, size_t numVertices, uint32_t cacheSize = VERTEX_CACHE_ANALYSIS_SIZE);
+
+// Reorders triangles for post-transform cache reuse with Tom Forsyth's linear-speed heuristic.
+void OptimizeVertexCache(uint32_t* indices, size_t numIndices, size_t numVertices);
+
+// Splits a cache optimized list into clusters at points where the cache restarts anyway, or where a cut costs less than
+// threshold times the cluster's ACMR, then puts clusters facing away from the mesh center first (Sander et al. 2007).
+void OptimizeOverdraw(uint32_t* indices, size_t numIndices, const ModelFileVertex* vertices, size_t numVertices, float threshold = OVERDRAW_CACHE_THRESHOLD);
+
+// Renumbers vertices in the order the index list first uses them and moves them to match, so fetches walk the vertex
+// buffer forwards. Unreferenced vertices are dropped, the new vertex count is returned.
+uint32_t OptimizeVertexFetch(uint32_t* indices, size_t numIndices, ModelFileVertex* vertices, size_t numVertices);
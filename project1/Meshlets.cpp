@@ -0,0 +1,260 @@
+#include "Meshlets.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cfloat>
+#include "ModelFile.h"
+
+namespace
+{
+    void FinishMeshlet(const ModelFileVertex* vertices, const uint32_t* meshletIndices, size_t numMeshletIndices, MeshletData& meshlets)
+    {
+        const uint32_t vertexOffset = meshlets.mVertexOffsets.back();
+        const uint32_t numVertices = meshlets.mVertexCounts.back();
+        const uint32_t* vertexIndices = meshlets.mVertexIndices.data() + vertexOffset;
+
+        // Sphere around the center of the bounding box, looser than a minimal one but good enough for culling.
+        float boundsMin[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+        float boundsMax[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+
+        for (uint32_t i = 0; i < numVertices; i++) {
+            const float* position = vertices[vertexIndices[i]].mPosition;
+            for (uint32_t axis = 0; axis < 3; axis++) {
+                boundsMin[axis] = (std::min)(boundsMin[axis], position[axis]);
+                boundsMax[axis] = (std::max)(boundsMax[axis], position[axis]);
+            }
+        }
+
+        const float center[3] = { (boundsMin[0] + boundsMax[0]) * 0.5f, (boundsMin[1] + boundsMax[1]) * 0.5f, (boundsMin[2] + boundsMax[2]) * 0.5f };
+        float radiusSquared = 0.0f;
+
+        for (uint32_t i = 0; i < numVertices; i++) {
+            const float* position = vertices[vertexIndices[i]].mPosition;
+            const float delta[3] = { position[0] - center[0], position[1] - center[1], position[2] - center[2] };
+            radiusSquared = (std::max)(radiusSquared, delta[0] * delta[0] + delta[1] * delta[1] + delta[2] * delta[2]);
+        }
+
+        meshlets.mBoundingSpheres.push_back(Vector4(center[0], center[1], center[2], std::sqrt(radiusSquared)));
+
+        // The cone axis is the average face normal, its width the largest angle any face normal makes with it.
+        std::vector<float> faceNormals(numMeshletIndices);
+        float axis[3] = {};
+
+        for (size_t i = 0; i < numMeshletIndices; i += 3) {
+            const float* p0 = vertices[meshletIndices[i + 0]].mPosition;
+            const float* p1 = vertices[meshletIndices[i + 1]].mPosition;
+            const float* p2 = vertices[meshletIndices[i + 2]].mPosition;
+
+            const float e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+            const float e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+            float* normal = faceNormals.data() + i;
+            normal[0] = e1[1] * e2[2] - e1[2] * e2[1];
+            normal[1] = e1[2] * e2[0] - e1[0] * e2[2];
+            normal[2] = e1[0] * e2[1] - e1[1] * e2[0];
+
+            const float length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+            const float inverseLength = length > 0.0f ? 1.0f / length : 0.0f;
+
+            for (uint32_t k = 0; k < 3; k++) {
+                normal[k] *= inverseLength;
+                axis[k] += normal[k];
+            }
+        }
+
+        const float axisLength = std::sqrt(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+        float minimumDot = 1.0f;
+
+        if (axisLength > 0.0f) {
+            for (uint32_t k = 0; k < 3; k++) {
+                axis[k] /= axisLength;
+            }
+
+            for (size_t i = 0; i < numMeshletIndices; i += 3) {
+                // Degenerate triangles have no normal and can't be seen from either side.
+                const float* normal = faceNormals.data() + i;
+                if (normal[0] != 0.0f || normal[1] != 0.0f || normal[2] != 0.0f) {
+                    minimumDot = (std::min)(minimumDot, normal[0] * axis[0] + normal[1] * axis[1] + normal[2] * axis[2]);
+                }
+            }
+        }
+        else {
+            minimumDot = -1.0f;
+        }
+
+        // Cones of 90 degrees or wider face the camera from some direction no matter where it is, so they never cull.
+        const float cutoff = minimumDot <= 0.0f ? 1.0f : std::sqrt(1.0f - minimumDot * minimumDot);
+        meshlets.mNormalCones.push_back(Vector4(axis[0], axis[1], axis[2], cutoff));
+    }
+}
+
+void BuildMeshlets(const ModelFileVertex* vertices, size_t numVertices, const uint32_t* indices, const ModelFileMesh* meshes, size_t numMeshes,
+    MeshletData& meshlets, MeshletBuildStatistics* statistics)
+{
+    const auto startTime = std::chrono::steady_clock::now();
+
+    meshlets = MeshletData();
+
+    // Where each vertex sits in the meshlet being filled, 0xff when it isn't in it.
+    std::vector<uint8_t> meshletVertexSlots(numVertices, 0xff);
+    std::vector<uint32_t> meshletIndices;
+    meshletIndices.reserve(MAX_MESHLET_TRIANGLES * 3);
+
+    auto finishMeshlet = [&]() {
+        FinishMeshlet(vertices, meshletIndices.data(), meshletIndices.size(), meshlets);
+
+        for (uint32_t i = 0; i < meshlets.mVertexCounts.back(); i++) {
+            meshletVertexSlots[meshlets.mVertexIndices[meshlets.mVertexOffsets.back() + i]] = 0xff;
+        }
+        meshletIndices.clear();
+    };
+
+    auto startMeshlet = [&meshlets]() {
+        meshlets.mVertexOffsets.push_back(static_cast<uint32_t>(meshlets.mVertexIndices.size()));
+        meshlets.mVertexCounts.push_back(0);
+        meshlets.mTriangleOffsets.push_back(static_cast<uint32_t>(meshlets.mTriangles.size()));
+        meshlets.mTriangleCounts.push_back(0);
+    };
+
+    for (size_t meshIndex = 0; meshIndex < numMeshes; meshIndex++) {
+        const ModelFileMesh& mesh = meshes[meshIndex];
+        if (mesh.mNumIndices == 0) {
+            continue;
+        }
+
+        startMeshlet();
+
+        for (uint32_t i = mesh.mFirstIndex; i < mesh.mFirstIndex + mesh.mNumIndices; i += 3) {
+            const uint32_t* triangleIndices = indices + i;
+            uint32_t numNewVertices = 0;
+
+            for (uint32_t k = 0; k < 3; k++) {
+                const bool isRepeat = (k > 0 && triangleIndices[k] == triangleIndices[0]) || (k > 1 && triangleIndices[k] == triangleIndices[1]);
+                numNewVertices += (meshletVertexSlots[triangleIndices[k]] == 0xff && !isRepeat) ? 1 : 0;
+            }
+
+            if (meshlets.mVertexCounts.back() + numNewVertices > MAX_MESHLET_VERTICES || meshlets.mTriangleCounts.back() == MAX_MESHLET_TRIANGLES) {
+                finishMeshlet();
+                startMeshlet();
+            }
+
+            uint32_t packedTriangle = 0;
+            for (uint32_t k = 0; k < 3; k++) {
+                uint8_t& slot = meshletVertexSlots[triangleIndices[k]];
+                if (slot == 0xff) {
+                    slot = static_cast<uint8_t>(meshlets.mVertexCounts.back()++);
+                    meshlets.mVertexIndices.push_back(triangleIndices[k]);
+                }
+
+                packedTriangle |= uint32_t(slot) << (k * 8);
+                meshletIndices.push_back(triangleIndices[k]);
+            }
+
+            meshlets.mTriangles.push_back(packedTriangle);
+            meshlets.mTriangleCounts.back()++;
+        }
+
+        finishMeshlet();
+    }
+
+    if (statistics) {
+        *statistics = MeshletBuildStatistics();
+        statistics->mNumMeshlets = static_cast<uint32_t>(meshlets.GetNumMeshlets());
+
+        if (statistics->mNumMeshlets > 0) {
+            statistics->mVertexFillRate = static_cast<float>(meshlets.mVertexIndices.size()) / static_cast<float>(statistics->mNumMeshlets * MAX_MESHLET_VERTICES);
+            statistics->mTriangleFillRate = static_cast<float>(meshlets.mTriangles.size()) / static_cast<float>(statistics->mNumMeshlets * MAX_MESHLET_TRIANGLES);
+        }
+
+        statistics->mBuildMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+    }
+}
+
+MeshletCuller::MeshletCuller(uint32_t numThreads)
+    : mWorkerPool(numThreads)
+{
+}
+
+void MeshletCuller::Cull(const MeshletData& meshlets, const Matrix& worldViewProjection, const Vector3& cameraPosition, std::vector<uint32_t>& visibleMeshlets)
+{
+    const auto startTime = std::chrono::steady_clock::now();
+    const uint32_t numMeshlets = static_cast<uint32_t>(meshlets.GetNumMeshlets());
+
+    // Frustum planes pulled out of the matrix columns (Gribb and Hartmann), for row vectors and a 0 to 1 depth range.
+    const float(&m)[4][4] = worldViewProjection.m;
+    float planes[6][4];
+
+    for (uint32_t i = 0; i < 4; i++) {
+        planes[0][i] = m[i][3] + m[i][0];
+        planes[1][i] = m[i][3] - m[i][0];
+        planes[2][i] = m[i][3] + m[i][1];
+        planes[3][i] = m[i][3] - m[i][1];
+        planes[4][i] = m[i][2];
+        planes[5][i] = m[i][3] - m[i][2];
+    }
+
+    for (auto& plane : planes) {
+        const float length = std::sqrt(plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2]);
+        for (float& component : plane) {
+            component /= length;
+        }
+    }
+
+    const uint32_t numBatches = (numMeshlets + MESHLET_CULLING_BATCH_SIZE - 1) / MESHLET_CULLING_BATCH_SIZE;
+    mBatches.resize(numBatches);
+
+    for (uint32_t batchIndex = 0; batchIndex < numBatches; batchIndex++) {
+        mWorkerPool.AddJob([this, &meshlets, &planes, cameraPosition, batchIndex, numMeshlets]() {
+            CullingBatch& batch = mBatches[batchIndex];
+            batch.mVisibleMeshlets.clear();
+            batch.mNumFrustumCulled = 0;
+            batch.mNumBackfaceCulled = 0;
+
+            const uint32_t end = (std::min)((batchIndex + 1) * MESHLET_CULLING_BATCH_SIZE, numMeshlets);
+
+            for (uint32_t meshletIndex = batchIndex * MESHLET_CULLING_BATCH_SIZE; meshletIndex < end; meshletIndex++) {
+                const Vector4& sphere = meshlets.mBoundingSpheres[meshletIndex];
+                bool isInFrustum = true;
+
+                for (const auto& plane : planes) {
+                    if (plane[0] * sphere.x + plane[1] * sphere.y + plane[2] * sphere.z + plane[3] < -sphere.w) {
+                        isInFrustum = false;
+                        break;
+                    }
+                }
+
+                if (!isInFrustum) {
+                    batch.mNumFrustumCulled++;
+                    continue;
+                }
+
+                // Every triangle faces away when the camera sits inside the cone mirrored behind the sphere.
+                const Vector4& cone = meshlets.mNormalCones[meshletIndex];
+                const float toCenter[3] = { sphere.x - cameraPosition.x, sphere.y - cameraPosition.y, sphere.z - cameraPosition.z };
+                const float distance = std::sqrt(toCenter[0] * toCenter[0] + toCenter[1] * toCenter[1] + toCenter[2] * toCenter[2]);
+
+                if (toCenter[0] * cone.x + toCenter[1] * cone.y + toCenter[2] * cone.z >= cone.w * distance + sphere.w) {
+                    batch.mNumBackfaceCulled++;
+                    continue;
+                }
+
+                batch.mVisibleMeshlets.push_back(meshletIndex);
+            }
+        });
+    }
+
+    mWorkerPool.WaitForIdle();
+
+    mStatistics = MeshletCullingStatistics();
+    mStatistics.mNumMeshlets = numMeshlets;
+    visibleMeshlets.clear();
+
+    for (const CullingBatch& batch : mBatches) {
+        visibleMeshlets.insert(visibleMeshlets.end(), batch.mVisibleMeshlets.begin(), batch.mVisibleMeshlets.end());
+        mStatistics.mNumFrustumCulled += batch.mNumFrustumCulled;
+        mStatistics.mNumBackfaceCulled += batch.mNumBackfaceCulled;
+    }
+
+    mStatistics.mNumVisible = static_cast<uint32_t>(visibleMeshlets.size());
+    mStatistics.mCullMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+    mStatistics.mMeshletsPerSecond = mStatistics.mCullMilliseconds > 0.0 ? numMeshlets / (mStatistics.mCullMilliseconds * 0.001) : 0.0;
+}
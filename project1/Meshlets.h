@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+// SimpleMath only builds with d3d12.h included before it.
+#include <d3d12.h>
+#include "SimpleMath/SimpleMath.h"
+#include "D3D12LiteWorkerPool.h"
+
+using namespace DirectX::SimpleMath;
+
+struct ModelFileVertex;
+struct ModelFileMesh;
+
+// Meshlet limits, well inside what D3D12 mesh shaders allow and sized so one meshlet is a wave's worth of vertex work.
+constexpr uint32_t MAX_MESHLET_VERTICES = 64;
+constexpr uint32_t MAX_MESHLET_TRIANGLES = 124;
+// Meshlets one culling job handles.
+constexpr uint32_t MESHLET_CULLING_BATCH_SIZE = 1024;
+
+// Meshlets of a model in structure of arrays form, every per-meshlet array has one entry per meshlet and can be uploaded
+// as a structured buffer without repacking.
+struct MeshletData {
+    // Range of mVertexIndices, which index the model's vertex buffer.
+    std::vector<uint32_t> mVertexOffsets;
+    std::vector<uint32_t> mVertexCounts;
+    // Range of mTriangles, each holding three 8 bit indices into the meshlet's vertices.
+    std::vector<uint32_t> mTriangleOffsets;
+    std::vector<uint32_t> mTriangleCounts;
+    // xyz center, w radius.
+    std::vector<Vector4> mBoundingSpheres;
+    // xyz axis the triangle normals are around, w the sine of the cone's half angle, 1 for meshlets that can't be cone culled.
+    std::vector<Vector4> mNormalCones;
+
+    std::vector<uint32_t> mVertexIndices;
+    std::vector<uint32_t> mTriangles;
+
+    size_t GetNumMeshlets() const { return mVertexOffsets.size(); }
+};
+
+struct MeshletBuildStatistics {
+    uint32_t mNumMeshlets = 0;
+    // Average share of MAX_MESHLET_VERTICES and MAX_MESHLET_TRIANGLES a meshlet uses.
+    float mVertexFillRate = 0.0f;
+    float mTriangleFillRate = 0.0f;
+    double mBuildMilliseconds = 0.0;
+};
+
+// Splits every mesh into meshlets by walking its triangles in index order, so it works best on a list that has been
+// through OptimizeVertexCache. Meshlets never span meshes.
+void BuildMeshlets(const ModelFileVertex* vertices, size_t numVertices, const uint32_t* indices, const ModelFileMesh* meshes, size_t numMeshes,
+    MeshletData& meshlets, MeshletBuildStatistics* statistics = nullptr);
+
+struct MeshletCullingStatistics {
+    uint32_t mNumMeshlets = 0;
+    uint32_t mNumFrustumCulled = 0;
+    uint32_t mNumBackfaceCulled = 0;
+    uint32_t mNumVisible = 0;
+    double mCullMilliseconds = 0.0;
+    double mMeshletsPerSecond = 0.0;
+};
+
+// Reference implementation of the per-meshlet tests a GPU culling pass would run, spread over its own worker threads.
+class MeshletCuller {
+public:
+    MeshletCuller(uint32_t numThreads);
+
+    // worldViewProjection takes the model's object space to clip space, cameraPosition is in object space. The visible
+    // meshlets come out in ascending order.
+    void Cull(const MeshletData& meshlets, const Matrix& worldViewProjection, const Vector3& cameraPosition, std::vector<uint32_t>& visibleMeshlets);
+
+    const MeshletCullingStatistics& GetStatistics() const { return mStatistics; }
+
+private:
+    struct CullingBatch {
+        std::vector<uint32_t> mVisibleMeshlets;
+        uint32_t mNumFrustumCulled = 0;
+        uint32_t mNumBackfaceCulled = 0;
+    };
+
+    D3D12Lite::WorkerPool mWorkerPool;
+    std::vector<CullingBatch> mBatches;
+    MeshletCullingStatistics mStatistics;
+};
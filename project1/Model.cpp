@@ -2,18 +2,35 @@
 #include <stdexcept>
 #include <fstream>
 #include <iostream>
+#include <chrono>
 #include "D3D12Lite.h"
 #include <d3d12.h>
-#include "assimp/Importer.hpp"
-#include "assimp/scene.h"
-#include "assimp/postprocess.h"
+
+using namespace D3D12Lite;
 
 Model::Model() {}
 
-Model::~Model() {}
+Model::~Model()
+{
+    if (mDevice) {
+        if (mVertexBuffer) {
+            mDevice->DestroyBuffer(std::move(mVertexBuffer));
+        }
+
+        if (mIndexBuffer) {
+            mDevice->DestroyBuffer(std::move(mIndexBuffer));
+        }
+
+        if (mTexture) {
+            mDevice->DestroyTexture(std::move(mTexture));
+        }
+    }
+}
 
-bool Model::LoadFromFile(const std::string& filePath, ID3D12Device* device, ID3D12GraphicsCommandList* commandList)
+bool Model::LoadFromFile(const std::string& filePath, Device& device)
 {
+    mDevice = &device;
+
     // ޽  ε
     if (!LoadMesh(filePath)) {
         std::cerr << "Failed to load mesh from file: " << filePath << std::endl;
@@ -21,14 +38,17 @@ bool Model::LoadFromFile(const std::string& filePath, ID3D12Device* device, ID3D
     }
 
     // DirectX 12  
-    if (!CreateBuffers(device, commandList)) {
+    if (!CreateBuffers(device)) {
         std::cerr << "Failed to create DirectX 12 buffers." << std::endl;
         return false;
     }
 
+    // The uploads hold their own reference to the mapping, so the file is unmapped as soon as it has been staged.
+    mModelFile = ModelFile();
+
     // ؽó ε ( ؽó  )
     std::string texturePath = "path/to/texture.png"; // ʿ信  
-    if (!LoadTexture(texturePath, device, commandList)) {
+    if (!LoadTexture(texturePath, device)) {
         std::cerr << "Failed to load texture from file: " << texturePath << std::endl;
         return false;
     }
@@ -38,91 +58,84 @@ bool Model::LoadFromFile(const std::string& filePath, ID3D12Device* device, ID3D
 
 bool Model::LoadMesh(const std::string& filePath)
 {
-    Assimp::Importer importer;
-    const aiScene* scene = importer.ReadFile(filePath, aiProcess_Triangulate | aiProcess_JoinIdenticalVertices | aiProcess_GenSmoothNormals);
+    const auto startTime = std::chrono::steady_clock::now();
+    const std::string cookedPath = filePath + MODEL_FILE_EXTENSION;
+    mLoadStatistics = ModelLoadStatistics{};
+
+    // Assimp only runs when there is no cooked file next to the source yet, or the source changed since it was cooked.
+    if (!mModelFile.Open(cookedPath, filePath)) {
+        if (!CookModelFile(filePath, cookedPath, &mLoadStatistics.mCook) || !mModelFile.Open(cookedPath)) {
+            return false;
+        }
 
-    if (!scene || !scene->mRootNode || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE) {
-        std::cerr << "Assimp error: " << importer.GetErrorString() << std::endl;
-        return false;
+        mLoadStatistics.mWasCooked = true;
     }
 
-    aiMesh* mesh = scene->mMeshes[0]; // ù ° ޽ ε
-    for (unsigned int i = 0; i < mesh->mNumVertices; i++) {
-        Vertex vertex;
-        vertex.Position = { mesh->mVertices[i].x, mesh->mVertices[i].y, mesh->mVertices[i].z };
-        vertex.Normal = { mesh->mNormals[i].x, mesh->mNormals[i].y, mesh->mNormals[i].z };
-        if (mesh->mTextureCoords[0]) {
-            vertex.TexCoord = { mesh->mTextureCoords[0][i].x, mesh->mTextureCoords[0][i].y };
-        }
-        else {
-            vertex.TexCoord = { 0.0f, 0.0f };
-        }
-        mVertices.push_back(vertex);
-    }
+    const ModelFileHeader& header = mModelFile.GetHeader();
+    const Vertex* vertices = reinterpret_cast<const Vertex*>(mModelFile.GetVertices());
+    mVertices.assign(vertices, vertices + header.mNumVertices);
+    mIndices.assign(mModelFile.GetIndices(), mModelFile.GetIndices() + header.mNumIndices);
+    mMeshes.assign(mModelFile.GetMeshes(), mModelFile.GetMeshes() + header.mNumMeshes);
+    mBounds = header.mBounds;
 
-    for (unsigned int i = 0; i < mesh->mNumFaces; i++) {
-        aiFace face = mesh->mFaces[i];
-        for (unsigned int j = 0; j < face.mNumIndices; j++) {
-            mIndices.push_back(face.mIndices[j]);
-        }
-    }
+    BuildMeshlets(mModelFile.GetVertices(), header.mNumVertices, mIndices.data(), mMeshes.data(), mMeshes.size(), mMeshlets, &mLoadStatistics.mMeshlets);
+
+    mLoadStatistics.mLoadMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
 
     return true;
 }
 
-bool Model::CreateBuffers(ID3D12Device* device, ID3D12GraphicsCommandList* commandList)
+bool Model::CreateBuffers(Device& device)
 {
+    if (mVertices.empty() || mIndices.empty()) {
+        return false;
+    }
+
     // Vertex Buffer
-    const UINT vertexBufferSize = static_cast<UINT>(mVertices.size() * sizeof(Vertex));
-    ThrowIfFailed(device->CreateCommittedResource(
-        &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
-        D3D12_HEAP_FLAG_NONE,
-        &CD3DX12_RESOURCE_DESC::Buffer(vertexBufferSize),
-        D3D12_RESOURCE_STATE_GENERIC_READ,
-        nullptr,
-        IID_PPV_ARGS(&mVertexBuffer)));
-
-    void* pVertexData = nullptr;
-    ThrowIfFailed(mVertexBuffer->Map(0, nullptr, &pVertexData));
-    memcpy(pVertexData, mVertices.data(), vertexBufferSize);
-    mVertexBuffer->Unmap(0, nullptr);
-
-    mVertexBufferView.BufferLocation = mVertexBuffer->GetGPUVirtualAddress();
-    mVertexBufferView.SizeInBytes = vertexBufferSize;
-    mVertexBufferView.StrideInBytes = sizeof(Vertex);
+    BufferCreationDesc vertexBufferDesc{};
+    vertexBufferDesc.mSize = static_cast<uint32_t>(mVertices.size() * sizeof(Vertex));
+    vertexBufferDesc.mAccessFlags = BufferAccessFlags::gpuOnly;
+    vertexBufferDesc.mViewFlags = BufferViewFlags::srv;
+    vertexBufferDesc.mStride = sizeof(Vertex);
+    vertexBufferDesc.mIsRawAccess = true;
+
+    mVertexBuffer = device.CreateBuffer(vertexBufferDesc);
 
     // Index Buffer
-    const UINT indexBufferSize = static_cast<UINT>(mIndices.size() * sizeof(uint32_t));
-    ThrowIfFailed(device->CreateCommittedResource(
-        &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
-        D3D12_HEAP_FLAG_NONE,
-        &CD3DX12_RESOURCE_DESC::Buffer(indexBufferSize),
-        D3D12_RESOURCE_STATE_GENERIC_READ,
-        nullptr,
-        IID_PPV_ARGS(&mIndexBuffer)));
-
-    void* pIndexData = nullptr;
-    ThrowIfFailed(mIndexBuffer->Map(0, nullptr, &pIndexData));
-    memcpy(pIndexData, mIndices.data(), indexBufferSize);
-    mIndexBuffer->Unmap(0, nullptr);
-
-    mIndexBufferView.BufferLocation = mIndexBuffer->GetGPUVirtualAddress();
-    mIndexBufferView.SizeInBytes = indexBufferSize;
-    mIndexBufferView.Format = DXGI_FORMAT_R32_UINT;
+    BufferCreationDesc indexBufferDesc{};
+    indexBufferDesc.mSize = static_cast<uint32_t>(mIndices.size() * sizeof(uint32_t));
+    indexBufferDesc.mAccessFlags = BufferAccessFlags::gpuOnly;
+    indexBufferDesc.mStride = sizeof(uint32_t);
+
+    mIndexBuffer = device.CreateBuffer(indexBufferDesc);
+
+    // Both streams are staged straight out of the mapped cooked file, the uploads keep the mapping alive until then.
+    auto addUpload = [this, &device](BufferResource* buffer, const void* data, size_t dataSize) {
+        auto bufferUpload = std::make_unique<BufferUpload>();
+        bufferUpload->mBuffer = buffer;
+        bufferUpload->mSourceOwner = mModelFile.GetMappedFile();
+        bufferUpload->mSourceData = static_cast<const uint8_t*>(data);
+        bufferUpload->mBufferDataSize = dataSize;
+
+        device.GetUploadContextForCurrentFrame().AddBufferUpload(std::move(bufferUpload));
+    };
+
+    addUpload(mVertexBuffer.get(), mModelFile.GetVertices(), vertexBufferDesc.mSize);
+    addUpload(mIndexBuffer.get(), mModelFile.GetIndices(), indexBufferDesc.mSize);
 
     return true;
 }
 
-bool Model::LoadTexture(const std::string& texturePath, ID3D12Device* device, ID3D12GraphicsCommandList* commandList)
+bool Model::LoadTexture(const std::string& texturePath, Device& device)
 {
     // ؽó ε  (̺귯  , : DirectXTK)
     //  Լ ؽó ε  ID3D12Resource   մϴ.
     return true;
 }
 
-void Model::Render(ID3D12GraphicsCommandList* commandList)
+void Model::Render(GraphicsContext& context)
 {
-    commandList->IASetVertexBuffers(0, 1, &mVertexBufferView);
-    commandList->IASetIndexBuffer(&mIndexBufferView);
-    commandList->DrawIndexedInstanced(static_cast<UINT>(mIndices.size()), 1, 0, 0, 0);
+    // Indices are absolute into the one vertex buffer, so all meshes go out in a single draw.
+    context.SetIndexBuffer(*mIndexBuffer);
+    context.DrawIndexed(static_cast<uint32_t>(mIndices.size()));
 }
@@ -1,5 +1,4 @@
 #pragma once
-#pragma once
 
 #include <d3d12.h>
 #include <DirectXMath.h>
@@ -7,15 +6,29 @@
 #include <vector>
 #include <string>
 #include <memory>
+#include "D3D12Lite.h"
+#include "ModelFile.h"
+#include "Meshlets.h"
 
 // DirectX  Microsoft ӽ̽
 using namespace Microsoft::WRL;
 using namespace DirectX;
 
+// Same layout as MeshVertex in Shaders/Shared.h and the vertex stream of a cooked model file.
 struct Vertex {
     XMFLOAT3 Position;
-    XMFLOAT3 Normal;
     XMFLOAT2 TexCoord;
+    XMFLOAT3 Normal;
+};
+
+static_assert(sizeof(Vertex) == sizeof(ModelFileVertex), "Vertex has to match the cooked vertex stream");
+
+struct ModelLoadStatistics {
+    // Set when the cooked file was missing or stale and Assimp had to run first.
+    bool mWasCooked = false;
+    ModelCookStatistics mCook;
+    MeshletBuildStatistics mMeshlets;
+    double mLoadMilliseconds = 0.0;
 };
 
 class Model {
@@ -23,24 +36,36 @@ public:
     Model();
     ~Model();
 
-    bool LoadFromFile(const std::string& filePath, ID3D12Device* device, ID3D12GraphicsCommandList* commandList);
-    void Render(ID3D12GraphicsCommandList* commandList);
+    bool LoadFromFile(const std::string& filePath, D3D12Lite::Device& device);
+
+    // Binds the index buffer and draws every mesh, the vertex buffer is fetched bindlessly through GetVertexBuffer's descriptor.
+    void Render(D3D12Lite::GraphicsContext& context);
+
+    bool IsReady() const { return mVertexBuffer && mVertexBuffer->mIsReady && mIndexBuffer->mIsReady; }
+    const D3D12Lite::BufferResource* GetVertexBuffer() const { return mVertexBuffer.get(); }
+    const std::vector<ModelFileMesh>& GetMeshes() const { return mMeshes; }
+    const MeshletData& GetMeshlets() const { return mMeshlets; }
+    const ModelFileBounds& GetBounds() const { return mBounds; }
+    const ModelLoadStatistics& GetLoadStatistics() const { return mLoadStatistics; }
 
 private:
     // ޽ 
     std::vector<Vertex> mVertices;
     std::vector<uint32_t> mIndices;
+    std::vector<ModelFileMesh> mMeshes;
+    MeshletData mMeshlets;
+    ModelFileBounds mBounds{};
+    ModelFile mModelFile;
+    ModelLoadStatistics mLoadStatistics;
 
     // DirectX 12 ҽ
-    ComPtr<ID3D12Resource> mVertexBuffer;
-    ComPtr<ID3D12Resource> mIndexBuffer;
-    ComPtr<ID3D12Resource> mTexture;
-
-    D3D12_VERTEX_BUFFER_VIEW mVertexBufferView;
-    D3D12_INDEX_BUFFER_VIEW mIndexBufferView;
+    D3D12Lite::Device* mDevice = nullptr;
+    std::unique_ptr<D3D12Lite::BufferResource> mVertexBuffer;
+    std::unique_ptr<D3D12Lite::BufferResource> mIndexBuffer;
+    std::unique_ptr<D3D12Lite::TextureResource> mTexture;
 
     // ε  Լ
     bool LoadMesh(const std::string& filePath);
-    bool CreateBuffers(ID3D12Device* device, ID3D12GraphicsCommandList* commandList);
-    bool LoadTexture(const std::string& texturePath, ID3D12Device* device, ID3D12GraphicsCommandList* commandList);
+    bool CreateBuffers(D3D12Lite::Device& device);
+    bool LoadTexture(const std::string& texturePath, D3D12Lite::Device& device);
 };
@@ -0,0 +1,300 @@
+#include "ModelFile.h"
+#include <cfloat>
+#include <cmath>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <vector>
+#include "D3D12Lite.h"
+#include "assimp/Importer.hpp"
+#include "assimp/scene.h"
+#include "assimp/postprocess.h"
+
+namespace
+{
+    uint64_t AlignOffset(uint64_t offset)
+    {
+        return (offset + MODEL_FILE_ALIGNMENT - 1) & ~uint64_t(MODEL_FILE_ALIGNMENT - 1);
+    }
+
+    bool GetSourceStamp(const std::string& sourcePath, uint64_t& sourceSize, int64_t& sourceWriteTime)
+    {
+        std::error_code error;
+        sourceSize = std::filesystem::file_size(sourcePath, error);
+        if (error) {
+            return false;
+        }
+
+        sourceWriteTime = static_cast<int64_t>(std::filesystem::last_write_time(sourcePath, error).time_since_epoch().count());
+        return !error;
+    }
+
+    // Every mesh has to lie inside the shared streams and only index its own vertices, the vertex fetch reads whatever the
+    // index points at with no bounds check on the GPU.
+    bool ValidateMeshes(const ModelFileHeader& header, const ModelFileMesh* meshes, const uint32_t* indices)
+    {
+        for (uint32_t meshIndex = 0; meshIndex < header.mNumMeshes; meshIndex++) {
+            const ModelFileMesh& mesh = meshes[meshIndex];
+
+            if (uint64_t(mesh.mFirstIndex) + mesh.mNumIndices > header.mNumIndices || mesh.mNumIndices % 3 != 0
+                || uint64_t(mesh.mFirstVertex) + mesh.mNumVertices > header.mNumVertices) {
+                return false;
+            }
+
+            for (uint32_t i = mesh.mFirstIndex; i < mesh.mFirstIndex + mesh.mNumIndices; i++) {
+                if (indices[i] < mesh.mFirstVertex || indices[i] - mesh.mFirstVertex >= mesh.mNumVertices) {
+                    return false;
+                }
+            }
+        }
+
+        return true;
+    }
+
+    ModelFileBounds ComputeBounds(const ModelFileVertex* vertices, size_t numVertices)
+    {
+        ModelFileBounds bounds{};
+        if (numVertices == 0) {
+            return bounds;
+        }
+
+        for (uint32_t axis = 0; axis < 3; axis++) {
+            bounds.mMin[axis] = FLT_MAX;
+            bounds.mMax[axis] = -FLT_MAX;
+        }
+
+        for (size_t vertexIndex = 0; vertexIndex < numVertices; vertexIndex++) {
+            for (uint32_t axis = 0; axis < 3; axis++) {
+                bounds.mMin[axis] = (std::min)(bounds.mMin[axis], vertices[vertexIndex].mPosition[axis]);
+                bounds.mMax[axis] = (std::max)(bounds.mMax[axis], vertices[vertexIndex].mPosition[axis]);
+            }
+        }
+
+        // The sphere is centered on the box, which is a little looser than a minimal sphere but costs one pass.
+        float radiusSquared = 0.0f;
+        for (uint32_t axis = 0; axis < 3; axis++) {
+            bounds.mSphereCenter[axis] = (bounds.mMin[axis] + bounds.mMax[axis]) * 0.5f;
+        }
+
+        for (size_t vertexIndex = 0; vertexIndex < numVertices; vertexIndex++) {
+            float distanceSquared = 0.0f;
+            for (uint32_t axis = 0; axis < 3; axis++) {
+                const float delta = vertices[vertexIndex].mPosition[axis] - bounds.mSphereCenter[axis];
+                distanceSquared += delta * delta;
+            }
+            radiusSquared = (std::max)(radiusSquared, distanceSquared);
+        }
+
+        bounds.mSphereRadius = std::sqrt(radiusSquared);
+        return bounds;
+    }
+}
+
+bool CookModelFile(const std::string& sourcePath, const std::string& cookedPath, ModelCookStatistics* statistics)
+{
+    const auto startTime = std::chrono::steady_clock::now();
+
+    ModelFileHeader header{};
+    if (!GetSourceStamp(sourcePath, header.mSourceSize, header.mSourceWriteTime)) {
+        std::cerr << "Model source not found: " << sourcePath << std::endl;
+        return false;
+    }
+
+    Assimp::Importer importer;
+    const aiScene* scene = importer.ReadFile(sourcePath, aiProcess_Triangulate | aiProcess_JoinIdenticalVertices | aiProcess_GenSmoothNormals | aiProcess_SortByPType);
+
+    if (!scene || !scene->mRootNode || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE) {
+        std::cerr << "Assimp error: " << importer.GetErrorString() << std::endl;
+        return false;
+    }
+
+    const auto importTime = std::chrono::steady_clock::now();
+
+    // SortByPType leaves every mesh with a single primitive type, points and lines are dropped here.
+    size_t totalVertices = 0;
+    size_t totalIndices = 0;
+    for (unsigned int meshIndex = 0; meshIndex < scene->mNumMeshes; meshIndex++) {
+        const aiMesh* mesh = scene->mMeshes[meshIndex];
+        if (mesh->mPrimitiveTypes == aiPrimitiveType_TRIANGLE) {
+            totalVertices += mesh->mNumVertices;
+            totalIndices += size_t(mesh->mNumFaces) * 3;
+        }
+    }
+
+    if (totalVertices > UINT32_MAX || totalIndices > UINT32_MAX) {
+        std::cerr << "Model is too large for 32 bit indices: " << sourcePath << std::endl;
+        return false;
+    }
+
+    std::vector<ModelFileMesh> meshes;
+    std::vector<ModelFileVertex> vertices(totalVertices);
+    std::vector<uint32_t> indices(totalIndices);
+    uint32_t numVertices = 0;
+    uint32_t numIndices = 0;
+    double optimizeMilliseconds = 0.0;
+
+    if (statistics) {
+        statistics->mMeshes.clear();
+    }
+
+    for (unsigned int meshIndex = 0; meshIndex < scene->mNumMeshes; meshIndex++) {
+        const aiMesh* mesh = scene->mMeshes[meshIndex];
+        if (mesh->mPrimitiveTypes != aiPrimitiveType_TRIANGLE) {
+            continue;
+        }
+
+        ModelFileMesh fileMesh{};
+        fileMesh.mFirstIndex = numIndices;
+        fileMesh.mFirstVertex = numVertices;
+        fileMesh.mNumVertices = mesh->mNumVertices;
+        fileMesh.mMaterialIndex = mesh->mMaterialIndex;
+
+        ModelFileVertex* meshVertices = vertices.data() + numVertices;
+        for (unsigned int i = 0; i < mesh->mNumVertices; i++) {
+            ModelFileVertex& vertex = meshVertices[i];
+            vertex.mPosition[0] = mesh->mVertices[i].x;
+            vertex.mPosition[1] = mesh->mVertices[i].y;
+            vertex.mPosition[2] = mesh->mVertices[i].z;
+            vertex.mTexCoord[0] = mesh->mTextureCoords[0] ? mesh->mTextureCoords[0][i].x : 0.0f;
+            vertex.mTexCoord[1] = mesh->mTextureCoords[0] ? mesh->mTextureCoords[0][i].y : 0.0f;
+            vertex.mNormal[0] = mesh->mNormals[i].x;
+            vertex.mNormal[1] = mesh->mNormals[i].y;
+            vertex.mNormal[2] = mesh->mNormals[i].z;
+        }
+
+        uint32_t* meshIndices = indices.data() + numIndices;
+        for (unsigned int i = 0; i < mesh->mNumFaces; i++) {
+            const aiFace& face = mesh->mFaces[i];
+            indices[numIndices++] = face.mIndices[0];
+            indices[numIndices++] = face.mIndices[1];
+            indices[numIndices++] = face.mIndices[2];
+        }
+        fileMesh.mNumIndices = numIndices - fileMesh.mFirstIndex;
+
+        // Optimized while the indices are still local to the mesh, fetch order last since it renumbers the vertices.
+        const auto optimizeStartTime = std::chrono::steady_clock::now();
+        ModelMeshCookStatistics meshStatistics;
+        meshStatistics.mImported = AnalyzeVertexCache(meshIndices, fileMesh.mNumIndices, fileMesh.mNumVertices);
+
+        OptimizeVertexCache(meshIndices, fileMesh.mNumIndices, fileMesh.mNumVertices);
+        OptimizeOverdraw(meshIndices, fileMesh.mNumIndices, meshVertices, fileMesh.mNumVertices);
+        fileMesh.mNumVertices = OptimizeVertexFetch(meshIndices, fileMesh.mNumIndices, meshVertices, fileMesh.mNumVertices);
+
+        meshStatistics.mOptimized = AnalyzeVertexCache(meshIndices, fileMesh.mNumIndices, fileMesh.mNumVertices);
+        optimizeMilliseconds += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - optimizeStartTime).count();
+
+        if (statistics) {
+            statistics->mMeshes.push_back(meshStatistics);
+        }
+
+        for (uint32_t i = 0; i < fileMesh.mNumIndices; i++) {
+            meshIndices[i] += numVertices;
+        }
+
+        numVertices += fileMesh.mNumVertices;
+        fileMesh.mBounds = ComputeBounds(meshVertices, fileMesh.mNumVertices);
+        meshes.push_back(fileMesh);
+    }
+
+    // Unreferenced vertices were dropped by the fetch pass.
+    vertices.resize(numVertices);
+
+    header.mMagic = MODEL_FILE_MAGIC;
+    header.mVersion = MODEL_FILE_VERSION;
+    header.mVertexStride = sizeof(ModelFileVertex);
+    header.mNumMeshes = static_cast<uint32_t>(meshes.size());
+    header.mNumVertices = numVertices;
+    header.mNumIndices = numIndices;
+    header.mMeshesOffset = AlignOffset(sizeof(ModelFileHeader));
+    header.mVerticesOffset = AlignOffset(header.mMeshesOffset + meshes.size() * sizeof(ModelFileMesh));
+    header.mIndicesOffset = AlignOffset(header.mVerticesOffset + vertices.size() * sizeof(ModelFileVertex));
+    header.mFileSize = header.mIndicesOffset + indices.size() * sizeof(uint32_t);
+    header.mBounds = ComputeBounds(vertices.data(), vertices.size());
+
+    // Written under another name first, so a cook that dies halfway never leaves a file behind that passes the checks in Open.
+    const std::string tempPath = cookedPath + ".tmp";
+    {
+        std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+        if (!file) {
+            std::cerr << "Failed to write cooked model: " << tempPath << std::endl;
+            return false;
+        }
+
+        auto writeAt = [&file](uint64_t offset, const void* data, size_t size) {
+            static const char padding[MODEL_FILE_ALIGNMENT] = {};
+            file.write(padding, static_cast<std::streamsize>(offset - static_cast<uint64_t>(file.tellp())));
+            file.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+        };
+
+        writeAt(0, &header, sizeof(header));
+        writeAt(header.mMeshesOffset, meshes.data(), meshes.size() * sizeof(ModelFileMesh));
+        writeAt(header.mVerticesOffset, vertices.data(), vertices.size() * sizeof(ModelFileVertex));
+        writeAt(header.mIndicesOffset, indices.data(), indices.size() * sizeof(uint32_t));
+
+        if (!file) {
+            std::cerr << "Failed to write cooked model: " << tempPath << std::endl;
+            return false;
+        }
+    }
+
+    std::error_code error;
+    std::filesystem::rename(tempPath, cookedPath, error);
+    if (error) {
+        std::cerr << "Failed to write cooked model: " << cookedPath << std::endl;
+        return false;
+    }
+
+    if (statistics) {
+        const auto endTime = std::chrono::steady_clock::now();
+        statistics->mImportMilliseconds = std::chrono::duration<double, std::milli>(importTime - startTime).count();
+        statistics->mOptimizeMilliseconds = optimizeMilliseconds;
+        statistics->mCookMilliseconds = std::chrono::duration<double, std::milli>(endTime - startTime).count();
+        statistics->mFileSize = header.mFileSize;
+    }
+
+    return true;
+}
+
+bool ModelFile::Open(const std::string& cookedPath, const std::string& sourcePath)
+{
+    auto mappedFile = std::make_shared<D3D12Lite::MappedFile>();
+    if (!mappedFile->Open(std::filesystem::path(cookedPath).wstring().c_str()) || mappedFile->GetSize() < sizeof(ModelFileHeader)) {
+        return false;
+    }
+
+    const uint8_t* data = mappedFile->GetData();
+    const uint64_t fileSize = mappedFile->GetSize();
+    const ModelFileHeader* header = reinterpret_cast<const ModelFileHeader*>(data);
+
+    if (header->mMagic != MODEL_FILE_MAGIC || header->mVersion != MODEL_FILE_VERSION || header->mVertexStride != sizeof(ModelFileVertex) || header->mFileSize != fileSize) {
+        return false;
+    }
+
+    if (header->mMeshesOffset + uint64_t(header->mNumMeshes) * sizeof(ModelFileMesh) > fileSize
+        || header->mVerticesOffset + uint64_t(header->mNumVertices) * sizeof(ModelFileVertex) > fileSize
+        || header->mIndicesOffset + uint64_t(header->mNumIndices) * sizeof(uint32_t) > fileSize) {
+        return false;
+    }
+
+    if (!ValidateMeshes(*header, reinterpret_cast<const ModelFileMesh*>(data + header->mMeshesOffset), reinterpret_cast<const uint32_t*>(data + header->mIndicesOffset))) {
+        return false;
+    }
+
+    if (!sourcePath.empty()) {
+        // A missing source is fine, cooked files can ship without it.
+        uint64_t sourceSize = 0;
+        int64_t sourceWriteTime = 0;
+        if (GetSourceStamp(sourcePath, sourceSize, sourceWriteTime) && (sourceSize != header->mSourceSize || sourceWriteTime != header->mSourceWriteTime)) {
+            return false;
+        }
+    }
+
+    mMappedFile = std::move(mappedFile);
+    mHeader = header;
+    mMeshes = reinterpret_cast<const ModelFileMesh*>(data + header->mMeshesOffset);
+    mVertices = reinterpret_cast<const ModelFileVertex*>(data + header->mVerticesOffset);
+    mIndices = reinterpret_cast<const uint32_t*>(data + header->mIndicesOffset);
+
+    return true;
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <memory>
+#include <vector>
+#include "MeshOptimizer.h"
+
+namespace D3D12Lite
+{
+    class MappedFile;
+}
+
+// Cooked model file, written once by CookModelFile and memory mapped on every load after that.
+// A header is followed by the mesh table, the vertex stream and the index stream at the offsets it lists.
+// Vertices have the MeshVertex layout from Shaders/Shared.h and indices are 32 bit and absolute into the vertex
+// stream (the bindless vertex fetch gets no base vertex), so both streams go to the GPU as they are.
+constexpr uint32_t MODEL_FILE_MAGIC = 0x4C444D43; // "CMDL"
+constexpr uint32_t MODEL_FILE_VERSION = 2;
+constexpr uint32_t MODEL_FILE_ALIGNMENT = 16;
+static const char* MODEL_FILE_EXTENSION = ".cmdl";
+
+struct ModelFileBounds {
+    float mMin[3];
+    float mMax[3];
+    float mSphereCenter[3];
+    float mSphereRadius;
+};
+
+struct ModelFileVertex {
+    float mPosition[3];
+    float mTexCoord[2];
+    float mNormal[3];
+};
+
+// One per source mesh, a range of the shared streams drawn with a single material.
+struct ModelFileMesh {
+    uint32_t mFirstIndex;
+    uint32_t mNumIndices;
+    uint32_t mFirstVertex;
+    uint32_t mNumVertices;
+    uint32_t mMaterialIndex;
+    uint32_t mPadding[3];
+    ModelFileBounds mBounds;
+};
+
+struct ModelFileHeader {
+    uint32_t mMagic;
+    uint32_t mVersion;
+    uint32_t mVertexStride;
+    uint32_t mNumMeshes;
+    uint32_t mNumVertices;
+    uint32_t mNumIndices;
+    uint64_t mMeshesOffset;
+    uint64_t mVerticesOffset;
+    uint64_t mIndicesOffset;
+    uint64_t mFileSize;
+    // Size and write time of the file this was cooked from, a mismatch means it has to be cooked again.
+    uint64_t mSourceSize;
+    int64_t mSourceWriteTime;
+    ModelFileBounds mBounds;
+};
+
+struct ModelMeshCookStatistics {
+    VertexCacheStatistics mImported;
+    VertexCacheStatistics mOptimized;
+};
+
+struct ModelCookStatistics {
+    double mImportMilliseconds = 0.0;
+    double mOptimizeMilliseconds = 0.0;
+    double mCookMilliseconds = 0.0;
+    uint64_t mFileSize = 0;
+    std::vector<ModelMeshCookStatistics> mMeshes;
+};
+
+// Runs the source file through Assimp and writes every triangle mesh in it to cookedPath. Each mesh has its triangles
+// ordered for the vertex cache and then overdraw, and its vertices ordered for fetch, before it is written.
+bool CookModelFile(const std::string& sourcePath, const std::string& cookedPath, ModelCookStatistics* statistics = nullptr);
+
+// Read-only view of a mapped cooked file. The pointers stay valid as long as the mapping does, and the mapping can be
+// shared with uploads reading straight out of it.
+class ModelFile {
+public:
+    // Fails when the file is missing, truncated, from another version, has a mesh range or index outside its streams or,
+    // given a sourcePath, is stale. Any of these gets the file cooked again.
+    bool Open(const std::string& cookedPath, const std::string& sourcePath = std::string());
+
+    const ModelFileHeader& GetHeader() const { return *mHeader; }
+    const ModelFileMesh* GetMeshes() const { return mMeshes; }
+    const ModelFileVertex* GetVertices() const { return mVertices; }
+    const uint32_t* GetIndices() const { return mIndices; }
+    const std::shared_ptr<D3D12Lite::MappedFile>& GetMappedFile() const { return mMappedFile; }
+
+private:
+    std::shared_ptr<D3D12Lite::MappedFile> mMappedFile;
+    const ModelFileHeader* mHeader = nullptr;
+    const ModelFileMesh* mMeshes = nullptr;
+    const ModelFileVertex* mVertices = nullptr;
+    const uint32_t* mIndices = nullptr;
+};
@@ -3,15 +3,52 @@
 #include "imgui/imgui.h"
 #include "imgui/imgui_impl_dx12.h"
 #include "imgui/imgui_impl_win32.h"
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <cassert>
+
+// Mesh instances are split over this many contexts, each one recorded on its own worker thread.
+constexpr uint32_t NUM_MESH_RECORDING_THREADS = 4;
+// VRAM the streamed textures may take beyond their mip tails.
+constexpr uint64_t TEXTURE_RESIDENCY_BUDGET = 256ull * 1024 * 1024;
 
 Renderer::Renderer(HWND windowHandle, Uint2 screenSize)
 {
     mDevice = std::make_unique<Device>(windowHandle, screenSize);
+    InitializeResources(windowHandle);
+}
+
+Renderer::Renderer(const NullDeviceDesc& nullDeviceDesc, Uint2 screenSize)
+{
+    mDevice = std::make_unique<Device>(nullDeviceDesc, screenSize);
+    InitializeResources(nullptr);
+}
+
+void Renderer::InitializeResources(HWND windowHandle)
+{
     mGraphicsContext = mDevice->CreateGraphicsContext();
+    mTextureResidencyManager = std::make_unique<TextureResidencyManager>(*mDevice, TEXTURE_RESIDENCY_BUDGET);
 
     InitializeTriangleResources();
     InitializeMeshResources();
-    InitializeImGui(windowHandle);
+
+    // ImGui draws through the native device and window, neither of which exists on the null backend.
+    if (mDevice->GetBackendType() != DeviceBackendType::null)
+    {
+        InitializeImGui(windowHandle);
+    }
+
+    // Every pipeline above has waited for its shaders by now, so these cover the whole startup.
+    ShaderCacheStatistics shaderStatistics = mDevice->GetShaderCacheStatistics();
+    std::cout << "Shaders: " << shaderStatistics.mNumRequests << " requested, " << shaderStatistics.mNumHits << " cached ("
+        << shaderStatistics.mLoadMilliseconds << " ms), " << shaderStatistics.mNumMisses << " compiled (" << shaderStatistics.mCompileMilliseconds
+        << " ms), " << shaderStatistics.mNumFailures << " failed, hashing " << shaderStatistics.mHashMilliseconds << " ms" << std::endl;
+
+    PipelineCacheStatistics pipelineStatistics = mDevice->GetPipelineCacheStatistics();
+    std::cout << "Pipelines: " << pipelineStatistics.mNumLibraryHits << " from the pipeline library, " << pipelineStatistics.mNumLibraryMisses
+        << " created (" << pipelineStatistics.mCreateMilliseconds << " ms), " << pipelineStatistics.mNumPipelineHits << " reused, root signatures "
+        << pipelineStatistics.mNumRootSignatureHits << " reused / " << pipelineStatistics.mNumRootSignatureMisses << " created" << std::endl;
 }
 
 Renderer::~Renderer() {
@@ -24,6 +61,9 @@ Renderer::~Renderer() {
     mDevice->DestroyBuffer(std::move(mTriangleVertexBuffer));
     mDevice->DestroyBuffer(std::move(mTriangleConstantBuffer));
 
+    mTextureResidencyManager->DestroyStreamedTexture(std::move(mWoodTexture));
+    mTextureResidencyManager = nullptr;
+
     mDevice = nullptr;
 }
 
@@ -45,6 +85,12 @@ void Renderer::InitializeImGui(HWND windowHandle)
 
 void Renderer::RenderImGui()
 {
+    if (mDevice->GetBackendType() == DeviceBackendType::null)
+    {
+        RenderClearColorTutorial();
+        return;
+    }
+
     mDevice->BeginFrame();
 
     ImGui_ImplDX12_NewFrame();
@@ -254,22 +300,8 @@ void Renderer::InitializeMeshResources()
 
     mDevice->GetUploadContextForCurrentFrame().AddBufferUpload(std::move(bufferUpload));
 
-    mWoodTexture = mDevice->CreateTextureFromFile("Wood.dds");
-
-    MeshConstants meshConstants;
-    meshConstants.vertexBufferIndex = mMeshVertexBuffer->mDescriptorHeapIndex;
-    meshConstants.textureIndex = mWoodTexture->mDescriptorHeapIndex;
-
-    BufferCreationDesc meshConstantDesc{};
-    meshConstantDesc.mSize = sizeof(MeshConstants);
-    meshConstantDesc.mAccessFlags = BufferAccessFlags::hostWritable;
-    meshConstantDesc.mViewFlags = BufferViewFlags::cbv;
-
-    for (uint32_t frameIndex = 0; frameIndex < NUM_FRAMES_IN_FLIGHT; frameIndex++)
-    {
-        mMeshConstantBuffers[frameIndex] = mDevice->CreateBuffer(meshConstantDesc);
-        mMeshConstantBuffers[frameIndex]->SetMappedData(&meshConstants, sizeof(MeshConstants));
-    }
+    // Starts out with only its mip tail, the finer mips stream in once RenderMeshTutorial asks for them.
+    mWoodTexture = mTextureResidencyManager->CreateStreamedTexture("Wood.dds");
 
     BufferCreationDesc meshPassConstantDesc{};
     meshPassConstantDesc.mSize = sizeof(MeshPassConstants);
@@ -320,7 +352,9 @@ void Renderer::InitializeMeshResources()
     meshPipelineDesc.mRenderTargetDesc.mDepthStencilFormat = depthBufferDesc.mResourceDesc.Format;
     meshPipelineDesc.mDepthStencilDesc.DepthWriteMask = D3D12_DEPTH_WRITE_MASK_ALL;
 
-    mMeshPerObjectResourceSpace.SetCBV(mMeshConstantBuffers[0].get());
+    // Only declares the per object CBV for the layout, every draw binds its own transient constant buffer.
+    MeshConstants meshConstants;
+    mMeshPerObjectResourceSpace.SetTransientCBV(mDevice->AllocateTransientConstantBuffer(meshConstants));
     mMeshPerObjectResourceSpace.Lock();
 
     mMeshPerPassResourceSpace.SetCBV(mMeshPassConstantBuffer.get());
@@ -331,58 +365,120 @@ void Renderer::InitializeMeshResources()
     meshResourceLayout.mSpaces[PER_PASS_SPACE] = &mMeshPerPassResourceSpace;
 
     mMeshPSO = mDevice->CreateGraphicsPipeline(meshPipelineDesc, meshResourceLayout);
+
+    mMeshRecordingWorkerPool = std::make_unique<WorkerPool>(NUM_MESH_RECORDING_THREADS);
 }
 
 void Renderer::RenderMeshTutorial()
 {
     mDevice->BeginFrame();
+    mTextureResidencyManager->Update();
 
     TextureResource& backBuffer = mDevice->GetCurrentBackBuffer();
 
-    mGraphicsContext->Reset();
-    mGraphicsContext->AddBarrier(backBuffer, D3D12_RESOURCE_STATE_RENDER_TARGET);
-    mGraphicsContext->AddBarrier(*mDepthBuffer, D3D12_RESOURCE_STATE_DEPTH_WRITE);
-    mGraphicsContext->FlushBarriers();
+    // Contexts are submitted in one batch, in the order they are listed here.
+    std::array<Context*, MAX_BATCHED_CONTEXTS> contexts{};
+    uint32_t numContexts = 0;
 
-    mGraphicsContext->ClearRenderTarget(backBuffer, Color(0.3f, 0.3f, 0.8f));
-    mGraphicsContext->ClearDepthStencilTarget(*mDepthBuffer, 1.0f, 0);
+    GraphicsContext& clearContext = mDevice->AcquireGraphicsContext();
+    clearContext.AddBarrier(backBuffer, D3D12_RESOURCE_STATE_RENDER_TARGET);
+    clearContext.AddBarrier(*mDepthBuffer, D3D12_RESOURCE_STATE_DEPTH_WRITE);
+    clearContext.FlushBarriers();
+
+    clearContext.ClearRenderTarget(backBuffer, Color(0.3f, 0.3f, 0.8f));
+    clearContext.ClearDepthStencilTarget(*mDepthBuffer, 1.0f, 0);
+    contexts[numContexts++] = &clearContext;
 
     static float rotation = 0.0f;
     rotation += 0.0001f;
 
     if (mMeshVertexBuffer->mIsReady && mWoodTexture->mIsReady)
     {
-        MeshConstants meshConstants;
-        meshConstants.vertexBufferIndex = mMeshVertexBuffer->mDescriptorHeapIndex;
-        meshConstants.textureIndex = mWoodTexture->mDescriptorHeapIndex;
-        meshConstants.worldMatrix = Matrix::CreateRotationY(rotation);
-
-        mMeshConstantBuffers[mDevice->GetFrameId()]->SetMappedData(&meshConstants, sizeof(MeshConstants));
-
-        mMeshPerObjectResourceSpace.SetCBV(mMeshConstantBuffers[mDevice->GetFrameId()].get());
-
-        PipelineInfo pipeline;
-        pipeline.mPipeline = mMeshPSO.get();
-        pipeline.mRenderTargets.push_back(&backBuffer);
-        pipeline.mDepthStencilTarget = mDepthBuffer.get();
-
-        mGraphicsContext->SetPipeline(pipeline);
-        mGraphicsContext->SetPipelineResources(PER_OBJECT_SPACE, mMeshPerObjectResourceSpace);
-        mGraphicsContext->SetPipelineResources(PER_PASS_SPACE, mMeshPerPassResourceSpace);
-        mGraphicsContext->SetDefaultViewPortAndScissor(mDevice->GetScreenSize());
-        mGraphicsContext->SetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-        mGraphicsContext->Draw(36);
+        // The cubes fill a good part of the screen, so the full resolution is wanted whenever they are drawn.
+        mTextureResidencyManager->RequestMip(*mWoodTexture, 0);
+
+        const uint32_t maxRecordingContexts = std::min(mMeshRecordingWorkerPool->GetNumThreads(), MAX_BATCHED_CONTEXTS - 2);
+        const uint32_t numRecordingContexts = std::min(maxRecordingContexts, mNumMeshInstances);
+        const uint32_t numInstancesPerContext = (mNumMeshInstances + numRecordingContexts - 1) / numRecordingContexts;
+
+        for (uint32_t firstInstance = 0; firstInstance < mNumMeshInstances; firstInstance += numInstancesPerContext)
+        {
+            GraphicsContext& meshContext = mDevice->AcquireGraphicsContext();
+            const uint32_t numInstances = std::min(numInstancesPerContext, mNumMeshInstances - firstInstance);
+
+            mMeshRecordingWorkerPool->AddJob([this, &meshContext, &backBuffer, firstInstance, numInstances]()
+            {
+                RecordMeshInstances(meshContext, backBuffer, firstInstance, numInstances, rotation);
+            });
+
+            contexts[numContexts++] = &meshContext;
+        }
+
+        mMeshRecordingWorkerPool->WaitForIdle();
     }
 
-    mGraphicsContext->AddBarrier(backBuffer, D3D12_RESOURCE_STATE_PRESENT);
-    mGraphicsContext->FlushBarriers();
+    GraphicsContext& presentContext = mDevice->AcquireGraphicsContext();
+    presentContext.AddBarrier(backBuffer, D3D12_RESOURCE_STATE_PRESENT);
+    presentContext.FlushBarriers();
+    contexts[numContexts++] = &presentContext;
 
-    mDevice->SubmitContextWork(*mGraphicsContext);
+    mDevice->SubmitContextWork(contexts.data(), numContexts);
 
     mDevice->EndFrame();
     mDevice->Present();
 }
 
+void Renderer::RecordMeshInstances(GraphicsContext& context, TextureResource& backBuffer, uint32_t firstInstance, uint32_t numInstances, float rotation)
+{
+    // Already in these states from the clear, the barriers only tell this context's state tracking.
+    context.AddBarrier(backBuffer, D3D12_RESOURCE_STATE_RENDER_TARGET);
+    context.AddBarrier(*mDepthBuffer, D3D12_RESOURCE_STATE_DEPTH_WRITE);
+    context.FlushBarriers();
+
+    PipelineInfo pipeline;
+    pipeline.mPipeline = mMeshPSO.get();
+    pipeline.mRenderTargets.push_back(&backBuffer);
+    pipeline.mDepthStencilTarget = mDepthBuffer.get();
+
+    context.SetPipeline(pipeline);
+    context.SetPipelineResources(PER_PASS_SPACE, mMeshPerPassResourceSpace);
+    context.SetDefaultViewPortAndScissor(mDevice->GetScreenSize());
+    context.SetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+
+    // Instances are laid out on a square grid centered on the origin, a single one sits at the origin.
+    const uint32_t gridSize = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<float>(mNumMeshInstances))));
+    const float gridSpacing = 3.0f;
+    const float gridOffset = (gridSize - 1) * gridSpacing * 0.5f;
+
+    MeshConstants meshConstants;
+    meshConstants.vertexBufferIndex = mMeshVertexBuffer->mDescriptorHeapIndex;
+    meshConstants.textureIndex = mWoodTexture->mDescriptorHeapIndex;
+
+    for (uint32_t instanceIndex = firstInstance; instanceIndex < firstInstance + numInstances; instanceIndex++)
+    {
+        // Binds everything again the way per draw code usually does, which the context's state filtering drops.
+        if (mRebindMeshStatePerDraw)
+        {
+            context.SetPipeline(pipeline);
+            context.SetPipelineResources(PER_PASS_SPACE, mMeshPerPassResourceSpace);
+            context.SetDefaultViewPortAndScissor(mDevice->GetScreenSize());
+            context.SetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+        }
+
+        Vector3 position = Vector3((instanceIndex % gridSize) * gridSpacing - gridOffset, 0.0f, (instanceIndex / gridSize) * gridSpacing - gridOffset);
+        meshConstants.worldMatrix = Matrix::CreateRotationY(rotation) * Matrix::CreateTranslation(position);
+
+        context.SetConstantBuffer(PER_OBJECT_SPACE, mDevice->AllocateTransientConstantBuffer(meshConstants));
+        context.Draw(36);
+    }
+}
+
+void Renderer::SetNumMeshRecordingThreads(uint32_t numThreads)
+{
+    assert(numThreads > 0);
+    mMeshRecordingWorkerPool = std::make_unique<WorkerPool>(numThreads);
+}
+
 void Renderer::Render()
 {
     //RenderClearColorTutorial();
@@ -1,5 +1,6 @@
 #pragma once
 #include "D3D12Lite.h"
+#include "D3D12LiteResidency.h"
 #include "d3d12.h"
 
 using namespace D3D12Lite;
@@ -10,6 +11,7 @@ private:
     // Member Variable for Render
     std::unique_ptr<Device> mDevice;
     std::unique_ptr<GraphicsContext> mGraphicsContext;
+    std::unique_ptr<TextureResidencyManager> mTextureResidencyManager;
 
     // Member variables for Triangle
     std::unique_ptr<BufferResource> mTriangleVertexBuffer;
@@ -23,18 +25,24 @@ private:
     std::unique_ptr<TextureResource> mDepthBuffer;
     std::unique_ptr<TextureResource> mWoodTexture;
     std::unique_ptr<BufferResource> mMeshVertexBuffer;
-    std::array<std::unique_ptr<BufferResource>, NUM_FRAMES_IN_FLIGHT> mMeshConstantBuffers;
     std::unique_ptr<BufferResource> mMeshPassConstantBuffer;
     PipelineResourceSpace mMeshPerObjectResourceSpace;
     PipelineResourceSpace mMeshPerPassResourceSpace;
     std::unique_ptr<Shader> mMeshVertexShader;
     std::unique_ptr<Shader> mMeshPixelShader;
     std::unique_ptr<PipelineStateObject> mMeshPSO;
+    std::unique_ptr<WorkerPool> mMeshRecordingWorkerPool;
+    uint32_t mNumMeshInstances = 1;
+    bool mRebindMeshStatePerDraw = false;
 
 public:
     Renderer(HWND windowHandle, Uint2 screenSize);
+    // Headless, everything is recorded against the null backend and nothing reaches a GPU or window.
+    Renderer(const NullDeviceDesc& nullDeviceDesc, Uint2 screenSize);
     ~Renderer();
 
+    void InitializeResources(HWND windowHandle);
+
     void InitializeImGui(HWND windowHandle);
     void RenderImGui();
 
@@ -45,6 +53,13 @@ public:
 
     void InitializeMeshResources();
     void RenderMeshTutorial();
+    void RecordMeshInstances(GraphicsContext& context, TextureResource& backBuffer, uint32_t firstInstance, uint32_t numInstances, float rotation);
+    void SetNumMeshInstances(uint32_t numMeshInstances) { mNumMeshInstances = numMeshInstances; }
+    void SetNumMeshRecordingThreads(uint32_t numThreads);
+    void SetRebindMeshStatePerDraw(bool isRebinding) { mRebindMeshStatePerDraw = isRebinding; }
+
+    Device& GetDevice() { return *mDevice; }
+    TextureResidencyManager& GetTextureResidencyManager() { return *mTextureResidencyManager; }
 
     void Render();
 };
\ No newline at end of file
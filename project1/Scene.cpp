@@ -0,0 +1,46 @@
+#include "Scene.h"
+
+Scene::Scene(uint32_t numThreads)
+    : mEntities(numThreads)
+    , mTransforms(numThreads)
+{
+}
+
+GameObject Scene::CreateGameObject(const GameObject& parent)
+{
+    assert(!parent.IsValid() || parent.GetScene() == this);
+
+    const uint32_t parentId = parent.IsValid() ? parent.GetTransform().GetId() : INVALID_TRANSFORM_ID;
+    const uint32_t transformId = mTransforms.Add(parentId);
+    const Entity entity = mEntities.Create(TransformComponent{ transformId });
+
+    if (transformId >= mEntityOfTransform.size()) {
+        mEntityOfTransform.resize(transformId + 1);
+    }
+    mEntityOfTransform[transformId] = entity;
+
+    return GameObject(*this, entity);
+}
+
+void Scene::DestroyGameObject(const GameObject& gameObject)
+{
+    if (!gameObject.IsValid()) {
+        return;
+    }
+
+    const uint32_t transformId = gameObject.GetTransform().GetId();
+    mTransforms.Remove(transformId);
+    mEntityOfTransform[transformId] = Entity();
+    mEntities.Destroy(gameObject.GetEntity());
+}
+
+GameObject Scene::GetGameObject(uint32_t transformId)
+{
+    assert(mTransforms.IsValid(transformId));
+    return GameObject(*this, mEntityOfTransform[transformId]);
+}
+
+void Scene::Update()
+{
+    mTransforms.Update();
+}
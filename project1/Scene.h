@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "EntityStore.h"
+#include "TransformHierarchy.h"
+#include "GameObject.h"
+
+// The entities of every game object and the hierarchy of their transforms. Each game object's entity has a
+// TransformComponent pointing at its transform, everything else is whatever components are added to it.
+class Scene {
+public:
+    Scene(uint32_t numThreads);
+
+    // Invalid parents put the game object at the root.
+    GameObject CreateGameObject(const GameObject& parent = GameObject());
+    // Children of the game object move up to its parent.
+    void DestroyGameObject(const GameObject& gameObject);
+    GameObject GetGameObject(uint32_t transformId);
+
+    // Recomputes the world matrices of transforms changed since the last call.
+    void Update();
+
+    EntityStore& GetEntities() { return mEntities; }
+    TransformHierarchy& GetTransforms() { return mTransforms; }
+
+private:
+    EntityStore mEntities;
+    TransformHierarchy mTransforms;
+    std::vector<Entity> mEntityOfTransform;
+};
@@ -0,0 +1,579 @@
+#include "Tests.h"
+#include "D3D12LiteShaderCache.h"
+#include "D3D12LitePipelineCache.h"
+#include "D3D12LiteNullBackend.h"
+#include "D3D12LiteResidencyPolicy.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <thread>
+
+using namespace D3D12Lite;
+
+#define CHECK(condition) Check((condition), #condition, __LINE__)
+
+namespace
+{
+    int numFailedChecks = 0;
+
+    void Check(bool condition, const char* expression, int line)
+    {
+        if (!condition)
+        {
+            std::cout << "  check failed on line " << line << ": " << expression << std::endl;
+            numFailedChecks++;
+        }
+    }
+
+    void WriteTextFile(const std::filesystem::path& path, const std::string& text)
+    {
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        file << text;
+    }
+
+    // Hands the source back as the bytecode and counts how often any compile thread ran it.
+    class CountingShaderCompiler : public ShaderCompiler
+    {
+    public:
+        CountingShaderCompiler(std::atomic<uint32_t>& numCompiles)
+            : mNumCompiles(numCompiles)
+        {
+        }
+
+        ShaderCompileOutput Compile(const ShaderCompileRequest& request, const std::string& source) override
+        {
+            mNumCompiles++;
+
+            ShaderCompileOutput output;
+            output.mSucceeded = true;
+            output.mByteCode.assign(source.begin(), source.end());
+
+            return output;
+        }
+
+    private:
+        std::atomic<uint32_t>& mNumCompiles;
+    };
+
+    // Flips the last byte of a cached entry, which is part of the bytecode, so only its hash gives it away.
+    void FlipLastByte(const std::filesystem::path& path)
+    {
+        std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+        file.seekg(-1, std::ios::end);
+        const char lastByte = static_cast<char>(file.get());
+        file.seekp(-1, std::ios::end);
+        file.put(static_cast<char>(~lastByte));
+    }
+
+    uint32_t GetNumTemporaryFiles(const std::filesystem::path& directory)
+    {
+        uint32_t numTemporaryFiles = 0;
+
+        for (const auto& entry : std::filesystem::directory_iterator(directory))
+        {
+            numTemporaryFiles += entry.path().extension() == ".tmp" ? 1 : 0;
+        }
+
+        return numTemporaryFiles;
+    }
+
+    // Laid out like the real shaders: Mesh.hlsl includes Shaders/Common.hlsl from the working directory, which includes
+    // Shared.h from next to itself.
+    void TestShaderCache()
+    {
+        std::cout << "Shader cache" << std::endl;
+
+        const std::filesystem::path previousWorkingDirectory = std::filesystem::current_path();
+        const std::filesystem::path testDirectory = std::filesystem::temp_directory_path() / "D3D12LiteShaderCacheTest";
+        const std::filesystem::path cachePath = "Compiled";
+
+        std::filesystem::remove_all(testDirectory);
+        std::filesystem::create_directories(testDirectory / "Shaders");
+        std::filesystem::current_path(testDirectory);
+
+        WriteTextFile("Shaders/Mesh.hlsl", "#include \"Shaders/Common.hlsl\"\nfloat4 PixelShader() : SV_Target { return MeshColor; }\n");
+        WriteTextFile("Shaders/Common.hlsl", "#include \"Shared.h\"\n");
+        WriteTextFile("Shaders/Shared.h", "static const float4 MeshColor = float4(1, 0, 0, 1);\n");
+
+        ShaderCompileRequest request;
+        request.mSourcePath = "Shaders/Mesh.hlsl";
+        request.mSourceName = L"Mesh.hlsl";
+        request.mEntryPoint = L"PixelShader";
+        request.mTarget = L"ps_6_6";
+
+        std::atomic<uint32_t> numCompiles{ 0 };
+        auto compilerFactory = [&numCompiles]() { return std::make_unique<CountingShaderCompiler>(numCompiles); };
+
+        // Compiled once, then loaded from disk by a cache that never compiled it.
+        uint64_t firstHash = 0;
+        {
+            ShaderCache cache(cachePath, compilerFactory);
+            const ShaderCacheResult result = cache.Request(request).get();
+            CHECK(result.mSucceeded && !result.mWasCached);
+
+            ShaderCache secondCache(cachePath, compilerFactory);
+            const ShaderCacheResult cachedResult = secondCache.Request(request).get();
+            CHECK(cachedResult.mSucceeded && cachedResult.mWasCached);
+            CHECK(cachedResult.mHash == result.mHash);
+            CHECK(cachedResult.mByteCode == result.mByteCode);
+            CHECK(secondCache.GetStatistics().mNumHits == 1);
+            CHECK(numCompiles == 1);
+
+            firstHash = result.mHash;
+        }
+
+        // A change two includes down makes it a different key.
+        WriteTextFile("Shaders/Shared.h", "static const float4 MeshColor = float4(0, 1, 0, 1);\n");
+
+        uint64_t changedHash = 0;
+        {
+            ShaderCache cache(cachePath, compilerFactory);
+            const ShaderCacheResult result = cache.Request(request).get();
+            CHECK(result.mSucceeded && !result.mWasCached);
+            CHECK(result.mHash != firstHash);
+            CHECK(numCompiles == 2);
+
+            changedHash = result.mHash;
+        }
+
+        // Entries that were cut short or had their bytecode changed are compiled again and written over.
+        const std::filesystem::path cachedPath = ShaderCache(cachePath, compilerFactory).GetCachedPath(request, changedHash);
+
+        std::filesystem::resize_file(cachedPath, std::filesystem::file_size(cachedPath) - 1);
+        {
+            ShaderCache cache(cachePath, compilerFactory);
+            const ShaderCacheResult result = cache.Request(request).get();
+            CHECK(result.mSucceeded && !result.mWasCached);
+            CHECK(cache.GetStatistics().mNumCorruptEntries == 1);
+            CHECK(numCompiles == 3);
+        }
+
+        FlipLastByte(cachedPath);
+        {
+            ShaderCache cache(cachePath, compilerFactory);
+            const ShaderCacheResult result = cache.Request(request).get();
+            CHECK(result.mSucceeded && !result.mWasCached);
+            CHECK(cache.GetStatistics().mNumCorruptEntries == 1);
+            CHECK(numCompiles == 4);
+
+            ShaderCache secondCache(cachePath, compilerFactory);
+            CHECK(secondCache.Request(request).get().mWasCached);
+            CHECK(numCompiles == 4);
+        }
+
+        // Two caches on the same directory storing the same key at once.
+        WriteTextFile("Shaders/Shared.h", "static const float4 MeshColor = float4(0, 0, 1, 1);\n");
+        {
+            ShaderCache firstCache(cachePath, compilerFactory);
+            ShaderCache secondCache(cachePath, compilerFactory);
+
+            std::shared_future<ShaderCacheResult> firstResult = firstCache.Request(request);
+            std::shared_future<ShaderCacheResult> secondResult = secondCache.Request(request);
+
+            CHECK(firstResult.get().mSucceeded && secondResult.get().mSucceeded);
+            CHECK(firstResult.get().mByteCode == secondResult.get().mByteCode);
+            CHECK(GetNumTemporaryFiles(cachePath) == 0);
+
+            ShaderCache thirdCache(cachePath, compilerFactory);
+            CHECK(thirdCache.Request(request).get().mWasCached);
+        }
+
+        std::filesystem::current_path(previousWorkingDirectory);
+        std::filesystem::remove_all(testDirectory);
+    }
+
+    // Plans a frame and lets every change take effect right away, the way it would once its upload finished.
+    std::vector<ResidencyChange> PlanAndApply(ResidencyPolicy& policy, uint64_t frameIndex, uint64_t budgetBytes)
+    {
+        std::vector<ResidencyChange> changes;
+        policy.Plan(frameIndex, budgetBytes, changes);
+
+        for (const ResidencyChange& change : changes)
+        {
+            policy.SetResidentMip(change.mTextureId, change.mResidentMip);
+        }
+
+        return changes;
+    }
+
+    bool HasChange(const std::vector<ResidencyChange>& changes, uint32_t textureId, uint32_t residentMip)
+    {
+        return std::find_if(changes.begin(), changes.end(), [&](const ResidencyChange& change)
+        {
+            return change.mTextureId == textureId && change.mResidentMip == residentMip;
+        }) != changes.end();
+    }
+
+    // Every texture has four mips of 64, 16, 4 and 1 bytes with mip 2 as its tail, so 5 bytes are always resident, mip 1
+    // takes 21 and mip 0 takes 85.
+    void TestResidencyPolicy()
+    {
+        std::cout << "Residency policy" << std::endl;
+
+        const std::vector<uint64_t> mipSizes = { 64, 16, 4, 1 };
+        const uint32_t tailMip = 2;
+
+        // Requests within a frame keep the finest mip, requests are capped at the tail.
+        {
+            ResidencyPolicy policy;
+            const uint32_t texture = policy.AddTexture(mipSizes, tailMip);
+            CHECK(policy.GetResidentMip(texture) == tailMip);
+            CHECK(policy.GetResidentBytes(texture) == 5);
+
+            policy.RequestMip(texture, 1, 1);
+            policy.RequestMip(texture, 0, 1);
+            policy.RequestMip(texture, 3, 1);
+
+            const std::vector<ResidencyChange> changes = PlanAndApply(policy, 1, 1000);
+            CHECK(changes.size() == 1 && HasChange(changes, texture, 0));
+            CHECK(policy.GetResidentBytes(texture) == 85);
+        }
+
+        // Under budget pressure the least recently used textures are evicted first, and only the ones outside the grace
+        // period.
+        {
+            ResidencyPolicy policy;
+            const uint32_t firstTexture = policy.AddTexture(mipSizes, tailMip);
+            const uint32_t secondTexture = policy.AddTexture(mipSizes, tailMip);
+            const uint32_t thirdTexture = policy.AddTexture(mipSizes, tailMip);
+            const uint64_t budgetBytes = 200;
+
+            policy.RequestMip(firstTexture, 0, 1);
+            PlanAndApply(policy, 1, budgetBytes);
+
+            policy.RequestMip(secondTexture, 0, 2);
+            PlanAndApply(policy, 2, budgetBytes);
+            CHECK(policy.GetStatistics().mResidentBytes == 175);
+
+            // Both earlier textures are stale by now, only evicting the older one makes room for the third.
+            policy.RequestMip(thirdTexture, 0, 6);
+            std::vector<ResidencyChange> changes = PlanAndApply(policy, 6, budgetBytes);
+            CHECK(changes.size() == 2);
+            CHECK(HasChange(changes, firstTexture, tailMip));
+            CHECK(HasChange(changes, thirdTexture, 0));
+            CHECK(policy.GetResidentMip(secondTexture) == 0);
+            CHECK(policy.GetStatistics().mNumEvictions == 1 && policy.GetStatistics().mNumUpgrades == 1);
+            CHECK(policy.GetStatistics().mResidentBytes == 175);
+
+            // A shrinking budget evicts what it can, the texture requested last frame stays even though that leaves
+            // the budget exceeded.
+            changes = PlanAndApply(policy, 7, 50);
+            CHECK(changes.size() == 1 && HasChange(changes, secondTexture, tailMip));
+            CHECK(policy.GetResidentMip(thirdTexture) == 0);
+            CHECK(policy.GetStatistics().mResidentBytes == 95);
+        }
+
+        // Without anything to evict an upgrade settles for a coarser mip that fits, or waits for a later frame.
+        {
+            ResidencyPolicy policy;
+            const uint32_t firstTexture = policy.AddTexture(mipSizes, tailMip);
+            const uint32_t secondTexture = policy.AddTexture(mipSizes, tailMip);
+
+            policy.RequestMip(firstTexture, 0, 1);
+            policy.RequestMip(secondTexture, 0, 1);
+
+            std::vector<ResidencyChange> changes = PlanAndApply(policy, 1, 30);
+            CHECK(changes.size() == 1 && HasChange(changes, firstTexture, 1) != HasChange(changes, secondTexture, 1));
+            CHECK(policy.GetStatistics().mNumDeferredRequests == 1);
+            CHECK(policy.GetStatistics().mResidentBytes == 26);
+        }
+
+        // Textures with a change in flight are left alone until it took effect.
+        {
+            ResidencyPolicy policy;
+            const uint32_t texture = policy.AddTexture(mipSizes, tailMip);
+            std::vector<ResidencyChange> changes;
+
+            policy.RequestMip(texture, 1, 1);
+            policy.Plan(1, 1000, changes);
+            CHECK(changes.size() == 1);
+
+            policy.RequestMip(texture, 0, 2);
+            policy.Plan(2, 1000, changes);
+            CHECK(changes.empty());
+
+            policy.SetResidentMip(texture, 1);
+            policy.RequestMip(texture, 0, 3);
+            policy.Plan(3, 1000, changes);
+            CHECK(changes.size() == 1 && HasChange(changes, texture, 0));
+        }
+
+        // Removed textures give their bytes back and their id is reused.
+        {
+            ResidencyPolicy policy;
+            const uint32_t texture = policy.AddTexture(mipSizes, tailMip);
+            policy.RequestMip(texture, 0, 1);
+            PlanAndApply(policy, 1, 1000);
+
+            policy.RemoveTexture(texture);
+            PlanAndApply(policy, 2, 1000);
+            CHECK(policy.GetStatistics().mResidentBytes == 0);
+            CHECK(policy.AddTexture(mipSizes, tailMip) == texture);
+        }
+    }
+
+    // Two render targets with depth, independent blending off and stencil off, so a number of fields are ignored.
+    D3D12_GRAPHICS_PIPELINE_STATE_DESC GetTestPipelineDesc(const std::vector<uint8_t>& vertexShader, const std::vector<uint8_t>& pixelShader,
+        const std::array<D3D12_INPUT_ELEMENT_DESC, 2>& inputElements)
+    {
+        D3D12_GRAPHICS_PIPELINE_STATE_DESC pipelineDesc = {};
+        pipelineDesc.VS = { vertexShader.data(), vertexShader.size() };
+        pipelineDesc.PS = { pixelShader.data(), pixelShader.size() };
+        pipelineDesc.NumRenderTargets = 2;
+        pipelineDesc.RTVFormats[0] = DXGI_FORMAT_R8G8B8A8_UNORM;
+        pipelineDesc.RTVFormats[1] = DXGI_FORMAT_R16G16B16A16_FLOAT;
+        pipelineDesc.DSVFormat = DXGI_FORMAT_D32_FLOAT;
+        pipelineDesc.BlendState.RenderTarget[0].RenderTargetWriteMask = D3D12_COLOR_WRITE_ENABLE_ALL;
+        pipelineDesc.SampleMask = UINT_MAX;
+        pipelineDesc.RasterizerState.FillMode = D3D12_FILL_MODE_SOLID;
+        pipelineDesc.RasterizerState.CullMode = D3D12_CULL_MODE_BACK;
+        pipelineDesc.RasterizerState.DepthClipEnable = TRUE;
+        pipelineDesc.DepthStencilState.DepthEnable = TRUE;
+        pipelineDesc.DepthStencilState.DepthWriteMask = D3D12_DEPTH_WRITE_MASK_ALL;
+        pipelineDesc.DepthStencilState.DepthFunc = D3D12_COMPARISON_FUNC_LESS;
+        pipelineDesc.InputLayout = { inputElements.data(), static_cast<UINT>(inputElements.size()) };
+        pipelineDesc.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE;
+        pipelineDesc.SampleDesc.Count = 1;
+
+        return pipelineDesc;
+    }
+
+    void TestPipelineCacheKeys()
+    {
+        std::cout << "Pipeline cache keys" << std::endl;
+
+        // Root signatures. Spaces without bindings count as missing and bindings are keyed by index, not resource.
+        BufferResource constantBuffer;
+        TextureResource texture;
+
+        PipelineResourceSpace firstSpace;
+        firstSpace.SetCBV(&constantBuffer);
+        firstSpace.SetSRV({ 0, &texture });
+        firstSpace.SetSRV({ 1, &texture });
+
+        PipelineResourceSpace equalSpace;
+        equalSpace.SetCBV(&constantBuffer);
+        equalSpace.SetSRV({ 0, nullptr });
+        equalSpace.SetSRV({ 1, nullptr });
+
+        PipelineResourceSpace emptySpace;
+
+        PipelineResourceLayout layout;
+        layout.mSpaces[PER_PASS_SPACE] = &firstSpace;
+
+        PipelineResourceLayout equalLayout;
+        equalLayout.mSpaces[PER_PASS_SPACE] = &equalSpace;
+        equalLayout.mSpaces[PER_OBJECT_SPACE] = &emptySpace;
+
+        const PipelineCacheKey rootSignatureKey = GetRootSignatureKey(layout);
+        CHECK(GetRootSignatureKey(equalLayout) == rootSignatureKey);
+
+        PipelineResourceSpace otherBindingSpace;
+        otherBindingSpace.SetCBV(&constantBuffer);
+        otherBindingSpace.SetSRV({ 0, &texture });
+        otherBindingSpace.SetSRV({ 2, &texture });
+
+        PipelineResourceSpace withoutCBVSpace;
+        withoutCBVSpace.SetSRV({ 0, &texture });
+        withoutCBVSpace.SetSRV({ 1, &texture });
+
+        PipelineResourceSpace withUAVSpace;
+        withUAVSpace.SetCBV(&constantBuffer);
+        withUAVSpace.SetSRV({ 0, &texture });
+        withUAVSpace.SetSRV({ 1, &texture });
+        withUAVSpace.SetUAV({ 0, &texture });
+
+        for (PipelineResourceSpace* space : { &otherBindingSpace, &withoutCBVSpace, &withUAVSpace })
+        {
+            PipelineResourceLayout otherLayout;
+            otherLayout.mSpaces[PER_PASS_SPACE] = space;
+            CHECK(!(GetRootSignatureKey(otherLayout) == rootSignatureKey));
+        }
+
+        PipelineResourceLayout otherSpaceLayout;
+        otherSpaceLayout.mSpaces[PER_OBJECT_SPACE] = &firstSpace;
+        CHECK(!(GetRootSignatureKey(otherSpaceLayout) == rootSignatureKey));
+
+        // Graphics pipelines. Bytecode is keyed by contents, so a copy in another buffer gives the same key.
+        const std::vector<uint8_t> vertexShader = { 1, 2, 3, 4, 5, 6, 7, 8 };
+        const std::vector<uint8_t> pixelShader = { 8, 7, 6, 5, 4, 3, 2, 1 };
+        const std::vector<uint8_t> vertexShaderCopy = vertexShader;
+        const std::vector<uint8_t> otherPixelShader = { 8, 7, 6, 5, 4, 3, 2, 0 };
+        const std::string positionSemantic = "POSITION";
+
+        std::array<D3D12_INPUT_ELEMENT_DESC, 2> inputElements = {};
+        inputElements[0] = { "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 };
+        inputElements[1] = { "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 };
+
+        std::array<D3D12_INPUT_ELEMENT_DESC, 2> equalInputElements = inputElements;
+        equalInputElements[0].SemanticName = positionSemantic.c_str();
+
+        const D3D12_GRAPHICS_PIPELINE_STATE_DESC pipelineDesc = GetTestPipelineDesc(vertexShader, pixelShader, inputElements);
+        const PipelineCacheKey pipelineKey = GetGraphicsPipelineKey(pipelineDesc, rootSignatureKey);
+
+        // Only differs in what the key has to ignore.
+        D3D12_GRAPHICS_PIPELINE_STATE_DESC equalDesc = GetTestPipelineDesc(vertexShaderCopy, pixelShader, equalInputElements);
+        equalDesc.RTVFormats[2] = DXGI_FORMAT_R8_UNORM;
+        equalDesc.BlendState.RenderTarget[0].SrcBlend = D3D12_BLEND_SRC_ALPHA;
+        equalDesc.BlendState.RenderTarget[0].LogicOp = D3D12_LOGIC_OP_SET;
+        equalDesc.BlendState.RenderTarget[1].BlendEnable = TRUE;
+        equalDesc.DepthStencilState.StencilReadMask = 0xff;
+        equalDesc.DepthStencilState.FrontFace.StencilFunc = D3D12_COMPARISON_FUNC_ALWAYS;
+        CHECK(GetGraphicsPipelineKey(equalDesc, GetRootSignatureKey(equalLayout)) == pipelineKey);
+
+        // Every change here has to end up as a different pipeline.
+        std::vector<std::function<void(D3D12_GRAPHICS_PIPELINE_STATE_DESC&)>> changes =
+        {
+            [&](D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc) { desc.PS = { otherPixelShader.data(), otherPixelShader.size() }; },
+            [&](D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc) { desc.VS = { vertexShader.data(), vertexShader.size() - 1 }; },
+            [&](D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc) { desc.GS = { pixelShader.data(), pixelShader.size() }; },
+            [](D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc) { desc.NumRenderTargets = 1; },
+            [](D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc) { desc.RTVFormats[1] = DXGI_FORMAT_R8G8B8A8_UNORM; },
+            [](D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc) { desc.DSVFormat = DXGI_FORMAT_D24_UNORM_S8_UINT; },
+            [](D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc) { desc.BlendState.AlphaToCoverageEnable = TRUE; },
+            [](D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc) { desc.BlendState.IndependentBlendEnable = TRUE; },
+            [](D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc) { desc.BlendState.RenderTarget[0].BlendEnable = TRUE; },
+            [](D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc) { desc.BlendState.RenderTarget[0].RenderTargetWriteMask = D3D12_COLOR_WRITE_ENABLE_RED; },
+            [](D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc) { desc.SampleMask = 1; },
+            [](D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc) { desc.RasterizerState.FillMode = D3D12_FILL_MODE_WIREFRAME; },
+            [](D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc) { desc.RasterizerState.CullMode = D3D12_CULL_MODE_NONE; },
+            [](D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc) { desc.RasterizerState.FrontCounterClockwise = TRUE; },
+            [](D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc) { desc.RasterizerState.DepthBias = 1; },
+            [](D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc) { desc.RasterizerState.SlopeScaledDepthBias = 0.5f; },
+            [](D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc) { desc.RasterizerState.DepthClipEnable = FALSE; },
+            [](D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc) { desc.RasterizerState.ConservativeRaster = D3D12_CONSERVATIVE_RASTERIZATION_MODE_ON; },
+            [](D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc) { desc.DepthStencilState.DepthEnable = FALSE; },
+            [](D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc) { desc.DepthStencilState.DepthWriteMask = D3D12_DEPTH_WRITE_MASK_ZERO; },
+            [](D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc) { desc.DepthStencilState.DepthFunc = D3D12_COMPARISON_FUNC_GREATER; },
+            [](D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc) { desc.DepthStencilState.StencilEnable = TRUE; },
+            [](D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc) { desc.InputLayout.NumElements = 1; },
+            [](D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc) { desc.IBStripCutValue = D3D12_INDEX_BUFFER_STRIP_CUT_VALUE_0xFFFF; },
+            [](D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc) { desc.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_LINE; },
+            [](D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc) { desc.SampleDesc.Count = 4; }
+        };
+
+        std::array<D3D12_INPUT_ELEMENT_DESC, 2> otherInputElements = inputElements;
+        otherInputElements[1].SemanticName = "NORMAL";
+        changes.push_back([&](D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc) { desc.InputLayout.pInputElementDescs = otherInputElements.data(); });
+
+        std::array<D3D12_INPUT_ELEMENT_DESC, 2> otherOffsetElements = inputElements;
+        otherOffsetElements[1].AlignedByteOffset = 16;
+        changes.push_back([&](D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc) { desc.InputLayout.pInputElementDescs = otherOffsetElements.data(); });
+
+        for (size_t changeIndex = 0; changeIndex < changes.size(); changeIndex++)
+        {
+            D3D12_GRAPHICS_PIPELINE_STATE_DESC otherDesc = pipelineDesc;
+            changes[changeIndex](otherDesc);
+
+            if (GetGraphicsPipelineKey(otherDesc, rootSignatureKey) == pipelineKey)
+            {
+                std::cout << "  graphics pipeline change " << changeIndex << " kept the same key" << std::endl;
+                numFailedChecks++;
+            }
+        }
+
+        CHECK(!(GetGraphicsPipelineKey(pipelineDesc, GetRootSignatureKey(otherSpaceLayout)) == pipelineKey));
+
+        // Compute pipelines, which never share a key with a graphics pipeline.
+        D3D12_COMPUTE_PIPELINE_STATE_DESC computeDesc = {};
+        computeDesc.CS = { vertexShader.data(), vertexShader.size() };
+
+        D3D12_COMPUTE_PIPELINE_STATE_DESC equalComputeDesc = {};
+        equalComputeDesc.CS = { vertexShaderCopy.data(), vertexShaderCopy.size() };
+
+        D3D12_COMPUTE_PIPELINE_STATE_DESC otherComputeDesc = {};
+        otherComputeDesc.CS = { pixelShader.data(), pixelShader.size() };
+
+        const PipelineCacheKey computeKey = GetComputePipelineKey(computeDesc, rootSignatureKey);
+        CHECK(GetComputePipelineKey(equalComputeDesc, rootSignatureKey) == computeKey);
+        CHECK(!(GetComputePipelineKey(otherComputeDesc, rootSignatureKey) == computeKey));
+        CHECK(!(GetComputePipelineKey(computeDesc, GetRootSignatureKey(otherSpaceLayout)) == computeKey));
+        CHECK(!(computeKey == pipelineKey));
+    }
+
+    // Many threads missing the same pipelines at once. Each pipeline is stored in the library once per thread that
+    // created it, which the backend reports as already stored for all but the first.
+    void TestPipelineCacheConcurrentMisses()
+    {
+        std::cout << "Pipeline cache concurrent misses" << std::endl;
+
+        constexpr uint32_t NUM_THREADS = 8;
+        constexpr uint32_t NUM_PIPELINES = 64;
+
+        const std::filesystem::path libraryPath = std::filesystem::temp_directory_path() / "D3D12LitePipelineCacheTest.bin";
+        std::filesystem::remove(libraryPath);
+
+        std::vector<std::vector<uint8_t>> computeShaders(NUM_PIPELINES);
+        for (uint32_t pipelineIndex = 0; pipelineIndex < NUM_PIPELINES; pipelineIndex++)
+        {
+            computeShaders[pipelineIndex] = { static_cast<uint8_t>(pipelineIndex), 1, 2, 3 };
+        }
+
+        PipelineResourceLayout layout;
+        const PipelineCacheKey rootSignatureKey = GetRootSignatureKey(layout);
+
+        auto requestAll = [&](PipelineCache& cache)
+        {
+            std::vector<std::thread> threads;
+
+            for (uint32_t threadIndex = 0; threadIndex < NUM_THREADS; threadIndex++)
+            {
+                threads.emplace_back([&]()
+                {
+                    for (const std::vector<uint8_t>& computeShader : computeShaders)
+                    {
+                        D3D12_COMPUTE_PIPELINE_STATE_DESC computeDesc = {};
+                        computeDesc.CS = { computeShader.data(), computeShader.size() };
+
+                        cache.GetComputePipeline(computeDesc, GetComputePipelineKey(computeDesc, rootSignatureKey));
+                    }
+                });
+            }
+
+            for (std::thread& thread : threads)
+            {
+                thread.join();
+            }
+        };
+
+        {
+            NullDeviceBackend backend(NullDeviceDesc{});
+            PipelineCache cache(backend, libraryPath.wstring());
+            requestAll(cache);
+
+            const PipelineCacheStatistics statistics = cache.GetStatistics();
+            CHECK(statistics.mNumLibraryHits + statistics.mNumLibraryMisses + statistics.mNumPipelineHits == NUM_THREADS * NUM_PIPELINES);
+            CHECK(statistics.mNumLibraryMisses >= NUM_PIPELINES);
+            CHECK(cache.SaveLibrary());
+        }
+
+        // A second run finds every pipeline in the saved library.
+        {
+            NullDeviceBackend backend(NullDeviceDesc{});
+            PipelineCache cache(backend, libraryPath.wstring());
+            requestAll(cache);
+
+            const PipelineCacheStatistics statistics = cache.GetStatistics();
+            CHECK(statistics.mNumLibraryMisses == 0);
+            CHECK(statistics.mNumLibraryHits >= NUM_PIPELINES);
+        }
+
+        std::filesystem::remove(libraryPath);
+    }
+}
+
+int RunTests()
+{
+    TestShaderCache();
+    TestPipelineCacheKeys();
+    TestPipelineCacheConcurrentMisses();
+    TestResidencyPolicy();
+
+    std::cout << (numFailedChecks == 0 ? "All checks passed" : "Some checks failed") << std::endl;
+
+    return numFailedChecks;
+}
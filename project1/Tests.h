@@ -0,0 +1,5 @@
+#pragma once
+
+// Runs the tests headless and prints every check that fails. Returns the number of failed checks, so 0 means they all
+// passed.
+int RunTests();
@@ -1,45 +1,57 @@
 #include "Transform.h"
 
-Transform::Transform() : mPosition(Vector3(0,0,0)), mRotation(Vector3(0, 0, 0)), mScale(Vector3(0, 0, 0))
+Transform::Transform()
 {}
 
-Transform::Transform(Vector3 v3) : Transform()
+Transform::Transform(TransformHierarchy& hierarchy, uint32_t id) : mHierarchy(&hierarchy), mId(id)
+{}
+
+bool Transform::IsValid() const
 {
-	mPosition = v3;
+	return mHierarchy && mHierarchy->IsValid(mId);
 }
 
-Transform::Transform(float x, float y, float z) : Transform(Vector3(x, y, z)) {}
+uint32_t Transform::GetId() const
+{
+	return mId;
+}
+
+Vector3 Transform::GetPosition() const
+{
+	return mHierarchy->GetLocalPosition(mId);
+}
 
-Transform::~Transform()
+Quaternion Transform::GetRotation() const
 {
+	return mHierarchy->GetLocalRotation(mId);
 }
 
-Vector3 Transform::GetPosition()
+Vector3 Transform::GetScale() const
 {
-	return mPosition;
+	return mHierarchy->GetLocalScale(mId);
 }
 
-Vector3 Transform::GetRotation()
+const Matrix& Transform::GetWorldMatrix() const
 {
-	return mRotation;
+	return mHierarchy->GetWorldMatrix(mId);
 }
 
-Vector3 Transform::GetScale()
+void Transform::SetPosition(const Vector3& v3)
 {
-	return mScale;
+	mHierarchy->SetLocalPosition(mId, v3);
 }
 
-void Transform::SetPosition(Vector3 v3)
+void Transform::SetRotation(const Quaternion& q)
 {
-	mPosition = v3;
+	mHierarchy->SetLocalRotation(mId, q);
 }
 
-void Transform::SetRotation(Vector3 v3)
+void Transform::SetRotation(const Vector3& v3)
 {
-	mRotation = v3;
+	mHierarchy->SetLocalRotation(mId, Quaternion::CreateFromYawPitchRoll(v3.y, v3.x, v3.z));
 }
 
-void Transform::SetScale(Vector3 v3)
+void Transform::SetScale(const Vector3& v3)
 {
-	mScale = v3;
+	mHierarchy->SetLocalScale(mId, v3);
 }
@@ -1,25 +1,36 @@
 #pragma once
 #include "D3D12Lite.h"
+#include "TransformHierarchy.h"
 
+// Handle to a transform in a TransformHierarchy. Copies refer to the same transform.
 class Transform
 {
 private:
-	Vector3 mPosition;
-	Vector3 mRotation;
-	Vector3 mScale;
+	TransformHierarchy* mHierarchy = nullptr;
+	uint32_t mId = INVALID_TRANSFORM_ID;
 
 public:
 	Transform();
-	Transform(Vector3);
-	Transform(float, float, float);
-	~Transform();
+	Transform(TransformHierarchy& hierarchy, uint32_t id);
 
-	Vector3 GetPosition();
-	Vector3 GetRotation();
-	Vector3 GetScale();
+	bool IsValid() const;
+	uint32_t GetId() const;
 
-	void SetPosition(Vector3);
-	void SetRotation(Vector3);
-	void SetScale(Vector3);
+	Vector3 GetPosition() const;
+	Quaternion GetRotation() const;
+	Vector3 GetScale() const;
+	// As of the last TransformHierarchy::Update.
+	const Matrix& GetWorldMatrix() const;
+
+	void SetPosition(const Vector3&);
+	void SetRotation(const Quaternion&);
+	// Pitch, yaw and roll in radians.
+	void SetRotation(const Vector3&);
+	void SetScale(const Vector3&);
 };
 
+// Links a game object's entity to its transform in the scene's TransformHierarchy.
+struct TransformComponent
+{
+	uint32_t mTransformId = INVALID_TRANSFORM_ID;
+};
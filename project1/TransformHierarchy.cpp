@@ -0,0 +1,482 @@
+#include "TransformHierarchy.h"
+#include <algorithm>
+#include <chrono>
+#include <cassert>
+#include <xmmintrin.h>
+
+namespace
+{
+    double GetMillisecondsSince(std::chrono::steady_clock::time_point startTime)
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+    }
+
+    // Scale, rotation and translation of four transforms composed into the upper 4x3 of their local matrices, for row
+    // vectors like the rest of SimpleMath. Lane j of local[row * 3 + column] is element [row][column] of transform j.
+    void ComposeLocalMatrices(const float* const components[], __m128 local[12])
+    {
+        const __m128 x = _mm_loadu_ps(components[3]);
+        const __m128 y = _mm_loadu_ps(components[4]);
+        const __m128 z = _mm_loadu_ps(components[5]);
+        const __m128 w = _mm_loadu_ps(components[6]);
+        const __m128 one = _mm_set1_ps(1.0f);
+        const __m128 two = _mm_set1_ps(2.0f);
+
+        const __m128 xx = _mm_mul_ps(x, x);
+        const __m128 yy = _mm_mul_ps(y, y);
+        const __m128 zz = _mm_mul_ps(z, z);
+        const __m128 xy = _mm_mul_ps(x, y);
+        const __m128 xz = _mm_mul_ps(x, z);
+        const __m128 yz = _mm_mul_ps(y, z);
+        const __m128 xw = _mm_mul_ps(x, w);
+        const __m128 yw = _mm_mul_ps(y, w);
+        const __m128 zw = _mm_mul_ps(z, w);
+
+        const __m128 scaleX = _mm_loadu_ps(components[7]);
+        const __m128 scaleY = _mm_loadu_ps(components[8]);
+        const __m128 scaleZ = _mm_loadu_ps(components[9]);
+
+        local[0] = _mm_mul_ps(scaleX, _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz))));
+        local[1] = _mm_mul_ps(scaleX, _mm_mul_ps(two, _mm_add_ps(xy, zw)));
+        local[2] = _mm_mul_ps(scaleX, _mm_mul_ps(two, _mm_sub_ps(xz, yw)));
+        local[3] = _mm_mul_ps(scaleY, _mm_mul_ps(two, _mm_sub_ps(xy, zw)));
+        local[4] = _mm_mul_ps(scaleY, _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz))));
+        local[5] = _mm_mul_ps(scaleY, _mm_mul_ps(two, _mm_add_ps(yz, xw)));
+        local[6] = _mm_mul_ps(scaleZ, _mm_mul_ps(two, _mm_add_ps(xz, yw)));
+        local[7] = _mm_mul_ps(scaleZ, _mm_mul_ps(two, _mm_sub_ps(yz, xw)));
+        local[8] = _mm_mul_ps(scaleZ, _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy))));
+        local[9] = _mm_loadu_ps(components[0]);
+        local[10] = _mm_loadu_ps(components[1]);
+        local[11] = _mm_loadu_ps(components[2]);
+    }
+
+    // world = local * parent, with local affine so only three rows of the parent are scaled and summed per row.
+    void WriteWorldMatrix(const float (&local)[12][4], uint32_t lane, const Matrix* parent, Matrix& world)
+    {
+        if (!parent) {
+            for (uint32_t row = 0; row < 4; row++) {
+                const float homogeneous = row == 3 ? 1.0f : 0.0f;
+                _mm_storeu_ps(world.m[row], _mm_setr_ps(local[row * 3][lane], local[row * 3 + 1][lane], local[row * 3 + 2][lane], homogeneous));
+            }
+            return;
+        }
+
+        const __m128 parentRow0 = _mm_loadu_ps(parent->m[0]);
+        const __m128 parentRow1 = _mm_loadu_ps(parent->m[1]);
+        const __m128 parentRow2 = _mm_loadu_ps(parent->m[2]);
+        const __m128 parentRow3 = _mm_loadu_ps(parent->m[3]);
+
+        for (uint32_t row = 0; row < 4; row++) {
+            __m128 result = _mm_mul_ps(_mm_set1_ps(local[row * 3][lane]), parentRow0);
+            result = _mm_add_ps(result, _mm_mul_ps(_mm_set1_ps(local[row * 3 + 1][lane]), parentRow1));
+            result = _mm_add_ps(result, _mm_mul_ps(_mm_set1_ps(local[row * 3 + 2][lane]), parentRow2));
+            if (row == 3) {
+                result = _mm_add_ps(result, parentRow3);
+            }
+            _mm_storeu_ps(world.m[row], result);
+        }
+    }
+}
+
+TransformHierarchy::TransformHierarchy(uint32_t numThreads)
+    : mWorkerPool(numThreads)
+{
+}
+
+uint32_t TransformHierarchy::Add(uint32_t parentId)
+{
+    assert(parentId == INVALID_TRANSFORM_ID || IsValid(parentId));
+
+    uint32_t id;
+    if (!mFreeIds.empty()) {
+        id = mFreeIds.back();
+        mFreeIds.pop_back();
+    } else {
+        id = static_cast<uint32_t>(mIndexOfId.size());
+        mIndexOfId.push_back(INVALID_TRANSFORM_ID);
+        mParentOfId.push_back(INVALID_TRANSFORM_ID);
+    }
+
+    const uint32_t index = static_cast<uint32_t>(mIdOfIndex.size());
+    mIndexOfId[id] = index;
+    mParentOfId[id] = parentId;
+
+    static const float identity[numLocalComponents] = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f, 1.0f };
+    for (uint32_t component = 0; component < numLocalComponents; component++) {
+        mLocalComponents[component].push_back(identity[component]);
+    }
+
+    // Where it belongs in the sorted order, and so its parent index, depth and children, is only worked out by the next
+    // Update.
+    mIdOfIndex.push_back(id);
+    mParentIndices.push_back(INVALID_TRANSFORM_ID);
+    mDepths.push_back(0);
+    mIsDirty.push_back(1);
+    mChangedInUpdate.push_back(0);
+    mWorldMatrices.push_back(Matrix());
+    mIsOrderDirty = true;
+
+    return id;
+}
+
+void TransformHierarchy::Remove(uint32_t id)
+{
+    const uint32_t index = GetIndex(id);
+
+    mIdOfIndex[index] = INVALID_TRANSFORM_ID;
+    mIndexOfId[id] = INVALID_TRANSFORM_ID;
+    mPendingFreeIds.push_back(id);
+    mIsOrderDirty = true;
+}
+
+bool TransformHierarchy::IsValid(uint32_t id) const
+{
+    return id < mIndexOfId.size() && mIndexOfId[id] != INVALID_TRANSFORM_ID;
+}
+
+void TransformHierarchy::SetParent(uint32_t id, uint32_t parentId)
+{
+    const uint32_t index = GetIndex(id);
+    assert(parentId == INVALID_TRANSFORM_ID || IsValid(parentId));
+
+    // A transform can't end up below itself.
+    for (uint32_t ancestorId = parentId; ancestorId != INVALID_TRANSFORM_ID; ancestorId = ResolveParent(ancestorId)) {
+        assert(ancestorId != id);
+    }
+
+    if (ResolveParent(id) == parentId) {
+        return;
+    }
+
+    mParentOfId[id] = parentId;
+    MarkDirty(index);
+    mIsOrderDirty = true;
+}
+
+uint32_t TransformHierarchy::GetParent(uint32_t id) const
+{
+    assert(IsValid(id));
+    return ResolveParent(id);
+}
+
+void TransformHierarchy::SetLocalPosition(uint32_t id, const Vector3& position)
+{
+    const uint32_t index = GetIndex(id);
+    mLocalComponents[positionX][index] = position.x;
+    mLocalComponents[positionY][index] = position.y;
+    mLocalComponents[positionZ][index] = position.z;
+    MarkDirty(index);
+}
+
+void TransformHierarchy::SetLocalRotation(uint32_t id, const Quaternion& rotation)
+{
+    const uint32_t index = GetIndex(id);
+    mLocalComponents[rotationX][index] = rotation.x;
+    mLocalComponents[rotationY][index] = rotation.y;
+    mLocalComponents[rotationZ][index] = rotation.z;
+    mLocalComponents[rotationW][index] = rotation.w;
+    MarkDirty(index);
+}
+
+void TransformHierarchy::SetLocalScale(uint32_t id, const Vector3& scale)
+{
+    const uint32_t index = GetIndex(id);
+    mLocalComponents[scaleX][index] = scale.x;
+    mLocalComponents[scaleY][index] = scale.y;
+    mLocalComponents[scaleZ][index] = scale.z;
+    MarkDirty(index);
+}
+
+Vector3 TransformHierarchy::GetLocalPosition(uint32_t id) const
+{
+    const uint32_t index = GetIndex(id);
+    return Vector3(mLocalComponents[positionX][index], mLocalComponents[positionY][index], mLocalComponents[positionZ][index]);
+}
+
+Quaternion TransformHierarchy::GetLocalRotation(uint32_t id) const
+{
+    const uint32_t index = GetIndex(id);
+    return Quaternion(mLocalComponents[rotationX][index], mLocalComponents[rotationY][index], mLocalComponents[rotationZ][index], mLocalComponents[rotationW][index]);
+}
+
+Vector3 TransformHierarchy::GetLocalScale(uint32_t id) const
+{
+    const uint32_t index = GetIndex(id);
+    return Vector3(mLocalComponents[scaleX][index], mLocalComponents[scaleY][index], mLocalComponents[scaleZ][index]);
+}
+
+const Matrix& TransformHierarchy::GetWorldMatrix(uint32_t id) const
+{
+    return mWorldMatrices[GetIndex(id)];
+}
+
+void TransformHierarchy::Update()
+{
+    const auto startTime = std::chrono::steady_clock::now();
+
+    mStatistics = TransformHierarchyStatistics();
+
+    if (mIsOrderDirty) {
+        Sort();
+        mStatistics.mSortMilliseconds = GetMillisecondsSince(startTime);
+    }
+
+    mUpdateNumber++;
+
+    const uint32_t numLevels = static_cast<uint32_t>(mDirtyRanges.size());
+    IndexRange changedInParentLevel;
+
+    for (uint32_t level = 0; level < numLevels; level++) {
+        // The children of a range of transforms are a range themselves, so everything that can need an update is
+        // between the first and last dirty transform of the level or child of a changed one.
+        IndexRange range = mDirtyRanges[level];
+        if (!changedInParentLevel.IsEmpty()) {
+            range.Add(mChildStarts[changedInParentLevel.mBegin], mChildStarts[changedInParentLevel.mEnd]);
+        }
+
+        mDirtyRanges[level] = IndexRange();
+        changedInParentLevel = IndexRange();
+
+        if (range.IsEmpty()) {
+            mStatistics.mNumLevelsSkipped++;
+            continue;
+        }
+
+        // Levels are a dependency chain, every one has to be done before the next starts, so only the transforms within
+        // a level are spread over the threads.
+        const uint32_t numBatches = (range.mEnd - range.mBegin + TRANSFORM_UPDATE_BATCH_SIZE - 1) / TRANSFORM_UPDATE_BATCH_SIZE;
+        mBatchUpdates.resize(numBatches);
+
+        if (numBatches == 1) {
+            mBatchUpdates[0] = UpdateRange(range.mBegin, range.mEnd);
+        } else {
+            for (uint32_t batchIndex = 0; batchIndex < numBatches; batchIndex++) {
+                const uint32_t batchBegin = range.mBegin + batchIndex * TRANSFORM_UPDATE_BATCH_SIZE;
+                const uint32_t batchEnd = (std::min)(batchBegin + TRANSFORM_UPDATE_BATCH_SIZE, range.mEnd);
+
+                mWorkerPool.AddJob([this, batchIndex, batchBegin, batchEnd]() {
+                    mBatchUpdates[batchIndex] = UpdateRange(batchBegin, batchEnd);
+                });
+            }
+
+            mWorkerPool.WaitForIdle();
+        }
+
+        for (const RangeUpdate& batchUpdate : mBatchUpdates) {
+            mStatistics.mNumUpdated += batchUpdate.mNumUpdated;
+            if (!batchUpdate.mChanged.IsEmpty()) {
+                changedInParentLevel.Add(batchUpdate.mChanged.mBegin, batchUpdate.mChanged.mEnd);
+            }
+        }
+    }
+
+    mStatistics.mNumTransforms = static_cast<uint32_t>(mIdOfIndex.size());
+    mStatistics.mNumLevels = numLevels;
+    mStatistics.mUpdateMilliseconds = GetMillisecondsSince(startTime);
+}
+
+uint32_t TransformHierarchy::GetIndex(uint32_t id) const
+{
+    assert(IsValid(id));
+    return mIndexOfId[id];
+}
+
+uint32_t TransformHierarchy::ResolveParent(uint32_t id) const
+{
+    uint32_t parentId = mParentOfId[id];
+
+    while (parentId != INVALID_TRANSFORM_ID && mIndexOfId[parentId] == INVALID_TRANSFORM_ID) {
+        parentId = mParentOfId[parentId];
+    }
+
+    return parentId;
+}
+
+void TransformHierarchy::MarkDirty(uint32_t index)
+{
+    if (mIsDirty[index]) {
+        return;
+    }
+
+    mIsDirty[index] = 1;
+
+    // The ranges are rebuilt by the sort, and until then the depth isn't known.
+    if (!mIsOrderDirty) {
+        mDirtyRanges[mDepths[index]].Add(index, index + 1);
+    }
+}
+
+void TransformHierarchy::Sort()
+{
+    const uint32_t numSlots = static_cast<uint32_t>(mIdOfIndex.size());
+    const uint32_t numIds = static_cast<uint32_t>(mIndexOfId.size());
+
+    // Children of every live transform by id, in their current order. Transforms whose parent was removed hang off the
+    // nearest live ancestor from now on.
+    std::vector<uint32_t> childStartsById(numIds + 1, 0);
+    std::vector<uint32_t> parentOfId(numIds, INVALID_TRANSFORM_ID);
+    std::vector<uint32_t> roots;
+
+    for (uint32_t index = 0; index < numSlots; index++) {
+        const uint32_t id = mIdOfIndex[index];
+        if (id == INVALID_TRANSFORM_ID) {
+            continue;
+        }
+
+        const uint32_t parentId = ResolveParent(id);
+        parentOfId[id] = parentId;
+        if (parentId == INVALID_TRANSFORM_ID) {
+            roots.push_back(id);
+        } else {
+            childStartsById[parentId + 1]++;
+        }
+    }
+
+    for (uint32_t id = 0; id < numIds; id++) {
+        childStartsById[id + 1] += childStartsById[id];
+    }
+
+    std::vector<uint32_t> childCursors(childStartsById.begin(), childStartsById.end() - 1);
+    std::vector<uint32_t> childrenById(childStartsById[numIds]);
+
+    for (uint32_t index = 0; index < numSlots; index++) {
+        const uint32_t id = mIdOfIndex[index];
+        if (id != INVALID_TRANSFORM_ID && parentOfId[id] != INVALID_TRANSFORM_ID) {
+            childrenById[childCursors[parentOfId[id]]++] = id;
+        }
+    }
+
+    // Breadth first from the roots, which sorts by depth and keeps siblings together in the order of their parents.
+    const uint32_t numTransforms = static_cast<uint32_t>(roots.size() + childrenById.size());
+    std::vector<uint32_t> sortedIds(std::move(roots));
+    sortedIds.reserve(numTransforms);
+    mChildStarts.resize(numTransforms + 1);
+
+    for (uint32_t index = 0; index < sortedIds.size(); index++) {
+        const uint32_t id = sortedIds[index];
+        mChildStarts[index] = static_cast<uint32_t>(sortedIds.size());
+        sortedIds.insert(sortedIds.end(), childrenById.begin() + childStartsById[id], childrenById.begin() + childStartsById[id + 1]);
+    }
+
+    assert(sortedIds.size() == numTransforms);
+    mChildStarts[numTransforms] = numTransforms;
+
+    std::vector<uint32_t> oldIndices(numTransforms);
+    for (uint32_t index = 0; index < numTransforms; index++) {
+        oldIndices[index] = mIndexOfId[sortedIds[index]];
+        mIndexOfId[sortedIds[index]] = index;
+    }
+
+    for (std::vector<float>& component : mLocalComponents) {
+        std::vector<float> sorted(numTransforms);
+        for (uint32_t index = 0; index < numTransforms; index++) {
+            sorted[index] = component[oldIndices[index]];
+        }
+        component = std::move(sorted);
+    }
+
+    std::vector<uint32_t> parentIndices(numTransforms);
+    std::vector<uint32_t> depths(numTransforms);
+    std::vector<uint8_t> isDirty(numTransforms);
+    std::vector<Matrix> worldMatrices(numTransforms);
+    mDirtyRanges.clear();
+
+    for (uint32_t index = 0; index < numTransforms; index++) {
+        const uint32_t oldIndex = oldIndices[index];
+        const uint32_t id = sortedIds[index];
+        const uint32_t parentId = parentOfId[id];
+
+        parentIndices[index] = parentId == INVALID_TRANSFORM_ID ? INVALID_TRANSFORM_ID : mIndexOfId[parentId];
+        depths[index] = parentId == INVALID_TRANSFORM_ID ? 0 : depths[parentIndices[index]] + 1;
+        worldMatrices[index] = mWorldMatrices[oldIndex];
+
+        if (depths[index] == mDirtyRanges.size()) {
+            mDirtyRanges.emplace_back();
+        }
+
+        // A transform moved up to a new parent has to pick up that parent's world matrix.
+        isDirty[index] = mIsDirty[oldIndex] || parentId != mParentOfId[id];
+        if (isDirty[index]) {
+            mDirtyRanges[depths[index]].Add(index, index + 1);
+        }
+    }
+
+    for (uint32_t index = 0; index < numTransforms; index++) {
+        mParentOfId[sortedIds[index]] = parentOfId[sortedIds[index]];
+    }
+
+    mIdOfIndex = std::move(sortedIds);
+    mParentIndices = std::move(parentIndices);
+    mDepths = std::move(depths);
+    mIsDirty = std::move(isDirty);
+    mWorldMatrices = std::move(worldMatrices);
+    mChangedInUpdate.assign(numTransforms, 0);
+    mUpdateNumber = 0;
+
+    // Nothing refers to the removed ids any more, so they can be handed out again.
+    for (uint32_t id : mPendingFreeIds) {
+        mParentOfId[id] = INVALID_TRANSFORM_ID;
+        mFreeIds.push_back(id);
+    }
+    mPendingFreeIds.clear();
+
+    mIsOrderDirty = false;
+}
+
+TransformHierarchy::RangeUpdate TransformHierarchy::UpdateRange(uint32_t begin, uint32_t end)
+{
+    const uint32_t* parentIndices = mParentIndices.data();
+    uint8_t* isDirty = mIsDirty.data();
+    uint32_t* changedInUpdate = mChangedInUpdate.data();
+    Matrix* worldMatrices = mWorldMatrices.data();
+    RangeUpdate rangeUpdate;
+
+    for (uint32_t index = begin; index < end; index += 4) {
+        const uint32_t numLanes = (std::min)(4u, end - index);
+        uint32_t laneMask = 0;
+
+        for (uint32_t lane = 0; lane < numLanes; lane++) {
+            const uint32_t parentIndex = parentIndices[index + lane];
+            const bool isParentChanged = parentIndex != INVALID_TRANSFORM_ID && changedInUpdate[parentIndex] == mUpdateNumber;
+            laneMask |= isDirty[index + lane] || isParentChanged ? 1u << lane : 0u;
+        }
+
+        if (laneMask == 0) {
+            continue;
+        }
+
+        // The last group of a range can be short, its components are copied out and padded so the loads stay in bounds.
+        const float* components[numLocalComponents];
+        float paddedComponents[numLocalComponents][4] = {};
+
+        for (uint32_t component = 0; component < numLocalComponents; component++) {
+            if (numLanes == 4) {
+                components[component] = mLocalComponents[component].data() + index;
+            } else {
+                std::copy_n(mLocalComponents[component].data() + index, numLanes, paddedComponents[component]);
+                components[component] = paddedComponents[component];
+            }
+        }
+
+        __m128 localRows[12];
+        ComposeLocalMatrices(components, localRows);
+
+        float local[12][4];
+        for (uint32_t element = 0; element < 12; element++) {
+            _mm_storeu_ps(local[element], localRows[element]);
+        }
+
+        for (uint32_t lane = 0; lane < numLanes; lane++) {
+            if (laneMask & (1u << lane)) {
+                const uint32_t parentIndex = parentIndices[index + lane];
+                WriteWorldMatrix(local, lane, parentIndex == INVALID_TRANSFORM_ID ? nullptr : &worldMatrices[parentIndex], worldMatrices[index + lane]);
+                isDirty[index + lane] = 0;
+                changedInUpdate[index + lane] = mUpdateNumber;
+                rangeUpdate.mChanged.Add(index + lane, index + lane + 1);
+                rangeUpdate.mNumUpdated++;
+            }
+        }
+    }
+
+    return rangeUpdate;
+}
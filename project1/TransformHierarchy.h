@@ -0,0 +1,117 @@
+#pragma once
+
+#include <cstdint>
+#include <climits>
+#include <algorithm>
+#include <array>
+#include <vector>
+// SimpleMath only builds with d3d12.h included before it.
+#include <d3d12.h>
+#include "SimpleMath/SimpleMath.h"
+#include "D3D12LiteWorkerPool.h"
+
+using namespace DirectX::SimpleMath;
+
+constexpr uint32_t INVALID_TRANSFORM_ID = UINT_MAX;
+// Transforms one update job handles, a multiple of the four the SIMD loop works on.
+constexpr uint32_t TRANSFORM_UPDATE_BATCH_SIZE = 16384;
+
+struct TransformHierarchyStatistics {
+    uint32_t mNumTransforms = 0;
+    uint32_t mNumLevels = 0;
+    // Transforms whose world matrix was recomputed, because they or one of their ancestors changed.
+    uint32_t mNumUpdated = 0;
+    // Levels left alone because nothing in them or above them changed.
+    uint32_t mNumLevelsSkipped = 0;
+    double mSortMilliseconds = 0.0;
+    double mUpdateMilliseconds = 0.0;
+};
+
+// Local position, rotation and scale of every transform in structure of arrays form, sorted breadth first so parents
+// always come before their children, every level of the hierarchy is one contiguous range and the children of
+// consecutive transforms are consecutive as well. Transforms are referred to by ids, which stay the same when the
+// storage is sorted again.
+//
+// Setters only mark a transform dirty. Update recomputes the world matrices of dirty transforms and everything below
+// them a level at a time, four transforms per SIMD iteration, with levels bigger than a batch split across the worker
+// threads. Only the range between the first and last transform that can have changed is visited on every level.
+// Adding, removing or reparenting transforms makes the next Update sort the storage again first.
+class TransformHierarchy {
+public:
+    TransformHierarchy(uint32_t numThreads);
+
+    uint32_t Add(uint32_t parentId = INVALID_TRANSFORM_ID);
+    // Children of a removed transform move up to its parent and keep their local values. The id is reused after the
+    // next Update.
+    void Remove(uint32_t id);
+    bool IsValid(uint32_t id) const;
+    void SetParent(uint32_t id, uint32_t parentId);
+    uint32_t GetParent(uint32_t id) const;
+
+    void SetLocalPosition(uint32_t id, const Vector3& position);
+    void SetLocalRotation(uint32_t id, const Quaternion& rotation);
+    void SetLocalScale(uint32_t id, const Vector3& scale);
+    Vector3 GetLocalPosition(uint32_t id) const;
+    Quaternion GetLocalRotation(uint32_t id) const;
+    Vector3 GetLocalScale(uint32_t id) const;
+    // As of the last Update.
+    const Matrix& GetWorldMatrix(uint32_t id) const;
+
+    void Update();
+
+    size_t GetNumTransforms() const { return mIdOfIndex.size() - mPendingFreeIds.size(); }
+    const TransformHierarchyStatistics& GetStatistics() const { return mStatistics; }
+
+private:
+    enum LocalComponent : uint32_t {
+        positionX, positionY, positionZ,
+        rotationX, rotationY, rotationZ, rotationW,
+        scaleX, scaleY, scaleZ,
+        numLocalComponents
+    };
+
+    struct IndexRange {
+        uint32_t mBegin = UINT_MAX;
+        uint32_t mEnd = 0;
+
+        bool IsEmpty() const { return mBegin >= mEnd; }
+        void Add(uint32_t begin, uint32_t end) { mBegin = (std::min)(mBegin, begin); mEnd = (std::max)(mEnd, end); }
+    };
+
+    struct RangeUpdate {
+        uint32_t mNumUpdated = 0;
+        IndexRange mChanged;
+    };
+
+    uint32_t GetIndex(uint32_t id) const;
+    uint32_t ResolveParent(uint32_t id) const;
+    void MarkDirty(uint32_t index);
+    void Sort();
+    RangeUpdate UpdateRange(uint32_t begin, uint32_t end);
+
+    // Indexed by id. Removed ids keep their parent until the next sort, so their children can be moved up to it.
+    std::vector<uint32_t> mIndexOfId;
+    std::vector<uint32_t> mParentOfId;
+    std::vector<uint32_t> mFreeIds;
+    std::vector<uint32_t> mPendingFreeIds;
+
+    // Indexed by position in the sorted storage. Transforms added since the last sort are at the end.
+    std::array<std::vector<float>, numLocalComponents> mLocalComponents;
+    std::vector<uint32_t> mIdOfIndex;
+    std::vector<uint32_t> mParentIndices;
+    // The children of transform i are [mChildStarts[i], mChildStarts[i + 1]), with one extra entry at the end.
+    std::vector<uint32_t> mChildStarts;
+    std::vector<uint32_t> mDepths;
+    std::vector<uint8_t> mIsDirty;
+    // The Update a transform's world matrix last changed in, which the level below checks its parents against.
+    std::vector<uint32_t> mChangedInUpdate;
+    std::vector<Matrix> mWorldMatrices;
+
+    std::vector<IndexRange> mDirtyRanges;
+    std::vector<RangeUpdate> mBatchUpdates;
+    uint32_t mUpdateNumber = 0;
+    bool mIsOrderDirty = false;
+
+    D3D12Lite::WorkerPool mWorkerPool;
+    TransformHierarchyStatistics mStatistics;
+};